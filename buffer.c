@@ -56,6 +56,20 @@ ldns_buffer_new_frm_data(ldns_buffer *buffer, const void *data, size_t size)
 	ldns_buffer_invariant(buffer);
 }
 
+void
+ldns_buffer_init_frm_data(ldns_buffer *buffer, void *data, size_t size)
+{
+	assert(data != NULL);
+
+	buffer->_position = 0;
+	buffer->_limit = buffer->_capacity = size;
+	buffer->_fixed = 1;
+	buffer->_data = data;
+	buffer->_status = LDNS_STATUS_OK;
+
+	ldns_buffer_invariant(buffer);
+}
+
 bool
 ldns_buffer_set_capacity(ldns_buffer *buffer, size_t capacity)
 {
@@ -146,6 +160,101 @@ ldns_buffer_free(ldns_buffer *buffer)
 	LDNS_FREE(buffer);
 }
 
+/* Recycled buffers are kept in size classes of LDNS_BUFFER_POOL_MIN << i
+ * bytes, up to a class for maximum sized packets
+ */
+#define LDNS_BUFFER_POOL_MIN     512
+#define LDNS_BUFFER_POOL_CLASSES 8
+#define LDNS_BUFFER_POOL_DEPTH   8
+
+struct ldns_buffer_pool
+{
+	ldns_buffer *buffers[LDNS_BUFFER_POOL_CLASSES][LDNS_BUFFER_POOL_DEPTH];
+	size_t count[LDNS_BUFFER_POOL_CLASSES];
+};
+
+static void
+ldns_buffer_pool_drain(void *arg)
+{
+	struct ldns_buffer_pool *pool = arg;
+	size_t c;
+
+	for (c = 0; c < LDNS_BUFFER_POOL_CLASSES; c++) {
+		while (pool->count[c] > 0) {
+			ldns_buffer_free(pool->buffers[c][--pool->count[c]]);
+		}
+	}
+}
+
+static const struct _ldns_thread_pool ldns_buffer_pool_type = {
+	sizeof(struct ldns_buffer_pool), ldns_buffer_pool_drain
+};
+
+static struct ldns_buffer_pool *
+ldns_buffer_pool(bool create)
+{
+	return _ldns_thread_pool(&ldns_buffer_pool_type, create);
+}
+
+ldns_buffer *
+ldns_buffer_new_pooled(size_t capacity)
+{
+	struct ldns_buffer_pool *pool;
+	ldns_buffer *buffer;
+	size_t c = 0;
+
+	while (c < LDNS_BUFFER_POOL_CLASSES &&
+			((size_t) LDNS_BUFFER_POOL_MIN << c) < capacity) {
+		c++;
+	}
+	if (c == LDNS_BUFFER_POOL_CLASSES) {
+		return ldns_buffer_new(capacity);
+	}
+	pool = ldns_buffer_pool(false);
+	if (!pool || pool->count[c] == 0) {
+		return ldns_buffer_new((size_t) LDNS_BUFFER_POOL_MIN << c);
+	}
+	buffer = pool->buffers[c][--pool->count[c]];
+	ldns_buffer_clear(buffer);
+	buffer->_status = LDNS_STATUS_OK;
+	return buffer;
+}
+
+void
+ldns_buffer_recycle(ldns_buffer *buffer)
+{
+	struct ldns_buffer_pool *pool;
+	size_t c = 0;
+
+	if (!buffer || buffer->_fixed
+	            || buffer->_capacity < LDNS_BUFFER_POOL_MIN
+	            || buffer->_capacity >= ((size_t) LDNS_BUFFER_POOL_MIN
+	                                     << LDNS_BUFFER_POOL_CLASSES)) {
+		ldns_buffer_free(buffer);
+		return;
+	}
+	/* The largest class the buffer has the capacity for */
+	while (((size_t) LDNS_BUFFER_POOL_MIN << (c + 1)) <= buffer->_capacity) {
+		c++;
+	}
+	pool = ldns_buffer_pool(true);
+	if (!pool || pool->count[c] == LDNS_BUFFER_POOL_DEPTH) {
+		ldns_buffer_free(buffer);
+		return;
+	}
+	pool->buffers[c][pool->count[c]++] = buffer;
+}
+
+void
+ldns_buffer_pool_free(void)
+{
+	struct ldns_buffer_pool *pool = ldns_buffer_pool(false);
+
+	if (pool) {
+		ldns_buffer_pool_drain(pool);
+	}
+}
+
 void *
 ldns_buffer_export(ldns_buffer *buffer)
 {
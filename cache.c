@@ -0,0 +1,370 @@
+/*
+ * cache.c
+ *
+ * answer cache implementation
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+#include <ldns/config.h>
+#include <ldns/ldns.h>
+
+#include <time.h>
+
+/* query flags that are part of the key */
+#define LDNS_CACHE_KEY_RD 0x01
+#define LDNS_CACHE_KEY_CD 0x02
+#define LDNS_CACHE_KEY_DO 0x04
+
+/* owner name + type + class + flags + nameservers + port */
+#define LDNS_CACHE_KEY_MAX (LDNS_MAX_DOMAINLEN + 15)
+
+typedef struct ldns_cache_entry ldns_cache_entry;
+struct ldns_cache_entry
+{
+	/* place in the least recently used list, with the key */
+	struct _ldns_lru_entry lru;
+	/* node in the lookup tree, its key points to lru */
+	ldns_rbnode_t node;
+	/* when the answer was stored, to age its TTLs */
+	time_t stored;
+	/* absolute time after which the answer is stale */
+	time_t expire;
+	/* the answer in wire format */
+	uint8_t *wire;
+	size_t wire_size;
+	uint8_t key[LDNS_CACHE_KEY_MAX];
+};
+
+struct ldns_struct_cache
+{
+	ldns_rbtree_t *tree;
+	struct _ldns_lru lru;
+	/* bytes taken by the entries and their answers */
+	size_t size;
+	size_t max_size;
+	ldns_lock_type lock;
+};
+
+/* The key for a query sent by res (or by none), or false when the query
+ * should not be cached */
+static bool
+ldns_cache_key(ldns_cache_entry *key, const ldns_resolver *res,
+		const ldns_pkt *query)
+{
+	const ldns_rr *q;
+	const ldns_rdf *name;
+	uint64_t ns = 0;
+	uint16_t port = 0;
+	size_t i;
+
+	if (!query || ldns_pkt_get_opcode(query) != LDNS_PACKET_QUERY ||
+	    ldns_rr_list_rr_count(ldns_pkt_question(query)) != 1 ||
+	    ldns_pkt_tsig(query) ||
+	    ldns_pkt_edns_data(query) || query->_edns_list) {
+		return false;
+	}
+	q = ldns_rr_list_rr(ldns_pkt_question(query), 0);
+	name = ldns_rr_owner(q);
+	if (!name || ldns_rdf_size(name) > LDNS_MAX_DOMAINLEN ||
+	    ldns_rr_get_type(q) == LDNS_RR_TYPE_AXFR ||
+	    ldns_rr_get_type(q) == LDNS_RR_TYPE_IXFR) {
+		return false;
+	}
+	i = ldns_rdf_size(name);
+	_ldns_dname_lower(key->key, ldns_rdf_data(name), i);
+	ldns_write_uint16(&key->key[i], ldns_rr_get_type(q));
+	ldns_write_uint16(&key->key[i + 2], ldns_rr_get_class(q));
+	key->key[i + 4] = (ldns_pkt_rd(query) ? LDNS_CACHE_KEY_RD : 0)
+	                | (ldns_pkt_cd(query) ? LDNS_CACHE_KEY_CD : 0)
+	                | (ldns_pkt_edns_do(query) ? LDNS_CACHE_KEY_DO : 0);
+	if (res) {
+		ns = _ldns_resolver_nameservers_hash(res);
+		port = ldns_resolver_port(res);
+	}
+	ldns_write_uint32(&key->key[i + 5], (uint32_t) (ns >> 32));
+	ldns_write_uint32(&key->key[i + 9], (uint32_t) ns);
+	ldns_write_uint16(&key->key[i + 13], port);
+	key->lru.key_len = i + 15;
+	key->lru.key = key->key;
+	return true;
+}
+
+ldns_cache *
+ldns_cache_new(size_t max_size)
+{
+	ldns_cache *cache = LDNS_CALLOC(ldns_cache, 1);
+	if (!cache) {
+		return NULL;
+	}
+	cache->tree = ldns_rbtree_create(_ldns_lru_compare);
+	if (!cache->tree) {
+		LDNS_FREE(cache);
+		return NULL;
+	}
+	cache->max_size = max_size ? max_size : LDNS_CACHE_DEFAULT_SIZE;
+	ldns_lock_init(&cache->lock);
+	return cache;
+}
+
+static void
+ldns_cache_entry_free(ldns_cache_entry *entry)
+{
+	LDNS_FREE(entry->wire);
+	LDNS_FREE(entry);
+}
+
+/* the following functions must be called with the cache locked */
+
+static void
+ldns_cache_remove(ldns_cache *cache, ldns_cache_entry *entry)
+{
+	(void) ldns_rbtree_delete(cache->tree, &entry->lru);
+	_ldns_lru_unlink(&cache->lru, &entry->lru);
+	cache->size -= sizeof(ldns_cache_entry) + entry->wire_size;
+	ldns_cache_entry_free(entry);
+}
+
+static void
+ldns_cache_clear_locked(ldns_cache *cache)
+{
+	struct _ldns_lru_entry *entry, *next;
+
+	for (entry = cache->lru.first; entry; entry = next) {
+		next = entry->next;
+		ldns_cache_entry_free((ldns_cache_entry *) entry);
+	}
+	ldns_rbtree_init(cache->tree, _ldns_lru_compare);
+	cache->lru.first = cache->lru.last = NULL;
+	cache->size = 0;
+}
+
+void
+ldns_cache_clear(ldns_cache *cache)
+{
+	if (!cache) {
+		return;
+	}
+	ldns_lock(&cache->lock);
+	ldns_cache_clear_locked(cache);
+	ldns_unlock(&cache->lock);
+}
+
+void
+ldns_cache_free(ldns_cache *cache)
+{
+	if (!cache) {
+		return;
+	}
+	ldns_cache_clear_locked(cache);
+	ldns_rbtree_free(cache->tree);
+	ldns_lock_destroy(&cache->lock);
+	LDNS_FREE(cache);
+}
+
+size_t
+ldns_cache_size(ldns_cache *cache)
+{
+	size_t size;
+
+	if (!cache) {
+		return 0;
+	}
+	ldns_lock(&cache->lock);
+	size = cache->size;
+	ldns_unlock(&cache->lock);
+	return size;
+}
+
+static void
+ldns_rr_list_age_ttls(ldns_rr_list *rrs, uint32_t age)
+{
+	size_t i;
+	ldns_rr *rr;
+
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		rr = ldns_rr_list_rr(rrs, i);
+		ldns_rr_set_ttl(rr, ldns_rr_ttl(rr) > age
+		                    ? ldns_rr_ttl(rr) - age : 0);
+	}
+}
+
+ldns_pkt *
+_ldns_cache_lookup(ldns_cache *cache, const ldns_resolver *res,
+		const ldns_pkt *query)
+{
+	ldns_cache_entry key;
+	ldns_cache_entry *entry;
+	ldns_rbnode_t *node;
+	ldns_pkt *answer = NULL;
+	uint8_t *wire = NULL;
+	size_t wire_size = 0;
+	time_t now, stored = 0;
+	struct timeval tv;
+
+	if (!cache || !ldns_cache_key(&key, res, query)) {
+		return NULL;
+	}
+	now = ldns_time(NULL);
+
+	ldns_lock(&cache->lock);
+	node = ldns_rbtree_search(cache->tree, &key.lru);
+	if (node) {
+		entry = (ldns_cache_entry *) node->data;
+		if (entry->expire <= now) {
+			ldns_cache_remove(cache, entry);
+		} else if ((wire = LDNS_XMALLOC(uint8_t, entry->wire_size))) {
+			memcpy(wire, entry->wire, entry->wire_size);
+			wire_size = entry->wire_size;
+			stored = entry->stored;
+			_ldns_lru_touch(&cache->lru, &entry->lru);
+		}
+	}
+	ldns_unlock(&cache->lock);
+
+	if (!wire) {
+		return NULL;
+	}
+	if (ldns_wire2pkt(&answer, wire, wire_size) != LDNS_STATUS_OK) {
+		LDNS_FREE(wire);
+		return NULL;
+	}
+	LDNS_FREE(wire);
+
+	if (now > stored) {
+		ldns_rr_list_age_ttls(ldns_pkt_answer(answer),
+				(uint32_t) (now - stored));
+		ldns_rr_list_age_ttls(ldns_pkt_authority(answer),
+				(uint32_t) (now - stored));
+		ldns_rr_list_age_ttls(ldns_pkt_additional(answer),
+				(uint32_t) (now - stored));
+	}
+	ldns_pkt_set_id(answer, ldns_pkt_id(query));
+	ldns_pkt_set_size(answer, wire_size);
+	tv.tv_sec = now;
+	tv.tv_usec = 0;
+	ldns_pkt_set_timestamp(answer, tv);
+	return answer;
+}
+
+ldns_pkt *
+ldns_cache_lookup(ldns_cache *cache, const ldns_pkt *query)
+{
+	return _ldns_cache_lookup(cache, NULL, query);
+}
+
+void
+_ldns_cache_store(ldns_cache *cache, const ldns_resolver *res,
+		const ldns_pkt *query, const ldns_pkt *answer)
+{
+	ldns_cache_entry key;
+	ldns_cache_entry *entry;
+	ldns_rbnode_t *node;
+	uint32_t ttl;
+	time_t now;
+
+	if (!cache || !answer || !ldns_cache_key(&key, res, query)) {
+		return;
+	}
+	ttl = ldns_pkt_cache_ttl(answer);
+	if (ttl == 0) {
+		return;
+	}
+	entry = LDNS_MALLOC(ldns_cache_entry);
+	if (!entry) {
+		return;
+	}
+	if (ldns_pkt2wire(&entry->wire, answer, &entry->wire_size)
+			!= LDNS_STATUS_OK) {
+		LDNS_FREE(entry);
+		return;
+	}
+	if (sizeof(ldns_cache_entry) + entry->wire_size > cache->max_size) {
+		ldns_cache_entry_free(entry);
+		return;
+	}
+	now = ldns_time(NULL);
+	entry->stored = now;
+	entry->expire = now + (time_t) ttl;
+	entry->lru.key_len = key.lru.key_len;
+	entry->lru.key = entry->key;
+	memcpy(entry->key, key.key, key.lru.key_len);
+	entry->node.key = &entry->lru;
+	entry->node.data = entry;
+
+	ldns_lock(&cache->lock);
+	node = ldns_rbtree_search(cache->tree, &entry->lru);
+	if (node) {
+		ldns_cache_remove(cache, (ldns_cache_entry *) node->data);
+	}
+	while (cache->lru.last && cache->size + sizeof(ldns_cache_entry)
+			+ entry->wire_size > cache->max_size) {
+		ldns_cache_remove(cache, (ldns_cache_entry *) cache->lru.last);
+	}
+	(void) ldns_rbtree_insert(cache->tree, &entry->node);
+	_ldns_lru_push_front(&cache->lru, &entry->lru);
+	cache->size += sizeof(ldns_cache_entry) + entry->wire_size;
+	ldns_unlock(&cache->lock);
+}
+
+void
+ldns_cache_store(ldns_cache *cache,
+		const ldns_pkt *query, const ldns_pkt *answer)
+{
+	_ldns_cache_store(cache, NULL, query, answer);
+}
+
+uint32_t
+ldns_pkt_cache_ttl(const ldns_pkt *answer)
+{
+	ldns_rr_list *rrs;
+	ldns_rr *rr;
+	uint32_t ttl = 0, min;
+	size_t i;
+	bool soa = false;
+
+	if (!answer || ldns_pkt_tc(answer) ||
+	    (ldns_pkt_get_rcode(answer) != LDNS_RCODE_NOERROR &&
+	     ldns_pkt_get_rcode(answer) != LDNS_RCODE_NXDOMAIN)) {
+		return 0;
+	}
+	if (ldns_pkt_get_rcode(answer) == LDNS_RCODE_NOERROR &&
+	    ldns_pkt_ancount(answer) > 0) {
+		rrs = ldns_pkt_answer(answer);
+		for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+			rr = ldns_rr_list_rr(rrs, i);
+			if (i == 0 || ldns_rr_ttl(rr) < ttl) {
+				ttl = ldns_rr_ttl(rr);
+			}
+		}
+		rrs = ldns_pkt_authority(answer);
+		for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+			rr = ldns_rr_list_rr(rrs, i);
+			if (ldns_rr_ttl(rr) < ttl) {
+				ttl = ldns_rr_ttl(rr);
+			}
+		}
+		return ttl;
+	}
+	rrs = ldns_pkt_authority(answer);
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		rr = ldns_rr_list_rr(rrs, i);
+		if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA &&
+		    ldns_rr_rd_count(rr) == 7) {
+			min = ldns_rdf2native_int32(ldns_rr_rdf(rr, 6));
+			if (ldns_rr_ttl(rr) < min) {
+				min = ldns_rr_ttl(rr);
+			}
+			if (!soa || min < ttl) {
+				ttl = min;
+			}
+			soa = true;
+		}
+	}
+	/* without a SOA there is no telling how long to remember */
+	return soa ? ttl : 0;
+}
@@ -44,8 +44,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-static const char Base64[] =
-	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 static const char Pad64 = '=';
 
 /* (From RFC1521 and draft-ietf-dnssec-secext-03.txt)
@@ -117,29 +115,67 @@ static const char Pad64 = '=';
    it returns the number of data bytes stored at the target, or -1 on error.
  */
 
+/* The value of a Base64 character in Table 1 below, or -1 for other
+   characters. */
+static int
+b64_value(int ch)
+{
+	if (ch >= 'A' && ch <= 'Z')
+		return ch - 'A';
+	if (ch >= 'a' && ch <= 'z')
+		return ch - 'a' + 26;
+	if (ch >= '0' && ch <= '9')
+		return ch - '0' + 52;
+	if (ch == '+')
+		return 62;
+	if (ch == '/')
+		return 63;
+	return -1;
+}
+
 int
 ldns_b64_pton(char const *origsrc, uint8_t *target, size_t targsize)
 {
 	unsigned char const* src = (unsigned char*)origsrc;
 	int tarindex, state, ch;
-	char *pos;
+	int val, v0, v1, v2, v3;
 
 	state = 0;
 	tarindex = 0;
 
-	if (strlen(origsrc) == 0) {
+	if (*origsrc == '\0') {
 		return 0;
 	}
 
-	while ((ch = *src++) != '\0') {
+	for (;;) {
+		/* Between quanta, decode whole quanta of four Base64
+		   characters while there are, which is what signatures
+		   and keys mostly consist of. The checks stop at the
+		   terminating nul, and anything else goes the slow way.
+		 */
+		while (state == 0 && target
+		    && (size_t)tarindex + 3 <= targsize
+		    && (v0 = b64_value(src[0])) >= 0
+		    && (v1 = b64_value(src[1])) >= 0
+		    && (v2 = b64_value(src[2])) >= 0
+		    && (v3 = b64_value(src[3])) >= 0) {
+			target[tarindex]   = (v0 << 2) | (v1 >> 4);
+			target[tarindex+1] = ((v1 & 0x0f) << 4) | (v2 >> 2);
+			target[tarindex+2] = ((v2 & 0x03) << 6) | v3;
+			tarindex += 3;
+			src += 4;
+		}
+		if ((ch = *src++) == '\0')
+			break;
+
 		if (isspace((unsigned char)ch))        /* Skip whitespace anywhere. */
 			continue;
 
 		if (ch == Pad64)
 			break;
 
-		pos = strchr(Base64, ch);
-		if (pos == 0) {
+		val = b64_value(ch);
+		if (val < 0) {
 			/* A non-base64 character. */
 			return (-1);
 		}
@@ -149,7 +185,7 @@ ldns_b64_pton(char const *origsrc, uint8_t *target, size_t targsize)
 			if (target) {
 				if ((size_t)tarindex >= targsize)
 					return (-1);
-				target[tarindex] = (pos - Base64) << 2;
+				target[tarindex] = val << 2;
 			}
 			state = 1;
 			break;
@@ -157,8 +193,8 @@ ldns_b64_pton(char const *origsrc, uint8_t *target, size_t targsize)
 			if (target) {
 				if ((size_t)tarindex + 1 >= targsize)
 					return (-1);
-				target[tarindex]   |=  (pos - Base64) >> 4;
-				target[tarindex+1]  = ((pos - Base64) & 0x0f)
+				target[tarindex]   |=  val >> 4;
+				target[tarindex+1]  = (val & 0x0f)
 							<< 4 ;
 			}
 			tarindex++;
@@ -168,8 +204,8 @@ ldns_b64_pton(char const *origsrc, uint8_t *target, size_t targsize)
 			if (target) {
 				if ((size_t)tarindex + 1 >= targsize)
 					return (-1);
-				target[tarindex]   |=  (pos - Base64) >> 2;
-				target[tarindex+1]  = ((pos - Base64) & 0x03)
+				target[tarindex]   |=  val >> 2;
+				target[tarindex+1]  = (val & 0x03)
 							<< 6;
 			}
 			tarindex++;
@@ -179,7 +215,7 @@ ldns_b64_pton(char const *origsrc, uint8_t *target, size_t targsize)
 			if (target) {
 				if ((size_t)tarindex >= targsize)
 					return (-1);
-				target[tarindex] |= (pos - Base64);
+				target[tarindex] |= val;
 			}
 			tarindex++;
 			state = 0;
@@ -48,6 +48,93 @@ ldns_dname_last_label_is_root_label(const ldns_rdf* dname)
 	return src_pos > 0 && len == 0;
 }
 
+/* Lowercases an ASCII byte, as RFC 4343 wants; unlike tolower() it does
+ * not depend on the locale.
+ */
+#define LDNS_DNAME_LOWER(b) ((uint8_t)((b) >= 'A' && (b) <= 'Z' ? (b) | 0x20 : (b)))
+
+#define LDNS_DNAME_ONES 0x0101010101010101ULL
+#define LDNS_DNAME_HIGH 0x8080808080808080ULL
+
+/* Lowercases the eight bytes in a word at once. Bytes with the high bit
+ * set are left alone, and for the others the high bit of the sums is set
+ * when the byte is 'A' or more, and when it is more than 'Z'. The bytes
+ * that are upper case get 0x20 added, which is their high bit shifted.
+ */
+static inline uint64_t
+ldns_dname_lower_word(uint64_t w)
+{
+	uint64_t low = w & ~LDNS_DNAME_HIGH;
+	uint64_t ge_a = low + LDNS_DNAME_ONES * (0x80 - 'A');
+	uint64_t gt_z = low + LDNS_DNAME_ONES * (0x7f - 'Z');
+
+	return w | ((ge_a & ~gt_z & ~w & LDNS_DNAME_HIGH) >> 2);
+}
+
+/* Writes the len bytes at src lowercased to dst, which may be src */
+void
+_ldns_dname_lower(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	uint64_t w;
+
+	for (; len >= sizeof(w); src += sizeof(w), dst += sizeof(w),
+			len -= sizeof(w)) {
+		memcpy(&w, src, sizeof(w));
+		w = ldns_dname_lower_word(w);
+		memcpy(dst, &w, sizeof(w));
+	}
+	for (; len > 0; src++, dst++, len--) {
+		*dst = LDNS_DNAME_LOWER(*src);
+	}
+}
+
+/* Compares len bytes case insensitively, eight at a time where they
+ * are equal. Returns < 0, 0 or > 0 like memcmp().
+ */
+static int
+ldns_dname_casecmp(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	uint64_t wa, wb;
+
+	for (; len >= sizeof(wa); a += sizeof(wa), b += sizeof(wb),
+			len -= sizeof(wa)) {
+		memcpy(&wa, a, sizeof(wa));
+		memcpy(&wb, b, sizeof(wb));
+		if (wa != wb && ldns_dname_lower_word(wa)
+		             != ldns_dname_lower_word(wb)) {
+			/* the difference is in here */
+			break;
+		}
+	}
+	for (; len > 0; a++, b++, len--) {
+		if (LDNS_DNAME_LOWER(*a) != LDNS_DNAME_LOWER(*b)) {
+			return (int)LDNS_DNAME_LOWER(*a)
+			     - (int)LDNS_DNAME_LOWER(*b);
+		}
+	}
+	return 0;
+}
+
+/* Stores pointers to the length bytes of the labels of dname, except
+ * the root label, in labels, which must have room for
+ * LDNS_MAX_DOMAINLEN / 2 + 1 pointers. Labels running past the end of
+ * the name are left out. Returns the number of labels.
+ */
+static size_t
+ldns_dname_labels(const ldns_rdf *dname, const uint8_t **labels)
+{
+	const uint8_t *data = ldns_rdf_data(dname);
+	const uint8_t *end = data + ldns_rdf_size(dname);
+	size_t n_labels = 0;
+
+	while (data < end && *data && data + *data < end
+			&& n_labels < LDNS_MAX_DOMAINLEN / 2 + 1) {
+		labels[n_labels++] = data;
+		data += *data + 1;
+	}
+	return n_labels;
+}
+
 ldns_rdf *
 ldns_dname_cat_clone(const ldns_rdf *rd1, const ldns_rdf *rd2)
 {
@@ -97,6 +184,10 @@ ldns_dname_cat(ldns_rdf *rd1, const ldns_rdf *rd2)
 			ldns_rdf_get_type(rd2) != LDNS_RDF_TYPE_DNAME) {
 		return LDNS_STATUS_ERR;
 	}
+	/* a shared name would change for all that hold it */
+	if (ldns_rdf_is_shared(rd1)) {
+		return LDNS_STATUS_ERR;
+	}
 
 	/* remove root label if it is present at the end of the left
 	 * rd, by reducing the size with 1
@@ -213,35 +304,17 @@ ldns_dname_left_chop(const ldns_rdf *d)
 uint8_t
 ldns_dname_label_count(const ldns_rdf *r)
 {
-        uint16_t src_pos;
-        uint16_t len;
-        uint8_t i;
-        size_t r_size;
+	const uint8_t *data, *end;
+	uint8_t i = 0;
 
-	if (!r) {
+	if (!r || ldns_rdf_get_type(r) != LDNS_RDF_TYPE_DNAME) {
 		return 0;
 	}
-
-	i = 0;
-	src_pos = 0;
-	r_size = ldns_rdf_size(r);
-
-	if (ldns_rdf_get_type(r) != LDNS_RDF_TYPE_DNAME) {
-		return 0;
-	} else {
-		len = ldns_rdf_data(r)[src_pos]; /* start of the label */
-
-		/* single root label */
-		if (1 == r_size) {
-			return 0;
-		} else {
-			while ((len > 0) && src_pos < r_size) {
-				src_pos++;
-				src_pos += len;
-				len = ldns_rdf_data(r)[src_pos];
-				i++;
-			}
-		}
+	data = ldns_rdf_data(r);
+	end = data + ldns_rdf_size(r);
+	while (data < end && *data) {
+		data += *data + 1;
+		i++;
 	}
 	return i;
 }
@@ -261,6 +334,7 @@ ldns_dname_new(uint16_t s, void *d)
         ldns_rdf_set_size(rd, s);
         ldns_rdf_set_type(rd, LDNS_RDF_TYPE_DNAME);
         ldns_rdf_set_data(rd, d);
+        rd->_refs = 0;
         return rd;
 }
 
@@ -280,94 +354,60 @@ void
 ldns_dname2canonical(const ldns_rdf *rd)
 {
 	uint8_t *rdd;
-	uint16_t i;
 
 	if (ldns_rdf_get_type(rd) != LDNS_RDF_TYPE_DNAME) {
 		return;
 	}
 
 	rdd = (uint8_t*)ldns_rdf_data(rd);
-	for (i = 0; i < ldns_rdf_size(rd); i++, rdd++) {
-		*rdd = (uint8_t)LDNS_DNAME_NORMALIZE((int)*rdd);
-	}
+	_ldns_dname_lower(rdd, rdd, ldns_rdf_size(rd));
 }
 
 bool
 ldns_dname_is_subdomain(const ldns_rdf *sub, const ldns_rdf *parent)
 {
-	uint8_t sub_lab;
-	uint8_t par_lab;
-	int8_t i, j;
-	ldns_rdf *tmp_sub = NULL;
-	ldns_rdf *tmp_par = NULL;
-    ldns_rdf *sub_clone;
-    ldns_rdf *parent_clone;
-    bool result = true;
+	const uint8_t *sub_labels[LDNS_MAX_DOMAINLEN / 2 + 1];
+	const uint8_t *par_labels[LDNS_MAX_DOMAINLEN / 2 + 1];
+	size_t sub_lab, par_lab, i;
+	const uint8_t *s, *p;
 
 	if (ldns_rdf_get_type(sub) != LDNS_RDF_TYPE_DNAME ||
 			ldns_rdf_get_type(parent) != LDNS_RDF_TYPE_DNAME ||
 			ldns_rdf_compare(sub, parent) == 0) {
 		return false;
 	}
-
-    /* would be nicer if we do not have to clone... */
-    sub_clone = ldns_dname_clone_from(sub, 0);
-    parent_clone = ldns_dname_clone_from(parent, 0);
-    ldns_dname2canonical(sub_clone);
-    ldns_dname2canonical(parent_clone);
-
-	sub_lab = ldns_dname_label_count(sub_clone);
-	par_lab = ldns_dname_label_count(parent_clone);
+	sub_lab = ldns_dname_labels(sub, sub_labels);
+	par_lab = ldns_dname_labels(parent, par_labels);
 
 	/* if sub sits above parent, it cannot be a child/sub domain */
 	if (sub_lab < par_lab) {
-		result = false;
-	} else {
-		/* check all labels the from the parent labels, from right to left.
-		 * When they /all/ match we have found a subdomain
-		 */
-		j = sub_lab - 1; /* we count from zero, thank you */
-		for (i = par_lab -1; i >= 0; i--) {
-			tmp_sub = ldns_dname_label(sub_clone, j);
-			tmp_par = ldns_dname_label(parent_clone, i);
-			if (!tmp_sub || !tmp_par) {
-				/* deep free does null check */
-				ldns_rdf_deep_free(tmp_sub);
-				ldns_rdf_deep_free(tmp_par);
-				result = false;
-				break;
-			}
-
-			if (ldns_rdf_compare(tmp_sub, tmp_par) != 0) {
-				/* they are not equal */
-				ldns_rdf_deep_free(tmp_sub);
-				ldns_rdf_deep_free(tmp_par);
-				result = false;
-				break;
-			}
-			ldns_rdf_deep_free(tmp_sub);
-			ldns_rdf_deep_free(tmp_par);
-			j--;
+		return false;
+	}
+	/* the last labels of sub must all match those of parent */
+	for (i = 0; i < par_lab; i++) {
+		s = sub_labels[sub_lab - par_lab + i];
+		p = par_labels[i];
+		if (*s != *p || ldns_dname_casecmp(s + 1, p + 1, *p) != 0) {
+			return false;
 		}
 	}
-	ldns_rdf_deep_free(sub_clone);
-	ldns_rdf_deep_free(parent_clone);
-	return result;
+	return true;
 }
 
 int
 ldns_dname_compare(const ldns_rdf *dname1, const ldns_rdf *dname2)
 {
-	size_t lc1, lc2, lc1f, lc2f;
-	size_t i;
-	int result = 0;
-	uint8_t *lp1, *lp2;
+	const uint8_t *labels1[LDNS_MAX_DOMAINLEN / 2 + 1];
+	const uint8_t *labels2[LDNS_MAX_DOMAINLEN / 2 + 1];
+	size_t lc1, lc2;
+	const uint8_t *lp1, *lp2;
+	int result;
 
 	/* see RFC4034 for this algorithm */
-	/* this algorithm assumes the names are normalized to case */
 
-        /* only when both are not NULL we can say anything about them */
-        if (!dname1 && !dname2) {
+        /* only when both are not NULL we can say anything about them;
+         * shared names are equal by pointer */
+        if (dname1 == dname2) {
                 return 0;
         }
         if (!dname1 || !dname2) {
@@ -380,76 +420,80 @@ ldns_dname_compare(const ldns_rdf *dname1, const ldns_rdf *dname2)
 	assert(ldns_rdf_get_type(dname1) == LDNS_RDF_TYPE_DNAME);
 	assert(ldns_rdf_get_type(dname2) == LDNS_RDF_TYPE_DNAME);
 
-	lc1 = ldns_dname_label_count(dname1);
-	lc2 = ldns_dname_label_count(dname2);
+	lc1 = ldns_dname_labels(dname1, labels1);
+	lc2 = ldns_dname_labels(dname2, labels2);
 
-	if (lc1 == 0 && lc2 == 0) {
-		return 0;
-	}
-	if (lc1 == 0) {
-		return -1;
-	}
-	if (lc2 == 0) {
-		return 1;
-	}
-	lc1--;
-	lc2--;
 	/* we start at the last label */
-	while (true) {
-		/* find the label first */
-		lc1f = lc1;
-		lp1 = ldns_rdf_data(dname1);
-		while (lc1f > 0) {
-			lp1 += *lp1 + 1;
-			lc1f--;
+	while (lc1 > 0 && lc2 > 0) {
+		lp1 = labels1[--lc1];
+		lp2 = labels2[--lc2];
+
+		/* now check the labels, up to the shortest length */
+		result = ldns_dname_casecmp(lp1 + 1, lp2 + 1,
+				*lp1 < *lp2 ? *lp1 : *lp2);
+		if (result != 0) {
+			return result < 0 ? -1 : 1;
 		}
-
-		/* and find the other one */
-		lc2f = lc2;
-		lp2 = ldns_rdf_data(dname2);
-		while (lc2f > 0) {
-			lp2 += *lp2 + 1;
-			lc2f--;
+		if (*lp1 != *lp2) {
+			/* the shorter label is a prefix of the other */
+			return *lp1 < *lp2 ? -1 : 1;
 		}
+	}
+	/* the name with fewer labels comes first */
+	if (lc1 == lc2) {
+		return 0;
+	}
+	return lc1 < lc2 ? -1 : 1;
+}
 
-		/* now check the label character for character. */
-		for (i = 1; i < (size_t)(*lp1 + 1); i++) {
-			if (i > *lp2) {
-				/* apparently label 1 is larger */
-				result = 1;
-				goto done;
-			}
-			if (LDNS_DNAME_NORMALIZE((int) *(lp1 + i)) <
-			    LDNS_DNAME_NORMALIZE((int) *(lp2 + i))) {
-			    result = -1;
-			    goto done;
-			} else if (LDNS_DNAME_NORMALIZE((int) *(lp1 + i)) >
-			    LDNS_DNAME_NORMALIZE((int) *(lp2 + i))) {
-			    result = 1;
-			    goto done;
-			}
+/* Writes the key of dname to key, or only returns its length when key is
+ * NULL. The key is the lowercased name with its labels in reverse order,
+ * each label followed by 1, and label bytes 0, 1 and 2 escaped as 2
+ * followed by the byte + 2. So memcmp() on keys gives the order of
+ * ldns_dname_compare(), a key is a prefix of the keys of the names below
+ * its name, and the key of the root is empty. A key is at most
+ * 2 * LDNS_MAX_DOMAINLEN bytes.
+ */
+size_t
+_ldns_dname_key_write(uint8_t *key, const ldns_rdf *dname)
+{
+	const uint8_t *labels[LDNS_MAX_DOMAINLEN / 2 + 1];
+	const uint8_t *data, *end;
+	size_t n_labels = 0, len = 0, i;
+	uint8_t b;
+
+	if (dname && ldns_rdf_size(dname) > 0) {
+		data = ldns_rdf_data(dname);
+		end = data + ldns_rdf_size(dname);
+		while (data < end && *data && data + *data < end
+				&& n_labels < sizeof(labels) / sizeof(*labels)) {
+			labels[n_labels++] = data;
+			data += *data + 1;
 		}
-		if (*lp1 < *lp2) {
-			/* apparently label 2 is larger */
-			result = -1;
-			goto done;
+	}
+	while (n_labels > 0) {
+		data = labels[--n_labels];
+		for (i = 1; i <= *data; i++) {
+			b = LDNS_DNAME_LOWER(data[i]);
+			if (b <= 2) {
+				if (key) {
+					key[len] = 2;
+					key[len + 1] = b + 2;
+				}
+				len += 2;
+			} else {
+				if (key) {
+					key[len] = b;
+				}
+				len += 1;
+			}
 		}
-		if (lc1 == 0 && lc2 > 0) {
-			result = -1;
-			goto done;
-		} else if (lc1 > 0 && lc2 == 0) {
-			result = 1;
-			goto done;
-		} else if (lc1 == 0 && lc2 == 0) {
-			result = 0;
-			goto done;
+		if (key) {
+			key[len] = 1;
 		}
-		lc1--;
-		lc2--;
+		len += 1;
 	}
-
-	done:
-	return result;
+	return len;
 }
 
 int
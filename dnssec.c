@@ -1700,13 +1700,34 @@ qsort_rr_compare_nsec3(const void *a, const void *b)
 	return ldns_rdf_compare(ldns_rr_owner(rr1), ldns_rr_owner(rr2));
 }
 
+void _ldns_rr_list_sort_keys(ldns_rr_list *unsorted,
+		size_t (*write_key)(uint8_t *key, const ldns_rr *rr));
+
+/* The size of the owner followed by the owner, so that memcmp() on these
+ * keys gives the order of qsort_rr_compare_nsec3()
+ */
+static size_t
+ldns_nsec3_sort_key_write(uint8_t *key, const ldns_rr *rr)
+{
+	const ldns_rdf *owner = rr ? ldns_rr_owner(rr) : NULL;
+
+	if (!owner) {
+		return 0;
+	}
+	if (key) {
+		ldns_write_uint16(key, (uint16_t)ldns_rdf_size(owner));
+		if (ldns_rdf_size(owner) > 0) {
+			memcpy(key + 2, ldns_rdf_data(owner),
+					ldns_rdf_size(owner));
+		}
+	}
+	return 2 + ldns_rdf_size(owner);
+}
+
 void
 ldns_rr_list_sort_nsec3(ldns_rr_list *unsorted)
 {
-	qsort(unsorted->_rrs,
-	      ldns_rr_list_rr_count(unsorted),
-	      sizeof(ldns_rr *),
-	      qsort_rr_compare_nsec3);
+	_ldns_rr_list_sort_keys(unsorted, ldns_nsec3_sort_key_write);
 }
 
 int
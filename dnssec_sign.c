@@ -124,99 +124,79 @@ ldns_create_empty_rrsig(const ldns_rr_list *rrset,
 }
 
 #ifdef HAVE_SSL
-ldns_rdf *
-ldns_sign_public_buffer(ldns_buffer *sign_buf, ldns_key *current_key)
+/* Sets md to the digest that keys of the algorithm sign with, which is NULL
+ * for the algorithms that do not take one. Returns false for algorithms that
+ * can not sign.
+ */
+static bool
+ldns_sign_digest(ldns_signing_algorithm algorithm, const EVP_MD **md)
 {
-	ldns_rdf *b64rdf = NULL;
-
-	switch(ldns_key_algorithm(current_key)) {
+	switch(algorithm) {
 #ifdef USE_DSA
 	case LDNS_SIGN_DSA:
 	case LDNS_SIGN_DSA_NSEC3:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
 # ifdef HAVE_EVP_DSS1
-				   EVP_dss1()
+		*md = EVP_dss1();
 # else
-				   EVP_sha1()
+		*md = EVP_sha1();
 # endif
-				   );
-		break;
+		return true;
 #endif /* USE_DSA */
 	case LDNS_SIGN_RSASHA1:
 	case LDNS_SIGN_RSASHA1_NSEC3:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_sha1());
-		break;
+		*md = EVP_sha1();
+		return true;
 #ifdef USE_SHA2
 	case LDNS_SIGN_RSASHA256:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_sha256());
-		break;
+		*md = EVP_sha256();
+		return true;
 	case LDNS_SIGN_RSASHA512:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_sha512());
-		break;
+		*md = EVP_sha512();
+		return true;
 #endif /* USE_SHA2 */
 #ifdef USE_GOST
 	case LDNS_SIGN_ECC_GOST:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_get_digestbyname("md_gost94"));
-		break;
+		*md = EVP_get_digestbyname("md_gost94");
+		return true;
 #endif /* USE_GOST */
 #ifdef USE_ECDSA
         case LDNS_SIGN_ECDSAP256SHA256:
-       		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_sha256());
-                break;
+		*md = EVP_sha256();
+		return true;
         case LDNS_SIGN_ECDSAP384SHA384:
-       		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_sha384());
-                break;
+		*md = EVP_sha384();
+		return true;
 #endif
 #ifdef USE_ED25519
         case LDNS_SIGN_ED25519:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   NULL);
-                break;
+		*md = NULL;
+		return true;
 #endif
 #ifdef USE_ED448
         case LDNS_SIGN_ED448:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   NULL);
-                break;
+		*md = NULL;
+		return true;
 #endif
 	case LDNS_SIGN_RSAMD5:
-		b64rdf = ldns_sign_public_evp(
-				   sign_buf,
-				   ldns_key_evp_key(current_key),
-				   EVP_md5());
-		break;
+		*md = EVP_md5();
+		return true;
 	default:
 		/* do _you_ know this alg? */
 		printf("unknown algorithm, ");
 		printf("is the one used available on this system?\n");
-		break;
+		return false;
 	}
+}
+
+ldns_rdf *
+ldns_sign_public_buffer(ldns_buffer *sign_buf, ldns_key *current_key)
+{
+	const EVP_MD *md;
 
-	return b64rdf;
+	if (!ldns_sign_digest(ldns_key_algorithm(current_key), &md)) {
+		return NULL;
+	}
+	return ldns_sign_public_evp(sign_buf, ldns_key_evp_key(current_key), md);
 }
 
 /**
@@ -226,105 +206,14 @@ ldns_sign_public_buffer(ldns_buffer *sign_buf, ldns_key *current_key)
 ldns_rr_list *
 ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys)
 {
+	ldns_sign_ctx *ctx;
 	ldns_rr_list *signatures;
-	ldns_rr_list *rrset_clone;
-	ldns_rr *current_sig;
-	ldns_rdf *b64rdf;
-	ldns_key *current_key;
-	size_t key_count;
-	uint16_t i;
-	ldns_buffer *sign_buf;
-	ldns_rdf *new_owner;
-
-	if (!rrset || ldns_rr_list_rr_count(rrset) < 1 || !keys) {
-		return NULL;
-	}
-
-	new_owner = NULL;
 
-	/* prepare a signature and add all the know data
-	 * prepare the rrset. Sign this together.  */
-	rrset_clone = ldns_rr_list_clone(rrset);
-	if (!rrset_clone) {
+	if (!(ctx = ldns_sign_ctx_new())) {
 		return NULL;
 	}
-
-	/* make it canonical */
-	for(i = 0; i < ldns_rr_list_rr_count(rrset_clone); i++) {
-		ldns_rr_set_ttl(ldns_rr_list_rr(rrset_clone, i), 
-			ldns_rr_ttl(ldns_rr_list_rr(rrset, 0)));
-		ldns_rr2canonical(ldns_rr_list_rr(rrset_clone, i));
-	}
-	/* sort */
-	ldns_rr_list_sort(rrset_clone);
-
-	signatures = ldns_rr_list_new();
-
-	for (key_count = 0;
-		key_count < ldns_key_list_key_count(keys);
-		key_count++) {
-		if (!ldns_key_use(ldns_key_list_key(keys, key_count))) {
-			continue;
-		}
-		sign_buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-		if (!sign_buf) {
-			ldns_rr_list_free(rrset_clone);
-			ldns_rr_list_free(signatures);
-			ldns_rdf_free(new_owner);
-			return NULL;
-		}
-		b64rdf = NULL;
-
-		current_key = ldns_key_list_key(keys, key_count);
-		/* sign all RRs with keys that have ZSKbit, !SEPbit.
-		   sign DNSKEY RRs with keys that have ZSKbit&SEPbit */
-		if (ldns_key_flags(current_key) & LDNS_KEY_ZONE_KEY) {
-			current_sig = ldns_create_empty_rrsig(rrset_clone,
-			                                      current_key);
-
-			/* right now, we have: a key, a semi-sig and an rrset. For
-			 * which we can create the sig and base64 encode that and
-			 * add that to the signature */
-
-			if (ldns_rrsig2buffer_wire(sign_buf, current_sig)
-			    != LDNS_STATUS_OK) {
-				ldns_buffer_free(sign_buf);
-				/* ERROR */
-				ldns_rr_list_deep_free(rrset_clone);
-				ldns_rr_free(current_sig);
-				ldns_rr_list_deep_free(signatures);
-				return NULL;
-			}
-
-			/* add the rrset in sign_buf */
-			if (ldns_rr_list2buffer_wire(sign_buf, rrset_clone)
-			    != LDNS_STATUS_OK) {
-				ldns_buffer_free(sign_buf);
-				ldns_rr_list_deep_free(rrset_clone);
-				ldns_rr_free(current_sig);
-				ldns_rr_list_deep_free(signatures);
-				return NULL;
-			}
-
-			b64rdf = ldns_sign_public_buffer(sign_buf, current_key);
-
-			if (!b64rdf) {
-				/* signing went wrong */
-				ldns_rr_list_deep_free(rrset_clone);
-				ldns_rr_free(current_sig);
-				ldns_rr_list_deep_free(signatures);
-				return NULL;
-			}
-
-			ldns_rr_rrsig_set_sig(current_sig, b64rdf);
-
-			/* push the signature to the signatures list */
-			ldns_rr_list_push_rr(signatures, current_sig);
-		}
-		ldns_buffer_free(sign_buf); /* restart for the next key */
-	}
-	ldns_rr_list_deep_free(rrset_clone);
-
+	signatures = ldns_sign_public_ctx(ctx, rrset, keys);
+	ldns_sign_ctx_free(ctx);
 	return signatures;
 }
 
@@ -440,6 +329,64 @@ ldns_pkey_is_ecdsa(EVP_PKEY* pkey)
 #endif /* splint */
 #endif /* USE_ECDSA */
 
+/* How the OpenSSL signatures of a key are converted to the DNS format: -1
+ * for DSA, the number of bytes per component for ECDSA, or 0 when they are
+ * the same.
+ */
+static int
+ldns_evp_sig_kind(EVP_PKEY *key)
+{
+	(void)key;
+#ifdef USE_DSA
+#ifndef S_SPLINT_S
+	/* unfortunately, OpenSSL output is different from DNS DSA format */
+# ifdef HAVE_EVP_PKEY_GET_BASE_ID
+	if (EVP_PKEY_get_base_id(key) == EVP_PKEY_DSA) {
+# elif defined(HAVE_EVP_PKEY_BASE_ID)
+	if (EVP_PKEY_base_id(key) == EVP_PKEY_DSA) {
+# else
+	if (EVP_PKEY_type(key->type) == EVP_PKEY_DSA) {
+# endif
+		return -1;
+	}
+#endif
+#endif
+#if defined(USE_ECDSA)
+	if(
+#  ifdef HAVE_EVP_PKEY_GET_BASE_ID
+		EVP_PKEY_get_base_id(key)
+#  elif defined(HAVE_EVP_PKEY_BASE_ID)
+		EVP_PKEY_base_id(key)
+#  else
+		EVP_PKEY_type(key->type)
+#  endif
+		== EVP_PKEY_EC) {
+		return ldns_pkey_is_ecdsa(key);
+	}
+#endif /* PKEY_EC */
+	return 0;
+}
+
+/* Converts the OpenSSL output in sig to the signature rdf */
+static ldns_rdf *
+ldns_evp_sig2rdf(ldns_buffer *sig, unsigned int siglen, int kind)
+{
+#ifdef USE_DSA
+	if (kind == -1) {
+		return ldns_convert_dsa_rrsig_asn12rdf(sig, siglen);
+	}
+#endif
+#ifdef USE_ECDSA
+	if (kind > 0) {
+		return ldns_convert_ecdsa_rrsig_asn1len2rdf(
+				sig, (long)siglen, kind);
+	}
+#endif
+	/* ok output for other types is the same */
+	return ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, siglen,
+			ldns_buffer_begin(sig));
+}
+
 ldns_rdf *
 ldns_sign_public_evp(ldns_buffer *to_sign,
 				 EVP_PKEY *key,
@@ -523,664 +470,1439 @@ ldns_sign_public_evp(ldns_buffer *to_sign,
 		return NULL;
 	}
 
-	/* OpenSSL output is different, convert it */
-	r = 0;
-#ifdef USE_DSA
-#ifndef S_SPLINT_S
-	/* unfortunately, OpenSSL output is different from DNS DSA format */
-# ifdef HAVE_EVP_PKEY_GET_BASE_ID
-	if (EVP_PKEY_get_base_id(key) == EVP_PKEY_DSA) {
-# elif defined(HAVE_EVP_PKEY_BASE_ID)
-	if (EVP_PKEY_base_id(key) == EVP_PKEY_DSA) {
-# else
-	if (EVP_PKEY_type(key->type) == EVP_PKEY_DSA) {
-# endif
-		r = 1;
-		sigdata_rdf = ldns_convert_dsa_rrsig_asn12rdf(b64sig, siglen);
-	}
-#endif
-#endif
-#if defined(USE_ECDSA)
-	if(
-#  ifdef HAVE_EVP_PKEY_GET_BASE_ID
-		EVP_PKEY_get_base_id(key)
-#  elif defined(HAVE_EVP_PKEY_BASE_ID)
-		EVP_PKEY_base_id(key)
-#  else
-		EVP_PKEY_type(key->type)
-#  endif
-		== EVP_PKEY_EC) {
-#  ifdef USE_ECDSA
-                if(ldns_pkey_is_ecdsa(key)) {
-			r = 1;
-			sigdata_rdf = ldns_convert_ecdsa_rrsig_asn1len2rdf(
-				b64sig, (long)siglen, ldns_pkey_is_ecdsa(key));
-		}
-#  endif /* USE_ECDSA */
-	}
-#endif /* PKEY_EC */
-	if(r == 0) {
-		/* ok output for other types is the same */
-		sigdata_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, siglen,
-									 ldns_buffer_begin(b64sig));
-	}
+	sigdata_rdf = ldns_evp_sig2rdf(b64sig, siglen, ldns_evp_sig_kind(key));
 	ldns_buffer_free(b64sig);
 	EVP_MD_CTX_destroy(ctx);
 	return sigdata_rdf;
 }
 
-ldns_rdf *
-ldns_sign_public_rsasha1(ldns_buffer *to_sign, RSA *key)
+/* What a signing context keeps of a key: the RRSIG rdata before the
+ * signature, and the EVP_MD_CTX to sign with it
+ */
+typedef struct ldns_sign_ctx_key
 {
-	unsigned char md[EVP_MAX_MD_SIZE];
-	unsigned char *sha1_hash;
-	unsigned int siglen;
-	ldns_rdf *sigdata_rdf;
-	ldns_buffer *b64sig;
-	int result;
+	const ldns_key *key;
+	/* the fields of the key that the rest is made of */
+	EVP_PKEY *evp_key;
+	ldns_signing_algorithm algorithm;
+	uint16_t keytag;
+	uint32_t inception;
+	uint32_t expiration;
+	ldns_rdf *signer;
+
+	/* the RRSIG rdata from the type covered up to the signature, of
+	 * which the type covered, the labels and the original TTL are
+	 * filled in for each RRset, and the inception and expiration when
+	 * the key does not have them
+	 */
+	uint8_t *rdata;
+	size_t rdata_size;
 
-	siglen = 0;
-	b64sig = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-	if (!b64sig) {
-		return NULL;
-	}
+	/* set up with EVP_DigestSignInit() and copied for every signature,
+	 * or NULL for the algorithms that sign in one go
+	 */
+	EVP_MD_CTX *md_ctx;
+	size_t sig_size;
+	int sig_kind;
 
-	sha1_hash = SHA1((unsigned char*)ldns_buffer_begin(to_sign),
-				  ldns_buffer_position(to_sign), md);
-	if (!sha1_hash) {
-		ldns_buffer_free(b64sig);
-		return NULL;
-	}
+	/* the digest of the DNSKEY rdata, for the signature cache */
+	uint8_t key_digest[LDNS_SHA256_DIGEST_LENGTH];
+	bool has_key_digest;
+} ldns_sign_ctx_key;
 
-	result = RSA_sign(NID_sha1, sha1_hash, SHA_DIGEST_LENGTH,
-				   (unsigned char*)ldns_buffer_begin(b64sig),
-				   &siglen, key);
-	if (result != 1) {
-		ldns_buffer_free(b64sig);
-		return NULL;
-	}
+/* Where an RR is in the canonical RRs of an RRset */
+typedef struct ldns_sign_ctx_rr
+{
+	const uint8_t *data;
+	size_t size;
+	/* the size of the owner, type, class, TTL and rdata length */
+	size_t rdata;
+} ldns_sign_ctx_rr;
+
+/* An RRSIG of which the backend makes the signature */
+typedef struct ldns_sign_ctx_pending
+{
+	ldns_sign_request request;
+	/* NULL when the RRSIG was freed before it was signed */
+	ldns_rr *rrsig;
+	/* the digest for the signature cache */
+	uint8_t digest[LDNS_SHA256_DIGEST_LENGTH];
+	bool has_digest;
+} ldns_sign_ctx_pending;
+
+/* The number of requests that are submitted to a backend at once */
+#define LDNS_SIGN_CTX_BATCH 64
+/* The number of RRSIGs that may wait for their signature, after which
+ * ldns_sign_public_ctx() waits for them */
+#define LDNS_SIGN_CTX_MAX_PENDING 16384
+
+struct ldns_struct_sign_ctx
+{
+	ldns_sign_ctx_key *keys;
+	size_t key_count;
+	size_t key_capacity;
 
-	sigdata_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, siglen, 
-								 ldns_buffer_begin(b64sig));
-	ldns_buffer_free(b64sig); /* can't free this buffer ?? */
-	return sigdata_rdf;
-}
+	/* the RRs of an RRset in canonical form, and in canonical order
+	 * when they were not already
+	 */
+	ldns_buffer *rrs;
+	ldns_buffer *sorted;
+	ldns_sign_ctx_rr *rr_pos;
+	size_t rr_capacity;
 
-ldns_rdf *
-ldns_sign_public_rsamd5(ldns_buffer *to_sign, RSA *key)
+	EVP_MD_CTX *md_ctx;
+	/* the data for the algorithms that sign in one go */
+	ldns_buffer *sign_buf;
+	/* the signature as OpenSSL makes it */
+	ldns_buffer *sig;
+
+	ldns_sign_cache *cache;
+
+	/* with a backend, the RRSIGs that wait for their signature, of
+	 * which the first submitted ones are submitted to it
+	 */
+	ldns_sign_backend *backend;
+	ldns_sign_ctx_pending **pending;
+	size_t pending_count;
+	size_t pending_capacity;
+	size_t submitted;
+	/* the first error since ldns_sign_ctx_wait() */
+	ldns_status status;
+};
+
+static EVP_MD_CTX *
+ldns_evp_md_ctx_new(void)
 {
-	unsigned char md[EVP_MAX_MD_SIZE];
-	unsigned char *md5_hash;
-	unsigned int siglen;
-	ldns_rdf *sigdata_rdf;
-	ldns_buffer *b64sig;
+	EVP_MD_CTX *ctx;
 
-	b64sig = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-	if (!b64sig) {
-		return NULL;
-	}
+#ifdef HAVE_EVP_MD_CTX_NEW
+	ctx = EVP_MD_CTX_new();
+#else
+	ctx = (EVP_MD_CTX*)malloc(sizeof(*ctx));
+	if(ctx) EVP_MD_CTX_init(ctx);
+#endif
+	return ctx;
+}
 
-	md5_hash = MD5((unsigned char*)ldns_buffer_begin(to_sign),
-				ldns_buffer_position(to_sign), md);
-	if (!md5_hash) {
-		ldns_buffer_free(b64sig);
-		return NULL;
+static void
+ldns_sign_ctx_key_clear(ldns_sign_ctx_key *k)
+{
+	ldns_rdf_deep_free(k->signer);
+	LDNS_FREE(k->rdata);
+	if (k->md_ctx) {
+		EVP_MD_CTX_destroy(k->md_ctx);
 	}
+	memset(k, 0, sizeof(*k));
+}
 
-	RSA_sign(NID_md5, md5_hash, MD5_DIGEST_LENGTH,
-		    (unsigned char*)ldns_buffer_begin(b64sig),
-		    &siglen, key);
+/* Renders the RRSIG rdata and sets up the signing for a key */
+static bool
+ldns_sign_ctx_key_set(ldns_sign_ctx_key *k, const ldns_key *key)
+{
+	const EVP_MD *md;
+
+	ldns_sign_ctx_key_clear(k);
+	k->key = key;
+	k->evp_key = ldns_key_evp_key(key);
+	k->algorithm = ldns_key_algorithm(key);
+	k->keytag = ldns_key_keytag(key);
+	k->inception = ldns_key_inception(key);
+	k->expiration = ldns_key_expiration(key);
+	if (!k->evp_key || !ldns_key_pubkey_owner(key)
+	||  !ldns_sign_digest(k->algorithm, &md)
+	||  !(k->signer = ldns_rdf_clone(ldns_key_pubkey_owner(key)))) {
+		return false;
+	}
+	ldns_dname2canonical(k->signer);
 
-	sigdata_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, siglen,
-								 ldns_buffer_begin(b64sig));
-	ldns_buffer_free(b64sig);
-	return sigdata_rdf;
+	k->rdata_size = 18 + ldns_rdf_size(k->signer);
+	if (!(k->rdata = LDNS_XMALLOC(uint8_t, k->rdata_size))) {
+		return false;
+	}
+	memset(k->rdata, 0, 18);
+	k->rdata[2] = (uint8_t)k->algorithm;
+	ldns_write_uint32(k->rdata + 8, k->expiration);
+	ldns_write_uint32(k->rdata + 12, k->inception);
+	ldns_write_uint16(k->rdata + 16, k->keytag);
+	memcpy(k->rdata + 18, ldns_rdf_data(k->signer),
+			ldns_rdf_size(k->signer));
+
+	k->sig_size = (size_t)EVP_PKEY_size(k->evp_key);
+	k->sig_kind = ldns_evp_sig_kind(k->evp_key);
+#ifdef USE_ED25519
+	if (EVP_PKEY_id(k->evp_key) == NID_ED25519) {
+		/* digest must be NULL for ED25519 sign and verify */
+		return true;
+	}
+#endif
+#ifdef USE_ED448
+	if (EVP_PKEY_id(k->evp_key) == NID_ED448) {
+		return true;
+	}
+#endif
+	return md && (k->md_ctx = ldns_evp_md_ctx_new())
+	          && EVP_DigestSignInit(k->md_ctx, NULL, md, NULL,
+				  k->evp_key) == 1;
 }
-#endif /* HAVE_SSL */
 
-/**
- * Pushes all rrs from the rrsets of type A and AAAA on gluelist.
+/* Returns the entry of a key, which is made or renewed when the key is new
+ * to the context or has changed
  */
-static ldns_status
-ldns_dnssec_addresses_on_glue_list(
-		ldns_dnssec_rrsets *cur_rrset,
-		ldns_rr_list *glue_list)
+static ldns_sign_ctx_key *
+ldns_sign_ctx_get_key(ldns_sign_ctx *ctx, const ldns_key *key)
 {
-	ldns_dnssec_rrs *cur_rrs;
-	while (cur_rrset) {
-		if (cur_rrset->type == LDNS_RR_TYPE_A 
-				|| cur_rrset->type == LDNS_RR_TYPE_AAAA) {
-			for (cur_rrs = cur_rrset->rrs; 
-					cur_rrs; 
-					cur_rrs = cur_rrs->next) {
-				if (cur_rrs->rr) {
-					if (!ldns_rr_list_push_rr(glue_list, 
-							cur_rrs->rr)) {
-						return LDNS_STATUS_MEM_ERR; 
-						/* ldns_rr_list_push_rr()
-						 * returns false when unable
-						 * to increase the capacity
-						 * of the ldns_rr_list
-						 */
-					}
-				}
+	ldns_sign_ctx_key *k, *keys;
+	size_t i;
+
+	for (i = 0; i < ctx->key_count; i++) {
+		k = &ctx->keys[i];
+		if (k->key != key) {
+			continue;
+		}
+		if (k->evp_key == ldns_key_evp_key(key)
+		&&  k->algorithm == ldns_key_algorithm(key)
+		&&  k->keytag == ldns_key_keytag(key)
+		&&  k->inception == ldns_key_inception(key)
+		&&  k->expiration == ldns_key_expiration(key)
+		&&  ldns_key_pubkey_owner(key)
+		&&  ldns_dname_compare(k->signer,
+				ldns_key_pubkey_owner(key)) == 0) {
+			return k;
+		}
+		break;
+	}
+	if (i == ctx->key_count) {
+		if (ctx->key_count == ctx->key_capacity) {
+			keys = LDNS_XREALLOC(ctx->keys, ldns_sign_ctx_key,
+					ctx->key_capacity * 2 + 4);
+			if (!keys) {
+				return NULL;
 			}
+			ctx->keys = keys;
+			ctx->key_capacity = ctx->key_capacity * 2 + 4;
 		}
-		cur_rrset = cur_rrset->next;
+		k = &ctx->keys[ctx->key_count++];
+		memset(k, 0, sizeof(*k));
 	}
-	return LDNS_STATUS_OK;
+	if (ldns_sign_ctx_key_set(k, key)) {
+		return k;
+	}
+	/* so that it is set up again the next time */
+	ldns_sign_ctx_key_clear(k);
+	return NULL;
 }
 
-ldns_status
-ldns_dnssec_zone_mark_and_get_glue(ldns_dnssec_zone *zone, 
-	ldns_rr_list *glue_list)
+/* Compares byte strings, of which the shorter one sorts first when it is
+ * the start of the other
+ */
+static int
+ldns_sign_ctx_bytes_cmp(const uint8_t *a, size_t a_size,
+		const uint8_t *b, size_t b_size)
 {
-	ldns_rbnode_t    *node;
-	ldns_dnssec_name *name;
-	ldns_rdf         *owner;
-	ldns_rdf         *cut = NULL; /* keeps track of zone cuts */
-	/* When the cut is caused by a delegation, below_delegation will be 1.
-	 * When caused by a DNAME, below_delegation will be 0.
-	 */
-	int below_delegation = -1; /* init suppresses compiler warning */
-	ldns_status s;
+	int c = memcmp(a, b, a_size < b_size ? a_size : b_size);
 
-	if (!zone || !zone->names) {
-		return LDNS_STATUS_NULL;
-	}
-	for (node = ldns_rbtree_first(zone->names); 
-			node != LDNS_RBTREE_NULL; 
-			node = ldns_rbtree_next(node)) {
-		name = (ldns_dnssec_name *) node->data;
-		owner = ldns_dnssec_name_name(name);
+	return c ? c : a_size < b_size ? -1 : a_size > b_size ? 1 : 0;
+}
 
-		if (cut) { 
-			/* The previous node was a zone cut, or a subdomain
-			 * below a zone cut. Is this node (still) a subdomain
-			 * below the cut? Then the name is occluded. Unless
-			 * the name contains a SOA, after which we are 
-			 * authoritative again.
-			 *
-			 * FIXME! If there are labels in between the SOA and
-			 * the cut, going from the authoritative space (below
-			 * the SOA) up into occluded space again, will not be
-			 * detected with the construct below!
-			 */
-			if (ldns_dname_is_subdomain(owner, cut) &&
-					!ldns_dnssec_rrsets_contains_type(
-					name->rrsets, LDNS_RR_TYPE_SOA)) {
-
-				if (below_delegation && glue_list) {
-					s = ldns_dnssec_addresses_on_glue_list(
-						name->rrsets, glue_list);
-					if (s != LDNS_STATUS_OK) {
-						return s;
-					}
-				}
-				name->is_glue = true; /* Mark occluded name! */
-				continue;
-			} else {
-				cut = NULL;
-			}
-		}
+/* The canonical order of RRs of an RRset (RFC 4034 section 6.3), on their
+ * canonical form
+ */
+static int
+ldns_sign_ctx_rr_cmp(const void *a, const void *b)
+{
+	const ldns_sign_ctx_rr *rr1 = (const ldns_sign_ctx_rr *)a;
+	const ldns_sign_ctx_rr *rr2 = (const ldns_sign_ctx_rr *)b;
+	int c;
+
+	/* the owner, type and class, which are the same in an RRset */
+	if ((c = ldns_sign_ctx_bytes_cmp(rr1->data, rr1->rdata - 6,
+	                                 rr2->data, rr2->rdata - 6))) {
+		return c;
+	}
+	return ldns_sign_ctx_bytes_cmp(
+			rr1->data + rr1->rdata, rr1->size - rr1->rdata,
+			rr2->data + rr2->rdata, rr2->size - rr2->rdata);
+}
 
-		/* The node is not below a zone cut. Is it a zone cut itself?
-		 * Everything below a SOA is authoritative of course; Except
-		 * when the name also contains a DNAME :).
-		 */
-		if (ldns_dnssec_rrsets_contains_type(
-				name->rrsets, LDNS_RR_TYPE_NS)
-			    && !ldns_dnssec_rrsets_contains_type(
-				name->rrsets, LDNS_RR_TYPE_SOA)) {
-			cut = owner;
-			below_delegation = 1;
-			if (glue_list) { /* record glue on the zone cut */
-				s = ldns_dnssec_addresses_on_glue_list(
-					name->rrsets, glue_list);
-				if (s != LDNS_STATUS_OK) {
-					return s;
-				}
-			}
-		} else if (ldns_dnssec_rrsets_contains_type(
-				name->rrsets, LDNS_RR_TYPE_DNAME)) {
-			cut = owner;
-			below_delegation = 0;
+/* Writes the RRs of an RRset in canonical form, with the TTL of the first,
+ * and returns them in canonical order, without copying the RRs themselves.
+ */
+static ldns_buffer *
+ldns_sign_ctx_rrset(ldns_sign_ctx *ctx, const ldns_rr_list *rrset)
+{
+	size_t n = ldns_rr_list_rr_count(rrset);
+	uint32_t ttl = ldns_rr_ttl(ldns_rr_list_rr(rrset, 0));
+	ldns_sign_ctx_rr *rr_pos;
+	const ldns_rr *rr;
+	size_t i, pos;
+	bool sorted = true;
+
+	if (n > ctx->rr_capacity) {
+		if (!(rr_pos = LDNS_XREALLOC(ctx->rr_pos, ldns_sign_ctx_rr, n))) {
+			return NULL;
 		}
+		ctx->rr_pos = rr_pos;
+		ctx->rr_capacity = n;
 	}
-	return LDNS_STATUS_OK;
+	ldns_buffer_clear(ctx->rrs);
+	for (i = 0; i < n; i++) {
+		rr = ldns_rr_list_rr(rrset, i);
+		pos = ldns_buffer_position(ctx->rrs);
+		if (ldns_rr2buffer_wire_canonical(ctx->rrs, rr,
+					LDNS_SECTION_ANY) != LDNS_STATUS_OK) {
+			return NULL;
+		}
+		ctx->rr_pos[i].size = ldns_buffer_position(ctx->rrs) - pos;
+		ctx->rr_pos[i].rdata = (ldns_rr_owner(rr)
+		                     ? ldns_rdf_size(ldns_rr_owner(rr)) : 0) + 10;
+		ldns_buffer_write_u32_at(ctx->rrs,
+				pos + ctx->rr_pos[i].rdata - 6, ttl);
+	}
+	/* the buffer does not move anymore */
+	pos = 0;
+	for (i = 0; i < n; i++) {
+		ctx->rr_pos[i].data = ldns_buffer_at(ctx->rrs, pos);
+		pos += ctx->rr_pos[i].size;
+		if (i > 0 && sorted && ldns_sign_ctx_rr_cmp(
+				&ctx->rr_pos[i - 1], &ctx->rr_pos[i]) > 0) {
+			sorted = false;
+		}
+	}
+	if (sorted) {
+		return ctx->rrs;
+	}
+	qsort(ctx->rr_pos, n, sizeof(ldns_sign_ctx_rr), ldns_sign_ctx_rr_cmp);
+	ldns_buffer_clear(ctx->sorted);
+	if (!ldns_buffer_reserve(ctx->sorted, pos)) {
+		return NULL;
+	}
+	for (i = 0; i < n; i++) {
+		ldns_buffer_write(ctx->sorted,
+				ctx->rr_pos[i].data, ctx->rr_pos[i].size);
+	}
+	return ctx->sorted;
 }
 
-ldns_status
-ldns_dnssec_zone_mark_glue(ldns_dnssec_zone *zone)
+/* The digest by which the signature cache knows a signature: that of the
+ * key, the RRSIG rdata and the RRs
+ */
+static bool
+ldns_sign_ctx_digest(ldns_sign_ctx_key *k, const ldns_buffer *rrs,
+		uint8_t digest[LDNS_SHA256_DIGEST_LENGTH])
 {
-	return ldns_dnssec_zone_mark_and_get_glue(zone, NULL);
+	ldns_sha256_CTX sha256;
+	ldns_buffer *buf;
+	ldns_rr *dnskey;
+
+	if (!k->has_key_digest) {
+		/* the key tag and algorithm may be the same for another key */
+		if (!(dnskey = ldns_key2rr(k->key))) {
+			return false;
+		}
+		if (!(buf = ldns_buffer_new(LDNS_MIN_BUFLEN))) {
+			ldns_rr_free(dnskey);
+			return false;
+		}
+		if (ldns_rr_rdata2buffer_wire(buf, dnskey) != LDNS_STATUS_OK) {
+			ldns_buffer_free(buf);
+			ldns_rr_free(dnskey);
+			return false;
+		}
+		(void) ldns_sha256(ldns_buffer_begin(buf),
+				(unsigned int)ldns_buffer_position(buf),
+				k->key_digest);
+		ldns_buffer_free(buf);
+		ldns_rr_free(dnskey);
+		k->has_key_digest = true;
+	}
+	ldns_sha256_init(&sha256);
+	ldns_sha256_update(&sha256, k->key_digest, sizeof(k->key_digest));
+	ldns_sha256_update(&sha256, k->rdata, k->rdata_size);
+	ldns_sha256_update(&sha256, ldns_buffer_begin(rrs),
+			ldns_buffer_position(rrs));
+	ldns_sha256_final(digest, &sha256);
+	return true;
 }
 
-ldns_rbnode_t *
-ldns_dnssec_name_node_next_nonglue(ldns_rbnode_t *node)
+/* Signs the RRSIG rdata of a key and the RRs of an RRset */
+static ldns_rdf *
+ldns_sign_ctx_sign_evp(ldns_sign_ctx *ctx, const ldns_sign_ctx_key *k,
+		const ldns_buffer *rrs)
 {
-	ldns_rbnode_t *next_node = NULL;
-	ldns_dnssec_name *next_name = NULL;
-	bool done = false;
+	size_t siglen;
+	int r;
 
-	if (node == LDNS_RBTREE_NULL) {
+	ldns_buffer_clear(ctx->sig);
+	if (!ldns_buffer_reserve(ctx->sig, k->sig_size)) {
 		return NULL;
 	}
-	next_node = node;
-	while (!done) {
-		if (next_node == LDNS_RBTREE_NULL) {
+	siglen = ldns_buffer_capacity(ctx->sig);
+	if (k->md_ctx) {
+		r = EVP_MD_CTX_copy_ex(ctx->md_ctx, k->md_ctx);
+		if (r == 1) {
+			r = EVP_DigestSignUpdate(ctx->md_ctx,
+					k->rdata, k->rdata_size);
+		}
+		if (r == 1) {
+			r = EVP_DigestSignUpdate(ctx->md_ctx,
+					ldns_buffer_begin(rrs),
+					ldns_buffer_position(rrs));
+		}
+		if (r == 1) {
+			r = EVP_DigestSignFinal(ctx->md_ctx, (unsigned char*)
+					ldns_buffer_begin(ctx->sig), &siglen);
+		}
+	} else {
+#if defined(USE_ED25519) || defined(USE_ED448)
+		/* for these methods we must use the one-shot DigestSign */
+		ldns_buffer_clear(ctx->sign_buf);
+		if (!ldns_buffer_reserve(ctx->sign_buf,
+				k->rdata_size + ldns_buffer_position(rrs))) {
 			return NULL;
-		} else {
-			next_name = (ldns_dnssec_name *)next_node->data;
-			if (!next_name->is_glue) {
-				done = true;
-			} else {
-				next_node = ldns_rbtree_next(next_node);
-			}
 		}
+		ldns_buffer_write(ctx->sign_buf, k->rdata, k->rdata_size);
+		ldns_buffer_write(ctx->sign_buf, ldns_buffer_begin(rrs),
+				ldns_buffer_position(rrs));
+#ifdef HAVE_EVP_MD_CTX_NEW
+		EVP_MD_CTX_reset(ctx->md_ctx);
+#else
+		EVP_MD_CTX_cleanup(ctx->md_ctx);
+		EVP_MD_CTX_init(ctx->md_ctx);
+#endif
+		r = EVP_DigestSignInit(ctx->md_ctx, NULL, NULL, NULL,
+				k->evp_key);
+		if (r == 1) {
+			r = EVP_DigestSign(ctx->md_ctx, (unsigned char*)
+					ldns_buffer_begin(ctx->sig), &siglen,
+					(unsigned char*)
+					ldns_buffer_begin(ctx->sign_buf),
+					ldns_buffer_position(ctx->sign_buf));
+		}
+#else
+		r = 0;
+#endif
 	}
-	return next_node;
+	if (r != 1) {
+		return NULL;
+	}
+	return ldns_evp_sig2rdf(ctx->sig, (unsigned int)siglen, k->sig_kind);
 }
 
-ldns_status
-ldns_dnssec_zone_create_nsecs(ldns_dnssec_zone *zone,
-                              ldns_rr_list *new_rrs)
+/* Takes the signature from the cache, or makes it and stores it there */
+static ldns_rdf *
+ldns_sign_ctx_sign(ldns_sign_ctx *ctx, ldns_sign_ctx_key *k,
+		const ldns_buffer *rrs)
 {
+	uint8_t digest[LDNS_SHA256_DIGEST_LENGTH];
+	ldns_rdf *sig;
 
-	ldns_rbnode_t *first_node, *cur_node, *next_node;
-	ldns_dnssec_name *cur_name, *next_name;
-	ldns_rr *nsec_rr;
-	uint32_t nsec_ttl;
-	ldns_dnssec_rrsets *soa;
-
-	/* The TTL value for any NSEC RR SHOULD be the same TTL value as the
-	 * lesser of the MINIMUM field of the SOA record and the TTL of the SOA
-	 * itself. This matches the definition of the TTL for negative
-	 * responses in [RFC2308]. (draft-ietf-dnsop-nsec-ttl-01 update of
-	 * RFC4035 Section 2.3)
-	 */
-	soa = ldns_dnssec_name_find_rrset(zone->soa, LDNS_RR_TYPE_SOA);
-
-	/* did the caller actually set it? if not,
-	 * fall back to default ttl
-	 */
-	if (soa && soa->rrs && soa->rrs->rr) {
-		ldns_rr  *soa_rr  = soa->rrs->rr;
-		ldns_rdf *min_rdf = ldns_rr_rdf(soa_rr, 6);
-
-		nsec_ttl = min_rdf == NULL
-		       || ldns_rr_ttl(soa_rr) < ldns_rdf2native_int32(min_rdf)
-		        ? ldns_rr_ttl(soa_rr) : ldns_rdf2native_int32(min_rdf);
-	} else {
-		nsec_ttl = LDNS_DEFAULT_TTL;
+	if (!ctx->cache) {
+		return ldns_sign_ctx_sign_evp(ctx, k, rrs);
 	}
-
-	first_node = ldns_dnssec_name_node_next_nonglue(
-			       ldns_rbtree_first(zone->names));
-	cur_node = first_node;
-	if (cur_node) {
-		next_node = ldns_dnssec_name_node_next_nonglue(
-			           ldns_rbtree_next(cur_node));
-	} else {
-		next_node = NULL;
+	if (!ldns_sign_ctx_digest(k, rrs, digest)) {
+		return NULL;
 	}
-
-	while (cur_node && next_node) {
-		cur_name = (ldns_dnssec_name *)cur_node->data;
-		next_name = (ldns_dnssec_name *)next_node->data;
-		nsec_rr = ldns_dnssec_create_nsec(cur_name,
-		                                  next_name,
-		                                  LDNS_RR_TYPE_NSEC);
-		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
-		if(ldns_dnssec_name_add_rr(cur_name, nsec_rr)!=LDNS_STATUS_OK){
-			ldns_rr_free(nsec_rr);
-			return LDNS_STATUS_ERR;
-		}
-		ldns_rr_list_push_rr(new_rrs, nsec_rr);
-		cur_node = next_node;
-		if (cur_node) {
-			next_node = ldns_dnssec_name_node_next_nonglue(
-                               ldns_rbtree_next(cur_node));
-		}
+	if ((sig = ldns_sign_cache_lookup(ctx->cache, digest))) {
+		return sig;
+	}
+	if ((sig = ldns_sign_ctx_sign_evp(ctx, k, rrs))
+	&&  ldns_sign_cache_store(ctx->cache, digest, sig) != LDNS_STATUS_OK) {
+		ldns_rdf_deep_free(sig);
+		return NULL;
 	}
+	return sig;
+}
 
-	if (cur_node && !next_node) {
-		cur_name = (ldns_dnssec_name *)cur_node->data;
-		next_name = (ldns_dnssec_name *)first_node->data;
-		nsec_rr = ldns_dnssec_create_nsec(cur_name,
-		                                  next_name,
-		                                  LDNS_RR_TYPE_NSEC);
-		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
-		if(ldns_dnssec_name_add_rr(cur_name, nsec_rr)!=LDNS_STATUS_OK){
-			ldns_rr_free(nsec_rr);
-			return LDNS_STATUS_ERR;
+/* Makes the RRSIG of an RRset from the rdata of the key and the signature,
+ * which it takes
+ */
+static ldns_rr *
+ldns_sign_ctx_rrsig(const ldns_sign_ctx_key *k, const ldns_rr *first,
+		ldns_rdf *sig)
+{
+	/* the types and sizes of the rdata fields before the signature */
+	static const struct {
+		ldns_rdf_type type;
+		size_t size;
+	} fields[] = {
+		{ LDNS_RDF_TYPE_TYPE, 2 }, { LDNS_RDF_TYPE_ALG, 1 },
+		{ LDNS_RDF_TYPE_INT8, 1 }, { LDNS_RDF_TYPE_INT32, 4 },
+		{ LDNS_RDF_TYPE_TIME, 4 }, { LDNS_RDF_TYPE_TIME, 4 },
+		{ LDNS_RDF_TYPE_INT16, 2 }, { LDNS_RDF_TYPE_DNAME, 0 }
+	};
+	ldns_rr *rrsig;
+	ldns_rdf *rdf;
+	size_t i, pos;
+
+	if (!(rrsig = ldns_rr_new_frm_type(LDNS_RR_TYPE_RRSIG))) {
+		ldns_rdf_deep_free(sig);
+		return NULL;
+	}
+	(void) ldns_rr_set_rdf(rrsig, sig, 8);
+	ldns_rr_set_ttl(rrsig, ldns_rr_ttl(first));
+	ldns_rr_set_class(rrsig, ldns_rr_get_class(first));
+	if (!(rdf = ldns_rdf_clone(ldns_rr_owner(first)))) {
+		ldns_rr_free(rrsig);
+		return NULL;
+	}
+	ldns_dname2canonical(rdf);
+	ldns_rr_set_owner(rrsig, rdf);
+	for (i = 0, pos = 0; i < 8; pos += fields[i++].size) {
+		if (!(rdf = ldns_rdf_new_frm_data(fields[i].type,
+				fields[i].size ? fields[i].size
+				               : k->rdata_size - pos,
+				k->rdata + pos))) {
+			ldns_rr_free(rrsig);
+			return NULL;
 		}
-		ldns_rr_list_push_rr(new_rrs, nsec_rr);
-	} else {
-		printf("error\n");
+		(void) ldns_rr_set_rdf(rrsig, rdf, i);
 	}
-
-	return LDNS_STATUS_OK;
+	return rrsig;
 }
 
-#ifdef HAVE_SSL
 static void
-ldns_hashed_names_node_free(ldns_rbnode_t *node, void *arg) {
-	(void) arg;
-	LDNS_FREE(node);
+ldns_sign_ctx_pending_free(ldns_sign_ctx_pending *p)
+{
+	ldns_buffer_free(p->request.data);
+	ldns_rdf_deep_free(p->request.sig);
+	LDNS_FREE(p);
 }
 
-static ldns_status
-ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
-		ldns_rr_list *new_rrs,
-		uint8_t algorithm,
-		uint8_t flags,
-		uint16_t iterations,
-		uint8_t salt_length,
-		uint8_t *salt,
-		ldns_rbtree_t **map)
+/* Submits the requests that are not submitted yet to the backend, in
+ * batches. The requests of a batch that is refused keep its error.
+ */
+static void
+ldns_sign_ctx_submit(ldns_sign_ctx *ctx)
 {
-	ldns_rbnode_t *first_name_node;
-	ldns_rbnode_t *current_name_node;
-	ldns_dnssec_name *current_name;
-	ldns_status result = LDNS_STATUS_OK;
-	ldns_rr *nsec_rr;
-	ldns_rr_list *nsec3_list;
-	uint32_t nsec_ttl;
-	ldns_dnssec_rrsets *soa;
-	ldns_rbnode_t *hashmap_node;
+	ldns_sign_request *batch[LDNS_SIGN_CTX_BATCH];
+	size_t i, n;
+	ldns_status s;
 
-	if (!zone || !new_rrs || !zone->names) {
-		return LDNS_STATUS_ERR;
+	while (ctx->submitted < ctx->pending_count) {
+		n = ctx->pending_count - ctx->submitted;
+		if (n > LDNS_SIGN_CTX_BATCH) {
+			n = LDNS_SIGN_CTX_BATCH;
+		}
+		for (i = 0; i < n; i++) {
+			batch[i] = &ctx->pending[ctx->submitted + i]->request;
+		}
+		if ((s = ldns_sign_backend_submit(ctx->backend, batch, n))) {
+			for (i = 0; i < n; i++) {
+				batch[i]->status = s;
+			}
+		}
+		ctx->submitted += n;
 	}
+}
 
-	/* The TTL value for any NSEC RR SHOULD be the same TTL value as the
-	 * lesser of the MINIMUM field of the SOA record and the TTL of the SOA
-	 * itself. This matches the definition of the TTL for negative
-	 * responses in [RFC2308]. (draft-ietf-dnsop-nsec-ttl-01 update of
-	 * RFC4035 Section 2.3)
-	 */
-	soa = ldns_dnssec_name_find_rrset(zone->soa, LDNS_RR_TYPE_SOA);
+/* The size of the signatures of a key in the RRSIG rdata */
+static size_t
+ldns_sign_ctx_key_sig_size(const ldns_sign_ctx_key *k)
+{
+	/* DSA has T, R and S; ECDSA R and S of the same size */
+	return k->sig_kind == -1 ? 41
+	     : k->sig_kind > 0 ? 2 * (size_t)k->sig_kind : k->sig_size;
+}
 
-	/* did the caller actually set it? if not,
-	 * fall back to default ttl
-	 */
-	if (soa && soa->rrs && soa->rrs->rr) {
-		ldns_rr  *soa_rr  = soa->rrs->rr;
-		ldns_rdf *min_rdf = ldns_rr_rdf(soa_rr, 6);
+/* Makes an RRSIG of which the backend is asked for the signature, or with
+ * the signature from the cache. Until the signature is made, the RRSIG
+ * has one of zeros of its size, so that it sorts among the other RRSIGs
+ * of the RRset like it will with the signature.
+ */
+static ldns_rr *
+ldns_sign_ctx_queue(ldns_sign_ctx *ctx, ldns_key *key, ldns_sign_ctx_key *k,
+		const ldns_rr *first, const ldns_buffer *rrs)
+{
+	ldns_sign_ctx_pending *p, **pending;
+	ldns_rdf *sig;
+	uint8_t *zeros;
+	ldns_status s;
 
-		nsec_ttl = min_rdf == NULL
-		       || ldns_rr_ttl(soa_rr) < ldns_rdf2native_int32(min_rdf)
-		        ? ldns_rr_ttl(soa_rr) : ldns_rdf2native_int32(min_rdf);
-	} else {
-		nsec_ttl = LDNS_DEFAULT_TTL;
+	if (ctx->pending_count >= LDNS_SIGN_CTX_MAX_PENDING
+	&&  (s = ldns_sign_ctx_wait(ctx))) {
+		/* for the next ldns_sign_ctx_wait() */
+		ctx->status = s;
+		return NULL;
 	}
-
-	if (ldns_rdf_size(zone->soa->name) > 222) {
-		return LDNS_STATUS_NSEC3_DOMAINNAME_OVERFLOW;
+	if (ctx->pending_count == ctx->pending_capacity) {
+		pending = LDNS_XREALLOC(ctx->pending, ldns_sign_ctx_pending *,
+				ctx->pending_capacity * 2 + 64);
+		if (!pending) {
+			return NULL;
+		}
+		ctx->pending = pending;
+		ctx->pending_capacity = ctx->pending_capacity * 2 + 64;
 	}
-
-	if (zone->hashed_names) {
-		ldns_traverse_postorder(zone->hashed_names,
-				ldns_hashed_names_node_free, NULL);
-		LDNS_FREE(zone->hashed_names);
+	if (!(p = LDNS_CALLOC(ldns_sign_ctx_pending, 1))) {
+		return NULL;
 	}
-	zone->hashed_names = ldns_rbtree_create(ldns_dname_compare_v);
-	if (zone->hashed_names && map) {
-		*map = zone->hashed_names;
+	if (ctx->cache) {
+		if (!ldns_sign_ctx_digest(k, rrs, p->digest)) {
+			LDNS_FREE(p);
+			return NULL;
+		}
+		if ((sig = ldns_sign_cache_lookup(ctx->cache, p->digest))) {
+			LDNS_FREE(p);
+			return ldns_sign_ctx_rrsig(k, first, sig);
+		}
+		p->has_digest = true;
 	}
+	p->request.key = key;
+	p->request.status = LDNS_STATUS_ERR;
+	if (!(p->request.data = ldns_buffer_new(
+				k->rdata_size + ldns_buffer_position(rrs)))
+	||  !(zeros = LDNS_CALLOC(uint8_t, ldns_sign_ctx_key_sig_size(k)))) {
+		ldns_sign_ctx_pending_free(p);
+		return NULL;
+	}
+	if (!(sig = ldns_rdf_new(LDNS_RDF_TYPE_B64,
+				ldns_sign_ctx_key_sig_size(k), zeros))) {
+		LDNS_FREE(zeros);
+		ldns_sign_ctx_pending_free(p);
+		return NULL;
+	}
+	if (!(p->rrsig = ldns_sign_ctx_rrsig(k, first, sig))) {
+		ldns_sign_ctx_pending_free(p);
+		return NULL;
+	}
+	ldns_buffer_write(p->request.data, k->rdata, k->rdata_size);
+	ldns_buffer_write(p->request.data, ldns_buffer_begin(rrs),
+			ldns_buffer_position(rrs));
+	ctx->pending[ctx->pending_count++] = p;
+	if (ctx->pending_count - ctx->submitted >= LDNS_SIGN_CTX_BATCH) {
+		ldns_sign_ctx_submit(ctx);
+	}
+	return p->rrsig;
+}
 
-	first_name_node = ldns_dnssec_name_node_next_nonglue(
-					  ldns_rbtree_first(zone->names));
-
-	current_name_node = first_name_node;
+/* Forgets an RRSIG that is freed before it is signed, which is one of the
+ * last ones that were queued
+ */
+static void
+ldns_sign_ctx_forget(ldns_sign_ctx *ctx, const ldns_rr *rrsig, size_t last)
+{
+	size_t i;
 
-	while (current_name_node && current_name_node != LDNS_RBTREE_NULL &&
-			result == LDNS_STATUS_OK) {
-
-		current_name = (ldns_dnssec_name *) current_name_node->data;
-		nsec_rr = ldns_dnssec_create_nsec3(current_name,
-		                                   NULL,
-		                                   zone->soa->name,
-		                                   algorithm,
-		                                   flags,
-		                                   iterations,
-		                                   salt_length,
-		                                   salt);
-		/* by default, our nsec based generator adds rrsigs
-		 * remove the bitmap for empty nonterminals */
-		if (!current_name->rrsets) {
-			ldns_rdf_deep_free(ldns_rr_pop_rdf(nsec_rr));
+	for (i = ctx->pending_count; i > 0 && last > 0; i--, last--) {
+		if (ctx->pending[i - 1]->rrsig == rrsig) {
+			ctx->pending[i - 1]->rrsig = NULL;
+			return;
 		}
-		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
-		result = ldns_dnssec_name_add_rr(current_name, nsec_rr);
-		ldns_rr_list_push_rr(new_rrs, nsec_rr);
-		if (ldns_rr_owner(nsec_rr)) {
-			hashmap_node = LDNS_MALLOC(ldns_rbnode_t);
-			if (hashmap_node == NULL) {
-				return LDNS_STATUS_MEM_ERR;
-			}
-			current_name->hashed_name = 
-				ldns_dname_label(ldns_rr_owner(nsec_rr), 0);
+	}
+}
 
-			if (current_name->hashed_name == NULL) {
-				LDNS_FREE(hashmap_node);
-				return LDNS_STATUS_MEM_ERR;
-			}
-			hashmap_node->key  = current_name->hashed_name;
-			hashmap_node->data = current_name;
+ldns_sign_ctx *
+ldns_sign_ctx_new(void)
+{
+	ldns_sign_ctx *ctx = LDNS_CALLOC(ldns_sign_ctx, 1);
 
-			if (! ldns_rbtree_insert(zone->hashed_names
-						, hashmap_node)) {
-				LDNS_FREE(hashmap_node);
-			}
-		}
-		current_name_node = ldns_dnssec_name_node_next_nonglue(
-		                   ldns_rbtree_next(current_name_node));
+	if (!ctx) {
+		return NULL;
 	}
-	if (result != LDNS_STATUS_OK) {
-		return result;
+	if (!(ctx->rrs = ldns_buffer_new(LDNS_MIN_BUFLEN))
+	||  !(ctx->sorted = ldns_buffer_new(LDNS_MIN_BUFLEN))
+	||  !(ctx->sign_buf = ldns_buffer_new(LDNS_MIN_BUFLEN))
+	||  !(ctx->sig = ldns_buffer_new(LDNS_MIN_BUFLEN))
+	||  !(ctx->md_ctx = ldns_evp_md_ctx_new())) {
+		ldns_sign_ctx_free(ctx);
+		return NULL;
 	}
+	return ctx;
+}
 
-	/* Make sorted list of nsec3s (via zone->hashed_names)
-	 */
-	nsec3_list = ldns_rr_list_new();
-	if (nsec3_list == NULL) {
-		return LDNS_STATUS_MEM_ERR;
+ldns_rr_list *
+ldns_sign_public_ctx(ldns_sign_ctx *ctx, const ldns_rr_list *rrset,
+		ldns_key_list *keys)
+{
+	ldns_rr_list *signatures;
+	const ldns_rr *first;
+	ldns_buffer *rrs;
+	ldns_key *current_key;
+	ldns_sign_ctx_key *k;
+	ldns_rdf *sig;
+	ldns_rr *rrsig;
+	uint8_t label_count;
+	uint32_t now;
+	size_t i;
+
+	if (!ctx || !rrset || ldns_rr_list_rr_count(rrset) < 1 || !keys) {
+		return NULL;
 	}
-	for ( hashmap_node  = ldns_rbtree_first(zone->hashed_names)
-	    ; hashmap_node != LDNS_RBTREE_NULL
-	    ; hashmap_node  = ldns_rbtree_next(hashmap_node)
-	    ) {
-		nsec_rr = ((ldns_dnssec_name *) hashmap_node->data)->nsec;
-		if (nsec_rr) {
-			ldns_rr_list_push_rr(nsec3_list, nsec_rr);
-		}
+	/* the RRs, canonical, with one TTL and sorted, are written once
+	 * for all keys */
+	if (!(rrs = ldns_sign_ctx_rrset(ctx, rrset))) {
+		return NULL;
 	}
-	result = ldns_dnssec_chain_nsec3_list(nsec3_list);
-	ldns_rr_list_free(nsec3_list);
+	first = ldns_rr_list_rr(rrset, 0);
+	label_count = ldns_dname_label_count(ldns_rr_owner(first));
+        /* RFC4035 2.2: not counting the leftmost label if it is a wildcard */
+	if (ldns_dname_is_wildcard(ldns_rr_owner(first))) {
+		label_count--;
+	}
+	now = (uint32_t)time(NULL);
 
-	return result;
+	if (!(signatures = ldns_rr_list_new())) {
+		return NULL;
+	}
+	for (i = 0; i < ldns_key_list_key_count(keys); i++) {
+		current_key = ldns_key_list_key(keys, i);
+		/* sign all RRs with keys that have ZSKbit, !SEPbit.
+		   sign DNSKEY RRs with keys that have ZSKbit&SEPbit */
+		if (!ldns_key_use(current_key)
+		||  !(ldns_key_flags(current_key) & LDNS_KEY_ZONE_KEY)) {
+			continue;
+		}
+		if (!(k = ldns_sign_ctx_get_key(ctx, current_key))) {
+			goto error;
+		}
+		ldns_write_uint16(k->rdata, ldns_rr_get_type(first));
+		k->rdata[3] = label_count;
+		ldns_write_uint32(k->rdata + 4, ldns_rr_ttl(first));
+		if (k->expiration == 0) {
+			ldns_write_uint32(k->rdata + 8,
+					now + LDNS_DEFAULT_EXP_TIME);
+		}
+		if (k->inception == 0) {
+			ldns_write_uint32(k->rdata + 12, now);
+		}
+		if (ctx->backend) {
+			if (!(rrsig = ldns_sign_ctx_queue(ctx, current_key,
+						k, first, rrs))) {
+				goto error;
+			}
+		} else if (!(sig = ldns_sign_ctx_sign(ctx, k, rrs))
+		       ||  !(rrsig = ldns_sign_ctx_rrsig(k, first, sig))) {
+			goto error;
+		}
+		if (!ldns_rr_list_push_rr(signatures, rrsig)) {
+			ldns_sign_ctx_forget(ctx, rrsig, 1);
+			ldns_rr_free(rrsig);
+			goto error;
+		}
+	}
+	return signatures;
+error:
+	for (i = 0; i < ldns_rr_list_rr_count(signatures); i++) {
+		ldns_sign_ctx_forget(ctx, ldns_rr_list_rr(signatures, i),
+				ldns_rr_list_rr_count(signatures));
+	}
+	ldns_rr_list_deep_free(signatures);
+	return NULL;
 }
 
 ldns_status
-ldns_dnssec_zone_create_nsec3s(ldns_dnssec_zone *zone,
-		ldns_rr_list *new_rrs,
-		uint8_t algorithm,
-		uint8_t flags,
-		uint16_t iterations,
-		uint8_t salt_length,
-		uint8_t *salt)
-{
-	return ldns_dnssec_zone_create_nsec3s_mkmap(zone, new_rrs, algorithm,
-		       	flags, iterations, salt_length, salt, NULL);
-
-}
-#endif /* HAVE_SSL */
-
-ldns_dnssec_rrs *
-ldns_dnssec_remove_signatures( ldns_dnssec_rrs *signatures
-			     , ATTR_UNUSED(ldns_key_list *key_list)
-			     , int (*func)(ldns_rr *, void *)
-			     , void *arg
-			     )
+ldns_sign_ctx_wait(ldns_sign_ctx *ctx)
 {
-	ldns_dnssec_rrs *base_rrs = signatures;
-	ldns_dnssec_rrs *cur_rr = base_rrs;
-	ldns_dnssec_rrs *prev_rr = NULL;
-	ldns_dnssec_rrs *next_rr;
-
-	uint16_t keytag;
+	ldns_sign_ctx_pending *p;
+	ldns_status s;
 	size_t i;
 
-	if (!cur_rr) {
-		switch(func(NULL, arg)) {
-		case LDNS_SIGNATURE_LEAVE_ADD_NEW:
-		case LDNS_SIGNATURE_REMOVE_ADD_NEW:
-		break;
-		case LDNS_SIGNATURE_LEAVE_NO_ADD:
-		case LDNS_SIGNATURE_REMOVE_NO_ADD:
-		ldns_key_list_set_use(key_list, false);
-		break;
-		default:
-#ifdef STDERR_MSGS
-			fprintf(stderr, "[XX] unknown return value from callback\n");
-#endif
-			break;
+	if (!ctx) {
+		return LDNS_STATUS_NULL;
+	}
+	if (ctx->pending_count > 0) {
+		ldns_sign_ctx_submit(ctx);
+		if ((s = ldns_sign_backend_wait(ctx->backend))
+		&&  ctx->status == LDNS_STATUS_OK) {
+			ctx->status = s;
 		}
-		return NULL;
 	}
-	(void)func(cur_rr->rr, arg);
-
-	while (cur_rr) {
-		next_rr = cur_rr->next;
-
-		switch (func(cur_rr->rr, arg)) {
-		case  LDNS_SIGNATURE_LEAVE_ADD_NEW:
-			prev_rr = cur_rr;
-			break;
-		case LDNS_SIGNATURE_LEAVE_NO_ADD:
-			keytag = ldns_rdf2native_int16(
-					   ldns_rr_rrsig_keytag(cur_rr->rr));
-			for (i = 0; i < ldns_key_list_key_count(key_list); i++) {
-				if (ldns_key_keytag(ldns_key_list_key(key_list, i)) ==
-				    keytag) {
-					ldns_key_set_use(ldns_key_list_key(key_list, i),
-								  false);
-				}
-			}
-			prev_rr = cur_rr;
-			break;
-		case LDNS_SIGNATURE_REMOVE_NO_ADD:
-			keytag = ldns_rdf2native_int16(
-					   ldns_rr_rrsig_keytag(cur_rr->rr));
-			for (i = 0; i < ldns_key_list_key_count(key_list); i++) {
-				if (ldns_key_keytag(ldns_key_list_key(key_list, i))
-				    == keytag) {
-					ldns_key_set_use(ldns_key_list_key(key_list, i),
-								  false);
-				}
-			}
-			if (prev_rr) {
-				prev_rr->next = next_rr;
-			} else {
-				base_rrs = next_rr;
-			}
-			LDNS_FREE(cur_rr);
-			break;
-		case LDNS_SIGNATURE_REMOVE_ADD_NEW:
-			if (prev_rr) {
-				prev_rr->next = next_rr;
-			} else {
-				base_rrs = next_rr;
+	for (i = 0; i < ctx->pending_count; i++) {
+		p = ctx->pending[i];
+		if (p->rrsig && p->request.status == LDNS_STATUS_OK
+		&&  p->request.sig) {
+			if (p->has_digest && ctx->cache
+			&&  (s = ldns_sign_cache_store(ctx->cache, p->digest,
+						p->request.sig))
+			&&  ctx->status == LDNS_STATUS_OK) {
+				ctx->status = s;
 			}
-			LDNS_FREE(cur_rr);
-			break;
-		default:
-#ifdef STDERR_MSGS
-			fprintf(stderr, "[XX] unknown return value from callback\n");
-#endif
-			break;
+			ldns_rdf_deep_free(ldns_rr_set_rdf(p->rrsig,
+						p->request.sig, 8));
+			p->request.sig = NULL;
+
+		} else if (p->rrsig && ctx->status == LDNS_STATUS_OK) {
+			ctx->status = p->request.status ? p->request.status
+			                                : LDNS_STATUS_ERR;
 		}
-		cur_rr = next_rr;
+		ldns_sign_ctx_pending_free(p);
 	}
+	ctx->pending_count = 0;
+	ctx->submitted = 0;
+	s = ctx->status;
+	ctx->status = LDNS_STATUS_OK;
+	return s;
+}
 
-	return base_rrs;
+void
+ldns_sign_ctx_set_backend(ldns_sign_ctx *ctx, ldns_sign_backend *backend)
+{
+	if (ctx->pending_count > 0) {
+		/* the error is returned by the next ldns_sign_ctx_wait() */
+		ctx->status = ldns_sign_ctx_wait(ctx);
+	}
+	ctx->backend = backend;
 }
 
-#ifdef HAVE_SSL
-ldns_status
-ldns_dnssec_zone_create_rrsigs(ldns_dnssec_zone *zone,
-                               ldns_rr_list *new_rrs,
-                               ldns_key_list *key_list,
-                               int (*func)(ldns_rr *, void*),
-                               void *arg)
+void
+ldns_sign_ctx_set_cache(ldns_sign_ctx *ctx, ldns_sign_cache *cache)
 {
-	return ldns_dnssec_zone_create_rrsigs_flg(zone, new_rrs, key_list,
-		func, arg, 0);
+	ctx->cache = cache;
 }
 
-/** If there are KSKs use only them and mark ZSKs unused */
-static void
-ldns_key_list_filter_for_dnskey(ldns_key_list *key_list, int flags)
+void
+ldns_sign_ctx_free(ldns_sign_ctx *ctx)
 {
-	bool algos[256]
-#ifndef S_SPLINT_S
-	                = { false }
-#endif
-	                           ;
-	ldns_signing_algorithm saw_ksk = 0;
-	ldns_key *key;
 	size_t i;
 
-	if (!ldns_key_list_key_count(key_list))
+	if (!ctx) {
 		return;
-
-	/* Mark all KSKs */
-	for (i = 0; i < ldns_key_list_key_count(key_list); i++) {
-		key = ldns_key_list_key(key_list, i);
-		if ((ldns_key_flags(key) & LDNS_KEY_SEP_KEY)) {
-			if (!saw_ksk)
-				saw_ksk = ldns_key_algorithm(key);
-			algos[ldns_key_algorithm(key)] = true;
-		}
 	}
-	if (!saw_ksk)
-		return; /* No KSKs means sign using all ZSKs */
-
-	/* Deselect the ZSKs so they do not sign DNSKEY RRs.
-	 * Except with the LDNS_SIGN_WITH_ALL_ALGORITHMS flag, then use it,
-	 * but only if it has an algorithm for which there is no KSK
-	 */
-	for (i =0; i < ldns_key_list_key_count(key_list); i++) {
-		key = ldns_key_list_key(key_list, i);
-		if (!(ldns_key_flags(key) & LDNS_KEY_SEP_KEY)) {
-			/* We have a ZSK.
-			 * Still use it if it has a unique algorithm though!
-			 */
-			if ((flags & LDNS_SIGN_WITH_ALL_ALGORITHMS) &&
-			    !algos[ldns_key_algorithm(key)])
-				algos[ldns_key_algorithm(key)] = true;
-			else
-				ldns_key_set_use(key, 0);
-		}
+	/* the requests are in use by the backend until it is done */
+	if (ctx->submitted > 0) {
+		(void) ldns_sign_backend_wait(ctx->backend);
+	}
+	for (i = 0; i < ctx->pending_count; i++) {
+		ldns_sign_ctx_pending_free(ctx->pending[i]);
+	}
+	LDNS_FREE(ctx->pending);
+	for (i = 0; i < ctx->key_count; i++) {
+		ldns_sign_ctx_key_clear(&ctx->keys[i]);
 	}
+	LDNS_FREE(ctx->keys);
+	LDNS_FREE(ctx->rr_pos);
+	ldns_buffer_free(ctx->rrs);
+	ldns_buffer_free(ctx->sorted);
+	ldns_buffer_free(ctx->sign_buf);
+	ldns_buffer_free(ctx->sig);
+	if (ctx->md_ctx) {
+		EVP_MD_CTX_destroy(ctx->md_ctx);
+	}
+	LDNS_FREE(ctx);
 }
 
-/** If there are no ZSKs use KSKs as ZSK too */
-static void
-ldns_key_list_filter_for_non_dnskey(ldns_key_list *key_list, int flags)
+ldns_rdf *
+ldns_sign_public_rsasha1(ldns_buffer *to_sign, RSA *key)
 {
-	bool algos[256]
-#ifndef S_SPLINT_S
-	                = { false }
-#endif
-	                           ;
-	ldns_signing_algorithm saw_zsk = 0;
-	ldns_key *key;
-	size_t i;
-	
-	if (!ldns_key_list_key_count(key_list))
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned char *sha1_hash;
+	unsigned int siglen;
+	ldns_rdf *sigdata_rdf;
+	ldns_buffer *b64sig;
+	int result;
+
+	siglen = 0;
+	b64sig = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	if (!b64sig) {
+		return NULL;
+	}
+
+	sha1_hash = SHA1((unsigned char*)ldns_buffer_begin(to_sign),
+				  ldns_buffer_position(to_sign), md);
+	if (!sha1_hash) {
+		ldns_buffer_free(b64sig);
+		return NULL;
+	}
+
+	result = RSA_sign(NID_sha1, sha1_hash, SHA_DIGEST_LENGTH,
+				   (unsigned char*)ldns_buffer_begin(b64sig),
+				   &siglen, key);
+	if (result != 1) {
+		ldns_buffer_free(b64sig);
+		return NULL;
+	}
+
+	sigdata_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, siglen, 
+								 ldns_buffer_begin(b64sig));
+	ldns_buffer_free(b64sig); /* can't free this buffer ?? */
+	return sigdata_rdf;
+}
+
+ldns_rdf *
+ldns_sign_public_rsamd5(ldns_buffer *to_sign, RSA *key)
+{
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned char *md5_hash;
+	unsigned int siglen;
+	ldns_rdf *sigdata_rdf;
+	ldns_buffer *b64sig;
+
+	b64sig = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	if (!b64sig) {
+		return NULL;
+	}
+
+	md5_hash = MD5((unsigned char*)ldns_buffer_begin(to_sign),
+				ldns_buffer_position(to_sign), md);
+	if (!md5_hash) {
+		ldns_buffer_free(b64sig);
+		return NULL;
+	}
+
+	RSA_sign(NID_md5, md5_hash, MD5_DIGEST_LENGTH,
+		    (unsigned char*)ldns_buffer_begin(b64sig),
+		    &siglen, key);
+
+	sigdata_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, siglen,
+								 ldns_buffer_begin(b64sig));
+	ldns_buffer_free(b64sig);
+	return sigdata_rdf;
+}
+#endif /* HAVE_SSL */
+
+/**
+ * Pushes all rrs from the rrsets of type A and AAAA on gluelist.
+ */
+static ldns_status
+ldns_dnssec_addresses_on_glue_list(
+		ldns_dnssec_rrsets *cur_rrset,
+		ldns_rr_list *glue_list)
+{
+	ldns_dnssec_rrs *cur_rrs;
+	while (cur_rrset) {
+		if (cur_rrset->type == LDNS_RR_TYPE_A 
+				|| cur_rrset->type == LDNS_RR_TYPE_AAAA) {
+			for (cur_rrs = cur_rrset->rrs; 
+					cur_rrs; 
+					cur_rrs = cur_rrs->next) {
+				if (cur_rrs->rr) {
+					if (!ldns_rr_list_push_rr(glue_list, 
+							cur_rrs->rr)) {
+						return LDNS_STATUS_MEM_ERR; 
+						/* ldns_rr_list_push_rr()
+						 * returns false when unable
+						 * to increase the capacity
+						 * of the ldns_rr_list
+						 */
+					}
+				}
+			}
+		}
+		cur_rrset = cur_rrset->next;
+	}
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_dnssec_zone_mark_and_get_glue(ldns_dnssec_zone *zone, 
+	ldns_rr_list *glue_list)
+{
+	ldns_rbnode_t    *node;
+	ldns_dnssec_name *name;
+	ldns_rdf         *owner;
+	/* The zone cuts and apexes above the current name. The names are
+	 * visited in canonical order, so all names below an entry come
+	 * right after it, and an entry is popped as soon as a name is not
+	 * below it anymore. Names below a cut are occluded, until a SOA
+	 * (an apex) makes them authoritative again.
+	 */
+	struct {
+		ldns_rdf *name;
+		/* When the cut is caused by a delegation, below_delegation
+		 * will be 1. When caused by a DNAME, below_delegation will
+		 * be 0. It is -1 for an apex.
+		 */
+		int below_delegation;
+	} cuts[LDNS_MAX_DOMAINLEN / 2 + 1];
+	size_t n_cuts = 0;
+	bool has_soa;
+	ldns_status s;
+
+	if (!zone || !zone->names) {
+		return LDNS_STATUS_NULL;
+	}
+	for (node = ldns_rbtree_first(zone->names); 
+			node != LDNS_RBTREE_NULL; 
+			node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		owner = ldns_dnssec_name_name(name);
+		has_soa = ldns_dnssec_rrsets_contains_type(
+				name->rrsets, LDNS_RR_TYPE_SOA);
+
+		while (n_cuts > 0 &&
+		       !ldns_dname_is_subdomain(owner, cuts[n_cuts - 1].name)) {
+			n_cuts--;
+		}
+		if (n_cuts > 0 && cuts[n_cuts - 1].below_delegation >= 0
+				&& !has_soa) {
+			/* The name is a subdomain below a zone cut, so it is
+			 * occluded. Unless the name contains a SOA, after
+			 * which we are authoritative again.
+			 */
+			if (cuts[n_cuts - 1].below_delegation && glue_list) {
+				s = ldns_dnssec_addresses_on_glue_list(
+					name->rrsets, glue_list);
+				if (s != LDNS_STATUS_OK) {
+					return s;
+				}
+			}
+			name->is_glue = true; /* Mark occluded name! */
+			continue;
+		}
+		if (n_cuts == sizeof(cuts) / sizeof(*cuts)) {
+			/* cannot happen with names of valid length */
+			continue;
+		}
+
+		/* The node is not below a zone cut. Is it a zone cut itself?
+		 * Everything below a SOA is authoritative of course; Except
+		 * when the name also contains a DNAME :).
+		 */
+		if (ldns_dnssec_rrsets_contains_type(
+				name->rrsets, LDNS_RR_TYPE_NS) && !has_soa) {
+			cuts[n_cuts].name = owner;
+			cuts[n_cuts++].below_delegation = 1;
+			if (glue_list) { /* record glue on the zone cut */
+				s = ldns_dnssec_addresses_on_glue_list(
+					name->rrsets, glue_list);
+				if (s != LDNS_STATUS_OK) {
+					return s;
+				}
+			}
+		} else if (ldns_dnssec_rrsets_contains_type(
+				name->rrsets, LDNS_RR_TYPE_DNAME)) {
+			cuts[n_cuts].name = owner;
+			cuts[n_cuts++].below_delegation = 0;
+		} else if (has_soa && n_cuts > 0) {
+			/* only needed to end the occlusion by a cut above */
+			cuts[n_cuts].name = owner;
+			cuts[n_cuts++].below_delegation = -1;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_dnssec_zone_mark_glue(ldns_dnssec_zone *zone)
+{
+	return ldns_dnssec_zone_mark_and_get_glue(zone, NULL);
+}
+
+ldns_rbnode_t *
+ldns_dnssec_name_node_next_nonglue(ldns_rbnode_t *node)
+{
+	ldns_rbnode_t *next_node = NULL;
+	ldns_dnssec_name *next_name = NULL;
+	bool done = false;
+
+	if (node == LDNS_RBTREE_NULL) {
+		return NULL;
+	}
+	next_node = node;
+	while (!done) {
+		if (next_node == LDNS_RBTREE_NULL) {
+			return NULL;
+		} else {
+			next_name = (ldns_dnssec_name *)next_node->data;
+			if (!next_name->is_glue) {
+				done = true;
+			} else {
+				next_node = ldns_rbtree_next(next_node);
+			}
+		}
+	}
+	return next_node;
+}
+
+ldns_status
+ldns_dnssec_zone_create_nsecs(ldns_dnssec_zone *zone,
+                              ldns_rr_list *new_rrs)
+{
+
+	ldns_rbnode_t *first_node, *cur_node, *next_node;
+	ldns_dnssec_name *cur_name, *next_name;
+	ldns_rr *nsec_rr;
+	uint32_t nsec_ttl;
+	ldns_dnssec_rrsets *soa;
+
+	/* The TTL value for any NSEC RR SHOULD be the same TTL value as the
+	 * lesser of the MINIMUM field of the SOA record and the TTL of the SOA
+	 * itself. This matches the definition of the TTL for negative
+	 * responses in [RFC2308]. (draft-ietf-dnsop-nsec-ttl-01 update of
+	 * RFC4035 Section 2.3)
+	 */
+	soa = ldns_dnssec_name_find_rrset(zone->soa, LDNS_RR_TYPE_SOA);
+
+	/* did the caller actually set it? if not,
+	 * fall back to default ttl
+	 */
+	if (soa && soa->rrs && soa->rrs->rr) {
+		ldns_rr  *soa_rr  = soa->rrs->rr;
+		ldns_rdf *min_rdf = ldns_rr_rdf(soa_rr, 6);
+
+		nsec_ttl = min_rdf == NULL
+		       || ldns_rr_ttl(soa_rr) < ldns_rdf2native_int32(min_rdf)
+		        ? ldns_rr_ttl(soa_rr) : ldns_rdf2native_int32(min_rdf);
+	} else {
+		nsec_ttl = LDNS_DEFAULT_TTL;
+	}
+
+	first_node = ldns_dnssec_name_node_next_nonglue(
+			       ldns_rbtree_first(zone->names));
+	cur_node = first_node;
+	if (cur_node) {
+		next_node = ldns_dnssec_name_node_next_nonglue(
+			           ldns_rbtree_next(cur_node));
+	} else {
+		next_node = NULL;
+	}
+
+	while (cur_node && next_node) {
+		cur_name = (ldns_dnssec_name *)cur_node->data;
+		next_name = (ldns_dnssec_name *)next_node->data;
+		nsec_rr = ldns_dnssec_create_nsec(cur_name,
+		                                  next_name,
+		                                  LDNS_RR_TYPE_NSEC);
+		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
+		if(ldns_dnssec_name_add_rr(cur_name, nsec_rr)!=LDNS_STATUS_OK){
+			ldns_rr_free(nsec_rr);
+			return LDNS_STATUS_ERR;
+		}
+		ldns_rr_list_push_rr(new_rrs, nsec_rr);
+		cur_node = next_node;
+		if (cur_node) {
+			next_node = ldns_dnssec_name_node_next_nonglue(
+                               ldns_rbtree_next(cur_node));
+		}
+	}
+
+	if (cur_node && !next_node) {
+		cur_name = (ldns_dnssec_name *)cur_node->data;
+		next_name = (ldns_dnssec_name *)first_node->data;
+		nsec_rr = ldns_dnssec_create_nsec(cur_name,
+		                                  next_name,
+		                                  LDNS_RR_TYPE_NSEC);
+		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
+		if(ldns_dnssec_name_add_rr(cur_name, nsec_rr)!=LDNS_STATUS_OK){
+			ldns_rr_free(nsec_rr);
+			return LDNS_STATUS_ERR;
+		}
+		ldns_rr_list_push_rr(new_rrs, nsec_rr);
+	} else {
+		printf("error\n");
+	}
+
+	return LDNS_STATUS_OK;
+}
+
+#ifdef HAVE_SSL
+static void
+ldns_hashed_names_node_free(ldns_rbnode_t *node, void *arg) {
+	(void) arg;
+	LDNS_FREE(node);
+}
+
+static ldns_status
+ldns_dnssec_zone_create_nsec3s_mkmap(ldns_dnssec_zone *zone,
+		ldns_rr_list *new_rrs,
+		uint8_t algorithm,
+		uint8_t flags,
+		uint16_t iterations,
+		uint8_t salt_length,
+		uint8_t *salt,
+		ldns_rbtree_t **map)
+{
+	ldns_rbnode_t *first_name_node;
+	ldns_rbnode_t *current_name_node;
+	ldns_dnssec_name *current_name;
+	ldns_status result = LDNS_STATUS_OK;
+	ldns_rr *nsec_rr;
+	ldns_rr_list *nsec3_list;
+	uint32_t nsec_ttl;
+	ldns_dnssec_rrsets *soa;
+	ldns_rbnode_t *hashmap_node;
+
+	if (!zone || !new_rrs || !zone->names) {
+		return LDNS_STATUS_ERR;
+	}
+
+	/* The TTL value for any NSEC RR SHOULD be the same TTL value as the
+	 * lesser of the MINIMUM field of the SOA record and the TTL of the SOA
+	 * itself. This matches the definition of the TTL for negative
+	 * responses in [RFC2308]. (draft-ietf-dnsop-nsec-ttl-01 update of
+	 * RFC4035 Section 2.3)
+	 */
+	soa = ldns_dnssec_name_find_rrset(zone->soa, LDNS_RR_TYPE_SOA);
+
+	/* did the caller actually set it? if not,
+	 * fall back to default ttl
+	 */
+	if (soa && soa->rrs && soa->rrs->rr) {
+		ldns_rr  *soa_rr  = soa->rrs->rr;
+		ldns_rdf *min_rdf = ldns_rr_rdf(soa_rr, 6);
+
+		nsec_ttl = min_rdf == NULL
+		       || ldns_rr_ttl(soa_rr) < ldns_rdf2native_int32(min_rdf)
+		        ? ldns_rr_ttl(soa_rr) : ldns_rdf2native_int32(min_rdf);
+	} else {
+		nsec_ttl = LDNS_DEFAULT_TTL;
+	}
+
+	if (ldns_rdf_size(zone->soa->name) > 222) {
+		return LDNS_STATUS_NSEC3_DOMAINNAME_OVERFLOW;
+	}
+
+	if (zone->hashed_names) {
+		ldns_traverse_postorder(zone->hashed_names,
+				ldns_hashed_names_node_free, NULL);
+		LDNS_FREE(zone->hashed_names);
+	}
+	zone->hashed_names = ldns_rbtree_create(ldns_dname_compare_v);
+	if (zone->hashed_names && map) {
+		*map = zone->hashed_names;
+	}
+
+	first_name_node = ldns_dnssec_name_node_next_nonglue(
+					  ldns_rbtree_first(zone->names));
+
+	current_name_node = first_name_node;
+
+	while (current_name_node && current_name_node != LDNS_RBTREE_NULL &&
+			result == LDNS_STATUS_OK) {
+
+		current_name = (ldns_dnssec_name *) current_name_node->data;
+		nsec_rr = ldns_dnssec_create_nsec3(current_name,
+		                                   NULL,
+		                                   zone->soa->name,
+		                                   algorithm,
+		                                   flags,
+		                                   iterations,
+		                                   salt_length,
+		                                   salt);
+		/* by default, our nsec based generator adds rrsigs
+		 * remove the bitmap for empty nonterminals */
+		if (!current_name->rrsets) {
+			ldns_rdf_deep_free(ldns_rr_pop_rdf(nsec_rr));
+		}
+		ldns_rr_set_ttl(nsec_rr, nsec_ttl);
+		result = ldns_dnssec_name_add_rr(current_name, nsec_rr);
+		ldns_rr_list_push_rr(new_rrs, nsec_rr);
+		if (ldns_rr_owner(nsec_rr)) {
+			hashmap_node = LDNS_MALLOC(ldns_rbnode_t);
+			if (hashmap_node == NULL) {
+				return LDNS_STATUS_MEM_ERR;
+			}
+			current_name->hashed_name = 
+				ldns_dname_label(ldns_rr_owner(nsec_rr), 0);
+
+			if (current_name->hashed_name == NULL) {
+				LDNS_FREE(hashmap_node);
+				return LDNS_STATUS_MEM_ERR;
+			}
+			hashmap_node->key  = current_name->hashed_name;
+			hashmap_node->data = current_name;
+
+			if (! ldns_rbtree_insert(zone->hashed_names
+						, hashmap_node)) {
+				LDNS_FREE(hashmap_node);
+			}
+		}
+		current_name_node = ldns_dnssec_name_node_next_nonglue(
+		                   ldns_rbtree_next(current_name_node));
+	}
+	if (result != LDNS_STATUS_OK) {
+		return result;
+	}
+
+	/* Make sorted list of nsec3s (via zone->hashed_names)
+	 */
+	nsec3_list = ldns_rr_list_new();
+	if (nsec3_list == NULL) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for ( hashmap_node  = ldns_rbtree_first(zone->hashed_names)
+	    ; hashmap_node != LDNS_RBTREE_NULL
+	    ; hashmap_node  = ldns_rbtree_next(hashmap_node)
+	    ) {
+		nsec_rr = ((ldns_dnssec_name *) hashmap_node->data)->nsec;
+		if (nsec_rr) {
+			ldns_rr_list_push_rr(nsec3_list, nsec_rr);
+		}
+	}
+	result = ldns_dnssec_chain_nsec3_list(nsec3_list);
+	ldns_rr_list_free(nsec3_list);
+
+	return result;
+}
+
+ldns_status
+ldns_dnssec_zone_create_nsec3s(ldns_dnssec_zone *zone,
+		ldns_rr_list *new_rrs,
+		uint8_t algorithm,
+		uint8_t flags,
+		uint16_t iterations,
+		uint8_t salt_length,
+		uint8_t *salt)
+{
+	return ldns_dnssec_zone_create_nsec3s_mkmap(zone, new_rrs, algorithm,
+		       	flags, iterations, salt_length, salt, NULL);
+
+}
+#endif /* HAVE_SSL */
+
+ldns_dnssec_rrs *
+ldns_dnssec_remove_signatures( ldns_dnssec_rrs *signatures
+			     , ATTR_UNUSED(ldns_key_list *key_list)
+			     , int (*func)(ldns_rr *, void *)
+			     , void *arg
+			     )
+{
+	ldns_dnssec_rrs *base_rrs = signatures;
+	ldns_dnssec_rrs *cur_rr = base_rrs;
+	ldns_dnssec_rrs *prev_rr = NULL;
+	ldns_dnssec_rrs *next_rr;
+
+	uint16_t keytag;
+	size_t i;
+
+	if (!cur_rr) {
+		switch(func(NULL, arg)) {
+		case LDNS_SIGNATURE_LEAVE_ADD_NEW:
+		case LDNS_SIGNATURE_REMOVE_ADD_NEW:
+		break;
+		case LDNS_SIGNATURE_LEAVE_NO_ADD:
+		case LDNS_SIGNATURE_REMOVE_NO_ADD:
+		ldns_key_list_set_use(key_list, false);
+		break;
+		default:
+#ifdef STDERR_MSGS
+			fprintf(stderr, "[XX] unknown return value from callback\n");
+#endif
+			break;
+		}
+		return NULL;
+	}
+	(void)func(cur_rr->rr, arg);
+
+	while (cur_rr) {
+		next_rr = cur_rr->next;
+
+		switch (func(cur_rr->rr, arg)) {
+		case  LDNS_SIGNATURE_LEAVE_ADD_NEW:
+			prev_rr = cur_rr;
+			break;
+		case LDNS_SIGNATURE_LEAVE_NO_ADD:
+			keytag = ldns_rdf2native_int16(
+					   ldns_rr_rrsig_keytag(cur_rr->rr));
+			for (i = 0; i < ldns_key_list_key_count(key_list); i++) {
+				if (ldns_key_keytag(ldns_key_list_key(key_list, i)) ==
+				    keytag) {
+					ldns_key_set_use(ldns_key_list_key(key_list, i),
+								  false);
+				}
+			}
+			prev_rr = cur_rr;
+			break;
+		case LDNS_SIGNATURE_REMOVE_NO_ADD:
+			keytag = ldns_rdf2native_int16(
+					   ldns_rr_rrsig_keytag(cur_rr->rr));
+			for (i = 0; i < ldns_key_list_key_count(key_list); i++) {
+				if (ldns_key_keytag(ldns_key_list_key(key_list, i))
+				    == keytag) {
+					ldns_key_set_use(ldns_key_list_key(key_list, i),
+								  false);
+				}
+			}
+			if (prev_rr) {
+				prev_rr->next = next_rr;
+			} else {
+				base_rrs = next_rr;
+			}
+			LDNS_FREE(cur_rr);
+			break;
+		case LDNS_SIGNATURE_REMOVE_ADD_NEW:
+			if (prev_rr) {
+				prev_rr->next = next_rr;
+			} else {
+				base_rrs = next_rr;
+			}
+			LDNS_FREE(cur_rr);
+			break;
+		default:
+#ifdef STDERR_MSGS
+			fprintf(stderr, "[XX] unknown return value from callback\n");
+#endif
+			break;
+		}
+		cur_rr = next_rr;
+	}
+
+	return base_rrs;
+}
+
+#ifdef HAVE_SSL
+ldns_status
+ldns_dnssec_zone_create_rrsigs(ldns_dnssec_zone *zone,
+                               ldns_rr_list *new_rrs,
+                               ldns_key_list *key_list,
+                               int (*func)(ldns_rr *, void*),
+                               void *arg)
+{
+	return ldns_dnssec_zone_create_rrsigs_flg(zone, new_rrs, key_list,
+		func, arg, 0);
+}
+
+/** If there are KSKs use only them and mark ZSKs unused */
+static void
+ldns_key_list_filter_for_dnskey(ldns_key_list *key_list, int flags)
+{
+	bool algos[256]
+#ifndef S_SPLINT_S
+	                = { false }
+#endif
+	                           ;
+	ldns_signing_algorithm saw_ksk = 0;
+	ldns_key *key;
+	size_t i;
+
+	if (!ldns_key_list_key_count(key_list))
+		return;
+
+	/* Mark all KSKs */
+	for (i = 0; i < ldns_key_list_key_count(key_list); i++) {
+		key = ldns_key_list_key(key_list, i);
+		if ((ldns_key_flags(key) & LDNS_KEY_SEP_KEY)) {
+			if (!saw_ksk)
+				saw_ksk = ldns_key_algorithm(key);
+			algos[ldns_key_algorithm(key)] = true;
+		}
+	}
+	if (!saw_ksk)
+		return; /* No KSKs means sign using all ZSKs */
+
+	/* Deselect the ZSKs so they do not sign DNSKEY RRs.
+	 * Except with the LDNS_SIGN_WITH_ALL_ALGORITHMS flag, then use it,
+	 * but only if it has an algorithm for which there is no KSK
+	 */
+	for (i =0; i < ldns_key_list_key_count(key_list); i++) {
+		key = ldns_key_list_key(key_list, i);
+		if (!(ldns_key_flags(key) & LDNS_KEY_SEP_KEY)) {
+			/* We have a ZSK.
+			 * Still use it if it has a unique algorithm though!
+			 */
+			if ((flags & LDNS_SIGN_WITH_ALL_ALGORITHMS) &&
+			    !algos[ldns_key_algorithm(key)])
+				algos[ldns_key_algorithm(key)] = true;
+			else
+				ldns_key_set_use(key, 0);
+		}
+	}
+}
+
+/** If there are no ZSKs use KSKs as ZSK too */
+static void
+ldns_key_list_filter_for_non_dnskey(ldns_key_list *key_list, int flags)
+{
+	bool algos[256]
+#ifndef S_SPLINT_S
+	                = { false }
+#endif
+	                           ;
+	ldns_signing_algorithm saw_zsk = 0;
+	ldns_key *key;
+	size_t i;
+	
+	if (!ldns_key_list_key_count(key_list))
 		return;
 
 	/* Mark all ZSKs */
@@ -1214,31 +1936,176 @@ ldns_key_list_filter_for_non_dnskey(ldns_key_list *key_list, int flags)
 	}
 }
 
+/* Signs the RRsets and the NSEC(3) of a name that is not glue */
+static ldns_status
+ldns_dnssec_name_create_rrsigs_flg( ldns_sign_ctx *sign_ctx
+				  , ldns_dnssec_name *cur_name
+				  , ldns_rr_list *new_rrs
+				  , ldns_key_list *key_list
+				  , int (*func)(ldns_rr *, void*)
+				  , void *arg
+				  , int flags
+				  )
+{
+	ldns_status result = LDNS_STATUS_OK;
+
+	ldns_rr_list *rr_list;
+
+	ldns_dnssec_rrsets *cur_rrset;
+	ldns_dnssec_rrs *cur_rr;
+
+	ldns_rr_list *siglist;
+
+	size_t i;
+
+	int on_delegation_point = 0; /* handle partially occluded names */
+
+	on_delegation_point = ldns_dnssec_rrsets_contains_type(
+			cur_name->rrsets, LDNS_RR_TYPE_NS)
+		&& !ldns_dnssec_rrsets_contains_type(
+			cur_name->rrsets, LDNS_RR_TYPE_SOA);
+	cur_rrset = cur_name->rrsets;
+	while (cur_rrset) {
+		/* reset keys to use */
+		ldns_key_list_set_use(key_list, true);
+
+		/* walk through old sigs, remove the old,
+		   and mark which keys (not) to use) */
+		cur_rrset->signatures =
+			ldns_dnssec_remove_signatures(cur_rrset->signatures,
+									key_list,
+									func,
+									arg);
+		if(cur_rrset->type == LDNS_RR_TYPE_DNSKEY ||
+		   cur_rrset->type == LDNS_RR_TYPE_CDNSKEY ||
+		   cur_rrset->type == LDNS_RR_TYPE_CDS) {
+			if(!(flags&LDNS_SIGN_DNSKEY_WITH_ZSK)) {
+				ldns_key_list_filter_for_dnskey(key_list, flags);
+			}
+		} else {
+			ldns_key_list_filter_for_non_dnskey(key_list, flags);
+		}
+
+		/* TODO: just set count to zero? */
+		rr_list = ldns_rr_list_new();
+
+		cur_rr = cur_rrset->rrs;
+		while (cur_rr) {
+			ldns_rr_list_push_rr(rr_list, cur_rr->rr);
+			cur_rr = cur_rr->next;
+		}
+
+		/* only sign non-delegation RRsets */
+		/* (glue should have been marked earlier, 
+		 *  except on the delegation points itself) */
+		if (!on_delegation_point ||
+				ldns_rr_list_type(rr_list) 
+					== LDNS_RR_TYPE_DS ||
+				ldns_rr_list_type(rr_list) 
+					== LDNS_RR_TYPE_NSEC ||
+				ldns_rr_list_type(rr_list) 
+					== LDNS_RR_TYPE_NSEC3) {
+			siglist = ldns_sign_public_ctx(sign_ctx, rr_list, key_list);
+			for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
+				if (cur_rrset->signatures) {
+					result = ldns_dnssec_rrs_add_rr(cur_rrset->signatures,
+									   ldns_rr_list_rr(siglist,
+												    i));
+				} else {
+					cur_rrset->signatures = ldns_dnssec_rrs_new();
+					cur_rrset->signatures->rr =
+						ldns_rr_list_rr(siglist, i);
+				}
+				if (new_rrs) {
+					ldns_rr_list_push_rr(new_rrs,
+										 ldns_rr_list_rr(siglist,
+													  i));
+				}
+			}
+			ldns_rr_list_free(siglist);
+		}
+
+		ldns_rr_list_free(rr_list);
+
+		cur_rrset = cur_rrset->next;
+	}
+
+	if (!cur_name->nsec) {
+		return result;
+	}
+
+	/* sign the nsec */
+	ldns_key_list_set_use(key_list, true);
+	cur_name->nsec_signatures =
+		ldns_dnssec_remove_signatures(cur_name->nsec_signatures,
+								key_list,
+								func,
+								arg);
+	ldns_key_list_filter_for_non_dnskey(key_list, flags);
+
+	rr_list = ldns_rr_list_new();
+	ldns_rr_list_push_rr(rr_list, cur_name->nsec);
+	siglist = ldns_sign_public_ctx(sign_ctx, rr_list, key_list);
+
+	for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
+		if (cur_name->nsec_signatures) {
+			result = ldns_dnssec_rrs_add_rr(cur_name->nsec_signatures,
+							   ldns_rr_list_rr(siglist, i));
+		} else {
+			cur_name->nsec_signatures = ldns_dnssec_rrs_new();
+			cur_name->nsec_signatures->rr =
+				ldns_rr_list_rr(siglist, i);
+		}
+		if (new_rrs) {
+			ldns_rr_list_push_rr(new_rrs,
+						 ldns_rr_list_rr(siglist, i));
+		}
+	}
+
+	ldns_rr_list_free(siglist);
+	ldns_rr_list_free(rr_list);
+	return result;
+}
+
+ldns_status
+ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
+				  , ldns_rr_list *new_rrs
+				  , ldns_key_list *key_list
+				  , int (*func)(ldns_rr *, void*)
+				  , void *arg
+				  , int flags
+				  )
+{
+	return ldns_dnssec_zone_create_rrsigs_ctx(zone, new_rrs, key_list,
+			func, arg, flags, NULL);
+}
+
 ldns_status
-ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
+ldns_dnssec_zone_create_rrsigs_ctx( ldns_dnssec_zone *zone
 				  , ldns_rr_list *new_rrs
 				  , ldns_key_list *key_list
 				  , int (*func)(ldns_rr *, void*)
 				  , void *arg
 				  , int flags
+				  , ldns_sign_ctx *sign_ctx
 				  )
 {
 	ldns_status result = LDNS_STATUS_OK;
+	ldns_status s;
 
 	ldns_rbnode_t *cur_node;
-	ldns_rr_list *rr_list;
 
 	ldns_dnssec_name *cur_name;
-	ldns_dnssec_rrsets *cur_rrset;
-	ldns_dnssec_rrs *cur_rr;
-
-	ldns_rr_list *siglist;
 
 	size_t i;
 
-	int on_delegation_point = 0; /* handle partially occluded names */
+	ldns_sign_ctx *own_ctx = NULL;
+	ldns_rr_list *pubkey_list;
 
-	ldns_rr_list *pubkey_list = ldns_rr_list_new();
+	if (!sign_ctx && !(sign_ctx = own_ctx = ldns_sign_ctx_new())) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	pubkey_list = ldns_rr_list_new();
 	for (i = 0; i<ldns_key_list_key_count(key_list); i++) {
 		ldns_rr_list_push_rr( pubkey_list
 				    , ldns_key2rr(ldns_key_list_key(
@@ -1252,111 +2119,19 @@ ldns_dnssec_zone_create_rrsigs_flg( ldns_dnssec_zone *zone
 		cur_name = (ldns_dnssec_name *) cur_node->data;
 
 		if (!cur_name->is_glue) {
-			on_delegation_point = ldns_dnssec_rrsets_contains_type(
-					cur_name->rrsets, LDNS_RR_TYPE_NS)
-				&& !ldns_dnssec_rrsets_contains_type(
-					cur_name->rrsets, LDNS_RR_TYPE_SOA);
-			cur_rrset = cur_name->rrsets;
-			while (cur_rrset) {
-				/* reset keys to use */
-				ldns_key_list_set_use(key_list, true);
-
-				/* walk through old sigs, remove the old,
-				   and mark which keys (not) to use) */
-				cur_rrset->signatures =
-					ldns_dnssec_remove_signatures(cur_rrset->signatures,
-											key_list,
-											func,
-											arg);
-				if(cur_rrset->type == LDNS_RR_TYPE_DNSKEY ||
-				   cur_rrset->type == LDNS_RR_TYPE_CDNSKEY ||
-				   cur_rrset->type == LDNS_RR_TYPE_CDS) {
-					if(!(flags&LDNS_SIGN_DNSKEY_WITH_ZSK)) {
-						ldns_key_list_filter_for_dnskey(key_list, flags);
-					}
-				} else {
-					ldns_key_list_filter_for_non_dnskey(key_list, flags);
-				}
-
-				/* TODO: just set count to zero? */
-				rr_list = ldns_rr_list_new();
-
-				cur_rr = cur_rrset->rrs;
-				while (cur_rr) {
-					ldns_rr_list_push_rr(rr_list, cur_rr->rr);
-					cur_rr = cur_rr->next;
-				}
-
-				/* only sign non-delegation RRsets */
-				/* (glue should have been marked earlier, 
-				 *  except on the delegation points itself) */
-				if (!on_delegation_point ||
-						ldns_rr_list_type(rr_list) 
-							== LDNS_RR_TYPE_DS ||
-						ldns_rr_list_type(rr_list) 
-							== LDNS_RR_TYPE_NSEC ||
-						ldns_rr_list_type(rr_list) 
-							== LDNS_RR_TYPE_NSEC3) {
-					siglist = ldns_sign_public(rr_list, key_list);
-					for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
-						if (cur_rrset->signatures) {
-							result = ldns_dnssec_rrs_add_rr(cur_rrset->signatures,
-											   ldns_rr_list_rr(siglist,
-														    i));
-						} else {
-							cur_rrset->signatures = ldns_dnssec_rrs_new();
-							cur_rrset->signatures->rr =
-								ldns_rr_list_rr(siglist, i);
-						}
-						if (new_rrs) {
-							ldns_rr_list_push_rr(new_rrs,
-												 ldns_rr_list_rr(siglist,
-															  i));
-						}
-					}
-					ldns_rr_list_free(siglist);
-				}
-
-				ldns_rr_list_free(rr_list);
-
-				cur_rrset = cur_rrset->next;
-			}
-
-			/* sign the nsec */
-			ldns_key_list_set_use(key_list, true);
-			cur_name->nsec_signatures =
-				ldns_dnssec_remove_signatures(cur_name->nsec_signatures,
-										key_list,
-										func,
-										arg);
-			ldns_key_list_filter_for_non_dnskey(key_list, flags);
-
-			rr_list = ldns_rr_list_new();
-			ldns_rr_list_push_rr(rr_list, cur_name->nsec);
-			siglist = ldns_sign_public(rr_list, key_list);
-
-			for (i = 0; i < ldns_rr_list_rr_count(siglist); i++) {
-				if (cur_name->nsec_signatures) {
-					result = ldns_dnssec_rrs_add_rr(cur_name->nsec_signatures,
-									   ldns_rr_list_rr(siglist, i));
-				} else {
-					cur_name->nsec_signatures = ldns_dnssec_rrs_new();
-					cur_name->nsec_signatures->rr =
-						ldns_rr_list_rr(siglist, i);
-				}
-				if (new_rrs) {
-					ldns_rr_list_push_rr(new_rrs,
-								 ldns_rr_list_rr(siglist, i));
-				}
-			}
-
-			ldns_rr_list_free(siglist);
-			ldns_rr_list_free(rr_list);
+			result = ldns_dnssec_name_create_rrsigs_flg(sign_ctx,
+					cur_name, new_rrs, key_list, func, arg,
+					flags);
 		}
 		cur_node = ldns_rbtree_next(cur_node);
 	}
+	/* the signatures a backend of the context still makes */
+	if ((s = ldns_sign_ctx_wait(sign_ctx)) && result == LDNS_STATUS_OK) {
+		result = s;
+	}
 
 	ldns_rr_list_deep_free(pubkey_list);
+	ldns_sign_ctx_free(own_ctx);
 	return result;
 }
 
@@ -1379,6 +2154,19 @@ ldns_dnssec_zone_sign_flg(ldns_dnssec_zone *zone,
 				  int (*func)(ldns_rr *, void *),
 				  void *arg,
 				  int flags)
+{
+	return ldns_dnssec_zone_sign_ctx(zone, new_rrs, key_list, func, arg,
+			flags, NULL);
+}
+
+ldns_status
+ldns_dnssec_zone_sign_ctx(ldns_dnssec_zone *zone,
+				  ldns_rr_list *new_rrs,
+				  ldns_key_list *key_list,
+				  int (*func)(ldns_rr *, void *),
+				  void *arg,
+				  int flags,
+				  ldns_sign_ctx *sign_ctx)
 {
 	ldns_status result = LDNS_STATUS_OK;
 	ldns_dnssec_rrsets zonemd_rrset;
@@ -1421,12 +2209,13 @@ ldns_dnssec_zone_sign_flg(ldns_dnssec_zone *zone,
 			return result;
 		}
 	}
-	result = ldns_dnssec_zone_create_rrsigs_flg(zone,
+	result = ldns_dnssec_zone_create_rrsigs_ctx(zone,
 					new_rrs,
 					key_list,
 					func,
 					arg,
-					flags);
+					flags,
+					sign_ctx);
 
 	if (zonemd_added) {
 		ldns_dnssec_rrsets **rrsets_ref
@@ -1472,6 +2261,26 @@ ldns_dnssec_zone_sign_nsec3_flg_mkmap(ldns_dnssec_zone *zone,
 		uint8_t *salt,
 		int signflags,
 		ldns_rbtree_t **map)
+{
+	return ldns_dnssec_zone_sign_nsec3_ctx(zone, new_rrs, key_list, func,
+		arg, algorithm, flags, iterations, salt_length, salt,
+		signflags, map, NULL);
+}
+
+ldns_status
+ldns_dnssec_zone_sign_nsec3_ctx(ldns_dnssec_zone *zone,
+		ldns_rr_list *new_rrs,
+		ldns_key_list *key_list,
+		int (*func)(ldns_rr *, void *),
+		void *arg,
+		uint8_t algorithm,
+		uint8_t flags,
+		uint16_t iterations,
+		uint8_t salt_length,
+		uint8_t *salt,
+		int signflags,
+		ldns_rbtree_t **map,
+		ldns_sign_ctx *sign_ctx)
 {
 	ldns_rr *nsec3, *nsec3param;
 	ldns_status result = LDNS_STATUS_OK;
@@ -1557,135 +2366,889 @@ ldns_dnssec_zone_sign_nsec3_flg_mkmap(ldns_dnssec_zone *zone,
 				ldns_dnssec_rrsets **rrsets_ref
 				    = &zone->soa->rrsets;
 
-				while (*rrsets_ref
-				   && (*rrsets_ref)->type < LDNS_RR_TYPE_ZONEMD)
-					rrsets_ref = &(*rrsets_ref)->next;
-				*rrsets_ref = zonemd_rrset.next;
-			}
-			if (result != LDNS_STATUS_OK) {
-				return result;
-			}
+				while (*rrsets_ref
+				   && (*rrsets_ref)->type < LDNS_RR_TYPE_ZONEMD)
+					rrsets_ref = &(*rrsets_ref)->next;
+				*rrsets_ref = zonemd_rrset.next;
+			}
+			if (result != LDNS_STATUS_OK) {
+				return result;
+			}
+		}
+
+		result = ldns_dnssec_zone_create_rrsigs_ctx(zone,
+						new_rrs,
+						key_list,
+						func,
+						arg,
+						signflags,
+						sign_ctx);
+	}
+	if (result || !zone->names)
+		return result;
+
+	return signflags & LDNS_SIGN_WITH_ZONEMD
+	     ? dnssec_zone_equip_zonemd(zone, new_rrs, key_list, signflags)
+	     : result;
+}
+
+ldns_status
+ldns_dnssec_zone_sign_nsec3_flg(ldns_dnssec_zone *zone,
+		ldns_rr_list *new_rrs,
+		ldns_key_list *key_list,
+		int (*func)(ldns_rr *, void *),
+		void *arg,
+		uint8_t algorithm,
+		uint8_t flags,
+		uint16_t iterations,
+		uint8_t salt_length,
+		uint8_t *salt,
+		int signflags)
+{
+	return ldns_dnssec_zone_sign_nsec3_flg_mkmap(zone, new_rrs, key_list,
+		func, arg, algorithm, flags, iterations, salt_length, salt,
+		signflags, NULL);
+}
+
+ldns_zone *
+ldns_zone_sign(const ldns_zone *zone, ldns_key_list *key_list)
+{
+	ldns_dnssec_zone *dnssec_zone;
+	ldns_zone *signed_zone;
+	ldns_rr_list *new_rrs;
+	size_t i;
+
+	signed_zone = ldns_zone_new();
+	dnssec_zone = ldns_dnssec_zone_new();
+
+	(void) ldns_dnssec_zone_add_rr(dnssec_zone, ldns_zone_soa(zone));
+	ldns_zone_set_soa(signed_zone, ldns_rr_clone(ldns_zone_soa(zone)));
+
+	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(zone)); i++) {
+		(void) ldns_dnssec_zone_add_rr(dnssec_zone,
+								 ldns_rr_list_rr(ldns_zone_rrs(zone),
+											  i));
+		ldns_zone_push_rr(signed_zone,
+					   ldns_rr_clone(ldns_rr_list_rr(ldns_zone_rrs(zone),
+											   i)));
+	}
+
+	new_rrs = ldns_rr_list_new();
+	(void) ldns_dnssec_zone_sign(dnssec_zone,
+						    new_rrs,
+						    key_list,
+						    ldns_dnssec_default_replace_signatures,
+						    NULL);
+
+    	for (i = 0; i < ldns_rr_list_rr_count(new_rrs); i++) {
+		ldns_rr_list_push_rr(ldns_zone_rrs(signed_zone),
+						 ldns_rr_clone(ldns_rr_list_rr(new_rrs, i)));
+	}
+
+	ldns_rr_list_deep_free(new_rrs);
+	ldns_dnssec_zone_free(dnssec_zone);
+
+	return signed_zone;
+}
+
+ldns_zone *
+ldns_zone_sign_nsec3(ldns_zone *zone, ldns_key_list *key_list, uint8_t algorithm, uint8_t flags, uint16_t iterations, uint8_t salt_length, uint8_t *salt)
+{
+	ldns_dnssec_zone *dnssec_zone;
+	ldns_zone *signed_zone;
+	ldns_rr_list *new_rrs;
+	size_t i;
+
+	signed_zone = ldns_zone_new();
+	dnssec_zone = ldns_dnssec_zone_new();
+
+	(void) ldns_dnssec_zone_add_rr(dnssec_zone, ldns_zone_soa(zone));
+	ldns_zone_set_soa(signed_zone, ldns_rr_clone(ldns_zone_soa(zone)));
+
+	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(zone)); i++) {
+		(void) ldns_dnssec_zone_add_rr(dnssec_zone,
+								 ldns_rr_list_rr(ldns_zone_rrs(zone),
+											  i));
+		ldns_zone_push_rr(signed_zone, 
+					   ldns_rr_clone(ldns_rr_list_rr(ldns_zone_rrs(zone),
+											   i)));
+	}
+
+	new_rrs = ldns_rr_list_new();
+	(void) ldns_dnssec_zone_sign_nsec3(dnssec_zone,
+								new_rrs,
+								key_list,
+								ldns_dnssec_default_replace_signatures,
+								NULL,
+								algorithm,
+								flags,
+								iterations,
+								salt_length,
+								salt);
+
+    	for (i = 0; i < ldns_rr_list_rr_count(new_rrs); i++) {
+		ldns_rr_list_push_rr(ldns_zone_rrs(signed_zone),
+						 ldns_rr_clone(ldns_rr_list_rr(new_rrs, i)));
+	}
+
+	ldns_rr_list_deep_free(new_rrs);
+	ldns_dnssec_zone_free(dnssec_zone);
+
+	return signed_zone;
+}
+
+/* From dnssec_zone.c and host2str.c, to print the zone while it is signed */
+void _ldns_dnssec_name_print_buf(FILE *out, const ldns_output_format *fmt,
+		const ldns_dnssec_name *name, bool apex, ldns_buffer *buf);
+ldns_buffer *_ldns_print_buffer_new(FILE *output, size_t capacity);
+void _ldns_print_buffer_flush(FILE *output, ldns_buffer *buf);
+void _ldns_print_buffer_free(FILE *output, ldns_buffer *buf);
+void _ldns_rr_print_fmt_buf(FILE *output, const ldns_output_format *fmt,
+		const ldns_rr *rr, ldns_buffer *buf);
+
+/* A name of a zone that is signed one name at a time */
+typedef struct ldns_dnssec_signer_name
+{
+	ldns_dnssec_name *name;
+	/* the RRs of the name, also its NSEC(3) and new signatures */
+	ldns_rr_list *rrs;
+} ldns_dnssec_signer_name;
+
+struct ldns_struct_dnssec_zone_signer
+{
+	FILE *out;
+	const ldns_output_format *fmt;
+	ldns_buffer *buf;
+	ldns_key_list *key_list;
+	int (*func)(ldns_rr *, void *);
+	void *arg;
+	int signflags;
+	ldns_sign_ctx *sign_ctx;
+	ldns_sign_backend *backend;
+	/* no keys and LDNS_SIGN_NO_KEYS_NO_NSECS */
+	bool no_nsecs;
+
+	/* the NSEC3 parameters, and the NSEC3 RRs until they are chained;
+	 * nsec3s is NULL for NSEC
+	 */
+	uint8_t nsec3_algorithm;
+	uint8_t nsec3_flags;
+	uint16_t nsec3_iterations;
+	uint8_t nsec3_salt_length;
+	uint8_t *nsec3_salt;
+	ldns_rr_sorter *nsec3s;
+
+	/* the owner of the SOA of the first name, and the TTL for NSEC(3)s */
+	ldns_rdf *apex;
+	uint32_t nsec_ttl;
+	bool apex_printed;
+
+	/* the name to which RRs are added */
+	ldns_dnssec_signer_name cur;
+
+	/* With NSEC, the last authoritative name and the glue after it,
+	 * which are printed when the next authoritative name is known.
+	 */
+	ldns_dnssec_signer_name *held;
+	size_t held_count;
+	size_t held_capacity;
+
+	/* With NSEC3, the last authoritative name, for the empty
+	 * non-terminals above the next one
+	 */
+	ldns_rdf *last_auth;
+
+	/* The zone cuts and apexes above the current name, like in
+	 * ldns_dnssec_zone_mark_and_get_glue()
+	 */
+	struct {
+		ldns_rdf *name;
+		int below_delegation;
+	} cuts[LDNS_MAX_DOMAINLEN / 2 + 1];
+	size_t n_cuts;
+
+	/* With a backend, the signed names that wait for their signatures
+	 * to be printed, in order. NSEC3s are here as RRs without a name.
+	 */
+	ldns_dnssec_signer_name *done;
+	size_t done_count;
+	size_t done_capacity;
+
+	bool finished;
+};
+
+/* The number of signed names after which the signer waits for the backend
+ * to make their signatures, and prints them
+ */
+#define LDNS_SIGNER_MAX_DONE 4096
+
+ldns_status
+ldns_dnssec_zone_signer_new(ldns_dnssec_zone_signer **signer,
+		FILE *out, const ldns_output_format *fmt,
+		ldns_key_list *key_list,
+		int (*func)(ldns_rr *, void *), void *arg, int signflags)
+{
+	ldns_dnssec_zone_signer *new_signer;
+
+	if (!signer || !out || !key_list || !func) {
+		return LDNS_STATUS_NULL;
+	}
+	if (signflags & LDNS_SIGN_WITH_ZONEMD) {
+		/* the digest is over the whole signed zone */
+		return LDNS_STATUS_NOT_IMPL;
+	}
+	new_signer = LDNS_CALLOC(ldns_dnssec_zone_signer, 1);
+	if (!new_signer) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	new_signer->buf = _ldns_print_buffer_new(out, 2 * LDNS_MAX_PACKETLEN);
+	if (!new_signer->buf) {
+		LDNS_FREE(new_signer);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (!(new_signer->sign_ctx = ldns_sign_ctx_new())) {
+		_ldns_print_buffer_free(out, new_signer->buf);
+		LDNS_FREE(new_signer);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	new_signer->out = out;
+	new_signer->fmt = fmt ? fmt : ldns_output_format_default;
+	new_signer->key_list = key_list;
+	new_signer->func = func;
+	new_signer->arg = arg;
+	new_signer->signflags = signflags;
+	new_signer->no_nsecs = (signflags & LDNS_SIGN_NO_KEYS_NO_NSECS)
+	                    && ldns_key_list_key_count(key_list) < 1;
+	*signer = new_signer;
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_dnssec_zone_signer_set_nsec3(ldns_dnssec_zone_signer *signer,
+		uint8_t algorithm, uint8_t flags, uint16_t iterations,
+		uint8_t salt_length, const uint8_t *salt,
+		size_t max_memory, const char *tmpdir)
+{
+	if (!signer) {
+		return LDNS_STATUS_NULL;
+	}
+	if (signer->nsec3s || signer->cur.name || signer->apex) {
+		return LDNS_STATUS_ERR;
+	}
+	if (salt_length > 0) {
+		signer->nsec3_salt = LDNS_XMALLOC(uint8_t, salt_length);
+		if (!signer->nsec3_salt) {
+			return LDNS_STATUS_MEM_ERR;
+		}
+		memcpy(signer->nsec3_salt, salt, salt_length);
+	}
+	signer->nsec3s = ldns_rr_sorter_new(max_memory, tmpdir);
+	if (!signer->nsec3s) {
+		LDNS_FREE(signer->nsec3_salt);
+		signer->nsec3_salt = NULL;
+		return LDNS_STATUS_MEM_ERR;
+	}
+	signer->nsec3_algorithm = algorithm;
+	signer->nsec3_flags = flags;
+	signer->nsec3_iterations = iterations;
+	signer->nsec3_salt_length = salt_length;
+	return LDNS_STATUS_OK;
+}
+
+static void
+ldns_dnssec_signer_name_free(ldns_dnssec_signer_name *sname)
+{
+	ldns_dnssec_name_free(sname->name);
+	ldns_rr_list_deep_free(sname->rrs);
+	sname->name = NULL;
+	sname->rrs = NULL;
+}
+
+/* Adds an RR that the name owns, or else is still the caller's */
+static ldns_status
+ldns_dnssec_signer_name_add_rr(ldns_dnssec_signer_name *sname, ldns_rr *rr)
+{
+	ldns_status s;
+
+	if ((s = ldns_dnssec_name_add_rr(sname->name, rr))) {
+		return s;
+	}
+	return ldns_rr_list_push_rr(sname->rrs, rr)
+	     ? LDNS_STATUS_OK : LDNS_STATUS_MEM_ERR;
+}
+
+/* Prints a name, or the RRs of an NSEC3 that has no name */
+static void
+ldns_dnssec_zone_signer_print(ldns_dnssec_zone_signer *signer,
+		const ldns_dnssec_signer_name *sname)
+{
+	size_t i;
+
+	if (!sname->name) {
+		for (i = 0; i < ldns_rr_list_rr_count(sname->rrs); i++) {
+			_ldns_rr_print_fmt_buf(signer->out, signer->fmt,
+					ldns_rr_list_rr(sname->rrs, i),
+					signer->buf);
+		}
+		return;
+	}
+	_ldns_dnssec_name_print_buf(signer->out, signer->fmt, sname->name,
+			!signer->apex_printed, signer->buf);
+	signer->apex_printed = true;
+}
+
+/* Waits for the signatures of the names that are done, and prints them */
+static ldns_status
+ldns_dnssec_zone_signer_drain(ldns_dnssec_zone_signer *signer)
+{
+	ldns_status s = ldns_sign_ctx_wait(signer->sign_ctx);
+	size_t i;
+
+	for (i = 0; i < signer->done_count; i++) {
+		if (s == LDNS_STATUS_OK) {
+			ldns_dnssec_zone_signer_print(signer, &signer->done[i]);
 		}
+		ldns_dnssec_signer_name_free(&signer->done[i]);
+	}
+	signer->done_count = 0;
+	return s;
+}
 
-		result = ldns_dnssec_zone_create_rrsigs_flg(zone,
-						new_rrs,
-						key_list,
-						func,
-						arg,
-						signflags);
+/* Prints a signed name and frees it, or with a backend keeps it until the
+ * signatures of a number of names are made.
+ */
+static ldns_status
+ldns_dnssec_zone_signer_emit(ldns_dnssec_zone_signer *signer,
+		ldns_dnssec_signer_name *sname)
+{
+	ldns_dnssec_signer_name *done;
+
+	if (!signer->backend) {
+		ldns_dnssec_zone_signer_print(signer, sname);
+		ldns_dnssec_signer_name_free(sname);
+		return LDNS_STATUS_OK;
 	}
-	if (result || !zone->names)
-		return result;
+	if (signer->done_count == signer->done_capacity) {
+		done = LDNS_XREALLOC(signer->done, ldns_dnssec_signer_name,
+				signer->done_capacity * 2 + 64);
+		if (!done) {
+			ldns_dnssec_signer_name_free(sname);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		signer->done = done;
+		signer->done_capacity = signer->done_capacity * 2 + 64;
+	}
+	signer->done[signer->done_count++] = *sname;
+	return signer->done_count < LDNS_SIGNER_MAX_DONE
+	     ? LDNS_STATUS_OK : ldns_dnssec_zone_signer_drain(signer);
+}
 
-	return signflags & LDNS_SIGN_WITH_ZONEMD
-	     ? dnssec_zone_equip_zonemd(zone, new_rrs, key_list, signflags)
-	     : result;
+static ldns_status
+ldns_dnssec_zone_signer_sign(ldns_dnssec_zone_signer *signer,
+		ldns_dnssec_signer_name *sname)
+{
+	if (sname->name->is_glue) {
+		return LDNS_STATUS_OK;
+	}
+	return ldns_dnssec_name_create_rrsigs_flg(signer->sign_ctx,
+			sname->name, sname->rrs, signer->key_list, signer->func, signer->arg,
+			signer->signflags);
 }
 
-ldns_status
-ldns_dnssec_zone_sign_nsec3_flg(ldns_dnssec_zone *zone,
-		ldns_rr_list *new_rrs,
-		ldns_key_list *key_list,
-		int (*func)(ldns_rr *, void *),
-		void *arg,
-		uint8_t algorithm,
-		uint8_t flags,
-		uint16_t iterations,
-		uint8_t salt_length,
-		uint8_t *salt,
-		int signflags)
+/* The hashed owner name of an NSEC3 RR, as the next hashed owner name of
+ * another one, the way ldns_dnssec_chain_nsec3_list() makes it.
+ */
+static ldns_rdf *
+ldns_nsec3_hashed_owner(const ldns_rr *nsec3)
 {
-	return ldns_dnssec_zone_sign_nsec3_flg_mkmap(zone, new_rrs, key_list,
-		func, arg, algorithm, flags, iterations, salt_length, salt,
-		signflags, NULL);
+	ldns_rdf *label, *hashed = NULL;
+	char *str;
+
+	if (!(label = ldns_dname_label(ldns_rr_owner(nsec3), 0))) {
+		return NULL;
+	}
+	str = ldns_rdf2str(label);
+	ldns_rdf_deep_free(label);
+	if (!str) {
+		return NULL;
+	}
+	if (*str && str[strlen(str) - 1] == '.') {
+		str[strlen(str) - 1] = '\0';
+	}
+	(void) ldns_str2rdf_b32_ext(&hashed, str);
+	LDNS_FREE(str);
+	return hashed;
 }
 
-ldns_zone *
-ldns_zone_sign(const ldns_zone *zone, ldns_key_list *key_list)
+/* Puts the NSEC3 of a name in the sorter, with its own hashed owner name
+ * as next hashed owner name until the chain is made.
+ */
+static ldns_status
+ldns_dnssec_zone_signer_add_nsec3(ldns_dnssec_zone_signer *signer,
+		const ldns_dnssec_name *name)
 {
-	ldns_dnssec_zone *dnssec_zone;
-	ldns_zone *signed_zone;
-	ldns_rr_list *new_rrs;
+	ldns_rr *nsec3;
+	ldns_rdf *hashed;
+	ldns_status s;
+
+	nsec3 = ldns_dnssec_create_nsec3(name, NULL, signer->apex,
+			signer->nsec3_algorithm, signer->nsec3_flags,
+			signer->nsec3_iterations, signer->nsec3_salt_length,
+			signer->nsec3_salt);
+	if (!nsec3) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	/* remove the bitmap for empty nonterminals */
+	if (!name->rrsets) {
+		ldns_rdf_deep_free(ldns_rr_pop_rdf(nsec3));
+	}
+	ldns_rr_set_ttl(nsec3, signer->nsec_ttl);
+	if (!(hashed = ldns_nsec3_hashed_owner(nsec3))) {
+		ldns_rr_free(nsec3);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	ldns_rdf_deep_free(ldns_rr_set_rdf(nsec3, hashed, 4));
+	if ((s = ldns_rr_sorter_add(signer->nsec3s, nsec3))) {
+		ldns_rr_free(nsec3);
+	}
+	return s;
+}
+
+/* Adds the NSEC3s of an authoritative name and of the empty non-terminals
+ * between it and the one before it. The names above the new one that are
+ * not the last name, or above it, are empty non-terminals.
+ */
+static ldns_status
+ldns_dnssec_zone_signer_add_nsec3s(ldns_dnssec_zone_signer *signer,
+		const ldns_dnssec_name *name)
+{
+	ldns_rdf *owner = ldns_dnssec_name_name(name);
+	ldns_dnssec_name ent;
+	uint8_t i, label_count, apex_label_count;
+	ldns_status s;
+
+	label_count = ldns_dname_label_count(owner);
+	apex_label_count = ldns_dname_label_count(signer->apex);
+	memset(&ent, 0, sizeof(ent));
+	for (i = 1; signer->last_auth
+	         && i + apex_label_count < label_count; i++) {
+		if (!(ent.name = ldns_dname_clone_from(owner, i))) {
+			return LDNS_STATUS_MEM_ERR;
+		}
+		if (ldns_dname_compare(ent.name, signer->last_auth) == 0
+		||  ldns_dname_is_subdomain(signer->last_auth, ent.name)) {
+			ldns_rdf_deep_free(ent.name);
+			break;
+		}
+		s = ldns_dnssec_zone_signer_add_nsec3(signer, &ent);
+		ldns_rdf_deep_free(ent.name);
+		if (s != LDNS_STATUS_OK) {
+			return s;
+		}
+	}
+	if ((s = ldns_dnssec_zone_signer_add_nsec3(signer, name))) {
+		return s;
+	}
+	ldns_rdf_deep_free(signer->last_auth);
+	signer->last_auth = ldns_rdf_clone(owner);
+	return signer->last_auth ? LDNS_STATUS_OK : LDNS_STATUS_MEM_ERR;
+}
+
+/* Gives the held names their NSEC, to the next authoritative name, signs
+ * and prints them.
+ */
+static ldns_status
+ldns_dnssec_zone_signer_release(ldns_dnssec_zone_signer *signer,
+		const ldns_dnssec_name *next)
+{
+	ldns_dnssec_signer_name *held = signer->held;
+	ldns_rr *nsec;
 	size_t i;
+	ldns_status s = LDNS_STATUS_OK;
 
-	signed_zone = ldns_zone_new();
-	dnssec_zone = ldns_dnssec_zone_new();
+	if (signer->held_count == 0) {
+		return LDNS_STATUS_OK;
+	}
+	nsec = ldns_dnssec_create_nsec(held[0].name, next, LDNS_RR_TYPE_NSEC);
+	if (!nsec) {
+		s = LDNS_STATUS_MEM_ERR;
+	} else {
+		ldns_rr_set_ttl(nsec, signer->nsec_ttl);
+		if ((s = ldns_dnssec_signer_name_add_rr(&held[0], nsec))) {
+			ldns_rr_free(nsec);
+		}
+	}
+	if (s == LDNS_STATUS_OK) {
+		s = ldns_dnssec_zone_signer_sign(signer, &held[0]);
+	}
+	for (i = 0; i < signer->held_count; i++) {
+		if (s == LDNS_STATUS_OK) {
+			s = ldns_dnssec_zone_signer_emit(signer, &held[i]);
+		} else {
+			ldns_dnssec_signer_name_free(&held[i]);
+		}
+	}
+	signer->held_count = 0;
+	return s;
+}
 
-	(void) ldns_dnssec_zone_add_rr(dnssec_zone, ldns_zone_soa(zone));
-	ldns_zone_set_soa(signed_zone, ldns_rr_clone(ldns_zone_soa(zone)));
+static ldns_status
+ldns_dnssec_zone_signer_hold(ldns_dnssec_zone_signer *signer,
+		ldns_dnssec_signer_name *sname)
+{
+	ldns_dnssec_signer_name *held;
 
-	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(zone)); i++) {
-		(void) ldns_dnssec_zone_add_rr(dnssec_zone,
-								 ldns_rr_list_rr(ldns_zone_rrs(zone),
-											  i));
-		ldns_zone_push_rr(signed_zone,
-					   ldns_rr_clone(ldns_rr_list_rr(ldns_zone_rrs(zone),
-											   i)));
+	if (signer->held_count == signer->held_capacity) {
+		held = LDNS_XREALLOC(signer->held, ldns_dnssec_signer_name,
+				signer->held_capacity * 2 + 4);
+		if (!held) {
+			return LDNS_STATUS_MEM_ERR;
+		}
+		signer->held = held;
+		signer->held_capacity = signer->held_capacity * 2 + 4;
 	}
+	signer->held[signer->held_count++] = *sname;
+	return LDNS_STATUS_OK;
+}
 
-	new_rrs = ldns_rr_list_new();
-	(void) ldns_dnssec_zone_sign(dnssec_zone,
-						    new_rrs,
-						    key_list,
-						    ldns_dnssec_default_replace_signatures,
-						    NULL);
+/* The first name is the apex, which gives the TTL of NSEC(3)s */
+static ldns_status
+ldns_dnssec_zone_signer_set_apex(ldns_dnssec_zone_signer *signer,
+		ldns_dnssec_signer_name *sname)
+{
+	ldns_dnssec_rrsets *soa;
+	ldns_rr *soa_rr, *nsec3param;
+	ldns_rdf *min_rdf;
+	ldns_status s;
 
-    	for (i = 0; i < ldns_rr_list_rr_count(new_rrs); i++) {
-		ldns_rr_list_push_rr(ldns_zone_rrs(signed_zone),
-						 ldns_rr_clone(ldns_rr_list_rr(new_rrs, i)));
+	soa = ldns_dnssec_name_find_rrset(sname->name, LDNS_RR_TYPE_SOA);
+	if (!soa || !soa->rrs || !soa->rrs->rr) {
+		return LDNS_STATUS_NO_SOA;
+	}
+	soa_rr  = soa->rrs->rr;
+	min_rdf = ldns_rr_rdf(soa_rr, 6);
+	signer->nsec_ttl = min_rdf == NULL
+	                || ldns_rr_ttl(soa_rr) < ldns_rdf2native_int32(min_rdf)
+	                 ? ldns_rr_ttl(soa_rr) : ldns_rdf2native_int32(min_rdf);
+	if (!(signer->apex = ldns_rdf_clone(sname->name->name))) {
+		return LDNS_STATUS_MEM_ERR;
 	}
+	if (!signer->nsec3s || signer->no_nsecs) {
+		return LDNS_STATUS_OK;
+	}
+	if (ldns_rdf_size(signer->apex) > 222) {
+		return LDNS_STATUS_NSEC3_DOMAINNAME_OVERFLOW;
+	}
+	if (ldns_dnssec_name_find_rrset(sname->name,
+				LDNS_RR_TYPE_NSEC3PARAM)) {
+		return LDNS_STATUS_OK;
+	}
+	nsec3param = ldns_rr_new_frm_type(LDNS_RR_TYPE_NSEC3PARAM);
+	if (!nsec3param) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	ldns_rr_set_owner(nsec3param, ldns_rdf_clone(signer->apex));
+	ldns_nsec3_add_param_rdfs(nsec3param, signer->nsec3_algorithm,
+			signer->nsec3_flags, signer->nsec3_iterations,
+			signer->nsec3_salt_length, signer->nsec3_salt);
+	/* always set bit 7 of the flags to zero, according to
+	 * rfc5155 section 11. The bits are counted from right to left,
+	 * so bit 7 in rfc5155 is bit 0 in ldns */
+	ldns_set_bit(ldns_rdf_data(ldns_rr_rdf(nsec3param, 1)), 0, 0);
+	if ((s = ldns_dnssec_signer_name_add_rr(sname, nsec3param))) {
+		ldns_rr_free(nsec3param);
+	}
+	return s;
+}
 
-	ldns_rr_list_deep_free(new_rrs);
-	ldns_dnssec_zone_free(dnssec_zone);
+/* All RRs of the current name are added: find out whether it is glue, and
+ * sign and print it, or hold it until its NSEC can be made.
+ */
+static ldns_status
+ldns_dnssec_zone_signer_flush(ldns_dnssec_zone_signer *signer)
+{
+	ldns_dnssec_signer_name sname = signer->cur;
+	ldns_rdf *owner = ldns_dnssec_name_name(sname.name);
+	bool has_soa;
+	int below_delegation = 2;
+	ldns_status s;
 
-	return signed_zone;
+	signer->cur.name = NULL;
+	signer->cur.rrs = NULL;
+	has_soa = ldns_dnssec_rrsets_contains_type(
+			sname.name->rrsets, LDNS_RR_TYPE_SOA);
+	if (!signer->apex &&
+	    (s = ldns_dnssec_zone_signer_set_apex(signer, &sname))) {
+		ldns_dnssec_signer_name_free(&sname);
+		return s;
+	}
+	while (signer->n_cuts > 0 && !ldns_dname_is_subdomain(owner,
+				signer->cuts[signer->n_cuts - 1].name)) {
+		ldns_rdf_deep_free(signer->cuts[--signer->n_cuts].name);
+	}
+	if (signer->n_cuts > 0
+	&&  signer->cuts[signer->n_cuts - 1].below_delegation >= 0
+	&&  !has_soa) {
+		sname.name->is_glue = true;
+
+	} else if (ldns_dnssec_rrsets_contains_type(
+				sname.name->rrsets, LDNS_RR_TYPE_NS)
+	       && !has_soa) {
+		below_delegation = 1;
+
+	} else if (ldns_dnssec_rrsets_contains_type(
+				sname.name->rrsets, LDNS_RR_TYPE_DNAME)) {
+		below_delegation = 0;
+
+	} else if (has_soa && signer->n_cuts > 0) {
+		below_delegation = -1;
+	}
+	if (below_delegation < 2 && signer->n_cuts
+			< sizeof(signer->cuts) / sizeof(*signer->cuts)) {
+		if (!(signer->cuts[signer->n_cuts].name =
+					ldns_rdf_clone(owner))) {
+			ldns_dnssec_signer_name_free(&sname);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		signer->cuts[signer->n_cuts++].below_delegation =
+			below_delegation;
+	}
+
+	if (signer->no_nsecs || signer->nsec3s) {
+		if (signer->nsec3s && !signer->no_nsecs
+		&& !sname.name->is_glue) {
+			s = ldns_dnssec_zone_signer_add_nsec3s(signer,
+					sname.name);
+		} else {
+			s = LDNS_STATUS_OK;
+		}
+		if (s == LDNS_STATUS_OK) {
+			s = ldns_dnssec_zone_signer_sign(signer, &sname);
+		}
+		if (s == LDNS_STATUS_OK) {
+			return ldns_dnssec_zone_signer_emit(signer, &sname);
+		}
+		ldns_dnssec_signer_name_free(&sname);
+		return s;
+	}
+	if (!sname.name->is_glue &&
+	    (s = ldns_dnssec_zone_signer_release(signer, sname.name))) {
+		ldns_dnssec_signer_name_free(&sname);
+		return s;
+	}
+	if ((s = ldns_dnssec_zone_signer_hold(signer, &sname))) {
+		ldns_dnssec_signer_name_free(&sname);
+	}
+	return s;
 }
 
-ldns_zone *
-ldns_zone_sign_nsec3(ldns_zone *zone, ldns_key_list *key_list, uint8_t algorithm, uint8_t flags, uint16_t iterations, uint8_t salt_length, uint8_t *salt)
+ldns_status
+ldns_dnssec_zone_signer_add_rr(ldns_dnssec_zone_signer *signer, ldns_rr *rr)
 {
-	ldns_dnssec_zone *dnssec_zone;
-	ldns_zone *signed_zone;
-	ldns_rr_list *new_rrs;
-	size_t i;
+	ldns_rr_type type;
+	int cmp;
+	ldns_status s;
 
-	signed_zone = ldns_zone_new();
-	dnssec_zone = ldns_dnssec_zone_new();
+	if (!signer || !rr || !ldns_rr_owner(rr)) {
+		return LDNS_STATUS_NULL;
+	}
+	if (signer->finished) {
+		return LDNS_STATUS_ERR;
+	}
+	/* the NSEC(3) chain is made anew */
+	type = ldns_rr_get_type(rr);
+	if (type == LDNS_RR_TYPE_RRSIG && ldns_rr_rrsig_typecovered(rr)) {
+		type = ldns_rdf2rr_type(ldns_rr_rrsig_typecovered(rr));
+	}
+	if (type == LDNS_RR_TYPE_NSEC || type == LDNS_RR_TYPE_NSEC3) {
+		ldns_rr_free(rr);
+		return LDNS_STATUS_OK;
+	}
+	if (signer->cur.name) {
+		cmp = ldns_dname_compare(ldns_rr_owner(rr),
+				ldns_dnssec_name_name(signer->cur.name));
+		if (cmp == 0) {
+			return ldns_dnssec_signer_name_add_rr(
+					&signer->cur, rr);
+		}
+		if (cmp < 0) {
+			return LDNS_STATUS_NOT_CANONICAL_ORDER;
+		}
+		if ((s = ldns_dnssec_zone_signer_flush(signer))) {
+			return s;
+		}
+	}
+	signer->cur.name = ldns_dnssec_name_new();
+	signer->cur.rrs = ldns_rr_list_new();
+	if (!signer->cur.name || !signer->cur.rrs) {
+		ldns_dnssec_signer_name_free(&signer->cur);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	signer->cur.name->name = ldns_rr_owner(rr);
+	if ((s = ldns_dnssec_signer_name_add_rr(&signer->cur, rr))) {
+		signer->cur.name->name = NULL;
+		ldns_dnssec_signer_name_free(&signer->cur);
+	}
+	return s;
+}
 
-	(void) ldns_dnssec_zone_add_rr(dnssec_zone, ldns_zone_soa(zone));
-	ldns_zone_set_soa(signed_zone, ldns_rr_clone(ldns_zone_soa(zone)));
+/* Signs and prints a chained NSEC3, and frees it */
+static ldns_status
+ldns_dnssec_zone_signer_print_nsec3(ldns_dnssec_zone_signer *signer,
+		ldns_rr *nsec3)
+{
+	ldns_dnssec_signer_name sname;
+	ldns_dnssec_name name;
+	ldns_status s;
 
-	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(zone)); i++) {
-		(void) ldns_dnssec_zone_add_rr(dnssec_zone,
-								 ldns_rr_list_rr(ldns_zone_rrs(zone),
-											  i));
-		ldns_zone_push_rr(signed_zone, 
-					   ldns_rr_clone(ldns_rr_list_rr(ldns_zone_rrs(zone),
-											   i)));
+	memset(&name, 0, sizeof(name));
+	name.name = ldns_rr_owner(nsec3);
+	name.nsec = nsec3;
+	sname.name = &name;
+	if (!(sname.rrs = ldns_rr_list_new())) {
+		ldns_rr_free(nsec3);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (!ldns_rr_list_push_rr(sname.rrs, nsec3)) {
+		ldns_rr_list_free(sname.rrs);
+		ldns_rr_free(nsec3);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	s = ldns_dnssec_zone_signer_sign(signer, &sname);
+	/* the RRs are printed without the name */
+	ldns_dnssec_rrs_free(name.nsec_signatures);
+	sname.name = NULL;
+	if (s == LDNS_STATUS_OK) {
+		return ldns_dnssec_zone_signer_emit(signer, &sname);
 	}
+	ldns_rr_list_deep_free(sname.rrs);
+	return s;
+}
 
-	new_rrs = ldns_rr_list_new();
-	(void) ldns_dnssec_zone_sign_nsec3(dnssec_zone,
-								new_rrs,
-								key_list,
-								ldns_dnssec_default_replace_signatures,
-								NULL,
-								algorithm,
-								flags,
-								iterations,
-								salt_length,
-								salt);
+/* Takes the NSEC3s from the sorter in hash order, and gives each the
+ * hashed owner name of the next one, which it has as a placeholder.
+ */
+static ldns_status
+ldns_dnssec_zone_signer_finish_nsec3s(ldns_dnssec_zone_signer *signer)
+{
+	ldns_rr *cur, *next;
+	ldns_rdf *first_hashed, *next_hashed;
+	ldns_status s;
 
-    	for (i = 0; i < ldns_rr_list_rr_count(new_rrs); i++) {
-		ldns_rr_list_push_rr(ldns_zone_rrs(signed_zone),
-						 ldns_rr_clone(ldns_rr_list_rr(new_rrs, i)));
+	if ((s = ldns_rr_sorter_next(signer->nsec3s, &cur)) || !cur) {
+		return s;
+	}
+	if (!(first_hashed = ldns_rdf_clone(ldns_rr_rdf(cur, 4)))) {
+		ldns_rr_free(cur);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	while (cur) {
+		if ((s = ldns_rr_sorter_next(signer->nsec3s, &next))) {
+			ldns_rr_free(cur);
+			break;
+		}
+		if (!next) {
+			next_hashed = first_hashed;
+			first_hashed = NULL;
+		} else if (!(next_hashed = ldns_rdf_clone(
+						ldns_rr_rdf(next, 4)))) {
+			ldns_rr_free(cur);
+			ldns_rr_free(next);
+			s = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+		ldns_rdf_deep_free(ldns_rr_set_rdf(cur, next_hashed, 4));
+		if ((s = ldns_dnssec_zone_signer_print_nsec3(signer, cur))) {
+			ldns_rr_free(next);
+			break;
+		}
+		cur = next;
 	}
+	ldns_rdf_deep_free(first_hashed);
+	return s;
+}
 
-	ldns_rr_list_deep_free(new_rrs);
-	ldns_dnssec_zone_free(dnssec_zone);
+ldns_status
+ldns_dnssec_zone_signer_finish(ldns_dnssec_zone_signer *signer)
+{
+	ldns_dnssec_name apex;
+	ldns_status s = LDNS_STATUS_OK;
 
-	return signed_zone;
+	if (!signer) {
+		return LDNS_STATUS_NULL;
+	}
+	if (signer->finished) {
+		return LDNS_STATUS_ERR;
+	}
+	signer->finished = true;
+	if (signer->cur.name && (s = ldns_dnssec_zone_signer_flush(signer))) {
+		return s;
+	}
+	if (!signer->apex) {
+		return LDNS_STATUS_NO_SOA;
+	}
+	/* the last NSEC is to the apex */
+	memset(&apex, 0, sizeof(apex));
+	apex.name = signer->apex;
+	if ((s = ldns_dnssec_zone_signer_release(signer, &apex))) {
+		return s;
+	}
+	if (signer->nsec3s &&
+	    (s = ldns_dnssec_zone_signer_finish_nsec3s(signer))) {
+		return s;
+	}
+	if (signer->backend && (s = ldns_dnssec_zone_signer_drain(signer))) {
+		return s;
+	}
+	_ldns_print_buffer_flush(signer->out, signer->buf);
+	return fflush(signer->out) == 0 && !ferror(signer->out)
+	     ? LDNS_STATUS_OK : LDNS_STATUS_FILE_ERR;
+}
+
+void
+ldns_dnssec_zone_signer_set_cache(ldns_dnssec_zone_signer *signer,
+		ldns_sign_cache *cache)
+{
+	ldns_sign_ctx_set_cache(signer->sign_ctx, cache);
+}
+
+void
+ldns_dnssec_zone_signer_set_backend(ldns_dnssec_zone_signer *signer,
+		ldns_sign_backend *backend)
+{
+	ldns_sign_ctx_set_backend(signer->sign_ctx, backend);
+	signer->backend = backend;
+}
+
+void
+ldns_dnssec_zone_signer_free(ldns_dnssec_zone_signer *signer)
+{
+	size_t i;
+
+	if (!signer) {
+		return;
+	}
+	ldns_dnssec_signer_name_free(&signer->cur);
+	for (i = 0; i < signer->held_count; i++) {
+		ldns_dnssec_signer_name_free(&signer->held[i]);
+	}
+	LDNS_FREE(signer->held);
+	for (i = 0; i < signer->done_count; i++) {
+		ldns_dnssec_signer_name_free(&signer->done[i]);
+	}
+	LDNS_FREE(signer->done);
+	for (i = 0; i < signer->n_cuts; i++) {
+		ldns_rdf_deep_free(signer->cuts[i].name);
+	}
+	ldns_rdf_deep_free(signer->last_auth);
+	ldns_rdf_deep_free(signer->apex);
+	ldns_rr_sorter_free(signer->nsec3s);
+	LDNS_FREE(signer->nsec3_salt);
+	ldns_sign_ctx_free(signer->sign_ctx);
+	_ldns_print_buffer_free(signer->out, signer->buf);
+	LDNS_FREE(signer);
 }
+
 #endif /* HAVE_SSL */
 
 
@@ -15,6 +15,287 @@
 #include <openssl/err.h>
 #include <openssl/md5.h>
 
+static ldns_status ldns_rrsig_check_timestamps(const ldns_rr* rrsig,
+		time_t now);
+
+/* number of entries a cache holds when no maximum is given */
+#define LDNS_DNSSEC_CACHE_DEFAULT_SIZE 4096
+
+/* cache key prefixes, keeping query answers and verifications apart */
+#define LDNS_DNSSEC_CACHE_QUERY  'Q'
+#define LDNS_DNSSEC_CACHE_VERIFY 'V'
+
+/* resolver settings that are part of a 'Q' key */
+#define LDNS_DNSSEC_CACHE_DO 0x01
+#define LDNS_DNSSEC_CACHE_CD 0x02
+
+/* 'Q' + type + class + flags + DO/CD + nameservers + port + owner name,
+ * or 'V' + sha256 digest */
+#define LDNS_DNSSEC_CACHE_Q_LEN 18
+#define LDNS_DNSSEC_CACHE_KEY_MAX (LDNS_DNSSEC_CACHE_Q_LEN + LDNS_MAX_DOMAINLEN)
+
+typedef struct ldns_dnssec_cache_entry ldns_dnssec_cache_entry;
+struct ldns_dnssec_cache_entry
+{
+	/* place in the least recently used list, with the key */
+	struct _ldns_lru_entry lru;
+	/* node in the lookup tree, its key points to lru */
+	ldns_rbnode_t node;
+	/* absolute time after which the entry is stale */
+	time_t expire;
+	/* the cached answer, NULL for a verification entry */
+	ldns_pkt *pkt;
+	uint8_t key[LDNS_DNSSEC_CACHE_KEY_MAX];
+};
+
+struct ldns_struct_dnssec_cache
+{
+	ldns_rbtree_t *tree;
+	struct _ldns_lru lru;
+	size_t max_entries;
+	/* to make the 'V' keys in, used with the lock held */
+	ldns_buffer *buf;
+	ldns_lock_type lock;
+};
+
+ldns_dnssec_cache *
+ldns_dnssec_cache_new(size_t max_entries)
+{
+	ldns_dnssec_cache *cache = LDNS_CALLOC(ldns_dnssec_cache, 1);
+	if (!cache) {
+		return NULL;
+	}
+	cache->tree = ldns_rbtree_create(_ldns_lru_compare);
+	cache->buf = ldns_buffer_new(LDNS_MIN_BUFLEN);
+	if (!cache->tree || !cache->buf) {
+		ldns_rbtree_free(cache->tree);
+		ldns_buffer_free(cache->buf);
+		LDNS_FREE(cache);
+		return NULL;
+	}
+	cache->max_entries = max_entries ? max_entries
+	                                 : LDNS_DNSSEC_CACHE_DEFAULT_SIZE;
+	ldns_lock_init(&cache->lock);
+	return cache;
+}
+
+static void
+ldns_dnssec_cache_entry_free(ldns_dnssec_cache_entry *entry)
+{
+	ldns_pkt_free(entry->pkt);
+	LDNS_FREE(entry);
+}
+
+void
+ldns_dnssec_cache_free(ldns_dnssec_cache *cache)
+{
+	struct _ldns_lru_entry *entry, *next;
+
+	if (!cache) {
+		return;
+	}
+	for (entry = cache->lru.first; entry; entry = next) {
+		next = entry->next;
+		ldns_dnssec_cache_entry_free((ldns_dnssec_cache_entry *) entry);
+	}
+	ldns_rbtree_free(cache->tree);
+	ldns_buffer_free(cache->buf);
+	ldns_lock_destroy(&cache->lock);
+	LDNS_FREE(cache);
+}
+
+/* the following functions must be called with the cache locked */
+
+static void
+ldns_dnssec_cache_remove(ldns_dnssec_cache *cache,
+		ldns_dnssec_cache_entry *entry)
+{
+	(void) ldns_rbtree_delete(cache->tree, &entry->lru);
+	_ldns_lru_unlink(&cache->lru, &entry->lru);
+	ldns_dnssec_cache_entry_free(entry);
+}
+
+/* Find a fresh entry, dropping it instead when it has expired. */
+static ldns_dnssec_cache_entry *
+ldns_dnssec_cache_lookup(ldns_dnssec_cache *cache,
+		const ldns_dnssec_cache_entry *key, time_t now)
+{
+	ldns_rbnode_t *node = ldns_rbtree_search(cache->tree, &key->lru);
+	ldns_dnssec_cache_entry *entry;
+
+	if (!node) {
+		return NULL;
+	}
+	entry = (ldns_dnssec_cache_entry *) node->data;
+	if (entry->expire <= now) {
+		ldns_dnssec_cache_remove(cache, entry);
+		return NULL;
+	}
+	_ldns_lru_touch(&cache->lru, &entry->lru);
+	return entry;
+}
+
+/* Store key with pkt (which the cache takes over), replacing any older
+ * entry for the same key and evicting the least recently used ones when
+ * the cache is full.
+ */
+static void
+ldns_dnssec_cache_insert(ldns_dnssec_cache *cache,
+		const ldns_dnssec_cache_entry *key, time_t expire, ldns_pkt *pkt)
+{
+	ldns_rbnode_t *node = ldns_rbtree_search(cache->tree, &key->lru);
+	ldns_dnssec_cache_entry *entry;
+
+	if (node) {
+		ldns_dnssec_cache_remove(cache,
+				(ldns_dnssec_cache_entry *) node->data);
+	}
+	while (cache->lru.last && cache->tree->count >= cache->max_entries) {
+		ldns_dnssec_cache_remove(cache,
+				(ldns_dnssec_cache_entry *) cache->lru.last);
+	}
+	entry = LDNS_MALLOC(ldns_dnssec_cache_entry);
+	if (!entry) {
+		ldns_pkt_free(pkt);
+		return;
+	}
+	entry->lru.key_len = key->lru.key_len;
+	entry->lru.key = entry->key;
+	memcpy(entry->key, key->key, key->lru.key_len);
+	entry->expire = expire;
+	entry->pkt = pkt;
+	entry->node.key = &entry->lru;
+	entry->node.data = entry;
+	(void) ldns_rbtree_insert(cache->tree, &entry->node);
+	_ldns_lru_push_front(&cache->lru, &entry->lru);
+}
+
+/* ldns_resolver_query() answered from the cache when possible. Answers
+ * are kept apart by the nameservers, port and DO and CD settings of the
+ * resolver, so that resolvers that ask different servers, or that do
+ * not ask for signatures, can share a cache.
+ */
+static ldns_pkt *
+ldns_dnssec_cache_query(ldns_dnssec_cache *cache, ldns_resolver *res,
+		const ldns_rdf *name, ldns_rr_type t, ldns_rr_class c,
+		uint16_t flags)
+{
+	ldns_dnssec_cache_entry key;
+	ldns_dnssec_cache_entry *entry;
+	ldns_pkt *pkt = NULL;
+	uint64_t ns;
+	uint32_t ttl;
+	time_t now;
+
+	if (!cache || !res || !name ||
+	    ldns_rdf_size(name) > LDNS_MAX_DOMAINLEN ||
+	    ldns_rdf_get_type(name) != LDNS_RDF_TYPE_DNAME) {
+		return ldns_resolver_query(res, name, t, c, flags);
+	}
+	ns = _ldns_resolver_nameservers_hash(res);
+	key.key[0] = LDNS_DNSSEC_CACHE_QUERY;
+	ldns_write_uint16(&key.key[1], (uint16_t) t);
+	ldns_write_uint16(&key.key[3], (uint16_t) c);
+	ldns_write_uint16(&key.key[5], flags);
+	key.key[7] = (ldns_resolver_dnssec(res) ? LDNS_DNSSEC_CACHE_DO : 0)
+	           | (ldns_resolver_dnssec_cd(res) ? LDNS_DNSSEC_CACHE_CD : 0);
+	ldns_write_uint32(&key.key[8], (uint32_t) (ns >> 32));
+	ldns_write_uint32(&key.key[12], (uint32_t) ns);
+	ldns_write_uint16(&key.key[16], ldns_resolver_port(res));
+	_ldns_dname_lower(&key.key[LDNS_DNSSEC_CACHE_Q_LEN],
+			ldns_rdf_data(name), ldns_rdf_size(name));
+	key.lru.key_len = LDNS_DNSSEC_CACHE_Q_LEN + ldns_rdf_size(name);
+	key.lru.key = key.key;
+
+	now = ldns_time(NULL);
+	ldns_lock(&cache->lock);
+	entry = ldns_dnssec_cache_lookup(cache, &key, now);
+	if (entry) {
+		pkt = ldns_pkt_clone(entry->pkt);
+	}
+	ldns_unlock(&cache->lock);
+	if (pkt) {
+		return pkt;
+	}
+
+	/* do not hold the lock while waiting for the network */
+	pkt = ldns_resolver_query(res, name, t, c, flags);
+	if (pkt && (ttl = ldns_pkt_cache_ttl(pkt)) > 0) {
+		ldns_pkt *copy = ldns_pkt_clone(pkt);
+		if (copy) {
+			ldns_lock(&cache->lock);
+			ldns_dnssec_cache_insert(cache, &key,
+					now + (time_t) ttl, copy);
+			ldns_unlock(&cache->lock);
+		}
+	}
+	return pkt;
+}
+
+/* ldns_verify_rrsig_time() remembering successful verifications. A
+ * cached result still has its signature validity period checked against
+ * check_time.
+ */
+static ldns_status
+ldns_dnssec_cache_verify_rrsig_time(ldns_dnssec_cache *cache,
+		ldns_rr_list *rrset, ldns_rr *rrsig, ldns_rr *key,
+		time_t check_time)
+{
+	ldns_dnssec_cache_entry digest;
+	ldns_buffer *buf;
+	ldns_status result;
+	uint32_t ttl;
+	time_t now;
+	size_t i;
+	bool hit;
+
+	if (!cache || !rrset || !rrsig || !key ||
+	    ldns_rr_list_rr_count(rrset) == 0) {
+		return ldns_verify_rrsig_time(rrset, rrsig, key, check_time);
+	}
+	ttl = ldns_rr_ttl(rrsig);
+	if (ldns_rr_ttl(key) < ttl) {
+		ttl = ldns_rr_ttl(key);
+	}
+	now = ldns_time(NULL);
+	ldns_lock(&cache->lock);
+	buf = cache->buf;
+	ldns_buffer_clear(buf);
+	for (i = 0; i < ldns_rr_list_rr_count(rrset); i++) {
+		(void) ldns_rr2buffer_wire_canonical(buf,
+				ldns_rr_list_rr(rrset, i), LDNS_SECTION_ANSWER);
+		if (ldns_rr_ttl(ldns_rr_list_rr(rrset, i)) < ttl) {
+			ttl = ldns_rr_ttl(ldns_rr_list_rr(rrset, i));
+		}
+	}
+	(void) ldns_rr2buffer_wire_canonical(buf, rrsig, LDNS_SECTION_ANSWER);
+	(void) ldns_rr2buffer_wire_canonical(buf, key, LDNS_SECTION_ANSWER);
+	if (ldns_buffer_status(buf) != LDNS_STATUS_OK) {
+		/* out of memory, the buffer may be used again next time */
+		buf->_status = LDNS_STATUS_OK;
+		ldns_unlock(&cache->lock);
+		return ldns_verify_rrsig_time(rrset, rrsig, key, check_time);
+	}
+	digest.key[0] = LDNS_DNSSEC_CACHE_VERIFY;
+	(void) ldns_sha256(ldns_buffer_begin(buf),
+			(unsigned int) ldns_buffer_position(buf), &digest.key[1]);
+	digest.lru.key_len = 1 + LDNS_SHA256_DIGEST_LENGTH;
+	digest.lru.key = digest.key;
+	hit = ldns_dnssec_cache_lookup(cache, &digest, now) != NULL;
+	ldns_unlock(&cache->lock);
+	if (hit) {
+		return ldns_rrsig_check_timestamps(rrsig, check_time);
+	}
+
+	result = ldns_verify_rrsig_time(rrset, rrsig, key, check_time);
+	if (result == LDNS_STATUS_OK && ttl > 0) {
+		ldns_lock(&cache->lock);
+		ldns_dnssec_cache_insert(cache, &digest, now + (time_t) ttl, NULL);
+		ldns_unlock(&cache->lock);
+	}
+	return result;
+}
+
 ldns_dnssec_data_chain *
 ldns_dnssec_data_chain_new(void)
 {
@@ -97,6 +378,7 @@ ldns_dnssec_data_chain_print(FILE *out, const ldns_dnssec_data_chain *chain)
 
 static void
 ldns_dnssec_build_data_chain_dnskey(ldns_resolver *res,
+					    ldns_dnssec_cache *cache,
 					    uint16_t qflags,
 					    const ldns_pkt *pkt,
 					    ldns_rr_list *signatures,
@@ -116,7 +398,7 @@ ldns_dnssec_build_data_chain_dnskey(ldns_resolver *res,
 				 LDNS_SECTION_ANY_NOQUESTION
 			  );
 		if (!keys) {
-			my_pkt = ldns_resolver_query(res,
+			my_pkt = ldns_dnssec_cache_query(cache, res,
 									key_name,
 									LDNS_RR_TYPE_DNSKEY,
 									c,
@@ -128,7 +410,7 @@ ldns_dnssec_build_data_chain_dnskey(ldns_resolver *res,
 					 LDNS_RR_TYPE_DNSKEY,
 					 LDNS_SECTION_ANY_NOQUESTION
 				  );
-			new_chain->parent = ldns_dnssec_build_data_chain(res,
+			new_chain->parent = ldns_dnssec_build_data_chain_cache(res, cache,
 													qflags,
 													keys,
 													my_pkt,
@@ -137,7 +419,7 @@ ldns_dnssec_build_data_chain_dnskey(ldns_resolver *res,
 			ldns_pkt_free(my_pkt);
 			}
 		} else {
-			new_chain->parent = ldns_dnssec_build_data_chain(res,
+			new_chain->parent = ldns_dnssec_build_data_chain_cache(res, cache,
 													qflags,
 													keys,
 													pkt,
@@ -150,6 +432,7 @@ ldns_dnssec_build_data_chain_dnskey(ldns_resolver *res,
 
 static void
 ldns_dnssec_build_data_chain_other(ldns_resolver *res,
+					    ldns_dnssec_cache *cache,
 					    uint16_t qflags,
 						ldns_dnssec_data_chain *new_chain,
 						ldns_rdf *key_name,
@@ -171,7 +454,7 @@ ldns_dnssec_build_data_chain_other(ldns_resolver *res,
 	
 	new_chain->parent_type = 1;
 
-	my_pkt = ldns_resolver_query(res,
+	my_pkt = ldns_dnssec_cache_query(cache, res,
 							key_name,
 							LDNS_RR_TYPE_DS,
 							c,
@@ -183,7 +466,7 @@ ldns_dnssec_build_data_chain_other(ldns_resolver *res,
 									LDNS_SECTION_ANY_NOQUESTION
 									);
 	if (dss) {
-		new_chain->parent = ldns_dnssec_build_data_chain(res,
+		new_chain->parent = ldns_dnssec_build_data_chain_cache(res, cache,
 												qflags,
 												dss,
 												my_pkt,
@@ -194,7 +477,7 @@ ldns_dnssec_build_data_chain_other(ldns_resolver *res,
 	ldns_pkt_free(my_pkt);
 	}
 
-	my_pkt = ldns_resolver_query(res,
+	my_pkt = ldns_dnssec_cache_query(cache, res,
 							key_name,
 							LDNS_RR_TYPE_DNSKEY,
 							c,
@@ -218,6 +501,7 @@ ldns_dnssec_build_data_chain_other(ldns_resolver *res,
 
 static ldns_dnssec_data_chain *
 ldns_dnssec_build_data_chain_nokeyname(ldns_resolver *res,
+                                       ldns_dnssec_cache *cache,
                                        uint16_t qflags,
                                        ldns_rr *orig_rr,
                                        const ldns_rr_list *rrset,
@@ -238,7 +522,7 @@ ldns_dnssec_build_data_chain_nokeyname(ldns_resolver *res,
 		return new_chain;
 	}
 
-	my_pkt = ldns_resolver_query(res,
+	my_pkt = ldns_dnssec_cache_query(cache, res,
 	              possible_parent_name,
 	              LDNS_RR_TYPE_DS,
 	              LDNS_RR_CLASS_IN,
@@ -253,7 +537,7 @@ ldns_dnssec_build_data_chain_nokeyname(ldns_resolver *res,
 		ldns_pkt_free(my_pkt);
 	} else {
 		/* are there signatures? */
-		new_chain->parent =  ldns_dnssec_build_data_chain(res, 
+		new_chain->parent =  ldns_dnssec_build_data_chain_cache(res, cache, 
 		                          qflags, 
 		                          NULL,
 		                          my_pkt,
@@ -267,7 +551,8 @@ ldns_dnssec_build_data_chain_nokeyname(ldns_resolver *res,
 
 
 ldns_dnssec_data_chain *
-ldns_dnssec_build_data_chain(ldns_resolver *res,
+ldns_dnssec_build_data_chain_cache(ldns_resolver *res,
+					    ldns_dnssec_cache *cache,
 					    uint16_t qflags,
 					    const ldns_rr_list *rrset,
 					    const ldns_pkt *pkt,
@@ -299,7 +584,7 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 	if (orig_rr) {
 		new_chain->rrset = ldns_rr_list_new();
 		ldns_rr_list_push_rr(new_chain->rrset, orig_rr);
-		new_chain->parent = ldns_dnssec_build_data_chain(res,
+		new_chain->parent = ldns_dnssec_build_data_chain_cache(res, cache,
 											    qflags,
 											    rrset,
 											    pkt,
@@ -376,7 +661,7 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 		if (pkt) {
 			signatures = ldns_dnssec_pkt_get_rrsigs_for_type(pkt, type);
 		} else {
-			my_pkt = ldns_resolver_query(res, name, type, c, qflags);
+			my_pkt = ldns_dnssec_cache_query(cache, res, name, type, c, qflags);
 			if (my_pkt) {
 			signatures = ldns_dnssec_pkt_get_rrsigs_for_type(pkt, type);
 			ldns_pkt_free(my_pkt);
@@ -390,7 +675,7 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 													type);
 		}
 		if (!signatures) {
-			my_pkt = ldns_resolver_query(res, name, type, c, qflags);
+			my_pkt = ldns_dnssec_cache_query(cache, res, name, type, c, qflags);
 			if (my_pkt) {
 			signatures =
 				ldns_dnssec_pkt_get_rrsigs_for_name_and_type(my_pkt,
@@ -408,7 +693,7 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 		if (signatures) {
 			ldns_rr_list_deep_free(signatures);
 		}
-		return ldns_dnssec_build_data_chain_nokeyname(res,
+		return ldns_dnssec_build_data_chain_nokeyname(res, cache,
 		                                              qflags,
 		                                              orig_rr,
 		                                              rrset,
@@ -417,7 +702,7 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 	if (type != LDNS_RR_TYPE_DNSKEY) {
 		if (type != LDNS_RR_TYPE_DS ||
 				ldns_dname_is_subdomain(name, key_name)) {
-			ldns_dnssec_build_data_chain_dnskey(res,
+			ldns_dnssec_build_data_chain_dnskey(res, cache,
 			                                    qflags,
 			                                    pkt,
 			                                    signatures,
@@ -427,7 +712,7 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 			                                   );
 		}
 	} else {
-		ldns_dnssec_build_data_chain_other(res,
+		ldns_dnssec_build_data_chain_other(res, cache,
 		                                   qflags,
 		                                   new_chain,
 		                                   key_name,
@@ -441,6 +726,17 @@ ldns_dnssec_build_data_chain(ldns_resolver *res,
 	return new_chain;
 }
 
+ldns_dnssec_data_chain *
+ldns_dnssec_build_data_chain(ldns_resolver *res,
+					    uint16_t qflags,
+					    const ldns_rr_list *rrset,
+					    const ldns_pkt *pkt,
+					    ldns_rr *orig_rr)
+{
+	return ldns_dnssec_build_data_chain_cache(
+			res, NULL, qflags, rrset, pkt, orig_rr);
+}
+
 ldns_dnssec_trust_tree *
 ldns_dnssec_trust_tree_new(void)
 {
@@ -681,11 +977,37 @@ ldns_dnssec_trust_tree_add_parent(ldns_dnssec_trust_tree *tree,
 }
 
 /* if rr is null, take the first from the rrset */
+static void ldns_dnssec_derive_trust_tree_normal_rrset_cache(
+		ldns_dnssec_trust_tree *new_tree,
+		ldns_dnssec_data_chain *data_chain,
+		ldns_rr *cur_sig_rr,
+		time_t check_time,
+		ldns_dnssec_cache *cache);
+static void ldns_dnssec_derive_trust_tree_dnskey_rrset_cache(
+		ldns_dnssec_trust_tree *new_tree,
+		ldns_dnssec_data_chain *data_chain,
+		ldns_rr *cur_rr,
+		ldns_rr *cur_sig_rr,
+		time_t check_time,
+		ldns_dnssec_cache *cache);
+static void ldns_dnssec_derive_trust_tree_ds_rrset_cache(
+		ldns_dnssec_trust_tree *new_tree,
+		ldns_dnssec_data_chain *data_chain,
+		ldns_rr *cur_rr,
+		time_t check_time,
+		ldns_dnssec_cache *cache);
+static void ldns_dnssec_derive_trust_tree_no_sig_cache(
+		ldns_dnssec_trust_tree *new_tree,
+		ldns_dnssec_data_chain *data_chain,
+		time_t check_time,
+		ldns_dnssec_cache *cache);
+
 ldns_dnssec_trust_tree *
-ldns_dnssec_derive_trust_tree_time(
+ldns_dnssec_derive_trust_tree_cache(
 		ldns_dnssec_data_chain *data_chain, 
 		ldns_rr *rr, 
-		time_t check_time
+		time_t check_time,
+		ldns_dnssec_cache *cache
 		)
 {
 	ldns_rr_list *cur_rrset;
@@ -750,31 +1072,31 @@ ldns_dnssec_derive_trust_tree_time(
 					}
 					/* option 1 */
 					if (data_chain->parent) {
-						ldns_dnssec_derive_trust_tree_normal_rrset_time(
+						ldns_dnssec_derive_trust_tree_normal_rrset_cache(
 						    new_tree,
 						    data_chain,
 						    cur_sig_rr,
-						    check_time);
+						    check_time, cache);
 					}
 
 					/* option 2 */
-					ldns_dnssec_derive_trust_tree_dnskey_rrset_time(
+					ldns_dnssec_derive_trust_tree_dnskey_rrset_cache(
 					    new_tree,
 					    data_chain,
 					    cur_rr,
 					    cur_sig_rr,
-					    check_time);
+					    check_time, cache);
 				}
 					
-				ldns_dnssec_derive_trust_tree_ds_rrset_time(
+				ldns_dnssec_derive_trust_tree_ds_rrset_cache(
 						new_tree, data_chain, 
-						cur_rr, check_time);
+						cur_rr, check_time, cache);
 			} else {
 				/* no signatures? maybe it's nsec data */
 					
 				/* just add every rr from parent as new parent */
-				ldns_dnssec_derive_trust_tree_no_sig_time(
-					new_tree, data_chain, check_time);
+				ldns_dnssec_derive_trust_tree_no_sig_cache(
+					new_tree, data_chain, check_time, cache);
 			}
 		}
 	}
@@ -782,6 +1104,17 @@ ldns_dnssec_derive_trust_tree_time(
 	return new_tree;
 }
 
+ldns_dnssec_trust_tree *
+ldns_dnssec_derive_trust_tree_time(
+		ldns_dnssec_data_chain *data_chain, 
+		ldns_rr *rr, 
+		time_t check_time
+		)
+{
+	return ldns_dnssec_derive_trust_tree_cache(
+			data_chain, rr, check_time, NULL);
+}
+
 ldns_dnssec_trust_tree *
 ldns_dnssec_derive_trust_tree(ldns_dnssec_data_chain *data_chain, ldns_rr *rr)
 {
@@ -794,9 +1127,21 @@ ldns_dnssec_derive_trust_tree_normal_rrset_time(
 		ldns_dnssec_data_chain *data_chain, 
 		ldns_rr *cur_sig_rr,
 		time_t check_time)
+{
+	ldns_dnssec_derive_trust_tree_normal_rrset_cache(
+			new_tree, data_chain, cur_sig_rr, check_time, NULL);
+}
+
+static void
+ldns_dnssec_derive_trust_tree_normal_rrset_cache(
+		ldns_dnssec_trust_tree *new_tree, 
+		ldns_dnssec_data_chain *data_chain, 
+		ldns_rr *cur_sig_rr,
+		time_t check_time,
+		ldns_dnssec_cache *cache)
 {
 	size_t i, j;
-	ldns_rr_list *cur_rrset = ldns_rr_list_clone(data_chain->rrset); 
+	ldns_rr_list *cur_rrset = ldns_rr_list_share(data_chain->rrset); 
 	ldns_dnssec_trust_tree *cur_parent_tree;
 	ldns_rr *cur_parent_rr;
 	uint16_t cur_keytag;
@@ -835,8 +1180,8 @@ ldns_dnssec_derive_trust_tree_normal_rrset_time(
 								ldns_rr_list_pop_rrset(cur_rrset);
 						}
 					}
-					cur_status = ldns_verify_rrsig_time(
-							tmp_rrset, 
+					cur_status = ldns_dnssec_cache_verify_rrsig_time(
+							cache, tmp_rrset, 
 							cur_sig_rr, 
 							cur_parent_rr,
 							check_time);
@@ -854,10 +1199,10 @@ ldns_dnssec_derive_trust_tree_normal_rrset_time(
 					}
 
 					cur_parent_tree =
-						ldns_dnssec_derive_trust_tree_time(
+						ldns_dnssec_derive_trust_tree_cache(
 								data_chain->parent,
 						                cur_parent_rr,
-								check_time);
+								check_time, cache);
 					(void)ldns_dnssec_trust_tree_add_parent(new_tree,
 					           cur_parent_tree,
 					           cur_sig_rr,
@@ -886,6 +1231,19 @@ ldns_dnssec_derive_trust_tree_dnskey_rrset_time(
 		ldns_rr *cur_rr, 
 		ldns_rr *cur_sig_rr,
 		time_t check_time)
+{
+	ldns_dnssec_derive_trust_tree_dnskey_rrset_cache(
+			new_tree, data_chain, cur_rr, cur_sig_rr, check_time, NULL);
+}
+
+static void
+ldns_dnssec_derive_trust_tree_dnskey_rrset_cache(
+		ldns_dnssec_trust_tree *new_tree, 
+		ldns_dnssec_data_chain *data_chain, 
+		ldns_rr *cur_rr, 
+		ldns_rr *cur_sig_rr,
+		time_t check_time,
+		ldns_dnssec_cache *cache)
 {
 	size_t j;
 	ldns_rr_list *cur_rrset = data_chain->rrset;
@@ -905,8 +1263,8 @@ ldns_dnssec_derive_trust_tree_dnskey_rrset_time(
 				cur_parent_tree = ldns_dnssec_trust_tree_new();
 				cur_parent_tree->rr = cur_parent_rr;
 				cur_parent_tree->rrset = cur_rrset;
-				cur_status = ldns_verify_rrsig_time(
-						cur_rrset, cur_sig_rr, 
+				cur_status = ldns_dnssec_cache_verify_rrsig_time(
+						cache, cur_rrset, cur_sig_rr, 
 						cur_parent_rr, check_time);
 				if (ldns_dnssec_trust_tree_add_parent(new_tree,
 				            cur_parent_tree, cur_sig_rr, cur_status))
@@ -932,6 +1290,18 @@ ldns_dnssec_derive_trust_tree_ds_rrset_time(
 		ldns_dnssec_data_chain *data_chain, 
 		ldns_rr *cur_rr,
 		time_t check_time)
+{
+	ldns_dnssec_derive_trust_tree_ds_rrset_cache(
+			new_tree, data_chain, cur_rr, check_time, NULL);
+}
+
+static void
+ldns_dnssec_derive_trust_tree_ds_rrset_cache(
+		ldns_dnssec_trust_tree *new_tree,
+		ldns_dnssec_data_chain *data_chain, 
+		ldns_rr *cur_rr,
+		time_t check_time,
+		ldns_dnssec_cache *cache)
 {
 	size_t j, h;
 	ldns_rr_list *cur_rrset = data_chain->rrset;
@@ -952,10 +1322,10 @@ ldns_dnssec_derive_trust_tree_ds_rrset_time(
 					cur_rr = ldns_rr_list_rr(cur_rrset, h);
 					if (ldns_rr_compare_ds(cur_rr, cur_parent_rr)) {
 						cur_parent_tree =
-							ldns_dnssec_derive_trust_tree_time(
+							ldns_dnssec_derive_trust_tree_cache(
 							    data_chain->parent, 
 							    cur_parent_rr,
-							    check_time);
+							    check_time, cache);
 						(void) ldns_dnssec_trust_tree_add_parent(
 						            new_tree,
 						            cur_parent_tree,
@@ -984,6 +1354,17 @@ ldns_dnssec_derive_trust_tree_no_sig_time(
 		ldns_dnssec_trust_tree *new_tree, 
 		ldns_dnssec_data_chain *data_chain,
 		time_t check_time)
+{
+	ldns_dnssec_derive_trust_tree_no_sig_cache(
+			new_tree, data_chain, check_time, NULL);
+}
+
+static void
+ldns_dnssec_derive_trust_tree_no_sig_cache(
+		ldns_dnssec_trust_tree *new_tree, 
+		ldns_dnssec_data_chain *data_chain,
+		time_t check_time,
+		ldns_dnssec_cache *cache)
 {
 	size_t i;
 	ldns_rr_list *cur_rrset;
@@ -1020,10 +1401,10 @@ ldns_dnssec_derive_trust_tree_no_sig_time(
 		for (i = 0; i < ldns_rr_list_rr_count(cur_rrset); i++) {
 			cur_parent_rr = ldns_rr_list_rr(cur_rrset, i);
 			cur_parent_tree = 
-				ldns_dnssec_derive_trust_tree_time(
+				ldns_dnssec_derive_trust_tree_cache(
 						data_chain->parent, 
 						cur_parent_rr,
-						check_time);
+						check_time, cache);
 			if (ldns_dnssec_trust_tree_add_parent(new_tree,
 			            cur_parent_tree, NULL, result))
 				ldns_dnssec_trust_tree_free(cur_parent_tree);
@@ -2097,37 +2478,46 @@ ldns_verify_rrsig_buffers_raw(unsigned char* sig, size_t siglen,
 }
 
 
+bool _ldns_rr_list_canonical_ttl(ldns_rr_list *rr_list, uint32_t ttl);
+
 /**
  * Reset the ttl in the rrset with the orig_ttl from the sig 
  * and update owner name if it was wildcard 
  * Also canonicalizes the rrset.
+ * The RRs of the rrset may be shared; those that need a change are
+ * replaced by private copies.
  * @param rrset: rrset to modify
  * @param sig: signature to take TTL and wildcard values from
+ * @return OK or LDNS_STATUS_MEM_ERR
  */
-static void
+static ldns_status
 ldns_rrset_use_signature_ttl(ldns_rr_list* rrset_clone, const ldns_rr* rrsig)
 {
 	uint32_t orig_ttl;
 	uint16_t i;
 	uint8_t label_count;
+	ldns_rr *rr;
 	ldns_rdf *wildcard_name;
 	ldns_rdf *wildcard_chopped;
 	ldns_rdf *wildcard_chopped_tmp;
 	
 	if ((rrsig == NULL) || ldns_rr_rd_count(rrsig) < 4) {
-		return;
+		return LDNS_STATUS_OK;
 	}
 
 	orig_ttl = ldns_rdf2native_int32( ldns_rr_rdf(rrsig, 3));
 	label_count = ldns_rdf2native_int8(ldns_rr_rdf(rrsig, 2));
 
 	for(i = 0; i < ldns_rr_list_rr_count(rrset_clone); i++) {
+		rr = ldns_rr_list_rr(rrset_clone, i);
 		if (label_count < 
-		    ldns_dname_label_count(
-			   ldns_rr_owner(ldns_rr_list_rr(rrset_clone, i)))) {
+		    ldns_dname_label_count(ldns_rr_owner(rr))) {
+			if (!(rr = ldns_rr_unshare(rr))) {
+				return LDNS_STATUS_MEM_ERR;
+			}
+			(void) ldns_rr_list_set_rr(rrset_clone, rr, i);
 			(void) ldns_str2rdf_dname(&wildcard_name, "*");
-			wildcard_chopped = ldns_rdf_clone(ldns_rr_owner(
-				ldns_rr_list_rr(rrset_clone, i)));
+			wildcard_chopped = ldns_rdf_clone(ldns_rr_owner(rr));
 			while (label_count < ldns_dname_label_count(wildcard_chopped)) {
 				wildcard_chopped_tmp = ldns_dname_left_chop(
 					wildcard_chopped);
@@ -2136,15 +2526,15 @@ ldns_rrset_use_signature_ttl(ldns_rr_list* rrset_clone, const ldns_rr* rrsig)
 			}
 			(void) ldns_dname_cat(wildcard_name, wildcard_chopped);
 			ldns_rdf_deep_free(wildcard_chopped);
-			ldns_rdf_deep_free(ldns_rr_owner(ldns_rr_list_rr(
-				rrset_clone, i)));
-			ldns_rr_set_owner(ldns_rr_list_rr(rrset_clone, i), 
-				wildcard_name);
+			ldns_rdf_deep_free(ldns_rr_owner(rr));
+			ldns_rr_set_owner(rr, wildcard_name);
 		}
-		ldns_rr_set_ttl(ldns_rr_list_rr(rrset_clone, i), orig_ttl);
-		/* convert to lowercase */
-		ldns_rr2canonical(ldns_rr_list_rr(rrset_clone, i));
 	}
+	/* set the TTLs and convert to lowercase */
+	if (!_ldns_rr_list_canonical_ttl(rrset_clone, orig_ttl)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	return LDNS_STATUS_OK;
 }
 
 /**
@@ -2286,8 +2676,10 @@ ldns_prepare_for_verify(ldns_buffer* rawsig_buf, ldns_buffer* verify_buf,
 {
 	ldns_status result;
 
-	/* canonicalize the sig */
-	ldns_dname2canonical(ldns_rr_owner(rrsig));
+	/* canonicalize the sig; its owner is not in the signed data, so a
+	 * shared one, which must not change, is left alone */
+	if (!ldns_rdf_is_shared(ldns_rr_owner(rrsig)))
+		ldns_dname2canonical(ldns_rr_owner(rrsig));
 	
 	/* check if the typecovered is equal to the type checked */
 	if (ldns_rdf2rr_type(ldns_rr_rrsig_typecovered(rrsig)) !=
@@ -2301,7 +2693,9 @@ ldns_prepare_for_verify(ldns_buffer* rawsig_buf, ldns_buffer* verify_buf,
 
 	/* use TTL from signature. Use wildcard names for wildcards */
 	/* also canonicalizes rrset_clone */
-	ldns_rrset_use_signature_ttl(rrset_clone, rrsig);
+	result = ldns_rrset_use_signature_ttl(rrset_clone, rrsig);
+	if(result != LDNS_STATUS_OK)
+		return result;
 
 	/* sort the rrset in canonical order  */
 	ldns_rr_list_sort(rrset_clone);
@@ -2470,8 +2864,8 @@ ldns_verify_rrsig_keylist_notime(const ldns_rr_list *rrset,
 		return LDNS_STATUS_MEM_ERR;
 	}
 	
-	/* clone the rrset so that we can fiddle with it */
-	rrset_clone = ldns_rr_list_clone(rrset);
+	/* share the rrset; the RRs we fiddle with are copied on write */
+	rrset_clone = ldns_rr_list_share(rrset);
 
 	/* create the buffers which will certainly hold the raw data */
 	rawsig_buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
@@ -2547,8 +2941,8 @@ ldns_verify_rrsig_time(
 	if (!rrset) {
 		return LDNS_STATUS_NO_DATA;
 	}
-	/* clone the rrset so that we can fiddle with it */
-	rrset_clone = ldns_rr_list_clone(rrset);
+	/* share the rrset; the RRs we fiddle with are copied on write */
+	rrset_clone = ldns_rr_list_share(rrset);
 	/* create the buffers which will certainly hold the raw data */
 	rawsig_buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
 	verify_buf  = ldns_buffer_new(LDNS_MAX_PACKETLEN);
@@ -43,6 +43,19 @@ ldns_dnssec_rrs_deep_free(ldns_dnssec_rrs *rrs)
 	ldns_dnssec_rrs_free_internal(rrs, 1);
 }
 
+int _ldns_rr_compare_rdata(const ldns_rr *rr1, const ldns_rr *rr2);
+
+/* ldns_rr_compare() for the RRs in a list of RRs, which have the same
+ * owner and type, without converting them to wireformat
+ */
+static int
+ldns_dnssec_rrs_compare(const ldns_rr *rr1, const ldns_rr *rr2)
+{
+	int cmp = ldns_rr_compare_no_rdata(rr1, rr2);
+
+	return cmp != 0 ? cmp : _ldns_rr_compare_rdata(rr1, rr2);
+}
+
 ldns_status
 ldns_dnssec_rrs_add_rr(ldns_dnssec_rrs *rrs, ldns_rr *rr)
 {
@@ -52,21 +65,21 @@ ldns_dnssec_rrs_add_rr(ldns_dnssec_rrs *rrs, ldns_rr *rr)
 		return LDNS_STATUS_ERR;
 	}
 
-	/* this could be done more efficiently; name and type should already
-	   be equal */
-	cmp = ldns_rr_compare(rrs->rr, rr);
+	while ((cmp = ldns_dnssec_rrs_compare(rrs->rr, rr)) < 0 && rrs->next) {
+		rrs = rrs->next;
+	}
 	if (cmp < 0) {
-		if (rrs->next) {
-			return ldns_dnssec_rrs_add_rr(rrs->next, rr);
-		} else {
-			new_rrs = ldns_dnssec_rrs_new();
-			new_rrs->rr = rr;
-			rrs->next = new_rrs;
+		if (!(new_rrs = ldns_dnssec_rrs_new())) {
+			return LDNS_STATUS_MEM_ERR;
 		}
+		new_rrs->rr = rr;
+		rrs->next = new_rrs;
 	} else if (cmp > 0) {
 		/* put the current old rr in the new next, put the new
 		   rr in the current container */
-		new_rrs = ldns_dnssec_rrs_new();
+		if (!(new_rrs = ldns_dnssec_rrs_new())) {
+			return LDNS_STATUS_MEM_ERR;
+		}
 		new_rrs->rr = rrs->rr;
 		new_rrs->next = rrs->next;
 		rrs->rr = rr;
@@ -76,23 +89,39 @@ ldns_dnssec_rrs_add_rr(ldns_dnssec_rrs *rrs, ldns_rr *rr)
 	return LDNS_STATUS_OK;
 }
 
-void
-ldns_dnssec_rrs_print_fmt(FILE *out, const ldns_output_format *fmt,
-	       const ldns_dnssec_rrs *rrs)
+/* The zone is printed through one output buffer, from host2str.c */
+ldns_buffer *_ldns_print_buffer_new(FILE *output, size_t capacity);
+void _ldns_print_buffer_free(FILE *output, ldns_buffer *buf);
+void _ldns_rr_print_fmt_buf(FILE *output, const ldns_output_format *fmt,
+		const ldns_rr *rr, ldns_buffer *buf);
+
+static void
+ldns_dnssec_rrs_print_buf(FILE *out, const ldns_output_format *fmt,
+	       const ldns_dnssec_rrs *rrs, ldns_buffer *buf)
 {
 	if (!rrs) {
 		if ((fmt->flags & LDNS_COMMENT_LAYOUT))
-			fprintf(out, "; <void>");
-	} else {
+			ldns_buffer_write_chars(buf, "; <void>");
+	}
+	for (; rrs; rrs = rrs->next) {
 		if (rrs->rr) {
-			ldns_rr_print_fmt(out, fmt, rrs->rr);
-		}
-		if (rrs->next) {
-			ldns_dnssec_rrs_print_fmt(out, fmt, rrs->next);
+			_ldns_rr_print_fmt_buf(out, fmt, rrs->rr, buf);
 		}
 	}
 }
 
+void
+ldns_dnssec_rrs_print_fmt(FILE *out, const ldns_output_format *fmt,
+	       const ldns_dnssec_rrs *rrs)
+{
+	ldns_buffer *buf = _ldns_print_buffer_new(out, LDNS_MAX_PACKETLEN);
+
+	if (buf) {
+		ldns_dnssec_rrs_print_buf(out, fmt, rrs, buf);
+		_ldns_print_buffer_free(out, buf);
+	}
+}
+
 void
 ldns_dnssec_rrs_print(FILE *out, const ldns_dnssec_rrs *rrs)
 {
@@ -270,30 +299,28 @@ ldns_dnssec_rrsets_add_rr(ldns_dnssec_rrsets *rrsets, ldns_rr *rr)
 }
 
 static void
-ldns_dnssec_rrsets_print_soa_fmt(FILE *out, const ldns_output_format *fmt,
+ldns_dnssec_rrsets_print_soa_buf(FILE *out, const ldns_output_format *fmt,
 		const ldns_dnssec_rrsets *rrsets,
 		bool follow,
-		bool show_soa)
+		bool show_soa,
+		ldns_buffer *buf)
 {
 	if (!rrsets) {
 		if ((fmt->flags & LDNS_COMMENT_LAYOUT))
-			fprintf(out, "; <void>\n");
-	} else {
+			ldns_buffer_write_chars(buf, "; <void>\n");
+	}
+	for (; rrsets; rrsets = follow ? rrsets->next : NULL) {
 		if (rrsets->rrs &&
 		    (show_soa ||
 			ldns_rr_get_type(rrsets->rrs->rr) != LDNS_RR_TYPE_SOA
 		    )
 		   ) {
-			ldns_dnssec_rrs_print_fmt(out, fmt, rrsets->rrs);
+			ldns_dnssec_rrs_print_buf(out, fmt, rrsets->rrs, buf);
 			if (rrsets->signatures) {
-				ldns_dnssec_rrs_print_fmt(out, fmt, 
-						rrsets->signatures);
+				ldns_dnssec_rrs_print_buf(out, fmt, 
+						rrsets->signatures, buf);
 			}
 		}
-		if (follow && rrsets->next) {
-			ldns_dnssec_rrsets_print_soa_fmt(out, fmt, 
-					rrsets->next, follow, show_soa);
-		}
 	}
 }
 
@@ -303,7 +330,13 @@ ldns_dnssec_rrsets_print_fmt(FILE *out, const ldns_output_format *fmt,
 		const ldns_dnssec_rrsets *rrsets, 
 		bool follow)
 {
-	ldns_dnssec_rrsets_print_soa_fmt(out, fmt, rrsets, follow, true);
+	ldns_buffer *buf = _ldns_print_buffer_new(out, LDNS_MAX_PACKETLEN);
+
+	if (buf) {
+		ldns_dnssec_rrsets_print_soa_buf(out, fmt, rrsets, follow,
+				true, buf);
+		_ldns_print_buffer_free(out, buf);
+	}
 }
 
 void
@@ -505,16 +538,410 @@ ldns_dnssec_name_find_rrset(const ldns_dnssec_name *name,
 	return NULL;
 }
 
+/* RRsets of indexed zones with at least this many RRs are indexed too */
+#define LDNS_DNSSEC_RRS_INDEX_MIN 32
+
+/* The nodes of the list of RRs of a large RRset, in order */
+typedef struct ldns_dnssec_rrs_index ldns_dnssec_rrs_index;
+struct ldns_dnssec_rrs_index
+{
+	ldns_rr_type type;
+	ldns_dnssec_rrs **nodes;
+	size_t count;
+	size_t capacity;
+	ldns_dnssec_rrs_index *next;
+};
+
+typedef struct ldns_dnssec_zone_index_slot ldns_dnssec_zone_index_slot;
+struct ldns_dnssec_zone_index_slot
+{
+	/* NULL for an empty slot */
+	ldns_dnssec_name *name;
+	uint32_t hash;
+	/* the indexed RRsets of the name */
+	ldns_dnssec_rrs_index *rrsets;
+};
+
+/* Hash table of the names of a zone, with linear probing */
+struct ldns_struct_dnssec_zone_index
+{
+	ldns_dnssec_zone_index_slot *slots;
+	/* the number of slots minus one, which is a power of two */
+	size_t mask;
+	size_t count;
+};
+
+/* Only the RRs in the rrs lists of the RRsets are indexed */
+static bool
+ldns_dnssec_zone_index_type(const ldns_rr *rr)
+{
+	return ldns_rr_get_type(rr) != LDNS_RR_TYPE_RRSIG &&
+	       ldns_rr_get_type(rr) != LDNS_RR_TYPE_NSEC &&
+	       ldns_rr_get_type(rr) != LDNS_RR_TYPE_NSEC3;
+}
+
+static uint32_t
+ldns_dnssec_zone_index_hash(const ldns_rdf *dname)
+{
+	uint8_t lower[LDNS_MAX_DOMAINLEN];
+	size_t size = ldns_rdf_size(dname), i;
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a, case insensitive like ldns_dname_compare() */
+	if (size > sizeof(lower)) {
+		size = sizeof(lower);
+	}
+	_ldns_dname_lower(lower, ldns_rdf_data(dname), size);
+	for (i = 0; i < size; i++) {
+		hash ^= lower[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static ldns_dnssec_zone_index_slot *
+ldns_dnssec_zone_index_find(const struct ldns_struct_dnssec_zone_index *index,
+		const ldns_rdf *dname, uint32_t hash)
+{
+	ldns_dnssec_zone_index_slot *slot;
+	size_t i;
+
+	for (i = hash & index->mask; (slot = &index->slots[i])->name;
+			i = (i + 1) & index->mask) {
+		if (slot->hash == hash &&
+		    ldns_dname_compare(slot->name->name, dname) == 0) {
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+static void
+ldns_dnssec_rrs_index_free(ldns_dnssec_rrs_index *rrs_index)
+{
+	ldns_dnssec_rrs_index *next;
+
+	for (; rrs_index; rrs_index = next) {
+		next = rrs_index->next;
+		LDNS_FREE(rrs_index->nodes);
+		LDNS_FREE(rrs_index);
+	}
+}
+
+static ldns_status
+ldns_dnssec_zone_index_grow(struct ldns_struct_dnssec_zone_index *index)
+{
+	ldns_dnssec_zone_index_slot *slots, *old = index->slots;
+	size_t mask = index->mask * 2 + 1, i, j;
+
+	if (!(slots = LDNS_CALLOC(ldns_dnssec_zone_index_slot, mask + 1))) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i <= index->mask; i++) {
+		if (!old[i].name) {
+			continue;
+		}
+		for (j = old[i].hash & mask; slots[j].name; j = (j + 1) & mask)
+			;
+		slots[j] = old[i];
+	}
+	index->slots = slots;
+	index->mask = mask;
+	LDNS_FREE(old);
+	return LDNS_STATUS_OK;
+}
+
+static ldns_dnssec_zone_index_slot *
+ldns_dnssec_zone_index_insert(struct ldns_struct_dnssec_zone_index *index,
+		ldns_dnssec_name *name, uint32_t hash)
+{
+	size_t i;
+
+	/* keep it at most three quarters full */
+	if ((index->count + 1) * 4 > (index->mask + 1) * 3 &&
+	    ldns_dnssec_zone_index_grow(index) != LDNS_STATUS_OK) {
+		return NULL;
+	}
+	for (i = hash & index->mask; index->slots[i].name;
+			i = (i + 1) & index->mask)
+		;
+	index->slots[i].name = name;
+	index->slots[i].hash = hash;
+	index->slots[i].rrsets = NULL;
+	index->count++;
+	return &index->slots[i];
+}
+
+static void
+ldns_dnssec_zone_index_delete(struct ldns_struct_dnssec_zone_index *index,
+		ldns_dnssec_zone_index_slot *slot)
+{
+	size_t i = (size_t)(slot - index->slots), j, home;
+
+	ldns_dnssec_rrs_index_free(slot->rrsets);
+	/* move up the entries after it that would not be found anymore */
+	for (j = (i + 1) & index->mask; index->slots[j].name;
+			j = (j + 1) & index->mask) {
+		home = index->slots[j].hash & index->mask;
+		if (i <= j ? (home <= i || home > j)
+		           : (home <= i && home > j)) {
+			index->slots[i] = index->slots[j];
+			i = j;
+		}
+	}
+	index->slots[i].name = NULL;
+	index->slots[i].rrsets = NULL;
+	index->count--;
+}
+
+void
+ldns_dnssec_zone_free_index(ldns_dnssec_zone *zone)
+{
+	size_t i;
+
+	if (!zone || !zone->_index) {
+		return;
+	}
+	for (i = 0; i <= zone->_index->mask; i++) {
+		ldns_dnssec_rrs_index_free(zone->_index->slots[i].rrsets);
+	}
+	LDNS_FREE(zone->_index->slots);
+	LDNS_FREE(zone->_index);
+}
+
+/* Adds a name to the index of the zone, or drops the index when that
+ * fails.
+ */
+static ldns_dnssec_zone_index_slot *
+ldns_dnssec_zone_index_add_name(ldns_dnssec_zone *zone,
+		ldns_dnssec_name *name, uint32_t hash)
+{
+	ldns_dnssec_zone_index_slot *slot;
+
+	slot = ldns_dnssec_zone_index_insert(zone->_index, name, hash);
+	if (!slot) {
+		ldns_dnssec_zone_free_index(zone);
+		return NULL;
+	}
+	return slot;
+}
+
+ldns_status
+ldns_dnssec_zone_create_index(ldns_dnssec_zone *zone)
+{
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+
+	if (!zone) {
+		return LDNS_STATUS_NULL;
+	}
+	if (zone->_index) {
+		return LDNS_STATUS_OK;
+	}
+	zone->_index = LDNS_MALLOC(struct ldns_struct_dnssec_zone_index);
+	if (!zone->_index) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	zone->_index->mask = 63;
+	zone->_index->count = 0;
+	zone->_index->slots = LDNS_CALLOC(ldns_dnssec_zone_index_slot,
+			zone->_index->mask + 1);
+	if (!zone->_index->slots) {
+		ldns_dnssec_zone_free_index(zone);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (!zone->names) {
+		return LDNS_STATUS_OK;
+	}
+	for (node = ldns_rbtree_first(zone->names); node != LDNS_RBTREE_NULL;
+			node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		if (!ldns_dnssec_zone_index_add_name(zone, name,
+				ldns_dnssec_zone_index_hash(name->name))) {
+			return LDNS_STATUS_MEM_ERR;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+static void
+ldns_dnssec_rrs_index_drop(ldns_dnssec_zone_index_slot *slot,
+		ldns_dnssec_rrs_index *rrs_index)
+{
+	ldns_dnssec_rrs_index **prev;
+
+	for (prev = &slot->rrsets; *prev; prev = &(*prev)->next) {
+		if (*prev == rrs_index) {
+			*prev = rrs_index->next;
+			rrs_index->next = NULL;
+			ldns_dnssec_rrs_index_free(rrs_index);
+			return;
+		}
+	}
+}
+
+/* The index of the RRs of rrset, or NULL when it has none, or when the
+ * RRs were changed without it (which drops the index).
+ */
+static ldns_dnssec_rrs_index *
+ldns_dnssec_rrs_index_get(ldns_dnssec_zone_index_slot *slot,
+		ldns_rr_type type, const ldns_dnssec_rrsets *rrset)
+{
+	ldns_dnssec_rrs_index *rrs_index;
+
+	for (rrs_index = slot->rrsets; rrs_index; rrs_index = rrs_index->next) {
+		if (rrs_index->type != type) {
+			continue;
+		}
+		if (rrset && rrs_index->count > 0 &&
+		    rrs_index->nodes[0] == rrset->rrs) {
+			return rrs_index;
+		}
+		ldns_dnssec_rrs_index_drop(slot, rrs_index);
+		return NULL;
+	}
+	return NULL;
+}
+
+static void
+ldns_dnssec_rrs_index_new(ldns_dnssec_zone_index_slot *slot,
+		ldns_rr_type type, ldns_dnssec_rrs *rrs)
+{
+	ldns_dnssec_rrs_index *rrs_index;
+	ldns_dnssec_rrs *cur;
+	size_t count = 0;
+
+	/* without the index, adding RRs just takes longer */
+	if (!(rrs_index = LDNS_MALLOC(ldns_dnssec_rrs_index))) {
+		return;
+	}
+	for (cur = rrs; cur; cur = cur->next) {
+		count++;
+	}
+	rrs_index->capacity = count * 2;
+	rrs_index->nodes = LDNS_XMALLOC(ldns_dnssec_rrs *,
+			rrs_index->capacity);
+	if (!rrs_index->nodes) {
+		LDNS_FREE(rrs_index);
+		return;
+	}
+	for (count = 0, cur = rrs; cur; cur = cur->next) {
+		rrs_index->nodes[count++] = cur;
+	}
+	rrs_index->type = type;
+	rrs_index->count = count;
+	rrs_index->next = slot->rrsets;
+	slot->rrsets = rrs_index;
+}
+
+/* The position of the first RR in the index that is not before rr */
+static size_t
+ldns_dnssec_rrs_index_search(const ldns_dnssec_rrs_index *rrs_index,
+		const ldns_rr *rr, bool *equal)
+{
+	size_t lo = 0, hi = rrs_index->count, mid;
+	int cmp;
+
+	*equal = false;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = ldns_dnssec_rrs_compare(rrs_index->nodes[mid]->rr, rr);
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			*equal = cmp == 0;
+			hi = mid;
+			if (*equal) {
+				break;
+			}
+		}
+	}
+	return hi;
+}
+
+/* Adds rr, of a type with an rrs list, to the name of an indexed zone */
+static ldns_status
+ldns_dnssec_zone_index_add_rr(ldns_dnssec_zone_index_slot *slot,
+		ldns_rr *rr)
+{
+	ldns_rr_type type = ldns_rr_get_type(rr);
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs_index *rrs_index;
+	ldns_dnssec_rrs *prev = NULL, *cur, *node, **nodes;
+	size_t pos = 0;
+	bool equal = false;
+	int cmp = 1;
+
+	rrset = ldns_dnssec_name_find_rrset(slot->name, type);
+	rrs_index = ldns_dnssec_rrs_index_get(slot, type, rrset);
+	if (!rrset || !rrset->rrs) {
+		return ldns_dnssec_name_add_rr(slot->name, rr);
+	}
+	if (rrs_index) {
+		pos = ldns_dnssec_rrs_index_search(rrs_index, rr, &equal);
+		prev = pos > 0 ? rrs_index->nodes[pos - 1] : NULL;
+	} else {
+		for (cur = rrset->rrs; cur &&
+		     (cmp = ldns_dnssec_rrs_compare(cur->rr, rr)) < 0;
+		     cur = cur->next) {
+			prev = cur;
+			pos++;
+		}
+		equal = cur && cmp == 0;
+	}
+	if (equal) {
+		/* Silently ignore equal rr's */
+		return LDNS_STATUS_OK;
+	}
+	if (!(node = ldns_dnssec_rrs_new())) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	node->rr = rr;
+	if (prev) {
+		node->next = prev->next;
+		prev->next = node;
+	} else {
+		node->next = rrset->rrs;
+		rrset->rrs = node;
+	}
+	if (!rrs_index) {
+		if (pos >= LDNS_DNSSEC_RRS_INDEX_MIN) {
+			ldns_dnssec_rrs_index_new(slot, type, rrset->rrs);
+		}
+		return LDNS_STATUS_OK;
+	}
+	if (rrs_index->count == rrs_index->capacity) {
+		nodes = LDNS_XREALLOC(rrs_index->nodes, ldns_dnssec_rrs *,
+				rrs_index->capacity * 2);
+		if (!nodes) {
+			ldns_dnssec_rrs_index_drop(slot, rrs_index);
+			return LDNS_STATUS_OK;
+		}
+		rrs_index->nodes = nodes;
+		rrs_index->capacity *= 2;
+	}
+	memmove(&rrs_index->nodes[pos + 1], &rrs_index->nodes[pos],
+			(rrs_index->count - pos) * sizeof(ldns_dnssec_rrs *));
+	rrs_index->nodes[pos] = node;
+	rrs_index->count++;
+	return LDNS_STATUS_OK;
+}
+
 ldns_dnssec_rrsets *
 ldns_dnssec_zone_find_rrset(const ldns_dnssec_zone *zone,
 					   const ldns_rdf *dname,
 					   ldns_rr_type type)
 {
 	ldns_rbnode_t *node;
+	ldns_dnssec_zone_index_slot *slot;
 
 	if (!zone || !dname || !zone->names) {
 		return NULL;
 	}
+	if (zone->_index && (slot = ldns_dnssec_zone_index_find(zone->_index,
+			dname, ldns_dnssec_zone_index_hash(dname)))) {
+		return ldns_dnssec_name_find_rrset(slot->name, type);
+	}
 
 	node = ldns_rbtree_search(zone->names, dname);
 	if (node) {
@@ -525,29 +952,44 @@ ldns_dnssec_zone_find_rrset(const ldns_dnssec_zone *zone,
 	}
 }
 
+/* Appends a name for a comment, or the error ldns_rdf_print() prints */
+static void
+ldns_dnssec_name_print_dname_buf(const ldns_rdf *dname, ldns_buffer *buf)
+{
+	size_t start = ldns_buffer_position(buf);
+
+	if (ldns_rdf2buffer_str(buf, dname) != LDNS_STATUS_OK) {
+		ldns_buffer_set_position(buf, start);
+		buf->_status = LDNS_STATUS_OK;
+		ldns_buffer_write_chars(buf,
+				";Unable to convert rdf to string\n");
+	}
+}
+
 static void
-ldns_dnssec_name_print_soa_fmt(FILE *out, const ldns_output_format *fmt,
+ldns_dnssec_name_print_soa_buf(FILE *out, const ldns_output_format *fmt,
 		const ldns_dnssec_name *name, 
-		bool show_soa)
+		bool show_soa,
+		ldns_buffer *buf)
 {
 	if (name) {
 		if(name->rrsets) {
-			ldns_dnssec_rrsets_print_soa_fmt(out, fmt, 
-					name->rrsets, true, show_soa);
+			ldns_dnssec_rrsets_print_soa_buf(out, fmt, 
+					name->rrsets, true, show_soa, buf);
 		} else if ((fmt->flags & LDNS_COMMENT_LAYOUT)) {
-			fprintf(out, ";; Empty nonterminal: ");
-			ldns_rdf_print(out, name->name);
-			fprintf(out, "\n");
+			ldns_buffer_write_chars(buf, ";; Empty nonterminal: ");
+			ldns_dnssec_name_print_dname_buf(name->name, buf);
+			ldns_buffer_write_char(buf, '\n');
 		}
 		if(name->nsec) {
-			ldns_rr_print_fmt(out, fmt, name->nsec);
+			_ldns_rr_print_fmt_buf(out, fmt, name->nsec, buf);
 		}
 		if (name->nsec_signatures) {
-			ldns_dnssec_rrs_print_fmt(out, fmt, 
-					name->nsec_signatures);
+			ldns_dnssec_rrs_print_buf(out, fmt, 
+					name->nsec_signatures, buf);
 		}
 	} else if ((fmt->flags & LDNS_COMMENT_LAYOUT)) {
-		fprintf(out, "; <void>\n");
+		ldns_buffer_write_chars(buf, "; <void>\n");
 	}
 }
 
@@ -556,7 +998,12 @@ void
 ldns_dnssec_name_print_fmt(FILE *out, const ldns_output_format *fmt,
 		const ldns_dnssec_name *name)
 {
-	ldns_dnssec_name_print_soa_fmt(out, fmt, name, true);
+	ldns_buffer *buf = _ldns_print_buffer_new(out, LDNS_MAX_PACKETLEN);
+
+	if (buf) {
+		ldns_dnssec_name_print_soa_buf(out, fmt, name, true, buf);
+		_ldns_print_buffer_free(out, buf);
+	}
 }
 
 void
@@ -575,6 +1022,7 @@ ldns_dnssec_zone_new(void)
 	zone->names = NULL;
 	zone->hashed_names = NULL;
 	zone->_nsec3params = NULL;
+	zone->_index = NULL;
 
 	return zone;
 }
@@ -605,9 +1053,59 @@ ldns_todo_nsec3_ents_node_free(ldns_rbnode_t *node, void *arg) {
 	LDNS_FREE(node);
 }
 
-ldns_status _ldns_rr_new_frm_fp_l_internal(ldns_rr **newrr, FILE *fp,
-		uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev,
-		int *line_nr, bool *explicit_ttl);
+/* Adds the NSEC3s that could not be added when they were read, because
+ * the names they refer to were not read yet.
+ */
+static ldns_status
+ldns_dnssec_zone_add_todo_nsec3s(ldns_dnssec_zone *zone,
+		ldns_rr_list *todo_nsec3s)
+{
+	/* when reading NSEC3s, there is a chance that we encounter nsecs
+	   for empty nonterminals, whose nonterminals we cannot derive yet
+	   because the needed information is to be read later.
+
+	   nsec3_ents (where ent is e.n.t.; i.e. empty non terminal) will
+	   hold the NSEC3s that still didn't have a matching name in the
+	   zone tree, even after all names were read.  They can only match
+	   after the zone is equipped with all the empty non terminals. */
+	ldns_rbtree_t todo_nsec3_ents;
+	ldns_rbnode_t *new_node;
+	ldns_rr *cur_rr;
+	ldns_status status = LDNS_STATUS_OK;
+	size_t i;
+
+	ldns_rbtree_init(&todo_nsec3_ents, ldns_dname_compare_v);
+	for (i = 0; status == LDNS_STATUS_OK &&
+			i < ldns_rr_list_rr_count(todo_nsec3s); i++) {
+		cur_rr = ldns_rr_list_rr(todo_nsec3s, i);
+		status = ldns_dnssec_zone_add_rr(zone, cur_rr);
+		if (status == LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND) {
+			if (!(new_node = LDNS_MALLOC(ldns_rbnode_t))) {
+				status = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			new_node->key  = ldns_dname_label(ldns_rr_owner(cur_rr), 0);
+			new_node->data = cur_rr;
+			if (!ldns_rbtree_insert(&todo_nsec3_ents, new_node)) {
+				LDNS_FREE(new_node);
+				status = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			status = LDNS_STATUS_OK;
+		}
+	}
+	if (todo_nsec3_ents.count > 0)
+		(void) ldns_dnssec_zone_add_empty_nonterminals_nsec3(
+				zone, &todo_nsec3_ents);
+	ldns_traverse_postorder(&todo_nsec3_ents,
+			ldns_todo_nsec3_ents_node_free, NULL);
+	return status;
+}
+
+ldns_status _ldns_rr_new_frm_fp_l_internal(ldns_rr_parse_ctx *ctx,
+		ldns_rr **newrr, FILE *fp, uint32_t *default_ttl,
+		ldns_rdf **origin, ldns_rdf **prev, int *line_nr,
+		bool *explicit_ttl);
 
 ldns_status
 ldns_dnssec_zone_new_frm_fp_l(ldns_dnssec_zone** z, FILE* fp, const ldns_rdf* origin,
@@ -624,16 +1122,6 @@ ldns_dnssec_zone_new_frm_fp_l(ldns_dnssec_zone** z, FILE* fp, const ldns_rdf* or
 	   them and add them to the name later on, after the name is read.
 	   We track not yet  matching NSEC3s*n the todo_nsec3s list */
 	ldns_rr_list* todo_nsec3s = ldns_rr_list_new();
-	/* when reading NSEC3s, there is a chance that we encounter nsecs
-	   for empty nonterminals, whose nonterminals we cannot derive yet
-	   because the needed information is to be read later.
-
-	   nsec3_ents (where ent is e.n.t.; i.e. empty non terminal) will
-	   hold the NSEC3s that still didn't have a matching name in the
-	   zone tree, even after all names were read.  They can only match
-	   after the zone is equipped with all the empty non terminals. */
-	ldns_rbtree_t todo_nsec3_ents;
-	ldns_rbnode_t *new_node;
 	ldns_rr_list* todo_nsec3_rrsigs = ldns_rr_list_new();
 
 	ldns_status status;
@@ -650,8 +1138,6 @@ ldns_dnssec_zone_new_frm_fp_l(ldns_dnssec_zone** z, FILE* fp, const ldns_rdf* or
 	bool explicit_ttl = false;
 #endif
 
-	ldns_rbtree_init(&todo_nsec3_ents, ldns_dname_compare_v);
-
 #ifdef FASTER_DNSSEC_ZONE_NEW_FRM_FP
 	status = ldns_zone_new_frm_fp_l(&zone, fp, origin, default_ttl, c, line_nr);
 	if (status != LDNS_STATUS_OK)
@@ -661,6 +1147,10 @@ ldns_dnssec_zone_new_frm_fp_l(ldns_dnssec_zone** z, FILE* fp, const ldns_rdf* or
 		status = LDNS_STATUS_MEM_ERR;
 		goto error;
 	}
+	/* for finding the names and adding to large RRsets while loading */
+	if ((status = ldns_dnssec_zone_create_index(newzone))) {
+		goto error;
+	}
 	if (origin) {
 		if (!(my_origin = ldns_rdf_clone(origin))) {
 			status = LDNS_STATUS_MEM_ERR;
@@ -780,33 +1270,17 @@ ldns_dnssec_zone_new_frm_fp_l(ldns_dnssec_zone** z, FILE* fp, const ldns_rdf* or
 		}
 	}
 
+	if (status == LDNS_STATUS_OK)
+		status = ldns_dnssec_zone_add_todo_nsec3s(newzone, todo_nsec3s);
 	for (i = 0; status == LDNS_STATUS_OK &&
-			i < ldns_rr_list_rr_count(todo_nsec3s); i++) {
-		cur_rr = ldns_rr_list_rr(todo_nsec3s, i);
-		status = ldns_dnssec_zone_add_rr(newzone, cur_rr);
-		if (status == LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND) {
-			if (!(new_node = LDNS_MALLOC(ldns_rbnode_t))) {
-				status = LDNS_STATUS_MEM_ERR;
-				break;
-			}
-			new_node->key  = ldns_dname_label(ldns_rr_owner(cur_rr), 0);
-			new_node->data = cur_rr;
-			if (!ldns_rbtree_insert(&todo_nsec3_ents, new_node)) {
-				LDNS_FREE(new_node);
-				status = LDNS_STATUS_MEM_ERR;
-				break;
-			}
-			status = LDNS_STATUS_OK;
-		}
-	}
-	if (todo_nsec3_ents.count > 0)
-		(void) ldns_dnssec_zone_add_empty_nonterminals_nsec3(
-				newzone, &todo_nsec3_ents);
-	for (i = 0; status == LDNS_STATUS_OK &&
-			i < ldns_rr_list_rr_count(todo_nsec3_rrsigs); i++) {
-		cur_rr = ldns_rr_list_rr(todo_nsec3_rrsigs, i);
+			i < ldns_rr_list_rr_count(todo_nsec3_rrsigs); i++) {
+		cur_rr = ldns_rr_list_rr(todo_nsec3_rrsigs, i);
 		status = ldns_dnssec_zone_add_rr(newzone, cur_rr);
 	}
+	/* The caller may change the zone in ways that do not keep an index
+	 * up to date, so it only gets one with
+	 * ldns_dnssec_zone_create_index() */
+	ldns_dnssec_zone_free_index(newzone);
 	if (z) {
 		*z = newzone;
 		newzone = NULL;
@@ -822,8 +1296,6 @@ error:
 	}
 #endif
 	ldns_rr_list_free(todo_nsec3_rrsigs);
-	ldns_traverse_postorder(&todo_nsec3_ents,
-			ldns_todo_nsec3_ents_node_free, NULL);
 	ldns_rr_list_free(todo_nsec3s);
 
 	if (my_origin) {
@@ -869,6 +1341,7 @@ void
 ldns_dnssec_zone_free(ldns_dnssec_zone *zone)
 {
 	if (zone) {
+		ldns_dnssec_zone_free_index(zone);
 		if (zone->hashed_names) {
 			ldns_traverse_postorder(zone->hashed_names,
 					ldns_hashed_names_node_free, NULL);
@@ -889,6 +1362,7 @@ void
 ldns_dnssec_zone_deep_free(ldns_dnssec_zone *zone)
 {
 	if (zone) {
+		ldns_dnssec_zone_free_index(zone);
 		if (zone->hashed_names) {
 			ldns_traverse_postorder(zone->hashed_names,
 					ldns_hashed_names_node_free, NULL);
@@ -1008,7 +1482,10 @@ ldns_dnssec_zone_add_rr(ldns_dnssec_zone *zone, ldns_rr *rr)
 	ldns_status result = LDNS_STATUS_OK;
 	ldns_dnssec_name *cur_name;
 	ldns_rbnode_t *cur_node;
+	ldns_dnssec_zone_index_slot *slot = NULL;
 	ldns_rr_type type_covered = 0;
+	uint32_t hash = 0;
+	bool index_miss = false;
 
 	if (!zone || !rr) {
 		return LDNS_STATUS_ERR;
@@ -1030,10 +1507,22 @@ ldns_dnssec_zone_add_rr(ldns_dnssec_zone *zone, ldns_rr *rr)
 		if (!cur_node) {
 			return LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND;
 		}
+	} else if (zone->_index) {
+		hash = ldns_dnssec_zone_index_hash(ldns_rr_owner(rr));
+		slot = ldns_dnssec_zone_index_find(zone->_index,
+				ldns_rr_owner(rr), hash);
+		index_miss = !slot;
+		cur_node = slot ? NULL
+			: ldns_rbtree_search(zone->names, ldns_rr_owner(rr));
 	} else {
 		cur_node = ldns_rbtree_search(zone->names, ldns_rr_owner(rr));
 	}
-	if (!cur_node) {
+	if (slot) {
+		cur_name = slot->name;
+		result = ldns_dnssec_zone_index_type(rr)
+			? ldns_dnssec_zone_index_add_rr(slot, rr)
+			: ldns_dnssec_name_add_rr(cur_name, rr);
+	} else if (!cur_node) {
 		/* add */
 		cur_name = ldns_dnssec_name_new_frm_rr(rr);
                 if(!cur_name) return LDNS_STATUS_MEM_ERR;
@@ -1050,16 +1539,622 @@ ldns_dnssec_zone_add_rr(ldns_dnssec_zone *zone, ldns_rr *rr)
 		cur_name = (ldns_dnssec_name *) cur_node->data;
 		result = ldns_dnssec_name_add_rr(cur_name, rr);
 	}
+	if (index_miss) {
+		/* without an index is fine too */
+		(void) ldns_dnssec_zone_index_add_name(zone, cur_name, hash);
+	}
 	if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
 		zone->soa = cur_name;
 	}
 	return result;
 }
 
+/* Removes the RR equal to rr from rrs, and returns it */
+static ldns_rr *
+ldns_dnssec_rrs_remove_rr(ldns_dnssec_rrs **rrs, const ldns_rr *rr)
+{
+	ldns_dnssec_rrs *cur;
+	ldns_rr *removed;
+
+	for (; *rrs; rrs = &(*rrs)->next) {
+		if (ldns_dnssec_rrs_compare((*rrs)->rr, rr) == 0) {
+			cur = *rrs;
+			removed = cur->rr;
+			*rrs = cur->next;
+			LDNS_FREE(cur);
+			return removed;
+		}
+	}
+	return NULL;
+}
+
+static ldns_rr *
+ldns_dnssec_name_remove_rr(ldns_dnssec_name *name, const ldns_rr *rr)
+{
+	ldns_dnssec_rrsets **rrsets, *cur;
+	ldns_rr_type rr_type, typecovered = 0;
+	ldns_rr *removed = NULL;
+
+	rr_type = ldns_rr_get_type(rr);
+	if (rr_type == LDNS_RR_TYPE_RRSIG) {
+		typecovered = ldns_rdf2rr_type(ldns_rr_rrsig_typecovered(rr));
+	}
+	if (rr_type == LDNS_RR_TYPE_NSEC || rr_type == LDNS_RR_TYPE_NSEC3) {
+		if (name->nsec && ldns_rr_compare(name->nsec, rr) == 0) {
+			removed = name->nsec;
+			name->nsec = NULL;
+		}
+		return removed;
+	}
+	if (typecovered == LDNS_RR_TYPE_NSEC ||
+	    typecovered == LDNS_RR_TYPE_NSEC3) {
+		return ldns_dnssec_rrs_remove_rr(&name->nsec_signatures, rr);
+	}
+	for (rrsets = &name->rrsets; *rrsets; rrsets = &(*rrsets)->next) {
+		cur = *rrsets;
+		if (cur->type != (typecovered ? typecovered : rr_type)) {
+			continue;
+		}
+		removed = ldns_dnssec_rrs_remove_rr(typecovered
+				? &cur->signatures : &cur->rrs, rr);
+		if (!cur->rrs && !cur->signatures) {
+			*rrsets = cur->next;
+			LDNS_FREE(cur);
+		}
+		break;
+	}
+	return removed;
+}
+
+/* Removes the RR equal to rr, of a type with an rrs list, from the name
+ * of an indexed zone, and returns it
+ */
+static ldns_rr *
+ldns_dnssec_zone_index_remove_rr(ldns_dnssec_zone_index_slot *slot,
+		const ldns_rr *rr)
+{
+	ldns_rr_type type = ldns_rr_get_type(rr);
+	ldns_dnssec_rrsets **rrsets, *rrset = NULL;
+	ldns_dnssec_rrs_index *rrs_index;
+	ldns_dnssec_rrs *node;
+	ldns_rr *removed;
+	size_t pos;
+	bool equal;
+
+	for (rrsets = &slot->name->rrsets; *rrsets; rrsets = &(*rrsets)->next) {
+		if ((*rrsets)->type == type) {
+			rrset = *rrsets;
+			break;
+		}
+	}
+	if (!(rrs_index = ldns_dnssec_rrs_index_get(slot, type, rrset))) {
+		return ldns_dnssec_name_remove_rr(slot->name, rr);
+	}
+	pos = ldns_dnssec_rrs_index_search(rrs_index, rr, &equal);
+	if (!equal) {
+		return NULL;
+	}
+	node = rrs_index->nodes[pos];
+	if (pos > 0) {
+		rrs_index->nodes[pos - 1]->next = node->next;
+	} else {
+		rrset->rrs = node->next;
+	}
+	memmove(&rrs_index->nodes[pos], &rrs_index->nodes[pos + 1],
+			(rrs_index->count - pos - 1) * sizeof(ldns_dnssec_rrs *));
+	rrs_index->count--;
+	removed = node->rr;
+	LDNS_FREE(node);
+	if (rrs_index->count == 0) {
+		ldns_dnssec_rrs_index_drop(slot, rrs_index);
+		if (!rrset->signatures) {
+			*rrsets = rrset->next;
+			LDNS_FREE(rrset);
+		}
+	}
+	return removed;
+}
+
+/* An RR of the zone to replace zone->_nsec3params with */
+static ldns_rr *
+ldns_dnssec_zone_find_nsec3(const ldns_dnssec_zone *zone)
+{
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+
+	for (node = ldns_rbtree_first(zone->names); node != LDNS_RBTREE_NULL;
+	     node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		if (name->nsec &&
+		    ldns_rr_get_type(name->nsec) == LDNS_RR_TYPE_NSEC3) {
+			return name->nsec;
+		}
+	}
+	return NULL;
+}
+
+ldns_rr *
+ldns_dnssec_zone_remove_rr(ldns_dnssec_zone *zone, const ldns_rr *rr)
+{
+	ldns_dnssec_name *name;
+	ldns_rbnode_t *node;
+	ldns_dnssec_zone_index_slot *slot = NULL;
+	ldns_rdf *hashed_name, *owner;
+	ldns_rr *removed;
+	ldns_rr_type type_covered = 0;
+
+	if (!zone || !rr || !zone->names) {
+		return NULL;
+	}
+	if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_RRSIG) {
+		type_covered = ldns_rdf2rr_type(ldns_rr_rrsig_typecovered(rr));
+	}
+	if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_NSEC3 ||
+	    type_covered == LDNS_RR_TYPE_NSEC3) {
+		if (!zone->hashed_names ||
+		    !(hashed_name = ldns_dname_label(ldns_rr_owner(rr), 0))) {
+			return NULL;
+		}
+		node = ldns_rbtree_search(zone->hashed_names, hashed_name);
+		ldns_rdf_deep_free(hashed_name);
+		if (!node) {
+			return NULL;
+		}
+		name = (ldns_dnssec_name *) node->data;
+		node = ldns_rbtree_search(zone->names, name->name);
+	} else {
+		node = ldns_rbtree_search(zone->names, ldns_rr_owner(rr));
+	}
+	if (!node) {
+		return NULL;
+	}
+	name = (ldns_dnssec_name *) node->data;
+	if (zone->_index) {
+		slot = ldns_dnssec_zone_index_find(zone->_index, name->name,
+				ldns_dnssec_zone_index_hash(name->name));
+	}
+	if (slot && ldns_dnssec_zone_index_type(rr)) {
+		removed = ldns_dnssec_zone_index_remove_rr(slot, rr);
+	} else {
+		removed = ldns_dnssec_name_remove_rr(name, rr);
+	}
+	if (!removed) {
+		return NULL;
+	}
+	if (ldns_rdf_is_shared(ldns_rr_owner(removed)) &&
+	    (owner = ldns_rdf_clone(ldns_rr_owner(removed)))) {
+		/* the removed RR gets an owner of its own; when the name
+		 * borrowed the interned one, the name takes its reference */
+		if (!name->name_alloced &&
+		    name->name == ldns_rr_owner(removed)) {
+			name->name_alloced = true;
+		} else {
+			ldns_rdf_deep_free(ldns_rr_owner(removed));
+		}
+		ldns_rr_set_owner(removed, owner);
+	}
+	if (ldns_rr_get_type(removed) == LDNS_RR_TYPE_SOA &&
+	    zone->soa == name) {
+		zone->soa = NULL;
+	}
+	if (!name->rrsets && !name->nsec && !name->nsec_signatures) {
+		node = ldns_rbtree_delete(zone->names, name->name);
+		LDNS_FREE(node);
+		if (name->hashed_name && zone->hashed_names &&
+		    (node = ldns_rbtree_delete(zone->hashed_names,
+					       name->hashed_name))) {
+			LDNS_FREE(node);
+		}
+		if (slot) {
+			ldns_dnssec_zone_index_delete(zone->_index, slot);
+		}
+		ldns_dnssec_name_free(name);
+
+	} else if (!name->name_alloced &&
+	    name->name == ldns_rr_owner(removed)) {
+		/* the name belonged to the removed RR */
+		if ((name->name = ldns_rdf_clone(name->name))) {
+			name->name_alloced = true;
+		}
+		node->key = name->name;
+	}
+	if (removed == zone->_nsec3params) {
+		zone->_nsec3params = ldns_dnssec_zone_find_nsec3(zone);
+	}
+	return removed;
+}
+
+/* Gives the RRs that have an owner equal to name, byte for byte, a
+ * reference to name instead */
+static void
+ldns_dnssec_rrs_intern_owners(ldns_dnssec_rrs *rrs, ldns_rdf *name)
+{
+	ldns_rdf *owner;
+
+	for (; rrs; rrs = rrs->next) {
+		owner = ldns_rr_owner(rrs->rr);
+		if (owner != name && !ldns_rr_is_shared(rrs->rr)
+		                  && ldns_rdf_compare(owner, name) == 0) {
+			ldns_rr_set_owner(rrs->rr, ldns_rdf_ref(name));
+			ldns_rdf_deep_free(owner);
+		}
+	}
+}
+
 void
-ldns_dnssec_zone_names_print_fmt(FILE *out, const ldns_output_format *fmt,
+ldns_dnssec_zone_intern_owners(ldns_dnssec_zone *zone)
+{
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs nsec;
+
+	if (!zone || !zone->names) {
+		return;
+	}
+	for (node = ldns_rbtree_first(zone->names); node != LDNS_RBTREE_NULL;
+			node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		for (rrset = name->rrsets; rrset; rrset = rrset->next) {
+			ldns_dnssec_rrs_intern_owners(rrset->rrs, name->name);
+			ldns_dnssec_rrs_intern_owners(rrset->signatures,
+					name->name);
+		}
+		if (name->nsec) {
+			nsec.rr = name->nsec;
+			nsec.next = name->nsec_signatures;
+			ldns_dnssec_rrs_intern_owners(&nsec, name->name);
+		}
+	}
+}
+
+/* Where the application of a zone transfer to a zone is */
+struct ldns_dnssec_zone_xfr_state {
+	ldns_dnssec_zone *zone;
+	/* the first SOA, held until the kind of transfer is known */
+	ldns_rr *soa;
+	/* serial of the first SOA, the version being transferred */
+	uint32_t serial;
+	size_t rr_count;
+	/* IXFR answered with differences, rather than the whole zone */
+	bool incremental;
+	/* in a difference: adding, rather than deleting, RRs */
+	bool adding;
+	/* NSEC3s (and their RRSIGs) whose names were not seen yet */
+	ldns_rr_list *todo_nsec3s;
+	ldns_rr_list *todo_nsec3_rrsigs;
+};
+
+static void
+ldns_dnssec_zone_clear(ldns_dnssec_zone *zone)
+{
+	bool indexed = zone->_index != NULL;
+
+	ldns_dnssec_zone_free_index(zone);
+	if (zone->hashed_names) {
+		ldns_traverse_postorder(zone->hashed_names,
+				ldns_hashed_names_node_free, NULL);
+		LDNS_FREE(zone->hashed_names);
+	}
+	if (zone->names) {
+		ldns_traverse_postorder(zone->names,
+				ldns_dnssec_name_node_deep_free, NULL);
+		LDNS_FREE(zone->names);
+	}
+	zone->soa = NULL;
+	zone->_nsec3params = NULL;
+	if (indexed) {
+		/* keep the zone indexed; without is fine too */
+		(void) ldns_dnssec_zone_create_index(zone);
+	}
+}
+
+static uint32_t
+ldns_soa_serial(const ldns_rr *soa)
+{
+	return ldns_rr_rd_count(soa) < 3 ? 0
+		: ldns_rdf2native_int32(ldns_rr_rdf(soa, 2));
+}
+
+static ldns_status
+ldns_dnssec_zone_xfr_add_rr(struct ldns_dnssec_zone_xfr_state *x,
+		ldns_rr *rr)
+{
+	ldns_status status;
+
+	/* replace an equal RR, which may have a different TTL */
+	ldns_rr_free(ldns_dnssec_zone_remove_rr(x->zone, rr));
+	status = ldns_dnssec_zone_add_rr(x->zone, rr);
+	if (status == LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND) {
+		if (!ldns_rr_list_push_rr(
+				rr_is_rrsig_covering(rr, LDNS_RR_TYPE_NSEC3)
+				? x->todo_nsec3_rrsigs : x->todo_nsec3s, rr)) {
+			ldns_rr_free(rr);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		return LDNS_STATUS_OK;
+	}
+	if (status != LDNS_STATUS_OK) {
+		ldns_rr_free(rr);
+	}
+	return status;
+}
+
+static ldns_status
+ldns_dnssec_zone_xfr_rr(struct ldns_dnssec_zone_xfr_state *x, ldns_rr *rr)
+{
+	bool is_soa = ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA;
+	ldns_status status;
+
+	if (x->rr_count++ == 0) {
+		x->soa = rr;
+		x->serial = ldns_soa_serial(rr);
+		return LDNS_STATUS_OK;
+	}
+	if (x->soa) {
+		if (is_soa && ldns_soa_serial(rr) != x->serial) {
+			/* the differences start with deleting the current
+			 * SOA
+			 */
+			x->incremental = true;
+			ldns_rr_free(x->soa);
+			x->soa = NULL;
+			ldns_rr_free(ldns_dnssec_zone_remove_rr(x->zone, rr));
+			ldns_rr_free(rr);
+			return LDNS_STATUS_OK;
+		} else {
+			ldns_dnssec_zone_clear(x->zone);
+			status = ldns_dnssec_zone_add_rr(x->zone, x->soa);
+			if (status != LDNS_STATUS_OK) {
+				ldns_rr_free(x->soa);
+				x->soa = NULL;
+				ldns_rr_free(rr);
+				return status;
+			}
+		}
+		x->soa = NULL;
+	}
+	if (!x->incremental) {
+		if (is_soa) {
+			/* the last RR, repeating the first */
+			ldns_rr_free(rr);
+			return LDNS_STATUS_OK;
+		}
+		return ldns_dnssec_zone_xfr_add_rr(x, rr);
+	}
+	if (is_soa && x->adding && ldns_soa_serial(rr) == x->serial) {
+		/* the last RR, repeating the SOA added last */
+		ldns_rr_free(rr);
+		return LDNS_STATUS_OK;
+	}
+	if (is_soa) {
+		x->adding = !x->adding;
+	}
+	if (x->adding) {
+		return ldns_dnssec_zone_xfr_add_rr(x, rr);
+	}
+	ldns_rr_free(ldns_dnssec_zone_remove_rr(x->zone, rr));
+	ldns_rr_free(rr);
+	return LDNS_STATUS_OK;
+}
+
+/* Keeps the RRs of a transfer until it is complete */
+static ldns_status
+ldns_dnssec_zone_xfr_stage(ldns_rr_list *rrs, void *arg)
+{
+	ldns_rr_list *staged = arg;
+	size_t i;
+
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		if (!ldns_rr_list_push_rr(staged, ldns_rr_list_rr(rrs, i))) {
+			for (; i < ldns_rr_list_rr_count(rrs); i++) {
+				ldns_rr_free(ldns_rr_list_rr(rrs, i));
+			}
+			return LDNS_STATUS_MEM_ERR;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* Applies the staged RRs of a complete transfer to the zone, which takes
+ * them over */
+static ldns_status
+ldns_dnssec_zone_xfr_apply(ldns_dnssec_zone *zone, ldns_rr_list *staged)
+{
+	struct ldns_dnssec_zone_xfr_state x;
+	ldns_rbnode_t *node;
+	ldns_rdf *hashed_name;
+	ldns_rr *rr;
+	ldns_status status = LDNS_STATUS_OK;
+	size_t i;
+
+	memset(&x, 0, sizeof(x));
+	x.zone = zone;
+	x.todo_nsec3s = ldns_rr_list_new();
+	x.todo_nsec3_rrsigs = ldns_rr_list_new();
+	if (!x.todo_nsec3s || !x.todo_nsec3_rrsigs) {
+		status = LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(staged); i++) {
+		if (status == LDNS_STATUS_OK) {
+			status = ldns_dnssec_zone_xfr_rr(&x,
+					ldns_rr_list_rr(staged, i));
+		} else {
+			ldns_rr_free(ldns_rr_list_rr(staged, i));
+		}
+	}
+	ldns_rr_list_set_rr_count(staged, 0);
+	if (status == LDNS_STATUS_OK) {
+		status = ldns_dnssec_zone_add_todo_nsec3s(zone, x.todo_nsec3s);
+	}
+	/* free the NSEC3s that still have no name */
+	for (i = 0; i < ldns_rr_list_rr_count(x.todo_nsec3s); i++) {
+		rr = ldns_rr_list_rr(x.todo_nsec3s, i);
+		node = NULL;
+		if (zone->hashed_names && (hashed_name =
+		    ldns_dname_label(ldns_rr_owner(rr), 0))) {
+			node = ldns_rbtree_search(zone->hashed_names,
+					hashed_name);
+			ldns_rdf_deep_free(hashed_name);
+		}
+		if (!node || ((ldns_dnssec_name *) node->data)->nsec != rr) {
+			ldns_rr_free(rr);
+		}
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(x.todo_nsec3_rrsigs); i++) {
+		rr = ldns_rr_list_rr(x.todo_nsec3_rrsigs, i);
+		if (status == LDNS_STATUS_OK) {
+			status = ldns_dnssec_zone_add_rr(zone, rr);
+			if (status == LDNS_STATUS_OK) {
+				continue;
+			}
+		}
+		ldns_rr_free(rr);
+	}
+	/* when the zone was up to date */
+	ldns_rr_free(x.soa);
+	ldns_rr_list_free(x.todo_nsec3s);
+	ldns_rr_list_free(x.todo_nsec3_rrsigs);
+	return status;
+}
+
+/* Replaces the contents of the zone by the staged RRs of a complete
+ * transfer of the whole zone. They are added to a new zone first, so
+ * that the zone is left as it was when that fails. The RRs are taken
+ * over, unless there is no memory for the new zone.
+ */
+static ldns_status
+ldns_dnssec_zone_xfr_replace(ldns_dnssec_zone *zone, ldns_rr_list *staged)
+{
+	ldns_dnssec_zone *new_zone = ldns_dnssec_zone_new();
+	ldns_dnssec_zone tmp;
+	bool indexed = zone->_index != NULL;
+	ldns_status status;
+
+	if (!new_zone) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	status = ldns_dnssec_zone_xfr_apply(new_zone, staged);
+	if (status == LDNS_STATUS_OK) {
+		tmp = *zone;
+		*zone = *new_zone;
+		*new_zone = tmp;
+		if (indexed) {
+			/* keep the zone indexed; without is fine too */
+			(void) ldns_dnssec_zone_create_index(zone);
+		}
+	}
+	ldns_dnssec_zone_deep_free(new_zone);
+	return status;
+}
+
+/* Whether the staged transfer has the differences between two versions,
+ * rather than the whole zone: the SOA of the new version followed by
+ * the one of the version to delete from */
+static bool
+ldns_dnssec_zone_xfr_incremental(const ldns_rr_list *staged)
+{
+	const ldns_rr *first, *second;
+
+	if (ldns_rr_list_rr_count(staged) < 2) {
+		return false;
+	}
+	first = ldns_rr_list_rr(staged, 0);
+	second = ldns_rr_list_rr(staged, 1);
+	return ldns_rr_get_type(first) == LDNS_RR_TYPE_SOA &&
+	       ldns_rr_get_type(second) == LDNS_RR_TYPE_SOA &&
+	       ldns_soa_serial(first) != ldns_soa_serial(second);
+}
+
+static ldns_status
+ldns_dnssec_zone_xfr_type(ldns_dnssec_zone *zone, ldns_resolver *res,
+		const ldns_rdf *name, ldns_rr_class c, ldns_rr_type t,
+		size_t workers)
+{
+	ldns_rr_list *staged = ldns_rr_list_new();
+	ldns_dnssec_rrsets *soa = NULL;
+	uint32_t ixfr_serial;
+	ldns_status status;
+
+	if (!staged) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (t == LDNS_RR_TYPE_IXFR) {
+		soa = ldns_dnssec_name_find_rrset(zone->soa,
+				LDNS_RR_TYPE_SOA);
+		ixfr_serial = ldns_resolver_get_ixfr_serial(res);
+		ldns_resolver_set_ixfr_serial(res,
+				ldns_soa_serial(soa->rrs->rr));
+		status = ldns_xfr_pipeline(res, name, c, t, workers,
+				ldns_dnssec_zone_xfr_stage, staged);
+		ldns_resolver_set_ixfr_serial(res, ixfr_serial);
+	} else {
+		status = ldns_xfr_pipeline(res, name, c, t, workers,
+				ldns_dnssec_zone_xfr_stage, staged);
+	}
+	/* the transfer is complete, up to the final SOA, when it succeeds */
+	if (status != LDNS_STATUS_OK) {
+		ldns_rr_list_deep_free(staged);
+		return status;
+	}
+	if (ldns_rr_list_rr_count(staged) <= 1) {
+		/* just the SOA: the zone is up to date */
+		ldns_rr_list_deep_free(staged);
+		return LDNS_STATUS_OK;
+	}
+	if (t != LDNS_RR_TYPE_IXFR ||
+	    !ldns_dnssec_zone_xfr_incremental(staged)) {
+		status = ldns_dnssec_zone_xfr_replace(zone, staged);
+		ldns_rr_list_deep_free(staged);
+		return status;
+	}
+	soa = ldns_dnssec_name_find_rrset(zone->soa, LDNS_RR_TYPE_SOA);
+	if (ldns_soa_serial(ldns_rr_list_rr(staged, 1))
+			!= ldns_soa_serial(soa->rrs->rr)) {
+		/* the differences are from another version */
+		status = LDNS_STATUS_ERR;
+	} else {
+		status = ldns_dnssec_zone_xfr_apply(zone, staged);
+	}
+	ldns_rr_list_deep_free(staged);
+	if (status != LDNS_STATUS_OK) {
+		/* the differences do not apply, start over */
+		status = ldns_dnssec_zone_xfr_type(zone, res, name, c,
+				LDNS_RR_TYPE_AXFR, workers);
+	}
+	return status;
+}
+
+ldns_status
+ldns_dnssec_zone_xfr_pipeline(ldns_dnssec_zone *zone, ldns_resolver *res,
+		const ldns_rdf *name, ldns_rr_class c, size_t workers)
+{
+	ldns_dnssec_rrsets *soa = NULL;
+
+	if (!zone || !res || !name) {
+		return LDNS_STATUS_NULL;
+	}
+	if (zone->soa) {
+		soa = ldns_dnssec_name_find_rrset(zone->soa,
+				LDNS_RR_TYPE_SOA);
+	}
+	return ldns_dnssec_zone_xfr_type(zone, res, name, c,
+			soa && soa->rrs ? LDNS_RR_TYPE_IXFR
+			                : LDNS_RR_TYPE_AXFR, workers);
+}
+
+ldns_status
+ldns_dnssec_zone_xfr(ldns_dnssec_zone *zone, ldns_resolver *res,
+		const ldns_rdf *name, ldns_rr_class c)
+{
+	return ldns_dnssec_zone_xfr_pipeline(zone, res, name, c, 0);
+}
+
+static void
+ldns_dnssec_zone_names_print_buf(FILE *out, const ldns_output_format *fmt,
 		const ldns_rbtree_t *tree, 
-		bool print_soa)
+		bool print_soa,
+		ldns_buffer *buf)
 {
 	ldns_rbnode_t *node;
 	ldns_dnssec_name *name;
@@ -1067,13 +2162,28 @@ ldns_dnssec_zone_names_print_fmt(FILE *out, const ldns_output_format *fmt,
 	node = ldns_rbtree_first(tree);
 	while (node != LDNS_RBTREE_NULL) {
 		name = (ldns_dnssec_name *) node->data;
-		ldns_dnssec_name_print_soa_fmt(out, fmt, name, print_soa);
+		ldns_dnssec_name_print_soa_buf(out, fmt, name, print_soa, buf);
 		if ((fmt->flags & LDNS_COMMENT_LAYOUT))
-			fprintf(out, ";\n");
+			ldns_buffer_write_chars(buf, ";\n");
 		node = ldns_rbtree_next(node);
 	}
 }
 
+void
+ldns_dnssec_zone_names_print_fmt(FILE *out, const ldns_output_format *fmt,
+		const ldns_rbtree_t *tree, 
+		bool print_soa)
+{
+	ldns_buffer *buf = _ldns_print_buffer_new(out,
+			2 * LDNS_MAX_PACKETLEN);
+
+	if (buf) {
+		ldns_dnssec_zone_names_print_buf(out, fmt, tree, print_soa,
+				buf);
+		_ldns_print_buffer_free(out, buf);
+	}
+}
+
 void
 ldns_dnssec_zone_names_print(FILE *out, const ldns_rbtree_t *tree, bool print_soa)
 {
@@ -1085,28 +2195,33 @@ void
 ldns_dnssec_zone_print_fmt(FILE *out, const ldns_output_format *fmt,
 	       const ldns_dnssec_zone *zone)
 {
-	if (zone) {
-		if (zone->soa) {
-			if ((fmt->flags & LDNS_COMMENT_LAYOUT)) {
-				fprintf(out, ";; Zone: ");
-				ldns_rdf_print(out, ldns_dnssec_name_name(
-							zone->soa));
-				fprintf(out, "\n;\n");
-			}
-			ldns_dnssec_rrsets_print_fmt(out, fmt,
-					ldns_dnssec_name_find_rrset(
-						zone->soa, 
-						LDNS_RR_TYPE_SOA), 
-					false);
-			if ((fmt->flags & LDNS_COMMENT_LAYOUT))
-				fprintf(out, ";\n");
-		}
+	ldns_buffer *buf;
 
-		if (zone->names) {
-			ldns_dnssec_zone_names_print_fmt(out, fmt, 
-					zone->names, false);
+	if (!zone || !(buf = _ldns_print_buffer_new(out,
+					2 * LDNS_MAX_PACKETLEN))) {
+		return;
+	}
+	if (zone->soa) {
+		if ((fmt->flags & LDNS_COMMENT_LAYOUT)) {
+			ldns_buffer_write_chars(buf, ";; Zone: ");
+			ldns_dnssec_name_print_dname_buf(
+					ldns_dnssec_name_name(zone->soa), buf);
+			ldns_buffer_write_chars(buf, "\n;\n");
 		}
+		ldns_dnssec_rrsets_print_soa_buf(out, fmt,
+				ldns_dnssec_name_find_rrset(
+					zone->soa, 
+					LDNS_RR_TYPE_SOA), 
+				false, true, buf);
+		if ((fmt->flags & LDNS_COMMENT_LAYOUT))
+			ldns_buffer_write_chars(buf, ";\n");
+	}
+
+	if (zone->names) {
+		ldns_dnssec_zone_names_print_buf(out, fmt, 
+				zone->names, false, buf);
 	}
+	_ldns_print_buffer_free(out, buf);
 }
 
 void
@@ -1115,6 +2230,34 @@ ldns_dnssec_zone_print(FILE *out, const ldns_dnssec_zone *zone)
 	ldns_dnssec_zone_print_fmt(out, ldns_output_format_default, zone);
 }
 
+/* Prints one name of a zone in the layout of ldns_dnssec_zone_print_fmt(),
+ * for zones that are printed one name at a time while they are signed
+ * (see ldns_dnssec_zone_signer in dnssec_sign.c). The apex comes first,
+ * with its SOA RRset before the rest.
+ */
+void
+_ldns_dnssec_name_print_buf(FILE *out, const ldns_output_format *fmt,
+		const ldns_dnssec_name *name, bool apex, ldns_buffer *buf)
+{
+	if (apex) {
+		if ((fmt->flags & LDNS_COMMENT_LAYOUT)) {
+			ldns_buffer_write_chars(buf, ";; Zone: ");
+			ldns_dnssec_name_print_dname_buf(
+					ldns_dnssec_name_name(name), buf);
+			ldns_buffer_write_chars(buf, "\n;\n");
+		}
+		ldns_dnssec_rrsets_print_soa_buf(out, fmt,
+				ldns_dnssec_name_find_rrset(
+					name, LDNS_RR_TYPE_SOA),
+				false, true, buf);
+		if ((fmt->flags & LDNS_COMMENT_LAYOUT))
+			ldns_buffer_write_chars(buf, ";\n");
+	}
+	ldns_dnssec_name_print_soa_buf(out, fmt, name, false, buf);
+	if ((fmt->flags & LDNS_COMMENT_LAYOUT))
+		ldns_buffer_write_chars(buf, ";\n");
+}
+
 static ldns_status
 ldns_dnssec_zone_add_empty_nonterminals_nsec3(
 		ldns_dnssec_zone *zone, ldns_rbtree_t *nsec3s)
@@ -1231,7 +2374,13 @@ ldns_dnssec_zone_add_empty_nonterminals_nsec3(
 				}
 				new_node->key = new_name->name;
 				new_node->data = new_name;
-				(void)ldns_rbtree_insert(zone->names, new_node);
+				if (ldns_rbtree_insert(zone->names, new_node)
+				    && zone->_index) {
+					(void) ldns_dnssec_zone_index_add_name(
+						zone, new_name,
+						ldns_dnssec_zone_index_hash(
+							new_name->name));
+				}
 				ldns_dnssec_name_make_hashed_name(
 						zone, new_name, NULL);
 				if (node)
@@ -66,6 +66,8 @@ static bool set_nss_for_name(
 	ldns_rdf *new_lookup;
 	ldns_rdf *addr;
 	ldns_rr_list *addrs;
+	ldns_rdf **ns_names;
+	size_t nss_count;
 
 	/* nss will become the rrset of as much of "name" as possible */
 	for (;;) {
@@ -107,15 +109,22 @@ static bool set_nss_for_name(
 	if (ldns_resolver_nameserver_count(res) > 0)
 		return true;
 
-	/* Lookup addresses with local resolver add add to "referrals" database */
-	addrs = ldns_rr_list_new();
-	for (nss_rrs = nss->rrs; nss_rrs; nss_rrs = nss_rrs->next) {
-		ldns_rr_list *addrs_by_name =
-		    ldns_get_rr_list_addr_by_name(
-			local_res, ldns_rr_rdf(nss_rrs->rr, 0), c, 0);
-		ldns_rr_list_cat(addrs, addrs_by_name);
-		ldns_rr_list_free(addrs_by_name);
+	/* Lookup addresses with local resolver add add to "referrals" database.
+	 * The names are all looked up at once.
+	 */
+	for (nss_count = 0, nss_rrs = nss->rrs; nss_rrs; nss_rrs = nss_rrs->next)
+		nss_count++;
+	if (!(ns_names = LDNS_XMALLOC(ldns_rdf *, nss_count))) {
+		error("Memory allocation failed");
+		return false;
 	}
+	for (nss_count = 0, nss_rrs = nss->rrs; nss_rrs; nss_rrs = nss_rrs->next)
+		ns_names[nss_count++] = ldns_rr_rdf(nss_rrs->rr, 0);
+	addrs = ldns_get_rr_list_addr_by_names(
+	    local_res, ns_names, nss_count, c, 0);
+	LDNS_FREE(ns_names);
+	if (!addrs)
+		addrs = ldns_rr_list_new();
 
 	if (ldns_rr_list_rr_count(addrs) == 0)
 		error("Could not find the nameserver ip addr; abort");
@@ -148,7 +157,7 @@ do_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 {
 
 	static uint8_t zero[1] = { 0 };
-	static const ldns_rdf root_dname = { 1, LDNS_RDF_TYPE_DNAME, &zero };
+	static const ldns_rdf root_dname = { 1, LDNS_RDF_TYPE_DNAME, &zero, 0 };
 
 	ldns_resolver *res = NULL;
 	ldns_pkt *p = NULL;
@@ -186,6 +195,8 @@ do_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 			ldns_resolver_usevc(local_res));
 	ldns_resolver_set_random(res, 
 			ldns_resolver_random(local_res));
+	ldns_resolver_set_fanout(res,
+			ldns_resolver_fanout(local_res));
 	ldns_resolver_set_source(res,
 			ldns_resolver_source(local_res));
 	ldns_resolver_set_recursive(res, false);
@@ -354,6 +365,7 @@ do_chase(ldns_resolver *res,
 	ldns_status tree_result;
 	ldns_dnssec_data_chain *chain;
 	ldns_dnssec_trust_tree *tree;
+	ldns_dnssec_cache *cache;
 	
 	const ldns_rr_descriptor *descriptor;
 	descriptor = ldns_rr_descript(type);
@@ -446,16 +458,22 @@ do_chase(ldns_resolver *res,
 	
 	orig_rr = ldns_rr_new();
 
+	/* the chain asks for the same DNSKEY rrsets, and the trust tree
+	 * verifies the same signatures, more than once */
+	cache = ldns_dnssec_cache_new(0);
+
 /* if the answer had no answer section, we need to construct our own rr (for instance if
  * the rr qe asked for doesn't exist. This rr will be destroyed when the chain is freed */
 	if (ldns_pkt_ancount(pkt) < 1) {
 		ldns_rr_set_type(orig_rr, type);
 		ldns_rr_set_owner(orig_rr, ldns_rdf_clone(name));
 	
-		chain = ldns_dnssec_build_data_chain(res, qflags, rrset, pkt, ldns_rr_clone(orig_rr));
+		chain = ldns_dnssec_build_data_chain_cache(res, cache, qflags,
+				rrset, pkt, ldns_rr_clone(orig_rr));
 	} else {
 		/* chase the first answer */
-		chain = ldns_dnssec_build_data_chain(res, qflags, rrset, pkt, NULL);
+		chain = ldns_dnssec_build_data_chain_cache(res, cache, qflags,
+				rrset, pkt, NULL);
 	}
 
 	if (verbosity >= 4) {
@@ -465,7 +483,8 @@ do_chase(ldns_resolver *res,
 	
 	result = LDNS_STATUS_OK;
 
-	tree = ldns_dnssec_derive_trust_tree(chain, NULL);
+	tree = ldns_dnssec_derive_trust_tree_cache(chain, NULL, time(NULL),
+			cache);
 
 	if (verbosity >= 2) {
 		printf("\n\nDNSSEC Trust tree:\n");
@@ -495,6 +514,7 @@ do_chase(ldns_resolver *res,
 	
 	ldns_rr_free(orig_rr);
 	ldns_dnssec_trust_tree_free(tree);
+	ldns_dnssec_cache_free(cache);
 	ldns_dnssec_data_chain_deep_free(chain);
 	
 	ldns_rr_list_deep_free(rrset);
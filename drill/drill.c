@@ -78,6 +78,7 @@ usage(FILE *stream, const char *progname)
 	fprintf(stream, "\t-r <file>\tuse file as root servers hint file\n");
 	fprintf(stream, "\t-t\t\tsend the query with tcp (connected)\n");
 	fprintf(stream, "\t-d <domain>\tuse domain as the start point for the trace\n");
+	fprintf(stream, "\t-F <number>\tquery <number> nameservers at once (defaults to 3\n\t\t\twhen tracing or chasing, 1 otherwise)\n");
     fprintf(stream, "\t-y <name:key[:algo]>\tspecify named base64 tsig key, and optional an\n\t\t\talgorithm (defaults to hmac-md5.sig-alg.reg.int)\n");
 	fprintf(stream, "\t-z\t\tdon't randomize the nameservers before use\n");
 	fprintf(stream, "\n  [*] = enables/implies DNSSEC\n");
@@ -156,6 +157,7 @@ main(int argc, char *argv[])
 	bool		qds;
 	bool		qusevc;
 	bool 		qrandom;
+	int		qfanout;
 	bool            drill_reverse = false;
 	
 	char		*resolv_conf_file = NULL;
@@ -202,6 +204,7 @@ main(int argc, char *argv[])
 	qbuf = 0;
 	qusevc = false;
 	qrandom = true;
+	qfanout = -1;
 	key_verified = NULL;
 	ldns_edns_option_list* edns_list = NULL;
 
@@ -211,7 +214,7 @@ main(int argc, char *argv[])
 	/* global first, query opt next, option with parm's last
 	 * and sorted */ /*  "46DITSVQf:i:w:q:achuvxzy:so:p:b:k:" */
 	                               
-	while ((c = getopt(argc, argv, "46ab:c:d:Df:hi:I:k:o:p:q:Qr:sStTuvV:w:xy:z")) != -1) {
+	while ((c = getopt(argc, argv, "46ab:c:d:DF:f:hi:I:k:o:p:q:Qr:sStTuvV:w:xy:z")) != -1) {
 		switch(c) {
 			/* global options */
 			case '4':
@@ -226,6 +229,13 @@ main(int argc, char *argv[])
 			case 'I':
 				src = optarg;
 				break;
+			case 'F':
+				qfanout = atoi(optarg);
+				if (qfanout < 0 || qfanout > 255) {
+					fprintf(stderr, "-F expects a number between 0 and 255.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
 			case 'T':
 				if (PURPOSE == DRILL_CHASE) {
 					fprintf(stderr, "-T and -S cannot be used at the same time.\n");
@@ -673,6 +683,12 @@ main(int argc, char *argv[])
 	ldns_resolver_set_fallback(res, qfallback);
 	ldns_resolver_set_usevc(res, qusevc);
 	ldns_resolver_set_random(res, qrandom);
+	if (qfanout == -1) {
+		/* query a few servers at a time for each step of the way */
+		qfanout = (PURPOSE == DRILL_TRACE || PURPOSE == DRILL_SECTRACE
+		        || PURPOSE == DRILL_CHASE) ? 3 : 1;
+	}
+	ldns_resolver_set_fanout(res, (uint8_t)qfanout);
 	if (qbuf != 0) {
 		ldns_resolver_set_edns_udp_size(res, qbuf);
 	}
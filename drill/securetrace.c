@@ -77,6 +77,81 @@ get_dnssec_pkt(ldns_resolver *r, ldns_rdf *name, ldns_rr_type t)
 	}
 }
 
+/* Fetch the DNSKEY rrset of key_name and the next_type rrset of next_name
+ * at the same time, because the latter does not depend on the former.
+ */
+static void
+get_dnssec_pkts(ldns_resolver *r, ldns_rdf *key_name, ldns_pkt **key_p,
+		ldns_rdf *next_name, ldns_rr_type next_t, ldns_pkt **next_p)
+{
+	ldns_rdf *names[2];
+	ldns_rr_type types[2];
+	ldns_pkt *pkts[2];
+
+	names[0] = key_name;
+	types[0] = LDNS_RR_TYPE_DNSKEY;
+	names[1] = next_name;
+	types[1] = next_t;
+	(void) ldns_resolver_send_multi(pkts, r, names, types, 2,
+			LDNS_RR_CLASS_IN, 0);
+	if (verbosity >= 5) {
+		if (pkts[0]) {
+			ldns_pkt_print(stdout, pkts[0]);
+		}
+		if (pkts[1]) {
+			ldns_pkt_print(stdout, pkts[1]);
+		}
+	}
+	*key_p = pkts[0];
+	*next_p = pkts[1];
+}
+
+/* Look up the addresses of the names that do not have glue in the
+ * referral, first with the trace resolver, and of the names that still
+ * have none with the local resolver. All names are looked up at once.
+ */
+static ldns_rr_list *
+get_ns_addrs(ldns_resolver *res, ldns_resolver *local_res,
+		ldns_rdf **names, size_t count, ldns_rr_class c)
+{
+	ldns_rr_list *addrs;
+	ldns_rr_list *more_addrs;
+	size_t i, j, n;
+	bool found;
+
+	addrs = ldns_get_rr_list_addr_by_names(res, names, count, c, 0);
+
+	/* keep the names that were not resolved */
+	for (i = 0, n = 0; i < count; i++) {
+		found = false;
+		for (j = 0; j < ldns_rr_list_rr_count(addrs); j++) {
+			if (ldns_dname_compare(names[i], ldns_rr_owner(
+					ldns_rr_list_rr(addrs, j))) == 0) {
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			names[n++] = names[i];
+		}
+	}
+	if (n == 0) {
+		return addrs;
+	}
+	more_addrs = ldns_get_rr_list_addr_by_names(local_res, names, n, c, 0);
+	if (!addrs) {
+		return more_addrs;
+	}
+	if (more_addrs) {
+		if (!ldns_rr_list_cat(addrs, more_addrs)) {
+			ldns_rr_list_deep_free(more_addrs);
+		} else {
+			ldns_rr_list_free(more_addrs);
+		}
+	}
+	return addrs;
+}
+
 #ifdef HAVE_SSL
 /* 
  * retrieve keys for this zone
@@ -153,6 +228,11 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 	ldns_rr_list *new_ns_addr;
 	ldns_rr_list *old_ns_addr;
 	ldns_rr *ns_rr;
+	ldns_rdf **no_glue;
+	size_t no_glue_count;
+
+	/* the DNSKEY and the DS (or final) data are fetched together */
+	ldns_pkt *next_p = NULL;
 
 	int result = 0;
 
@@ -212,6 +292,8 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 			ldns_resolver_usevc(local_res));
 	ldns_resolver_set_random(res,
 			ldns_resolver_random(local_res));
+	ldns_resolver_set_fanout(res,
+			ldns_resolver_fanout(local_res));
 	ldns_resolver_set_source(res,
 			ldns_resolver_source(local_res));
 	ldns_resolver_set_recursive(local_res, true);
@@ -280,6 +362,15 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 		   of course if the data is in the apex, there are, so cover both
 		   cases */
 		if (new_nss || i > 1) {
+			no_glue = LDNS_XMALLOC(ldns_rdf *,
+					ldns_rr_list_rr_count(new_nss) + 1);
+			if (!no_glue) {
+				error("Memory allocation failed");
+				ldns_rr_list_deep_free(new_nss);
+				ldns_pkt_free(local_p);
+				goto done;
+			}
+			no_glue_count = 0;
 			for(j = 0; j < ldns_rr_list_rr_count(new_nss); j++) {
 				ns_rr = ldns_rr_list_rr(new_nss, j);
 				pop = ldns_rr_rdf(ns_rr, 0);
@@ -294,10 +385,9 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 					new_ns_addr = ldns_pkt_rr_list_by_name_and_type(local_p, pop, LDNS_RR_TYPE_A, LDNS_SECTION_ADDITIONAL);
 				}
 				if (!new_ns_addr || ldns_rr_list_rr_count(new_ns_addr) == 0) {
-					new_ns_addr = ldns_get_rr_list_addr_by_name(res, pop, c, 0);
-				}
-				if (!new_ns_addr || ldns_rr_list_rr_count(new_ns_addr) == 0) {
-					new_ns_addr = ldns_get_rr_list_addr_by_name(local_res, pop, c, 0);
+					/* looked up below, together with
+					 * the other names without glue */
+					no_glue[no_glue_count++] = pop;
 				}
 
 				if (new_ns_addr) {
@@ -307,6 +397,17 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 				}
 				ldns_rr_list_deep_free(new_ns_addr);
 			}
+			if (no_glue_count > 0) {
+				new_ns_addr = get_ns_addrs(res, local_res,
+						no_glue, no_glue_count, c);
+				if (new_ns_addr) {
+					old_ns_addr = ns_addr;
+					ns_addr = ldns_rr_list_cat_clone(ns_addr, new_ns_addr);
+					ldns_rr_list_deep_free(old_ns_addr);
+				}
+				ldns_rr_list_deep_free(new_ns_addr);
+			}
+			LDNS_FREE(no_glue);
 			ldns_rr_list_deep_free(new_nss);
 
 			if (ns_addr) {
@@ -430,7 +531,13 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 		   if they match an already trusted DS, or if one of the
 		   keys used to sign these is trusted, add the keys to
 		   the trusted list */
-		p = get_dnssec_pkt(res, labels[i], LDNS_RR_TYPE_DNSKEY);
+		if (i > 1) {
+			get_dnssec_pkts(res, labels[i], &p,
+					labels[i-1], LDNS_RR_TYPE_DS, &next_p);
+		} else {
+			get_dnssec_pkts(res, labels[i], &p,
+					labels[i], t, &next_p);
+		}
 		(void) get_key(p, labels[i], &key_list, &key_sig_list);
 		if (key_sig_list) {
 			if (key_list) {
@@ -501,7 +608,8 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 
 		/* check the DS records for the next child domain */
 		if (i > 1) {
-			p = get_dnssec_pkt(res, labels[i-1], LDNS_RR_TYPE_DS);
+			p = next_p;
+			next_p = NULL;
 			(void) get_ds(p, labels[i-1], &ds_list, &ds_sig_list);
 			if (!ds_list) {
 				ldns_rr_list_deep_free(ds_sig_list);
@@ -658,7 +766,8 @@ do_secure_trace(ldns_resolver *local_res, ldns_rdf *name, ldns_rr_type t,
 			ldns_pkt_free(p);
 		} else {
 			/* if this is the last label, just verify the data and stop */
-			p = get_dnssec_pkt(res, labels[i], t);
+			p = next_p;
+			next_p = NULL;
 			(void) get_dnssec_rr(p, labels[i], t, &dataset, &key_sig_list);
 			if (dataset && ldns_rr_list_rr_count(dataset) > 0) {
 				if (key_sig_list && ldns_rr_list_rr_count(key_sig_list) > 0) {
@@ -184,6 +184,10 @@ ldns_lookup_table ldns_error_str[] = {
 	{ LDNS_STATUS_INVALID_SVCPARAM_VALUE,
 		"Invalid wireformat of a value "
 		"in the ServiceParam rdata field of SVCB or HTTPS RR" },
+	{ LDNS_STATUS_XFR_ERR, "Zone transfer refused or malformed" },
+	{ LDNS_STATUS_NOT_CANONICAL_ORDER,
+		"RRs are not in canonical order" },
+	{ LDNS_STATUS_NO_SOA, "The zone does not start with a SOA RR" },
 	{ 0, NULL }
 };
 
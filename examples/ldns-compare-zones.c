@@ -26,8 +26,8 @@
 static void 
 usage(char *prog)
 {
-	printf("Usage: %s [-v] [-i] [-d] [-c] [-u] [-s] [-e] "
-	       "<zonefile1> <zonefile2>\n", prog);
+	printf("Usage: %s [-v] [-i] [-d] [-c] [-u] [-s] [-e] [-m <MB>] [-x] "
+	       "[-j <threads>]\n       <zonefile1> <zonefile2>\n", prog);
 	printf("       -i - print inserted\n");
 	printf("       -d - print deleted\n");
 	printf("       -c - print changed\n");
@@ -36,35 +36,260 @@ usage(char *prog)
 	printf("       -a - print all differences (-i -d -c)\n");
 	printf("       -s - do not exclude SOA record from comparison\n");
 	printf("       -z - do not sort zones\n");
+	printf("       -m <MB> - sort each zone with at most about <MB> megabytes\n"
+	       "                 of records in memory, in temporary files in $TMPDIR\n");
+	printf("       -x - print the differences as an incremental zone "
+	       "transfer (IXFR)\n");
+	printf("       -j <threads> - with -x, compare with this many threads, "
+	       "or with one\n"
+	       "                 for every CPU when it is 0 (the default)\n");
 	printf("       -e - exit with status 2 on changed zones\n");
 	printf("       -h - show usage and exit\n");
 	printf("       -v - show the version and exit\n");
 }
 
+/*
+ * The records of a zone, one owner name at a time. They come from a sorter
+ * when the zone is sorted, and else straight from the zone file, so only
+ * the records of one name are in memory at once.
+ */
+struct zone_stream {
+	const char	*fn;
+	FILE		*fp;
+	ldns_zone_reader *reader;
+	ldns_rr_sorter	*sorter;
+	int		line_nr;
+	bool		inc_soa, soa_seen;
+	/* the records of the current name, from index i on */
+	ldns_rr_list	*name;
+	size_t		i;
+	/* the first record of the next name */
+	ldns_rr		*next;
+};
+
+static ldns_rr *
+zone_stream_read(struct zone_stream *zs)
+{
+	ldns_rr *rr;
+	ldns_status s;
+
+	while ((s = ldns_zone_reader_next(zs->reader, &rr, &zs->line_nr))
+			== LDNS_STATUS_OK && rr) {
+		if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_SOA) {
+			return rr;
+		}
+		/* like ldns_zone_new_frm_fp(), only the first SOA counts */
+		if (zs->inc_soa && !zs->soa_seen) {
+			zs->soa_seen = true;
+			return rr;
+		}
+		zs->soa_seen = true;
+		ldns_rr_free(rr);
+	}
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: %s at line %d\n",
+			   zs->fn,
+			   ldns_get_errorstr_by_id(s),
+			   zs->line_nr);
+		exit(EXIT_FAILURE);
+	}
+	return NULL;
+}
+
+static ldns_rr *
+zone_stream_next_rr(struct zone_stream *zs)
+{
+	ldns_rr *rr;
+	ldns_status s;
+
+	if (!zs->sorter) {
+		return zone_stream_read(zs);
+	}
+	if ((s = ldns_rr_sorter_next(zs->sorter, &rr)) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: %s\n", zs->fn, ldns_get_errorstr_by_id(s));
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+static void
+zone_stream_next_name(struct zone_stream *zs)
+{
+	ldns_rr *rr;
+	size_t i;
+
+	for (i = 0; i < ldns_rr_list_rr_count(zs->name); i++) {
+		ldns_rr_free(ldns_rr_list_rr(zs->name, i));
+	}
+	ldns_rr_list_set_rr_count(zs->name, 0);
+	zs->i = 0;
+	for (rr = zs->next; rr && (ldns_rr_list_rr_count(zs->name) == 0 ||
+	                           ldns_dname_compare(ldns_rr_owner(rr),
+	                               ldns_rr_owner(ldns_rr_list_rr(zs->name, 0)))
+	                           == 0); rr = zone_stream_next_rr(zs)) {
+		if (!ldns_rr_list_push_rr(zs->name, rr)) {
+			fprintf(stderr, "%s: %s\n", zs->fn,
+			        ldns_get_errorstr_by_id(LDNS_STATUS_MEM_ERR));
+			exit(EXIT_FAILURE);
+		}
+	}
+	zs->next = rr;
+}
+
+static void
+zone_stream_open(struct zone_stream *zs, const char *fn,
+		bool sort, bool inc_soa, size_t max_memory)
+{
+	ldns_rr *rr;
+	ldns_status s;
+
+	memset(zs, 0, sizeof(*zs));
+	zs->fn = fn;
+	zs->inc_soa = inc_soa;
+	zs->fp = fopen(fn, "r");
+	if (!zs->fp) {
+		fprintf(stderr, "Unable to open %s: %s\n", fn, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	zs->reader = ldns_zone_reader_new(zs->fp, NULL, 0, LDNS_RR_CLASS_IN);
+	zs->name = ldns_rr_list_new();
+	if (sort) {
+		zs->sorter = ldns_rr_sorter_new(max_memory, getenv("TMPDIR"));
+	}
+	if (!zs->reader || !zs->name || (sort && !zs->sorter)) {
+		fprintf(stderr, "%s: %s\n", fn,
+		        ldns_get_errorstr_by_id(LDNS_STATUS_MEM_ERR));
+		exit(EXIT_FAILURE);
+	}
+	if (sort) {
+		/* canonicalize and sort the zone */
+		while ((rr = zone_stream_read(zs))) {
+			ldns_rr2canonical(rr);
+			if ((s = ldns_rr_sorter_add(zs->sorter, rr))) {
+				fprintf(stderr, "%s: %s\n", fn,
+				        ldns_get_errorstr_by_id(s));
+				exit(EXIT_FAILURE);
+			}
+		}
+		ldns_zone_reader_free(zs->reader);
+		zs->reader = NULL;
+		fclose(zs->fp);
+		zs->fp = NULL;
+	}
+	zs->next = zone_stream_next_rr(zs);
+	zone_stream_next_name(zs);
+}
+
+/* The current record, or NULL at the end of the zone */
+static ldns_rr *
+zone_stream_rr(const struct zone_stream *zs)
+{
+	return ldns_rr_list_rr(zs->name, zs->i);
+}
+
+/* The records after the current one with the same name */
+static ldns_rr *
+zone_stream_name_rr(const struct zone_stream *zs, size_t n)
+{
+	return ldns_rr_list_rr(zs->name, zs->i + n);
+}
+
+static void
+zone_stream_advance(struct zone_stream *zs)
+{
+	if (++zs->i >= ldns_rr_list_rr_count(zs->name)) {
+		zone_stream_next_name(zs);
+	}
+}
+
+static void
+zone_stream_close(struct zone_stream *zs)
+{
+	ldns_rr_list_deep_free(zs->name);
+	ldns_rr_free(zs->next);
+	ldns_rr_sorter_free(zs->sorter);
+	ldns_zone_reader_free(zs->reader);
+	if (zs->fp) {
+		fclose(zs->fp);
+	}
+}
+
+static ldns_zone *
+read_zone(const char *fn)
+{
+	FILE		*fp;
+	ldns_zone	*z;
+	ldns_status	s;
+	int		line_nr = 0;
+
+	fp = fopen(fn, "r");
+	if (!fp) {
+		fprintf(stderr, "Unable to open %s: %s\n", fn, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	s = ldns_zone_new_frm_fp_l(&z, fp, NULL, 0, LDNS_RR_CLASS_IN, &line_nr);
+	fclose(fp);
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: %s at line %d\n",
+			   fn,
+			   ldns_get_errorstr_by_id(s),
+			   line_nr);
+		exit(EXIT_FAILURE);
+	}
+	return z;
+}
+
+/* Prints the differences from the zone in fn1 to the zone in fn2 as an
+ * IXFR, and returns whether there were any.
+ */
+static bool
+print_ixfr(const char *fn1, const char *fn2)
+{
+	ldns_zone	*z1, *z2;
+	ldns_zone_diff	*diff;
+	ldns_status	s;
+	bool		changed;
+
+	z1 = read_zone(fn1);
+	z2 = read_zone(fn2);
+	s = ldns_zone_diff_new_frm_zones(&diff, z1, z2);
+	ldns_zone_deep_free(z1);
+	ldns_zone_deep_free(z2);
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s\n", ldns_get_errorstr_by_id(s));
+		exit(EXIT_FAILURE);
+	}
+	if (ldns_zone_diff_print_ixfr(stdout, ldns_output_format_default,
+	                              diff) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: no SOA record\n",
+		        diff->old_soa ? fn2 : fn1);
+		exit(EXIT_FAILURE);
+	}
+	changed = ldns_zone_diff_has_changes(diff);
+	ldns_zone_diff_free(diff);
+	return changed;
+}
+
 int 
 main(int argc, char **argv)
 {
 	char           *fn1, *fn2;
-	FILE           *fp1, *fp2;
-	ldns_zone      *z1, *z2;
-	ldns_status	s;
-	size_t		i      , j;
-	size_t		k      , l;
+	struct zone_stream zs1, zs2;
+	size_t		k;
 	size_t		nc1    , nc2;
-	ldns_rr_list   *rrl1, *rrl2;
 	int		rr_cmp, rr_chg = 0;
-	ldns_rr        *rr1 = NULL, *rr2 = NULL, *rrx = NULL;
-	int		line_nr1 = 0, line_nr2 = 0;
-	size_t		rrc1   , rrc2;
+	ldns_rr        *rr1 = NULL, *rr2 = NULL;
+	ldns_rdf       *owner_x = NULL;
 	size_t		num_ins = 0, num_del = 0, num_chg = 0, num_eq = 0;
+	size_t		max_memory = 0;
 	int		c;
 	bool		opt_deleted = false, opt_inserted  = false;
 	bool            opt_changed = false, opt_unchanged = false, opt_Unchanged = false;
         bool		sort = true, inc_soa = false;
-	bool		opt_exit_status = false;
+	bool		opt_exit_status = false, opt_ixfr = false;
 	char		op = 0;
 
-	while ((c = getopt(argc, argv, "ahvdicuUesz")) != -1) {
+	while ((c = getopt(argc, argv, "ahvdicuUesm:xj:z")) != -1) {
 		switch (c) {
 		case 'h':
 			usage(argv[0]);
@@ -83,6 +308,15 @@ main(int argc, char **argv)
 		case 's':
 			inc_soa = true;
 			break;
+		case 'm':
+			max_memory = (size_t) strtoul(optarg, NULL, 10) << 20;
+			break;
+		case 'x':
+			opt_ixfr = true;
+			break;
+		case 'j':
+			ldns_rr_list_sort_set_threads((size_t) atol(optarg));
+			break;
 		case 'z':
 			sort = false;
                         break;
@@ -123,122 +357,51 @@ main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 	fn1 = argv[0];
-	fp1 = fopen(fn1, "r");
-	if (!fp1) {
-		fprintf(stderr, "Unable to open %s: %s\n", fn1, strerror(errno));
-		exit(EXIT_FAILURE);
-	}
-	/* Read first zone */
-	s = ldns_zone_new_frm_fp_l(&z1, fp1, NULL, 0, 
-						  LDNS_RR_CLASS_IN, &line_nr1);
-	if (s != LDNS_STATUS_OK) {
-		fclose(fp1);
-		fprintf(stderr, "%s: %s at line %d\n",
-			   fn1,
-			   ldns_get_errorstr_by_id(s),
-			   line_nr1);
-		exit(EXIT_FAILURE);
-	}
-	fclose(fp1);
-
 	fn2 = argv[1];
-	fp2 = fopen(fn2, "r");
-	if (!fp2) {
-		fprintf(stderr, "Unable to open %s: %s\n", fn2, strerror(errno));
-		exit(EXIT_FAILURE);
-	}
-	/* Read second zone */
-	s = ldns_zone_new_frm_fp_l(&z2, fp2, NULL, 0,
-						  LDNS_RR_CLASS_IN, &line_nr2);
-	if (s != LDNS_STATUS_OK) {
-		ldns_zone_deep_free(z1);
-		fclose(fp2);
-		fprintf(stderr, "%s: %s at line %d\n",
-			   fn2,
-			   ldns_get_errorstr_by_id(s),
-			   line_nr2);
-		exit(EXIT_FAILURE);
-	}
-	fclose(fp2);
-
-	rrl1 = ldns_zone_rrs(z1);
-	rrc1 = ldns_rr_list_rr_count(rrl1);
-
-	rrl2 = ldns_zone_rrs(z2);
-	rrc2 = ldns_rr_list_rr_count(rrl2);
 
-        if (sort) {
-		/* canonicalize zone 1 */
-		ldns_rr2canonical(ldns_zone_soa(z1));
-                for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(z1)); i++) {
-                	ldns_rr2canonical(ldns_rr_list_rr(ldns_zone_rrs(z1), i));
-		}
-                /* sort zone 1 */
-                ldns_zone_sort(z1);
-		/* canonicalize zone 2 */
-		ldns_rr2canonical(ldns_zone_soa(z2));
-                for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(z2)); i++) {
-                	ldns_rr2canonical(ldns_rr_list_rr(ldns_zone_rrs(z2), i));
-		}
-                /* sort zone 2 */
-                ldns_zone_sort(z2);
-        }
-
-	if(inc_soa) {
-		ldns_rr_list* wsoa = ldns_rr_list_new();
-		ldns_rr_list_push_rr(wsoa, ldns_zone_soa(z1));
-		ldns_rr_list_cat(wsoa, rrl1);
-		rrl1 = wsoa;
-		rrc1 = ldns_rr_list_rr_count(rrl1);
-		wsoa = ldns_rr_list_new();
-		ldns_rr_list_push_rr(wsoa, ldns_zone_soa(z2));
-		ldns_rr_list_cat(wsoa, rrl2);
-		rrl2 = wsoa;
-		rrc2 = ldns_rr_list_rr_count(rrl2);
-		if(sort) {
-			ldns_rr_list_sort(rrl1);
-			ldns_rr_list_sort(rrl2);
-		}
+	if (opt_ixfr) {
+		return print_ixfr(fn1, fn2) && opt_exit_status ? 2 : 0;
 	}
 
+	/* Read, and when sorting canonicalize and sort, the zones. With
+	 * -s the SOA is compared as one of the records.
+	 */
+	zone_stream_open(&zs1, fn1, sort, inc_soa, max_memory);
+	zone_stream_open(&zs2, fn2, sort, inc_soa, max_memory);
+
 	/*
-	 * Walk through both zones. The previously seen resource record is
-	 * kept (in the variable rrx) so that we can recognize when we are
-	 * handling a new owner name. If the owner name changes, we have to
-	 * set the operator again.
+	 * Walk through both zones. The owner name of the previously seen
+	 * resource record is kept (in the variable owner_x) so that we can
+	 * recognize when we are handling a new owner name. If the owner name
+	 * changes, we have to set the operator again.
 	 */
-	for (i = 0, j = 0; i < rrc1 || j < rrc2;) {
+	while ((rr1 = zone_stream_rr(&zs1)) || zone_stream_rr(&zs2)) {
+		rr2 = zone_stream_rr(&zs2);
 		rr_cmp = 0;
-		if (i < rrc1 && j < rrc2) {
-			rr1 = ldns_rr_list_rr(rrl1, i);
-			rr2 = ldns_rr_list_rr(rrl2, j);
+		if (rr1 && rr2) {
 			rr_cmp = ldns_rr_compare(rr1, rr2);
 
 			rr_chg = ldns_dname_compare(ldns_rr_owner(rr1),
 								   ldns_rr_owner(rr2));
-		} else if (i >= rrc1) {
+		} else if (!rr1) {
 			/* we have reached the end of zone 1, so the current record
 			 * from zone 2 automatically sorts higher
 			 */
-			rr1 = NULL;
-			rr2 = ldns_rr_list_rr(rrl2, j);
 			rr_chg = rr_cmp = 1;
-		} else if (j >= rrc2) {
+		} else {
 			/* we have reached the end of zone 2, so the current record
 			 * from zone 1 automatically sorts lower
 			 */
-			rr1 = ldns_rr_list_rr(rrl1, i);
-			rr2 = NULL;
 			rr_chg = rr_cmp = -1;
 		}
 		if (rr_cmp < 0) {
-			if ((rrx != NULL) && (ldns_dname_compare(ldns_rr_owner(rr1), 
-											 ldns_rr_owner(rrx)
-											 ) != 0)) {
+			if (owner_x && ldns_dname_compare(ldns_rr_owner(rr1),
+			                                  owner_x) != 0) {
 				/* The owner name is different, forget previous rr */
-				rrx = NULL;
+				ldns_rdf_deep_free(owner_x);
+				owner_x = NULL;
 			}
-			if (rrx == NULL) {
+			if (owner_x == NULL) {
 				if (rr_chg == 0) {
 					num_chg++;
 					op = OP_CHG;
@@ -246,21 +409,21 @@ main(int argc, char **argv)
 					num_del++;
 					op = OP_DEL;
 				}
-				rrx = rr1;
+				owner_x = ldns_rdf_clone(ldns_rr_owner(rr1));
 			}
 			if (((op == OP_DEL) && opt_deleted) ||
 			    ((op == OP_CHG) && opt_changed)) {
 				printf("%c-", op);
 				ldns_rr_print(stdout, rr1);
 			}
-			i++;
+			zone_stream_advance(&zs1);
 		} else if (rr_cmp > 0) {
-			if ((rrx != NULL) && (ldns_dname_compare(ldns_rr_owner(rr2),
-											 ldns_rr_owner(rrx)
-											 ) != 0)) {
-				rrx = NULL;
+			if (owner_x && ldns_dname_compare(ldns_rr_owner(rr2),
+			                                  owner_x) != 0) {
+				ldns_rdf_deep_free(owner_x);
+				owner_x = NULL;
 			}
-			if (rrx == NULL) {
+			if (owner_x == NULL) {
 				if (rr_chg == 0) {
 					num_chg++;
 					op = OP_CHG;
@@ -269,49 +432,37 @@ main(int argc, char **argv)
 					op = OP_INS;
 				}
 				/* remember this rr for it's name in the next iteration */
-				rrx = rr2;
+				owner_x = ldns_rdf_clone(ldns_rr_owner(rr2));
 			}
 			if (((op == OP_INS) && opt_inserted) ||
 			    ((op == OP_CHG) && opt_changed)) {
 				printf("%c+", op);
 				ldns_rr_print(stdout, rr2);
 			}
-			j++;
+			zone_stream_advance(&zs2);
 		} else {
-			if ((rrx != NULL) && (ldns_dname_compare(ldns_rr_owner(rr1),
-											 ldns_rr_owner(rrx)
-											 ) != 0)) {
-				rrx = NULL;
+			if (owner_x && ldns_dname_compare(ldns_rr_owner(rr1),
+			                                  owner_x) != 0) {
+				ldns_rdf_deep_free(owner_x);
+				owner_x = NULL;
 			}
-			if (rrx == NULL) {
-				rrx = rr1;
+			if (owner_x == NULL) {
+				owner_x = ldns_rdf_clone(ldns_rr_owner(rr1));
 
 				/* Are all rrs with this name equal? */
-				for ( k = i + 1
-				    ; k < rrc1 &&
-				      ldns_dname_compare(ldns_rr_owner(rr1), 
-					                 ldns_rr_owner(ldns_rr_list_rr(rrl1, k))) == 0
-				    ; k++);
-                                
-
-				for ( l = j + 1
-				    ; l < rrc2 &&
-				      ldns_dname_compare(ldns_rr_owner(rr2), 
-					                 ldns_rr_owner(ldns_rr_list_rr(rrl2, l))) == 0
-				    ; l++);
-
-				if ((k - i) != (l - j)) {
+				nc1 = ldns_rr_list_rr_count(zs1.name) - zs1.i;
+				nc2 = ldns_rr_list_rr_count(zs2.name) - zs2.i;
+
+				if (nc1 != nc2) {
 					op = OP_CHG;
 					num_chg++;
 				} else {
-					nc1 = k - i;
-					nc2 = l - j;
-					for ( k = i + 1, l = j + 1
-					    ; (k - i) < nc1 && (l - j) < nc2 &&
-							ldns_rr_compare(ldns_rr_list_rr(rrl1, k),
-							ldns_rr_list_rr(rrl2, l)) == 0
-					    ; k++, l++);
-					if ((k - i) < nc1) {
+					for ( k = 1
+					    ; k < nc1 &&
+							ldns_rr_compare(zone_stream_name_rr(&zs1, k),
+							zone_stream_name_rr(&zs2, k)) == 0
+					    ; k++);
+					if (k < nc1) {
 						op = OP_CHG;
 						num_chg++;
                                        } else {
@@ -325,8 +476,8 @@ main(int argc, char **argv)
 				printf("%c=", op);
 				ldns_rr_print(stdout, rr1);
 			}
-			i++;
-			j++;
+			zone_stream_advance(&zs1);
+			zone_stream_advance(&zs2);
 		}
 	}
 
@@ -350,12 +501,11 @@ main(int argc, char **argv)
 			  (unsigned int) num_chg);
 
 	/* Free resources */
-	if(inc_soa) {
-		ldns_rr_list_free(rrl1);
-		ldns_rr_list_free(rrl2);
+	if (owner_x) {
+		ldns_rdf_deep_free(owner_x);
 	}
-	ldns_zone_deep_free(z2);
-	ldns_zone_deep_free(z1);
+	zone_stream_close(&zs2);
+	zone_stream_close(&zs1);
 
 	return opt_exit_status && (num_ins || num_del || num_chg) ? 2 : 0;
 }
@@ -33,6 +33,9 @@ static void print_usage(const char* progname)
 	printf("\t\tThis option may be given multiple times.\n");
 	printf("\t\t-E is not meant to be used together with -e.\n");
 	printf("\t-h show this text\n");
+	printf("\t-m <MB>\n");
+	printf("\t\tSort (-z) with at most about <MB> megabytes of RRs in\n"
+	       "\t\tmemory, and the rest in temporary files in $TMPDIR.\n");
 	printf("\t-n do not print the SOA record\n");
 	printf("\t-p prepend SOA serial with spaces so"
 		" it takes exactly ten characters.\n");
@@ -109,6 +112,188 @@ fail:
 	exit(EXIT_FAILURE);
 }
 
+/* Reads and prints the zone one RR at a time, so the memory used does not
+ * grow with the size of the zone. Only RRs that come before the SOA in the
+ * zone file are held back, because the SOA is printed first. The output
+ * goes to a temporary file first, so that nothing is printed when the zone
+ * has an error, like when it is read as a whole.
+ */
+static void
+print_zone(FILE *fp, const ldns_output_format *fmt,
+		const ldns_rdf *show_types, bool print_soa, bool canonicalize,
+		ldns_soa_serial_increment_func_t soa_serial_increment_func,
+		int soa_serial_increment_func_data)
+{
+	ldns_zone_reader *reader;
+	ldns_rr_list *before_soa;
+	ldns_rr *cur_rr;
+	bool soa_seen = false;
+	int line_nr = 0;
+	ldns_status s;
+	FILE *out;
+	char buf[8192];
+	size_t n;
+
+	reader = ldns_zone_reader_new(fp, NULL, 0, LDNS_RR_CLASS_IN);
+	before_soa = ldns_rr_list_new();
+	if (!reader || !before_soa) {
+		fprintf(stderr, "%s\n",
+		        ldns_get_errorstr_by_id(LDNS_STATUS_MEM_ERR));
+		exit(EXIT_FAILURE);
+	}
+	if (!(out = tmpfile())) {
+		fprintf(stderr, "Unable to create a temporary file: %s\n",
+				strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (show_types && print_soa)
+		print_soa = ldns_nsec_bitmap_covers_type(show_types,
+				LDNS_RR_TYPE_SOA);
+
+	while ((s = ldns_zone_reader_next(reader, &cur_rr, &line_nr))
+			== LDNS_STATUS_OK && cur_rr) {
+		if (ldns_rr_get_type(cur_rr) == LDNS_RR_TYPE_SOA) {
+			/* like ldns_zone_new_frm_fp(), only the first SOA */
+			if (!soa_seen && print_soa) {
+				if (canonicalize)
+					ldns_rr2canonical(cur_rr);
+				if (soa_serial_increment_func) {
+					ldns_rr_soa_increment_func_int(
+							cur_rr
+						, soa_serial_increment_func
+						, soa_serial_increment_func_data
+						);
+				}
+				ldns_rr_print_fmt(out, fmt, cur_rr);
+			}
+			ldns_rr_free(cur_rr);
+			if (!soa_seen) {
+				ldns_rr_list_print_fmt(out, fmt, before_soa);
+				ldns_rr_list_deep_free(before_soa);
+				before_soa = NULL;
+				soa_seen = true;
+			}
+			continue;
+		}
+		if (show_types && !ldns_nsec_bitmap_covers_type(show_types,
+					ldns_rr_get_type(cur_rr))) {
+			ldns_rr_free(cur_rr);
+			continue;
+		}
+		if (canonicalize)
+			ldns_rr2canonical(cur_rr);
+		if (soa_seen) {
+			ldns_rr_print_fmt(out, fmt, cur_rr);
+			ldns_rr_free(cur_rr);
+		} else if (!ldns_rr_list_push_rr(before_soa, cur_rr)) {
+			s = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+	}
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s at line %d\n", 
+				ldns_get_errorstr_by_id(s),
+				line_nr);
+                exit(EXIT_FAILURE);
+	}
+	/* a zone without SOA */
+	ldns_rr_list_print_fmt(out, fmt, before_soa);
+	ldns_rr_list_deep_free(before_soa);
+	ldns_zone_reader_free(reader);
+	fclose(fp);
+
+	rewind(out);
+	while ((n = fread(buf, 1, sizeof(buf), out)) > 0) {
+		if (fwrite(buf, 1, n, stdout) != n) {
+			break;
+		}
+	}
+	if (ferror(out) || ferror(stdout)) {
+		fprintf(stderr, "Unable to print the zone: %s\n",
+				strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fclose(out);
+}
+
+/* Reads, sorts and prints the zone like main() does with -z, but with the
+ * RRs in a sorter, so at most about max_memory bytes of them are in memory.
+ */
+static void
+print_sorted_zone(FILE *fp, const ldns_output_format *fmt,
+		const ldns_rdf *show_types, bool print_soa,
+		ldns_soa_serial_increment_func_t soa_serial_increment_func,
+		int soa_serial_increment_func_data, size_t max_memory)
+{
+	ldns_zone_reader *reader;
+	ldns_rr_sorter *sorter;
+	ldns_rr *soa = NULL, *cur_rr;
+	int line_nr = 0;
+	ldns_status s;
+
+	reader = ldns_zone_reader_new(fp, NULL, 0, LDNS_RR_CLASS_IN);
+	sorter = ldns_rr_sorter_new(max_memory, getenv("TMPDIR"));
+	if (!reader || !sorter) {
+		fprintf(stderr, "%s\n",
+		        ldns_get_errorstr_by_id(LDNS_STATUS_MEM_ERR));
+		exit(EXIT_FAILURE);
+	}
+	while ((s = ldns_zone_reader_next(reader, &cur_rr, &line_nr))
+			== LDNS_STATUS_OK && cur_rr) {
+		if (ldns_rr_get_type(cur_rr) == LDNS_RR_TYPE_SOA) {
+			/* like ldns_zone_new_frm_fp(), only the first SOA */
+			if (soa)
+				ldns_rr_free(cur_rr);
+			else
+				soa = cur_rr;
+			continue;
+		}
+		if (show_types && !ldns_nsec_bitmap_covers_type(show_types,
+					ldns_rr_get_type(cur_rr))) {
+			ldns_rr_free(cur_rr);
+			continue;
+		}
+		ldns_rr2canonical(cur_rr);
+		if ((s = ldns_rr_sorter_add(sorter, cur_rr)) != LDNS_STATUS_OK)
+			break;
+	}
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s at line %d\n", 
+				ldns_get_errorstr_by_id(s),
+				line_nr);
+                exit(EXIT_FAILURE);
+	}
+	ldns_zone_reader_free(reader);
+	fclose(fp);
+
+	if (show_types && print_soa)
+		print_soa = ldns_nsec_bitmap_covers_type(show_types,
+				LDNS_RR_TYPE_SOA);
+	if (print_soa && soa) {
+		ldns_rr2canonical(soa);
+		if (soa_serial_increment_func) {
+			ldns_rr_soa_increment_func_int(
+					soa
+				, soa_serial_increment_func
+				, soa_serial_increment_func_data
+				);
+		}
+		ldns_rr_print_fmt(stdout, fmt, soa);
+	}
+	ldns_rr_free(soa);
+
+	while ((s = ldns_rr_sorter_next(sorter, &cur_rr)) == LDNS_STATUS_OK
+			&& cur_rr) {
+		ldns_rr_print_fmt(stdout, fmt, cur_rr);
+		ldns_rr_free(cur_rr);
+	}
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s\n", ldns_get_errorstr_by_id(s));
+                exit(EXIT_FAILURE);
+	}
+	ldns_rr_sorter_free(sorter);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -130,8 +315,9 @@ main(int argc, char **argv)
 
 	ldns_soa_serial_increment_func_t soa_serial_increment_func = NULL;
 	int soa_serial_increment_func_data = 0;
+	size_t max_memory = 0;
 
-        while ((c = getopt(argc, argv, "0bcde:E:hnpsS:u:U:vz")) != -1) {
+        while ((c = getopt(argc, argv, "0bcde:E:hm:npsS:u:U:vz")) != -1) {
                 switch(c) {
 			case '0':
 				fmt->flags |= LDNS_FMT_ZEROIZE_RRSIGS;
@@ -160,6 +346,10 @@ main(int argc, char **argv)
 			case 'h':
 				print_usage("ldns-read-zone");
 				break;
+			case 'm':
+				max_memory = (size_t) strtoul(optarg, NULL, 10)
+				           << 20;
+				break;
 			case 'n':
 				print_soa = false;
 				break;
@@ -253,6 +443,19 @@ main(int argc, char **argv)
 			exit(EXIT_FAILURE);
 		}
 	}
+
+	if (!sort) {
+		print_zone(fp, fmt, show_types, print_soa, canonicalize,
+				soa_serial_increment_func,
+				soa_serial_increment_func_data);
+		exit(EXIT_SUCCESS);
+	}
+	if (max_memory) {
+		print_sorted_zone(fp, fmt, show_types, print_soa,
+				soa_serial_increment_func,
+				soa_serial_increment_func_data, max_memory);
+		exit(EXIT_SUCCESS);
+	}
 	
 	s = ldns_zone_new_frm_fp_l(&z, fp, NULL, 0, LDNS_RR_CLASS_IN, &line_nr);
 
@@ -279,15 +482,12 @@ main(int argc, char **argv)
 		ldns_zone_set_rrs(z, stripped_list);
 	}
 
-	if (canonicalize) {
-		ldns_rr2canonical(ldns_zone_soa(z));
-		for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(z)); i++) {
-			ldns_rr2canonical(ldns_rr_list_rr(ldns_zone_rrs(z), i));
-		}
-	}
-	if (sort) {
-		ldns_zone_sort(z);
+	/* sorting implies canonicalizing */
+	ldns_rr2canonical(ldns_zone_soa(z));
+	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(z)); i++) {
+		ldns_rr2canonical(ldns_rr_list_rr(ldns_zone_rrs(z), i));
 	}
+	ldns_zone_sort(z);
 
 	if (print_soa && ldns_zone_soa(z)) {
 		if (soa_serial_increment_func) {
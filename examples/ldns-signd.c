@@ -0,0 +1,197 @@
+/*
+ * ldns-signd makes signatures for ldns-signzone -B
+ *
+ * A signer that listens on a Unix domain socket, to show how the
+ * signatures of a zone can be made in another process, for example one
+ * that holds the keys.
+ *
+ * (c) NLnet Labs, 2024
+ * See the file LICENSE for the license
+ */
+
+#include <stdio.h>
+
+#include "config.h"
+
+#if defined(HAVE_SSL) && defined(HAVE_SYS_UN_H)
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <ldns/ldns.h>
+
+static void
+usage(FILE *fp, const char *prog)
+{
+	fprintf(fp, "%s [OPTIONS] <socket> <key> [<key> ...]\n", prog);
+	fprintf(fp, "  listens on the Unix domain socket and makes the signatures that\n");
+	fprintf(fp, "  ldns-signzone -S -B <socket> asks for, with the given key(s)\n");
+	fprintf(fp, "  -j <threads>\tsign with this many threads, or with one for every\n");
+	fprintf(fp, "\t\tCPU when it is 0 (the default)\n");
+	fprintf(fp, "  -n <count>\texit after serving this many connections\n");
+	fprintf(fp, "  -v\t\tprint version and exit\n");
+	fprintf(fp, "  keys must be specified by their base name (usually K<name>+<alg>+<id>),\n");
+	fprintf(fp, "  and both <base name>.private and <base name>.key must exist.\n");
+}
+
+/* Reads the private key, and its owner, flags and key tag from the
+ * DNSKEY RR in the .key file, which are what a signer finds it by.
+ */
+static ldns_key *
+read_key(const char *base)
+{
+	char filename[256];
+	ldns_key *key = NULL;
+	ldns_rr *pubkey = NULL;
+	ldns_status s;
+	FILE *fp;
+
+	snprintf(filename, sizeof(filename), "%s.private", base);
+	if (!(fp = fopen(filename, "r"))) {
+		fprintf(stderr, "Unable to open %s: %s\n",
+			filename, strerror(errno));
+		return NULL;
+	}
+	s = ldns_key_new_frm_fp(&key, fp);
+	fclose(fp);
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "Unable to read key from %s: %s\n",
+			filename, ldns_get_errorstr_by_id(s));
+		return NULL;
+	}
+	snprintf(filename, sizeof(filename), "%s.key", base);
+	if (!(fp = fopen(filename, "r"))) {
+		fprintf(stderr, "Unable to open %s: %s\n",
+			filename, strerror(errno));
+		ldns_key_deep_free(key);
+		return NULL;
+	}
+	s = ldns_rr_new_frm_fp(&pubkey, fp, NULL, NULL, NULL);
+	fclose(fp);
+	if (s != LDNS_STATUS_OK ||
+	    ldns_rr_get_type(pubkey) != LDNS_RR_TYPE_DNSKEY) {
+		fprintf(stderr, "No DNSKEY RR in %s\n", filename);
+		ldns_rr_free(pubkey);
+		ldns_key_deep_free(key);
+		return NULL;
+	}
+	ldns_key_set_pubkey_owner(key,
+			ldns_rdf_clone(ldns_rr_owner(pubkey)));
+	ldns_key_set_flags(key, ldns_rdf2native_int16(ldns_rr_rdf(pubkey, 0)));
+	ldns_key_set_keytag(key, ldns_calc_keytag(pubkey));
+	ldns_rr_free(pubkey);
+	return key;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *prog = argv[0];
+	ldns_key_list *keys;
+	ldns_key *key;
+	ldns_sign_backend *backend = NULL;
+	ldns_status s;
+	struct sockaddr_un addr;
+	size_t threads = 0;
+	long count = 0, served = 0;
+	int c, fd, conn;
+
+	while ((c = getopt(argc, argv, "hj:n:v")) != -1) {
+		switch (c) {
+		case 'h':
+			usage(stdout, prog);
+			exit(EXIT_SUCCESS);
+		case 'j':
+			threads = (size_t) atol(optarg);
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'v':
+			printf("ldns-signd version %s (ldns version %s)\n",
+				LDNS_VERSION, ldns_version());
+			exit(EXIT_SUCCESS);
+		default:
+			usage(stderr, prog);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 2) {
+		usage(stderr, prog);
+		exit(EXIT_FAILURE);
+	}
+	if (strlen(argv[0]) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path %s is too long\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	keys = ldns_key_list_new();
+	for (c = 1; c < argc; c++) {
+		if (!(key = read_key(argv[c]))) {
+			exit(EXIT_FAILURE);
+		}
+		ldns_key_list_push_key(keys, key);
+	}
+	s = ldns_sign_backend_new_openssl(&backend, threads);
+	if (s != LDNS_STATUS_OK) {
+		fprintf(stderr, "Unable to set up signing: %s\n",
+			ldns_get_errorstr_by_id(s));
+		exit(EXIT_FAILURE);
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		fprintf(stderr, "socket: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, argv[0], sizeof(addr.sun_path) - 1);
+	(void) unlink(argv[0]);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+	    listen(fd, 5) == -1) {
+		fprintf(stderr, "Unable to listen on %s: %s\n",
+			argv[0], strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	/* one connection at a time; the backend signs its batches in
+	 * several threads */
+	while (count == 0 || served < count) {
+		if ((conn = accept(fd, NULL, NULL)) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "accept: %s\n", strerror(errno));
+			break;
+		}
+		s = ldns_sign_backend_serve(conn, backend, keys);
+		if (s != LDNS_STATUS_OK) {
+			fprintf(stderr, "Error serving a connection: %s\n",
+				ldns_get_errorstr_by_id(s));
+		}
+		close(conn);
+		served++;
+	}
+	close(fd);
+	(void) unlink(argv[0]);
+	ldns_sign_backend_free(backend);
+	ldns_key_list_free(keys);
+	return served == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else /* !HAVE_SSL || !HAVE_SYS_UN_H */
+int
+main(int argc __attribute__((unused)),
+     char **argv __attribute__((unused)))
+{
+	fprintf(stderr, "ldns-signd needs OpenSSL support and Unix domain "
+	                "sockets, which have not been compiled in\n");
+	return 1;
+}
+#endif /* HAVE_SSL && HAVE_SYS_UN_H */
@@ -37,11 +37,22 @@ usage(FILE *fp, const char *prog) {
 	fprintf(fp, "%s [OPTIONS] zonefile key [key [key]]\n", prog);
 	fprintf(fp, "  signs the zone with the given key(s)\n");
 	fprintf(fp, "  -b\t\tuse layout in signed zone and print comments DNSSEC records\n");
+	fprintf(fp, "  -B <socket>\twith -S, have the signatures made by the signer\n");
+	fprintf(fp, "\t\tthat listens on this Unix domain socket\n");
+	fprintf(fp, "  -C <file>\treuse the signatures in this file of RRsets that\n");
+	fprintf(fp, "\t\tdid not change, and write the signatures to it\n");
 	fprintf(fp, "  -d\t\tused keys are not added to the zone\n");
 	fprintf(fp, "  -e <date>\texpiration date\n");
 	fprintf(fp, "  -f <file>\toutput zone to file (default <name>.signed)\n");
 	fprintf(fp, "  -i <date>\tinception date\n");
+	fprintf(fp, "  -j <threads>\twith -S, sign with this many threads, or with one\n");
+	fprintf(fp, "\t\tfor every CPU when it is 0\n");
+	fprintf(fp, "  -m <MB>\twith -S and -n, the NSEC3s may take this many\n");
+	fprintf(fp, "\t\tmegabytes of memory before they go to a temporary file\n");
+	fprintf(fp, "\t\t(default 256)\n");
 	fprintf(fp, "  -o <domain>\torigin for the zone\n");
+	fprintf(fp, "  -S\t\tthe zone is sorted in canonical order, sign it one\n");
+	fprintf(fp, "\t\tname at a time without reading it all in memory\n");
 	fprintf(fp, "  -u\t\tset SOA serial to the number of seconds since 1-1-1970\n");
 	fprintf(fp, "  -v\t\tprint version and exit\n");
 	fprintf(fp, "  -z <[scheme:]hash>\tAdd ZONEMD resource record\n");
@@ -564,6 +575,84 @@ shutdown_openssl ( ENGINE * const e )
 }
 #endif
 
+/* Reads the RRs of the apex of a sorted zone into zone, for the keys, and
+ * returns the first RR after them in next_rr. The rest of the zone is
+ * left to the reader.
+ */
+static ldns_status
+read_zone_apex(ldns_zone **zone, ldns_zone_reader **reader, ldns_rr **next_rr,
+		FILE *fp, const ldns_rdf *origin, uint32_t ttl,
+		ldns_rr_class class, int *line_nr)
+{
+	ldns_rdf *apex = NULL;
+	ldns_rr *rr;
+	ldns_status s;
+
+	*next_rr = NULL;
+	*reader = ldns_zone_reader_new(fp, origin, ttl, class);
+	*zone = ldns_zone_new();
+	if (!*reader || !*zone) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	while ((s = ldns_zone_reader_next(*reader, &rr, line_nr))
+			== LDNS_STATUS_OK && rr) {
+		if (!apex && !(apex = ldns_rdf_clone(ldns_rr_owner(rr)))) {
+			ldns_rr_free(rr);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		if (ldns_dname_compare(ldns_rr_owner(rr), apex) != 0) {
+			*next_rr = rr;
+			break;
+		}
+		if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA &&
+		    !ldns_zone_soa(*zone)) {
+			ldns_zone_set_soa(*zone, rr);
+
+		} else if (!ldns_zone_push_rr(*zone, rr)) {
+			ldns_rr_free(rr);
+			s = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+	}
+	ldns_rdf_deep_free(apex);
+	return s;
+}
+
+/* Signs the apex read by read_zone_apex(), and the rest of the zone */
+static ldns_status
+sign_zone_sorted(ldns_dnssec_zone_signer *signer, ldns_zone *zone,
+		ldns_zone_reader *reader, ldns_rr *next_rr, int *line_nr)
+{
+	ldns_rr *rr;
+	size_t i;
+	ldns_status s;
+
+	if ((s = ldns_dnssec_zone_signer_add_rr(signer,
+				ldns_rr_ref(ldns_zone_soa(zone))))) {
+		ldns_rr_free(ldns_zone_soa(zone));
+		ldns_rr_free(next_rr);
+		return s;
+	}
+	for (i = 0; i < ldns_zone_rr_count(zone); i++) {
+		rr = ldns_rr_ref(ldns_rr_list_rr(ldns_zone_rrs(zone), i));
+		if ((s = ldns_dnssec_zone_signer_add_rr(signer, rr))) {
+			ldns_rr_free(rr);
+			ldns_rr_free(next_rr);
+			return s;
+		}
+	}
+	for (rr = next_rr; rr; ) {
+		if ((s = ldns_dnssec_zone_signer_add_rr(signer, rr))) {
+			ldns_rr_free(rr);
+			return s;
+		}
+		if ((s = ldns_zone_reader_next(reader, &rr, line_nr))) {
+			return s;
+		}
+	}
+	return ldns_dnssec_zone_signer_finish(signer);
+}
+
 int str2zonemd_signflag(const char *str, const char **reason)
 {
 	char *colon;
@@ -614,6 +703,9 @@ main(int argc, char *argv[])
 	ldns_rr_list *orig_rrs = NULL;
 	ldns_rr *orig_soa = NULL;
 	ldns_dnssec_zone *signed_zone;
+	ldns_dnssec_zone_signer *signer = NULL;
+	ldns_zone_reader *reader = NULL;
+	ldns_rr *next_rr = NULL;
 
 	char *keyfile_name_base;
 	char *keyfile_name = NULL;
@@ -634,6 +726,15 @@ main(int argc, char *argv[])
 	bool use_nsec3 = false;
 	int signflags = 0;
 	bool unixtime_serial = false;
+	bool sorted_input = false;
+	size_t max_memory = 256;
+	const char *sign_cache_name = NULL;
+	ldns_sign_cache *sign_cache = NULL;
+	const char *sign_socket_name = NULL;
+	bool sign_threaded = false;
+	size_t sign_threads = 0;
+	ldns_sign_backend *sign_backend = NULL;
+	ldns_sign_ctx *sign_ctx = NULL;
 
 	/* Add the given keys to the zone if they are not yet present */
 	bool add_keys = true;
@@ -669,7 +770,7 @@ main(int argc, char *argv[])
 	
 	keys = ldns_key_list_new();
 
-	while ((c = getopt(argc, argv, "a:bde:f:i:k:no:ps:t:uvz:ZAUE:K:")) != -1) {
+	while ((c = getopt(argc, argv, "a:bB:C:de:f:i:j:k:m:no:ps:t:uvz:ZAUSE:K:")) != -1) {
 		switch (c) {
 		case 'a':
 			nsec3_algorithm = (uint8_t) atoi(optarg);
@@ -678,6 +779,12 @@ main(int argc, char *argv[])
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'B':
+			sign_socket_name = optarg;
+			break;
+		case 'C':
+			sign_cache_name = optarg;
+			break;
 		case 'b':
 			ldns_output_format_set(fmt, LDNS_COMMENT_FLAGS
 						  | LDNS_COMMENT_LAYOUT      
@@ -741,6 +848,13 @@ main(int argc, char *argv[])
 				inception = (uint32_t) atol(optarg);
 			}
 			break;
+		case 'j':
+			sign_threaded = true;
+			sign_threads = (size_t) atol(optarg);
+			break;
+		case 'm':
+			max_memory = (size_t) atol(optarg);
+			break;
 		case 'n':
 			use_nsec3 = true;
 			break;
@@ -807,6 +921,9 @@ main(int argc, char *argv[])
 		case 'U':
 			signflags |= LDNS_SIGN_WITH_ALL_ALGORITHMS;
 			break;
+		case 'S':
+			sorted_input = true;
+			break;
 		case 's':
 			if (strlen(optarg) % 2 != 0) {
 				fprintf(stderr, "Salt value is not valid hex data, not a multiple of 2 characters\n");
@@ -842,6 +959,20 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
+	if (sorted_input && (signflags & (LDNS_SIGN_WITH_ZONEMD_SIMPLE_SHA384
+	                                | LDNS_SIGN_WITH_ZONEMD_SIMPLE_SHA512))) {
+		fprintf(stderr, "A ZONEMD can not be added with -S\n");
+		exit(EXIT_FAILURE);
+	}
+	if ((sign_socket_name || sign_threaded) && !sorted_input) {
+		fprintf(stderr, "-B and -j can only be used with -S\n");
+		exit(EXIT_FAILURE);
+	}
+	if (sign_socket_name && sign_threaded) {
+		fprintf(stderr, "-B and -j can not be used together\n");
+		exit(EXIT_FAILURE);
+	}
+
 	if (argc < 1) {
 		printf("Error: not enough arguments\n");
 		usage(stdout, prog);
@@ -853,7 +984,10 @@ main(int argc, char *argv[])
 	/* read zonefile first to find origin if not specified */
 	
 	if (strncmp(zonefile_name, "-", 2) == 0) {
-		s = ldns_zone_new_frm_fp_l(&orig_zone,
+		s = sorted_input
+		  ? read_zone_apex(&orig_zone, &reader, &next_rr,
+				   stdin, origin, ttl, class, &line_nr)
+		  : ldns_zone_new_frm_fp_l(&orig_zone,
 					   stdin,
 					   origin,
 					   ttl,
@@ -888,7 +1022,11 @@ main(int argc, char *argv[])
 				   strerror(errno));
 			exit(EXIT_FAILURE);
 		} else {
-			s = ldns_zone_new_frm_fp_l(&orig_zone,
+			s = sorted_input
+			  ? read_zone_apex(&orig_zone, &reader, &next_rr,
+			                   zonefile, origin, ttl, class,
+			                   &line_nr)
+			  : ldns_zone_new_frm_fp_l(&orig_zone,
 			                           zonefile,
 			                           origin,
 			                           ttl,
@@ -913,7 +1051,8 @@ main(int argc, char *argv[])
 					exit(EXIT_FAILURE);
 				}
 			}
-			fclose(zonefile);
+			if (!sorted_input)
+				fclose(zonefile);
 		}
 	}
 
@@ -998,34 +1137,10 @@ main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	signed_zone = ldns_dnssec_zone_new();
 	if (unixtime_serial) {
 		ldns_rr_soa_increment_func_int(ldns_zone_soa(orig_zone),
 			ldns_soa_serial_unixtime, 0);
 	}
-	if (ldns_dnssec_zone_add_rr(signed_zone, ldns_zone_soa(orig_zone)) !=
-	    LDNS_STATUS_OK) {
-		fprintf(stderr,
-		  "Error adding SOA to dnssec zone, skipping record\n");
-	}
-	
-	for (i = 0;
-	     i < ldns_rr_list_rr_count(ldns_zone_rrs(orig_zone));
-	     i++) {
-		if (ldns_dnssec_zone_add_rr(signed_zone, 
-		         ldns_rr_list_rr(ldns_zone_rrs(orig_zone), 
-		         i)) !=
-		    LDNS_STATUS_OK) {
-			fprintf(stderr,
-			        "Error adding RR to dnssec zone");
-			fprintf(stderr, ", skipping record:\n");
-			ldns_rr_print(stderr, 
-			  ldns_rr_list_rr(ldns_zone_rrs(orig_zone), i));
-		}
-	}
-	/* list to store newly created rrs, so we can free them later */
-	added_rrs = ldns_rr_list_new();
-
 	if (use_nsec3) {
 		if (verbosity < 1)
 			; /* pass */
@@ -1043,70 +1158,196 @@ main(int argc, char *argv[])
 			    "insecure responses!\n"
 			    "See: https://datatracker.ietf.org/doc/html/"
 			    "draft-hardaker-dnsop-nsec3-guidance-03#section-4\n");
-
-		result = ldns_dnssec_zone_sign_nsec3_flg_mkmap(signed_zone,
-			added_rrs,
-			keys,
-			ldns_dnssec_default_replace_signatures,
-			NULL,
-			nsec3_algorithm,
-			nsec3_flags,
-			nsec3_iterations,
-			nsec3_salt_length,
-			nsec3_salt,
-			signflags,
-			&fmt_st.hashmap);
-	} else {
-		result = ldns_dnssec_zone_sign_flg(signed_zone,
-				added_rrs,
-				keys,
-				ldns_dnssec_default_replace_signatures,
-				NULL,
-				signflags);
 	}
-	if (result != LDNS_STATUS_OK) {
-		fprintf(stderr, "Error signing zone: %s\n",
-			   ldns_get_errorstr_by_id(result));
-	}
-
 	if (!outputfile_name) {
 		outputfile_name = LDNS_XMALLOC(char, MAX_FILENAME_LEN);
 		snprintf(outputfile_name, MAX_FILENAME_LEN, "%s.signed", zonefile_name);
 	}
 
-	if (signed_zone) {
+	if (sign_cache_name) {
+		result = ldns_sign_cache_new_frm_file(&sign_cache,
+				sign_cache_name);
+		if (result != LDNS_STATUS_OK) {
+			fprintf(stderr, "Unable to read %s: %s\n",
+				   sign_cache_name,
+				   ldns_get_errorstr_by_id(result));
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (sorted_input) {
 		if (strncmp(outputfile_name, "-", 2) == 0) {
-			ldns_dnssec_zone_print(stdout, signed_zone);
-		} else {
-			outputfile = fopen(outputfile_name, "w");
-			if (!outputfile) {
-				fprintf(stderr, "Unable to open %s for writing: %s\n",
-					   outputfile_name, strerror(errno));
-			} else {
-				ldns_dnssec_zone_print_fmt(
-						outputfile, fmt, signed_zone);
-				fclose(outputfile);
+			outputfile = stdout;
+		} else if (!(outputfile = fopen(outputfile_name, "w"))) {
+			fprintf(stderr, "Unable to open %s for writing: %s\n",
+				   outputfile_name, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		result = ldns_dnssec_zone_signer_new(&signer, outputfile,
+				outputfile == stdout
+				? ldns_output_format_default : fmt, keys, ldns_dnssec_default_replace_signatures,
+				NULL, signflags);
+		if (result == LDNS_STATUS_OK && sign_cache) {
+			ldns_dnssec_zone_signer_set_cache(signer, sign_cache);
+		}
+		if (result == LDNS_STATUS_OK
+		&& (sign_socket_name || sign_threaded)) {
+			result = sign_socket_name
+			       ? ldns_sign_backend_new_socket(&sign_backend,
+					       sign_socket_name)
+			       : ldns_sign_backend_new_openssl(&sign_backend,
+					       sign_threads);
+			if (result != LDNS_STATUS_OK) {
+				fprintf(stderr, "Unable to set up signing%s%s: "
+					   "%s\n", sign_socket_name ? " with " : "",
+					   sign_socket_name ? sign_socket_name : "",
+					   ldns_get_errorstr_by_id(result));
+				exit(EXIT_FAILURE);
 			}
+			ldns_dnssec_zone_signer_set_backend(signer,
+					sign_backend);
 		}
+		if (result == LDNS_STATUS_OK && use_nsec3) {
+			result = ldns_dnssec_zone_signer_set_nsec3(signer,
+					nsec3_algorithm, nsec3_flags,
+					nsec3_iterations, nsec3_salt_length,
+					nsec3_salt, max_memory * 1024 * 1024,
+					NULL);
+		}
+		if (result == LDNS_STATUS_OK) {
+			result = sign_zone_sorted(signer, orig_zone, reader,
+					next_rr, &line_nr);
+		} else {
+			ldns_rr_free(next_rr);
+		}
+		ldns_dnssec_zone_signer_free(signer);
+		ldns_sign_backend_free(sign_backend);
+		ldns_zone_reader_free(reader);
+		if (zonefile) {
+			fclose(zonefile);
+		}
+		if (outputfile != stdout) {
+			fclose(outputfile);
+		}
+		if (result != LDNS_STATUS_OK) {
+			fprintf(stderr, "Error signing zone: %s at line %d\n",
+				   ldns_get_errorstr_by_id(result), line_nr);
+			exit(EXIT_FAILURE);
+		}
+		if (sign_cache && ldns_sign_cache_write(sign_cache,
+					sign_cache_name) != LDNS_STATUS_OK) {
+			fprintf(stderr, "Unable to write %s: %s\n",
+				   sign_cache_name, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		ldns_sign_cache_free(sign_cache);
+		signed_zone = NULL;
+		added_rrs = NULL;
 	} else {
-		fprintf(stderr, "Error signing zone.\n");
+		signed_zone = ldns_dnssec_zone_new();
+		if (ldns_dnssec_zone_add_rr(signed_zone, ldns_zone_soa(orig_zone)) !=
+		    LDNS_STATUS_OK) {
+			fprintf(stderr,
+			  "Error adding SOA to dnssec zone, skipping record\n");
+		}
+	
+		for (i = 0;
+		     i < ldns_rr_list_rr_count(ldns_zone_rrs(orig_zone));
+		     i++) {
+			if (ldns_dnssec_zone_add_rr(signed_zone, 
+			         ldns_rr_list_rr(ldns_zone_rrs(orig_zone), 
+			         i)) !=
+			    LDNS_STATUS_OK) {
+				fprintf(stderr,
+				        "Error adding RR to dnssec zone");
+				fprintf(stderr, ", skipping record:\n");
+				ldns_rr_print(stderr, 
+				  ldns_rr_list_rr(ldns_zone_rrs(orig_zone), i));
+			}
+		}
+		/* the RRs of a name share its owner */
+		ldns_dnssec_zone_intern_owners(signed_zone);
+		/* list to store newly created rrs, so we can free them later */
+		added_rrs = ldns_rr_list_new();
+
+		/* the signatures are looked up in, and stored in, the cache */
+		if (sign_cache) {
+			if (!(sign_ctx = ldns_sign_ctx_new())) {
+				fprintf(stderr, "Error signing zone: %s\n",
+					   ldns_get_errorstr_by_id(
+						   LDNS_STATUS_MEM_ERR));
+				exit(EXIT_FAILURE);
+			}
+			ldns_sign_ctx_set_cache(sign_ctx, sign_cache);
+		}
+		if (use_nsec3) {
+			result = ldns_dnssec_zone_sign_nsec3_ctx(signed_zone,
+				added_rrs,
+				keys,
+				ldns_dnssec_default_replace_signatures,
+				NULL,
+				nsec3_algorithm,
+				nsec3_flags,
+				nsec3_iterations,
+				nsec3_salt_length,
+				nsec3_salt,
+				signflags,
+				&fmt_st.hashmap,
+				sign_ctx);
+		} else {
+			result = ldns_dnssec_zone_sign_ctx(signed_zone,
+					added_rrs,
+					keys,
+					ldns_dnssec_default_replace_signatures,
+					NULL,
+					signflags,
+					sign_ctx);
+		}
+		ldns_sign_ctx_free(sign_ctx);
+		if (result != LDNS_STATUS_OK) {
+			fprintf(stderr, "Error signing zone: %s\n",
+				   ldns_get_errorstr_by_id(result));
+		} else if (sign_cache && ldns_sign_cache_write(sign_cache,
+					sign_cache_name) != LDNS_STATUS_OK) {
+			fprintf(stderr, "Unable to write %s: %s\n",
+				   sign_cache_name, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		ldns_sign_cache_free(sign_cache);
+
+		if (signed_zone) {
+			if (strncmp(outputfile_name, "-", 2) == 0) {
+				ldns_dnssec_zone_print(stdout, signed_zone);
+			} else {
+				outputfile = fopen(outputfile_name, "w");
+				if (!outputfile) {
+					fprintf(stderr, "Unable to open %s for writing: %s\n",
+						   outputfile_name, strerror(errno));
+				} else {
+					ldns_dnssec_zone_print_fmt(
+							outputfile, fmt, signed_zone);
+					fclose(outputfile);
+				}
+			}
+		} else {
+			fprintf(stderr, "Error signing zone.\n");
 
 #ifdef HAVE_SSL
-		if (ERR_peek_error()) {
+			if (ERR_peek_error()) {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(HAVE_LIBRESSL)
 #ifdef HAVE_ERR_LOAD_CRYPTO_STRINGS
-			ERR_load_crypto_strings();
+				ERR_load_crypto_strings();
 #endif
 #endif
-			ERR_print_errors_fp(stderr);
+				ERR_print_errors_fp(stderr);
 #if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(HAVE_LIBRESSL)
 #ifdef HAVE_ERR_FREE_STRINGS
-			ERR_free_strings ();
+				ERR_free_strings ();
 #endif
 #endif
-		}
+			}
 #endif
-		exit(EXIT_FAILURE);
+			exit(EXIT_FAILURE);
+		}
 	}
 	
 	ldns_key_list_free(keys);
@@ -887,7 +887,7 @@ handle_query(uint8_t* inbuf, ssize_t inlen, struct entry* entries, int* count,
 	entry = find_match(entries, query_pkt, transport);
 	if(!entry || !entry->reply_list) {
 		verbose(1, "no answer packet for this query, no reply.\n");
-		ldns_pkt_free(query_pkt);
+		ldns_pkt_recycle(query_pkt);
 		ldns_rdf_deep_free(stop_command);
 		return;
 	}
@@ -906,11 +906,11 @@ handle_query(uint8_t* inbuf, ssize_t inlen, struct entry* entries, int* count,
 				verbose(2, "Answer packet size: %u bytes.\n", (unsigned int)answer_size);
 				if (status != LDNS_STATUS_OK) {
 					verbose(1, "Error creating answer: %s\n", ldns_get_errorstr_by_id(status));
-					ldns_pkt_free(query_pkt);
+					ldns_pkt_recycle(query_pkt);
 					ldns_rdf_deep_free(stop_command);
 					return;
 				}
-				ldns_pkt_free(answer_pkt);
+				ldns_pkt_recycle(answer_pkt);
 				answer_pkt = NULL;
 			} else {
 				verbose(3, "Could not parse hex data (%s), sending hex data directly.\n", ldns_get_errorstr_by_id(status));
@@ -931,11 +931,11 @@ handle_query(uint8_t* inbuf, ssize_t inlen, struct entry* entries, int* count,
 			verbose(1, "Answer packet size: %u bytes.\n", (unsigned int)answer_size);
 			if (status != LDNS_STATUS_OK) {
 				verbose(1, "Error creating answer: %s\n", ldns_get_errorstr_by_id(status));
-				ldns_pkt_free(query_pkt);
+				ldns_pkt_recycle(query_pkt);
 				ldns_rdf_deep_free(stop_command);
 				return;
 			}
-			ldns_pkt_free(answer_pkt);
+			ldns_pkt_recycle(answer_pkt);
 			answer_pkt = NULL;
 		}
 		if(p->packet_sleep) {
@@ -954,7 +954,7 @@ handle_query(uint8_t* inbuf, ssize_t inlen, struct entry* entries, int* count,
 		outbuf = NULL;
 		answer_size = 0;
 	}
-	ldns_pkt_free(query_pkt);
+	ldns_pkt_recycle(query_pkt);
 	ldns_rdf_deep_free(stop_command);
 }
 
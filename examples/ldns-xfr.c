@@ -0,0 +1,267 @@
+/*
+ * ldns-xfr transfers a zone and writes it to a file while the transfer
+ * is going on
+ *
+ * (c) NLnet Labs, 2024
+ * See the file LICENSE for the license
+ */
+
+#include "config.h"
+
+#include <ldns/ldns.h>
+
+#include <errno.h>
+
+static void
+usage(FILE *fp, const char *prog) {
+	fprintf(fp, "%s [options] zone server\n", prog);
+	fprintf(fp, "  transfer a zone from server, and write it out\n");
+	fprintf(fp, "  as it comes in\n");
+	fprintf(fp, "options:\n");
+	fprintf(fp, "-4\t\tonly use IPv4\n");
+	fprintf(fp, "-6\t\tonly use IPv6\n");
+	fprintf(fp, "-b <file>\twrite the RRs to file in wireformat, each\n"
+	            "\t\tpreceded by its length in two bytes, instead\n"
+	            "\t\tof to stdout\n");
+	fprintf(fp, "-o <file>\twrite the RRs to file instead of stdout\n");
+	fprintf(fp, "-p <port>\tuse port to connect to the server\n");
+	fprintf(fp, "-s <serial>\tdo an IXFR from serial, instead of an AXFR\n");
+	fprintf(fp, "-w <workers>\tthe number of threads that parse the "
+	            "transfer (default 2)\n"
+	            "\t\t0 reads and parses the transfer in one thread\n");
+	fprintf(fp, "-y <name:key[:algo]>\tsign the query with a tsig key\n");
+	fprintf(fp, "-z\t\tcollect the zone in memory, and write it\n"
+	            "\t\tin canonical order when the transfer is done\n"
+	            "\t\t(cannot be used with -s)\n");
+}
+
+/* Where the RRs go */
+struct xfr_out {
+	FILE *text;
+	FILE *wire;
+	ldns_buffer *buf;
+};
+
+static ldns_status
+write_rrs(ldns_rr_list *rrs, void *arg)
+{
+	struct xfr_out *out = arg;
+	ldns_status status = LDNS_STATUS_OK;
+	ldns_rr *rr;
+	size_t i;
+
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		rr = ldns_rr_list_rr(rrs, i);
+		if (out->wire && status == LDNS_STATUS_OK) {
+			ldns_buffer_clear(out->buf);
+			ldns_buffer_write_u16(out->buf, 0);
+			status = ldns_rr2buffer_wire(out->buf, rr,
+					LDNS_SECTION_ANSWER);
+			if (status == LDNS_STATUS_OK) {
+				ldns_buffer_write_u16_at(out->buf, 0,
+					ldns_buffer_position(out->buf) - 2);
+				if (fwrite(ldns_buffer_begin(out->buf),
+					   ldns_buffer_position(out->buf), 1,
+					   out->wire) != 1) {
+					status = LDNS_STATUS_FILE_ERR;
+				}
+			}
+		}
+		if (out->text && status == LDNS_STATUS_OK) {
+			ldns_rr_print(out->text, rr);
+		}
+		ldns_rr_free(rr);
+	}
+	return status;
+}
+
+static ldns_status
+set_server(ldns_resolver *res, const char *server)
+{
+	ldns_resolver *r = NULL;
+	ldns_rdf *addr, *name;
+	ldns_rr_list *addrs;
+	ldns_status status;
+
+	if ((addr = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, server)) ||
+	    (addr = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_AAAA, server))) {
+		status = ldns_resolver_push_nameserver(res, addr);
+		ldns_rdf_deep_free(addr);
+		return status;
+	}
+	if (!(name = ldns_dname_new_frm_str(server))) {
+		return LDNS_STATUS_SYNTAX_DNAME_ERR;
+	}
+	status = ldns_resolver_new_frm_file(&r, NULL);
+	if (status != LDNS_STATUS_OK) {
+		ldns_rdf_deep_free(name);
+		return status;
+	}
+	addrs = ldns_get_rr_list_addr_by_name(r, name, LDNS_RR_CLASS_IN, 0);
+	if (addrs) {
+		status = ldns_resolver_push_nameserver_rr_list(res, addrs);
+		ldns_rr_list_deep_free(addrs);
+	} else {
+		status = LDNS_STATUS_RES_NO_NS;
+	}
+	ldns_resolver_deep_free(r);
+	ldns_rdf_deep_free(name);
+	return status;
+}
+
+int
+main(int argc, char *argv[])
+{
+	ldns_resolver *res;
+	ldns_rdf *zone;
+	ldns_dnssec_zone *dnssec_zone = NULL;
+	ldns_status status;
+	struct xfr_out out;
+	const char *prog = argv[0];
+	const char *text_file = NULL, *wire_file = NULL;
+	char *tsig_name = NULL, *tsig_data = NULL, *tsig_sep;
+	const char *tsig_algo = NULL;
+	ldns_rr_type type = LDNS_RR_TYPE_AXFR;
+	size_t workers = 2;
+	bool in_memory = false;
+	int c;
+
+	memset(&out, 0, sizeof(out));
+	if (!(res = ldns_resolver_new())) {
+		fprintf(stderr, "Out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	while ((c = getopt(argc, argv, "46b:ho:p:s:w:y:z")) != -1) {
+		switch (c) {
+		case '4':
+			ldns_resolver_set_ip6(res, LDNS_RESOLV_INET);
+			break;
+		case '6':
+			ldns_resolver_set_ip6(res, LDNS_RESOLV_INET6);
+			break;
+		case 'b':
+			wire_file = optarg;
+			break;
+		case 'h':
+			usage(stdout, prog);
+			exit(EXIT_SUCCESS);
+		case 'o':
+			text_file = optarg;
+			break;
+		case 'p':
+			ldns_resolver_set_port(res, (uint16_t)atoi(optarg));
+			break;
+		case 's':
+			type = LDNS_RR_TYPE_IXFR;
+			ldns_resolver_set_ixfr_serial(res,
+					(uint32_t)strtoul(optarg, NULL, 10));
+			break;
+		case 'w':
+			workers = (size_t)atoi(optarg);
+			break;
+		case 'y':
+			tsig_name = optarg;
+			if (!(tsig_data = strchr(tsig_name, ':'))) {
+				fprintf(stderr, "TSIG argument is not in form "
+					"<name:key[:algo]> %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			*tsig_data++ = '\0';
+			if ((tsig_sep = strchr(tsig_data, ':'))) {
+				*tsig_sep++ = '\0';
+				tsig_algo = tsig_sep;
+			} else {
+				tsig_algo = "hmac-md5.sig-alg.reg.int.";
+			}
+			break;
+		case 'z':
+			in_memory = true;
+			break;
+		default:
+			usage(stderr, prog);
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2) {
+		usage(stderr, prog);
+		exit(EXIT_FAILURE);
+	}
+	if (in_memory && type == LDNS_RR_TYPE_IXFR) {
+		/* there is no zone in memory to apply the changes to */
+		fprintf(stderr, "-s cannot be used with -z, which needs "
+		                "the whole zone\n");
+		usage(stderr, prog);
+		exit(EXIT_FAILURE);
+	}
+	if (!(zone = ldns_dname_new_frm_str(argv[0]))) {
+		fprintf(stderr, "Bad zone name: %s\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	status = set_server(res, argv[1]);
+	if (status != LDNS_STATUS_OK) {
+		fprintf(stderr, "Cannot use server %s: %s\n", argv[1],
+				ldns_get_errorstr_by_id(status));
+		exit(EXIT_FAILURE);
+	}
+	if (tsig_name) {
+		ldns_resolver_set_tsig_keyname(res, tsig_name);
+		ldns_resolver_set_tsig_keydata(res, tsig_data);
+		ldns_resolver_set_tsig_algorithm(res, tsig_algo);
+	}
+
+	if (!text_file) {
+		out.text = stdout;
+	} else if (!(out.text = fopen(text_file, "w"))) {
+		fprintf(stderr, "Cannot open %s: %s\n", text_file,
+				strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (wire_file) {
+		if (!(out.wire = fopen(wire_file, "wb"))) {
+			fprintf(stderr, "Cannot open %s: %s\n", wire_file,
+					strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		if (!(out.buf = ldns_buffer_new(LDNS_MAX_PACKETLEN))) {
+			fprintf(stderr, "Out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (in_memory) {
+		if (!(dnssec_zone = ldns_dnssec_zone_new())) {
+			fprintf(stderr, "Out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+		status = ldns_dnssec_zone_xfr_pipeline(dnssec_zone, res, zone,
+				LDNS_RR_CLASS_IN, workers);
+		if (status == LDNS_STATUS_OK) {
+			ldns_dnssec_zone_print(out.text, dnssec_zone);
+		}
+		ldns_dnssec_zone_deep_free(dnssec_zone);
+	} else {
+		if (out.wire) {
+			/* wireformat only, unless -o was given */
+			out.text = text_file ? out.text : NULL;
+		}
+		status = ldns_xfr_pipeline(res, zone, LDNS_RR_CLASS_IN, type,
+				workers, write_rrs, &out);
+	}
+	if (status != LDNS_STATUS_OK) {
+		fprintf(stderr, "Transfer of %s failed: %s\n", argv[0],
+				ldns_get_errorstr_by_id(status));
+	}
+
+	if (text_file && out.text) {
+		fclose(out.text);
+	}
+	if (out.wire) {
+		fclose(out.wire);
+	}
+	ldns_buffer_free(out.buf);
+	ldns_rdf_deep_free(zone);
+	ldns_resolver_deep_free(res);
+	return status == LDNS_STATUS_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -80,7 +80,7 @@ get_rrset(const ldns_zone *zone, const ldns_rdf *owner_name, const ldns_rr_type
 		    ldns_rr_get_class(cur_rr) == qclass &&
 		    ldns_rr_get_type(cur_rr) == qtype
 		   ) {
-			ldns_rr_list_push_rr(rrlist, ldns_rr_clone(cur_rr));
+			ldns_rr_list_push_rr(rrlist, ldns_rr_ref(cur_rr));
 		}
 	}
 	
@@ -201,10 +201,10 @@ main(int argc, char **argv)
 		ldns_rr_print(stdout, query_rr);
 		
 		answer_qr = ldns_rr_list_new();
-		ldns_rr_list_push_rr(answer_qr, ldns_rr_clone(query_rr));
+		ldns_rr_list_push_rr(answer_qr, ldns_rr_ref(query_rr));
 
 		answer_an = get_rrset(zone, ldns_rr_owner(query_rr), ldns_rr_get_type(query_rr), ldns_rr_get_class(query_rr));
-		answer_pkt = ldns_pkt_new();
+		answer_pkt = ldns_pkt_new_pooled();
 		answer_ns = ldns_rr_list_new();
 		answer_ad = ldns_rr_list_new();
 		
@@ -227,8 +227,8 @@ main(int argc, char **argv)
 				&addr_him, hislen);
 		}
 		
-		ldns_pkt_free(query_pkt);
-		ldns_pkt_free(answer_pkt);
+		ldns_pkt_recycle(query_pkt);
+		ldns_pkt_recycle(answer_pkt);
 		LDNS_FREE(outbuf);
 		ldns_rr_list_free(answer_qr);
 		ldns_rr_list_free(answer_an);
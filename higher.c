@@ -103,6 +103,95 @@ ldns_get_rr_list_addr_by_name(ldns_resolver *res, const ldns_rdf *name,
 	return result;
 }
 
+ldns_rr_list *
+ldns_get_rr_list_addr_by_names(ldns_resolver *res, ldns_rdf * const *names,
+		size_t count, ldns_rr_class c, uint16_t flags)
+{
+	ldns_rdf **qnames;
+	ldns_rr_type *qtypes;
+	ldns_pkt **answers;
+	ldns_rr_list *addrs;
+	ldns_rr_list *result = NULL;
+	ldns_rr_list *hostsfilenames;
+	size_t i, j, n;
+	bool in_hosts;
+	uint8_t ip6;
+
+	if (!res || count == 0) {
+		return NULL;
+	}
+	qnames = LDNS_XMALLOC(ldns_rdf *, 2 * count);
+	qtypes = LDNS_XMALLOC(ldns_rr_type, 2 * count);
+	answers = LDNS_XMALLOC(ldns_pkt *, 2 * count);
+	if (!qnames || !qtypes || !answers) {
+		LDNS_FREE(qnames);
+		LDNS_FREE(qtypes);
+		LDNS_FREE(answers);
+		return NULL;
+	}
+
+	/* names in the hosts file need not be queried */
+	hostsfilenames = ldns_get_rr_list_hosts_frm_file(NULL);
+	n = 0;
+	for (i = 0; i < count; i++) {
+		if (ldns_rdf_get_type(names[i]) != LDNS_RDF_TYPE_DNAME) {
+			continue;
+		}
+		in_hosts = false;
+		for (j = 0; j < ldns_rr_list_rr_count(hostsfilenames); j++) {
+			if (ldns_rdf_compare(names[i], ldns_rr_owner(
+				ldns_rr_list_rr(hostsfilenames, j))) == 0) {
+				if (!result) {
+					result = ldns_rr_list_new();
+				}
+				ldns_rr_list_push_rr(result, ldns_rr_clone(
+					ldns_rr_list_rr(hostsfilenames, j)));
+				in_hosts = true;
+			}
+		}
+		if (in_hosts) {
+			continue;
+		}
+		qnames[n] = names[i];
+		qtypes[n++] = LDNS_RR_TYPE_AAAA;
+		qnames[n] = names[i];
+		qtypes[n++] = LDNS_RR_TYPE_A;
+	}
+	ldns_rr_list_deep_free(hostsfilenames);
+
+	ip6 = ldns_resolver_ip6(res); /* we use INET_ANY here, save
+					 what was there */
+	ldns_resolver_set_ip6(res, LDNS_RESOLV_INETANY);
+
+	/* add the RD flags, because we want an answer */
+	(void) ldns_resolver_send_multi(answers, res, qnames, qtypes, n,
+			c, flags | LDNS_RD);
+	ldns_resolver_set_ip6(res, ip6);
+
+	for (i = 0; i < n; i++) {
+		if (!answers[i]) {
+			continue;
+		}
+		addrs = ldns_pkt_rr_list_by_type(answers[i], qtypes[i],
+				LDNS_SECTION_ANSWER);
+		if (addrs) {
+			if (!result) {
+				result = ldns_rr_list_new();
+			}
+			if (!result || !ldns_rr_list_cat(result, addrs)) {
+				ldns_rr_list_deep_free(addrs);
+			} else {
+				ldns_rr_list_free(addrs);
+			}
+		}
+		ldns_pkt_free(answers[i]);
+	}
+	LDNS_FREE(qnames);
+	LDNS_FREE(qtypes);
+	LDNS_FREE(answers);
+	return result;
+}
+
 ldns_rr_list *
 ldns_get_rr_list_name_by_addr(ldns_resolver *res, const ldns_rdf *addr,
 		ldns_rr_class c, uint16_t flags)
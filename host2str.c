@@ -332,6 +332,25 @@ ldns_pkt_cert_algorithm2str(ldns_cert_algorithm cert_algorithm)
 }
 
 
+/* Appends value in decimal, like ldns_buffer_printf() with "%lu" but
+ * without going through a format. Owner names, TTLs, classes, types and
+ * integer rdata are in every RR printed.
+ */
+static void
+ldns_buffer_write_decimal(ldns_buffer *output, unsigned long value)
+{
+	char digits[24];
+	size_t i = sizeof(digits);
+
+	do {
+		digits[--i] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+	if (ldns_buffer_reserve(output, sizeof(digits) - i)) {
+		ldns_buffer_write(output, &digits[i], sizeof(digits) - i);
+	}
+}
+
 /* do NOT pass compressed data here :p */
 ldns_status
 ldns_rdf2buffer_str_dname(ldns_buffer *output, const ldns_rdf *dname)
@@ -351,9 +370,15 @@ ldns_rdf2buffer_str_dname(ldns_buffer *output, const ldns_rdf *dname)
 		return LDNS_STATUS_DOMAINNAME_OVERFLOW;
 	}
 
+	/* a byte takes at most four characters, as \\ddd, and like
+	 * ldns_buffer_printf() the name is nul terminated
+	 */
+	if (!ldns_buffer_reserve(output, 4 * ldns_rdf_size(dname) + 1)) {
+		return ldns_buffer_status(output);
+	}
 	/* special case: root label */
 	if (1 == ldns_rdf_size(dname)) {
-		ldns_buffer_printf(output, ".");
+		ldns_buffer_write_u8(output, '.');
 	} else {
 		while ((len > 0) && src_pos < ldns_rdf_size(dname)) {
 			src_pos++;
@@ -365,23 +390,27 @@ ldns_rdf2buffer_str_dname(ldns_buffer *output, const ldns_rdf *dname)
 				if(c == '.' || c == ';' ||
 				   c == '(' || c == ')' ||
 				   c == '\\') {
-					ldns_buffer_printf(output, "\\%c",
-							data[src_pos]);
+					ldns_buffer_write_u8(output, '\\');
+					ldns_buffer_write_u8(output, c);
 				} else if (!(isascii(c) && isgraph(c))) {
-					ldns_buffer_printf(output, "\\%03u",
-						        data[src_pos]);
+					ldns_buffer_write_u8(output, '\\');
+					ldns_buffer_write_u8(output, '0' + c / 100);
+					ldns_buffer_write_u8(output,
+							'0' + c / 10 % 10);
+					ldns_buffer_write_u8(output, '0' + c % 10);
 				} else {
-					ldns_buffer_printf(output, "%c", data[src_pos]);
+					ldns_buffer_write_u8(output, c);
 				}
 				src_pos++;
 			}
 
 			if (src_pos < ldns_rdf_size(dname)) {
-				ldns_buffer_printf(output, ".");
+				ldns_buffer_write_u8(output, '.');
 			}
 			len = data[src_pos];
 		}
 	}
+	*ldns_buffer_current(output) = '\0';
 	return ldns_buffer_status(output);
 }
 
@@ -389,7 +418,7 @@ ldns_status
 ldns_rdf2buffer_str_int8(ldns_buffer *output, const ldns_rdf *rdf)
 {
 	uint8_t data = ldns_rdf_data(rdf)[0];
-	ldns_buffer_printf(output, "%lu", (unsigned long) data);
+	ldns_buffer_write_decimal(output, (unsigned long) data);
 	return ldns_buffer_status(output);
 }
 
@@ -397,7 +426,7 @@ ldns_status
 ldns_rdf2buffer_str_int16(ldns_buffer *output, const ldns_rdf *rdf)
 {
 	uint16_t data = ldns_read_uint16(ldns_rdf_data(rdf));
-	ldns_buffer_printf(output, "%lu", (unsigned long) data);
+	ldns_buffer_write_decimal(output, (unsigned long) data);
 	return ldns_buffer_status(output);
 }
 
@@ -405,7 +434,7 @@ ldns_status
 ldns_rdf2buffer_str_int32(ldns_buffer *output, const ldns_rdf *rdf)
 {
 	uint32_t data = ldns_read_uint32(ldns_rdf_data(rdf));
-	ldns_buffer_printf(output, "%lu", (unsigned long) data);
+	ldns_buffer_write_decimal(output, (unsigned long) data);
 	return ldns_buffer_status(output);
 }
 
@@ -483,11 +512,14 @@ ldns_rdf2buffer_str_str(ldns_buffer *output, const ldns_rdf *rdf)
 	return ldns_buffer_status(output);
 }
 
+/* The encodings below are written straight into the buffer, nul
+ * terminated like ldns_buffer_printf() leaves it.
+ */
 ldns_status
 ldns_rdf2buffer_str_b64(ldns_buffer *output, const ldns_rdf *rdf)
 {
 	size_t size;
-	char *b64;
+	int written;
 
 	if (ldns_rdf_size(rdf) == 0) {
 		ldns_buffer_printf(output, "0");
@@ -495,13 +527,13 @@ ldns_rdf2buffer_str_b64(ldns_buffer *output, const ldns_rdf *rdf)
 	} else
 		size = ldns_b64_ntop_calculate_size(ldns_rdf_size(rdf));
 
-	if (!(b64 = LDNS_XMALLOC(char, size)))
-		return LDNS_STATUS_MEM_ERR;
-
-	if (ldns_b64_ntop(ldns_rdf_data(rdf), ldns_rdf_size(rdf), b64, size)) {
-		ldns_buffer_printf(output, "%s", b64);
+	if (ldns_buffer_status_ok(output) && ldns_buffer_reserve(output, size)) {
+		written = ldns_b64_ntop(ldns_rdf_data(rdf), ldns_rdf_size(rdf),
+				(char *) ldns_buffer_current(output), size);
+		if (written > 0) {
+			ldns_buffer_skip(output, written);
+		}
 	}
-	LDNS_FREE(b64);
 	return ldns_buffer_status(output);
 }
 
@@ -509,31 +541,42 @@ ldns_status
 ldns_rdf2buffer_str_b32_ext(ldns_buffer *output, const ldns_rdf *rdf)
 {
 	size_t size;
-	char *b32;
+	int written;
 	if(ldns_rdf_size(rdf) == 0)
 		return LDNS_STATUS_OK;
         /* remove -1 for the b32-hash-len octet */
 	size = ldns_b32_ntop_calculate_size(ldns_rdf_size(rdf) - 1);
         /* add one for the end nul for the string */
-	b32 = LDNS_XMALLOC(char, size + 1);
-	if(!b32) return LDNS_STATUS_MEM_ERR;
-	size = (size_t) ldns_b32_ntop_extended_hex(ldns_rdf_data(rdf) + 1,
-		ldns_rdf_size(rdf) - 1, b32, size+1);
-	if (size > 0) {
-		ldns_buffer_printf(output, "%s", b32);
-	}
-	LDNS_FREE(b32);
+	if (ldns_buffer_status_ok(output)
+	    && ldns_buffer_reserve(output, size + 1)) {
+		written = ldns_b32_ntop_extended_hex(ldns_rdf_data(rdf) + 1,
+			ldns_rdf_size(rdf) - 1,
+			(char *) ldns_buffer_current(output), size + 1);
+		if (written > 0) {
+			ldns_buffer_skip(output, written);
+		}
+	}
 	return ldns_buffer_status(output);
 }
 
 ldns_status
 ldns_rdf2buffer_str_hex(ldns_buffer *output, const ldns_rdf *rdf)
 {
-	size_t i;
-	for (i = 0; i < ldns_rdf_size(rdf); i++) {
-		ldns_buffer_printf(output, "%02x", ldns_rdf_data(rdf)[i]);
+	static const char hexdigits[] = "0123456789abcdef";
+	const uint8_t *data = ldns_rdf_data(rdf);
+	size_t i, size = ldns_rdf_size(rdf);
+	char *dst;
+
+	if (ldns_buffer_status_ok(output)
+	    && ldns_buffer_reserve(output, 2 * size + 1)) {
+		dst = (char *) ldns_buffer_current(output);
+		for (i = 0; i < size; i++) {
+			*dst++ = hexdigits[data[i] >> 4];
+			*dst++ = hexdigits[data[i] & 0x0f];
+		}
+		*dst = '\0';
+		ldns_buffer_skip(output, 2 * size);
 	}
-
 	return ldns_buffer_status(output);
 }
 
@@ -547,9 +590,10 @@ ldns_rdf2buffer_str_type_fmt(ldns_buffer *output,
 			ldns_rr_descript(data) &&
 			ldns_rr_descript(data)->_name) {
 
-		ldns_buffer_printf(output, "%s",ldns_rr_descript(data)->_name);
+		ldns_buffer_write_chars(output, ldns_rr_descript(data)->_name);
 	} else {
-		ldns_buffer_printf(output, "TYPE%u", data);
+		ldns_buffer_write_chars(output, "TYPE");
+		ldns_buffer_write_decimal(output, data);
 	}
 	return  ldns_buffer_status(output);
 }
@@ -638,9 +682,10 @@ ldns_rr_type2buffer_str(ldns_buffer *output, const ldns_rr_type type)
 			break;
 		default:
 			if (descriptor && descriptor->_name) {
-				ldns_buffer_printf(output, "%s", descriptor->_name);
+				ldns_buffer_write_chars(output, descriptor->_name);
 			} else {
-				ldns_buffer_printf(output, "TYPE%u", type);
+				ldns_buffer_write_chars(output, "TYPE");
+				ldns_buffer_write_decimal(output, type);
 			}
 	}
 	return ldns_buffer_status(output);
@@ -675,9 +720,10 @@ ldns_rr_class2buffer_str(ldns_buffer *output,
 
 	lt = ldns_lookup_by_id(ldns_rr_classes, klass);
 	if (lt) {
-		ldns_buffer_printf(output, "%s", lt->name);
+		ldns_buffer_write_chars(output, lt->name);
 	} else {
-		ldns_buffer_printf(output, "CLASS%d", klass);
+		ldns_buffer_write_chars(output, "CLASS");
+		ldns_buffer_write_decimal(output, klass);
 	}
 	return ldns_buffer_status(output);
 }
@@ -1833,15 +1879,16 @@ ldns_rr2buffer_str_fmt(ldns_buffer *output,
 
 		/* TTL should NOT be printed if it is a question */
 		if (!ldns_rr_is_question(rr)) {
-			ldns_buffer_printf(output, "\t%u", (unsigned)ldns_rr_ttl(rr));
+			ldns_buffer_write_char(output, '\t');
+			ldns_buffer_write_decimal(output, ldns_rr_ttl(rr));
 		}
 
-		ldns_buffer_printf(output, "\t");
+		ldns_buffer_write_char(output, '\t');
 		status = ldns_rr_class2buffer_str(output, ldns_rr_get_class(rr));
 		if (status != LDNS_STATUS_OK) {
 			return status;
 		}
-		ldns_buffer_printf(output, "\t");
+		ldns_buffer_write_char(output, '\t');
 
 		if (ldns_output_format_covers_type(fmt, ldns_rr_get_type(rr))) {
 			return ldns_rr2buffer_str_rfc3597(output, rr);
@@ -1852,7 +1899,7 @@ ldns_rr2buffer_str_fmt(ldns_buffer *output,
 		}
 
 		if (ldns_rr_rd_count(rr) > 0) {
-			ldns_buffer_printf(output, "\t");
+			ldns_buffer_write_char(output, '\t');
 		} else if (!ldns_rr_is_question(rr)) {
 			ldns_buffer_printf(output, "\t\\# 0");
 		}
@@ -1893,7 +1940,7 @@ ldns_rr2buffer_str_fmt(ldns_buffer *output,
 		if(status != LDNS_STATUS_OK)
 			return status;
 		if (i < ldns_rr_rd_count(rr) - 1) {
-			ldns_buffer_printf(output, " ");
+			ldns_buffer_write_char(output, ' ');
 		}
 	}
 	/* per RR special comments - handy for DNSSEC types */
@@ -3402,17 +3449,70 @@ ldns_rdf_print(FILE *output, const ldns_rdf *rdf)
 	LDNS_FREE(str);
 }
 
+/* RRs printed through an output buffer are written out in chunks of
+ * this size or more; such buffers are allocated twice as large
+ */
+#define LDNS_PRINT_FLUSH_SIZE LDNS_MAX_PACKETLEN
+
+ldns_buffer *
+_ldns_print_buffer_new(FILE *output, size_t capacity)
+{
+	ldns_buffer *buf = ldns_buffer_new(capacity);
+
+	if (!buf) {
+		fprintf(output, ";Unable to allocate output buffer\n");
+	}
+	return buf;
+}
+
+void
+_ldns_print_buffer_flush(FILE *output, ldns_buffer *buf)
+{
+	if (ldns_buffer_position(buf) > 0) {
+		(void) fwrite(ldns_buffer_begin(buf), 1,
+				ldns_buffer_position(buf), output);
+	}
+	ldns_buffer_clear(buf);
+}
+
+void
+_ldns_print_buffer_free(FILE *output, ldns_buffer *buf)
+{
+	if (buf) {
+		_ldns_print_buffer_flush(output, buf);
+		ldns_buffer_free(buf);
+	}
+}
+
+/* Appends rr to buf, which is written to output when full */
+void
+_ldns_rr_print_fmt_buf(FILE *output, const ldns_output_format *fmt,
+		const ldns_rr *rr, ldns_buffer *buf)
+{
+	size_t start = ldns_buffer_position(buf);
+
+	if (ldns_rr2buffer_str_fmt(buf, fmt, rr) != LDNS_STATUS_OK) {
+		/* drop what was written of it */
+		ldns_buffer_set_position(buf, start);
+		buf->_status = LDNS_STATUS_OK;
+		ldns_buffer_write_chars(buf,
+				";Unable to convert rr to string\n");
+	}
+	if (ldns_buffer_position(buf) >= LDNS_PRINT_FLUSH_SIZE) {
+		_ldns_print_buffer_flush(output, buf);
+	}
+}
+
 void
 ldns_rr_print_fmt(FILE *output,
 		const ldns_output_format *fmt, const ldns_rr *rr)
 {
-	char *str = ldns_rr2str_fmt(fmt, rr);
-	if (str) {
-		fprintf(output, "%s", str);
-	} else {
-		fprintf(output, ";Unable to convert rr to string\n");
+	ldns_buffer *buf = _ldns_print_buffer_new(output, 512);
+
+	if (buf) {
+		_ldns_rr_print_fmt_buf(output, fmt, rr, buf);
+		_ldns_print_buffer_free(output, buf);
 	}
-	LDNS_FREE(str);
 }
 
 void
@@ -3440,13 +3540,27 @@ ldns_pkt_print(FILE *output, const ldns_pkt *pkt)
 	ldns_pkt_print_fmt(output, ldns_output_format_default, pkt);
 }
 
+static void
+ldns_rr_list_print_fmt_buf(FILE *output, const ldns_output_format *fmt,
+		const ldns_rr_list *lst, ldns_buffer *buf)
+{
+	size_t i;
+	for (i = 0; i < ldns_rr_list_rr_count(lst); i++) {
+		_ldns_rr_print_fmt_buf(output, fmt,
+				ldns_rr_list_rr(lst, i), buf);
+	}
+}
+
 void
 ldns_rr_list_print_fmt(FILE *output, 
 		const ldns_output_format *fmt, const ldns_rr_list *lst)
 {
-	size_t i;
-	for (i = 0; i < ldns_rr_list_rr_count(lst); i++) {
-		ldns_rr_print_fmt(output, fmt, ldns_rr_list_rr(lst, i));
+	ldns_buffer *buf = _ldns_print_buffer_new(output,
+			2 * LDNS_PRINT_FLUSH_SIZE);
+
+	if (buf) {
+		ldns_rr_list_print_fmt_buf(output, fmt, lst, buf);
+		_ldns_print_buffer_free(output, buf);
 	}
 }
 
@@ -3533,9 +3647,17 @@ void
 ldns_zone_print_fmt(FILE *output, 
 		const ldns_output_format *fmt, const ldns_zone *z)
 {
-	if(ldns_zone_soa(z))
-		ldns_rr_print_fmt(output, fmt, ldns_zone_soa(z));
-	ldns_rr_list_print_fmt(output, fmt, ldns_zone_rrs(z));
+	ldns_buffer *buf = _ldns_print_buffer_new(output,
+			2 * LDNS_PRINT_FLUSH_SIZE);
+
+	if (buf) {
+		if(ldns_zone_soa(z))
+			_ldns_rr_print_fmt_buf(output, fmt,
+					ldns_zone_soa(z), buf);
+		ldns_rr_list_print_fmt_buf(output, fmt,
+				ldns_zone_rrs(z), buf);
+		_ldns_print_buffer_free(output, buf);
+	}
 }
 void
 ldns_zone_print(FILE *output, const ldns_zone *z)
@@ -129,16 +129,11 @@ ldns_rdf2buffer_wire_compress(ldns_buffer *buffer, const ldns_rdf *rdf, ldns_rbt
 ldns_status
 ldns_rdf2buffer_wire_canonical(ldns_buffer *buffer, const ldns_rdf *rdf)
 {
-	size_t i;
-	uint8_t *rdf_data;
-
 	if (ldns_rdf_get_type(rdf) == LDNS_RDF_TYPE_DNAME) {
 		if (ldns_buffer_reserve(buffer, ldns_rdf_size(rdf))) {
-			rdf_data = ldns_rdf_data(rdf);
-			for (i = 0; i < ldns_rdf_size(rdf); i++) {
-				ldns_buffer_write_u8(buffer,
-				    (uint8_t) LDNS_DNAME_NORMALIZE((int)rdf_data[i]));
-			}
+			_ldns_dname_lower(ldns_buffer_current(buffer),
+					ldns_rdf_data(rdf), ldns_rdf_size(rdf));
+			ldns_buffer_skip(buffer, ldns_rdf_size(rdf));
 		}
 	} else {
 		/* direct copy for all other types */
@@ -472,56 +467,60 @@ ldns_pkt2buffer_wire_compress(ldns_buffer *buffer, const ldns_pkt *packet, ldns_
 	return LDNS_STATUS_OK;
 }
 
+/* Copies the wire data written to a pooled buffer out to dest, and
+ * recycles the buffer
+ */
+static ldns_status
+ldns_buffer2wire_recycle(uint8_t **dest, ldns_buffer *buffer,
+		ldns_status status, size_t *result_size)
+{
+	size_t size = ldns_buffer_position(buffer);
+
+	if (status == LDNS_STATUS_OK) {
+		*dest = LDNS_XMALLOC(uint8_t, size ? size : 1);
+		if (!*dest) {
+			status = LDNS_STATUS_MEM_ERR;
+		} else {
+			memcpy(*dest, ldns_buffer_begin(buffer), size);
+			*result_size = size;
+		}
+	}
+	ldns_buffer_recycle(buffer);
+	return status;
+}
+
 ldns_status
 ldns_rdf2wire(uint8_t **dest, const ldns_rdf *rdf, size_t *result_size)
 {
-	ldns_buffer *buffer = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-	ldns_status status;
+	ldns_buffer *buffer = ldns_buffer_new_pooled(LDNS_MAX_PACKETLEN);
 	*result_size = 0;
 	*dest = NULL;
 	if(!buffer) return LDNS_STATUS_MEM_ERR;
 	
-	status = ldns_rdf2buffer_wire(buffer, rdf);
-	if (status == LDNS_STATUS_OK) {
-		*result_size =  ldns_buffer_position(buffer);
-		*dest = (uint8_t *) ldns_buffer_export(buffer);
-	}
-	ldns_buffer_free(buffer);
-	return status;
+	return ldns_buffer2wire_recycle(dest, buffer,
+			ldns_rdf2buffer_wire(buffer, rdf), result_size);
 }
 
 ldns_status
 ldns_rr2wire(uint8_t **dest, const ldns_rr *rr, int section, size_t *result_size)
 {
-	ldns_buffer *buffer = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-	ldns_status status;
+	ldns_buffer *buffer = ldns_buffer_new_pooled(LDNS_MAX_PACKETLEN);
 	*result_size = 0;
 	*dest = NULL;
 	if(!buffer) return LDNS_STATUS_MEM_ERR;
 	
-	status = ldns_rr2buffer_wire(buffer, rr, section);
-	if (status == LDNS_STATUS_OK) {
-		*result_size =  ldns_buffer_position(buffer);
-		*dest = (uint8_t *) ldns_buffer_export(buffer);
-	}
-	ldns_buffer_free(buffer);
-	return status;
+	return ldns_buffer2wire_recycle(dest, buffer,
+			ldns_rr2buffer_wire(buffer, rr, section), result_size);
 }
 
 ldns_status
 ldns_pkt2wire(uint8_t **dest, const ldns_pkt *packet, size_t *result_size)
 {
-	ldns_buffer *buffer = ldns_buffer_new(LDNS_MAX_PACKETLEN);
-	ldns_status status;
+	ldns_buffer *buffer = ldns_buffer_new_pooled(LDNS_MAX_PACKETLEN);
 	*result_size = 0;
 	*dest = NULL;
 	if(!buffer) return LDNS_STATUS_MEM_ERR;
 	
-	status = ldns_pkt2buffer_wire(buffer, packet);
-	if (status == LDNS_STATUS_OK) {
-		*result_size =  ldns_buffer_position(buffer);
-		*dest = (uint8_t *) ldns_buffer_export(buffer);
-	}
-	ldns_buffer_free(buffer);
-	return status;
+	return ldns_buffer2wire_recycle(dest, buffer,
+			ldns_pkt2buffer_wire(buffer, packet), result_size);
 }
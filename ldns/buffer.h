@@ -107,6 +107,17 @@ ldns_buffer *ldns_buffer_new(size_t capacity);
  */
 void ldns_buffer_new_frm_data(ldns_buffer *buffer, const void *data, size_t size);
 
+/**
+ * sets up a buffer to read or write the specified data.  The data is
+ * NOT copied, and no memory allocations are done.  The buffer is fixed
+ * and must not be freed with ldns_buffer_free().
+ *
+ * \param[in] buffer pointer to the buffer to put the data in
+ * \param[in] data the data to encapsulate in the buffer
+ * \param[in] size the size of the data
+ */
+void ldns_buffer_init_frm_data(ldns_buffer *buffer, void *data, size_t size);
+
 /**
  * clears the buffer and make it ready for writing.  The buffer's limit
  * is set to the capacity and the position is set to 0.
@@ -652,6 +663,35 @@ int ldns_buffer_printf(ldns_buffer *buffer, const char *format, ...);
  */
 void ldns_buffer_free(ldns_buffer *buffer);
 
+/**
+ * Returns a cleared buffer of at least the given capacity from the pool of
+ * recycled buffers of the calling thread, or a new one when the pool has
+ * none. Buffers are pooled in size classes of 512 bytes up to 64K; for
+ * larger capacities this is ldns_buffer_new().
+ *
+ * The buffer can be freed with ldns_buffer_free() like any other, or be
+ * given back to the pool with ldns_buffer_recycle().
+ * \param[in] capacity the minimal capacity of the buffer
+ * \return the buffer, or NULL on allocation failure
+ */
+ldns_buffer *ldns_buffer_new_pooled(size_t capacity);
+
+/**
+ * Puts a buffer in the pool of the calling thread, for reuse by
+ * ldns_buffer_new_pooled(). It is freed instead when the pool is full,
+ * or when it is fixed or of a size that is not pooled. Any buffer made
+ * with ldns_buffer_new() can be recycled.
+ * \param[in] *buffer the buffer to recycle
+ */
+void ldns_buffer_recycle(ldns_buffer *buffer);
+
+/**
+ * Frees the recycled buffers in the pool of the calling thread. This
+ * happens by itself when a thread exits, and at exit() for the thread
+ * that calls it.
+ */
+void ldns_buffer_pool_free(void);
+
 /**
  * Makes the buffer fixed and returns a pointer to the data.  The
  * caller is responsible for free'ing the result.
@@ -0,0 +1,128 @@
+/*
+ * cache.h
+ *
+ * answer cache definitions
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+/**
+ * \file
+ *
+ * Defines the ldns_cache structure, a cache of DNS answers that a
+ * resolver can consult before sending a query to the network.
+ *
+ * Answers are kept as long as their TTLs allow, negative answers as long
+ * as their SOA allows (RFC 2308), and the least recently used answers
+ * are dropped when the cache grows beyond its maximum size. When ldns is
+ * built with thread support, a cache is locked internally and may be
+ * used by several threads at the same time.
+ *
+ * The answers a resolver stores in the cache it was given with
+ * ldns_resolver_set_cache() are kept apart by its nameservers and port,
+ * so one cache may be shared by resolvers that ask different
+ * nameservers. ldns_cache_lookup() and ldns_cache_store() keep answers
+ * apart only by the query, not by where it was sent.
+ */
+
+#ifndef LDNS_CACHE_H
+#define LDNS_CACHE_H
+
+#include <ldns/common.h>
+#include <ldns/packet.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default maximum size of a cache in bytes */
+#define LDNS_CACHE_DEFAULT_SIZE (4 * 1024 * 1024)
+
+/**
+ * DNS answer cache
+ */
+typedef struct ldns_struct_cache ldns_cache;
+
+/**
+ * Creates a new, empty, answer cache
+ *
+ * \param[in] max_size the maximum number of bytes the cached answers may
+ *            take, or 0 for LDNS_CACHE_DEFAULT_SIZE
+ * \return the new cache, or NULL on allocation failure
+ */
+ldns_cache *ldns_cache_new(size_t max_size);
+
+/**
+ * Frees a cache and all answers in it
+ *
+ * \param[in] cache the cache to free
+ */
+void ldns_cache_free(ldns_cache *cache);
+
+/**
+ * Removes all answers from a cache
+ *
+ * \param[in] cache the cache to empty
+ */
+void ldns_cache_clear(ldns_cache *cache);
+
+/**
+ * Looks up the answer to a query in the cache.
+ *
+ * Answers are found by the name, type and class of the question and the
+ * RD, CD and DO bits of the query. Queries that are not standard queries
+ * for a single question, carry EDNS options or are TSIG signed are never
+ * answered from the cache. The TTLs in the returned answer are reduced
+ * by the time it spent in the cache and its id is set to that of the
+ * query.
+ *
+ * \param[in] cache the cache to look in
+ * \param[in] query the query to find the answer for
+ * \return a newly allocated copy of the answer, or NULL if there is none
+ */
+ldns_pkt *ldns_cache_lookup(ldns_cache *cache, const ldns_pkt *query);
+
+/**
+ * Stores the answer to a query in the cache, for as long as
+ * ldns_pkt_cache_ttl() allows. Answers that may not be cached, and
+ * answers to queries ldns_cache_lookup() would never look up, are
+ * ignored.
+ *
+ * \param[in] cache the cache to store the answer in
+ * \param[in] query the query that was sent
+ * \param[in] answer the answer that was received; it is copied
+ */
+void ldns_cache_store(ldns_cache *cache,
+		const ldns_pkt *query, const ldns_pkt *answer);
+
+/**
+ * Returns the number of bytes the answers in the cache take
+ *
+ * \param[in] cache the cache
+ * \return the size of the cache
+ */
+size_t ldns_cache_size(ldns_cache *cache);
+
+/**
+ * Returns the number of seconds an answer may be cached.
+ *
+ * For answers with data this is the lowest TTL in the answer and
+ * authority sections. For NXDOMAIN and NODATA answers it is the lower of
+ * the TTL and the minimum field of the SOA in the authority section. It
+ * is 0 for truncated answers, answers with an rcode other than NOERROR
+ * or NXDOMAIN, and negative answers without a SOA (like referrals).
+ *
+ * \param[in] answer the answer
+ * \return the number of seconds the answer may be cached
+ */
+uint32_t ldns_pkt_cache_ttl(const ldns_pkt *answer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LDNS_CACHE_H */
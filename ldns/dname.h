@@ -58,9 +58,9 @@ ldns_rdf *ldns_dname_cat_clone(const ldns_rdf *rd1, const ldns_rdf *rd2);
 
 /**
  * concatenates rd2 after rd1 (rd2 is copied, rd1 is modified)
- * \param[in] rd1 the leftside
+ * \param[in] rd1 the leftside, which must not be shared, see ldns_rdf_ref()
  * \param[in] rd2 the rightside
- * \return LDNS_STATUS_OK on success
+ * \return LDNS_STATUS_OK on success, LDNS_STATUS_ERR when rd1 is shared
  */
 ldns_status 	ldns_dname_cat(ldns_rdf *rd1, const ldns_rdf *rd2);
 
@@ -128,6 +128,9 @@ ldns_rdf *ldns_dname_new_frm_data(uint16_t size, const void *data);
 
 /**
  * Put a dname into canonical fmt - ie. lowercase it
+ * The dname is changed in place, also when it is shared (see
+ * ldns_rdf_ref()), so for the owner of an RR of a zone with interned
+ * owners use ldns_rr2canonical() instead.
  * \param[in] rdf the dname to lowercase
  * \return void
  */
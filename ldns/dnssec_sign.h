@@ -4,6 +4,8 @@
 #define LDNS_DNSSEC_SIGN_H
 
 #include <ldns/dnssec.h>
+#include <ldns/sign_cache.h>
+#include <ldns/sign_backend.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +48,77 @@ ldns_sign_public_buffer(ldns_buffer *sign_buf, ldns_key *key);
  */
 ldns_rr_list *ldns_sign_public(ldns_rr_list *rrset, ldns_key_list *keys);
 
+/**
+ * A context for signing many RRsets, with ldns_sign_public_ctx(). It keeps
+ * the buffers for the data to sign and, for every key it has signed with,
+ * the RRSIG rdata up to the signature and an EVP_MD_CTX that is set up for
+ * the key, so that these are made once instead of for every RRset.
+ *
+ * A context may be used by one thread at a time. It holds a reference to
+ * the EVP_PKEYs of the keys until it is freed.
+ */
+typedef struct ldns_struct_sign_ctx ldns_sign_ctx;
+
+/**
+ * Creates a signing context
+ * \return the context, or NULL on allocation failure
+ */
+ldns_sign_ctx *ldns_sign_ctx_new(void);
+
+/**
+ * Signs an rrset, like ldns_sign_public(), with the buffers and the set up
+ * keys of a signing context. The RRs are written in canonical form and
+ * order to the context, they are not cloned or changed. With a backend,
+ * the signatures are filled in by ldns_sign_ctx_wait().
+ * \param[in] ctx the signing context
+ * \param[in] rrset the rrset
+ * \param[in] keys the keys to use
+ * \return a rr_list with the signatures, or NULL on error
+ */
+ldns_rr_list *ldns_sign_public_ctx(ldns_sign_ctx *ctx,
+		const ldns_rr_list *rrset, ldns_key_list *keys);
+
+/**
+ * Makes a signing context look up the signatures it would make in a cache
+ * first, and store the signatures it makes in it. Signatures are found when
+ * the key, the RRSIG rdata before the signature and the canonical RRset
+ * are the same, see ldns_sign_cache.
+ * \param[in] ctx the signing context
+ * \param[in] cache the cache, which must stay valid while the context is
+ *            used, or NULL to sign without one
+ */
+void ldns_sign_ctx_set_cache(ldns_sign_ctx *ctx, ldns_sign_cache *cache);
+
+/**
+ * Makes a signing context have its signatures made by a backend. The
+ * RRSIGs that ldns_sign_public_ctx() returns then have a signature of
+ * zeros, which is replaced by ldns_sign_ctx_wait(), so they must not be
+ * freed before that. Meanwhile the backend signs them while more RRsets
+ * are signed. Signatures that are in the cache of the context are filled
+ * in right away.
+ * \param[in] ctx the signing context
+ * \param[in] backend the backend, which must stay valid while the context
+ *            is used, or NULL to sign in the context itself
+ */
+void ldns_sign_ctx_set_backend(ldns_sign_ctx *ctx,
+		ldns_sign_backend *backend);
+
+/**
+ * Waits for the backend of a signing context to make the signatures of
+ * the RRSIGs that ldns_sign_public_ctx() returned, and fills them in.
+ * \param[in] ctx the signing context
+ * \return LDNS_STATUS_OK when all signatures are filled in, or the first
+ *         error since the last call, in which case RRSIGs may be left
+ *         with the signature of zeros
+ */
+ldns_status ldns_sign_ctx_wait(ldns_sign_ctx *ctx);
+
+/**
+ * Frees a signing context
+ * \param[in] ctx the context to free
+ */
+void ldns_sign_ctx_free(ldns_sign_ctx *ctx);
+
 #if LDNS_BUILD_CONFIG_HAVE_SSL
 /**
  * Sign a buffer with the DSA key (hash with SHA1)
@@ -195,6 +268,22 @@ ldns_status ldns_dnssec_zone_create_rrsigs_flg(ldns_dnssec_zone *zone,
 					void *arg,
 					int flags);
 
+/**
+ * Adds signatures to the zone like ldns_dnssec_zone_create_rrsigs_flg(),
+ * with a signing context, so that its cache and backend are used. The
+ * signatures of a backend are filled in before this returns.
+ * \param[in] sign_ctx the signing context, or NULL to sign with one of
+ *            its own
+ * \return LDNS_STATUS_OK on success, error otherwise
+ */
+ldns_status ldns_dnssec_zone_create_rrsigs_ctx(ldns_dnssec_zone *zone,
+					ldns_rr_list *new_rrs,
+					ldns_key_list *key_list,
+					int (*func)(ldns_rr *, void*),
+					void *arg,
+					int flags,
+					ldns_sign_ctx *sign_ctx);
+
 /**
  * Adds signatures to the zone
  *
@@ -246,6 +335,21 @@ ldns_status ldns_dnssec_zone_sign_flg(ldns_dnssec_zone *zone,
 					void *arg, 
 					int flags);
 
+/**
+ * signs the given zone like ldns_dnssec_zone_sign_flg(), with a signing
+ * context, see ldns_dnssec_zone_create_rrsigs_ctx()
+ * \param[in] sign_ctx the signing context, or NULL to sign with one of
+ *            its own
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_sign_ctx(ldns_dnssec_zone *zone,
+					ldns_rr_list *new_rrs,
+					ldns_key_list *key_list,
+					int (*func)(ldns_rr *, void *),
+					void *arg,
+					int flags,
+					ldns_sign_ctx *sign_ctx);
+
 /**
  * signs the given zone with the given new zone, with NSEC3
  *
@@ -307,6 +411,28 @@ ldns_status ldns_dnssec_zone_sign_nsec3_flg_mkmap(ldns_dnssec_zone *zone,
 				ldns_rbtree_t **map
 				);
 
+/**
+ * signs the given zone with NSEC3 like
+ * ldns_dnssec_zone_sign_nsec3_flg_mkmap(), with a signing context, see
+ * ldns_dnssec_zone_create_rrsigs_ctx()
+ * \param[in] sign_ctx the signing context, or NULL to sign with one of
+ *            its own
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_sign_nsec3_ctx(ldns_dnssec_zone *zone,
+				ldns_rr_list *new_rrs,
+				ldns_key_list *key_list,
+				int (*func)(ldns_rr *, void *),
+				void *arg,
+				uint8_t algorithm,
+				uint8_t flags,
+				uint16_t iterations,
+				uint8_t salt_length,
+				uint8_t *salt,
+				int signflags,
+				ldns_rbtree_t **map,
+				ldns_sign_ctx *sign_ctx);
+
 
 /**
  * signs the given zone with the given keys
@@ -380,6 +506,111 @@ ldns_zone *ldns_zone_sign(const ldns_zone *zone, ldns_key_list *key_list);
  * \return signed zone
  */
 ldns_zone *ldns_zone_sign_nsec3(ldns_zone *zone, ldns_key_list *key_list, uint8_t algorithm, uint8_t flags, uint16_t iterations, uint8_t salt_length, uint8_t *salt);
+
+/**
+ * Signs a zone one name at a time, while it is read, and prints the
+ * signed zone as it goes, so that the memory used does not grow with the
+ * size of the zone. The RRs must be given in canonical order (RFC 4034
+ * section 6), as ldns-read-zone -z prints them, starting with the apex
+ * and its SOA.
+ *
+ * With NSEC, a name is printed once the next authoritative name is read,
+ * which its NSEC points to. Glue is held with the name before it. With
+ * NSEC3, every name is printed right away, and its NSEC3 is kept in an
+ * ldns_rr_sorter, which may write it to a temporary file. The NSEC3s are
+ * chained and printed in hash order at the end, after all names.
+ */
+typedef struct ldns_struct_dnssec_zone_signer ldns_dnssec_zone_signer;
+
+/**
+ * Creates a signer that prints the signed zone to a file
+ * \param[out] signer the signer
+ * \param[in] out the file to print the signed zone to
+ * \param[in] fmt the format of the printed zone, or NULL for the default
+ * \param[in] key_list the keys to sign with, which must stay valid
+ * \param[in] func callback function that decides what to do with old
+ *            signatures, see ldns_dnssec_zone_sign()
+ * \param[in] arg optional argument for the callback function
+ * \param[in] signflags option flags for signing process, like for
+ *            ldns_dnssec_zone_sign_flg(). A ZONEMD can not be added.
+ * \return LDNS_STATUS_OK, LDNS_STATUS_NOT_IMPL when a ZONEMD is asked
+ *         for, or an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_signer_new(ldns_dnssec_zone_signer **signer,
+		FILE *out, const ldns_output_format *fmt,
+		ldns_key_list *key_list,
+		int (*func)(ldns_rr *, void *), void *arg, int signflags);
+
+/**
+ * Makes the signer deny existence with NSEC3 instead of NSEC. Must be
+ * called before the first RR is added.
+ * \param[in] signer the signer
+ * \param[in] algorithm the NSEC3 hashing algorithm to use
+ * \param[in] flags NSEC3 flags
+ * \param[in] iterations the number of NSEC3 hash iterations to use
+ * \param[in] salt_length the length (in octets) of the NSEC3 salt
+ * \param[in] salt the NSEC3 salt data
+ * \param[in] max_memory about the number of bytes the NSEC3 RRs may take
+ *            in memory before they are written to a temporary file, or 0
+ *            to keep them all in memory
+ * \param[in] tmpdir the directory for the temporary files, or NULL for
+ *            the default of the system
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_signer_set_nsec3(
+		ldns_dnssec_zone_signer *signer,
+		uint8_t algorithm, uint8_t flags, uint16_t iterations,
+		uint8_t salt_length, const uint8_t *salt,
+		size_t max_memory, const char *tmpdir);
+
+/**
+ * Makes the signer reuse the signatures in a cache, and store the ones it
+ * makes in it, see ldns_sign_ctx_set_cache().
+ * \param[in] signer the signer
+ * \param[in] cache the cache, which must stay valid while the signer is
+ *            used, or NULL to sign without one
+ */
+void ldns_dnssec_zone_signer_set_cache(ldns_dnssec_zone_signer *signer,
+		ldns_sign_cache *cache);
+
+/**
+ * Makes the signer have its signatures made by a backend, see
+ * ldns_sign_ctx_set_backend(). The signed names are then printed when
+ * the signatures of a number of them are complete.
+ * \param[in] signer the signer
+ * \param[in] backend the backend, which must stay valid while the signer
+ *            is used, or NULL to sign without one
+ */
+void ldns_dnssec_zone_signer_set_backend(ldns_dnssec_zone_signer *signer,
+		ldns_sign_backend *backend);
+
+/**
+ * Adds the next RR of the zone to the signer, which then owns it. When
+ * the RR has another owner than the RR before it, the name of that RR is
+ * complete, and is signed. NSEC and NSEC3 RRs, and their signatures, are
+ * dropped, because the signer makes them anew.
+ * \param[in] signer the signer
+ * \param[in] rr the RR
+ * \return LDNS_STATUS_OK, LDNS_STATUS_NOT_CANONICAL_ORDER when the owner of
+ *         the RR comes before that of the RR before it, LDNS_STATUS_NO_SOA
+ *         when the first name has no SOA, or another error. On error
+ *         the RR is still the caller's.
+ */
+ldns_status ldns_dnssec_zone_signer_add_rr(ldns_dnssec_zone_signer *signer,
+		ldns_rr *rr);
+
+/**
+ * Signs and prints the names that are left, after the last RR is added
+ * \param[in] signer the signer
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_signer_finish(ldns_dnssec_zone_signer *signer);
+
+/**
+ * Frees a signer, with the RRs and temporary files it still has
+ * \param[in] signer the signer to free
+ */
+void ldns_dnssec_zone_signer_free(ldns_dnssec_zone_signer *signer);
  
 #ifdef __cplusplus
 }
@@ -89,6 +89,64 @@ ldns_dnssec_data_chain *ldns_dnssec_build_data_chain(ldns_resolver *res,
 										   const ldns_pkt *pkt,
 										   ldns_rr *orig_rr);
 
+/**
+ * Cache of DNSSEC answers and signature verifications, shared between
+ * the building of data chains and the deriving of trust trees.
+ *
+ * Answers to the DNSKEY, DS and other queries needed to build a chain are
+ * kept for as long as their TTLs allow (negative answers for as long as
+ * their SOA allows), and successful signature verifications for as long
+ * as the TTLs of the rrset, its RRSIG and the DNSKEY allow. The least
+ * recently used entries are dropped when the cache is full.
+ *
+ * Answers are kept by the nameservers and port of the resolver that
+ * asked, and by whether it set the DO and CD bits, so one cache may be
+ * used with several resolvers.
+ *
+ * When ldns is built with thread support, the cache is locked
+ * internally and may be used by several threads at the same time.
+ */
+typedef struct ldns_struct_dnssec_cache ldns_dnssec_cache;
+
+/**
+ * Creates a new, empty, DNSSEC cache
+ *
+ * \param[in] max_entries the maximum number of entries to keep,
+ *             or 0 for the default of 4096
+ * \return the new cache, or NULL on allocation failure
+ */
+ldns_dnssec_cache *ldns_dnssec_cache_new(size_t max_entries);
+
+/**
+ * Frees a DNSSEC cache and everything in it
+ *
+ * \param[in] *cache The cache to free
+ */
+void ldns_dnssec_cache_free(ldns_dnssec_cache *cache);
+
+/**
+ * Build an ldns_dnssec_data_chain like ldns_dnssec_build_data_chain(),
+ * answering the needed queries from the cache when possible and
+ * storing the answers received from the network in it.
+ *
+ * \param[in] *res resolver structure for further needed queries
+ * \param[in] *cache the cache to use, may be NULL
+ * \param[in] qflags resolution flags
+ * \param[in] *data_set The original rrset where the chain ends
+ * \param[in] *pkt optional, can contain the original packet
+ * (and hence the sigs and maybe the key)
+ * \param[in] *orig_rr The original Resource Record
+ *
+ * \return the DNSSEC data chain
+ */
+ldns_dnssec_data_chain *ldns_dnssec_build_data_chain_cache(
+		ldns_resolver *res,
+		ldns_dnssec_cache *cache,
+		const uint16_t qflags,
+		const ldns_rr_list *data_set,
+		const ldns_pkt *pkt,
+		ldns_rr *orig_rr);
+
 /**
  * Tree structure that contains the relation of DNSSEC data,
  * and their cryptographic status.
@@ -239,6 +297,24 @@ ldns_dnssec_trust_tree *ldns_dnssec_derive_trust_tree_time(
 		ldns_dnssec_data_chain *data_chain, 
 		ldns_rr *rr, time_t check_time);
 
+/**
+ * Generates a dnssec_trust_tree for the given rr from the
+ * given data_chain like ldns_dnssec_derive_trust_tree_time(),
+ * skipping the signature verifications the cache has seen succeed
+ * before. The validity periods of those signatures are still checked
+ * against check_time.
+ *
+ * \param[in] *data_chain The chain to derive the trust tree from
+ * \param[in] *rr The RR this tree will be about
+ * \param[in] check_time the time for which the validation is performed
+ * \param[in] *cache the cache to use, may be NULL
+ * \return ldns_dnssec_trust_tree *
+ */
+ldns_dnssec_trust_tree *ldns_dnssec_derive_trust_tree_cache(
+		ldns_dnssec_data_chain *data_chain,
+		ldns_rr *rr, time_t check_time,
+		ldns_dnssec_cache *cache);
+
 /**
  * Sub function for derive_trust_tree that is used for a 'normal' rrset
  *
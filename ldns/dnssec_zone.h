@@ -10,6 +10,7 @@
  
 #include <ldns/rbtree.h>
 #include <ldns/host2str.h>
+#include <ldns/resolver.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -100,6 +101,10 @@ struct ldns_struct_dnssec_zone {
 	 *  to calculate hashed names
 	 */
 	ldns_rr *_nsec3params;
+	/** optional hash index of the names, see
+	 *  ldns_dnssec_zone_create_index()
+	 */
+	struct ldns_struct_dnssec_zone_index *_index;
 };
 typedef struct ldns_struct_dnssec_zone ldns_dnssec_zone;
 
@@ -420,6 +425,104 @@ void ldns_dnssec_zone_deep_free(ldns_dnssec_zone *zone);
 ldns_status ldns_dnssec_zone_add_rr(ldns_dnssec_zone *zone,
 							 ldns_rr *rr);
 
+/**
+ * Removes the RR equal to the given RR from the zone.
+ * Names left without RRs are removed too.
+ *
+ * \param[in] zone the zone to remove the RR from
+ * \param[in] rr the RR to remove
+ * \return the removed RR, which the caller must free, or NULL if the zone
+ * has no such RR
+ */
+ldns_rr *ldns_dnssec_zone_remove_rr(ldns_dnssec_zone *zone,
+		const ldns_rr *rr);
+
+/**
+ * Interns the owner names of the RRs in the zone: RRs whose owner is
+ * the same as the name they are under, byte for byte, get a reference to
+ * the name instead (see ldns_rdf_ref()), so that all RRs of a name share
+ * one owner. This saves memory in zones with several RRs per name.
+ *
+ * Afterwards the owners of the RRs in the zone must not be changed in
+ * place, with ldns_dname2canonical() for example, because that would
+ * change them for all RRs of the name. ldns_rr2canonical() and
+ * ldns_rr_set_owner() with a new owner are fine, and
+ * ldns_dnssec_zone_remove_rr() gives removed RRs an owner of their own.
+ *
+ * \param[in] zone the zone
+ */
+void ldns_dnssec_zone_intern_owners(ldns_dnssec_zone *zone);
+
+/**
+ * Creates a hash index of the names in the zone, with which
+ * ldns_dnssec_zone_add_rr(), ldns_dnssec_zone_remove_rr() and
+ * ldns_dnssec_zone_find_rrset() find names without searching the tree.
+ * The index also keeps the RRs of large RRsets in sorted arrays, so
+ * that adding to and removing from them does not walk the list of RRs.
+ *
+ * The index is kept up to date by ldns_dnssec_zone_add_rr() and
+ * ldns_dnssec_zone_remove_rr() only. Adding or removing names or RRs
+ * (but not signatures, NSEC or NSEC3) in other ways while the zone has
+ * an index, with ldns_dnssec_name_add_rr(), ldns_dnssec_rrsets_add_rr()
+ * or ldns_dnssec_rrs_add_rr(), or by linking or unlinking
+ * ldns_dnssec_rrs nodes or names directly, makes lookups stale: call
+ * ldns_dnssec_zone_free_index() first, and create the index again
+ * after the change if it is still wanted.
+ *
+ * \param[in] zone the zone to index
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_create_index(ldns_dnssec_zone *zone);
+
+/**
+ * Frees the index made with ldns_dnssec_zone_create_index(), if any.
+ * Freeing the zone frees its index too.
+ *
+ * \param[in] zone the zone to free the index of
+ */
+void ldns_dnssec_zone_free_index(ldns_dnssec_zone *zone);
+
+/**
+ * Brings the zone up to date with a zone transfer.
+ * When the zone has a SOA, an IXFR for its serial is sent, and the
+ * differences are applied to the zone once the transfer is complete.
+ * Otherwise, or when the whole zone is sent in reply, the zone is
+ * replaced by the transferred one. The RRs are read with
+ * ldns_xfr_stream().
+ *
+ * The zone must own its RRs (be freed with ldns_dnssec_zone_deep_free()),
+ * because RRs deleted by the transfer are freed. When the transfer fails,
+ * the zone is left as it was. When the differences cannot be applied to
+ * it, because they are from another version or adding an RR fails, the
+ * whole zone is transferred instead; only when that fails as well may
+ * the zone be left partly updated.
+ *
+ * \param[in] zone the zone to update
+ * \param[in] res the resolver whose nameservers to transfer from
+ * \param[in] name the name of the zone
+ * \param[in] c the class of the zone
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_xfr(ldns_dnssec_zone *zone, ldns_resolver *res,
+		const ldns_rdf *name, ldns_rr_class c);
+
+/**
+ * Brings the zone up to date with a zone transfer, like
+ * ldns_dnssec_zone_xfr(), but reads the transfer with
+ * ldns_xfr_pipeline(), so that the messages are parsed by worker
+ * threads while the transfer is being read.
+ *
+ * \param[in] zone the zone to update
+ * \param[in] res the resolver whose nameservers to transfer from
+ * \param[in] name the name of the zone
+ * \param[in] c the class of the zone
+ * \param[in] workers the number of threads that parse messages
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_dnssec_zone_xfr_pipeline(ldns_dnssec_zone *zone,
+		ldns_resolver *res, const ldns_rdf *name, ldns_rr_class c,
+		size_t workers);
+
 /**
  * Prints the rbtree of ldns_dnssec_name structures to the file descriptor
  *
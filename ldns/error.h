@@ -141,7 +141,10 @@ enum ldns_enum_status {
 	LDNS_STATUS_RESERVED_SVCPARAM_KEY,
 	LDNS_STATUS_NO_SVCPARAM_VALUE_EXPECTED,
 	LDNS_STATUS_SVCPARAM_KEY_MORE_THAN_ONCE,
-	LDNS_STATUS_INVALID_SVCPARAM_VALUE
+	LDNS_STATUS_INVALID_SVCPARAM_VALUE,
+	LDNS_STATUS_XFR_ERR,
+	LDNS_STATUS_NOT_CANONICAL_ORDER,
+	LDNS_STATUS_NO_SOA
 };
 typedef enum ldns_enum_status ldns_status;
 
@@ -36,6 +36,20 @@ extern "C" {
  */
 ldns_rr_list *ldns_get_rr_list_addr_by_name(ldns_resolver *r, const ldns_rdf *name, ldns_rr_class c, uint16_t flags);
 
+/**
+ * Ask the resolver about several names at the same time
+ * and return all address records for all of them.
+ * The AAAA and A queries for all names are in flight together
+ * (see ldns_resolver_send_multi()).
+ * \param[in] r the resolver to use
+ * \param[in] names array of names to look for
+ * \param[in] count the number of names
+ * \param[in] c the class to use
+ * \param[in] flags give some optional flags to the query
+ * \return ldns_rr_list * with the address records, or NULL if none were found
+ */
+ldns_rr_list *ldns_get_rr_list_addr_by_names(ldns_resolver *r, ldns_rdf * const *names, size_t count, ldns_rr_class c, uint16_t flags);
+
 /**
  * ask the resolver about the address
  * and return the name
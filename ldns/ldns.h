@@ -94,6 +94,7 @@ Or you can just use the menu above to browse through the API docs.
 
 #include <ldns/util.h>
 #include <ldns/buffer.h>
+#include <ldns/cache.h>
 #include <ldns/common.h>
 #include <ldns/dane.h>
 #include <ldns/dname.h>
@@ -120,10 +121,14 @@ Or you can just use the menu above to browse through the API docs.
 #include <ldns/parse.h>
 #include <ldns/zone.h>
 #include <ldns/dnssec_zone.h>
+#include <ldns/sorter.h>
+#include <ldns/zone_diff.h>
 #include <ldns/radix.h>
 #include <ldns/rbtree.h>
 #include <ldns/sha1.h>
 #include <ldns/sha2.h>
+#include <ldns/sign_cache.h>
+#include <ldns/sign_backend.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -794,6 +794,39 @@ ldns_pkt *ldns_pkt_new(void);
  */
 void ldns_pkt_free(ldns_pkt *packet);
 
+/**
+ * Resets a packet to the state of a new one. The RRs and the other data
+ * in the packet are freed, but the header and the section lists, with
+ * the capacity they have grown to, are kept for the next use.
+ * \param[in] packet the packet to reset
+ */
+void ldns_pkt_reset(ldns_pkt *packet);
+
+/**
+ * Returns a packet, as made by ldns_pkt_new(), from the pool of recycled
+ * packets of the calling thread, or a new one when the pool is empty.
+ * The packet can be freed with ldns_pkt_free() like any other, or be
+ * given back to the pool with ldns_pkt_recycle().
+ * \return pointer to the packet
+ */
+ldns_pkt *ldns_pkt_new_pooled(void);
+
+/**
+ * Resets a packet with ldns_pkt_reset() and puts it in the pool of the
+ * calling thread, for reuse by ldns_pkt_new_pooled(). It is freed instead
+ * when the pool is full or when its sections have grown large. Any
+ * packet can be recycled.
+ * \param[in] packet the packet to recycle
+ */
+void ldns_pkt_recycle(ldns_pkt *packet);
+
+/**
+ * Frees the recycled packets in the pool of the calling thread. This
+ * happens by itself when a thread exits, and at exit() for the thread
+ * that calls it.
+ */
+void ldns_pkt_pool_free(void);
+
 /**
  * creates a query packet for the given name, type, class.
  * \param[out] p the packet to be returned
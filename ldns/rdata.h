@@ -201,6 +201,13 @@ struct ldns_struct_rdf
 	ldns_rdf_type _type;
 	/** Pointer to the data (raw octets) */
 	void  *_data;
+	/**
+	 * The number of references beyond the first, see ldns_rdf_ref().
+	 * Zero for rdfs that are not shared, also when they are not made
+	 * with one of the ldns_rdf_new() functions. It is the last field,
+	 * so that initializers of the fields before it stay valid.
+	 */
+	uint32_t _refs;
 };
 typedef struct ldns_struct_rdf ldns_rdf;
 
@@ -312,7 +319,8 @@ ldns_status ldns_rdf_new_frm_fp_l(ldns_rdf **r, ldns_rdf_type type, FILE *fp, in
 
 /**
  * frees a rdf structure, leaving the
- * data pointer intact.
+ * data pointer intact. When the rdf is shared, only the reference
+ * is dropped.
  * \param[in] rd the pointer to be freed
  * \return void
  */
@@ -321,11 +329,35 @@ void ldns_rdf_free(ldns_rdf *rd);
 /**
  * frees a rdf structure _and_ frees the
  * data. rdf should be created with _new_frm_data
+ * When the rdf is shared, only the reference is dropped.
  * \param[in] rd the rdf structure to be freed
  * \return void
  */
 void ldns_rdf_deep_free(ldns_rdf *rd);
 
+/**
+ * Shares an rdf, made with one of the ldns_rdf_new() functions, instead of
+ * cloning it: adds a reference to it and returns it. Every reference is
+ * dropped with ldns_rdf_deep_free(), and the rdf is freed with the last
+ * one. ldns_dnssec_zone_intern_owners() shares the owner names of the
+ * RRs of a zone this way.
+ *
+ * A shared rdf must not be changed in place, by ldns_dname2canonical()
+ * or ldns_dname_cat() for example, because that changes it for all of
+ * its holders. Replace it with a clone first, as ldns_rr2canonical()
+ * does for the owner of an RR. ldns_dname_cat() refuses shared rdfs.
+ * \param[in] rd the rdf to share
+ * \return rd
+ */
+ldns_rdf *ldns_rdf_ref(ldns_rdf *rd);
+
+/**
+ * Returns whether there is more than one reference to an rdf
+ * \param[in] rd the rdf
+ * \return true when the rdf is shared
+ */
+bool ldns_rdf_is_shared(const ldns_rdf *rd);
+
 /* conversion functions */
 
 /**
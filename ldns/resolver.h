@@ -26,6 +26,7 @@
 #include <ldns/tsig.h>
 #include <ldns/rdata.h>
 #include <ldns/packet.h>
+#include <ldns/cache.h>
 #include <sys/time.h>
 
 #ifdef __cplusplus
@@ -143,6 +144,13 @@ struct ldns_struct_resolver
 
 	/** Source address to query from */
 	ldns_rdf *_source;
+
+	/** Number of nameservers to query simultaneously over UDP
+	 * (0 or 1: one after another) */
+	uint8_t _fanout;
+
+	/** Cache to answer queries from, not owned by the resolver */
+	ldns_cache *_cache;
 };
 typedef struct ldns_struct_resolver ldns_resolver;
 
@@ -265,6 +273,18 @@ bool ldns_resolver_igntc(const ldns_resolver *r);
  * \return true: yes, false: no
  */
 bool ldns_resolver_random(const ldns_resolver *r);
+/**
+ * How many nameservers are queried at the same time over UDP
+ * \param[in] r the resolver
+ * \return the number of nameservers (0 or 1 means one after another)
+ */
+uint8_t ldns_resolver_fanout(const ldns_resolver *r);
+/**
+ * Get the cache the resolver answers queries from
+ * \param[in] r the resolver
+ * \return the cache, or NULL if the resolver has none
+ */
+ldns_cache *ldns_resolver_cache(const ldns_resolver *r);
 /**
  * How many nameserver are configured in the resolver
  * \param[in] r the resolver
@@ -566,6 +586,26 @@ void ldns_resolver_set_nameserver_rtt(ldns_resolver *r, size_t pos, size_t value
  */
 void ldns_resolver_set_random(ldns_resolver *r, bool b);
 
+/**
+ * Set the number of nameservers that are queried at the same time over
+ * UDP. The first answer received is used. The nameservers that answered
+ * fastest before are preferred; when none answer the next ones are tried
+ * on retry. A value larger than the number of nameservers queries them all.
+ * \param[in] r the resolver
+ * \param[in] fanout the number of nameservers (0 or 1: one after another)
+ */
+void ldns_resolver_set_fanout(ldns_resolver *r, uint8_t fanout);
+
+/**
+ * Set the cache the resolver answers queries from, and stores the
+ * answers it receives in. The cache is not freed with the resolver, so
+ * it can be shared between resolvers (and threads). Answers are kept
+ * apart by the nameservers and port of the resolver that received them.
+ * \param[in] r the resolver
+ * \param[in] cache the cache, or NULL to always query the nameservers
+ */
+void ldns_resolver_set_cache(ldns_resolver *r, ldns_cache *cache);
+
 /**
  * Push a new nameserver to the resolver. It must be an IP
  * address v4 or v6.
@@ -656,6 +696,26 @@ ldns_status ldns_resolver_send(ldns_pkt **answer, ldns_resolver *r, const ldns_r
  */
 ldns_status ldns_resolver_send_pkt(ldns_pkt **answer, ldns_resolver *r, ldns_pkt *query_pkt);
 
+/**
+ * Send several queries for names as-is at the same time. Over UDP all
+ * queries are in flight together (each to ldns_resolver_fanout()
+ * nameservers), so the total time is that of the slowest answer instead
+ * of the sum of all answers. Truncated answers are retried with EDNS
+ * and/or TCP when fallback is set. TCP and TSIG signed queries are sent
+ * one after another.
+ * \param[out] answers array of count packet pointers, set to the answers
+ *             (or NULL for the queries that were not answered)
+ * \param[in] *r operate using this resolver
+ * \param[in] names array of count names to query for
+ * \param[in] types array of count types to query for (0 defaults to A)
+ * \param[in] count the number of queries
+ * \param[in] c query for this class (may be 0, default to IN)
+ * \param[in] flags the query flags
+ *
+ * \return ldns_status LDNS_STATUS_OK when all queries were answered
+ */
+ldns_status ldns_resolver_send_multi(ldns_pkt **answers, ldns_resolver *r, ldns_rdf * const *names, const ldns_rr_type *types, size_t count, ldns_rr_class c, uint16_t flags);
+
 /**
  * Send a query to a nameserver
  * \param[out] pkt a packet with the reply from the nameserver
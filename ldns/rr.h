@@ -328,9 +328,20 @@ struct ldns_struct_rr
 		 ABI change: Fix this in next major release
 	 */
 	bool		_rr_question;
+	/**  The number of references to the RR, see ldns_rr_ref() */
+	uint32_t	_refcount;
 };
 typedef struct ldns_struct_rr ldns_rr;
 
+/**
+ * Scratch space for reading RRs from presentation format.
+ *
+ * Reading many RRs (a zone file for example) with one parse context
+ * saves allocating and freeing the buffers needed for parsing each RR.
+ * A parse context may be used by one thread at a time only.
+ */
+typedef struct ldns_struct_rr_parse_ctx ldns_rr_parse_ctx;
+
 /**
  * List or Set of Resource Records
  *
@@ -401,12 +412,43 @@ ldns_rr* ldns_rr_new(void);
 ldns_rr* ldns_rr_new_frm_type(ldns_rr_type t);
 
 /**
- * frees an RR structure
+ * frees an RR structure. When the RR is shared, only the reference
+ * is dropped and the RR is freed with the last one.
  * \param[in] *rr the RR to be freed
  * \return void
  */
 void ldns_rr_free(ldns_rr *rr);
 
+/**
+ * Shares an RR instead of cloning it: adds a reference to it and returns
+ * it. Every reference is dropped with ldns_rr_free(), ldns_rr_list_deep_free()
+ * and the like, and the RR is freed with the last one. References may be
+ * taken and dropped from several threads.
+ *
+ * A shared RR must not be changed by any of the holders of a reference.
+ * Make it a private copy with ldns_rr_unshare() first.
+ * \param[in] *rr the RR to share
+ * \return rr
+ */
+ldns_rr *ldns_rr_ref(ldns_rr *rr);
+
+/**
+ * Returns whether there is more than one reference to an RR
+ * \param[in] *rr the RR
+ * \return true when the RR is shared
+ */
+bool ldns_rr_is_shared(const ldns_rr *rr);
+
+/**
+ * Copy on write: returns an RR that may be changed by the caller. When rr
+ * is not shared that is rr itself. Otherwise it is a clone, and the
+ * reference of the caller to rr is dropped.
+ * \param[in] *rr the RR the caller has a reference to
+ * \return the RR to change, or NULL on failure, in which case the
+ *         caller keeps its reference to rr
+ */
+ldns_rr *ldns_rr_unshare(ldns_rr *rr);
+
 /**
  * creates an rr from a string.
  * The string should be a fully filled-in rr, like
@@ -427,6 +469,38 @@ ldns_status ldns_rr_new_frm_str(ldns_rr **n, const char *str,
                                 uint32_t default_ttl, const ldns_rdf *origin,
                                 ldns_rdf **prev);
 
+/**
+ * creates a new parse context, for use with ldns_rr_new_frm_str_ctx()
+ * and ldns_rr_new_frm_fp_l_ctx()
+ * \return the new parse context or NULL on allocation failure
+ */
+ldns_rr_parse_ctx *ldns_rr_parse_ctx_new(void);
+
+/**
+ * frees a parse context
+ * \param[in] ctx the parse context to free
+ */
+void ldns_rr_parse_ctx_free(ldns_rr_parse_ctx *ctx);
+
+/**
+ * creates an rr from a string, like ldns_rr_new_frm_str(), but uses the
+ * buffers in a parse context instead of allocating its own.
+ * \param[in] ctx the parse context to use
+ * \param[out] n the rr to return
+ * \param[in] str the string to convert
+ * \param[in] default_ttl default ttl value for the rr.
+ *            If 0 DEF_TTL will be used
+ * \param[in] origin when the owner is relative add this.
+ *	The caller must ldns_rdf_deep_free it.
+ * \param[out] prev the previous ownername. if this value is not NULL,
+ * the function overwrites this with the ownername found in this
+ * string. The caller must then ldns_rdf_deep_free it.
+ * \return a status msg describing an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_new_frm_str_ctx(ldns_rr_parse_ctx *ctx, ldns_rr **n,
+                                const char *str, uint32_t default_ttl,
+                                const ldns_rdf *origin, ldns_rdf **prev);
+
 /**
  * creates an rr for the question section from a string, i.e.
  * without RDATA fields
@@ -476,6 +550,27 @@ ldns_status ldns_rr_new_frm_fp(ldns_rr **rr, FILE *fp, uint32_t *default_ttl, ld
  */
 ldns_status ldns_rr_new_frm_fp_l(ldns_rr **rr, FILE *fp, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr);
 
+/**
+ * creates a new rr from a file containing a string, like
+ * ldns_rr_new_frm_fp_l(), but uses the buffers in a parse context
+ * instead of allocating its own. The line read from the file is kept
+ * in the parse context, so that the next call can reuse its buffer.
+ * \param[in] ctx the parse context to use
+ * \param[out] rr the new rr
+ * \param[in] fp the file pointer to use
+ * \param[in] default_ttl a default ttl for the rr. If NULL DEF_TTL will be used
+ *            the pointer will be updated if the file contains a $TTL directive
+ * \param[in] origin when the owner is relative add this
+ * 	      the pointer will be updated if the file contains a $ORIGIN directive
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] prev when the owner is whitespaces use this as the * ownername
+ *            the pointer will be updated after the call
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] line_nr pointer to an integer containing the current line number (for debugging purposes)
+ * \return a ldns_status with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_new_frm_fp_l_ctx(ldns_rr_parse_ctx *ctx, ldns_rr **rr, FILE *fp, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr);
+
 /**
  * sets the owner in the rr structure.
  * \param[in] *rr rr to operate on
@@ -772,6 +867,15 @@ ldns_rr* ldns_rr_clone(const ldns_rr *rr);
  */
 ldns_rr_list* ldns_rr_list_clone(const ldns_rr_list *rrlist);
 
+/**
+ * Makes a new list with references to the RRs of rrlist, see ldns_rr_ref().
+ * The new list is freed with ldns_rr_list_deep_free() like a clone, but
+ * its RRs must not be changed before ldns_rr_unshare().
+ * \param[in] rrlist the rrlist to share the RRs of
+ * \return the new rr list
+ */
+ldns_rr_list* ldns_rr_list_share(const ldns_rr_list *rrlist);
+
 /**
  * sorts an rr_list (canonical wire format). the sorting is done inband.
  * \param[in] unsorted the rr_list to be sorted
@@ -779,6 +883,27 @@ ldns_rr_list* ldns_rr_list_clone(const ldns_rr_list *rrlist);
  */
 void ldns_rr_list_sort(ldns_rr_list *unsorted);
 
+/**
+ * Sets the number of threads that sort large rr lists with
+ * ldns_rr_list_sort(), ldns_rr_list_sort_nsec3() and ldns_zone_sort().
+ * Lists of tens of thousands of RRs and more are divided over the
+ * threads. This is a library wide setting that is not protected by a
+ * lock: set it before starting threads that sort, and not while another
+ * thread may be sorting. Without thread support in ldns sorting is
+ * always done in the calling thread.
+ * \param[in] threads the number of threads, 1 to sort in the calling
+ *            thread only, or 0 (the default) for as many threads as
+ *            there are processors (with a maximum of 16)
+ */
+void ldns_rr_list_sort_set_threads(size_t threads);
+
+/**
+ * Returns the number of threads that sort large rr lists, see
+ * ldns_rr_list_sort_set_threads()
+ * \return the number of threads
+ */
+size_t ldns_rr_list_sort_threads(void);
+
 /**
  * compares two rrs. The TTL is not looked at.
  * \param[in] rr1 the first one
@@ -838,6 +963,8 @@ size_t ldns_rr_uncompressed_size(const ldns_rr *r);
 
 /** 
  * converts each dname in a rr to its canonical form.
+ * Names that are shared with other RRs (see ldns_rdf_ref()) are replaced
+ * by a copy of their own first.
  * \param[in] rr the rr to work on
  * \return void
  */
@@ -0,0 +1,173 @@
+/*
+ * sign_backend.h
+ *
+ * backends that make signatures asynchronously
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+/**
+ * \file
+ *
+ * Defines ldns_sign_backend, an interface to something that makes
+ * signatures: it is given batches of requests, each with the data to sign
+ * and the key to sign it with, and completes them while the caller goes
+ * on with other work. Batches may be submitted while earlier ones are
+ * still being signed, so that the signing of many RRsets overlaps.
+ *
+ * Two backends come with ldns: one that signs with OpenSSL in a pool of
+ * threads, ldns_sign_backend_new_openssl(), and one that passes the
+ * requests over a Unix domain socket to a signer in another process,
+ * ldns_sign_backend_new_socket(). The other side of the socket can be
+ * served with ldns_sign_backend_serve(). Other backends, for example for
+ * an HSM, are made by filling in an ldns_sign_backend.
+ *
+ * A signing context (see ldns_sign_ctx_set_backend()) passes the RRsets it
+ * signs to a backend, and fills in the signatures of the RRSIGs when they
+ * are complete.
+ */
+
+#ifndef LDNS_SIGN_BACKEND_H
+#define LDNS_SIGN_BACKEND_H
+
+#include <ldns/common.h>
+#include <ldns/buffer.h>
+#include <ldns/rdata.h>
+#include <ldns/keys.h>
+#include <ldns/error.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A request for a signature
+ */
+struct ldns_struct_sign_request
+{
+	/** The key to sign with */
+	ldns_key *key;
+	/** The data to sign: the RRSIG rdata before the signature, and
+	 * the RRset in canonical form */
+	ldns_buffer *data;
+	/** The signature as in the RRSIG rdata, set by the backend */
+	ldns_rdf *sig;
+	/** Set by the backend: LDNS_STATUS_OK when sig is set, or the
+	 * reason it is not */
+	ldns_status status;
+};
+typedef struct ldns_struct_sign_request ldns_sign_request;
+
+typedef struct ldns_struct_sign_backend ldns_sign_backend;
+
+/**
+ * A backend that makes signatures. It may be used by one thread at a time.
+ */
+struct ldns_struct_sign_backend
+{
+	/** Starts signing a batch of requests. The requests must stay
+	 * valid until wait has returned. On error none of the requests
+	 * are taken. */
+	ldns_status (*submit)(ldns_sign_backend *backend,
+			ldns_sign_request **requests, size_t count);
+	/** Returns when all submitted requests are complete, so that
+	 * their sig and status are set */
+	ldns_status (*wait)(ldns_sign_backend *backend);
+	/** Frees the backend, after waiting for the requests */
+	void (*free)(ldns_sign_backend *backend);
+	/** The data of the backend */
+	void *data;
+};
+
+/**
+ * Signs the data of a request with its key in this process, and sets its
+ * signature and status.
+ * \param[in] request the request
+ */
+void ldns_sign_request_sign(ldns_sign_request *request);
+
+/**
+ * Creates a backend that signs with OpenSSL in a pool of threads. Without
+ * thread support the requests are signed when they are submitted. The keys
+ * are used by several threads at once, so they must be keys that OpenSSL
+ * can use that way, which is not so for all engines.
+ * \param[out] backend the backend
+ * \param[in] threads the number of threads, or 0 for the number of CPUs,
+ *            like ldns_rr_list_sort_threads()
+ * \return LDNS_STATUS_OK, or an error
+ */
+ldns_status ldns_sign_backend_new_openssl(ldns_sign_backend **backend,
+		size_t threads);
+
+/**
+ * Creates a backend that passes the requests over a Unix domain socket to
+ * a signer in another process, such as ldns_sign_backend_serve(). Requests
+ * are written while replies are read, so that the signer can work on a
+ * batch while the next one is submitted.
+ *
+ * A request is the id of the request in 4 bytes, the algorithm of the key
+ * in 1 byte, its key tag in 2, the length of its owner name in 1, the
+ * owner name in canonical wire format, the length of the data in 4 and
+ * the data. The ids count up from 0. A reply is the id in 4 bytes, the
+ * ldns_status in 2, the length of the signature in 2 and the signature,
+ * as in the RRSIG rdata. The replies come in the order of the requests.
+ * All numbers are in network order.
+ * \param[out] backend the backend
+ * \param[in] path the path of the socket to connect to
+ * \return LDNS_STATUS_OK, LDNS_STATUS_NETWORK_ERR when no connection can
+ *         be made, LDNS_STATUS_NOT_IMPL without Unix domain sockets, or
+ *         another error
+ */
+ldns_status ldns_sign_backend_new_socket(ldns_sign_backend **backend,
+		const char *path);
+
+/**
+ * Serves the requests that come in on a connection from
+ * ldns_sign_backend_new_socket(), until it is closed. The requests that
+ * are read at once are signed by a backend as one batch.
+ * \param[in] fd the connection
+ * \param[in] backend the backend that signs, such as one from
+ *            ldns_sign_backend_new_openssl()
+ * \param[in] keys the keys to sign with, which are found by their
+ *            algorithm, key tag and owner name
+ * \return LDNS_STATUS_OK when the connection was closed by the other side,
+ *         or an error
+ */
+ldns_status ldns_sign_backend_serve(int fd, ldns_sign_backend *backend,
+		const ldns_key_list *keys);
+
+/**
+ * Starts signing a batch of requests with a backend.
+ * \param[in] backend the backend
+ * \param[in] requests the requests, which must stay valid until
+ *            ldns_sign_backend_wait() has returned
+ * \param[in] count the number of requests
+ * \return LDNS_STATUS_OK, or an error, in which case none of the requests
+ *         are taken
+ */
+ldns_status ldns_sign_backend_submit(ldns_sign_backend *backend,
+		ldns_sign_request **requests, size_t count);
+
+/**
+ * Waits until all requests that were submitted to a backend are complete.
+ * \param[in] backend the backend
+ * \return LDNS_STATUS_OK, or an error of the backend itself; the status
+ *         of each request is in the request
+ */
+ldns_status ldns_sign_backend_wait(ldns_sign_backend *backend);
+
+/**
+ * Frees a backend, after waiting for the requests that were submitted
+ * \param[in] backend the backend to free
+ */
+void ldns_sign_backend_free(ldns_sign_backend *backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LDNS_SIGN_BACKEND_H */
@@ -0,0 +1,125 @@
+/*
+ * sign_cache.h
+ *
+ * a cache of signatures that is kept between signing runs
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+/**
+ * \file
+ *
+ * Defines ldns_sign_cache, which keeps the signatures that were made for
+ * RRsets, so that a zone that is signed again does not need to sign the
+ * RRsets that did not change.
+ *
+ * A signature is found by the SHA-256 digest of the public key and of the
+ * data that was signed: the RRSIG rdata before the signature, with the
+ * validity window of the key, and the RRset in canonical form. A cached
+ * signature is only used when all of these are the same, so when the
+ * zone is signed with the same inception and expiration times.
+ *
+ * A signing context (see ldns_sign_ctx_set_cache()) looks up signatures in
+ * the cache before it makes them, and stores the ones it makes. The cache
+ * can be written to a file and read back the next time the zone is
+ * signed. When ldns is built with thread support, a cache is locked
+ * internally and may be shared by signing contexts in several threads.
+ */
+
+#ifndef LDNS_SIGN_CACHE_H
+#define LDNS_SIGN_CACHE_H
+
+#include <ldns/common.h>
+#include <ldns/rdata.h>
+#include <ldns/error.h>
+#include <ldns/sha2.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Signatures of RRsets, by the digest of the key and the data signed
+ */
+typedef struct ldns_struct_sign_cache ldns_sign_cache;
+
+/**
+ * Creates an empty cache
+ * \return the cache, or NULL on allocation failure
+ */
+ldns_sign_cache *ldns_sign_cache_new(void);
+
+/**
+ * Creates a cache with the signatures in a file written by
+ * ldns_sign_cache_write(). A file that does not exist gives an empty
+ * cache.
+ * \param[out] cache the cache
+ * \param[in] filename the file to read
+ * \return LDNS_STATUS_OK, LDNS_STATUS_FILE_ERR when the file can not be
+ *         read or is not a signature cache, or LDNS_STATUS_MEM_ERR
+ */
+ldns_status ldns_sign_cache_new_frm_file(ldns_sign_cache **cache,
+		const char *filename);
+
+/**
+ * Looks up a signature in a cache, and marks it as used
+ * \param[in] cache the cache
+ * \param[in] digest the digest of the key and the data to sign
+ * \return a new rdf with the signature, or NULL when it is not in the
+ *         cache or on allocation failure
+ */
+ldns_rdf *ldns_sign_cache_lookup(ldns_sign_cache *cache,
+		const uint8_t digest[LDNS_SHA256_DIGEST_LENGTH]);
+
+/**
+ * Stores a signature in a cache, as used
+ * \param[in] cache the cache
+ * \param[in] digest the digest of the key and the data that was signed
+ * \param[in] sig the signature, which is copied
+ * \return LDNS_STATUS_OK, or LDNS_STATUS_MEM_ERR
+ */
+ldns_status ldns_sign_cache_store(ldns_sign_cache *cache,
+		const uint8_t digest[LDNS_SHA256_DIGEST_LENGTH],
+		const ldns_rdf *sig);
+
+/**
+ * Writes the signatures of a cache that were used or stored since it was
+ * read to a file, so that the signatures of RRsets that are not signed
+ * anymore are left out. The file is written under a temporary name, and
+ * renamed to filename when it is complete.
+ * \param[in] cache the cache
+ * \param[in] filename the file to write
+ * \return LDNS_STATUS_OK, or LDNS_STATUS_FILE_ERR
+ */
+ldns_status ldns_sign_cache_write(ldns_sign_cache *cache,
+		const char *filename);
+
+/**
+ * Returns the number of signatures in a cache
+ * \param[in] cache the cache
+ * \return the number of signatures
+ */
+size_t ldns_sign_cache_count(ldns_sign_cache *cache);
+
+/**
+ * Returns the number of signatures that were found in a cache
+ * \param[in] cache the cache
+ * \return the number of lookups that found a signature
+ */
+size_t ldns_sign_cache_hits(ldns_sign_cache *cache);
+
+/**
+ * Frees a cache and its signatures
+ * \param[in] cache the cache to free
+ */
+void ldns_sign_cache_free(ldns_sign_cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LDNS_SIGN_CACHE_H */
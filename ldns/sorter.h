@@ -0,0 +1,93 @@
+/*
+ * sorter.h
+ *
+ * sorting RRs in canonical order in bounded memory
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+/**
+ * \file
+ *
+ * Defines ldns_rr_sorter, which sorts any number of RRs in canonical order
+ * (RFC 4034 section 6), in the same order as ldns_rr_list_sort(), with a
+ * bound on the memory it uses.
+ *
+ * RRs are added to the sorter in memory. When they take more memory than
+ * the bound, they are sorted and written to a temporary file, a run. When
+ * all RRs are added, they are taken from the sorter one by one, in order,
+ * by merging the runs and the RRs still in memory. So zones larger than
+ * the memory of the machine can be sorted, compared and printed in order,
+ * together with ldns_zone_reader.
+ */
+
+#ifndef LDNS_SORTER_H
+#define LDNS_SORTER_H
+
+#include <ldns/common.h>
+#include <ldns/rr.h>
+#include <ldns/error.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sorts RRs in canonical order, in memory and temporary files
+ */
+typedef struct ldns_struct_rr_sorter ldns_rr_sorter;
+
+/**
+ * Creates a sorter
+ * \param[in] max_memory about the number of bytes that the RRs in memory
+ *            may take before they are written to a temporary file, or 0
+ *            to sort all RRs in memory
+ * \param[in] tmpdir the directory for the temporary files, or NULL for
+ *            the default of the system
+ * \return the sorter, or NULL on allocation failure
+ */
+ldns_rr_sorter *ldns_rr_sorter_new(size_t max_memory, const char *tmpdir);
+
+/**
+ * Adds an RR to a sorter, which then owns it. RRs can not be added
+ * anymore once they are taken out with ldns_rr_sorter_next().
+ * \param[in] sorter the sorter
+ * \param[in] rr the RR to add
+ * \return LDNS_STATUS_OK, or an error, in which case the RR is still the
+ *         caller's
+ */
+ldns_status ldns_rr_sorter_add(ldns_rr_sorter *sorter, ldns_rr *rr);
+
+/**
+ * Takes the next RR, in canonical order, out of a sorter. RRs that are
+ * equal in canonical order come out in the order in which they were
+ * added.
+ * \param[in] sorter the sorter
+ * \param[out] rr the next RR, which the caller must free, or NULL when
+ *             all RRs are taken
+ * \return LDNS_STATUS_OK, or an error reading the temporary files
+ */
+ldns_status ldns_rr_sorter_next(ldns_rr_sorter *sorter, ldns_rr **rr);
+
+/**
+ * Returns the number of temporary files that the sorter has written
+ * \param[in] sorter the sorter
+ * \return the number of runs, 0 when all RRs were sorted in memory
+ */
+size_t ldns_rr_sorter_run_count(const ldns_rr_sorter *sorter);
+
+/**
+ * Frees a sorter, the RRs still in it and its temporary files
+ * \param[in] sorter the sorter to free
+ */
+void ldns_rr_sorter_free(ldns_rr_sorter *sorter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LDNS_SORTER_H */
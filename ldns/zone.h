@@ -115,10 +115,13 @@ bool ldns_zone_push_rr(ldns_zone *z, ldns_rr *rr);
  * records. The resulting list does are pointer references
  * to the zone's data.
  *
- * Due to the current zone implementation (as a list of rr's), this
- * function is extremely slow. Another (probably better) way to do this
- * is to use an ldns_dnssec_zone structure and the 
- * ldns_dnssec_mark_and_get_glue() function.
+ * A and AAAA records at or below a name with NS records (other than
+ * the SOA owner) are glue. The zone cuts are sorted, so that every
+ * address record is found in time logarithmic to the number of cuts.
+ * Each glue record is in the list once, in zone order.
+ * Another way to do this, that also knows about nested zones, is to
+ * use an ldns_dnssec_zone structure and the
+ * ldns_dnssec_zone_mark_and_get_glue() function.
  *
  * \param[in] z the zone to look for glue
  * \return the rr_list with the glue
@@ -150,6 +153,56 @@ ldns_status ldns_zone_new_frm_fp(ldns_zone **z, FILE *fp, const ldns_rdf *origin
  */
 ldns_status ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, const ldns_rdf *origin, uint32_t ttl, ldns_rr_class c, int *line_nr);
 
+/**
+ * Reads the RRs of a zone file one by one, without keeping them. The RRs
+ * are read as by ldns_zone_new_frm_fp_l(), with the same rules for their
+ * TTLs and $ORIGIN and $TTL directives. Only one RR is in memory at a
+ * time, so zones of any size can be streamed through.
+ */
+typedef struct ldns_struct_zone_reader ldns_zone_reader;
+
+/**
+ * Creates a reader for the RRs in a zone file
+ * \param[in] fp the file to read from
+ * \param[in] origin the zones' origin, or NULL to use the owner of the
+ *            SOA
+ * \param[in] ttl default ttl to use
+ * \param[in] c default class to use (IN)
+ * \return the reader, or NULL on allocation failure
+ */
+ldns_zone_reader *ldns_zone_reader_new(FILE *fp, const ldns_rdf *origin,
+		uint32_t ttl, ldns_rr_class c);
+
+/**
+ * Reads the next RR from a zone file. Unlike ldns_zone_new_frm_fp_l(),
+ * the reader returns every SOA RR it reads.
+ * \param[in] reader the reader
+ * \param[out] rr the RR read, which the caller must free, or NULL at the
+ *             end of the file
+ * \param[out] line_nr when not NULL, the line number is counted in it
+ * \return LDNS_STATUS_OK, also at the end of the file, or an error
+ */
+ldns_status ldns_zone_reader_next(ldns_zone_reader *reader, ldns_rr **rr,
+		int *line_nr);
+
+/**
+ * Sets whether RRs that follow each other with the same owner share the
+ * owner name (see ldns_rdf_ref()), which saves memory when the RRs are
+ * kept. The default is not to. A shared owner must not be changed in
+ * place, with ldns_dname2canonical() for example; ldns_rr2canonical() and
+ * ldns_rr_set_owner() with a new owner are fine.
+ * \param[in] reader the reader
+ * \param[in] intern whether to share the owners
+ */
+void ldns_zone_reader_set_intern_owners(ldns_zone_reader *reader,
+		bool intern);
+
+/**
+ * Frees a zone reader. The file is not closed.
+ * \param[in] reader the reader to free
+ */
+void ldns_zone_reader_free(ldns_zone_reader *reader);
+
 /**
  * Frees the allocated memory for the zone, and the rr_list structure in it
  * \param[in] zone the zone to free
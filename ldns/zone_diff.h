@@ -0,0 +1,135 @@
+/*
+ * zone_diff.h
+ *
+ * the differences between two versions of a zone
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+/**
+ * \file
+ *
+ * Defines ldns_zone_diff, the change set that turns one version of a zone
+ * into another: the RRs that are deleted and the RRs that are added, and
+ * the SOA RRs of both versions.
+ *
+ * The RRs of both versions are compared in canonical order (RFC 4034
+ * section 6). For large zones the names are divided in ranges that are
+ * compared by several threads, as many as ldns_rr_list_sort_threads().
+ * The change set can be written as an incremental zone transfer
+ * (RFC 1995) with ldns_zone_diff2ixfr() and ldns_zone_diff_print_ixfr().
+ */
+
+#ifndef LDNS_ZONE_DIFF_H
+#define LDNS_ZONE_DIFF_H
+
+#include <ldns/common.h>
+#include <ldns/rr.h>
+#include <ldns/zone.h>
+#include <ldns/dnssec_zone.h>
+#include <ldns/host2str.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The differences between two versions of a zone
+ */
+typedef struct ldns_struct_zone_diff ldns_zone_diff;
+struct ldns_struct_zone_diff
+{
+	/** the SOA RR of the old version, or NULL when it had none */
+	ldns_rr *old_soa;
+	/** the SOA RR of the new version, or NULL when it had none */
+	ldns_rr *new_soa;
+	/**
+	 * the RRs of the old version that are not in the new one, in
+	 * canonical order, without SOA RRs
+	 */
+	ldns_rr_list *deleted;
+	/**
+	 * the RRs of the new version that are not in the old one, in
+	 * canonical order, without SOA RRs
+	 */
+	ldns_rr_list *added;
+};
+
+/**
+ * Compares two versions of a zone. RRs that are equal but for their TTL
+ * are both deleted and added, so that the TTL changes. A zone may have
+ * the same RR more than once; the change set then has the difference in
+ * numbers of them.
+ *
+ * The change set shares its RRs with the zones (see ldns_rr_ref()), so
+ * it stays valid after the zones are freed.
+ *
+ * \param[out] diff the change set
+ * \param[in] old_zone the old version of the zone
+ * \param[in] new_zone the new version of the zone
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_zone_diff_new_frm_zones(ldns_zone_diff **diff,
+		const ldns_zone *old_zone, const ldns_zone *new_zone);
+
+/**
+ * Compares two versions of a zone, like ldns_zone_diff_new_frm_zones(),
+ * with the RRs of ldns_dnssec_zones, including the NSEC(3) RRs and the
+ * signatures.
+ *
+ * \param[out] diff the change set
+ * \param[in] old_zone the old version of the zone
+ * \param[in] new_zone the new version of the zone
+ * \return LDNS_STATUS_OK on success, an error code otherwise
+ */
+ldns_status ldns_zone_diff_new_frm_dnssec_zones(ldns_zone_diff **diff,
+		const ldns_dnssec_zone *old_zone,
+		const ldns_dnssec_zone *new_zone);
+
+/**
+ * Returns whether the versions of the zone differ in other RRs than
+ * their SOA RRs
+ * \param[in] diff the change set
+ * \return true when RRs are deleted or added
+ */
+bool ldns_zone_diff_has_changes(const ldns_zone_diff *diff);
+
+/**
+ * Returns the change set in the form of the answer of an incremental
+ * zone transfer (RFC 1995 section 4): the new SOA, the old SOA, the
+ * deleted RRs, the new SOA, the added RRs and the new SOA again. When
+ * nothing changed, not even the SOA, it is the SOA alone, as for a client
+ * that is up to date.
+ * \param[in] diff the change set
+ * \return the RRs, which share the RRs of the change set, or NULL when
+ *         one of the versions had no SOA RR or on allocation failure
+ */
+ldns_rr_list *ldns_zone_diff2ixfr(const ldns_zone_diff *diff);
+
+/**
+ * Prints the change set as an incremental zone transfer, in the order
+ * of ldns_zone_diff2ixfr(), one RR per line.
+ * \param[in] out the file to print to
+ * \param[in] fmt the format of the RRs
+ * \param[in] diff the change set
+ * \return LDNS_STATUS_OK, or LDNS_STATUS_ERR when one of the versions had
+ *         no SOA RR
+ */
+ldns_status ldns_zone_diff_print_ixfr(FILE *out,
+		const ldns_output_format *fmt, const ldns_zone_diff *diff);
+
+/**
+ * Frees a change set and drops its references to the RRs
+ * \param[in] diff the change set to free
+ */
+void ldns_zone_diff_free(ldns_zone_diff *diff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LDNS_ZONE_DIFF_H */
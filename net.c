@@ -41,7 +41,7 @@ ldns_send(ldns_pkt **result_packet, ldns_resolver *r, const ldns_pkt *query_pkt)
 	ldns_status result;
 	ldns_rdf *tsig_mac = NULL;
 
-	qb = ldns_buffer_new(LDNS_MIN_BUFLEN);
+	qb = ldns_buffer_new_pooled(LDNS_MIN_BUFLEN);
 
 	if (query_pkt && ldns_pkt_tsig(query_pkt)) {
 		tsig_mac = ldns_rr_rdf(ldns_pkt_tsig(query_pkt), 3);
@@ -54,7 +54,7 @@ ldns_send(ldns_pkt **result_packet, ldns_resolver *r, const ldns_pkt *query_pkt)
         	result = ldns_send_buffer(result_packet, r, qb, tsig_mac);
 	}
 
-	ldns_buffer_free(qb);
+	ldns_buffer_recycle(qb);
 
 	return result;
 }
@@ -488,6 +488,431 @@ ldns_udp_send(uint8_t **result, ldns_buffer *qbin,
 			timeout, answer_size);
 }
 
+/* A query that has been sent to one nameserver and awaits its answer */
+struct ldns_fanout_query {
+	int sockfd;
+	size_t q;	/* index of the query */
+	size_t ns;	/* index in the resolver's nameserver list */
+	struct timeval sent;
+};
+
+/* Close the sockets of all queries for q, the answer for q is in */
+static void
+ldns_fanout_close(struct ldns_fanout_query *fq, size_t fq_count, size_t q)
+{
+	size_t i;
+
+	for (i = 0; i < fq_count; i++) {
+		if (fq[i].q == q && fq[i].sockfd != -1) {
+			close_socket(fq[i].sockfd);
+			fq[i].sockfd = -1;
+		}
+	}
+}
+
+/* Read the answer waiting on fq->sockfd and store it in results when it
+ * is an answer to the query, the other sockets for the query are closed
+ */
+static ldns_status
+ldns_fanout_read(ldns_pkt **results, ldns_resolver *r, ldns_buffer **qbs,
+		ldns_rdf **tsig_macs, struct ldns_fanout_query *fq,
+		size_t fq_count, size_t i)
+{
+	uint8_t *reply_bytes;
+	size_t reply_size = 0;
+	ldns_pkt *reply = NULL;
+	struct timeval tv_e;
+	size_t q = fq[i].q;
+	uint32_t querytime;
+	ldns_status status = LDNS_STATUS_OK;
+
+	reply_bytes = ldns_udp_read_wire(fq[i].sockfd, &reply_size, NULL, NULL);
+	if (!reply_bytes) {
+		close_socket(fq[i].sockfd);
+		fq[i].sockfd = -1;
+		return LDNS_STATUS_NETWORK_ERR;
+	}
+	/* ignore stray packets that do not answer this query */
+	if (reply_size < LDNS_HEADER_SIZE || results[q] ||
+	    ldns_read_uint16(reply_bytes) !=
+	    ldns_read_uint16(ldns_buffer_begin(qbs[q])) ||
+	    ldns_wire2pkt(&reply, reply_bytes, reply_size) != LDNS_STATUS_OK) {
+		LDNS_FREE(reply_bytes);
+		return LDNS_STATUS_OK;
+	}
+	gettimeofday(&tv_e, NULL);
+	querytime = (uint32_t)
+		((tv_e.tv_sec - fq[i].sent.tv_sec) * 1000) +
+		(tv_e.tv_usec - fq[i].sent.tv_usec) / 1000;
+	ldns_pkt_set_querytime(reply, querytime);
+	ldns_pkt_set_answerfrom(reply,
+			ldns_rdf_clone(ldns_resolver_nameservers(r)[fq[i].ns]));
+	ldns_pkt_set_timestamp(reply, fq[i].sent);
+	ldns_pkt_set_size(reply, reply_size);
+
+	/* remember the speed of the nameserver, to prefer it next time */
+	ldns_resolver_set_nameserver_rtt(r, fq[i].ns,
+			querytime > LDNS_RESOLV_RTT_MIN
+			? querytime : LDNS_RESOLV_RTT_MIN);
+#ifdef HAVE_SSL
+	if (tsig_macs && tsig_macs[q] &&
+	    !ldns_pkt_tsig_verify(reply, reply_bytes, reply_size,
+		    ldns_resolver_tsig_keyname(r),
+		    ldns_resolver_tsig_keydata(r), tsig_macs[q])) {
+		status = LDNS_STATUS_CRYPTO_TSIG_BOGUS;
+	}
+#else
+	(void)tsig_macs;
+#endif /* HAVE_SSL */
+	LDNS_FREE(reply_bytes);
+	results[q] = reply;
+	ldns_fanout_close(fq, fq_count, q);
+	return status;
+}
+
+/* Wait for answers to the outstanding queries until all queries are
+ * answered or the resolver's timeout expires
+ */
+static ldns_status
+ldns_fanout_wait(ldns_pkt **results, ldns_resolver *r, ldns_buffer **qbs,
+		ldns_rdf **tsig_macs, struct ldns_fanout_query *fq,
+		size_t fq_count, size_t *unanswered)
+{
+	struct timeval now, end, timeout = ldns_resolver_timeout(r);
+	size_t i, n;
+	int ret;
+	ldns_status status = LDNS_STATUS_OK, s;
+#ifdef HAVE_POLL
+	struct pollfd *pfds;
+	size_t *pfd_fq;
+
+	if (fq_count == 0) {
+		/* nothing was sent, so there is nothing to wait for */
+		return LDNS_STATUS_OK;
+	}
+	pfds = LDNS_XMALLOC(struct pollfd, fq_count);
+	pfd_fq = LDNS_XMALLOC(size_t, fq_count);
+	if (!pfds || !pfd_fq) {
+		LDNS_FREE(pfds);
+		LDNS_FREE(pfd_fq);
+		return LDNS_STATUS_MEM_ERR;
+	}
+#else
+	fd_set fds;
+	int maxfd;
+	struct timeval tv;
+#endif
+	gettimeofday(&end, NULL);
+	end.tv_sec += timeout.tv_sec;
+	end.tv_usec += timeout.tv_usec;
+	if (end.tv_usec >= 1000000) {
+		end.tv_sec += 1;
+		end.tv_usec -= 1000000;
+	}
+	while (*unanswered > 0) {
+		gettimeofday(&now, NULL);
+		if (now.tv_sec > end.tv_sec ||
+		    (now.tv_sec == end.tv_sec && now.tv_usec >= end.tv_usec)) {
+			break;
+		}
+#ifdef HAVE_POLL
+		for (i = 0, n = 0; i < fq_count; i++) {
+			if (fq[i].sockfd == -1) {
+				continue;
+			}
+			memset(&pfds[n], 0, sizeof(pfds[n]));
+			pfds[n].fd = fq[i].sockfd;
+			pfds[n].events = POLLIN|POLLERR;
+			pfd_fq[n++] = i;
+		}
+		if (n == 0) {
+			break;
+		}
+		ret = poll(pfds, (nfds_t)n, (int)(
+			(end.tv_sec - now.tv_sec) * 1000 +
+			(end.tv_usec - now.tv_usec) / 1000));
+#else
+		FD_ZERO(&fds);
+		maxfd = -1;
+		for (i = 0, n = 0; i < fq_count; i++) {
+			if (fq[i].sockfd == -1) {
+				continue;
+			}
+			FD_SET(FD_SET_T fq[i].sockfd, &fds);
+			if (fq[i].sockfd > maxfd) {
+				maxfd = fq[i].sockfd;
+			}
+			n++;
+		}
+		if (n == 0) {
+			break;
+		}
+		tv.tv_sec = end.tv_sec - now.tv_sec;
+		tv.tv_usec = end.tv_usec - now.tv_usec;
+		if (tv.tv_usec < 0) {
+			tv.tv_sec -= 1;
+			tv.tv_usec += 1000000;
+		}
+		ret = select(maxfd + 1, &fds, NULL, NULL, &tv);
+#endif
+		if (ret == -1 && errno == EINTR) {
+			continue;
+		} else if (ret <= 0) {
+			/* timeout expired, or error */
+			break;
+		}
+#ifdef HAVE_POLL
+		for (i = 0; i < n; i++) {
+			if (!pfds[i].revents || fq[pfd_fq[i]].sockfd == -1) {
+				continue;
+			}
+			if (results[fq[pfd_fq[i]].q]) {
+				continue;
+			}
+			s = ldns_fanout_read(results, r, qbs, tsig_macs,
+					fq, fq_count, pfd_fq[i]);
+			if (results[fq[pfd_fq[i]].q]) {
+				*unanswered -= 1;
+			}
+			if (s != LDNS_STATUS_OK &&
+			    s != LDNS_STATUS_NETWORK_ERR) {
+				status = s;
+			}
+		}
+#else
+		for (i = 0; i < fq_count; i++) {
+			if (fq[i].sockfd == -1 ||
+			    !FD_ISSET(fq[i].sockfd, &fds) || results[fq[i].q]) {
+				continue;
+			}
+			s = ldns_fanout_read(results, r, qbs, tsig_macs,
+					fq, fq_count, i);
+			if (results[fq[i].q]) {
+				*unanswered -= 1;
+			}
+			if (s != LDNS_STATUS_OK &&
+			    s != LDNS_STATUS_NETWORK_ERR) {
+				status = s;
+			}
+		}
+#endif
+	}
+#ifdef HAVE_POLL
+	LDNS_FREE(pfds);
+	LDNS_FREE(pfd_fq);
+#endif
+	return status;
+}
+
+/* Send the queries in qbs over UDP to ldns_resolver_fanout(r) nameservers
+ * each, all at the same time, and collect the first answer for every query.
+ */
+static ldns_status
+ldns_send_buffers_fanout(ldns_pkt **results, ldns_resolver *r,
+		ldns_buffer **qbs, ldns_rdf **tsig_macs, size_t count)
+{
+	struct sockaddr_storage *src = NULL;
+	size_t src_len = 0;
+	struct sockaddr_storage **ns = NULL;
+	size_t *ns_len = NULL;
+	size_t *ns_idx = NULL;
+	size_t ns_count = 0;
+	struct ldns_fanout_query *fq = NULL;
+	size_t fq_count;
+	size_t *rtt;
+	size_t width, offset, unanswered, i, j, k, tmp;
+	uint8_t retries;
+	struct sockaddr_storage *tmp_ns;
+	ldns_status status = LDNS_STATUS_OK, s;
+
+	assert(r != NULL);
+
+	for (i = 0; i < count; i++) {
+		results[i] = NULL;
+	}
+	if (count == 0) {
+		return LDNS_STATUS_OK;
+	}
+	if (ldns_resolver_random(r)) {
+		ldns_resolver_nameservers_randomize(r);
+	}
+	rtt = ldns_resolver_rtt(r);
+
+	ns = LDNS_XMALLOC(struct sockaddr_storage *,
+			ldns_resolver_nameserver_count(r));
+	ns_len = LDNS_XMALLOC(size_t, ldns_resolver_nameserver_count(r));
+	ns_idx = LDNS_XMALLOC(size_t, ldns_resolver_nameserver_count(r));
+	if (!ns || !ns_len || !ns_idx) {
+		status = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+	for (i = 0; i < ldns_resolver_nameserver_count(r); i++) {
+		if (rtt[i] == LDNS_RESOLV_RTT_INF) {
+			/* not reachable nameserver! */
+			continue;
+		}
+		ns[ns_count] = ldns_rdf2native_sockaddr_storage(
+				ldns_resolver_nameservers(r)[i],
+				ldns_resolver_port(r), &ns_len[ns_count]);
+		if (!ns[ns_count]) {
+			continue;
+		}
+#ifndef S_SPLINT_S
+		if ((ns[ns_count]->ss_family == AF_INET &&
+		     ldns_resolver_ip6(r) == LDNS_RESOLV_INET6) ||
+		    (ns[ns_count]->ss_family == AF_INET6 &&
+		     ldns_resolver_ip6(r) == LDNS_RESOLV_INET)) {
+			/* not reachable */
+			LDNS_FREE(ns[ns_count]);
+			continue;
+		}
+#endif
+		ns_idx[ns_count++] = i;
+	}
+	if (ns_count == 0) {
+		status = LDNS_STATUS_RES_NO_NS;
+		goto done;
+	}
+	/* prefer the nameservers that answered fastest before
+	 * (insertion sort, so randomized order among equals remains) */
+	for (i = 1; i < ns_count; i++) {
+		for (j = i; j > 0 && rtt[ns_idx[j - 1]] > rtt[ns_idx[j]]; j--) {
+			tmp_ns = ns[j]; ns[j] = ns[j - 1]; ns[j - 1] = tmp_ns;
+			tmp = ns_len[j]; ns_len[j] = ns_len[j - 1];
+			ns_len[j - 1] = tmp;
+			tmp = ns_idx[j]; ns_idx[j] = ns_idx[j - 1];
+			ns_idx[j - 1] = tmp;
+		}
+	}
+	width = ldns_resolver_fanout(r);
+	if (width < 1) {
+		width = 1;
+	}
+	if (width > ns_count) {
+		width = ns_count;
+	}
+	fq = LDNS_XMALLOC(struct ldns_fanout_query, count * width);
+	if (!fq) {
+		status = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+	if (ldns_resolver_source(r)) {
+		src = ldns_rdf2native_sockaddr_storage_port(
+				ldns_resolver_source(r), 0, &src_len);
+	}
+
+	unanswered = count;
+	offset = 0;
+	for (retries = ldns_resolver_retry(r); retries > 0 && unanswered > 0;
+			retries--) {
+		fq_count = 0;
+		for (i = 0; i < count; i++) {
+			if (results[i]) {
+				continue;
+			}
+			for (j = 0; j < width; j++) {
+				k = (offset + j) % ns_count;
+				fq[fq_count].sockfd = ldns_udp_bgsend_from(
+					qbs[i], ns[k], (socklen_t)ns_len[k],
+					src, (socklen_t)src_len,
+					ldns_resolver_timeout(r));
+				if (fq[fq_count].sockfd == -1) {
+					status = LDNS_STATUS_SOCKET_ERROR;
+					continue;
+				}
+				ldns_sock_nonblock(fq[fq_count].sockfd);
+				fq[fq_count].q = i;
+				fq[fq_count].ns = ns_idx[k];
+				gettimeofday(&fq[fq_count].sent, NULL);
+				fq_count++;
+			}
+		}
+		if (fq_count > 0) {
+			s = ldns_fanout_wait(results, r, qbs, tsig_macs,
+					fq, fq_count, &unanswered);
+			if (s != LDNS_STATUS_OK) {
+				status = s;
+			}
+		}
+		for (i = 0; i < fq_count; i++) {
+			if (fq[i].sockfd != -1) {
+				close_socket(fq[i].sockfd);
+			}
+		}
+		/* obey the fail directive, like ldns_send_buffer() does:
+		 * do not try other nameservers when the first fail */
+		if (unanswered > 0 && ldns_resolver_fail(r)) {
+			status = LDNS_STATUS_ERR;
+			break;
+		}
+		/* try the next nameservers for what remains unanswered */
+		offset = (offset + width) % ns_count;
+	}
+	if (unanswered == 0 && status == LDNS_STATUS_SOCKET_ERROR) {
+		status = LDNS_STATUS_OK;
+	} else if (unanswered > 0 && status == LDNS_STATUS_OK) {
+		status = LDNS_STATUS_NETWORK_ERR;
+	}
+done:
+	if (ns) {
+		for (i = 0; i < ns_count; i++) {
+			LDNS_FREE(ns[i]);
+		}
+	}
+	LDNS_FREE(ns);
+	LDNS_FREE(ns_len);
+	LDNS_FREE(ns_idx);
+	LDNS_FREE(fq);
+	LDNS_FREE(src);
+	return status;
+}
+
+ldns_status
+ldns_send_multi(ldns_pkt **result_packets, ldns_resolver *r,
+		ldns_pkt * const *query_pkts, size_t count)
+{
+	ldns_buffer **qbs;
+	ldns_rdf **tsig_macs;
+	ldns_status result = LDNS_STATUS_OK;
+	size_t i;
+
+	qbs = LDNS_XMALLOC(ldns_buffer *, count);
+	tsig_macs = LDNS_XMALLOC(ldns_rdf *, count);
+	if (!qbs || !tsig_macs) {
+		LDNS_FREE(qbs);
+		LDNS_FREE(tsig_macs);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i < count; i++) {
+		tsig_macs[i] = NULL;
+		qbs[i] = ldns_buffer_new_pooled(LDNS_MIN_BUFLEN);
+		if (!qbs[i]) {
+			result = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+		if (!query_pkts[i] || ldns_pkt2buffer_wire(qbs[i],
+					query_pkts[i]) != LDNS_STATUS_OK) {
+			ldns_buffer_recycle(qbs[i]);
+			result = LDNS_STATUS_ERR;
+			break;
+		}
+		if (ldns_pkt_tsig(query_pkts[i])) {
+			tsig_macs[i] = ldns_rr_rdf(
+					ldns_pkt_tsig(query_pkts[i]), 3);
+		}
+	}
+	if (result == LDNS_STATUS_OK) {
+		result = ldns_send_buffers_fanout(result_packets, r,
+				qbs, tsig_macs, count);
+	}
+	while (i-- > 0) {
+		ldns_buffer_recycle(qbs[i]);
+	}
+	LDNS_FREE(qbs);
+	LDNS_FREE(tsig_macs);
+	return result;
+}
+
 ldns_status
 ldns_send_buffer(ldns_pkt **result, ldns_resolver *r, ldns_buffer *qb, ldns_rdf *tsig_mac)
 {
@@ -512,6 +937,16 @@ ldns_send_buffer(ldns_pkt **result, ldns_resolver *r, ldns_buffer *qb, ldns_rdf
 
 	assert(r != NULL);
 
+	if (!ldns_resolver_usevc(r) && ldns_resolver_fanout(r) > 1) {
+		status = ldns_send_buffers_fanout(&reply, r, &qb, &tsig_mac, 1);
+		if (result) {
+			*result = reply;
+		} else {
+			ldns_pkt_recycle(reply);
+		}
+		return status;
+	}
+
 	status = LDNS_STATUS_OK;
 	rtt = ldns_resolver_rtt(r);
 	ns_array = ldns_resolver_nameservers(r);
@@ -958,7 +1393,7 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
 	}
 
 	if (resolver->_socket == SOCK_INVALID) {
-		ldns_pkt_free(query);
+		ldns_pkt_recycle(query);
 		LDNS_FREE(ns);
 		return LDNS_STATUS_NETWORK_ERR;
 	}
@@ -975,7 +1410,7 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
 			close_socket(resolver->_socket);
 			resolver->_socket = 0;
 
-			ldns_pkt_free(query);
+			ldns_pkt_recycle(query);
 			LDNS_FREE(ns);
 
 			return LDNS_STATUS_CRYPTO_TSIG_ERR;
@@ -986,9 +1421,9 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
         /* Convert the query to a buffer
          * Is this necessary?
          */
-        query_wire = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+        query_wire = ldns_buffer_new_pooled(LDNS_MAX_PACKETLEN);
         if(!query_wire) {
-                ldns_pkt_free(query);
+                ldns_pkt_recycle(query);
                 LDNS_FREE(ns);
 
 		close_socket(resolver->_socket);
@@ -997,8 +1432,8 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
         }
         status = ldns_pkt2buffer_wire(query_wire, query);
         if (status != LDNS_STATUS_OK) {
-                ldns_pkt_free(query);
-		ldns_buffer_free(query_wire);
+                ldns_pkt_recycle(query);
+		ldns_buffer_recycle(query_wire);
                 LDNS_FREE(ns);
 
 		/* to prevent problems on subsequent calls to ldns_axfr_start
@@ -1011,8 +1446,8 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
         /* Send the query */
         if (ldns_tcp_send_query(query_wire, resolver->_socket, ns,
 				(socklen_t)ns_len) == 0) {
-                ldns_pkt_free(query);
-                ldns_buffer_free(query_wire);
+                ldns_pkt_recycle(query);
+                ldns_buffer_recycle(query_wire);
                 LDNS_FREE(ns);
 
 		/* to prevent problems on subsequent calls to ldns_axfr_start
@@ -1024,8 +1459,8 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
                 return LDNS_STATUS_NETWORK_ERR;
         }
 
-        ldns_pkt_free(query);
-        ldns_buffer_free(query_wire);
+        ldns_pkt_recycle(query);
+        ldns_buffer_recycle(query_wire);
         LDNS_FREE(ns);
 
         /*
@@ -1034,3 +1469,628 @@ ldns_axfr_start(ldns_resolver *resolver, const ldns_rdf *domain, ldns_rr_class c
         resolver->_axfr_soa_count = 0;
         return LDNS_STATUS_OK;
 }
+
+/* The stream is read in chunks as large as a few maximum sized messages,
+ * so that a read call returns many messages at once.
+ */
+#define LDNS_XFR_BUFSIZE (4 * (LDNS_MAX_PACKETLEN + 2))
+
+/* Where a zone transfer is */
+struct ldns_xfr_state {
+	ldns_rr_type type;
+	uint16_t id;
+	/* serial of the first SOA, the version being transferred */
+	uint32_t serial;
+	/* serial sent in an IXFR query, the version we have */
+	uint32_t ixfr_serial;
+	/* number of RRs received */
+	size_t rr_count;
+	/* number of SOAs received with that serial */
+	size_t soa_count;
+	/* IXFR answered with differences, rather than the whole zone */
+	bool incremental;
+	bool done;
+};
+
+/* The connection a zone transfer is read from */
+struct ldns_xfr_conn {
+	int sockfd;
+	struct timeval timeout;
+	uint8_t *buf;
+	/* the unused part of buf */
+	size_t start, end;
+};
+
+static ldns_status
+ldns_xfr_count_rr(struct ldns_xfr_state *x, bool soa, uint32_t serial)
+{
+	if (!soa) {
+		if (x->rr_count++ == 0) {
+			return LDNS_STATUS_XFR_ERR;
+		}
+		return LDNS_STATUS_OK;
+	}
+	if (x->rr_count++ == 0) {
+		x->serial = serial;
+		x->soa_count = 1;
+		/* A single SOA, not newer than ours: the zone is up to
+		 * date (RFC 1995, section 2).
+		 */
+		x->done = x->type == LDNS_RR_TYPE_IXFR &&
+			(int32_t)(serial - x->ixfr_serial) <= 0;
+		return LDNS_STATUS_OK;
+	}
+	if (x->rr_count == 2 && x->type == LDNS_RR_TYPE_IXFR &&
+	    serial != x->serial) {
+		/* the SOA of the version the differences start from */
+		x->incremental = true;
+	}
+	if (serial == x->serial) {
+		/* An AXFR ends with the SOA it started with. Differences
+		 * have it once more, where the additions for the last
+		 * version start.
+		 */
+		x->soa_count++;
+		x->done = x->soa_count == (x->incremental ? 3 : 2);
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* Skips the (possibly compressed) domain name at *pos */
+static bool
+ldns_xfr_skip_dname(const uint8_t *wire, size_t size, size_t *pos)
+{
+	uint8_t len;
+
+	while (*pos < size) {
+		len = wire[*pos];
+		if ((len & 0xc0) == 0xc0) {
+			*pos += 2;
+			return *pos <= size;
+		}
+		if ((len & 0xc0) != 0) {
+			return false;
+		}
+		*pos += 1 + (size_t) len;
+		if (len == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Returns the position of the answer section of a message */
+static ldns_status
+ldns_xfr_skip_question(const uint8_t *wire, size_t size, size_t *pos)
+{
+	size_t i;
+
+	*pos = LDNS_HEADER_SIZE;
+	for (i = 0; i < LDNS_QDCOUNT(wire); i++) {
+		if (!ldns_xfr_skip_dname(wire, size, pos) ||
+		    (*pos += 4) > size) {
+			return LDNS_STATUS_WIRE_INCOMPLETE_QUESTION;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* Checks a message and follows the SOAs in its answer section, without
+ * parsing the RRs. *count is set to the number of RRs in the message
+ * that belong to the transfer.
+ */
+static ldns_status
+ldns_xfr_scan_msg(struct ldns_xfr_state *x,
+		const uint8_t *wire, size_t size, size_t *count)
+{
+	ldns_status status;
+	size_t pos, rdpos, i;
+	uint16_t type, rdlen;
+	uint32_t serial = 0;
+
+	*count = 0;
+	if (size < LDNS_HEADER_SIZE) {
+		return LDNS_STATUS_WIRE_INCOMPLETE_HEADER;
+	}
+	if (LDNS_ID_WIRE(wire) != x->id ||
+	    LDNS_RCODE_WIRE(wire) != LDNS_RCODE_NOERROR) {
+		return LDNS_STATUS_XFR_ERR;
+	}
+	status = ldns_xfr_skip_question(wire, size, &pos);
+	if (status != LDNS_STATUS_OK) {
+		return status;
+	}
+	for (i = 0; i < LDNS_ANCOUNT(wire) && !x->done; i++) {
+		if (!ldns_xfr_skip_dname(wire, size, &pos) ||
+		    pos + 10 > size) {
+			return LDNS_STATUS_WIRE_INCOMPLETE_ANSWER;
+		}
+		type = ldns_read_uint16(wire + pos);
+		rdlen = ldns_read_uint16(wire + pos + 8);
+		pos += 10;
+		if (pos + rdlen > size) {
+			return LDNS_STATUS_WIRE_INCOMPLETE_ANSWER;
+		}
+		if (type == LDNS_RR_TYPE_SOA) {
+			rdpos = pos;
+			if (!ldns_xfr_skip_dname(wire, pos + rdlen, &rdpos) ||
+			    !ldns_xfr_skip_dname(wire, pos + rdlen, &rdpos) ||
+			    rdpos + 4 > pos + rdlen) {
+				return LDNS_STATUS_XFR_ERR;
+			}
+			serial = ldns_read_uint32(wire + rdpos);
+		}
+		status = ldns_xfr_count_rr(x, type == LDNS_RR_TYPE_SOA,
+				serial);
+		if (status != LDNS_STATUS_OK) {
+			return status;
+		}
+		pos += rdlen;
+		*count += 1;
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* Parses the first count RRs of the answer section of a message */
+static ldns_status
+ldns_xfr_parse_msg(const uint8_t *wire, size_t size, size_t count,
+		ldns_rr_list *rrs)
+{
+	ldns_rr *rr;
+	ldns_status status;
+	size_t pos, i;
+
+	status = ldns_xfr_skip_question(wire, size, &pos);
+	for (i = 0; i < count && status == LDNS_STATUS_OK; i++) {
+		status = ldns_wire2rr(&rr, wire, size, &pos,
+				LDNS_SECTION_ANSWER);
+		if (status == LDNS_STATUS_OK &&
+		    !ldns_rr_list_push_rr(rrs, rr)) {
+			ldns_rr_free(rr);
+			status = LDNS_STATUS_MEM_ERR;
+		}
+	}
+	if (status != LDNS_STATUS_OK) {
+		for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+			ldns_rr_free(ldns_rr_list_rr(rrs, i));
+		}
+		ldns_rr_list_set_rr_count(rrs, 0);
+	}
+	return status;
+}
+
+/* Sends the transfer query over a new connection */
+static ldns_status
+ldns_xfr_open(struct ldns_xfr_conn *conn, struct ldns_xfr_state *x,
+		ldns_resolver *resolver, const ldns_rdf *domain,
+		ldns_rr_class c, ldns_rr_type t)
+{
+	ldns_pkt *query = NULL;
+	ldns_buffer *query_wire = NULL;
+	struct sockaddr_storage *src = NULL;
+	size_t src_len = 0;
+	struct sockaddr_storage *ns = NULL;
+	size_t ns_len = 0;
+	size_t ns_i;
+	ldns_status status;
+
+	memset(conn, 0, sizeof(*conn));
+	conn->sockfd = SOCK_INVALID;
+	conn->timeout = ldns_resolver_timeout(resolver);
+	memset(x, 0, sizeof(*x));
+	x->type = t;
+	x->ixfr_serial = ldns_resolver_get_ixfr_serial(resolver);
+
+	if (ldns_resolver_nameserver_count(resolver) < 1) {
+		return LDNS_STATUS_RES_NO_NS;
+	}
+	status = ldns_resolver_prepare_query_pkt(&query, resolver, domain,
+			t, c, 0);
+	if (status != LDNS_STATUS_OK) {
+		return status;
+	}
+#ifdef HAVE_SSL
+	if (ldns_resolver_tsig_keyname(resolver) &&
+	    ldns_resolver_tsig_keydata(resolver)) {
+		status = ldns_pkt_tsig_sign(query,
+		                            ldns_resolver_tsig_keyname(resolver),
+		                            ldns_resolver_tsig_keydata(resolver),
+		                            300,
+		                            ldns_resolver_tsig_algorithm(resolver),
+		                            NULL);
+		if (status != LDNS_STATUS_OK) {
+			ldns_pkt_recycle(query);
+			return LDNS_STATUS_CRYPTO_TSIG_ERR;
+		}
+	}
+#endif /* HAVE_SSL */
+	x->id = ldns_pkt_id(query);
+
+	query_wire = ldns_buffer_new_pooled(LDNS_MAX_PACKETLEN);
+	conn->buf = LDNS_XMALLOC(uint8_t, LDNS_XFR_BUFSIZE);
+	if (!query_wire || !conn->buf) {
+		status = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+	status = ldns_pkt2buffer_wire(query_wire, query);
+	if (status != LDNS_STATUS_OK) {
+		goto done;
+	}
+
+	if (ldns_resolver_source(resolver)) {
+		src = ldns_rdf2native_sockaddr_storage_port(
+				ldns_resolver_source(resolver), 0, &src_len);
+	}
+	for (ns_i = 0;
+	     ns_i < ldns_resolver_nameserver_count(resolver) &&
+	     conn->sockfd == SOCK_INVALID;
+	     ns_i++) {
+		LDNS_FREE(ns);
+		ns = ldns_rdf2native_sockaddr_storage(
+				resolver->_nameservers[ns_i],
+				ldns_resolver_port(resolver), &ns_len);
+		if (!ns) {
+			continue;
+		}
+#ifndef S_SPLINT_S
+		if ((ns->ss_family == AF_INET &&
+		     ldns_resolver_ip6(resolver) == LDNS_RESOLV_INET6) ||
+		    (ns->ss_family == AF_INET6 &&
+		     ldns_resolver_ip6(resolver) == LDNS_RESOLV_INET)) {
+			/* not reachable */
+			continue;
+		}
+#endif
+		conn->sockfd = ldns_tcp_connect_from(ns, (socklen_t)ns_len,
+				src, (socklen_t)src_len, conn->timeout);
+	}
+	if (conn->sockfd == SOCK_INVALID ||
+	    ldns_tcp_send_query(query_wire, conn->sockfd, ns,
+		    (socklen_t)ns_len) == 0) {
+		status = LDNS_STATUS_NETWORK_ERR;
+	}
+done:
+	LDNS_FREE(src);
+	LDNS_FREE(ns);
+	ldns_buffer_recycle(query_wire);
+	ldns_pkt_recycle(query);
+	return status;
+}
+
+static void
+ldns_xfr_close(struct ldns_xfr_conn *conn)
+{
+	if (conn->sockfd != SOCK_INVALID) {
+		close_socket(conn->sockfd);
+		conn->sockfd = SOCK_INVALID;
+	}
+	LDNS_FREE(conn->buf);
+}
+
+/* Returns the next message of the transfer. It stays valid until the
+ * next call.
+ */
+static ldns_status
+ldns_xfr_next_msg(struct ldns_xfr_conn *conn, uint8_t **msg, size_t *size)
+{
+	ssize_t n;
+
+	for (;;) {
+		if (conn->end - conn->start >= 2) {
+			*size = ldns_read_uint16(conn->buf + conn->start);
+			if (conn->end - conn->start >= 2 + *size) {
+				*msg = conn->buf + conn->start + 2;
+				conn->start += 2 + *size;
+				return LDNS_STATUS_OK;
+			}
+		}
+		/* keep the start of the next message, and read more */
+		if (conn->start > 0) {
+			memmove(conn->buf, conn->buf + conn->start,
+					conn->end - conn->start);
+			conn->end -= conn->start;
+			conn->start = 0;
+		}
+		if (!ldns_sock_wait(conn->sockfd, conn->timeout, 0)) {
+			return LDNS_STATUS_NETWORK_ERR;
+		}
+		n = recv(conn->sockfd, (void*) (conn->buf + conn->end),
+				(size_t) (LDNS_XFR_BUFSIZE - conn->end), 0);
+		if (n == -1 || n == 0) {
+			return LDNS_STATUS_NETWORK_ERR;
+		}
+		conn->end += (size_t) n;
+	}
+}
+
+ldns_status
+ldns_xfr_stream(ldns_resolver *resolver, const ldns_rdf *domain,
+		ldns_rr_class c, ldns_rr_type t,
+		ldns_status (*rrs_cb)(ldns_rr_list *rrs, void *arg), void *arg)
+{
+	struct ldns_xfr_state x;
+	struct ldns_xfr_conn conn;
+	ldns_rr_list *rrs;
+	ldns_status status, cb_status;
+	uint8_t *msg;
+	size_t size, count;
+
+	if (!resolver || !domain || !rrs_cb ||
+	    (t != LDNS_RR_TYPE_AXFR && t != LDNS_RR_TYPE_IXFR)) {
+		return LDNS_STATUS_NULL;
+	}
+	if (!(rrs = ldns_rr_list_new())) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	status = ldns_xfr_open(&conn, &x, resolver, domain, c, t);
+	while (status == LDNS_STATUS_OK && !x.done) {
+		status = ldns_xfr_next_msg(&conn, &msg, &size);
+		if (status == LDNS_STATUS_OK) {
+			status = ldns_xfr_scan_msg(&x, msg, size, &count);
+		}
+		if (status == LDNS_STATUS_OK) {
+			status = ldns_xfr_parse_msg(msg, size, count, rrs);
+		}
+		if (status == LDNS_STATUS_OK && count > 0) {
+			cb_status = rrs_cb(rrs, arg);
+			/* the RRs are the callback's now */
+			ldns_rr_list_set_rr_count(rrs, 0);
+			status = cb_status;
+		}
+	}
+	ldns_xfr_close(&conn);
+	ldns_rr_list_free(rrs);
+	return status;
+}
+
+#ifdef HAVE_PTHREAD
+/* A message on its way through the pipeline */
+struct ldns_xfr_slot {
+	uint8_t *wire;
+	size_t size, capacity;
+	/* the number of RRs to parse */
+	size_t count;
+	ldns_rr_list *rrs;
+	ldns_status status;
+	bool parsed;
+};
+
+/* Messages are read into the slots in turn. The nth message read is
+ * parsed by whichever worker comes first, and is handed to the callback
+ * when the messages before it have been.
+ */
+struct ldns_xfr_pipeline {
+	pthread_mutex_t lock;
+	/* signalled when a slot becomes free, a message is read or parsed */
+	pthread_cond_t cond;
+	struct ldns_xfr_slot *slots;
+	size_t nslots;
+	/* number of messages read, taken by workers and handed over */
+	size_t n_read, n_parse, n_sink;
+	/* no more messages will be read */
+	bool eof;
+	ldns_status status;
+	ldns_status (*rrs_cb)(ldns_rr_list *rrs, void *arg);
+	void *arg;
+};
+
+static void *
+ldns_xfr_pipeline_worker(void *arg)
+{
+	struct ldns_xfr_pipeline *p = arg;
+	struct ldns_xfr_slot *slot;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (p->status == LDNS_STATUS_OK &&
+		       p->n_parse == p->n_read && !p->eof) {
+			pthread_cond_wait(&p->cond, &p->lock);
+		}
+		if (p->status != LDNS_STATUS_OK || p->n_parse == p->n_read) {
+			break;
+		}
+		slot = &p->slots[p->n_parse++ % p->nslots];
+		pthread_mutex_unlock(&p->lock);
+
+		slot->status = ldns_xfr_parse_msg(slot->wire, slot->size,
+				slot->count, slot->rrs);
+
+		pthread_mutex_lock(&p->lock);
+		slot->parsed = true;
+		pthread_cond_broadcast(&p->cond);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+static void *
+ldns_xfr_pipeline_sink(void *arg)
+{
+	struct ldns_xfr_pipeline *p = arg;
+	struct ldns_xfr_slot *slot;
+	ldns_status status;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		slot = &p->slots[p->n_sink % p->nslots];
+		while (p->status == LDNS_STATUS_OK &&
+		       !(p->n_sink < p->n_read && slot->parsed) &&
+		       !(p->n_sink == p->n_read && p->eof)) {
+			pthread_cond_wait(&p->cond, &p->lock);
+		}
+		if (p->status != LDNS_STATUS_OK || p->n_sink == p->n_read) {
+			break;
+		}
+		pthread_mutex_unlock(&p->lock);
+
+		status = slot->status;
+		if (status == LDNS_STATUS_OK && slot->count > 0) {
+			status = p->rrs_cb(slot->rrs, p->arg);
+			/* the RRs are the callback's now */
+			ldns_rr_list_set_rr_count(slot->rrs, 0);
+		}
+
+		pthread_mutex_lock(&p->lock);
+		slot->parsed = false;
+		p->n_sink++;
+		if (p->status == LDNS_STATUS_OK) {
+			p->status = status;
+		}
+		pthread_cond_broadcast(&p->cond);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+/* Reads the messages into the pipeline */
+static ldns_status
+ldns_xfr_pipeline_read(struct ldns_xfr_pipeline *p,
+		ldns_resolver *resolver, const ldns_rdf *domain,
+		ldns_rr_class c, ldns_rr_type t)
+{
+	struct ldns_xfr_state x;
+	struct ldns_xfr_conn conn;
+	struct ldns_xfr_slot *slot;
+	ldns_status status;
+	uint8_t *msg;
+	size_t size, count;
+
+	status = ldns_xfr_open(&conn, &x, resolver, domain, c, t);
+	while (status == LDNS_STATUS_OK && !x.done) {
+		status = ldns_xfr_next_msg(&conn, &msg, &size);
+		if (status == LDNS_STATUS_OK) {
+			status = ldns_xfr_scan_msg(&x, msg, size, &count);
+		}
+		if (status != LDNS_STATUS_OK) {
+			break;
+		}
+		pthread_mutex_lock(&p->lock);
+		while (p->status == LDNS_STATUS_OK &&
+		       p->n_read - p->n_sink == p->nslots) {
+			pthread_cond_wait(&p->cond, &p->lock);
+		}
+		status = p->status;
+		pthread_mutex_unlock(&p->lock);
+		if (status != LDNS_STATUS_OK) {
+			break;
+		}
+		/* the slot is ours until n_read is increased */
+		slot = &p->slots[p->n_read % p->nslots];
+		if (slot->capacity < size) {
+			LDNS_FREE(slot->wire);
+			if (!(slot->wire = LDNS_XMALLOC(uint8_t, size))) {
+				slot->capacity = 0;
+				status = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			slot->capacity = size;
+		}
+		memcpy(slot->wire, msg, size);
+		slot->size = size;
+		slot->count = count;
+
+		pthread_mutex_lock(&p->lock);
+		p->n_read++;
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+	}
+	ldns_xfr_close(&conn);
+	return status;
+}
+
+static ldns_status
+ldns_xfr_pipeline_run(ldns_resolver *resolver, const ldns_rdf *domain,
+		ldns_rr_class c, ldns_rr_type t, size_t workers,
+		ldns_status (*rrs_cb)(ldns_rr_list *rrs, void *arg), void *arg)
+{
+	struct ldns_xfr_pipeline p;
+	pthread_t *threads;
+	size_t nthreads = 0, i;
+	ldns_status status = LDNS_STATUS_OK;
+	bool fallback = false;
+
+	memset(&p, 0, sizeof(p));
+	p.rrs_cb = rrs_cb;
+	p.arg = arg;
+	p.nslots = 4 * workers;
+	p.slots = LDNS_CALLOC(struct ldns_xfr_slot, p.nslots);
+	/* the workers and the sink */
+	threads = LDNS_XMALLOC(pthread_t, workers + 1);
+	if (!p.slots || !threads) {
+		LDNS_FREE(p.slots);
+		LDNS_FREE(threads);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i < p.nslots; i++) {
+		if (!(p.slots[i].rrs = ldns_rr_list_new())) {
+			status = LDNS_STATUS_MEM_ERR;
+		}
+	}
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.cond, NULL);
+
+	if (status == LDNS_STATUS_OK &&
+	    pthread_create(&threads[0], NULL,
+		    ldns_xfr_pipeline_sink, &p) == 0) {
+		nthreads = 1;
+		while (nthreads < workers + 1 &&
+		       pthread_create(&threads[nthreads], NULL,
+			       ldns_xfr_pipeline_worker, &p) == 0) {
+			nthreads++;
+		}
+	}
+	if (nthreads >= 2) {
+		status = ldns_xfr_pipeline_read(&p,
+				resolver, domain, c, t);
+	} else if (status == LDNS_STATUS_OK) {
+		/* without threads, transfer without the pipeline */
+		fallback = true;
+	}
+
+	pthread_mutex_lock(&p.lock);
+	p.eof = true;
+	if (p.status == LDNS_STATUS_OK) {
+		p.status = status;
+	}
+	pthread_cond_broadcast(&p.cond);
+	pthread_mutex_unlock(&p.lock);
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	status = p.status;
+
+	for (i = 0; i < p.nslots; i++) {
+		/* the RRs of messages that were not handed over */
+		ldns_rr_list_deep_free(p.slots[i].rrs);
+		LDNS_FREE(p.slots[i].wire);
+	}
+	pthread_cond_destroy(&p.cond);
+	pthread_mutex_destroy(&p.lock);
+	LDNS_FREE(p.slots);
+	LDNS_FREE(threads);
+	if (fallback) {
+		return ldns_xfr_stream(resolver, domain, c, t, rrs_cb, arg);
+	}
+	return status;
+}
+#endif /* HAVE_PTHREAD */
+
+ldns_status
+ldns_xfr_pipeline(ldns_resolver *resolver, const ldns_rdf *domain,
+		ldns_rr_class c, ldns_rr_type t, size_t workers,
+		ldns_status (*rrs_cb)(ldns_rr_list *rrs, void *arg), void *arg)
+{
+	if (!resolver || !domain || !rrs_cb ||
+	    (t != LDNS_RR_TYPE_AXFR && t != LDNS_RR_TYPE_IXFR)) {
+		return LDNS_STATUS_NULL;
+	}
+#ifdef HAVE_PTHREAD
+	if (workers > 0) {
+		return ldns_xfr_pipeline_run(resolver, domain, c, t,
+				workers, rrs_cb, arg);
+	}
+#else
+	(void) workers;
+#endif
+	return ldns_xfr_stream(resolver, domain, c, t, rrs_cb, arg);
+}
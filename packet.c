@@ -837,26 +837,10 @@ ldns_pkt_edns_get_option_list(ldns_pkt *packet)
 
 /* Create/destroy/convert functions
  */
-ldns_pkt *
-ldns_pkt_new(void)
+/* Sets everything in a packet, but the sections, to the defaults */
+static void
+ldns_pkt_set_defaults(ldns_pkt *packet)
 {
-	ldns_pkt *packet;
-	packet = LDNS_MALLOC(ldns_pkt);
-	if (!packet) {
-		return NULL;
-	}
-
-	packet->_header = LDNS_MALLOC(ldns_hdr);
-	if (!packet->_header) {
-		LDNS_FREE(packet);
-		return NULL;
-	}
-
-	packet->_question = ldns_rr_list_new();
-	packet->_answer = ldns_rr_list_new();
-	packet->_authority = ldns_rr_list_new();
-	packet->_additional = ldns_rr_list_new();
-
 	/* default everything to false */
 	ldns_pkt_set_qr(packet, false);
 	ldns_pkt_set_aa(packet, false);
@@ -887,6 +871,29 @@ ldns_pkt_new(void)
 	packet->_edns_present = false;
 
 	ldns_pkt_set_tsig(packet, NULL);
+}
+
+ldns_pkt *
+ldns_pkt_new(void)
+{
+	ldns_pkt *packet;
+	packet = LDNS_MALLOC(ldns_pkt);
+	if (!packet) {
+		return NULL;
+	}
+
+	packet->_header = LDNS_MALLOC(ldns_hdr);
+	if (!packet->_header) {
+		LDNS_FREE(packet);
+		return NULL;
+	}
+
+	packet->_question = ldns_rr_list_new();
+	packet->_answer = ldns_rr_list_new();
+	packet->_authority = ldns_rr_list_new();
+	packet->_additional = ldns_rr_list_new();
+
+	ldns_pkt_set_defaults(packet);
 	
 	return packet;
 }
@@ -908,6 +915,114 @@ ldns_pkt_free(ldns_pkt *packet)
 	}
 }
 
+/* Frees the RRs of a section, but keeps the list and its capacity */
+static void
+ldns_pkt_reset_section(ldns_rr_list *rrs)
+{
+	size_t i;
+
+	if (rrs) {
+		for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+			ldns_rr_free(ldns_rr_list_rr(rrs, i));
+		}
+		ldns_rr_list_set_rr_count(rrs, 0);
+	}
+}
+
+void
+ldns_pkt_reset(ldns_pkt *packet)
+{
+	if (!packet) {
+		return;
+	}
+	ldns_pkt_reset_section(packet->_question);
+	ldns_pkt_reset_section(packet->_answer);
+	ldns_pkt_reset_section(packet->_authority);
+	ldns_pkt_reset_section(packet->_additional);
+	ldns_rr_free(packet->_tsig_rr);
+	ldns_rdf_deep_free(packet->_edns_data);
+	ldns_edns_option_list_deep_free(packet->_edns_list);
+	ldns_rdf_deep_free(packet->_answerfrom);
+	ldns_pkt_set_defaults(packet);
+}
+
+/* Recycled packets; those with larger sections are not kept */
+#define LDNS_PKT_POOL_DEPTH   16
+#define LDNS_PKT_POOL_MAX_RRS 64
+
+struct ldns_pkt_pool
+{
+	ldns_pkt *packets[LDNS_PKT_POOL_DEPTH];
+	size_t count;
+};
+
+static void
+ldns_pkt_pool_drain(void *arg)
+{
+	struct ldns_pkt_pool *pool = arg;
+	while (pool->count > 0) {
+		ldns_pkt_free(pool->packets[--pool->count]);
+	}
+}
+
+static const struct _ldns_thread_pool ldns_pkt_pool_type = {
+	sizeof(struct ldns_pkt_pool), ldns_pkt_pool_drain
+};
+
+static struct ldns_pkt_pool *
+ldns_pkt_pool(bool create)
+{
+	return _ldns_thread_pool(&ldns_pkt_pool_type, create);
+}
+
+ldns_pkt *
+ldns_pkt_new_pooled(void)
+{
+	struct ldns_pkt_pool *pool = ldns_pkt_pool(false);
+
+	if (!pool || pool->count == 0) {
+		return ldns_pkt_new();
+	}
+	return pool->packets[--pool->count];
+}
+
+void
+ldns_pkt_recycle(ldns_pkt *packet)
+{
+	struct ldns_pkt_pool *pool;
+
+	if (!packet) {
+		return;
+	}
+	if (!packet->_question || !packet->_answer
+	                       || !packet->_authority || !packet->_additional
+	                       || packet->_question->_rr_capacity
+	                                          > LDNS_PKT_POOL_MAX_RRS
+	                       || packet->_answer->_rr_capacity
+	                                          > LDNS_PKT_POOL_MAX_RRS
+	                       || packet->_authority->_rr_capacity
+	                                          > LDNS_PKT_POOL_MAX_RRS
+	                       || packet->_additional->_rr_capacity
+	                                          > LDNS_PKT_POOL_MAX_RRS
+	                       || !(pool = ldns_pkt_pool(true))
+	                       || pool->count == LDNS_PKT_POOL_DEPTH) {
+		ldns_pkt_free(packet);
+		return;
+	}
+	ldns_pkt_reset(packet);
+	pool->packets[pool->count++] = packet;
+}
+
+void
+ldns_pkt_pool_free(void)
+{
+	struct ldns_pkt_pool *pool = ldns_pkt_pool(false);
+
+	if (pool) {
+		ldns_pkt_pool_drain(pool);
+	}
+}
+
 bool
 ldns_pkt_set_flags(ldns_pkt *packet, uint16_t flags)
 {
@@ -1026,19 +1141,19 @@ ldns_pkt_query_new_frm_str_internal(ldns_pkt **p, const char *name,
 	ldns_rr *question_rr;
 	ldns_rdf *name_rdf;
 
-	packet = ldns_pkt_new();
+	packet = ldns_pkt_new_pooled();
 	if (!packet) {
 		return LDNS_STATUS_MEM_ERR;
 	}
 
 	if (!ldns_pkt_set_flags(packet, flags)) {
-		ldns_pkt_free(packet);
+		ldns_pkt_recycle(packet);
 		return LDNS_STATUS_ERR;
 	}
 
 	question_rr = ldns_rr_new();
 	if (!question_rr) {
-		ldns_pkt_free(packet);
+		ldns_pkt_recycle(packet);
 		return LDNS_STATUS_MEM_ERR;
 	}
 
@@ -1058,7 +1173,7 @@ ldns_pkt_query_new_frm_str_internal(ldns_pkt **p, const char *name,
 		ldns_pkt_push_rr(packet, LDNS_SECTION_QUESTION, question_rr);
 	} else {
 		ldns_rr_free(question_rr);
-		ldns_pkt_free(packet);
+		ldns_pkt_recycle(packet);
 		return LDNS_STATUS_ERR;
 	}
 
@@ -1072,7 +1187,7 @@ ldns_pkt_query_new_frm_str_internal(ldns_pkt **p, const char *name,
 		*p = packet;
 		return LDNS_STATUS_OK;
 	} else {
-		ldns_pkt_free(packet);
+		ldns_pkt_recycle(packet);
 		return LDNS_STATUS_NULL;
 	}
 }
@@ -1108,7 +1223,7 @@ ldns_pkt_query_new_internal(ldns_rdf *rr_name, ldns_rr_type rr_type,
 	ldns_pkt *packet;
 	ldns_rr *question_rr;
 
-	packet = ldns_pkt_new();
+	packet = ldns_pkt_new_pooled();
 	if (!packet) {
 		return NULL;
 	}
@@ -1119,7 +1234,7 @@ ldns_pkt_query_new_internal(ldns_rdf *rr_name, ldns_rr_type rr_type,
 
 	question_rr = ldns_rr_new();
 	if (!question_rr) {
-		ldns_pkt_free(packet);
+		ldns_pkt_recycle(packet);
 		return NULL;
 	}
 
@@ -1218,7 +1333,7 @@ ldns_pkt_clone(const ldns_pkt *pkt)
 	if (!pkt) {
 		return NULL;
 	}
-	new_pkt = ldns_pkt_new();
+	new_pkt = ldns_pkt_new_pooled();
 
 	ldns_pkt_set_id(new_pkt, ldns_pkt_id(pkt));
 	ldns_pkt_set_qr(new_pkt, ldns_pkt_qr(pkt));
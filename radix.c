@@ -524,7 +524,7 @@ ldns_radix_next(ldns_radix_node_t* node)
 	}
 	/** No elements in subtree, get to parent and go down next branch. */
 	while (node->parent) {
-		uint8_t index = node->parent_index;
+		uint16_t index = node->parent_index;
 		node = node->parent;
 		index++;
 		for (; index < node->len; index++) {
@@ -535,7 +535,8 @@ ldns_radix_next(ldns_radix_node_t* node)
 					return node->array[index].edge;
 				}
 				/** Dive into subtree. */
-				next = ldns_radix_next_in_subtree(node);
+				next = ldns_radix_next_in_subtree(
+					node->array[index].edge);
 				if (next) {
 					return next;
 				}
@@ -1269,7 +1270,8 @@ ldns_radix_prev_from_index(ldns_radix_node_t* node, uint8_t index)
 		i--;
 		if (node->array[i].edge) {
 			ldns_radix_node_t* prev =
-				ldns_radix_last_in_subtree_incl_self(node);
+				ldns_radix_last_in_subtree_incl_self(
+				node->array[i].edge);
 			if (prev) {
 				return prev;
 			}
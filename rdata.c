@@ -186,6 +186,7 @@ ldns_rdf_new(ldns_rdf_type type, size_t size, void *data)
 	ldns_rdf_set_size(rd, size);
 	ldns_rdf_set_type(rd, type);
 	ldns_rdf_set_data(rd, data);
+	rd->_refs = 0;
 	return rd;
 }
 
@@ -214,6 +215,7 @@ ldns_rdf_new_frm_data(ldns_rdf_type type, size_t size, const void *data)
 	ldns_rdf_set_type(rdf, type);
 	ldns_rdf_set_size(rdf, size);
 	memcpy(rdf->_data, data, size);
+	rdf->_refs = 0;
 
 	return rdf;
 }
@@ -229,6 +231,11 @@ ldns_rdf_clone(const ldns_rdf *rd)
 void
 ldns_rdf_deep_free(ldns_rdf *rd)
 {
+	/* The reference that takes _refs below zero is the last one */
+	if (rd && ldns_refcount_get(&rd->_refs) > 0
+	       && ldns_refcount_dec(&rd->_refs) != (uint32_t) -1) {
+		return;
+	}
 	if (rd) {
 		if (rd->_data) {
 			LDNS_FREE(rd->_data);
@@ -237,9 +244,28 @@ ldns_rdf_deep_free(ldns_rdf *rd)
 	}
 }
 
+ldns_rdf *
+ldns_rdf_ref(ldns_rdf *rd)
+{
+	if (rd) {
+		ldns_refcount_inc(&rd->_refs);
+	}
+	return rd;
+}
+
+bool
+ldns_rdf_is_shared(const ldns_rdf *rd)
+{
+	return rd && ldns_refcount_get(&((ldns_rdf *) rd)->_refs) > 0;
+}
+
 void 
 ldns_rdf_free(ldns_rdf *rd)
 {
+	if (rd && ldns_refcount_get(&rd->_refs) > 0
+	       && ldns_refcount_dec(&rd->_refs) != (uint32_t) -1) {
+		return;
+	}
 	if (rd) {
 		LDNS_FREE(rd);
 	}
@@ -660,7 +686,7 @@ ldns_rdf_compare(const ldns_rdf *rd1, const ldns_rdf *rd2)
 	uint8_t *d1, *d2;
 
 	/* only when both are not NULL we can say anything about them */
-	if (!rd1 && !rd2) {
+	if (rd1 == rd2) {
 		return 0;
 	}
 	if (!rd1 || !rd2) {
@@ -116,6 +116,31 @@ ldns_resolver_nameserver_count(const ldns_resolver *r)
 	return r->_nameserver_count;
 }
 
+/* A sum of an FNV-1a hash of each nameserver, so that their order, which
+ * may be randomized, does not matter.
+ */
+uint64_t
+_ldns_resolver_nameservers_hash(const ldns_resolver *r)
+{
+	const ldns_rdf *ns;
+	const uint8_t *data;
+	uint64_t sum = 0, hash;
+	size_t i, j;
+
+	for (i = 0; i < r->_nameserver_count; i++) {
+		ns = r->_nameservers[i];
+		data = ldns_rdf_data(ns);
+		hash = 14695981039346656037ULL;
+		hash = (hash ^ (uint8_t) ldns_rdf_get_type(ns))
+			* 1099511628211ULL;
+		for (j = 0; j < ldns_rdf_size(ns); j++) {
+			hash = (hash ^ data[j]) * 1099511628211ULL;
+		}
+		sum += hash;
+	}
+	return sum;
+}
+
 bool
 ldns_resolver_dnssec(const ldns_resolver *r)
 {
@@ -227,6 +252,18 @@ ldns_resolver_random(const ldns_resolver *r)
 	return r->_random;
 }
 
+uint8_t
+ldns_resolver_fanout(const ldns_resolver *r)
+{
+	return r->_fanout;
+}
+
+ldns_cache *
+ldns_resolver_cache(const ldns_resolver *r)
+{
+	return r->_cache;
+}
+
 size_t
 ldns_resolver_searchlist_count(const ldns_resolver *r)
 {
@@ -603,6 +640,18 @@ ldns_resolver_set_random(ldns_resolver *r, bool b)
 	r->_random = b;
 }
 
+void
+ldns_resolver_set_fanout(ldns_resolver *r, uint8_t fanout)
+{
+	r->_fanout = fanout;
+}
+
+void
+ldns_resolver_set_cache(ldns_resolver *r, ldns_cache *cache)
+{
+	r->_cache = cache;
+}
+
 /* more sophisticated functions */
 ldns_resolver *
 ldns_resolver_new(void)
@@ -645,6 +694,12 @@ ldns_resolver_new(void)
 	 */
 	ldns_resolver_set_random(r, true);
 
+	/* query one nameserver at a time */
+	ldns_resolver_set_fanout(r, 0);
+
+	/* always go to the network */
+	ldns_resolver_set_cache(r, NULL);
+
 	ldns_resolver_set_debug(r, 0);
 
 	r->_timeout.tv_sec = LDNS_DEFAULT_TIMEOUT_SEC;
@@ -1056,7 +1111,7 @@ ldns_resolver_search_status(ldns_pkt** pkt,
 	ldns_rdf **search_list;
 	size_t i;
 	ldns_status s = LDNS_STATUS_OK;
-	ldns_rdf root_dname = { 1, LDNS_RDF_TYPE_DNAME, (void *)"" };
+	ldns_rdf root_dname = { 1, LDNS_RDF_TYPE_DNAME, (void *)"", 0 };
 
 	if (ldns_dname_absolute(name)) {
 		/* query as-is */
@@ -1083,7 +1138,7 @@ ldns_resolver_search_status(ldns_pkt** pkt,
 
 					return LDNS_STATUS_OK;
 				}
-				ldns_pkt_free(*pkt);
+				ldns_pkt_recycle(*pkt);
 				*pkt = NULL;
 			}
 		}
@@ -1098,7 +1153,7 @@ ldns_resolver_search(const ldns_resolver *r,const  ldns_rdf *name,
 	ldns_pkt* pkt = NULL;
 	if (ldns_resolver_search_status(&pkt, (ldns_resolver *)r,
 				name, t, c, flags) != LDNS_STATUS_OK) {
-		ldns_pkt_free(pkt);
+		ldns_pkt_recycle(pkt);
 		return NULL;
 	}
 	return pkt;
@@ -1132,7 +1187,7 @@ ldns_resolver_query(const ldns_resolver *r, const ldns_rdf *name,
 	ldns_pkt* pkt = NULL;
 	if (ldns_resolver_query_status(&pkt, (ldns_resolver *)r,
 				name, t, c, flags) != LDNS_STATUS_OK) {
-		ldns_pkt_free(pkt);
+		ldns_pkt_recycle(pkt);
 		return NULL;
 	}
 	return pkt;
@@ -1175,10 +1230,20 @@ ldns_resolver_send_pkt(ldns_pkt **answer, ldns_resolver *r,
 	ldns_status stat = LDNS_STATUS_OK;
 	size_t *rtt;
 
+	answer_pkt = _ldns_cache_lookup(ldns_resolver_cache(r), r, query_pkt);
+	if (answer_pkt) {
+		if (answer) {
+			*answer = answer_pkt;
+		} else {
+			ldns_pkt_recycle(answer_pkt);
+		}
+		return LDNS_STATUS_OK;
+	}
+
 	stat = ldns_send(&answer_pkt, (ldns_resolver *)r, query_pkt);
 	if (stat != LDNS_STATUS_OK) {
 		if(answer_pkt) {
-			ldns_pkt_free(answer_pkt);
+			ldns_pkt_recycle(answer_pkt);
 			answer_pkt = NULL;
 		}
 	} else {
@@ -1190,7 +1255,7 @@ ldns_resolver_send_pkt(ldns_pkt **answer, ldns_resolver *r,
 				if (ldns_pkt_edns_udp_size(query_pkt) == 0) {
 					ldns_pkt_set_edns_udp_size(query_pkt
 							, 4096);
-					ldns_pkt_free(answer_pkt);
+					ldns_pkt_recycle(answer_pkt);
 					answer_pkt = NULL;
 					/* Nameservers should not become 
 					 * unreachable because fragments are
@@ -1209,7 +1274,7 @@ ldns_resolver_send_pkt(ldns_pkt **answer, ldns_resolver *r,
 				if (stat != LDNS_STATUS_OK ||
 				    ldns_pkt_tc(answer_pkt)) {
 					ldns_resolver_set_usevc(r, true);
-					ldns_pkt_free(answer_pkt);
+					ldns_pkt_recycle(answer_pkt);
 					answer_pkt = NULL;
 					stat = ldns_send(&answer_pkt, r, query_pkt);
 					ldns_resolver_set_usevc(r, false);
@@ -1218,6 +1283,11 @@ ldns_resolver_send_pkt(ldns_pkt **answer, ldns_resolver *r,
 		}
 	}
 
+	if (stat == LDNS_STATUS_OK && answer_pkt) {
+		_ldns_cache_store(ldns_resolver_cache(r), r,
+				query_pkt, answer_pkt);
+	}
+
 	if (answer && answer_pkt) {
 		*answer = answer_pkt;
 	}
@@ -1384,17 +1454,17 @@ ldns_resolver_send(ldns_pkt **answer, ldns_resolver *r, const ldns_rdf *name,
 		                            ldns_resolver_tsig_keydata(r),
 		                            300, ldns_resolver_tsig_algorithm(r), NULL);
 		if (status != LDNS_STATUS_OK) {
-			ldns_pkt_free(query_pkt);
+			ldns_pkt_recycle(query_pkt);
 			return LDNS_STATUS_CRYPTO_TSIG_ERR;
 		}
 #else
-		ldns_pkt_free(query_pkt);
+		ldns_pkt_recycle(query_pkt);
 	        return LDNS_STATUS_CRYPTO_TSIG_ERR;
 #endif /* HAVE_SSL */
 	}
 
 	status = ldns_resolver_send_pkt(&answer_pkt, r, query_pkt);
-	ldns_pkt_free(query_pkt);
+	ldns_pkt_recycle(query_pkt);
 
 	/* allows answer to be NULL when not interested in return value */
 	if (answer) {
@@ -1403,6 +1473,149 @@ ldns_resolver_send(ldns_pkt **answer, ldns_resolver *r, const ldns_rdf *name,
 	return status;
 }
 
+/* ldns_send_multi() for the queries the cache of the resolver cannot
+ * answer, storing the answers to those in the cache.
+ */
+static ldns_status
+ldns_resolver_send_multi_cached(ldns_pkt **answers, ldns_resolver *r,
+		ldns_pkt **query_pkts, size_t count)
+{
+	ldns_cache *cache = ldns_resolver_cache(r);
+	ldns_pkt **todo_pkts, **todo_answers;
+	size_t *todo_idx;
+	ldns_status status = LDNS_STATUS_OK;
+	size_t i, n = 0;
+
+	if (!cache) {
+		return ldns_send_multi(answers, r, query_pkts, count);
+	}
+	todo_pkts = LDNS_XMALLOC(ldns_pkt *, count);
+	todo_answers = LDNS_XMALLOC(ldns_pkt *, count);
+	todo_idx = LDNS_XMALLOC(size_t, count);
+	if (!todo_pkts || !todo_answers || !todo_idx) {
+		LDNS_FREE(todo_pkts);
+		LDNS_FREE(todo_answers);
+		LDNS_FREE(todo_idx);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i < count; i++) {
+		answers[i] = _ldns_cache_lookup(cache, r, query_pkts[i]);
+		if (!answers[i]) {
+			todo_pkts[n] = query_pkts[i];
+			todo_answers[n] = NULL;
+			todo_idx[n++] = i;
+		}
+	}
+	if (n > 0) {
+		status = ldns_send_multi(todo_answers, r, todo_pkts, n);
+		for (i = 0; i < n; i++) {
+			answers[todo_idx[i]] = todo_answers[i];
+			if (todo_answers[i]) {
+				_ldns_cache_store(cache, r, todo_pkts[i],
+						todo_answers[i]);
+			}
+		}
+	}
+	LDNS_FREE(todo_pkts);
+	LDNS_FREE(todo_answers);
+	LDNS_FREE(todo_idx);
+	return status;
+}
+
+ldns_status
+ldns_resolver_send_multi(ldns_pkt **answers, ldns_resolver *r,
+		ldns_rdf * const *names, const ldns_rr_type *types, size_t count,
+		ldns_rr_class c, uint16_t flags)
+{
+	ldns_pkt **query_pkts;
+	ldns_status status, s;
+	size_t i, j;
+
+	assert(r != NULL);
+	assert(answers != NULL);
+
+	for (i = 0; i < count; i++) {
+		answers[i] = NULL;
+	}
+	if (0 == ldns_resolver_nameserver_count(r)) {
+		return LDNS_STATUS_RES_NO_NS;
+	}
+	if (0 == c) {
+		c= LDNS_RR_CLASS_IN;
+	}
+
+	/* Only plain UDP queries can be in flight together */
+	if (ldns_resolver_usevc(r) ||
+	    (ldns_resolver_tsig_keyname(r) && ldns_resolver_tsig_keydata(r))) {
+		status = LDNS_STATUS_OK;
+		for (i = 0; i < count; i++) {
+			s = ldns_resolver_send(&answers[i], r, names[i],
+					types[i], c, flags);
+			if (s != LDNS_STATUS_OK) {
+				status = s;
+			}
+		}
+		return status;
+	}
+
+	query_pkts = LDNS_XMALLOC(ldns_pkt *, count);
+	if (!query_pkts) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	status = LDNS_STATUS_OK;
+	for (i = 0; i < count; i++) {
+		query_pkts[i] = NULL;
+		if (ldns_rdf_get_type(names[i]) != LDNS_RDF_TYPE_DNAME) {
+			status = LDNS_STATUS_RES_QUERY;
+			break;
+		}
+		status = ldns_resolver_prepare_query_pkt(&query_pkts[i], r,
+				names[i], types[i] ? types[i] : LDNS_RR_TYPE_A,
+				c, flags);
+		if (status != LDNS_STATUS_OK) {
+			break;
+		}
+		/* answers are matched to their query by id, so draw a new
+		 * one and check all earlier queries again on a clash */
+		j = 0;
+		while (j < i) {
+			if (ldns_pkt_id(query_pkts[j]) ==
+			    ldns_pkt_id(query_pkts[i])) {
+				ldns_pkt_set_random_id(query_pkts[i]);
+				j = 0;
+			} else {
+				j++;
+			}
+		}
+	}
+	if (status == LDNS_STATUS_OK) {
+		status = ldns_resolver_send_multi_cached(answers, r,
+				query_pkts, count);
+	}
+
+	/* if tc=1 fall back to EDNS and/or TCP, one query at a time */
+	for (i = 0; i < count; i++) {
+		if (answers[i] && ldns_pkt_tc(answers[i]) &&
+		    ldns_resolver_fallback(r)) {
+			ldns_pkt_recycle(answers[i]);
+			answers[i] = NULL;
+			s = ldns_resolver_send_pkt(&answers[i], r,
+					query_pkts[i]);
+			if (s != LDNS_STATUS_OK) {
+				status = s;
+			}
+		}
+	}
+	for (i = 0; i < count; i++) {
+		if (!query_pkts[i]) {
+			break;
+		}
+		ldns_pkt_recycle(query_pkts[i]);
+	}
+	LDNS_FREE(query_pkts);
+	return status;
+}
+
 ldns_rr *
 ldns_axfr_next(ldns_resolver *resolver)
 {
@@ -1418,7 +1631,7 @@ ldns_axfr_next(ldns_resolver *resolver)
 
 	if (resolver->_cur_axfr_pkt) {
 		if (resolver->_axfr_i == ldns_pkt_ancount(resolver->_cur_axfr_pkt)) {
-			ldns_pkt_free(resolver->_cur_axfr_pkt);
+			ldns_pkt_recycle(resolver->_cur_axfr_pkt);
 			resolver->_cur_axfr_pkt = NULL;
 			return ldns_axfr_next(resolver);
 		}
@@ -1432,7 +1645,7 @@ ldns_axfr_next(ldns_resolver *resolver)
 
 				close_socket(resolver->_socket);
 
-				ldns_pkt_free(resolver->_cur_axfr_pkt);
+				ldns_pkt_recycle(resolver->_cur_axfr_pkt);
 				resolver->_cur_axfr_pkt = NULL;
 			}
 		}
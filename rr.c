@@ -41,6 +41,7 @@ ldns_rr_new(void)
 	rr->_rdata_fields = NULL;
 	ldns_rr_set_class(rr, LDNS_RR_CLASS_IN);
 	ldns_rr_set_ttl(rr, LDNS_DEFAULT_TTL);
+	rr->_refcount = 1;
         return rr;
 }
 
@@ -74,13 +75,50 @@ ldns_rr_new_frm_type(ldns_rr_type t)
 	ldns_rr_set_class(rr, LDNS_RR_CLASS_IN);
 	ldns_rr_set_ttl(rr, LDNS_DEFAULT_TTL);
 	ldns_rr_set_type(rr, t);
+	rr->_refcount = 1;
 	return rr;
 }
 
+ldns_rr *
+ldns_rr_ref(ldns_rr *rr)
+{
+	if (rr) {
+		ldns_refcount_inc(&rr->_refcount);
+	}
+	return rr;
+}
+
+bool
+ldns_rr_is_shared(const ldns_rr *rr)
+{
+	return rr && ldns_refcount_get(&((ldns_rr *) rr)->_refcount) > 1;
+}
+
+ldns_rr *
+ldns_rr_unshare(ldns_rr *rr)
+{
+	ldns_rr *copy;
+
+	if (!ldns_rr_is_shared(rr)) {
+		return rr;
+	}
+	copy = ldns_rr_clone(rr);
+	if (copy) {
+		ldns_rr_free(rr);
+	}
+	return copy;
+}
+
 void
 ldns_rr_free(ldns_rr *rr)
 {
 	size_t i;
+
+	/* With a single reference nobody else can add one */
+	if (rr && ldns_refcount_get(&rr->_refcount) > 1
+	       && ldns_refcount_dec(&rr->_refcount) > 0) {
+		return;
+	}
 	if (rr) {
 		if (ldns_rr_owner(rr)) {
 			ldns_rdf_deep_free(ldns_rr_owner(rr));
@@ -101,6 +139,57 @@ ldns_rdf_type_maybe_quoted(ldns_rdf_type rdf_type)
 		rdf_type == LDNS_RDF_TYPE_LONG_STR;
 }
 
+/* The scratch space for parsing RRs, so that parsing many RRs does not
+ * allocate and free it for every RR.
+ */
+struct ldns_struct_rr_parse_ctx
+{
+	char owner[LDNS_MAX_DOMAINLEN + 1];
+	char ttl[LDNS_TTL_DATALEN];
+	char clas[LDNS_SYNTAX_DATALEN];
+	/* may be copied from ttl or clas */
+	char type[LDNS_TTL_DATALEN];
+	char *rdata; /* LDNS_MAX_PACKETLEN + 1 */
+	char *rd;    /* LDNS_MAX_RDFLEN */
+	/* For RDF types with spaces (i.e. extra tokens) */
+	char *xtok;  /* LDNS_MAX_RDFLEN */
+	/* a line read from a file, grown when needed */
+	char *line;
+	size_t line_limit;
+};
+
+ldns_rr_parse_ctx *
+ldns_rr_parse_ctx_new(void)
+{
+	ldns_rr_parse_ctx *ctx = LDNS_MALLOC(ldns_rr_parse_ctx);
+
+	if (!ctx) {
+		return NULL;
+	}
+	ctx->rdata = LDNS_XMALLOC(char, LDNS_MAX_PACKETLEN + 1);
+	ctx->rd = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
+	ctx->xtok = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
+	ctx->line = NULL;
+	ctx->line_limit = 0;
+	if (!ctx->rdata || !ctx->rd || !ctx->xtok) {
+		ldns_rr_parse_ctx_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+void
+ldns_rr_parse_ctx_free(ldns_rr_parse_ctx *ctx)
+{
+	if (ctx) {
+		LDNS_FREE(ctx->rdata);
+		LDNS_FREE(ctx->rd);
+		LDNS_FREE(ctx->xtok);
+		LDNS_FREE(ctx->line);
+		LDNS_FREE(ctx);
+	}
+}
+
 /*
  * trailing spaces are allowed
  * leading spaces are not allowed
@@ -116,7 +205,8 @@ ldns_rdf_type_maybe_quoted(ldns_rdf_type rdf_type)
  * miek.nl. IN MX 10 elektron.atoom.net
  */
 static ldns_status
-ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
+ldns_rr_new_frm_str_ctx_internal(ldns_rr_parse_ctx *ctx, ldns_rr **newrr,
+                             const char *str,
                              uint32_t default_ttl, const ldns_rdf *origin,
                              ldns_rdf **prev, bool question,
 			     bool *explicit_ttl)
@@ -124,18 +214,19 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 	ldns_rr *new;
 	const ldns_rr_descriptor *desc;
 	ldns_rr_type rr_type;
-	ldns_buffer *rr_buf = NULL;
-	ldns_buffer *rd_buf = NULL;
+	ldns_buffer rr_buffer;
+	ldns_buffer rd_buffer;
+	ldns_buffer *rr_buf = &rr_buffer;
+	ldns_buffer *rd_buf = &rd_buffer;
 	uint32_t ttl_val;
-	char  *owner = NULL;
-	char  *ttl = NULL;
+	char  *owner = ctx->owner;
+	char  *ttl = ctx->ttl;
 	ldns_rr_class clas_val;
-	char  *clas = NULL;
+	char  *clas = ctx->clas;
 	char  *type = NULL;
-	size_t type_sz;
-	char  *rdata = NULL;
-	char  *rd = NULL;
-	char  *xtok = NULL; /* For RDF types with spaces (i.e. extra tokens) */
+	char  *rdata = ctx->rdata;
+	char  *rd = ctx->rd;
+	char  *xtok = ctx->xtok;
 	size_t rd_strlen;
 	const char *delimiters;
 	ssize_t c;
@@ -161,28 +252,12 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 	uint8_t *hex_data = NULL;
 
 	new = ldns_rr_new();
-
-	owner = LDNS_XMALLOC(char, LDNS_MAX_DOMAINLEN + 1);
-	ttl = LDNS_XMALLOC(char, LDNS_TTL_DATALEN);
-	clas = LDNS_XMALLOC(char, LDNS_SYNTAX_DATALEN);
-	rdata = LDNS_XMALLOC(char, LDNS_MAX_PACKETLEN + 1);
-	rr_buf = LDNS_MALLOC(ldns_buffer);
-	rd_buf = LDNS_MALLOC(ldns_buffer);
-	rd = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
-	xtok = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
-	if (rr_buf) {
-		rr_buf->_data = NULL;
-	}
-	if (rd_buf) {
-		rd_buf->_data = NULL;
-	}
-	if (!new || !owner || !ttl || !clas || !rdata ||
-			!rr_buf || !rd_buf || !rd || !xtok) {
-
+	if (!new) {
 		goto memerror;
 	}
 
-	ldns_buffer_new_frm_data(rr_buf, (char*)str, strlen(str));
+	/* the buffers only read str and rdata, they are not copied */
+	ldns_buffer_init_frm_data(rr_buf, (char*)str, strlen(str));
 
 	/* split the rr in its parts -1 signals trouble */
 	if (ldns_bget_token(rr_buf, owner, "\t\n ", LDNS_MAX_DOMAINLEN) == -1){
@@ -219,12 +294,8 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 		 */
 		if (clas_val == 0) {
 			clas_val = LDNS_RR_CLASS_IN;
-			type_sz = strlen(ttl) + 1;
-			type = LDNS_XMALLOC(char, type_sz);
-			if (!type) {
-				goto memerror;
-			}
-			strlcpy(type, ttl, type_sz);
+			type = ctx->type;
+			strlcpy(type, ttl, sizeof(ctx->type));
 		}
 	} else {
 		if (explicit_ttl)
@@ -242,21 +313,14 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 		 */
 		if (clas_val == 0) {
 			clas_val = LDNS_RR_CLASS_IN;
-			type_sz = strlen(clas) + 1;
-			type = LDNS_XMALLOC(char, type_sz);
-			if (!type) {
-				goto memerror;
-			}
-			strlcpy(type, clas, type_sz);
+			type = ctx->type;
+			strlcpy(type, clas, sizeof(ctx->type));
 		}
 	}
 	/* the rest should still be waiting for us */
 
 	if (!type) {
-		type = LDNS_XMALLOC(char, LDNS_SYNTAX_DATALEN);
-		if (!type) {
-			goto memerror;
-		}
+		type = ctx->type;
 		if (-1 == ldns_bget_token(
 				rr_buf, type, "\t\n ", LDNS_SYNTAX_DATALEN)) {
 
@@ -270,7 +334,7 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 		 * so do not set status and go to ldnserror here
 		 */
 	}
-	ldns_buffer_new_frm_data(rd_buf, rdata, strlen(rdata));
+	ldns_buffer_init_frm_data(rd_buf, rdata, strlen(rdata));
 
 	if (strncmp(owner, "@", 1) == 0) {
 		if (origin) {
@@ -330,18 +394,13 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 			}
 		}
 	}
-	LDNS_FREE(owner);
-
 	ldns_rr_set_question(new, question);
 
 	ldns_rr_set_ttl(new, ttl_val);
-	LDNS_FREE(ttl);
 
 	ldns_rr_set_class(new, clas_val);
-	LDNS_FREE(clas);
 
 	rr_type = ldns_get_rr_type_by_name(type);
-	LDNS_FREE(type);
 
 	desc = ldns_rr_descript((uint16_t)rr_type);
 	ldns_rr_set_type(new, rr_type);
@@ -620,16 +679,10 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 			ldns_rr_push_rdf(new, r);
 		}
 	} /* for (done = false, r_cnt = 0; !done && r_cnt < r_max; r_cnt++) */
-	LDNS_FREE(rd);
-	LDNS_FREE(xtok);
-	ldns_buffer_free(rr_buf);
-	LDNS_FREE(rdata);
 	if (ldns_buffer_remaining(rd_buf) > 0) {
-		ldns_buffer_free(rd_buf);
 		ldns_rr_free(new);
 		return LDNS_STATUS_SYNTAX_SUPERFLUOUS_TEXT_ERR;
 	}
-	ldns_buffer_free(rd_buf);
 
 	if (!question && desc && !was_unknown_rr_format &&
 			ldns_rr_rd_count(new) < r_min) {
@@ -649,35 +702,53 @@ ldns_rr_new_frm_str_internal(ldns_rr **newrr, const char *str,
 memerror:
 	status = LDNS_STATUS_MEM_ERR;
 error:
-	if (rd_buf && rd_buf->_data) {
-		ldns_buffer_free(rd_buf);
-	} else {
-		LDNS_FREE(rd_buf);
-	}
-	if (rr_buf && rr_buf->_data) {
-		ldns_buffer_free(rr_buf);
-	} else {
-		LDNS_FREE(rr_buf);
-	}
-	LDNS_FREE(type);
-	LDNS_FREE(owner);
-	LDNS_FREE(ttl);
-	LDNS_FREE(clas);
 	LDNS_FREE(hex_data);
 	LDNS_FREE(hex_data_str);
-	LDNS_FREE(xtok);
-	LDNS_FREE(rd);
-	LDNS_FREE(rdata);
 	ldns_rr_free(new);
 	return status;
 }
 
+static ldns_status
+ldns_rr_new_frm_str_internal(ldns_rr_parse_ctx *ctx, ldns_rr **newrr,
+                             const char *str,
+                             uint32_t default_ttl, const ldns_rdf *origin,
+                             ldns_rdf **prev, bool question,
+			     bool *explicit_ttl)
+{
+	ldns_rr_parse_ctx *my_ctx = NULL;
+	ldns_status status;
+
+	if (!ctx && !(ctx = my_ctx = ldns_rr_parse_ctx_new())) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	status = ldns_rr_new_frm_str_ctx_internal(ctx, newrr, str,
+			default_ttl, origin, prev, question, explicit_ttl);
+	ldns_rr_parse_ctx_free(my_ctx);
+	return status;
+}
+
 ldns_status
 ldns_rr_new_frm_str(ldns_rr **newrr, const char *str,
                     uint32_t default_ttl, const ldns_rdf *origin,
 				    ldns_rdf **prev)
 {
-	return ldns_rr_new_frm_str_internal(newrr,
+	return ldns_rr_new_frm_str_internal(NULL,
+	                                    newrr,
+	                                    str,
+	                                    default_ttl,
+	                                    origin,
+	                                    prev,
+	                                    false,
+					    NULL);
+}
+
+ldns_status
+ldns_rr_new_frm_str_ctx(ldns_rr_parse_ctx *ctx, ldns_rr **newrr,
+                        const char *str, uint32_t default_ttl,
+                        const ldns_rdf *origin, ldns_rdf **prev)
+{
+	return ldns_rr_new_frm_str_internal(ctx,
+	                                    newrr,
 	                                    str,
 	                                    default_ttl,
 	                                    origin,
@@ -690,7 +761,8 @@ ldns_status
 ldns_rr_new_question_frm_str(ldns_rr **newrr, const char *str,
                              const ldns_rdf *origin, ldns_rdf **prev)
 {
-	return ldns_rr_new_frm_str_internal(newrr,
+	return ldns_rr_new_frm_str_internal(NULL,
+	                                    newrr,
 	                                    str,
 	                                    0,
 	                                    origin,
@@ -722,12 +794,13 @@ ldns_rr_new_frm_fp(ldns_rr **newrr, FILE *fp, uint32_t *ttl, ldns_rdf **origin,
 }
 
 ldns_status
-_ldns_rr_new_frm_fp_l_internal(ldns_rr **newrr, FILE *fp,
-		uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev,
-		int *line_nr, bool *explicit_ttl)
+_ldns_rr_new_frm_fp_l_internal(ldns_rr_parse_ctx *ctx, ldns_rr **newrr,
+		FILE *fp, uint32_t *default_ttl, ldns_rdf **origin,
+		ldns_rdf **prev, int *line_nr, bool *explicit_ttl)
 {
-	char *line = NULL;
-	size_t limit = 0;
+	/* without a context, the line is allocated for this RR only */
+	char *line = ctx ? ctx->line : NULL;
+	size_t limit = ctx ? ctx->line_limit : 0;
 	const char *endptr;  /* unused */
 	ldns_rr *rr;
 	uint32_t ttl;
@@ -740,9 +813,16 @@ _ldns_rr_new_frm_fp_l_internal(ldns_rr **newrr, FILE *fp,
 		ttl = 0;
 	}
 	/* read an entire line in from the file */
-	if ((s = ldns_fget_token_l_st( fp, &line, &limit, false
-	                             , LDNS_PARSE_SKIP_SPACE, line_nr))) {
-		LDNS_FREE(line);
+	s = ldns_fget_token_l_st( fp, &line, &limit, false
+	                        , LDNS_PARSE_SKIP_SPACE, line_nr);
+	if (ctx) {
+		/* it may have grown */
+		ctx->line = line;
+		ctx->line_limit = limit;
+	}
+	if (s) {
+		if (!ctx)
+			LDNS_FREE(line);
 		return s;
 	}
 
@@ -755,7 +835,8 @@ _ldns_rr_new_frm_fp_l_internal(ldns_rr **newrr, FILE *fp,
 				ldns_strip_ws(line + 8));
 		if (!tmp) {
 			/* could not parse what next to $ORIGIN */
-			LDNS_FREE(line);
+			if (!ctx)
+				LDNS_FREE(line);
 			return LDNS_STATUS_SYNTAX_DNAME_ERR;
 		}
 		*origin = tmp;
@@ -769,18 +850,22 @@ _ldns_rr_new_frm_fp_l_internal(ldns_rr **newrr, FILE *fp,
 	} else if (strncmp(line, "$INCLUDE", 8) == 0) {
 		s = LDNS_STATUS_SYNTAX_INCLUDE;
 	} else if (!*ldns_strip_ws(line)) {
-		LDNS_FREE(line);
+		if (!ctx)
+			LDNS_FREE(line);
 		return LDNS_STATUS_SYNTAX_EMPTY;
 	} else {
 		if (origin && *origin) {
-			s = ldns_rr_new_frm_str_internal(&rr, (const char*)line,
-				ttl, *origin, prev, false, explicit_ttl);
+			s = ldns_rr_new_frm_str_internal(ctx, &rr,
+				(const char*)line, ttl, *origin, prev, false,
+				explicit_ttl);
 		} else {
-			s = ldns_rr_new_frm_str_internal(&rr, (const char*)line,
-				ttl, NULL, prev, false, explicit_ttl);
+			s = ldns_rr_new_frm_str_internal(ctx, &rr,
+				(const char*)line, ttl, NULL, prev, false,
+				explicit_ttl);
 		}
 	}
-	LDNS_FREE(line);
+	if (!ctx)
+		LDNS_FREE(line);
 	if (s == LDNS_STATUS_OK) {
 		if (newrr) {
 			*newrr = rr;
@@ -796,8 +881,17 @@ ldns_status
 ldns_rr_new_frm_fp_l(ldns_rr **newrr, FILE *fp, uint32_t *default_ttl,
 		ldns_rdf **origin, ldns_rdf **prev, int *line_nr)
 {
-	return _ldns_rr_new_frm_fp_l_internal(newrr, fp, default_ttl, origin,
-			prev, line_nr, NULL);
+	return _ldns_rr_new_frm_fp_l_internal(NULL, newrr, fp, default_ttl,
+			origin, prev, line_nr, NULL);
+}
+
+ldns_status
+ldns_rr_new_frm_fp_l_ctx(ldns_rr_parse_ctx *ctx, ldns_rr **newrr, FILE *fp,
+		uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev,
+		int *line_nr)
+{
+	return _ldns_rr_new_frm_fp_l_internal(ctx, newrr, fp, default_ttl,
+			origin, prev, line_nr, NULL);
 }
 
 void
@@ -1427,6 +1521,31 @@ ldns_rr_clone(const ldns_rr *rr)
 	return new_rr;
 }
 
+ldns_rr_list *
+ldns_rr_list_share(const ldns_rr_list *rrlist)
+{
+	size_t i;
+	ldns_rr_list *new_list;
+
+	if (!rrlist) {
+		return NULL;
+	}
+
+	new_list = ldns_rr_list_new();
+	if (!new_list) {
+		return NULL;
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(rrlist); i++) {
+		if (!ldns_rr_list_push_rr(new_list, ldns_rr_ref(
+				ldns_rr_list_rr(rrlist, i)))) {
+			ldns_rr_free(ldns_rr_list_rr(rrlist, i));
+			ldns_rr_list_deep_free(new_list);
+			return NULL;
+		}
+	}
+	return new_list;
+}
+
 ldns_rr_list *
 ldns_rr_list_clone(const ldns_rr_list *rrlist)
 {
@@ -1457,102 +1576,401 @@ ldns_rr_list_clone(const ldns_rr_list *rrlist)
 }
 
 
-static int
-qsort_schwartz_rr_compare(const void *a, const void *b)
-{
-	int result = 0;
-	ldns_rr *rr1, *rr2;
-	ldns_buffer *rr1_buf, *rr2_buf;
-	struct ldns_schwartzian_compare_struct *sa = *(struct ldns_schwartzian_compare_struct **) a;
-	struct ldns_schwartzian_compare_struct *sb = *(struct ldns_schwartzian_compare_struct **) b;
-	/* if we are doing 2wire, we need to do lowercasing on the dname (and maybe on the rdata)
-	 * this must be done for comparison only, so we need to have a temp var for both buffers,
-	 * which is only used when the transformed object value isn't there yet
-	 */
-	ldns_rr *canonical_a, *canonical_b;
+/* The sort key of an RR is the key of its owner name from
+ * _ldns_dname_key_write() and a 0 to end it, followed by the class, the
+ * type and the canonical rdata. So comparing the keys of two RRs with
+ * memcmp() gives the order of ldns_rr_list_sort(), as defined by
+ * RFC 4034 section 6.
+ */
+struct ldns_rr_sort_key {
+	ldns_rr *rr;
+	const uint8_t *key;
+	size_t len;
+};
 
-	rr1 = (ldns_rr *) sa->original_object;
-	rr2 = (ldns_rr *) sb->original_object;
+/* The types for which dnames in the rdata are lowercased in canonical
+ * form; the types listed in chapter 7 of RFC3597.
+ * Also added RRSIG, because a "Signer's Name" should be canonicalized
+ * too. See dnssec-bis-updates-16. We can add it to this list because
+ * the "Signer's Name"  is the only dname type rdata field in a RRSIG.
+ */
+static bool
+ldns_rr_type_canonical_rdata(ldns_rr_type type)
+{
+	switch(type) {
+        	case LDNS_RR_TYPE_NS:
+        	case LDNS_RR_TYPE_MD:
+        	case LDNS_RR_TYPE_MF:
+        	case LDNS_RR_TYPE_CNAME:
+        	case LDNS_RR_TYPE_SOA:
+        	case LDNS_RR_TYPE_MB:
+        	case LDNS_RR_TYPE_MG:
+        	case LDNS_RR_TYPE_MR:
+        	case LDNS_RR_TYPE_PTR:
+        	case LDNS_RR_TYPE_MINFO:
+        	case LDNS_RR_TYPE_MX:
+        	case LDNS_RR_TYPE_RP:
+        	case LDNS_RR_TYPE_AFSDB:
+        	case LDNS_RR_TYPE_RT:
+        	case LDNS_RR_TYPE_SIG:
+        	case LDNS_RR_TYPE_PX:
+        	case LDNS_RR_TYPE_NXT:
+        	case LDNS_RR_TYPE_NAPTR:
+        	case LDNS_RR_TYPE_KX:
+        	case LDNS_RR_TYPE_SRV:
+        	case LDNS_RR_TYPE_DNAME:
+        	case LDNS_RR_TYPE_A6:
+        	case LDNS_RR_TYPE_RRSIG:
+			return true;
+		default:
+			return false;
+	}
+}
 
-	result = ldns_rr_compare_no_rdata(rr1, rr2);
+size_t _ldns_dname_key_write(uint8_t *key, const ldns_rdf *dname);
 
-	if (result == 0) {
-		if (!sa->transformed_object) {
-			canonical_a = ldns_rr_clone(sa->original_object);
-			ldns_rr2canonical(canonical_a);
-			sa->transformed_object = ldns_buffer_new(ldns_rr_uncompressed_size(canonical_a));
-			if (ldns_rr2buffer_wire(sa->transformed_object, canonical_a, LDNS_SECTION_ANY) != LDNS_STATUS_OK) {
-		                ldns_buffer_free((ldns_buffer *)sa->transformed_object);
-                                sa->transformed_object = NULL;
-				ldns_rr_free(canonical_a);
-				return 0;
+/* Writes the sort key of rr to key, or only returns its length when key
+ * is NULL.
+ */
+static size_t
+ldns_rr_sort_key_write(uint8_t *key, const ldns_rr *rr)
+{
+	const ldns_rdf *rdf;
+	const uint8_t *data;
+	size_t len, i;
+	bool canonical;
+
+	len = _ldns_dname_key_write(key, ldns_rr_owner(rr));
+	if (key) {
+		key[len] = 0;
+		ldns_write_uint16(key + len + 1, ldns_rr_get_class(rr));
+		ldns_write_uint16(key + len + 3, ldns_rr_get_type(rr));
+	}
+	len += 5;
+
+	canonical = ldns_rr_type_canonical_rdata(ldns_rr_get_type(rr));
+	for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+		rdf = ldns_rr_rdf(rr, i);
+		if (key) {
+			data = ldns_rdf_data(rdf);
+			if (canonical &&
+			    ldns_rdf_get_type(rdf) == LDNS_RDF_TYPE_DNAME) {
+				_ldns_dname_lower(key + len, data,
+						ldns_rdf_size(rdf));
+			} else if (ldns_rdf_size(rdf) > 0) {
+				memcpy(key + len, data, ldns_rdf_size(rdf));
 			}
-			ldns_rr_free(canonical_a);
-		}
-		if (!sb->transformed_object) {
-			canonical_b = ldns_rr_clone(sb->original_object);
-			ldns_rr2canonical(canonical_b);
-			sb->transformed_object = ldns_buffer_new(ldns_rr_uncompressed_size(canonical_b));
-			if (ldns_rr2buffer_wire(sb->transformed_object, canonical_b, LDNS_SECTION_ANY) != LDNS_STATUS_OK) {
-		                ldns_buffer_free((ldns_buffer *)sa->transformed_object);
-		                ldns_buffer_free((ldns_buffer *)sb->transformed_object);
-                                sa->transformed_object = NULL;
-                                sb->transformed_object = NULL;
-				ldns_rr_free(canonical_b);
-				return 0;
+		}
+		len += ldns_rdf_size(rdf);
+	}
+	return len;
+}
+
+/* For the sorter in sorter.c */
+size_t
+_ldns_rr_sort_key_write(uint8_t *key, const ldns_rr *rr)
+{
+	return ldns_rr_sort_key_write(key, rr);
+}
+
+static int
+ldns_rr_sort_key_compare(const struct ldns_rr_sort_key *a,
+		const struct ldns_rr_sort_key *b)
+{
+	int result = memcmp(a->key, b->key, a->len < b->len ? a->len : b->len);
+
+	if (result != 0) {
+		return result;
+	}
+	return a->len < b->len ? -1 : a->len > b->len ? 1 : 0;
+}
+
+/* Below this many keys, insertion sort is faster than merging */
+#define LDNS_RR_SORT_INSERTION 16
+
+/* Sorts keys[0..n) stably, with tmp as scratch space of n keys */
+static void
+ldns_rr_sort_keys(struct ldns_rr_sort_key *keys, struct ldns_rr_sort_key *tmp,
+		size_t n)
+{
+	struct ldns_rr_sort_key k;
+	size_t half, i, j, o;
+
+	if (n <= LDNS_RR_SORT_INSERTION) {
+		for (i = 1; i < n; i++) {
+			k = keys[i];
+			for (j = i; j > 0 &&
+			     ldns_rr_sort_key_compare(&keys[j - 1], &k) > 0;
+			     j--) {
+				keys[j] = keys[j - 1];
 			}
-			ldns_rr_free(canonical_b);
+			keys[j] = k;
 		}
-		rr1_buf = (ldns_buffer *) sa->transformed_object;
-		rr2_buf = (ldns_buffer *) sb->transformed_object;
+		return;
+	}
+	half = n / 2;
+	ldns_rr_sort_keys(keys, tmp, half);
+	ldns_rr_sort_keys(keys + half, tmp, n - half);
 
-		result = ldns_rr_compare_wire(rr1_buf, rr2_buf);
+	/* already in order? */
+	if (ldns_rr_sort_key_compare(&keys[half - 1], &keys[half]) <= 0) {
+		return;
 	}
+	memcpy(tmp, keys, half * sizeof(*keys));
+	for (i = 0, j = half, o = 0; i < half && j < n; o++) {
+		if (ldns_rr_sort_key_compare(&keys[j], &tmp[i]) < 0) {
+			keys[o] = keys[j++];
+		} else {
+			keys[o] = tmp[i++];
+		}
+	}
+	/* what remains of keys[j..n) is in place already */
+	while (i < half) {
+		keys[o++] = tmp[i++];
+	}
+}
 
-	return result;
+/* Lists with fewer RRs than this are sorted in the calling thread */
+#define LDNS_RR_SORT_PARALLEL 32768
+
+/* 0 is the number of processors. Not locked: it is set before threads
+ * that sort are started (see ldns/rr.h) */
+static size_t ldns_rr_sort_threads = 0;
+
+void
+ldns_rr_list_sort_set_threads(size_t threads)
+{
+	ldns_rr_sort_threads = threads;
 }
 
+size_t
+ldns_rr_list_sort_threads(void)
+{
+#if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+	long n;
+
+	if (ldns_rr_sort_threads > 0) {
+		return ldns_rr_sort_threads;
+	}
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 16 ? 16 : n > 1 ? (size_t)n : 1;
+#elif defined(HAVE_PTHREAD)
+	return ldns_rr_sort_threads > 0 ? ldns_rr_sort_threads : 1;
+#else
+	return 1;
+#endif
+}
+
+/* A part of the list, for which the keys are written and sorted by one
+ * thread
+ */
+struct ldns_rr_sort_part {
+	struct ldns_rr_sort_key *keys;
+	struct ldns_rr_sort_key *tmp;
+	size_t n;
+	size_t (*write_key)(uint8_t *key, const ldns_rr *rr);
+	uint8_t *arena;
+};
+
+/* Two sorted runs to merge into out */
+struct ldns_rr_sort_merge {
+	const struct ldns_rr_sort_key *a;
+	size_t na;
+	const struct ldns_rr_sort_key *b;
+	size_t nb;
+	struct ldns_rr_sort_key *out;
+};
+
+static void *
+ldns_rr_sort_part(void *arg)
+{
+	struct ldns_rr_sort_part *part = arg;
+	size_t arena_size = 0;
+	uint8_t *key;
+	size_t i;
+
+	for (i = 0; i < part->n; i++) {
+		part->keys[i].len = part->write_key(NULL, part->keys[i].rr);
+		arena_size += part->keys[i].len;
+	}
+	/* at least one byte, so that NULL means allocation failure */
+	part->arena = LDNS_XMALLOC(uint8_t, arena_size + 1);
+	if (!part->arena) {
+		return NULL;
+	}
+	for (i = 0, key = part->arena; i < part->n; i++) {
+		part->keys[i].key = key;
+		key += part->write_key(key, part->keys[i].rr);
+	}
+	ldns_rr_sort_keys(part->keys, part->tmp, part->n);
+	return NULL;
+}
+
+static void *
+ldns_rr_sort_merge(void *arg)
+{
+	struct ldns_rr_sort_merge *m = arg;
+	size_t i = 0, j = 0, o = 0;
+
+	while (i < m->na && j < m->nb) {
+		if (ldns_rr_sort_key_compare(&m->b[j], &m->a[i]) < 0) {
+			m->out[o++] = m->b[j++];
+		} else {
+			m->out[o++] = m->a[i++];
+		}
+	}
+	if (i < m->na) {
+		memcpy(m->out + o, m->a + i, (m->na - i) * sizeof(*m->a));
+	}
+	if (j < m->nb) {
+		memcpy(m->out + o, m->b + j, (m->nb - j) * sizeof(*m->b));
+	}
+	return NULL;
+}
+
+/* Runs f on the n jobs of size bytes each, the first one in this thread
+ * and the others in threads of their own when possible. Also used by the
+ * zone differ in zone_diff.c.
+ */
 void
-ldns_rr_list_sort(ldns_rr_list *unsorted)
+_ldns_rr_sort_run(void *(*f)(void *), void *jobs, size_t size, size_t n)
 {
-	struct ldns_schwartzian_compare_struct **sortables;
-	size_t item_count;
+#ifdef HAVE_PTHREAD
+	pthread_t *threads = NULL;
+	bool *started = NULL;
+	size_t i;
+
+	if (n > 1) {
+		threads = LDNS_XMALLOC(pthread_t, n);
+		started = LDNS_CALLOC(bool, n);
+	}
+	for (i = 1; i < n; i++) {
+		if (threads && started) {
+			started[i] = pthread_create(&threads[i], NULL, f,
+					(uint8_t *)jobs + i * size) == 0;
+		}
+	}
+	(void) f(jobs);
+	for (i = 1; i < n; i++) {
+		if (threads && started && started[i]) {
+			(void) pthread_join(threads[i], NULL);
+		} else {
+			(void) f((uint8_t *)jobs + i * size);
+		}
+	}
+	LDNS_FREE(threads);
+	LDNS_FREE(started);
+#else
 	size_t i;
 
-	if (unsorted) {
-		item_count = ldns_rr_list_rr_count(unsorted);
-
-		sortables = LDNS_XMALLOC(struct ldns_schwartzian_compare_struct *,
-					 item_count);
-                if(!sortables) return; /* no way to return error */
-		for (i = 0; i < item_count; i++) {
-			sortables[i] = LDNS_XMALLOC(struct ldns_schwartzian_compare_struct, 1);
-                        if(!sortables[i]) {
-                                /* free the allocated parts */
-                                while(i>0) {
-                                        i--;
-                                        LDNS_FREE(sortables[i]);
-                                }
-                                /* no way to return error */
-				LDNS_FREE(sortables);
-                                return;
-                        }
-			sortables[i]->original_object = ldns_rr_list_rr(unsorted, i);
-			sortables[i]->transformed_object = NULL;
-		}
-		qsort(sortables,
-		      item_count,
-		      sizeof(struct ldns_schwartzian_compare_struct *),
-		      qsort_schwartz_rr_compare);
-		for (i = 0; i < item_count; i++) {
-			unsorted->_rrs[i] = sortables[i]->original_object;
-			if (sortables[i]->transformed_object) {
-				ldns_buffer_free(sortables[i]->transformed_object);
+	for (i = 0; i < n; i++) {
+		(void) f((uint8_t *)jobs + i * size);
+	}
+#endif
+}
+
+/* Sorts the RRs in the list on the keys written by write_key, in
+ * several threads for large lists.
+ */
+void
+_ldns_rr_list_sort_keys(ldns_rr_list *unsorted,
+		size_t (*write_key)(uint8_t *key, const ldns_rr *rr))
+{
+	struct ldns_rr_sort_key *keys, *src, *dst, *swap;
+	struct ldns_rr_sort_part *parts;
+	struct ldns_rr_sort_merge *merges;
+	size_t *runs;
+	size_t item_count, n_parts, n_runs, n_merges;
+	size_t i, j;
+	bool ok = true;
+
+	if (!unsorted || ldns_rr_list_rr_count(unsorted) < 2) {
+		return;
+	}
+	item_count = ldns_rr_list_rr_count(unsorted);
+	n_parts = item_count < LDNS_RR_SORT_PARALLEL ? 1
+	        : ldns_rr_list_sort_threads();
+	if (n_parts > item_count / (LDNS_RR_SORT_PARALLEL / 4)) {
+		n_parts = item_count / (LDNS_RR_SORT_PARALLEL / 4);
+	}
+	if (n_parts < 1) {
+		n_parts = 1;
+	}
+
+	/* the keys, and as much scratch space for merging */
+	keys = LDNS_XMALLOC(struct ldns_rr_sort_key, item_count * 2);
+	parts = LDNS_CALLOC(struct ldns_rr_sort_part, n_parts);
+	/* the start of each run, and the end of the last one */
+	runs = LDNS_XMALLOC(size_t, n_parts + 1);
+	merges = LDNS_XMALLOC(struct ldns_rr_sort_merge, n_parts);
+	if (!keys || !parts || !runs || !merges) {
+		goto done; /* no way to return error */
+	}
+	for (i = 0; i < item_count; i++) {
+		keys[i].rr = ldns_rr_list_rr(unsorted, i);
+	}
+	for (i = 0; i < n_parts; i++) {
+		runs[i] = item_count * i / n_parts;
+		parts[i].keys = keys + runs[i];
+		parts[i].tmp = keys + item_count + runs[i];
+		parts[i].n = item_count * (i + 1) / n_parts - runs[i];
+		parts[i].write_key = write_key;
+	}
+	runs[n_parts] = item_count;
+	_ldns_rr_sort_run(ldns_rr_sort_part, parts,
+			sizeof(*parts), n_parts);
+	for (i = 0; i < n_parts; i++) {
+		ok = ok && parts[i].arena != NULL;
+	}
+	if (!ok) {
+		goto done; /* no way to return error */
+	}
+
+	/* merge pairs of sorted runs until one is left */
+	src = keys;
+	dst = keys + item_count;
+	for (n_runs = n_parts; n_runs > 1; n_runs = (n_runs + 1) / 2) {
+		for (i = 0, n_merges = 0; i < n_runs; i += 2, n_merges++) {
+			merges[n_merges].a = src + runs[i];
+			merges[n_merges].na = runs[i + 1] - runs[i];
+			merges[n_merges].out = dst + runs[i];
+			if (i + 1 < n_runs) {
+				merges[n_merges].b = src + runs[i + 1];
+				merges[n_merges].nb = runs[i + 2] - runs[i + 1];
+			} else {
+				merges[n_merges].b = NULL;
+				merges[n_merges].nb = 0;
 			}
-			LDNS_FREE(sortables[i]);
 		}
-		LDNS_FREE(sortables);
+		_ldns_rr_sort_run(ldns_rr_sort_merge, merges,
+				sizeof(*merges), n_merges);
+		for (i = 0, j = 0; i < n_runs; i += 2, j++) {
+			runs[j] = runs[i];
+		}
+		runs[j] = item_count;
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	for (i = 0; i < item_count; i++) {
+		unsorted->_rrs[i] = src[i].rr;
+	}
+done:
+	if (parts) {
+		for (i = 0; i < n_parts; i++) {
+			LDNS_FREE(parts[i].arena);
+		}
 	}
+	LDNS_FREE(merges);
+	LDNS_FREE(runs);
+	LDNS_FREE(parts);
+	LDNS_FREE(keys);
+}
+
+void
+ldns_rr_list_sort(ldns_rr_list *unsorted)
+{
+	_ldns_rr_list_sort_keys(unsorted, ldns_rr_sort_key_write);
 }
 
 int
@@ -1634,6 +2052,77 @@ int ldns_rr_compare_wire(const ldns_buffer *rr1_buf, const ldns_buffer *rr2_buf)
 
 }
 
+/* Compares the RDATA of two RRs of the same type in canonical form, like
+ * ldns_rr_compare() does, but without converting them to wireformat.
+ */
+int
+_ldns_rr_compare_rdata(const ldns_rr *rr1, const ldns_rr *rr2)
+{
+	const ldns_rdf *rdf1 = NULL, *rdf2 = NULL;
+	size_t i1 = 0, i2 = 0, pos1 = 0, pos2 = 0, n, j, m;
+	bool canonical, lower1 = false, lower2 = false;
+	const uint8_t *d1, *d2;
+	uint8_t b1[64], b2[64];
+	int c;
+
+	canonical = ldns_rr_type_canonical_rdata(ldns_rr_get_type(rr1));
+	for (;;) {
+		/* go to the next rdf with bytes left, for both */
+		while (!rdf1 || pos1 == ldns_rdf_size(rdf1)) {
+			if (i1 == ldns_rr_rd_count(rr1)) {
+				rdf1 = NULL;
+				break;
+			}
+			rdf1 = ldns_rr_rdf(rr1, i1++);
+			pos1 = 0;
+			lower1 = canonical &&
+				ldns_rdf_get_type(rdf1) == LDNS_RDF_TYPE_DNAME;
+		}
+		while (!rdf2 || pos2 == ldns_rdf_size(rdf2)) {
+			if (i2 == ldns_rr_rd_count(rr2)) {
+				rdf2 = NULL;
+				break;
+			}
+			rdf2 = ldns_rr_rdf(rr2, i2++);
+			pos2 = 0;
+			lower2 = canonical &&
+				ldns_rdf_get_type(rdf2) == LDNS_RDF_TYPE_DNAME;
+		}
+		if (!rdf1 || !rdf2) {
+			/* the shorter one sorts first */
+			return rdf1 ? 1 : rdf2 ? -1 : 0;
+		}
+		n = ldns_rdf_size(rdf1) - pos1;
+		if (n > ldns_rdf_size(rdf2) - pos2) {
+			n = ldns_rdf_size(rdf2) - pos2;
+		}
+		d1 = ldns_rdf_data(rdf1) + pos1;
+		d2 = ldns_rdf_data(rdf2) + pos2;
+		if (!lower1 && !lower2) {
+			if ((c = memcmp(d1, d2, n)) != 0) {
+				return c < 0 ? -1 : 1;
+			}
+		} else for (j = 0; j < n; j += m) {
+			m = n - j < sizeof(b1) ? n - j : sizeof(b1);
+			if (lower1) {
+				_ldns_dname_lower(b1, d1 + j, m);
+			} else {
+				memcpy(b1, d1 + j, m);
+			}
+			if (lower2) {
+				_ldns_dname_lower(b2, d2 + j, m);
+			} else {
+				memcpy(b2, d2 + j, m);
+			}
+			if ((c = memcmp(b1, b2, m)) != 0) {
+				return c < 0 ? -1 : 1;
+			}
+		}
+		pos1 += n;
+		pos2 += n;
+	}
+}
+
 int
 ldns_rr_compare(const ldns_rr *rr1, const ldns_rr *rr2)
 {
@@ -1777,6 +2266,28 @@ ldns_rr_uncompressed_size(const ldns_rr *r)
 	return rrsize;
 }
 
+static bool ldns_rr_dname_is_lower(const ldns_rdf *rd);
+
+/* Lowercases a name of an RR and returns it. A shared name is replaced
+ * by a copy first, so that the other holders do not see the change; when
+ * that fails it is returned as it is.
+ */
+static ldns_rdf *
+ldns_rr_dname2canonical(ldns_rdf *rd)
+{
+	ldns_rdf *copy;
+
+	if (ldns_rdf_is_shared(rd) && !ldns_rr_dname_is_lower(rd)) {
+		if (!(copy = ldns_rdf_clone(rd))) {
+			return rd;
+		}
+		ldns_rdf_deep_free(rd);
+		rd = copy;
+	}
+	ldns_dname2canonical(rd);
+	return rd;
+}
+
 void
 ldns_rr2canonical(ldns_rr *rr)
 {
@@ -1786,47 +2297,82 @@ ldns_rr2canonical(ldns_rr *rr)
 	  return;
         }
 
-        ldns_dname2canonical(ldns_rr_owner(rr));
+	ldns_rr_set_owner(rr, ldns_rr_dname2canonical(ldns_rr_owner(rr)));
 
 	/*
 	 * lowercase the rdata dnames if the rr type is one
 	 * of the list in chapter 7 of RFC3597
-	 * Also added RRSIG, because a "Signer's Name" should be canonicalized
-	 * too. See dnssec-bis-updates-16. We can add it to this list because
-	 * the "Signer's Name"  is the only dname type rdata field in a RRSIG.
 	 */
-	switch(ldns_rr_get_type(rr)) {
-        	case LDNS_RR_TYPE_NS:
-        	case LDNS_RR_TYPE_MD:
-        	case LDNS_RR_TYPE_MF:
-        	case LDNS_RR_TYPE_CNAME:
-        	case LDNS_RR_TYPE_SOA:
-        	case LDNS_RR_TYPE_MB:
-        	case LDNS_RR_TYPE_MG:
-        	case LDNS_RR_TYPE_MR:
-        	case LDNS_RR_TYPE_PTR:
-        	case LDNS_RR_TYPE_MINFO:
-        	case LDNS_RR_TYPE_MX:
-        	case LDNS_RR_TYPE_RP:
-        	case LDNS_RR_TYPE_AFSDB:
-        	case LDNS_RR_TYPE_RT:
-        	case LDNS_RR_TYPE_SIG:
-        	case LDNS_RR_TYPE_PX:
-        	case LDNS_RR_TYPE_NXT:
-        	case LDNS_RR_TYPE_NAPTR:
-        	case LDNS_RR_TYPE_KX:
-        	case LDNS_RR_TYPE_SRV:
-        	case LDNS_RR_TYPE_DNAME:
-        	case LDNS_RR_TYPE_A6:
-        	case LDNS_RR_TYPE_RRSIG:
-			for (i = 0; i < ldns_rr_rd_count(rr); i++) {
-				ldns_dname2canonical(ldns_rr_rdf(rr, i));
+	if (ldns_rr_type_canonical_rdata(ldns_rr_get_type(rr))) {
+		for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+			(void) ldns_rr_set_rdf(rr, ldns_rr_dname2canonical(
+					ldns_rr_rdf(rr, i)), i);
+		}
+	}
+}
+
+/* Returns whether a name has no upper case letters; label lengths are
+ * below 'A', so all bytes can be checked. Other rdfs are never changed.
+ */
+static bool
+ldns_rr_dname_is_lower(const ldns_rdf *rd)
+{
+	const uint8_t *d;
+	size_t i;
+
+	if (!rd || ldns_rdf_get_type(rd) != LDNS_RDF_TYPE_DNAME) {
+		return true;
+	}
+	d = ldns_rdf_data(rd);
+	for (i = 0; i < ldns_rdf_size(rd); i++) {
+		if (d[i] >= 'A' && d[i] <= 'Z') {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Returns whether ldns_rr2canonical() would leave the RR as it is */
+bool
+_ldns_rr_is_canonical(const ldns_rr *rr)
+{
+	size_t i;
+
+	if (!ldns_rr_dname_is_lower(ldns_rr_owner(rr))) {
+		return false;
+	}
+	if (ldns_rr_type_canonical_rdata(ldns_rr_get_type(rr))) {
+		for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+			if (!ldns_rr_dname_is_lower(ldns_rr_rdf(rr, i))) {
+				return false;
 			}
-			return;
-		default:
-			/* do nothing */
-			return;
+		}
+	}
+	return true;
+}
+
+/* Sets the TTL of all RRs in a list and makes them canonical, replacing
+ * the RRs that are shared and need a change by private copies
+ */
+bool
+_ldns_rr_list_canonical_ttl(ldns_rr_list *rr_list, uint32_t ttl)
+{
+	size_t i;
+	ldns_rr *rr;
+
+	for (i = 0; i < ldns_rr_list_rr_count(rr_list); i++) {
+		rr = ldns_rr_list_rr(rr_list, i);
+		if (ldns_rr_ttl(rr) == ttl && _ldns_rr_is_canonical(rr)) {
+			continue;
+		}
+		if (!(rr = ldns_rr_unshare(rr))) {
+			return false;
+		}
+		(void) ldns_rr_list_set_rr(rr_list, rr, i);
+		ldns_rr_set_ttl(rr, ttl);
+		ldns_rr2canonical(rr);
 	}
+	return true;
 }
 
 void
@@ -0,0 +1,798 @@
+/*
+ * sign_backend.c
+ *
+ * backends that make signatures asynchronously
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+#include <ldns/config.h>
+
+#include <ldns/ldns.h>
+
+#ifdef HAVE_SSL
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+#ifdef HAVE_POLL
+#include <poll.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+
+#if defined(HAVE_SYS_UN_H) && defined(HAVE_POLL)
+#define LDNS_SIGN_SOCKET 1
+#endif
+
+/* The most requests a thread of the pool takes at once */
+#define LDNS_SIGN_POOL_TAKE 8
+
+/* The largest data of a request that a server accepts */
+#define LDNS_SIGN_SERVE_MAX_DATA (16 * 1024 * 1024)
+
+void
+ldns_sign_request_sign(ldns_sign_request *request)
+{
+	request->sig = ldns_sign_public_buffer(request->data, request->key);
+	request->status = request->sig ? LDNS_STATUS_OK : LDNS_STATUS_SSL_ERR;
+}
+
+ldns_status
+ldns_sign_backend_submit(ldns_sign_backend *backend,
+		ldns_sign_request **requests, size_t count)
+{
+	if (!backend || (!requests && count > 0)) {
+		return LDNS_STATUS_NULL;
+	}
+	return count > 0 ? backend->submit(backend, requests, count)
+	                 : LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_sign_backend_wait(ldns_sign_backend *backend)
+{
+	if (!backend) {
+		return LDNS_STATUS_NULL;
+	}
+	return backend->wait(backend);
+}
+
+void
+ldns_sign_backend_free(ldns_sign_backend *backend)
+{
+	if (backend) {
+		backend->free(backend);
+	}
+}
+
+/* The OpenSSL backend: a queue of requests from which the threads of the
+ * pool take a few at a time
+ */
+typedef struct ldns_sign_pool
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t lock;
+	/* signalled when there are requests in the queue, or on stop */
+	pthread_cond_t work;
+	/* signalled when the last submitted request is complete */
+	pthread_cond_t done;
+	pthread_t *threads;
+	size_t thread_count;
+
+	/* the requests from head up to tail are not taken yet */
+	ldns_sign_request **queue;
+	size_t head;
+	size_t tail;
+	size_t capacity;
+	/* submitted and not complete */
+	size_t busy;
+	bool stop;
+#else
+	int unused;
+#endif
+} ldns_sign_pool;
+
+#ifdef HAVE_PTHREAD
+static void *
+ldns_sign_pool_work(void *arg)
+{
+	ldns_sign_pool *pool = arg;
+	ldns_sign_request *taken[LDNS_SIGN_POOL_TAKE];
+	size_t i, n = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		pool->busy -= n;
+		if (n > 0 && pool->busy == 0) {
+			pthread_cond_broadcast(&pool->done);
+		}
+		while (pool->head == pool->tail && !pool->stop) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+		if (pool->head == pool->tail) {
+			break;
+		}
+		/* leave some for the other threads */
+		n = (pool->tail - pool->head) / pool->thread_count + 1;
+		if (n > LDNS_SIGN_POOL_TAKE) {
+			n = LDNS_SIGN_POOL_TAKE;
+		}
+		if (n > pool->tail - pool->head) {
+			n = pool->tail - pool->head;
+		}
+		memcpy(taken, pool->queue + pool->head, n * sizeof(*taken));
+		pool->head += n;
+		pthread_mutex_unlock(&pool->lock);
+
+		for (i = 0; i < n; i++) {
+			ldns_sign_request_sign(taken[i]);
+		}
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+#endif
+
+static ldns_status
+ldns_sign_pool_submit(ldns_sign_backend *backend,
+		ldns_sign_request **requests, size_t count)
+{
+	ldns_sign_pool *pool = backend->data;
+	size_t i;
+#ifdef HAVE_PTHREAD
+	ldns_sign_request **queue;
+	size_t capacity;
+
+	if (pool->thread_count == 0) {
+		for (i = 0; i < count; i++) {
+			ldns_sign_request_sign(requests[i]);
+		}
+		return LDNS_STATUS_OK;
+	}
+	pthread_mutex_lock(&pool->lock);
+	if (pool->tail + count > pool->capacity && pool->head > 0) {
+		memmove(pool->queue, pool->queue + pool->head,
+				(pool->tail - pool->head) * sizeof(*pool->queue));
+		pool->tail -= pool->head;
+		pool->head = 0;
+	}
+	if (pool->tail + count > pool->capacity) {
+		capacity = pool->capacity * 2 > pool->tail + count
+		         ? pool->capacity * 2 : pool->tail + count;
+		queue = LDNS_XREALLOC(pool->queue, ldns_sign_request *,
+				capacity);
+		if (!queue) {
+			pthread_mutex_unlock(&pool->lock);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		pool->queue = queue;
+		pool->capacity = capacity;
+	}
+	for (i = 0; i < count; i++) {
+		pool->queue[pool->tail++] = requests[i];
+	}
+	pool->busy += count;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+#else
+	(void) pool;
+	for (i = 0; i < count; i++) {
+		ldns_sign_request_sign(requests[i]);
+	}
+#endif
+	return LDNS_STATUS_OK;
+}
+
+static ldns_status
+ldns_sign_pool_wait(ldns_sign_backend *backend)
+{
+#ifdef HAVE_PTHREAD
+	ldns_sign_pool *pool = backend->data;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+#else
+	(void) backend;
+#endif
+	return LDNS_STATUS_OK;
+}
+
+static void
+ldns_sign_pool_free(ldns_sign_backend *backend)
+{
+	ldns_sign_pool *pool = backend->data;
+#ifdef HAVE_PTHREAD
+	size_t i;
+
+	(void) ldns_sign_pool_wait(backend);
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->thread_count; i++) {
+		(void) pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->lock);
+	LDNS_FREE(pool->threads);
+	LDNS_FREE(pool->queue);
+#endif
+	LDNS_FREE(pool);
+	LDNS_FREE(backend);
+}
+
+ldns_status
+ldns_sign_backend_new_openssl(ldns_sign_backend **backend, size_t threads)
+{
+	ldns_sign_backend *new_backend;
+	ldns_sign_pool *pool;
+
+	if (!backend) {
+		return LDNS_STATUS_NULL;
+	}
+	new_backend = LDNS_CALLOC(ldns_sign_backend, 1);
+	pool = LDNS_CALLOC(ldns_sign_pool, 1);
+	if (!new_backend || !pool) {
+		LDNS_FREE(new_backend);
+		LDNS_FREE(pool);
+		return LDNS_STATUS_MEM_ERR;
+	}
+#ifdef HAVE_PTHREAD
+	if (threads == 0) {
+		threads = ldns_rr_list_sort_threads();
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	/* without any threads the requests are signed on submit */
+	if ((pool->threads = LDNS_XMALLOC(pthread_t, threads))) {
+		while (pool->thread_count < threads
+		    && pthread_create(&pool->threads[pool->thread_count],
+			    NULL, ldns_sign_pool_work, pool) == 0) {
+			pool->thread_count++;
+		}
+	}
+#else
+	(void) threads;
+#endif
+	new_backend->submit = ldns_sign_pool_submit;
+	new_backend->wait = ldns_sign_pool_wait;
+	new_backend->free = ldns_sign_pool_free;
+	new_backend->data = pool;
+	*backend = new_backend;
+	return LDNS_STATUS_OK;
+}
+
+#ifdef LDNS_SIGN_SOCKET
+/* The socket backend: requests that are not written yet, and the ones
+ * that are written and wait for their reply, in order
+ */
+typedef struct ldns_sign_socket
+{
+	int fd;
+	/* the requests to write, of which sent bytes are written */
+	ldns_buffer *out;
+	size_t sent;
+	/* the replies that are read, up to the position */
+	ldns_buffer *in;
+
+	/* the requests from head up to tail wait for a reply */
+	ldns_sign_request **inflight;
+	size_t head;
+	size_t tail;
+	size_t capacity;
+	uint32_t next_id;
+	uint32_t reply_id;
+
+	/* an error of the connection, after which no requests are taken */
+	ldns_status status;
+} ldns_sign_socket;
+
+#ifdef MSG_NOSIGNAL
+#define LDNS_SIGN_SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define LDNS_SIGN_SOCKET_SEND_FLAGS 0
+#endif
+
+/* Completes the requests that wait with an error, which is kept */
+static ldns_status
+ldns_sign_socket_fail(ldns_sign_socket *s, ldns_status status)
+{
+	size_t i;
+
+	if (s->status == LDNS_STATUS_OK) {
+		s->status = status;
+	}
+	for (i = s->head; i < s->tail; i++) {
+		s->inflight[i]->status = s->status;
+	}
+	s->head = s->tail = 0;
+	s->sent = 0;
+	ldns_buffer_clear(s->out);
+	return s->status;
+}
+
+/* Completes the requests of the replies that are read */
+static ldns_status
+ldns_sign_socket_replies(ldns_sign_socket *s)
+{
+	uint8_t *data = ldns_buffer_begin(s->in);
+	size_t size = ldns_buffer_position(s->in), pos = 0, sig_size;
+	ldns_sign_request *request;
+
+	while (size - pos >= 8) {
+		sig_size = ldns_read_uint16(data + pos + 6);
+		if (size - pos < 8 + sig_size) {
+			break;
+		}
+		if (s->head == s->tail
+		||  ldns_read_uint32(data + pos) != s->reply_id) {
+			return ldns_sign_socket_fail(s,
+					LDNS_STATUS_NETWORK_ERR);
+		}
+		request = s->inflight[s->head++];
+		request->status = (ldns_status)ldns_read_uint16(data + pos + 4);
+		if (request->status == LDNS_STATUS_OK
+		&&  !(request->sig = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64,
+				sig_size, data + pos + 8))) {
+			request->status = LDNS_STATUS_MEM_ERR;
+		}
+		s->reply_id++;
+		pos += 8 + sig_size;
+	}
+	memmove(data, data + pos, size - pos);
+	ldns_buffer_set_position(s->in, size - pos);
+	if (s->head == s->tail) {
+		s->head = s->tail = 0;
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* Writes the requests and reads the replies that come in meanwhile, until
+ * all requests are written, and with all until all replies are read
+ */
+static ldns_status
+ldns_sign_socket_io(ldns_sign_socket *s, bool all)
+{
+	struct pollfd pfd;
+	ssize_t n;
+
+	while (s->status == LDNS_STATUS_OK
+	    && (s->sent < ldns_buffer_position(s->out)
+	        || (all && s->head < s->tail))) {
+		pfd.fd = s->fd;
+		pfd.events = POLLIN;
+		if (s->sent < ldns_buffer_position(s->out)) {
+			pfd.events |= POLLOUT;
+		}
+		pfd.revents = 0;
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return ldns_sign_socket_fail(s,
+					LDNS_STATUS_NETWORK_ERR);
+		}
+		if (pfd.revents & POLLOUT) {
+			n = send(s->fd, ldns_buffer_at(s->out, s->sent),
+					ldns_buffer_position(s->out) - s->sent,
+					LDNS_SIGN_SOCKET_SEND_FLAGS);
+			if (n < 0 && errno != EINTR && errno != EAGAIN
+			&&  errno != EWOULDBLOCK) {
+				return ldns_sign_socket_fail(s,
+						LDNS_STATUS_NETWORK_ERR);
+			}
+			if (n > 0 && (s->sent += (size_t)n)
+					== ldns_buffer_position(s->out)) {
+				ldns_buffer_clear(s->out);
+				s->sent = 0;
+			}
+		}
+		if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+			if (!ldns_buffer_reserve(s->in, 4096)) {
+				return ldns_sign_socket_fail(s,
+						LDNS_STATUS_MEM_ERR);
+			}
+			n = recv(s->fd, ldns_buffer_current(s->in),
+					ldns_buffer_remaining(s->in), 0);
+			if (n == 0 || (n < 0 && errno != EINTR
+			            && errno != EAGAIN
+			            && errno != EWOULDBLOCK)) {
+				return ldns_sign_socket_fail(s,
+						LDNS_STATUS_NETWORK_ERR);
+			}
+			if (n > 0) {
+				ldns_buffer_skip(s->in, n);
+				(void) ldns_sign_socket_replies(s);
+			}
+		}
+	}
+	return s->status;
+}
+
+static ldns_status
+ldns_sign_socket_submit(ldns_sign_backend *backend,
+		ldns_sign_request **requests, size_t count)
+{
+	ldns_sign_socket *s = backend->data;
+	ldns_sign_request **inflight;
+	ldns_rdf *owner;
+	size_t i, capacity, start = ldns_buffer_position(s->out);
+
+	if (s->status != LDNS_STATUS_OK) {
+		return s->status;
+	}
+	for (i = 0; i < count; i++) {
+		if (!requests[i]->key || !requests[i]->data
+		||  !ldns_key_pubkey_owner(requests[i]->key)) {
+			return LDNS_STATUS_NULL;
+		}
+		if (ldns_buffer_position(requests[i]->data) > 0xffffffff) {
+			return LDNS_STATUS_ERR;
+		}
+	}
+	if (s->tail + count > s->capacity) {
+		capacity = s->capacity * 2 > s->tail + count
+		         ? s->capacity * 2 : s->tail + count;
+		inflight = LDNS_XREALLOC(s->inflight, ldns_sign_request *,
+				capacity);
+		if (!inflight) {
+			return LDNS_STATUS_MEM_ERR;
+		}
+		s->inflight = inflight;
+		s->capacity = capacity;
+	}
+	for (i = 0; i < count; i++) {
+		if (!(owner = ldns_rdf_clone(
+				ldns_key_pubkey_owner(requests[i]->key)))) {
+			ldns_buffer_set_position(s->out, start);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		ldns_dname2canonical(owner);
+		if (!ldns_buffer_reserve(s->out, 12 + ldns_rdf_size(owner)
+				+ ldns_buffer_position(requests[i]->data))) {
+			ldns_rdf_deep_free(owner);
+			ldns_buffer_set_position(s->out, start);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		ldns_buffer_write_u32(s->out, s->next_id + (uint32_t)i);
+		ldns_buffer_write_u8(s->out,
+				(uint8_t)ldns_key_algorithm(requests[i]->key));
+		ldns_buffer_write_u16(s->out,
+				ldns_key_keytag(requests[i]->key));
+		ldns_buffer_write_u8(s->out, (uint8_t)ldns_rdf_size(owner));
+		ldns_buffer_write(s->out, ldns_rdf_data(owner),
+				ldns_rdf_size(owner));
+		ldns_buffer_write_u32(s->out, (uint32_t)
+				ldns_buffer_position(requests[i]->data));
+		ldns_buffer_write(s->out, ldns_buffer_begin(requests[i]->data),
+				ldns_buffer_position(requests[i]->data));
+		ldns_rdf_deep_free(owner);
+	}
+	for (i = 0; i < count; i++) {
+		s->inflight[s->tail++] = requests[i];
+	}
+	s->next_id += (uint32_t)count;
+	/* errors of the connection are in the status of the requests */
+	(void) ldns_sign_socket_io(s, false);
+	return LDNS_STATUS_OK;
+}
+
+static ldns_status
+ldns_sign_socket_wait(ldns_sign_backend *backend)
+{
+	return ldns_sign_socket_io(backend->data, true);
+}
+
+static void
+ldns_sign_socket_free(ldns_sign_backend *backend)
+{
+	ldns_sign_socket *s = backend->data;
+
+	(void) ldns_sign_socket_io(s, true);
+	close(s->fd);
+	ldns_buffer_free(s->out);
+	ldns_buffer_free(s->in);
+	LDNS_FREE(s->inflight);
+	LDNS_FREE(s);
+	LDNS_FREE(backend);
+}
+
+/* Writes all of a buffer to a blocking socket */
+static bool
+ldns_sign_serve_write(int fd, const ldns_buffer *buf)
+{
+	size_t pos = 0;
+	ssize_t n;
+
+	while (pos < ldns_buffer_position(buf)) {
+		n = send(fd, ldns_buffer_at(buf, pos),
+				ldns_buffer_position(buf) - pos,
+				LDNS_SIGN_SOCKET_SEND_FLAGS);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		pos += (size_t)n;
+	}
+	return true;
+}
+
+/* Signs the requests that are read completely, and writes their replies.
+ * Returns the number of bytes of requests it has done in *done.
+ */
+static ldns_status
+ldns_sign_serve_batch(int fd, ldns_sign_backend *backend,
+		const ldns_key_list *keys, ldns_rdf **owners,
+		const uint8_t *data, size_t size, size_t *done,
+		ldns_buffer *out)
+{
+	ldns_sign_request *requests = NULL, **submit = NULL;
+	uint32_t *ids = NULL;
+	size_t count = 0, n_submit = 0, capacity = 0, pos = 0, i, j;
+	size_t owner_size, data_size;
+	ldns_key *key;
+	ldns_status s = LDNS_STATUS_OK;
+	void *p;
+
+	while (s == LDNS_STATUS_OK && size - pos >= 8) {
+		owner_size = data[pos + 7];
+		if (size - pos < 12 + owner_size) {
+			break;
+		}
+		data_size = ldns_read_uint32(data + pos + 8 + owner_size);
+		if (data_size > LDNS_SIGN_SERVE_MAX_DATA) {
+			s = LDNS_STATUS_NETWORK_ERR;
+			break;
+		}
+		if (size - pos < 12 + owner_size + data_size) {
+			break;
+		}
+		if (count == capacity) {
+			capacity = capacity * 2 + 16;
+			if (!(p = LDNS_XREALLOC(requests, ldns_sign_request,
+							capacity))) {
+				s = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			requests = p;
+			if (!(p = LDNS_XREALLOC(ids, uint32_t, capacity))) {
+				s = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			ids = p;
+		}
+		memset(&requests[count], 0, sizeof(*requests));
+		requests[count].status =
+			LDNS_STATUS_CRYPTO_NO_MATCHING_KEYTAG_DNSKEY;
+		ids[count] = ldns_read_uint32(data + pos);
+		for (i = 0; i < ldns_key_list_key_count(keys); i++) {
+			key = ldns_key_list_key(keys, i);
+			if (owners[i]
+			&&  data[pos + 4] == (uint8_t)ldns_key_algorithm(key)
+			&&  ldns_read_uint16(data + pos + 5)
+					== ldns_key_keytag(key)
+			&&  owner_size == ldns_rdf_size(owners[i])
+			&&  memcmp(data + pos + 8, ldns_rdf_data(owners[i]),
+					owner_size) == 0) {
+				requests[count].key = key;
+				break;
+			}
+		}
+		if (requests[count].key) {
+			if ((requests[count].data =
+					ldns_buffer_new(data_size + 1))) {
+				ldns_buffer_write(requests[count].data,
+						data + pos + 12 + owner_size,
+						data_size);
+			} else {
+				requests[count].status = LDNS_STATUS_MEM_ERR;
+			}
+		}
+		count++;
+		pos += 12 + owner_size + data_size;
+	}
+	*done = pos;
+	if (s == LDNS_STATUS_OK && count > 0) {
+		if (!(submit = LDNS_XMALLOC(ldns_sign_request *, count))) {
+			s = LDNS_STATUS_MEM_ERR;
+		}
+	}
+	if (s == LDNS_STATUS_OK) {
+		for (i = 0; i < count; i++) {
+			if (requests[i].data) {
+				submit[n_submit++] = &requests[i];
+			}
+		}
+		if ((s = ldns_sign_backend_submit(backend, submit, n_submit))
+				== LDNS_STATUS_OK) {
+			s = ldns_sign_backend_wait(backend);
+		}
+	}
+	ldns_buffer_clear(out);
+	for (i = 0; s == LDNS_STATUS_OK && i < count; i++) {
+		j = requests[i].sig ? ldns_rdf_size(requests[i].sig) : 0;
+		if (j > 0xffff || !ldns_buffer_reserve(out, 8 + j)) {
+			s = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+		if (j == 0 && requests[i].status == LDNS_STATUS_OK) {
+			requests[i].status = LDNS_STATUS_ERR;
+		}
+		ldns_buffer_write_u32(out, ids[i]);
+		ldns_buffer_write_u16(out, (uint16_t)requests[i].status);
+		ldns_buffer_write_u16(out, (uint16_t)j);
+		if (j > 0) {
+			ldns_buffer_write(out, ldns_rdf_data(requests[i].sig), j);
+		}
+	}
+	if (s == LDNS_STATUS_OK && !ldns_sign_serve_write(fd, out)) {
+		s = LDNS_STATUS_NETWORK_ERR;
+	}
+	for (i = 0; i < count; i++) {
+		ldns_buffer_free(requests[i].data);
+		ldns_rdf_deep_free(requests[i].sig);
+	}
+	LDNS_FREE(requests);
+	LDNS_FREE(submit);
+	LDNS_FREE(ids);
+	return s;
+}
+#endif /* LDNS_SIGN_SOCKET */
+
+ldns_status
+ldns_sign_backend_new_socket(ldns_sign_backend **backend, const char *path)
+{
+#ifdef LDNS_SIGN_SOCKET
+	ldns_sign_backend *new_backend;
+	ldns_sign_socket *s;
+	struct sockaddr_un addr;
+	int fd, flag;
+
+	if (!backend || !path) {
+		return LDNS_STATUS_NULL;
+	}
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		return LDNS_STATUS_ERR;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path, strlen(path));
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		return LDNS_STATUS_SOCKET_ERROR;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		return LDNS_STATUS_NETWORK_ERR;
+	}
+	/* so that replies are read while requests can not be written */
+	if ((flag = fcntl(fd, F_GETFL)) == -1
+	||  fcntl(fd, F_SETFL, flag | O_NONBLOCK) == -1) {
+		close(fd);
+		return LDNS_STATUS_SOCKET_ERROR;
+	}
+#ifdef SO_NOSIGPIPE
+	flag = 1;
+	(void) setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &flag, sizeof(flag));
+#endif
+	new_backend = LDNS_CALLOC(ldns_sign_backend, 1);
+	s = LDNS_CALLOC(ldns_sign_socket, 1);
+	if (!new_backend || !s
+	||  !(s->out = ldns_buffer_new(LDNS_MAX_PACKETLEN))
+	||  !(s->in = ldns_buffer_new(LDNS_MAX_PACKETLEN))) {
+		if (s) {
+			ldns_buffer_free(s->out);
+		}
+		LDNS_FREE(s);
+		LDNS_FREE(new_backend);
+		close(fd);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	s->fd = fd;
+	new_backend->submit = ldns_sign_socket_submit;
+	new_backend->wait = ldns_sign_socket_wait;
+	new_backend->free = ldns_sign_socket_free;
+	new_backend->data = s;
+	*backend = new_backend;
+	return LDNS_STATUS_OK;
+#else
+	(void) backend;
+	(void) path;
+	return LDNS_STATUS_NOT_IMPL;
+#endif
+}
+
+ldns_status
+ldns_sign_backend_serve(int fd, ldns_sign_backend *backend,
+		const ldns_key_list *keys)
+{
+#ifdef LDNS_SIGN_SOCKET
+	ldns_rdf **owners;
+	ldns_buffer *in, *out;
+	size_t i, n_keys, done;
+	ssize_t n;
+	ldns_status s = LDNS_STATUS_OK;
+
+	if (!backend || !keys) {
+		return LDNS_STATUS_NULL;
+	}
+	/* the owner names of the keys as they come in the requests */
+	n_keys = ldns_key_list_key_count(keys);
+	if (!(owners = LDNS_CALLOC(ldns_rdf *, n_keys + 1))) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i < n_keys; i++) {
+		if (ldns_key_pubkey_owner(ldns_key_list_key(keys, i))) {
+			if (!(owners[i] = ldns_rdf_clone(ldns_key_pubkey_owner(
+						ldns_key_list_key(keys, i))))) {
+				s = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			ldns_dname2canonical(owners[i]);
+		}
+	}
+	in = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	out = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	if (!in || !out) {
+		s = LDNS_STATUS_MEM_ERR;
+	}
+	while (s == LDNS_STATUS_OK) {
+		if (!ldns_buffer_reserve(in, LDNS_MAX_PACKETLEN)) {
+			s = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+		n = recv(fd, ldns_buffer_current(in),
+				ldns_buffer_remaining(in), 0);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			s = LDNS_STATUS_NETWORK_ERR;
+			break;
+		}
+		if (n == 0) {
+			/* a request that is cut off */
+			if (ldns_buffer_position(in) > 0) {
+				s = LDNS_STATUS_NETWORK_ERR;
+			}
+			break;
+		}
+		ldns_buffer_skip(in, n);
+		s = ldns_sign_serve_batch(fd, backend, keys, owners,
+				ldns_buffer_begin(in), ldns_buffer_position(in),
+				&done, out);
+		memmove(ldns_buffer_begin(in), ldns_buffer_at(in, done),
+				ldns_buffer_position(in) - done);
+		ldns_buffer_set_position(in, ldns_buffer_position(in) - done);
+	}
+	for (i = 0; i < n_keys; i++) {
+		ldns_rdf_deep_free(owners[i]);
+	}
+	LDNS_FREE(owners);
+	ldns_buffer_free(in);
+	ldns_buffer_free(out);
+	return s;
+#else
+	(void) fd;
+	(void) backend;
+	(void) keys;
+	return LDNS_STATUS_NOT_IMPL;
+#endif
+}
+
+#endif /* HAVE_SSL */
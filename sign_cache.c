@@ -0,0 +1,324 @@
+/*
+ * sign_cache.c
+ *
+ * a cache of signatures that is kept between signing runs
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+#include <ldns/config.h>
+
+#include <ldns/ldns.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* The start of a cache file. It is followed by the signatures, each as its
+ * digest, the size of the signature in two bytes and the signature.
+ */
+static const uint8_t ldns_sign_cache_magic[8] =
+	{ 'L', 'D', 'N', 'S', 'S', 'I', 'G', '1' };
+
+typedef struct ldns_sign_cache_entry
+{
+	uint8_t digest[LDNS_SHA256_DIGEST_LENGTH];
+	/* whether it was looked up or stored since the cache was read */
+	bool used;
+	uint16_t sig_size;
+	/* the signature follows the entry */
+} ldns_sign_cache_entry;
+
+struct ldns_struct_sign_cache
+{
+	/* open addressing on the first bytes of the digests, which are
+	 * spread evenly already; the capacity is a power of two
+	 */
+	ldns_sign_cache_entry **table;
+	size_t capacity;
+	size_t count;
+	size_t hits;
+	ldns_lock_type lock;
+};
+
+#define LDNS_SIGN_CACHE_SIG(entry) ((uint8_t *)((entry) + 1))
+
+ldns_sign_cache *
+ldns_sign_cache_new(void)
+{
+	ldns_sign_cache *cache = LDNS_CALLOC(ldns_sign_cache, 1);
+
+	if (!cache) {
+		return NULL;
+	}
+	cache->capacity = 1024;
+	if (!(cache->table = LDNS_CALLOC(ldns_sign_cache_entry *,
+					cache->capacity))) {
+		LDNS_FREE(cache);
+		return NULL;
+	}
+	ldns_lock_init(&cache->lock);
+	return cache;
+}
+
+/* the following functions must be called with the cache locked */
+
+static size_t
+ldns_sign_cache_slot(const ldns_sign_cache *cache, const uint8_t *digest)
+{
+	size_t i = (size_t)ldns_read_uint32(digest) & (cache->capacity - 1);
+
+	while (cache->table[i] && memcmp(cache->table[i]->digest, digest,
+				LDNS_SHA256_DIGEST_LENGTH) != 0) {
+		i = (i + 1) & (cache->capacity - 1);
+	}
+	return i;
+}
+
+static bool
+ldns_sign_cache_grow(ldns_sign_cache *cache)
+{
+	ldns_sign_cache_entry **old_table = cache->table;
+	size_t old_capacity = cache->capacity, i;
+
+	if (!(cache->table = LDNS_CALLOC(ldns_sign_cache_entry *,
+					old_capacity * 2))) {
+		cache->table = old_table;
+		return false;
+	}
+	cache->capacity = old_capacity * 2;
+	for (i = 0; i < old_capacity; i++) {
+		if (old_table[i]) {
+			cache->table[ldns_sign_cache_slot(cache,
+					old_table[i]->digest)] = old_table[i];
+		}
+	}
+	LDNS_FREE(old_table);
+	return true;
+}
+
+/* Adds a signature, unless it is there already */
+static ldns_status
+ldns_sign_cache_add(ldns_sign_cache *cache, const uint8_t *digest,
+		const uint8_t *sig, size_t sig_size, bool used)
+{
+	ldns_sign_cache_entry *entry;
+	size_t i;
+
+	if (sig_size > 0xffff) {
+		return LDNS_STATUS_ERR;
+	}
+	/* keep the table at most half full */
+	if (cache->count * 2 >= cache->capacity
+	&&  !ldns_sign_cache_grow(cache)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	i = ldns_sign_cache_slot(cache, digest);
+	if (cache->table[i]) {
+		cache->table[i]->used |= used;
+		return LDNS_STATUS_OK;
+	}
+	entry = (ldns_sign_cache_entry *)LDNS_XMALLOC(uint8_t,
+			sizeof(ldns_sign_cache_entry) + sig_size);
+	if (!entry) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	memcpy(entry->digest, digest, LDNS_SHA256_DIGEST_LENGTH);
+	entry->used = used;
+	entry->sig_size = (uint16_t)sig_size;
+	memcpy(LDNS_SIGN_CACHE_SIG(entry), sig, sig_size);
+	cache->table[i] = entry;
+	cache->count++;
+	return LDNS_STATUS_OK;
+}
+
+/* end of the functions that must be called with the cache locked */
+
+ldns_status
+ldns_sign_cache_new_frm_file(ldns_sign_cache **cache, const char *filename)
+{
+	ldns_sign_cache *new_cache;
+	uint8_t head[LDNS_SHA256_DIGEST_LENGTH + 2];
+	uint8_t *sig = NULL, *new_sig;
+	uint8_t magic[sizeof(ldns_sign_cache_magic)];
+	ldns_status s = LDNS_STATUS_OK;
+	size_t n, sig_capacity = 0;
+	FILE *fp;
+
+	if (!cache || !filename) {
+		return LDNS_STATUS_NULL;
+	}
+	if (!(new_cache = ldns_sign_cache_new())) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (!(fp = fopen(filename, "rb"))) {
+		if (errno == ENOENT) {
+			*cache = new_cache;
+			return LDNS_STATUS_OK;
+		}
+		ldns_sign_cache_free(new_cache);
+		return LDNS_STATUS_FILE_ERR;
+	}
+	if (fread(magic, sizeof(magic), 1, fp) != 1
+	||  memcmp(magic, ldns_sign_cache_magic, sizeof(magic)) != 0) {
+		s = LDNS_STATUS_FILE_ERR;
+	}
+	while (s == LDNS_STATUS_OK) {
+		if ((n = fread(head, 1, sizeof(head), fp)) == 0 && feof(fp)) {
+			break;
+		}
+		if (n != sizeof(head)) {
+			s = LDNS_STATUS_FILE_ERR;
+			break;
+		}
+		n = ldns_read_uint16(head + LDNS_SHA256_DIGEST_LENGTH);
+		/* the signatures of a file are mostly of one size */
+		if (n > sig_capacity) {
+			if (!(new_sig = LDNS_XREALLOC(sig, uint8_t, n))) {
+				s = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+			sig = new_sig;
+			sig_capacity = n;
+		}
+		if (n > 0 && fread(sig, n, 1, fp) != 1) {
+			s = LDNS_STATUS_FILE_ERR;
+			break;
+		}
+		s = ldns_sign_cache_add(new_cache, head, sig, n, false);
+	}
+	LDNS_FREE(sig);
+	fclose(fp);
+	if (s != LDNS_STATUS_OK) {
+		ldns_sign_cache_free(new_cache);
+		return s;
+	}
+	*cache = new_cache;
+	return LDNS_STATUS_OK;
+}
+
+ldns_rdf *
+ldns_sign_cache_lookup(ldns_sign_cache *cache,
+		const uint8_t digest[LDNS_SHA256_DIGEST_LENGTH])
+{
+	ldns_sign_cache_entry *entry;
+	ldns_rdf *sig = NULL;
+
+	if (!cache || !digest) {
+		return NULL;
+	}
+	ldns_lock(&cache->lock);
+	if ((entry = cache->table[ldns_sign_cache_slot(cache, digest)])) {
+		entry->used = true;
+		cache->hits++;
+		sig = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64,
+				entry->sig_size, LDNS_SIGN_CACHE_SIG(entry));
+	}
+	ldns_unlock(&cache->lock);
+	return sig;
+}
+
+ldns_status
+ldns_sign_cache_store(ldns_sign_cache *cache,
+		const uint8_t digest[LDNS_SHA256_DIGEST_LENGTH],
+		const ldns_rdf *sig)
+{
+	ldns_status s;
+
+	if (!cache || !digest || !sig) {
+		return LDNS_STATUS_NULL;
+	}
+	ldns_lock(&cache->lock);
+	s = ldns_sign_cache_add(cache, digest,
+			ldns_rdf_data(sig), ldns_rdf_size(sig), true);
+	ldns_unlock(&cache->lock);
+	return s;
+}
+
+ldns_status
+ldns_sign_cache_write(ldns_sign_cache *cache, const char *filename)
+{
+	ldns_sign_cache_entry *entry;
+	uint8_t size[2];
+	char *tmpname;
+	bool ok;
+	size_t i;
+	FILE *fp;
+
+	if (!cache || !filename) {
+		return LDNS_STATUS_NULL;
+	}
+	if (!(tmpname = LDNS_XMALLOC(char, strlen(filename) + 5))) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	snprintf(tmpname, strlen(filename) + 5, "%s.tmp", filename);
+	if (!(fp = fopen(tmpname, "wb"))) {
+		LDNS_FREE(tmpname);
+		return LDNS_STATUS_FILE_ERR;
+	}
+	ldns_lock(&cache->lock);
+	ok = fwrite(ldns_sign_cache_magic,
+			sizeof(ldns_sign_cache_magic), 1, fp) == 1;
+	for (i = 0; ok && i < cache->capacity; i++) {
+		if (!(entry = cache->table[i]) || !entry->used) {
+			continue;
+		}
+		ldns_write_uint16(size, entry->sig_size);
+		ok = fwrite(entry->digest, LDNS_SHA256_DIGEST_LENGTH, 1, fp) == 1
+		  && fwrite(size, 2, 1, fp) == 1
+		  && (entry->sig_size == 0 || fwrite(LDNS_SIGN_CACHE_SIG(entry),
+				  entry->sig_size, 1, fp) == 1);
+	}
+	ldns_unlock(&cache->lock);
+	ok = fclose(fp) == 0 && ok;
+	if (ok && rename(tmpname, filename) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		(void) remove(tmpname);
+	}
+	LDNS_FREE(tmpname);
+	return ok ? LDNS_STATUS_OK : LDNS_STATUS_FILE_ERR;
+}
+
+size_t
+ldns_sign_cache_count(ldns_sign_cache *cache)
+{
+	size_t count;
+
+	ldns_lock(&cache->lock);
+	count = cache->count;
+	ldns_unlock(&cache->lock);
+	return count;
+}
+
+size_t
+ldns_sign_cache_hits(ldns_sign_cache *cache)
+{
+	size_t hits;
+
+	ldns_lock(&cache->lock);
+	hits = cache->hits;
+	ldns_unlock(&cache->lock);
+	return hits;
+}
+
+void
+ldns_sign_cache_free(ldns_sign_cache *cache)
+{
+	size_t i;
+
+	if (!cache) {
+		return;
+	}
+	for (i = 0; i < cache->capacity; i++) {
+		LDNS_FREE(cache->table[i]);
+	}
+	LDNS_FREE(cache->table);
+	ldns_lock_destroy(&cache->lock);
+	LDNS_FREE(cache);
+}
@@ -0,0 +1,559 @@
+/*
+ * sorter.c
+ *
+ * sorting RRs in canonical order in bounded memory
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+#include <ldns/config.h>
+
+#include <ldns/ldns.h>
+
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/* At most this many runs are kept. When one more is needed, the runs are
+ * merged into one first, so the number of open files stays bounded.
+ */
+#define LDNS_RR_SORTER_MAX_RUNS 64
+
+/* From rr.c; memcmp() on these keys gives the order of ldns_rr_list_sort() */
+size_t _ldns_rr_sort_key_write(uint8_t *key, const ldns_rr *rr);
+
+/* A sorted source of RRs while merging: a run, or the RRs in memory */
+struct ldns_rr_sorter_source
+{
+	/** the run, or NULL for the RRs in memory */
+	FILE *fp;
+	/** the current RR, or NULL when the source is exhausted */
+	ldns_rr *rr;
+	/** the sort key of the current RR */
+	uint8_t *key;
+	size_t key_len;
+	size_t key_size;
+};
+
+struct ldns_struct_rr_sorter
+{
+	size_t max_memory;
+	char *tmpdir;
+	/** the RRs in memory, and about the memory they take */
+	ldns_rr_list *rrs;
+	size_t memory;
+	/** the runs in temporary files */
+	FILE *runs[LDNS_RR_SORTER_MAX_RUNS];
+	size_t run_count;
+	size_t runs_written;
+	/** for writing RRs to and reading them from the runs */
+	ldns_buffer *buf;
+	/** set once RRs are taken out */
+	bool taking;
+	/** the next RR in memory to take out, when there are no runs */
+	size_t next;
+	/** the sources being merged */
+	struct ldns_rr_sorter_source *sources;
+	size_t source_count;
+	/** the sources that have an RR, as a heap on those RRs */
+	size_t *heap;
+	size_t heap_count;
+};
+
+/* About the memory an RR in the sorter takes: its structs and its data,
+ * and its sort key and place in the sort arrays while sorting.
+ */
+static size_t
+ldns_rr_sorter_rr_memory(const ldns_rr *rr)
+{
+	return sizeof(ldns_rr) + 64
+	     + (ldns_rr_rd_count(rr) + 1) * (sizeof(ldns_rdf) + 32)
+	     + 2 * ldns_rr_uncompressed_size(rr);
+}
+
+ldns_rr_sorter *
+ldns_rr_sorter_new(size_t max_memory, const char *tmpdir)
+{
+	ldns_rr_sorter *sorter;
+
+	sorter = LDNS_CALLOC(ldns_rr_sorter, 1);
+	if (!sorter) {
+		return NULL;
+	}
+	sorter->max_memory = max_memory;
+	sorter->rrs = ldns_rr_list_new();
+	sorter->buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	if (!sorter->rrs || !sorter->buf ||
+	    (tmpdir && !(sorter->tmpdir = strdup(tmpdir)))) {
+		ldns_rr_sorter_free(sorter);
+		return NULL;
+	}
+	return sorter;
+}
+
+/* Opens a new temporary file, that is removed when it is closed */
+static FILE *
+ldns_rr_sorter_tmpfile(const ldns_rr_sorter *sorter)
+{
+#ifdef HAVE_MKSTEMP
+	char *path;
+	size_t len;
+	int fd;
+	FILE *fp;
+
+	if (sorter->tmpdir) {
+		len = strlen(sorter->tmpdir) + sizeof("/ldns-sort-XXXXXX");
+		path = LDNS_XMALLOC(char, len);
+		if (!path) {
+			return NULL;
+		}
+		snprintf(path, len, "%s/ldns-sort-XXXXXX", sorter->tmpdir);
+		fd = mkstemp(path);
+		if (fd == -1) {
+			LDNS_FREE(path);
+			return NULL;
+		}
+		(void) unlink(path);
+		LDNS_FREE(path);
+		if (!(fp = fdopen(fd, "w+b"))) {
+			close(fd);
+		}
+		return fp;
+	}
+#endif
+	return tmpfile();
+}
+
+/* Runs are RRs one after the other, each after its length in four octets.
+ * An RR is its owner, type, class and TTL, and its rdfs, each with its
+ * type and size, so it comes back exactly as it was, unlike RRs in
+ * wireformat, which can come back with their rdata in different rdfs.
+ */
+static void
+ldns_rr_sorter_buffer_write_rdf(ldns_buffer *buf, const ldns_rdf *rdf)
+{
+	ldns_buffer_write_u16(buf, (uint16_t) ldns_rdf_get_type(rdf));
+	ldns_buffer_write_u16(buf, (uint16_t) ldns_rdf_size(rdf));
+	ldns_buffer_write(buf, ldns_rdf_data(rdf), ldns_rdf_size(rdf));
+}
+
+static ldns_status
+ldns_rr_sorter_write_rr(ldns_rr_sorter *sorter, FILE *fp, const ldns_rr *rr)
+{
+	ldns_buffer *buf = sorter->buf;
+	size_t i;
+
+	if (!ldns_rr_owner(rr)) {
+		return LDNS_STATUS_NULL;
+	}
+	ldns_buffer_clear(buf);
+	if (!ldns_buffer_reserve(buf, 4 + 4 + ldns_rdf_size(ldns_rr_owner(rr))
+				+ 10 + 4 * ldns_rr_rd_count(rr)
+				+ ldns_rr_uncompressed_size(rr))) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	ldns_buffer_skip(buf, 4);
+	ldns_rr_sorter_buffer_write_rdf(buf, ldns_rr_owner(rr));
+	ldns_buffer_write_u16(buf, ldns_rr_get_type(rr));
+	ldns_buffer_write_u16(buf, ldns_rr_get_class(rr));
+	ldns_buffer_write_u32(buf, ldns_rr_ttl(rr));
+	ldns_buffer_write_u16(buf, (uint16_t) ldns_rr_rd_count(rr));
+	for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+		if (ldns_rdf_size(ldns_rr_rdf(rr, i)) > 0xFFFF) {
+			return LDNS_STATUS_RDATA_OVERFLOW;
+		}
+		ldns_rr_sorter_buffer_write_rdf(buf, ldns_rr_rdf(rr, i));
+	}
+	ldns_buffer_write_u32_at(buf, 0, (uint32_t) ldns_buffer_position(buf) - 4);
+	if (fwrite(ldns_buffer_begin(buf),
+			ldns_buffer_position(buf), 1, fp) != 1) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	return LDNS_STATUS_OK;
+}
+
+static ldns_rdf *
+ldns_rr_sorter_buffer_read_rdf(ldns_buffer *buf)
+{
+	ldns_rdf_type type;
+	size_t size;
+	ldns_rdf *rdf;
+
+	if (!ldns_buffer_available(buf, 4)) {
+		return NULL;
+	}
+	type = (ldns_rdf_type) ldns_buffer_read_u16(buf);
+	size = ldns_buffer_read_u16(buf);
+	if (!ldns_buffer_available(buf, size)) {
+		return NULL;
+	}
+	rdf = ldns_rdf_new_frm_data(type, size, ldns_buffer_current(buf));
+	ldns_buffer_skip(buf, size);
+	return rdf;
+}
+
+static ldns_status
+ldns_rr_sorter_read_rr(ldns_rr_sorter *sorter, FILE *fp, ldns_rr **rr)
+{
+	ldns_buffer *buf = sorter->buf;
+	uint8_t len[4];
+	size_t n, rd_count;
+	ldns_rdf *rdf;
+
+	*rr = NULL;
+	if ((n = fread(len, 1, sizeof(len), fp)) == 0 && feof(fp)) {
+		return LDNS_STATUS_OK;
+	}
+	if (n != sizeof(len)) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	n = ldns_read_uint32(len);
+	ldns_buffer_clear(buf);
+	if (!ldns_buffer_reserve(buf, n)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (fread(ldns_buffer_begin(buf), n, 1, fp) != 1) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	ldns_buffer_set_limit(buf, n);
+
+	if (!(*rr = ldns_rr_new())) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (!(rdf = ldns_rr_sorter_buffer_read_rdf(buf))) {
+		goto error;
+	}
+	ldns_rr_set_owner(*rr, rdf);
+	if (!ldns_buffer_available(buf, 10)) {
+		goto error;
+	}
+	ldns_rr_set_type(*rr, (ldns_rr_type) ldns_buffer_read_u16(buf));
+	ldns_rr_set_class(*rr, (ldns_rr_class) ldns_buffer_read_u16(buf));
+	ldns_rr_set_ttl(*rr, ldns_buffer_read_u32(buf));
+	for (rd_count = ldns_buffer_read_u16(buf); rd_count > 0; rd_count--) {
+		if (!(rdf = ldns_rr_sorter_buffer_read_rdf(buf))) {
+			goto error;
+		}
+		if (!ldns_rr_push_rdf(*rr, rdf)) {
+			ldns_rdf_deep_free(rdf);
+			goto error;
+		}
+	}
+	return LDNS_STATUS_OK;
+error:
+	ldns_rr_free(*rr);
+	*rr = NULL;
+	return LDNS_STATUS_FILE_ERR;
+}
+
+/* Moves a source on to its next RR, and writes the sort key of that */
+static ldns_status
+ldns_rr_sorter_source_next(ldns_rr_sorter *sorter,
+		struct ldns_rr_sorter_source *src)
+{
+	ldns_status s;
+	uint8_t *key;
+	size_t len;
+
+	if (src->fp) {
+		if ((s = ldns_rr_sorter_read_rr(sorter, src->fp, &src->rr))) {
+			return s;
+		}
+	} else if (sorter->next < ldns_rr_list_rr_count(sorter->rrs)) {
+		src->rr = ldns_rr_list_set_rr(sorter->rrs, NULL, sorter->next);
+		sorter->next++;
+	} else {
+		src->rr = NULL;
+	}
+	if (!src->rr) {
+		return LDNS_STATUS_OK;
+	}
+	len = _ldns_rr_sort_key_write(NULL, src->rr);
+	if (len > src->key_size) {
+		key = LDNS_XREALLOC(src->key, uint8_t, len);
+		if (!key) {
+			return LDNS_STATUS_MEM_ERR;
+		}
+		src->key = key;
+		src->key_size = len;
+	}
+	src->key_len = _ldns_rr_sort_key_write(src->key, src->rr);
+	return LDNS_STATUS_OK;
+}
+
+/* Whether the current RR of source a sorts before that of source b. RRs
+ * that are equal come from the earlier source first, which keeps the sort
+ * stable, because the sources are in the order in which the RRs were added.
+ */
+static bool
+ldns_rr_sorter_before(const ldns_rr_sorter *sorter, size_t a, size_t b)
+{
+	const struct ldns_rr_sorter_source *sa = &sorter->sources[a];
+	const struct ldns_rr_sorter_source *sb = &sorter->sources[b];
+	int cmp;
+
+	cmp = memcmp(sa->key, sb->key,
+			sa->key_len < sb->key_len ? sa->key_len : sb->key_len);
+	if (cmp == 0) {
+		cmp = sa->key_len < sb->key_len ? -1
+		    : sa->key_len > sb->key_len ?  1 : 0;
+	}
+	return cmp < 0 || (cmp == 0 && a < b);
+}
+
+static void
+ldns_rr_sorter_sift_down(ldns_rr_sorter *sorter, size_t i)
+{
+	size_t *heap = sorter->heap;
+	size_t child, top = heap[i];
+
+	while ((child = 2 * i + 1) < sorter->heap_count) {
+		if (child + 1 < sorter->heap_count &&
+		    ldns_rr_sorter_before(sorter, heap[child + 1], heap[child])) {
+			child++;
+		}
+		if (!ldns_rr_sorter_before(sorter, heap[child], top)) {
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = top;
+}
+
+static void
+ldns_rr_sorter_merge_end(ldns_rr_sorter *sorter)
+{
+	size_t i;
+
+	for (i = 0; i < sorter->source_count; i++) {
+		ldns_rr_free(sorter->sources[i].rr);
+		LDNS_FREE(sorter->sources[i].key);
+	}
+	LDNS_FREE(sorter->sources);
+	LDNS_FREE(sorter->heap);
+	sorter->source_count = 0;
+	sorter->heap_count = 0;
+}
+
+/* Starts merging the runs, and the RRs in memory when with_memory is set */
+static ldns_status
+ldns_rr_sorter_merge_begin(ldns_rr_sorter *sorter, bool with_memory)
+{
+	size_t i, n = sorter->run_count + (with_memory ? 1 : 0);
+	ldns_status s;
+
+	sorter->sources = LDNS_CALLOC(struct ldns_rr_sorter_source, n);
+	sorter->heap = LDNS_XMALLOC(size_t, n);
+	if (!sorter->sources || !sorter->heap) {
+		ldns_rr_sorter_merge_end(sorter);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	sorter->source_count = n;
+	sorter->next = 0;
+	for (i = 0; i < n; i++) {
+		if (i < sorter->run_count) {
+			sorter->sources[i].fp = sorter->runs[i];
+			rewind(sorter->runs[i]);
+		}
+		if ((s = ldns_rr_sorter_source_next(sorter,
+						&sorter->sources[i]))) {
+			ldns_rr_sorter_merge_end(sorter);
+			return s;
+		}
+		if (sorter->sources[i].rr) {
+			sorter->heap[sorter->heap_count++] = i;
+		}
+	}
+	for (i = sorter->heap_count / 2; i > 0; i--) {
+		ldns_rr_sorter_sift_down(sorter, i - 1);
+	}
+	return LDNS_STATUS_OK;
+}
+
+static ldns_status
+ldns_rr_sorter_merge_next(ldns_rr_sorter *sorter, ldns_rr **rr)
+{
+	struct ldns_rr_sorter_source *src;
+	ldns_status s;
+
+	*rr = NULL;
+	if (sorter->heap_count == 0) {
+		return LDNS_STATUS_OK;
+	}
+	src = &sorter->sources[sorter->heap[0]];
+	*rr = src->rr;
+	src->rr = NULL;
+	if ((s = ldns_rr_sorter_source_next(sorter, src))) {
+		ldns_rr_free(*rr);
+		*rr = NULL;
+		return s;
+	}
+	if (!src->rr) {
+		sorter->heap[0] = sorter->heap[--sorter->heap_count];
+	}
+	if (sorter->heap_count > 0) {
+		ldns_rr_sorter_sift_down(sorter, 0);
+	}
+	return LDNS_STATUS_OK;
+}
+
+static void
+ldns_rr_sorter_close_runs(ldns_rr_sorter *sorter)
+{
+	size_t i;
+
+	for (i = 0; i < sorter->run_count; i++) {
+		fclose(sorter->runs[i]);
+	}
+	sorter->run_count = 0;
+}
+
+/* Merges all runs into one */
+static ldns_status
+ldns_rr_sorter_merge_runs(ldns_rr_sorter *sorter)
+{
+	FILE *fp;
+	ldns_rr *rr;
+	ldns_status s;
+
+	if (!(fp = ldns_rr_sorter_tmpfile(sorter))) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	if ((s = ldns_rr_sorter_merge_begin(sorter, false))) {
+		fclose(fp);
+		return s;
+	}
+	while ((s = ldns_rr_sorter_merge_next(sorter, &rr))
+			== LDNS_STATUS_OK && rr) {
+		s = ldns_rr_sorter_write_rr(sorter, fp, rr);
+		ldns_rr_free(rr);
+		if (s != LDNS_STATUS_OK) {
+			break;
+		}
+	}
+	ldns_rr_sorter_merge_end(sorter);
+	if (s != LDNS_STATUS_OK || fflush(fp) != 0) {
+		fclose(fp);
+		return s != LDNS_STATUS_OK ? s : LDNS_STATUS_FILE_ERR;
+	}
+	ldns_rr_sorter_close_runs(sorter);
+	sorter->runs[sorter->run_count++] = fp;
+	sorter->runs_written++;
+	return LDNS_STATUS_OK;
+}
+
+/* Sorts the RRs in memory and writes them to a new run */
+static ldns_status
+ldns_rr_sorter_spill(ldns_rr_sorter *sorter)
+{
+	FILE *fp;
+	size_t i;
+	ldns_status s = LDNS_STATUS_OK;
+
+	if (sorter->run_count == LDNS_RR_SORTER_MAX_RUNS &&
+	    (s = ldns_rr_sorter_merge_runs(sorter))) {
+		return s;
+	}
+	if (!(fp = ldns_rr_sorter_tmpfile(sorter))) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	ldns_rr_list_sort(sorter->rrs);
+	for (i = 0; i < ldns_rr_list_rr_count(sorter->rrs) && !s; i++) {
+		s = ldns_rr_sorter_write_rr(sorter, fp,
+				ldns_rr_list_rr(sorter->rrs, i));
+	}
+	if (s != LDNS_STATUS_OK || fflush(fp) != 0) {
+		fclose(fp);
+		return s != LDNS_STATUS_OK ? s : LDNS_STATUS_FILE_ERR;
+	}
+	sorter->runs[sorter->run_count++] = fp;
+	sorter->runs_written++;
+
+	for (i = 0; i < ldns_rr_list_rr_count(sorter->rrs); i++) {
+		ldns_rr_free(ldns_rr_list_rr(sorter->rrs, i));
+	}
+	ldns_rr_list_set_rr_count(sorter->rrs, 0);
+	sorter->memory = 0;
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_rr_sorter_add(ldns_rr_sorter *sorter, ldns_rr *rr)
+{
+	size_t memory;
+	ldns_status s;
+
+	if (!sorter || !rr) {
+		return LDNS_STATUS_NULL;
+	}
+	if (sorter->taking) {
+		return LDNS_STATUS_ERR;
+	}
+	memory = ldns_rr_sorter_rr_memory(rr);
+	if (sorter->max_memory &&
+	    sorter->memory + memory > sorter->max_memory &&
+	    ldns_rr_list_rr_count(sorter->rrs) > 0 &&
+	    (s = ldns_rr_sorter_spill(sorter))) {
+		return s;
+	}
+	if (!ldns_rr_list_push_rr(sorter->rrs, rr)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	sorter->memory += memory;
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_rr_sorter_next(ldns_rr_sorter *sorter, ldns_rr **rr)
+{
+	ldns_status s;
+
+	if (!sorter || !rr) {
+		return LDNS_STATUS_NULL;
+	}
+	*rr = NULL;
+	if (!sorter->taking) {
+		sorter->taking = true;
+		ldns_rr_list_sort(sorter->rrs);
+		if (sorter->run_count > 0 &&
+		    (s = ldns_rr_sorter_merge_begin(sorter, true))) {
+			return s;
+		}
+	}
+	if (sorter->run_count == 0) {
+		/* all in memory, nothing to merge */
+		if (sorter->next < ldns_rr_list_rr_count(sorter->rrs)) {
+			*rr = ldns_rr_list_set_rr(sorter->rrs, NULL,
+					sorter->next);
+			sorter->next++;
+		}
+		return LDNS_STATUS_OK;
+	}
+	return ldns_rr_sorter_merge_next(sorter, rr);
+}
+
+size_t
+ldns_rr_sorter_run_count(const ldns_rr_sorter *sorter)
+{
+	return sorter ? sorter->runs_written : 0;
+}
+
+void
+ldns_rr_sorter_free(ldns_rr_sorter *sorter)
+{
+	if (!sorter) {
+		return;
+	}
+	ldns_rr_sorter_merge_end(sorter);
+	ldns_rr_sorter_close_runs(sorter);
+	ldns_rr_list_deep_free(sorter->rrs);
+	ldns_buffer_free(sorter->buf);
+	free(sorter->tmpdir);
+	LDNS_FREE(sorter);
+}
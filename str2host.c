@@ -584,19 +584,20 @@ ldns_str2rdf_b64(ldns_rdf **rd, const char *str)
 {
 	uint8_t *buffer;
 	int16_t i;
+	size_t size;
 
 	if ((*str == '-' || *str == '0') && str[1] == '\0') {
 		*rd = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, 0, NULL);
 		return *rd ? LDNS_STATUS_OK : LDNS_STATUS_MEM_ERR;
 	}
 
-	buffer = LDNS_XMALLOC(uint8_t, ldns_b64_ntop_calculate_size(strlen(str)));
+	size = ldns_b64_ntop_calculate_size(strlen(str));
+	buffer = LDNS_XMALLOC(uint8_t, size);
         if(!buffer) {
                 return LDNS_STATUS_MEM_ERR;
         }
 
-	i = (uint16_t)ldns_b64_pton((const char*)str, buffer,
-						   ldns_b64_ntop_calculate_size(strlen(str)));
+	i = (uint16_t)ldns_b64_pton((const char*)str, buffer, size);
 	if (-1 == i) {
 		LDNS_FREE(buffer);
 		return LDNS_STATUS_INVALID_B64;
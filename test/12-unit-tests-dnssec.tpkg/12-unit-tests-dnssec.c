@@ -115,6 +115,156 @@ check_ldns_canonicalization(void)
 	return status;
 }
 
+/* nested delegations, glue below a cut, a DNAME, and a zone nested below
+ * a cut, with a delegation of its own and occluded names after it */
+static const char *zone_cuts_rrs[] = {
+	"cuts.test. 3600 IN SOA ns.cuts.test. hostmaster.cuts.test. "
+		"1 3600 900 604800 300",
+	"cuts.test. 3600 IN NS ns.cuts.test.",
+	"ns.cuts.test. 3600 IN A 192.0.2.53",
+	"deleg.cuts.test. 3600 IN NS ns.deleg.cuts.test.",
+	"ns.deleg.cuts.test. 3600 IN A 192.0.2.1",
+	"sub.deleg.cuts.test. 3600 IN NS ns.sub.deleg.cuts.test.",
+	"ns.sub.deleg.cuts.test. 3600 IN A 192.0.2.2",
+	"ns.sub.deleg.cuts.test. 3600 IN AAAA 2001:db8::2",
+	"txt.deleg.cuts.test. 3600 IN TXT \"occluded\"",
+	"p.cuts.test. 3600 IN NS ns.p.cuts.test.",
+	"ns.p.cuts.test. 3600 IN A 192.0.2.3",
+	"c.p.cuts.test. 3600 IN SOA ns.c.p.cuts.test. "
+		"hostmaster.c.p.cuts.test. 1 3600 900 604800 300",
+	"c.p.cuts.test. 3600 IN NS ns.c.p.cuts.test.",
+	"ns.c.p.cuts.test. 3600 IN A 192.0.2.4",
+	"d.c.p.cuts.test. 3600 IN NS ns.d.c.p.cuts.test.",
+	"ns.d.c.p.cuts.test. 3600 IN A 192.0.2.5",
+	"z.p.cuts.test. 3600 IN TXT \"occluded after the nested zone\"",
+	"zz.p.cuts.test. 3600 IN A 192.0.2.6",
+	"dn.cuts.test. 3600 IN DNAME example.",
+	"x.dn.cuts.test. 3600 IN A 192.0.2.7",
+	"after.cuts.test. 3600 IN TXT \"authoritative\"",
+	NULL
+};
+
+static const char *zone_cuts_occluded[] = {
+	"ns.deleg.cuts.test.", "sub.deleg.cuts.test.",
+	"ns.sub.deleg.cuts.test.", "txt.deleg.cuts.test.", "ns.p.cuts.test.",
+	"ns.d.c.p.cuts.test.", "z.p.cuts.test.", "zz.p.cuts.test.",
+	"x.dn.cuts.test.", NULL
+};
+
+/* the owners of the glue RRs: addresses at or below a delegation, but
+ * not below a DNAME, nor in the zone nested below p */
+static const char *zone_cuts_glue[] = {
+	"ns.deleg.cuts.test.", "ns.sub.deleg.cuts.test.",
+	"ns.sub.deleg.cuts.test.", "ns.p.cuts.test.", "ns.d.c.p.cuts.test.",
+	"zz.p.cuts.test.", NULL
+};
+
+static bool
+in_names(const ldns_rdf *name, const char **names)
+{
+	ldns_rdf *n;
+	bool found = false;
+
+	for (; *names && !found; names++) {
+		n = ldns_dname_new_frm_str(*names);
+		found = ldns_dname_compare(name, n) == 0;
+		ldns_rdf_deep_free(n);
+	}
+	return found;
+}
+
+/* Whether the glue RRs have the owners, in any order */
+static bool
+check_glue(const ldns_rr_list *glue, const char **owners, const char *what)
+{
+	size_t i, n = 0;
+	bool ok = true;
+
+	while (owners[n]) {
+		n++;
+	}
+	if (ldns_rr_list_rr_count(glue) != n) {
+		ok = false;
+	}
+	for (i = 0; ok && i < n; i++) {
+		ok = in_names(ldns_rr_owner(ldns_rr_list_rr(glue, i)), owners);
+	}
+	if (!ok) {
+		printf("%s gave the wrong glue:\n", what);
+		ldns_rr_list_print(stdout, glue);
+	}
+	return ok;
+}
+
+ldns_status
+check_ldns_zone_cuts(void)
+{
+	ldns_dnssec_zone *dnssec_zone = ldns_dnssec_zone_new();
+	ldns_zone *zone = ldns_zone_new();
+	ldns_rr_list *glue = ldns_rr_list_new();
+	ldns_rr_list *zone_glue;
+	/* ldns_zone_glue_rr_list() does not know about nested zones, so
+	 * for it the address of the nested zone is glue of c.p too */
+	const char *zone_glue_owners[sizeof(zone_cuts_glue) /
+	                             sizeof(*zone_cuts_glue) + 1];
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+	ldns_rr *rr;
+	ldns_status status = LDNS_STATUS_OK;
+	size_t i;
+
+	for (i = 0; zone_cuts_rrs[i]; i++) {
+		if (ldns_rr_new_frm_str(&rr, zone_cuts_rrs[i], 0, NULL, NULL)
+				!= LDNS_STATUS_OK) {
+			printf("Error constructing rr: %s\n", zone_cuts_rrs[i]);
+			return LDNS_STATUS_ERR;
+		}
+		if (i == 0) {
+			ldns_zone_set_soa(zone, rr);
+		} else {
+			(void) ldns_zone_push_rr(zone, rr);
+		}
+		(void) ldns_dnssec_zone_add_rr(dnssec_zone, ldns_rr_clone(rr));
+	}
+
+	if (ldns_dnssec_zone_mark_and_get_glue(dnssec_zone, glue)
+			!= LDNS_STATUS_OK) {
+		printf("ldns_dnssec_zone_mark_and_get_glue() failed\n");
+		status = LDNS_STATUS_ERR;
+	}
+	for (node = ldns_rbtree_first(dnssec_zone->names);
+			node != LDNS_RBTREE_NULL; node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		if (name->is_glue != in_names(name->name, zone_cuts_occluded)) {
+			ldns_rdf_print(stdout, name->name);
+			printf(" is %s, but should not be\n",
+				name->is_glue ? "occluded" : "authoritative");
+			status = LDNS_STATUS_ERR;
+		}
+	}
+	if (!check_glue(glue, zone_cuts_glue,
+			"ldns_dnssec_zone_mark_and_get_glue()")) {
+		status = LDNS_STATUS_ERR;
+	}
+
+	memcpy(zone_glue_owners, zone_cuts_glue, sizeof(zone_cuts_glue));
+	zone_glue_owners[sizeof(zone_cuts_glue) / sizeof(*zone_cuts_glue) - 1]
+		= "ns.c.p.cuts.test.";
+	zone_glue_owners[sizeof(zone_cuts_glue) / sizeof(*zone_cuts_glue)]
+		= NULL;
+	zone_glue = ldns_zone_glue_rr_list(zone);
+	if (!zone_glue || !check_glue(zone_glue, zone_glue_owners,
+			"ldns_zone_glue_rr_list()")) {
+		status = LDNS_STATUS_ERR;
+	}
+
+	ldns_rr_list_free(zone_glue);
+	ldns_rr_list_free(glue);
+	ldns_zone_deep_free(zone);
+	ldns_dnssec_zone_deep_free(dnssec_zone);
+	return status;
+}
+
 int main(void)
 {
 	int result = EXIT_SUCCESS;
@@ -129,5 +279,10 @@ int main(void)
 		result = EXIT_FAILURE;
 	}
 
+	if (check_ldns_zone_cuts() != LDNS_STATUS_OK) {
+		printf("finding zone cuts and glue failed.\n");
+		result = EXIT_FAILURE;
+	}
+
 	exit(result);
 }
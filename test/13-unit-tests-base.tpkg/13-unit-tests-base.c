@@ -344,6 +344,218 @@ test_base32_decode_extended_hex(const char *str, const uint8_t *expect_data, siz
 
 
 
+/* the results of decoding base64 with padding or whitespace, that is
+ * incomplete or in the wrong place, -1 for an error */
+static const struct {
+	const char *str;
+	int expect;
+} base64_cases[] = {
+	{ "Zg==", 1 }, { "Zg=", -1 }, { "Zg", -1 }, { "Z", -1 }, { "=", -1 },
+	{ "Zm8=", 2 }, { "Zm8", -1 }, { "Zm9v", 3 }, { "Zm9vYg==", 4 },
+	{ "Zm9vYmE=", 5 }, { "Zm9vYmFy", 6 }, { "Zm9vYmF", -1 },
+	{ "Zg==Zg==", -1 }, { "Zm9v====", -1 }, { "Zm8==", -1 },
+	{ "Zg== ", 1 }, { " Zg= =", 1 }, { "Zm 9v\n", 3 }, { "\tZ m 9 v ", 3 },
+	{ "Zm9vY mFy", 6 }, { "Zh==", -1 }, { "Zm9=", -1 }, { "Zm9v!", -1 },
+	{ "Zm9v-A==", -1 }, { "Zm9v_A==", -1 }, { "Zg==x", -1 }
+};
+
+int
+test_base64_cases(void)
+{
+	uint8_t data[16];
+	size_t i;
+	int r, result = 0;
+
+	for (i = 0; i < sizeof(base64_cases) / sizeof(*base64_cases); i++) {
+		r = ldns_b64_pton(base64_cases[i].str, data, sizeof(data));
+		if (r != base64_cases[i].expect) {
+			printf("Bad base64 decoding of \"%s\": got %d, "
+			       "expected %d\n", base64_cases[i].str,
+			       r, base64_cases[i].expect);
+			result = 1;
+		}
+	}
+	return result;
+}
+
+/* Encodes and decodes data of every length up to a few quanta, and
+ * decodes it with whitespace between the characters too */
+int
+test_base64_roundtrip(void)
+{
+	uint8_t data[70], decoded[70];
+	char text[200], spaced[400];
+	size_t len, i, j;
+	int r, result = 0;
+
+	for (len = 0; len < sizeof(data); len++) {
+		for (i = 0; i < len; i++) {
+			data[i] = (uint8_t) (len * 37 + i * 101);
+		}
+		r = ldns_b64_ntop(data, len, text, sizeof(text));
+		if (r < 0 || (size_t) r != (len + 2) / 3 * 4 ||
+		    (size_t) r + 1 > ldns_b64_ntop_calculate_size(len)) {
+			printf("Bad base64 encoding length %d for %d bytes\n",
+					r, (int) len);
+			result = 1;
+			continue;
+		}
+		r = ldns_b64_pton(text, decoded, sizeof(decoded));
+		if (r != (int) len || memcmp(data, decoded, len) != 0) {
+			printf("Bad base64 round trip of %d bytes: %s\n",
+					(int) len, text);
+			result = 1;
+		}
+		for (i = 0, j = 0; text[i]; i++) {
+			spaced[j++] = text[i];
+			if (i % 3 == 1) {
+				spaced[j++] = i % 2 ? ' ' : '\n';
+			}
+		}
+		spaced[j] = '\0';
+		r = ldns_b64_pton(spaced, decoded, sizeof(decoded));
+		if (r != (int) len || memcmp(data, decoded, len) != 0) {
+			printf("Bad base64 decoding with whitespace: %s\n",
+					spaced);
+			result = 1;
+		}
+		/* the last quantum cut short */
+		if (len > 0) {
+			text[strlen(text) - 1] = '\0';
+			if (ldns_b64_pton(text, decoded, sizeof(decoded))
+					!= -1) {
+				printf("Base64 with a short last quantum "
+				       "decoded: %s\n", text);
+				result = 1;
+			}
+		}
+	}
+	return result;
+}
+
+int
+test_base32_roundtrip(void)
+{
+	uint8_t data[70], decoded[70];
+	char text[200];
+	size_t len, i;
+	int r, result = 0;
+
+	for (len = 0; len < sizeof(data); len++) {
+		for (i = 0; i < len; i++) {
+			data[i] = (uint8_t) (len * 53 + i * 97);
+		}
+		r = ldns_b32_ntop_extended_hex(data, len, text, sizeof(text));
+		if (r < 0 || (size_t) r != (len + 4) / 5 * 8) {
+			printf("Bad base32hex encoding length %d for %d "
+			       "bytes\n", r, (int) len);
+			result = 1;
+			continue;
+		}
+		r = ldns_b32_pton_extended_hex(text, strlen(text),
+				decoded, sizeof(decoded));
+		if (r != (int) len || memcmp(data, decoded, len) != 0) {
+			printf("Bad base32hex round trip of %d bytes: %s\n",
+					(int) len, text);
+			result = 1;
+		}
+	}
+	return result;
+}
+
+/* Reads and prints RDATA fields as text, which must give the same text
+ * and data again */
+int
+test_rdf_str(ldns_rdf_type type, const char *str, const char *expect_str)
+{
+	ldns_rdf *rdf, *again = NULL;
+	char *printed;
+	int result = 0;
+
+	if (!(rdf = ldns_rdf_new_frm_str(type, str))) {
+		if (expect_str) {
+			printf("Could not read \"%s\"\n", str);
+			return 1;
+		}
+		return 0;
+	} else if (!expect_str) {
+		printf("Read \"%s\", which is not valid\n", str);
+		ldns_rdf_deep_free(rdf);
+		return 1;
+	}
+	printed = ldns_rdf2str(rdf);
+	if (!printed || strcmp(printed, expect_str) != 0) {
+		printf("Read \"%s\" and printed \"%s\", expected \"%s\"\n",
+				str, printed ? printed : "(null)", expect_str);
+		result = 1;
+	} else if (!(again = ldns_rdf_new_frm_str(type, printed)) ||
+	    ldns_rdf_compare(rdf, again) != 0) {
+		printf("Reading \"%s\" back gave other data\n", printed);
+		result = 1;
+	}
+	free(printed);
+	ldns_rdf_deep_free(rdf);
+	ldns_rdf_deep_free(again);
+	return result;
+}
+
+int
+test_hex(void)
+{
+	uint8_t data[64];
+	char text[2 * sizeof(data) + 1];
+	ldns_rdf *rdf;
+	char *printed;
+	size_t len, i;
+	int result = 0;
+
+	result |= test_rdf_str(LDNS_RDF_TYPE_HEX, "00", "00");
+	result |= test_rdf_str(LDNS_RDF_TYPE_HEX, "0aFf", "0aff");
+	result |= test_rdf_str(LDNS_RDF_TYPE_HEX, "0a ff\t7C", "0aff7c");
+	result |= test_rdf_str(LDNS_RDF_TYPE_HEX, "0g", NULL);
+	if (ldns_hexstring_to_data(data, "abc") != -2 ||
+	    ldns_hexstring_to_data(data, "AbcD") != 2 ||
+	    data[0] != 0xab || data[1] != 0xcd ||
+	    ldns_hexstring_to_data(data, "") != 0) {
+		printf("Bad ldns_hexstring_to_data() results\n");
+		result = 1;
+	}
+	for (len = 1; len < sizeof(data); len++) {
+		for (i = 0; i < len; i++) {
+			data[i] = (uint8_t) (len * 29 + i * 83);
+			snprintf(text + 2 * i, 3, "%02x", data[i]);
+		}
+		rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_HEX, len, data);
+		printed = ldns_rdf2str(rdf);
+		if (!printed || strcmp(printed, text) != 0) {
+			printf("Printed %d bytes as \"%s\", expected \"%s\"\n",
+					(int) len, printed ? printed : "(null)",
+					text);
+			result = 1;
+		}
+		result |= test_rdf_str(LDNS_RDF_TYPE_HEX, text, text);
+		free(printed);
+		ldns_rdf_deep_free(rdf);
+	}
+	return result;
+}
+
+int
+test_rdf_codecs(void)
+{
+	int result = 0;
+
+	result |= test_rdf_str(LDNS_RDF_TYPE_B64, "Zm9vYg==", "Zm9vYg==");
+	result |= test_rdf_str(LDNS_RDF_TYPE_B64, "Zm9v Ymfy", "Zm9vYmfy");
+	result |= test_rdf_str(LDNS_RDF_TYPE_B64, "-", "0");
+	result |= test_rdf_str(LDNS_RDF_TYPE_B64, "Zm9vY", NULL);
+	result |= test_rdf_str(LDNS_RDF_TYPE_B32_EXT,
+			"46CHVG6V0B8TBDMGV3QFVVHOVSFATI1Q",
+			"46chvg6v0b8tbdmgv3qfvvhovsfati1q");
+	result |= test_rdf_str(LDNS_RDF_TYPE_B32_EXT, "cpnmuog", NULL);
+	return result;
+}
+
 int
 test_sha1(const void *data, const void *expect_result_str)
 {
@@ -874,6 +1086,22 @@ main(void)
 	}
 	free(data);
 
+	if (test_base64_cases() != 0) {
+		result = EXIT_FAILURE;
+	}
+	if (test_base64_roundtrip() != 0) {
+		result = EXIT_FAILURE;
+	}
+	if (test_base32_roundtrip() != 0) {
+		result = EXIT_FAILURE;
+	}
+	if (test_hex() != 0) {
+		result = EXIT_FAILURE;
+	}
+	if (test_rdf_codecs() != 0) {
+		result = EXIT_FAILURE;
+	}
+
 	if (test_duration())
 		result = EXIT_FAILURE;
 
@@ -0,0 +1,848 @@
+/*
+ * Unit tests for ldns_cache
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+static ldns_pkt *
+make_query(const char *name)
+{
+	ldns_pkt *query = NULL;
+
+	if (ldns_pkt_query_new_frm_str(&query, name, LDNS_RR_TYPE_A,
+			LDNS_RR_CLASS_IN, LDNS_RD) != LDNS_STATUS_OK) {
+		return NULL;
+	}
+	return query;
+}
+
+static ldns_pkt *
+make_answer(const char *name, uint32_t ttl)
+{
+	ldns_pkt *answer = ldns_pkt_new();
+	ldns_rr *rr = NULL;
+	char str[256];
+
+	if (!answer) {
+		return NULL;
+	}
+	snprintf(str, sizeof(str), "%s %u IN A 192.0.2.1", name,
+			(unsigned int) ttl);
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		ldns_pkt_free(answer);
+		return NULL;
+	}
+	ldns_pkt_set_qr(answer, true);
+	ldns_pkt_set_rd(answer, true);
+	ldns_pkt_set_ra(answer, true);
+	(void) ldns_pkt_push_rr(answer, LDNS_SECTION_ANSWER, rr);
+	return answer;
+}
+
+static bool
+store(ldns_cache *cache, const char *name, uint32_t ttl)
+{
+	ldns_pkt *query = make_query(name);
+	ldns_pkt *answer = make_answer(name, ttl);
+	bool r = query && answer;
+
+	if (r) {
+		ldns_cache_store(cache, query, answer);
+	}
+	ldns_pkt_free(query);
+	ldns_pkt_free(answer);
+	return r;
+}
+
+/* The TTL of the answer in the cache, or -1 when there is none */
+static long
+lookup(ldns_cache *cache, const char *name)
+{
+	ldns_pkt *query = make_query(name);
+	ldns_pkt *answer;
+	long ttl = -1;
+
+	if (!query) {
+		return -1;
+	}
+	answer = ldns_cache_lookup(cache, query);
+	if (answer && ldns_pkt_ancount(answer) == 1) {
+		ttl = (long) ldns_rr_ttl(
+				ldns_rr_list_rr(ldns_pkt_answer(answer), 0));
+	}
+	ldns_pkt_free(answer);
+	ldns_pkt_free(query);
+	return ttl;
+}
+
+/* A nameserver in a child process that answers from a zone. It writes a
+ * byte to a pipe for every query, so that the queries can be counted.
+ */
+struct server {
+	pid_t pid;
+	uint16_t port;
+	int counter;
+	size_t queries;
+};
+
+/* The rrset of the question, or a NODATA or NXDOMAIN answer with the SOA,
+ * all with their RRSIGs */
+static ldns_pkt *
+answer_query(const ldns_pkt *query, const ldns_rr_list *zone)
+{
+	ldns_rr *q = ldns_rr_list_rr(ldns_pkt_question(query), 0);
+	ldns_pkt *answer = ldns_pkt_new();
+	ldns_rr *rr;
+	ldns_rr_type type;
+	bool exists = false;
+	size_t i;
+
+	if (!answer || !q) {
+		return answer;
+	}
+	ldns_pkt_set_id(answer, ldns_pkt_id(query));
+	ldns_pkt_set_qr(answer, true);
+	ldns_pkt_set_aa(answer, true);
+	ldns_pkt_set_rd(answer, ldns_pkt_rd(query));
+	(void) ldns_pkt_push_rr(answer, LDNS_SECTION_QUESTION, ldns_rr_clone(q));
+	if (ldns_pkt_edns(query)) {
+		ldns_pkt_set_edns_udp_size(answer, 4096);
+		ldns_pkt_set_edns_do(answer, ldns_pkt_edns_do(query));
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(zone); i++) {
+		rr = ldns_rr_list_rr(zone, i);
+		if (ldns_dname_compare(ldns_rr_owner(rr), ldns_rr_owner(q))) {
+			continue;
+		}
+		exists = true;
+		type = ldns_rr_get_type(rr) == LDNS_RR_TYPE_RRSIG
+		     ? ldns_rdf2rr_type(ldns_rr_rrsig_typecovered(rr))
+		     : ldns_rr_get_type(rr);
+		if (type == ldns_rr_get_type(q)) {
+			(void) ldns_pkt_push_rr(answer, LDNS_SECTION_ANSWER,
+					ldns_rr_clone(rr));
+		}
+	}
+	if (ldns_pkt_ancount(answer) > 0) {
+		return answer;
+	}
+	if (!exists) {
+		ldns_pkt_set_rcode(answer, LDNS_RCODE_NXDOMAIN);
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(zone); i++) {
+		rr = ldns_rr_list_rr(zone, i);
+		type = ldns_rr_get_type(rr) == LDNS_RR_TYPE_RRSIG
+		     ? ldns_rdf2rr_type(ldns_rr_rrsig_typecovered(rr))
+		     : ldns_rr_get_type(rr);
+		if (type == LDNS_RR_TYPE_SOA) {
+			(void) ldns_pkt_push_rr(answer, LDNS_SECTION_AUTHORITY,
+					ldns_rr_clone(rr));
+		}
+	}
+	return answer;
+}
+
+static void
+serve(int sock, int counter, const ldns_rr_list *zone)
+{
+	struct sockaddr_storage from;
+	socklen_t from_len;
+	uint8_t wire[LDNS_MAX_PACKETLEN];
+	uint8_t *reply;
+	size_t reply_size;
+	ldns_pkt *query, *answer;
+	ssize_t n;
+
+	for (;;) {
+		from_len = sizeof(from);
+		n = recvfrom(sock, wire, sizeof(wire), 0,
+				(struct sockaddr *) &from, &from_len);
+		if (n < 0) {
+			continue;
+		}
+		if (write(counter, "q", 1) != 1 ||
+		    ldns_wire2pkt(&query, wire, (size_t) n) != LDNS_STATUS_OK) {
+			continue;
+		}
+		answer = answer_query(query, zone);
+		if (answer && ldns_pkt2wire(&reply, answer, &reply_size)
+				== LDNS_STATUS_OK) {
+			(void) sendto(sock, reply, reply_size, 0,
+					(struct sockaddr *) &from, from_len);
+			LDNS_FREE(reply);
+		}
+		ldns_pkt_free(answer);
+		ldns_pkt_free(query);
+	}
+}
+
+static bool
+server_start(struct server *server, const ldns_rr_list *zone)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int sock, fds[2];
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((sock = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+		return false;
+	}
+	if (bind(sock, (struct sockaddr *) &addr, addr_len) == -1 ||
+	    getsockname(sock, (struct sockaddr *) &addr, &addr_len) == -1 ||
+	    pipe(fds) == -1) {
+		close(sock);
+		return false;
+	}
+	server->port = ntohs(addr.sin_port);
+	server->queries = 0;
+	if ((server->pid = fork()) == -1) {
+		close(sock);
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (server->pid == 0) {
+		close(fds[0]);
+		serve(sock, fds[1], zone);
+		_exit(0);
+	}
+	close(sock);
+	close(fds[1]);
+	(void) fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	server->counter = fds[0];
+	return true;
+}
+
+/* The number of queries the server received up to now */
+static size_t
+server_queries(struct server *server)
+{
+	char buf[64];
+	ssize_t n;
+
+	while ((n = read(server->counter, buf, sizeof(buf))) > 0) {
+		server->queries += (size_t) n;
+	}
+	return server->queries;
+}
+
+static void
+server_stop(struct server *server)
+{
+	(void) kill(server->pid, SIGTERM);
+	(void) waitpid(server->pid, NULL, 0);
+	close(server->counter);
+}
+
+/* A resolver for the server, with the given nameservers */
+static ldns_resolver *
+server_resolver(const struct server *server, const char *ns1, const char *ns2)
+{
+	ldns_resolver *res = ldns_resolver_new();
+	ldns_rdf *ns;
+
+	if (!res) {
+		return NULL;
+	}
+	ldns_resolver_set_port(res, server->port);
+	ldns_resolver_set_random(res, false);
+	ldns_resolver_set_retry(res, 1);
+	ldns_resolver_set_recursive(res, true);
+	if ((ns = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, ns1))) {
+		(void) ldns_resolver_push_nameserver(res, ns);
+		ldns_rdf_deep_free(ns);
+	}
+	if (ns2 && (ns = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, ns2))) {
+		(void) ldns_resolver_push_nameserver(res, ns);
+		ldns_rdf_deep_free(ns);
+	}
+	return res;
+}
+
+static int
+test_aging(void)
+{
+	ldns_cache *cache = ldns_cache_new(0);
+	long ttl;
+	int r = 0;
+
+	if (!cache) {
+		printf("ldns_cache_new() returned NULL\n");
+		return 0;
+	}
+	if (!store(cache, "aged.example.", 100) ||
+	    !store(cache, "expires.example.", 1)) {
+		printf("Could not make the packets\n");
+
+	} else if ((ttl = lookup(cache, "aged.example.")) < 99 || ttl > 100) {
+		printf("TTL of a fresh answer is %ld instead of 100\n", ttl);
+
+	} else if ((ttl = lookup(cache, "expires.example.")) < 0) {
+		printf("Answer with TTL 1 is not in the cache\n");
+
+	} else if (lookup(cache, "other.example.") != -1) {
+		printf("Answer found for a name that was not stored\n");
+
+	} else if (sleep(3), (ttl = lookup(cache, "aged.example.")) > 97
+			|| ttl < 90) {
+		printf("TTL of an answer stored 3 seconds ago is %ld "
+		       "instead of 97\n", ttl);
+
+	} else if (lookup(cache, "expires.example.") != -1) {
+		printf("Answer with TTL 1 did not expire\n");
+
+	} else {
+		r = 1;
+	}
+	ldns_cache_free(cache);
+	return r;
+}
+
+static int
+test_eviction(void)
+{
+	ldns_cache *cache = ldns_cache_new(0);
+	size_t entry_size, max_size;
+	int r = 0;
+
+	if (!cache || !store(cache, "n0.example.", 3600)) {
+		printf("Could not make the cache\n");
+		ldns_cache_free(cache);
+		return 0;
+	}
+	/* every answer takes the same space, make room for three */
+	entry_size = ldns_cache_size(cache);
+	ldns_cache_free(cache);
+	max_size = 3 * entry_size + entry_size / 2;
+	if (!(cache = ldns_cache_new(max_size))) {
+		printf("ldns_cache_new() returned NULL\n");
+		return 0;
+	}
+	if (!store(cache, "n0.example.", 3600) ||
+	    !store(cache, "n1.example.", 3600) ||
+	    !store(cache, "n2.example.", 3600)) {
+		printf("Could not make the packets\n");
+
+	} else if (ldns_cache_size(cache) != 3 * entry_size) {
+		printf("Cache size is %u instead of %u\n",
+		       (unsigned int) ldns_cache_size(cache),
+		       (unsigned int) (3 * entry_size));
+
+	/* use n0, so that n1 is the least recently used */
+	} else if (lookup(cache, "n0.example.") < 0) {
+		printf("n0 is not in the cache\n");
+
+	} else if (!store(cache, "n3.example.", 3600)) {
+		printf("Could not make the packets\n");
+
+	} else if (ldns_cache_size(cache) > max_size) {
+		printf("Cache size %u is over its maximum %u\n",
+		       (unsigned int) ldns_cache_size(cache),
+		       (unsigned int) max_size);
+
+	} else if (lookup(cache, "n1.example.") != -1) {
+		printf("The least recently used n1 was not evicted\n");
+
+	} else if (lookup(cache, "n0.example.") < 0 ||
+	           lookup(cache, "n2.example.") < 0 ||
+	           lookup(cache, "n3.example.") < 0) {
+		printf("A recently used answer was evicted\n");
+
+	/* replacing an answer does not take more space */
+	} else if (!store(cache, "n2.example.", 60) ||
+	           ldns_cache_size(cache) != 3 * entry_size ||
+	           lookup(cache, "n2.example.") > 60 ||
+	           lookup(cache, "n3.example.") < 0) {
+		printf("Replacing an answer did not work\n");
+
+	} else {
+		ldns_cache_clear(cache);
+		if (ldns_cache_size(cache) != 0 ||
+		    lookup(cache, "n0.example.") != -1) {
+			printf("ldns_cache_clear() left answers\n");
+		} else {
+			r = 1;
+		}
+	}
+	ldns_cache_free(cache);
+	return r;
+}
+
+/* A negative answer, with the SOA when soa is true */
+static ldns_pkt *
+make_negative(const char *name, ldns_pkt_rcode rcode, bool soa)
+{
+	ldns_pkt *answer = ldns_pkt_new();
+	ldns_rr *rr = NULL;
+
+	if (!answer) {
+		return NULL;
+	}
+	ldns_pkt_set_qr(answer, true);
+	ldns_pkt_set_rd(answer, true);
+	ldns_pkt_set_ra(answer, true);
+	ldns_pkt_set_rcode(answer, rcode);
+	if (ldns_rr_new_frm_str(&rr, name, 0, NULL, NULL) == LDNS_STATUS_OK) {
+		ldns_rr_set_question(rr, true);
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_QUESTION, rr);
+	}
+	if (soa && ldns_rr_new_frm_str(&rr, "example. 3600 IN SOA "
+			"ns.example. hostmaster.example. 1 3600 900 604800 30",
+			0, NULL, NULL) == LDNS_STATUS_OK) {
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_AUTHORITY, rr);
+	}
+	return answer;
+}
+
+/* The TTL a negative answer for name is cached with, 0 when it is not */
+static uint32_t
+negative_ttl(ldns_cache *cache, const char *name, ldns_pkt_rcode rcode,
+		bool soa)
+{
+	ldns_pkt *query = make_query(name);
+	ldns_pkt *answer = make_negative(name, rcode, soa);
+	ldns_pkt *cached = NULL;
+	uint32_t ttl = 0;
+
+	if (query && answer) {
+		ldns_cache_store(cache, query, answer);
+		cached = ldns_cache_lookup(cache, query);
+	}
+	if (cached && ldns_pkt_get_rcode(cached) == rcode &&
+	    ldns_pkt_nscount(cached) == 1) {
+		ttl = ldns_pkt_cache_ttl(cached);
+	}
+	ldns_pkt_free(cached);
+	ldns_pkt_free(answer);
+	ldns_pkt_free(query);
+	return ttl;
+}
+
+static int
+test_negative(void)
+{
+	ldns_cache *cache = ldns_cache_new(0);
+	uint32_t ttl;
+	int r = 0;
+
+	if (!cache) {
+		printf("ldns_cache_new() returned NULL\n");
+		return 0;
+
+	/* for as long as the SOA minimum allows */
+	} else if ((ttl = negative_ttl(cache, "nx.example.",
+			LDNS_RCODE_NXDOMAIN, true)) < 29 || ttl > 30) {
+		printf("NXDOMAIN is cached for %u seconds instead of 30\n",
+		       (unsigned int) ttl);
+
+	} else if ((ttl = negative_ttl(cache, "nodata.example.",
+			LDNS_RCODE_NOERROR, true)) < 29 || ttl > 30) {
+		printf("NODATA is cached for %u seconds instead of 30\n",
+		       (unsigned int) ttl);
+
+	/* and not at all without the SOA, or for failures */
+	} else if (negative_ttl(cache, "nosoa.example.",
+			LDNS_RCODE_NXDOMAIN, false) != 0 ||
+	           negative_ttl(cache, "referral.example.",
+			LDNS_RCODE_NOERROR, false) != 0) {
+		printf("A negative answer without SOA is cached\n");
+
+	} else if (negative_ttl(cache, "servfail.example.",
+			LDNS_RCODE_SERVFAIL, true) != 0 ||
+	           negative_ttl(cache, "refused.example.",
+			LDNS_RCODE_REFUSED, true) != 0) {
+		printf("A failure is cached\n");
+
+	} else {
+		r = 1;
+	}
+	ldns_cache_free(cache);
+	return r;
+}
+
+/* Queries the name with the resolver, and returns the number of queries
+ * the server received for it, or -1 when the answer has not the rcode */
+static long
+resolve(ldns_resolver *res, struct server *server, const char *name,
+		ldns_rr_type type, ldns_pkt_rcode rcode)
+{
+	ldns_rdf *dname = ldns_dname_new_frm_str(name);
+	ldns_pkt *answer = NULL;
+	size_t n = server_queries(server);
+	long r = -1;
+
+	if (dname && ldns_resolver_send(&answer, res, dname, type,
+			LDNS_RR_CLASS_IN, LDNS_RD) == LDNS_STATUS_OK &&
+	    answer && ldns_pkt_get_rcode(answer) == rcode) {
+		r = (long) (server_queries(server) - n);
+	}
+	ldns_pkt_free(answer);
+	ldns_rdf_deep_free(dname);
+	return r;
+}
+
+static int
+test_resolver(void)
+{
+	static const char *rrs[] = {
+		"example. 3600 IN SOA ns.example. hostmaster.example. "
+			"1 3600 900 604800 60",
+		"www.example. 3600 IN A 192.0.2.1"
+	};
+	ldns_rr_list *zone = ldns_rr_list_new();
+	ldns_cache *cache = ldns_cache_new(0);
+	ldns_resolver *res = NULL, *other_port = NULL, *other_ns = NULL;
+	struct server server, server2;
+	ldns_rr *rr;
+	size_t i;
+	int r = 0;
+
+	for (i = 0; zone && i < sizeof(rrs) / sizeof(rrs[0]); i++) {
+		rr = NULL;
+		(void) ldns_rr_new_frm_str(&rr, rrs[i], 0, NULL, NULL);
+		(void) ldns_rr_list_push_rr(zone, rr);
+	}
+	if (!zone || !cache || !server_start(&server, zone)) {
+		printf("Could not start the server\n");
+		ldns_rr_list_deep_free(zone);
+		ldns_cache_free(cache);
+		return 0;
+	}
+	if (!server_start(&server2, zone)) {
+		printf("Could not start the second server\n");
+		server_stop(&server);
+		ldns_rr_list_deep_free(zone);
+		ldns_cache_free(cache);
+		return 0;
+	}
+	res = server_resolver(&server, "127.0.0.1", NULL);
+	other_port = server_resolver(&server2, "127.0.0.1", NULL);
+	other_ns = server_resolver(&server, "127.0.0.1", "192.0.2.1");
+	if (!res || !other_port || !other_ns) {
+		printf("Could not make the resolvers\n");
+	} else {
+		ldns_resolver_set_cache(res, cache);
+		ldns_resolver_set_cache(other_port, cache);
+		ldns_resolver_set_cache(other_ns, cache);
+	}
+
+	if (!res || !other_port || !other_ns) {
+		;
+	} else if (resolve(res, &server, "www.example.", LDNS_RR_TYPE_A,
+			LDNS_RCODE_NOERROR) != 1 ||
+	           resolve(res, &server, "www.example.", LDNS_RR_TYPE_A,
+			LDNS_RCODE_NOERROR) != 0) {
+		printf("An answer was not cached by the resolver\n");
+
+	} else if (resolve(res, &server, "nx.example.", LDNS_RR_TYPE_A,
+			LDNS_RCODE_NXDOMAIN) != 1 ||
+	           resolve(res, &server, "nx.example.", LDNS_RR_TYPE_A,
+			LDNS_RCODE_NXDOMAIN) != 0) {
+		printf("NXDOMAIN was not cached by the resolver\n");
+
+	} else if (resolve(res, &server, "www.example.", LDNS_RR_TYPE_AAAA,
+			LDNS_RCODE_NOERROR) != 1 ||
+	           resolve(res, &server, "www.example.", LDNS_RR_TYPE_AAAA,
+			LDNS_RCODE_NOERROR) != 0) {
+		printf("NODATA was not cached by the resolver\n");
+
+	/* resolvers that ask elsewhere do not get these answers */
+	} else if (resolve(other_port, &server2, "www.example.",
+			LDNS_RR_TYPE_A, LDNS_RCODE_NOERROR) != 1) {
+		printf("A resolver for another port used the cache\n");
+
+	} else if (resolve(other_ns, &server, "www.example.",
+			LDNS_RR_TYPE_A, LDNS_RCODE_NOERROR) != 1) {
+		printf("A resolver with other nameservers used the cache\n");
+
+	/* the order of the nameservers does not matter */
+	} else if (ldns_resolver_nameservers_randomize(other_ns),
+	           ldns_resolver_set_random(other_ns, true),
+	           resolve(other_ns, &server, "www.example.",
+			LDNS_RR_TYPE_A, LDNS_RCODE_NOERROR) != 0) {
+		printf("Reordered nameservers did not use the cache\n");
+
+	/* and a resolver without cache always asks */
+	} else if (ldns_resolver_set_cache(res, NULL),
+	           resolve(res, &server, "www.example.", LDNS_RR_TYPE_A,
+			LDNS_RCODE_NOERROR) != 1) {
+		printf("A resolver without cache did not ask\n");
+
+	} else {
+		r = 1;
+	}
+	ldns_resolver_deep_free(res);
+	ldns_resolver_deep_free(other_port);
+	ldns_resolver_deep_free(other_ns);
+	server_stop(&server);
+	server_stop(&server2);
+	ldns_cache_free(cache);
+	ldns_rr_list_deep_free(zone);
+	return r;
+}
+
+#ifdef HAVE_SSL
+/* A signed example. zone, its RRs all with the given TTL */
+static ldns_rr_list *
+make_signed_zone(uint32_t ttl, ldns_rr_list *trusted)
+{
+	static const char *rrs[] = {
+		"example. IN SOA ns.example. hostmaster.example. 1 3600 900 "
+			"604800 3600",
+		"www.example. IN A 192.0.2.1"
+	};
+	ldns_rr_list *zone = ldns_rr_list_new();
+	ldns_rr_list *rrset, *sigs;
+	ldns_key_list *keys = ldns_key_list_new();
+	ldns_key *key;
+	ldns_rr *rr;
+	size_t i;
+
+#ifdef USE_ECDSA
+	key = ldns_key_new_frm_algorithm(LDNS_SIGN_ECDSAP384SHA384, 384);
+#else
+	key = ldns_key_new_frm_algorithm(LDNS_SIGN_RSASHA256, 2048);
+#endif
+	if (!zone || !keys || !key) {
+		ldns_rr_list_deep_free(zone);
+		ldns_key_list_free(keys);
+		ldns_key_deep_free(key);
+		return NULL;
+	}
+	ldns_key_set_pubkey_owner(key, ldns_dname_new_frm_str("example."));
+	ldns_key_set_flags(key, LDNS_KEY_ZONE_KEY | LDNS_KEY_SEP_KEY);
+	ldns_key_set_inception(key, (uint32_t) time(NULL) - 3600);
+	ldns_key_set_expiration(key, (uint32_t) time(NULL) + 86400);
+	ldns_key_list_push_key(keys, key);
+
+	rr = ldns_key2rr(key);
+	ldns_rr_set_ttl(rr, ttl);
+	ldns_key_set_keytag(key, ldns_calc_keytag(rr));
+	(void) ldns_rr_list_push_rr(trusted, ldns_rr_clone(rr));
+	(void) ldns_rr_list_push_rr(zone, rr);
+	for (i = 0; i < sizeof(rrs) / sizeof(rrs[0]); i++) {
+		rr = NULL;
+		(void) ldns_rr_new_frm_str(&rr, rrs[i], ttl, NULL, NULL);
+		(void) ldns_rr_list_push_rr(zone, rr);
+	}
+	/* every RR is an rrset of its own */
+	for (i = 0, rrset = ldns_rr_list_new();
+	     i < 1 + sizeof(rrs) / sizeof(rrs[0]); i++) {
+		(void) ldns_rr_list_push_rr(rrset, ldns_rr_list_rr(zone, i));
+		sigs = ldns_sign_public(rrset, keys);
+		(void) ldns_rr_list_cat(zone, sigs);
+		ldns_rr_list_free(sigs);
+		(void) ldns_rr_list_pop_rr(rrset);
+	}
+	ldns_rr_list_free(rrset);
+	ldns_key_list_free(keys);
+	return zone;
+}
+
+/* Builds the chain of trust for the answer and checks whether it leads
+ * to a trusted key at check_time */
+static bool
+chase(ldns_resolver *res, ldns_dnssec_cache *cache, const ldns_pkt *answer,
+		const ldns_rr_list *trusted, time_t check_time)
+{
+	ldns_rdf *name = ldns_rr_owner(
+			ldns_rr_list_rr(ldns_pkt_question(answer), 0));
+	ldns_rr_list *rrset;
+	ldns_dnssec_data_chain *chain;
+	ldns_dnssec_trust_tree *tree;
+	bool r;
+
+	rrset = ldns_pkt_rr_list_by_name_and_type(answer, name,
+			LDNS_RR_TYPE_A, LDNS_SECTION_ANSWER);
+	chain = ldns_dnssec_build_data_chain_cache(res, cache, LDNS_RD,
+			rrset, answer, NULL);
+	tree = ldns_dnssec_derive_trust_tree_cache(chain, NULL, check_time,
+			cache);
+	r = ldns_dnssec_trust_tree_contains_keys(tree,
+			(ldns_rr_list *) trusted) == LDNS_STATUS_OK;
+	ldns_dnssec_trust_tree_free(tree);
+	ldns_dnssec_data_chain_deep_free(chain);
+	ldns_rr_list_deep_free(rrset);
+	return r;
+}
+
+/* CPU time for deriving the trust tree of the chain many times */
+static double
+derive_time(ldns_dnssec_data_chain *chain, ldns_dnssec_cache *cache)
+{
+	ldns_dnssec_trust_tree *tree;
+	clock_t start = clock();
+	int i;
+
+	for (i = 0; i < 200; i++) {
+		tree = ldns_dnssec_derive_trust_tree_cache(chain, NULL,
+				time(NULL), cache);
+		ldns_dnssec_trust_tree_free(tree);
+	}
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static int
+test_dnssec_cache(void)
+{
+	ldns_rr_list *trusted = ldns_rr_list_new();
+	ldns_rr_list *zone = make_signed_zone(5, trusted);
+	ldns_dnssec_cache *cache = ldns_dnssec_cache_new(0);
+	ldns_resolver *res = NULL, *other_port = NULL;
+	ldns_resolver *other_ns = NULL, *no_do = NULL;
+	ldns_pkt *answer = NULL;
+	ldns_rr_list *rrset = NULL;
+	ldns_dnssec_data_chain *chain = NULL;
+	struct server server, server2;
+	double uncached, cached;
+	size_t n;
+	int r = 0;
+
+	if (!zone || !cache || !server_start(&server, zone)) {
+		printf("Could not set up the signed zone\n");
+		ldns_rr_list_deep_free(trusted);
+		ldns_rr_list_deep_free(zone);
+		ldns_dnssec_cache_free(cache);
+		return 0;
+	}
+	if (!server_start(&server2, zone)) {
+		printf("Could not start the second server\n");
+		server_stop(&server);
+		ldns_rr_list_deep_free(trusted);
+		ldns_rr_list_deep_free(zone);
+		ldns_dnssec_cache_free(cache);
+		return 0;
+	}
+	res = server_resolver(&server, "127.0.0.1", NULL);
+	other_port = server_resolver(&server2, "127.0.0.1", NULL);
+	other_ns = server_resolver(&server, "127.0.0.1", "192.0.2.1");
+	no_do = server_resolver(&server, "127.0.0.1", NULL);
+	if (res) {
+		ldns_resolver_set_dnssec(res, true);
+		answer = ldns_resolver_query(res,
+				ldns_rr_owner(ldns_rr_list_rr(zone, 2)),
+				LDNS_RR_TYPE_A, LDNS_RR_CLASS_IN, LDNS_RD);
+	}
+	if (other_port && other_ns) {
+		ldns_resolver_set_dnssec(other_port, true);
+		ldns_resolver_set_dnssec(other_ns, true);
+	}
+	n = server_queries(&server);
+
+	if (!answer || !other_port || !other_ns || !no_do) {
+		printf("Could not query the signed zone\n");
+
+	} else if (!chase(res, cache, answer, trusted, time(NULL))) {
+		printf("The answer does not chase to the trusted key\n");
+
+	} else if (server_queries(&server) == n) {
+		printf("Building the chain did not query the server\n");
+
+	/* the same again is answered from the cache */
+	} else if (n = server_queries(&server),
+	           !chase(res, cache, answer, trusted, time(NULL))) {
+		printf("The answer from the cache does not chase\n");
+
+	} else if (server_queries(&server) != n) {
+		printf("%u queries were not answered from the cache\n",
+		       (unsigned int) (server_queries(&server) - n));
+
+	/* but not for resolvers that ask other nameservers, another
+	 * port or without the DO bit */
+	} else if (!chase(other_port, cache, answer, trusted, time(NULL)) ||
+	           server_queries(&server2) == 0) {
+		printf("A resolver for another port used the cache\n");
+
+	} else if (n = server_queries(&server),
+	           !chase(other_ns, cache, answer, trusted, time(NULL)) ||
+	           server_queries(&server) == n) {
+		printf("A resolver with other nameservers used the cache\n");
+
+	} else if (n = server_queries(&server),
+	           (void) chase(no_do, cache, answer, trusted, time(NULL)),
+	           server_queries(&server) == n) {
+		printf("A resolver without DO used the cache\n");
+
+	/* signatures that were verified before are not verified again,
+	 * but their validity period is still checked */
+	} else if (!(rrset = ldns_pkt_rr_list_by_name_and_type(answer,
+			ldns_rr_owner(ldns_rr_list_rr(zone, 2)),
+			LDNS_RR_TYPE_A, LDNS_SECTION_ANSWER)) ||
+	           !(chain = ldns_dnssec_build_data_chain_cache(res, cache,
+			LDNS_RD, rrset, answer, NULL))) {
+		printf("Could not build the chain\n");
+
+	} else if ((uncached = derive_time(chain, NULL)),
+	           (cached = derive_time(chain, cache)) * 4 > uncached) {
+		printf("Verifying from the cache took %.3fs, without the "
+		       "cache %.3fs\n", cached, uncached);
+
+	} else if (chase(res, cache, answer, trusted, time(NULL) + 2 * 86400)) {
+		printf("A cached signature is valid after its expiration\n");
+
+	/* everything expires with the TTLs */
+	} else if (sleep(6), n = server_queries(&server),
+	           !chase(res, cache, answer, trusted, time(NULL)) ||
+	           server_queries(&server) == n) {
+		printf("Answers were used after their TTL\n");
+
+	} else {
+		r = 1;
+	}
+	ldns_dnssec_data_chain_deep_free(chain);
+	ldns_rr_list_deep_free(rrset);
+	ldns_pkt_free(answer);
+	ldns_resolver_deep_free(res);
+	ldns_resolver_deep_free(other_port);
+	ldns_resolver_deep_free(other_ns);
+	ldns_resolver_deep_free(no_do);
+	server_stop(&server);
+	server_stop(&server2);
+	ldns_dnssec_cache_free(cache);
+	ldns_rr_list_deep_free(zone);
+	ldns_rr_list_deep_free(trusted);
+	return r;
+}
+#endif /* HAVE_SSL */
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_eviction()) {
+		printf("test_eviction() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_aging()) {
+		printf("test_aging() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_negative()) {
+		printf("test_negative() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_resolver()) {
+		printf("test_resolver() failed.\n");
+		result = EXIT_FAILURE;
+	}
+#ifdef HAVE_SSL
+	if (!test_dnssec_cache()) {
+		printf("test_dnssec_cache() failed.\n");
+		result = EXIT_FAILURE;
+	}
+#endif
+	exit(result);
+}
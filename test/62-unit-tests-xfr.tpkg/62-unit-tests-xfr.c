@@ -0,0 +1,546 @@
+/*
+ * Unit tests for ldns_xfr_stream and ldns_dnssec_zone_xfr
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <errno.h>
+
+#define SOA(serial) "example.test. 3600 IN SOA ns.example.test. " \
+	"hostmaster.example.test. " #serial " 3600 900 604800 300"
+
+static const char *v1[] = {
+	SOA(1),
+	"example.test. 3600 IN NS ns.example.test.",
+	"ns.example.test. 3600 IN A 192.0.2.53",
+	"a.example.test. 3600 IN A 192.0.2.1",
+	"a.example.test. 3600 IN TXT \"one\"",
+	"old.example.test. 3600 IN A 192.0.2.9",
+	NULL
+};
+
+static const char *v2[] = {
+	SOA(2),
+	"example.test. 3600 IN NS ns.example.test.",
+	"ns.example.test. 3600 IN A 192.0.2.53",
+	"a.example.test. 3600 IN A 192.0.2.2",
+	"a.example.test. 3600 IN TXT \"one\"",
+	"old.example.test. 3600 IN A 192.0.2.9",
+	NULL
+};
+
+static const char *v3[] = {
+	SOA(10),
+	"example.test. 3600 IN NS ns.example.test.",
+	"ns.example.test. 3600 IN A 192.0.2.53",
+	"a.example.test. 3600 IN A 192.0.2.2",
+	"a.example.test. 3600 IN TXT \"three\"",
+	"new.example.test. 3600 IN A 192.0.2.3",
+	NULL
+};
+
+/* a version the server has no differences for */
+static const char *v4[] = {
+	SOA(4),
+	"example.test. 3600 IN NS ns.example.test.",
+	"gone.example.test. 3600 IN A 192.0.2.4",
+	NULL
+};
+
+/* a version the server sends the whole zone for */
+static const char *v5[] = {
+	SOA(5),
+	"example.test. 3600 IN NS ns.example.test.",
+	"a.example.test. 3600 IN A 192.0.2.5",
+	NULL
+};
+
+/* v3, as sent in an AXFR */
+static const char *axfr[] = {
+	SOA(10),
+	"example.test. 3600 IN NS ns.example.test.",
+	"ns.example.test. 3600 IN A 192.0.2.53",
+	"a.example.test. 3600 IN A 192.0.2.2",
+	"a.example.test. 3600 IN TXT \"three\"",
+	"new.example.test. 3600 IN A 192.0.2.3",
+	SOA(10),
+	NULL
+};
+
+/* from v1 to v3, by way of v2 */
+static const char *ixfr_1[] = {
+	SOA(10),
+	SOA(1),
+	"a.example.test. 3600 IN A 192.0.2.1",
+	SOA(2),
+	"a.example.test. 3600 IN A 192.0.2.2",
+	SOA(2),
+	"old.example.test. 3600 IN A 192.0.2.9",
+	"a.example.test. 3600 IN TXT \"one\"",
+	SOA(10),
+	"new.example.test. 3600 IN A 192.0.2.3",
+	"a.example.test. 3600 IN TXT \"three\"",
+	SOA(10),
+	NULL
+};
+
+/* from v2 to v3, broken off before the final SOA */
+static const char *ixfr_2[] = {
+	SOA(10),
+	SOA(2),
+	"old.example.test. 3600 IN A 192.0.2.9",
+	"a.example.test. 3600 IN TXT \"one\"",
+	SOA(10),
+	"new.example.test. 3600 IN A 192.0.2.3",
+	NULL
+};
+
+/* up to date */
+static const char *ixfr_3[] = {
+	SOA(10),
+	NULL
+};
+
+static ldns_rr_list *
+rrs_frm_strs(const char **strs)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	ldns_rr *rr;
+
+	for (; *strs; strs++) {
+		if (ldns_rr_new_frm_str(&rr, *strs, 0, NULL, NULL)
+				!= LDNS_STATUS_OK) {
+			fprintf(stderr, "could not parse %s\n", *strs);
+			exit(EXIT_FAILURE);
+		}
+		(void) ldns_rr_list_push_rr(rrs, rr);
+	}
+	return rrs;
+}
+
+static uint32_t
+query_serial(const ldns_pkt *query)
+{
+	ldns_rr *soa = ldns_rr_list_rr(ldns_pkt_authority(query), 0);
+
+	return soa && ldns_rr_rd_count(soa) >= 3
+		? ldns_rdf2native_int32(ldns_rr_rdf(soa, 2)) : 0;
+}
+
+/* Sends the RRs, two to a message */
+static void
+send_rrs(int fd, const ldns_pkt *query, const char **strs)
+{
+	ldns_rr_list *rrs = rrs_frm_strs(strs);
+	ldns_pkt *answer;
+	uint8_t *wire;
+	uint8_t len[2];
+	size_t size, i;
+
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i += 2) {
+		answer = ldns_pkt_new();
+		ldns_pkt_set_id(answer, ldns_pkt_id(query));
+		ldns_pkt_set_qr(answer, true);
+		ldns_pkt_set_aa(answer, true);
+		if (i == 0) {
+			(void) ldns_pkt_push_rr(answer, LDNS_SECTION_QUESTION,
+				ldns_rr_clone(ldns_rr_list_rr(
+				ldns_pkt_question(query), 0)));
+		}
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_ANSWER,
+				ldns_rr_clone(ldns_rr_list_rr(rrs, i)));
+		if (i + 1 < ldns_rr_list_rr_count(rrs)) {
+			(void) ldns_pkt_push_rr(answer, LDNS_SECTION_ANSWER,
+				ldns_rr_clone(ldns_rr_list_rr(rrs, i + 1)));
+		}
+		if (ldns_pkt2wire(&wire, answer, &size) == LDNS_STATUS_OK) {
+			ldns_write_uint16(len, (uint16_t) size);
+			if (write(fd, len, 2) != 2 ||
+			    write(fd, wire, size) != (ssize_t) size) {
+				i = ldns_rr_list_rr_count(rrs);
+			}
+			LDNS_FREE(wire);
+		}
+		ldns_pkt_free(answer);
+	}
+	ldns_rr_list_deep_free(rrs);
+}
+
+static bool
+read_n(int fd, uint8_t *buf, size_t n)
+{
+	ssize_t r;
+
+	while (n > 0) {
+		if ((r = read(fd, buf, n)) <= 0) {
+			return false;
+		}
+		buf += r;
+		n -= (size_t) r;
+	}
+	return true;
+}
+
+/* Answers one transfer per connection: the differences since the serial
+ * of an IXFR when it has them, v3 otherwise */
+static void
+serve(int sock)
+{
+	uint8_t wire[LDNS_MAX_PACKETLEN];
+	uint8_t len[2];
+	ldns_pkt *query;
+	ldns_rr *q;
+	int fd;
+
+	for (;;) {
+		if ((fd = accept(sock, NULL, NULL)) == -1) {
+			continue;
+		}
+		if (!read_n(fd, len, 2) ||
+		    !read_n(fd, wire, ldns_read_uint16(len)) ||
+		    ldns_wire2pkt(&query, wire, ldns_read_uint16(len))
+				!= LDNS_STATUS_OK) {
+			close(fd);
+			continue;
+		}
+		q = ldns_rr_list_rr(ldns_pkt_question(query), 0);
+		if (q && ldns_rr_get_type(q) == LDNS_RR_TYPE_IXFR &&
+		    query_serial(query) == 1) {
+			send_rrs(fd, query, ixfr_1);
+		} else if (q && ldns_rr_get_type(q) == LDNS_RR_TYPE_IXFR &&
+		    query_serial(query) == 2) {
+			send_rrs(fd, query, ixfr_2);
+		} else if (q && ldns_rr_get_type(q) == LDNS_RR_TYPE_IXFR &&
+		    query_serial(query) == 10) {
+			send_rrs(fd, query, ixfr_3);
+		} else if (q && ldns_rr_get_type(q) == LDNS_RR_TYPE_IXFR &&
+		    query_serial(query) == 4) {
+			/* the differences from another version */
+			send_rrs(fd, query, ixfr_1);
+		} else if (q) {
+			send_rrs(fd, query, axfr);
+		}
+		ldns_pkt_free(query);
+		close(fd);
+	}
+}
+
+struct server {
+	pid_t pid;
+	uint16_t port;
+};
+
+static bool
+server_start(struct server *server)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int sock;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+		return false;
+	}
+	if (bind(sock, (struct sockaddr *) &addr, addr_len) == -1 ||
+	    getsockname(sock, (struct sockaddr *) &addr, &addr_len) == -1 ||
+	    listen(sock, 5) == -1) {
+		close(sock);
+		return false;
+	}
+	server->port = ntohs(addr.sin_port);
+	if ((server->pid = fork()) == -1) {
+		close(sock);
+		return false;
+	}
+	if (server->pid == 0) {
+		serve(sock);
+		_exit(0);
+	}
+	close(sock);
+	return true;
+}
+
+static void
+server_stop(struct server *server)
+{
+	(void) kill(server->pid, SIGTERM);
+	(void) waitpid(server->pid, NULL, 0);
+}
+
+static ldns_resolver *
+server_resolver(const struct server *server)
+{
+	ldns_resolver *res = ldns_resolver_new();
+	struct timeval timeout = { 2, 0 };
+	ldns_rdf *ns;
+
+	if (!res) {
+		return NULL;
+	}
+	ldns_resolver_set_port(res, server->port);
+	ldns_resolver_set_timeout(res, timeout);
+	ldns_resolver_set_retry(res, 1);
+	if ((ns = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, "127.0.0.1"))) {
+		(void) ldns_resolver_push_nameserver(res, ns);
+		ldns_rdf_deep_free(ns);
+	}
+	return res;
+}
+
+struct batches {
+	ldns_rr_list *rrs;
+	size_t count;
+};
+
+static ldns_status
+collect(ldns_rr_list *rrs, void *arg)
+{
+	struct batches *b = arg;
+	size_t i;
+
+	b->count++;
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		(void) ldns_rr_list_push_rr(b->rrs, ldns_rr_list_rr(rrs, i));
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* Whether the RRs are the same, in the same order */
+static bool
+same_rrs(const ldns_rr_list *a, const ldns_rr_list *b)
+{
+	size_t i;
+
+	if (ldns_rr_list_rr_count(a) != ldns_rr_list_rr_count(b)) {
+		return false;
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(a); i++) {
+		if (ldns_rr_compare(ldns_rr_list_rr(a, i),
+				ldns_rr_list_rr(b, i)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int
+test_stream(ldns_resolver *res, ldns_rdf *origin)
+{
+	struct batches b;
+	ldns_rr_list *expect = rrs_frm_strs(axfr);
+	ldns_status s;
+	int r = 1;
+
+	b.rrs = ldns_rr_list_new();
+	b.count = 0;
+	s = ldns_xfr_stream(res, origin, LDNS_RR_CLASS_IN, LDNS_RR_TYPE_AXFR,
+			collect, &b);
+	if (s != LDNS_STATUS_OK) {
+		printf("AXFR: %s\n", ldns_get_errorstr_by_id(s));
+		r = 0;
+	}
+	if (!same_rrs(b.rrs, expect)) {
+		printf("AXFR did not hand over the zone in order:\n");
+		ldns_rr_list_print(stdout, b.rrs);
+		r = 0;
+	}
+	if (b.count != 4) {
+		printf("AXFR handed over %d batches, not one per message\n",
+				(int) b.count);
+		r = 0;
+	}
+	ldns_rr_list_deep_free(b.rrs);
+	ldns_rr_list_deep_free(expect);
+
+	expect = rrs_frm_strs(ixfr_1);
+	b.rrs = ldns_rr_list_new();
+	b.count = 0;
+	ldns_resolver_set_ixfr_serial(res, 1);
+	s = ldns_xfr_stream(res, origin, LDNS_RR_CLASS_IN, LDNS_RR_TYPE_IXFR,
+			collect, &b);
+	if (s != LDNS_STATUS_OK) {
+		printf("IXFR: %s\n", ldns_get_errorstr_by_id(s));
+		r = 0;
+	}
+	if (!same_rrs(b.rrs, expect)) {
+		printf("IXFR did not hand over the differences in order:\n");
+		ldns_rr_list_print(stdout, b.rrs);
+		r = 0;
+	}
+	ldns_rr_list_deep_free(b.rrs);
+	ldns_rr_list_deep_free(expect);
+
+	/* broken off: the batches so far are handed over, but it fails */
+	b.rrs = ldns_rr_list_new();
+	b.count = 0;
+	ldns_resolver_set_ixfr_serial(res, 2);
+	s = ldns_xfr_stream(res, origin, LDNS_RR_CLASS_IN, LDNS_RR_TYPE_IXFR,
+			collect, &b);
+	if (s == LDNS_STATUS_OK) {
+		printf("IXFR without the final SOA succeeded\n");
+		r = 0;
+	}
+	if (ldns_rr_list_rr_count(b.rrs) != 6) {
+		printf("IXFR broken off handed over %d RRs, not 6\n",
+				(int) ldns_rr_list_rr_count(b.rrs));
+		r = 0;
+	}
+	ldns_rr_list_deep_free(b.rrs);
+	ldns_resolver_set_ixfr_serial(res, 0);
+	return r;
+}
+
+static ldns_dnssec_zone *
+zone_frm_strs(const char **strs)
+{
+	ldns_dnssec_zone *zone = ldns_dnssec_zone_new();
+	ldns_rr_list *rrs = rrs_frm_strs(strs);
+	size_t i;
+
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		if (ldns_dnssec_zone_add_rr(zone, ldns_rr_list_rr(rrs, i))
+				!= LDNS_STATUS_OK) {
+			fprintf(stderr, "could not add %s\n", strs[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	ldns_rr_list_free(rrs);
+	return zone;
+}
+
+/* The RRs of the zone, sorted */
+static ldns_rr_list *
+zone_rrs(const ldns_dnssec_zone *zone)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	ldns_rbnode_t *node;
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs *rr;
+
+	for (node = ldns_rbtree_first(zone->names); node != LDNS_RBTREE_NULL;
+			node = ldns_rbtree_next(node)) {
+		rrset = ((ldns_dnssec_name *) node->data)->rrsets;
+		for (; rrset; rrset = rrset->next) {
+			for (rr = rrset->rrs; rr; rr = rr->next) {
+				(void) ldns_rr_list_push_rr(rrs, rr->rr);
+			}
+		}
+	}
+	ldns_rr_list_sort(rrs);
+	return rrs;
+}
+
+/* Whether the zone holds the RRs of the version, and has its SOA */
+static bool
+zone_is(const ldns_dnssec_zone *zone, const char **version)
+{
+	ldns_rr_list *expect = rrs_frm_strs(version);
+	ldns_rr_list *rrs = zone_rrs(zone);
+	ldns_dnssec_rrsets *soa;
+	bool same;
+
+	soa = zone->soa ? ldns_dnssec_name_find_rrset(zone->soa,
+			LDNS_RR_TYPE_SOA) : NULL;
+	if (!soa || ldns_rr_compare(soa->rrs->rr,
+			ldns_rr_list_rr(expect, 0)) != 0) {
+		printf("the zone does not have the SOA of the version\n");
+		soa = NULL;
+	}
+	ldns_rr_list_sort(expect);
+	same = same_rrs(rrs, expect);
+	if (!same) {
+		printf("the zone is:\n");
+		ldns_rr_list_print(stdout, rrs);
+		printf("rather than:\n");
+		ldns_rr_list_print(stdout, expect);
+	}
+	ldns_rr_list_free(rrs);
+	ldns_rr_list_deep_free(expect);
+	return same && soa != NULL;
+}
+
+static int
+check_xfr(ldns_resolver *res, ldns_rdf *origin, const char *what,
+		const char **from, const char **to, bool ok, size_t workers)
+{
+	ldns_dnssec_zone *zone = from ? zone_frm_strs(from)
+	                              : ldns_dnssec_zone_new();
+	ldns_status s;
+	int r = 1;
+
+	s = workers ? ldns_dnssec_zone_xfr_pipeline(zone, res, origin,
+			LDNS_RR_CLASS_IN, workers)
+	            : ldns_dnssec_zone_xfr(zone, res, origin,
+			LDNS_RR_CLASS_IN);
+	if ((s == LDNS_STATUS_OK) != ok) {
+		printf("%s: %s\n", what, ldns_get_errorstr_by_id(s));
+		r = 0;
+	}
+	if (!zone_is(zone, to)) {
+		printf("%s: wrong zone\n", what);
+		r = 0;
+	}
+	if (ldns_resolver_get_ixfr_serial(res) != 0) {
+		printf("%s: the IXFR serial of the resolver was changed\n",
+				what);
+		r = 0;
+	}
+	ldns_dnssec_zone_deep_free(zone);
+	return r;
+}
+
+static int
+test_zone_xfr(ldns_resolver *res, ldns_rdf *origin)
+{
+	int r = 1;
+
+	r &= check_xfr(res, origin, "AXFR into an empty zone",
+			NULL, v3, true, 0);
+	r &= check_xfr(res, origin, "IXFR from v1", v1, v3, true, 0);
+	r &= check_xfr(res, origin, "IXFR from v1 in a pipeline",
+			v1, v3, true, 2);
+	r &= check_xfr(res, origin, "IXFR broken off", v2, v2, false, 0);
+	r &= check_xfr(res, origin, "IXFR broken off in a pipeline",
+			v2, v2, false, 2);
+	r &= check_xfr(res, origin, "IXFR up to date", v3, v3, true, 0);
+	r &= check_xfr(res, origin, "IXFR from another version",
+			v4, v3, true, 0);
+	r &= check_xfr(res, origin, "IXFR answered with the whole zone",
+			v5, v3, true, 0);
+	return r;
+}
+
+int main(void)
+{
+	struct server server;
+	ldns_resolver *res;
+	ldns_rdf *origin = ldns_dname_new_frm_str("example.test.");
+	int result = EXIT_SUCCESS;
+
+	if (!server_start(&server)) {
+		printf("could not start the server: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	res = server_resolver(&server);
+	if (!test_stream(res, origin)) {
+		printf("test_stream() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_zone_xfr(res, origin)) {
+		printf("test_zone_xfr() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	ldns_resolver_deep_free(res);
+	ldns_rdf_deep_free(origin);
+	server_stop(&server);
+	exit(result);
+}
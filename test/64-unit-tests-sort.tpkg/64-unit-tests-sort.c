@@ -0,0 +1,163 @@
+/*
+ * Unit tests for sorting RR lists on their sort keys
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+/* more than ldns_rr_list_sort() sorts in the calling thread */
+#define RR_COUNT 70000
+
+static const char *labels[] = {
+	"a", "A", "b", "B", "*", "\\*", "a\\.b", "A\\.B", "\\000", "\\001",
+	"\\255", "\\065", "z", "Z", "-", "x-1", "X-1", "\\(", "\\\\", "\\ ",
+	"zz", "zZ", "aa", "Aa", "a\\000", "\\128a", "xn--bcher-kva", "0", "9"
+};
+#define N_LABELS (sizeof(labels) / sizeof(labels[0]))
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+/* A name of one to four labels below sort.test., and one of several
+ * types, with rdata that often only differs a little */
+static ldns_rr *
+random_rr(void)
+{
+	char str[512];
+	size_t len = 0;
+	uint32_t i, depth = 1 + rnd(4);
+	ldns_rr *rr = NULL;
+
+	for (i = 0; i < depth; i++) {
+		len += (size_t) snprintf(str + len, sizeof(str) - len, "%s.",
+				labels[rnd(N_LABELS)]);
+	}
+	switch (rnd(5)) {
+	case 0:
+		snprintf(str + len, sizeof(str) - len,
+				"sort.test. %u IN A 192.0.2.%u",
+				rnd(3600), rnd(4));
+		break;
+	case 1:
+		snprintf(str + len, sizeof(str) - len,
+				"Sort.Test. 3600 IN TXT \"t%u\"", rnd(8));
+		break;
+	case 2:
+		snprintf(str + len, sizeof(str) - len,
+				"sort.test. 3600 IN MX %u Mail%u.sort.test.",
+				rnd(3), rnd(3));
+		break;
+	case 3:
+		snprintf(str + len, sizeof(str) - len,
+				"SORT.TEST. 3600 IN NS ns%u.sort.test.", rnd(3));
+		break;
+	default:
+		snprintf(str + len, sizeof(str) - len,
+				"sort.test. 3600 CH TXT \"t%u\"", rnd(4));
+		break;
+	}
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "could not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+/* Whether the list is in the order of ldns_rr_compare() */
+static bool
+in_order(const ldns_rr_list *rrs, const char *what)
+{
+	size_t i;
+
+	for (i = 1; i < ldns_rr_list_rr_count(rrs); i++) {
+		if (ldns_rr_compare(ldns_rr_list_rr(rrs, i - 1),
+				ldns_rr_list_rr(rrs, i)) > 0) {
+			printf("%s: RR %d and %d are out of order:\n", what,
+					(int) i - 1, (int) i);
+			ldns_rr_print(stdout, ldns_rr_list_rr(rrs, i - 1));
+			ldns_rr_print(stdout, ldns_rr_list_rr(rrs, i));
+			return false;
+		}
+	}
+	return true;
+}
+
+static int
+compare_rrs(const void *a, const void *b)
+{
+	return ldns_rr_compare(*(ldns_rr * const *) a, *(ldns_rr * const *) b);
+}
+
+static int
+test_sort(size_t count)
+{
+	ldns_rr_list *one = ldns_rr_list_new();
+	ldns_rr_list *many, *expect;
+	ldns_rr **rrs;
+	size_t i;
+	int r = 1;
+
+	for (i = 0; i < count; i++) {
+		(void) ldns_rr_list_push_rr(one, random_rr());
+	}
+	many = ldns_rr_list_clone(one);
+	expect = ldns_rr_list_clone(one);
+	rrs = LDNS_XMALLOC(ldns_rr *, count);
+	for (i = 0; i < count; i++) {
+		rrs[i] = ldns_rr_list_rr(expect, i);
+	}
+	qsort(rrs, count, sizeof(*rrs), compare_rrs);
+
+	ldns_rr_list_sort_set_threads(1);
+	ldns_rr_list_sort(one);
+	ldns_rr_list_sort_set_threads(4);
+	ldns_rr_list_sort(many);
+	ldns_rr_list_sort_set_threads(0);
+
+	if (!in_order(one, "1 thread") || !in_order(many, "4 threads")) {
+		r = 0;
+	}
+	for (i = 0; r && i < count; i++) {
+		if (ldns_rr_compare(ldns_rr_list_rr(one, i), rrs[i]) != 0 ||
+		    ldns_rr_compare(ldns_rr_list_rr(many, i), rrs[i]) != 0) {
+			printf("RR %d differs from the one sorted with "
+			       "ldns_rr_compare():\n", (int) i);
+			ldns_rr_print(stdout, ldns_rr_list_rr(one, i));
+			ldns_rr_print(stdout, ldns_rr_list_rr(many, i));
+			ldns_rr_print(stdout, rrs[i]);
+			r = 0;
+		}
+	}
+	if (ldns_rr_list_rr_count(one) != count ||
+	    ldns_rr_list_rr_count(many) != count) {
+		printf("RRs were lost in sorting\n");
+		r = 0;
+	}
+	LDNS_FREE(rrs);
+	ldns_rr_list_deep_free(one);
+	ldns_rr_list_deep_free(many);
+	ldns_rr_list_deep_free(expect);
+	return r;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_sort(100)) {
+		printf("test_sort(100) failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_sort(RR_COUNT)) {
+		printf("test_sort(%d) failed.\n", RR_COUNT);
+		result = EXIT_FAILURE;
+	}
+	exit(result);
+}
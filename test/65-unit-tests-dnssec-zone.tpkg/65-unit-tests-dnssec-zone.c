@@ -0,0 +1,281 @@
+/*
+ * Unit tests for adding to and removing from an ldns_dnssec_zone, with
+ * and without its index
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+/* names of a few RRs each, and one large RRset: more RRs than the
+ * index keeps in the list of the RRset only */
+#define N_NAMES 40
+#define N_SMALL 3
+#define N_LARGE 100
+#define N_RRS (N_NAMES * N_SMALL + N_LARGE)
+#define ROUNDS 20000
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static ldns_rr *
+new_rr(const char *str)
+{
+	ldns_rr *rr = NULL;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "could not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+/* The RRs the zones may hold. Every other one is written in upper case,
+ * to be removed with the lower case version and the other way around.
+ */
+static ldns_rr *
+candidate(size_t i, bool upper)
+{
+	char str[128];
+
+	if (i < N_LARGE) {
+		snprintf(str, sizeof(str), upper ?
+				"BIG.CHURN.TEST. 3600 IN A 10.0.%u.%u" :
+				"big.churn.test. 3600 IN A 10.0.%u.%u",
+				(unsigned) (i / 256), (unsigned) (i % 256));
+		return new_rr(str);
+	}
+	i -= N_LARGE;
+	switch (i % N_SMALL) {
+	case 0:
+		snprintf(str, sizeof(str), "%s%u.churn.test. 3600 IN A 192.0.2.1",
+				upper ? "N" : "n", (unsigned) (i / N_SMALL));
+		break;
+	case 1:
+		snprintf(str, sizeof(str),
+				"%s%u.churn.test. 3600 IN TXT \"t\"",
+				upper ? "N" : "n", (unsigned) (i / N_SMALL));
+		break;
+	default:
+		snprintf(str, sizeof(str),
+				"%s%u.churn.test. 3600 IN A 192.0.2.2",
+				upper ? "N" : "n", (unsigned) (i / N_SMALL));
+		break;
+	}
+	return new_rr(str);
+}
+
+/* All RRs of the zone, sorted */
+static ldns_rr_list *
+zone_rrs(const ldns_dnssec_zone *zone)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs *cur;
+
+	for (node = ldns_rbtree_first(zone->names);
+	     node != LDNS_RBTREE_NULL; node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		if (!name->rrsets) {
+			printf("a name without RRs was left in the zone\n");
+			ldns_rr_list_free(rrs);
+			return NULL;
+		}
+		for (rrset = name->rrsets; rrset; rrset = rrset->next) {
+			for (cur = rrset->rrs; cur; cur = cur->next) {
+				(void) ldns_rr_list_push_rr(rrs, cur->rr);
+			}
+		}
+	}
+	ldns_rr_list_sort(rrs);
+	return rrs;
+}
+
+/* Whether the zone holds exactly the RRs in the reference, and finds
+ * the RRsets of all candidates when they are there */
+static bool
+zone_is(const ldns_dnssec_zone *zone, ldns_rr * const *in, const char *what)
+{
+	ldns_rr_list *rrs = zone_rrs(zone), *expect = ldns_rr_list_new();
+	ldns_rr *rr;
+	ldns_dnssec_rrsets *rrset;
+	bool r = rrs != NULL;
+	size_t i, j;
+
+	for (i = 0; i < N_RRS; i++) {
+		if (in[i]) {
+			(void) ldns_rr_list_push_rr(expect, in[i]);
+		}
+	}
+	ldns_rr_list_sort(expect);
+	if (r && ldns_rr_list_compare(rrs, expect) != 0) {
+		printf("%s: the zone has %d RRs instead of the %d expected\n",
+				what, (int) ldns_rr_list_rr_count(rrs),
+				(int) ldns_rr_list_rr_count(expect));
+		r = false;
+	}
+	for (i = 0; r && i < N_RRS; i++) {
+		rr = candidate(i, i % 2 == 0);
+		rrset = ldns_dnssec_zone_find_rrset(zone, ldns_rr_owner(rr),
+				ldns_rr_get_type(rr));
+		/* the RRset is there when any RR of it is */
+		for (j = 0; rrset == NULL && j < N_RRS; j++) {
+			if (in[j] && ldns_dname_compare(ldns_rr_owner(in[j]),
+					ldns_rr_owner(rr)) == 0 &&
+			    ldns_rr_get_type(in[j]) == ldns_rr_get_type(rr)) {
+				printf("%s: RRset of RR %d not found\n",
+						what, (int) i);
+				r = false;
+			}
+		}
+		if (rrset && (ldns_dname_compare(
+				ldns_rr_owner(rrset->rrs->rr),
+				ldns_rr_owner(rr)) != 0 ||
+		    ldns_dnssec_rrsets_type(rrset) != ldns_rr_get_type(rr))) {
+			printf("%s: another RRset found for RR %d\n",
+					what, (int) i);
+			r = false;
+		}
+		ldns_rr_free(rr);
+	}
+	ldns_rr_list_free(rrs);
+	ldns_rr_list_free(expect);
+	return r;
+}
+
+/* Adds and removes candidates at random; in[] is what is expected to be
+ * in the zone */
+static bool
+churn(ldns_dnssec_zone *zone, ldns_rr **in, size_t rounds, const char *what)
+{
+	ldns_rr *rr, *removed;
+	size_t round, i;
+
+	for (round = 0; round < rounds; round++) {
+		/* mostly the large RRset, so that it grows and shrinks */
+		i = rnd(4) ? rnd(N_LARGE) : N_LARGE + rnd(N_RRS - N_LARGE);
+		if (in[i]) {
+			rr = candidate(i, rnd(2));
+			removed = ldns_dnssec_zone_remove_rr(zone, rr);
+			ldns_rr_free(rr);
+			if (removed != in[i]) {
+				printf("%s: removing RR %d gave %p instead of "
+				       "%p\n", what, (int) i,
+				       (void *) removed, (void *) in[i]);
+				ldns_rr_free(removed);
+				return false;
+			}
+			ldns_rr_free(removed);
+			in[i] = NULL;
+		} else {
+			rr = candidate(i, rnd(2));
+			if (ldns_dnssec_zone_add_rr(zone, rr)
+					!= LDNS_STATUS_OK) {
+				printf("%s: could not add RR %d\n",
+						what, (int) i);
+				ldns_rr_free(rr);
+				return false;
+			}
+			in[i] = rr;
+		}
+		/* removing what is not there finds nothing */
+		if (!in[i]) {
+			rr = candidate(i, false);
+			removed = ldns_dnssec_zone_remove_rr(zone, rr);
+			ldns_rr_free(rr);
+			if (removed) {
+				printf("%s: RR %d was removed twice\n",
+						what, (int) i);
+				ldns_rr_free(removed);
+				return false;
+			}
+		}
+		if (round % 1000 == 999 && !zone_is(zone, in, what)) {
+			return false;
+		}
+	}
+	return zone_is(zone, in, what);
+}
+
+/* Empties the zone, which must leave no names behind */
+static bool
+empty(ldns_dnssec_zone *zone, ldns_rr **in, const char *what)
+{
+	ldns_rr *rr, *removed;
+	size_t i;
+
+	for (i = 0; i < N_RRS; i++) {
+		if (!in[i]) {
+			continue;
+		}
+		rr = candidate(i, false);
+		removed = ldns_dnssec_zone_remove_rr(zone, rr);
+		ldns_rr_free(rr);
+		if (removed != in[i]) {
+			printf("%s: could not remove RR %d\n", what, (int) i);
+			return false;
+		}
+		ldns_rr_free(removed);
+		in[i] = NULL;
+	}
+	if (zone->names->count != 0) {
+		printf("%s: %d names left in an empty zone\n",
+				what, (int) zone->names->count);
+		return false;
+	}
+	return true;
+}
+
+static bool
+test_churn(bool with_index)
+{
+	const char *what = with_index ? "with index" : "without index";
+	ldns_dnssec_zone *zone = ldns_dnssec_zone_new();
+	ldns_rr *in[N_RRS];
+	bool r;
+
+	memset(in, 0, sizeof(in));
+	seed = 1;
+	if (with_index && ldns_dnssec_zone_create_index(zone)
+			!= LDNS_STATUS_OK) {
+		printf("could not create the index\n");
+		ldns_dnssec_zone_deep_free(zone);
+		return false;
+	}
+	r = churn(zone, in, ROUNDS, what);
+	if (r && with_index) {
+		/* an index made of a zone with RRs in it */
+		ldns_dnssec_zone_free_index(zone);
+		r = churn(zone, in, ROUNDS / 4, "index freed") &&
+		    ldns_dnssec_zone_create_index(zone) == LDNS_STATUS_OK &&
+		    churn(zone, in, ROUNDS, "index created again");
+	}
+	r = r && empty(zone, in, what) &&
+	    churn(zone, in, ROUNDS / 4, "emptied") &&
+	    empty(zone, in, what);
+	ldns_dnssec_zone_deep_free(zone);
+	return r;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_churn(false)) {
+		printf("test_churn(false) failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_churn(true)) {
+		printf("test_churn(true) failed.\n");
+		result = EXIT_FAILURE;
+	}
+	exit(result);
+}
@@ -0,0 +1,240 @@
+/*
+ * Unit tests for walking an ldns_radix_t in order
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#define MAX_KEYS 2000
+#define MAX_KEYLEN 6
+
+struct key {
+	uint8_t data[MAX_KEYLEN];
+	radix_strlen_t len;
+};
+
+static struct key keys[MAX_KEYS];
+static size_t n_keys;
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+/* The order of the tree: by memcmp(), and a prefix before the longer
+ * keys it is a prefix of */
+static int
+key_compare(const void *a, const void *b)
+{
+	const struct key *x = a, *y = b;
+	int c = memcmp(x->data, y->data, x->len < y->len ? x->len : y->len);
+
+	if (c != 0) {
+		return c;
+	}
+	return x->len < y->len ? -1 : x->len > y->len ? 1 : 0;
+}
+
+/* Keys from a few bytes only, so that many share a prefix or are a
+ * prefix of others, and "x" followed by every byte, for a node with 256
+ * edges */
+static void
+make_keys(void)
+{
+	static const uint8_t bytes[] = { 0x00, 0x01, 'a', 'b', 0xfe, 0xff };
+	size_t i, j, n = 0;
+
+	for (i = 0; i < 256; i++) {
+		keys[n].data[0] = 'x';
+		keys[n].data[1] = (uint8_t) i;
+		keys[n++].len = 2;
+	}
+	while (n < MAX_KEYS) {
+		keys[n].len = (radix_strlen_t) (1 + rnd(MAX_KEYLEN));
+		for (j = 0; j < keys[n].len; j++) {
+			keys[n].data[j] = bytes[rnd(sizeof(bytes))];
+		}
+		n++;
+	}
+	qsort(keys, n, sizeof(*keys), key_compare);
+	n_keys = 0;
+	for (i = 0; i < n; i++) {
+		if (n_keys == 0 || key_compare(&keys[n_keys - 1], &keys[i])) {
+			keys[n_keys++] = keys[i];
+		}
+	}
+}
+
+static bool
+is_key(const ldns_radix_node_t *node, size_t i)
+{
+	return node && node->data == &keys[i] && node->klen == keys[i].len &&
+	       memcmp(node->key, keys[i].data, keys[i].len) == 0;
+}
+
+/* Walks the tree both ways; present[i] tells whether key i is in it */
+static bool
+walk(ldns_radix_t *tree, const bool *present, const char *what)
+{
+	ldns_radix_node_t *node;
+	size_t i;
+
+	node = ldns_radix_first(tree);
+	for (i = 0; i < n_keys; i++) {
+		if (!present[i]) {
+			continue;
+		}
+		if (!is_key(node, i)) {
+			printf("%s: forward walk misses key %d\n",
+					what, (int) i);
+			return false;
+		}
+		node = ldns_radix_next(node);
+	}
+	if (node) {
+		printf("%s: forward walk goes past the last key\n", what);
+		return false;
+	}
+	node = ldns_radix_last(tree);
+	for (i = n_keys; i-- > 0; ) {
+		if (!present[i]) {
+			continue;
+		}
+		if (!is_key(node, i)) {
+			printf("%s: backward walk misses key %d\n",
+					what, (int) i);
+			return false;
+		}
+		node = ldns_radix_prev(node);
+	}
+	if (node) {
+		printf("%s: backward walk goes past the first key\n", what);
+		return false;
+	}
+	return true;
+}
+
+/* Looks up every key, and keys just after it, which are not in the
+ * tree */
+static bool
+find(ldns_radix_t *tree, const bool *present, const char *what)
+{
+	ldns_radix_node_t *node;
+	struct key probe;
+	size_t i, j;
+	int exact;
+
+	for (i = 0; i < n_keys; i++) {
+		probe = keys[i];
+		if (probe.len < MAX_KEYLEN) {
+			/* a key that sorts right after key i */
+			probe.data[probe.len++] = 0x00;
+		} else {
+			probe.data[probe.len - 1]++;
+		}
+		/* the last present key that sorts before it */
+		for (j = n_keys; j-- > 0; ) {
+			if (present[j] && key_compare(&keys[j], &probe) <= 0) {
+				break;
+			}
+		}
+		exact = ldns_radix_find_less_equal(tree, probe.data,
+				probe.len, &node);
+		if (j < n_keys && key_compare(&keys[j], &probe) == 0) {
+			if (!exact || !is_key(node, j)) {
+				printf("%s: key %d not found\n", what, (int) j);
+				return false;
+			}
+		} else if (exact) {
+			printf("%s: found a key after key %d that is not "
+			       "there\n", what, (int) i);
+			return false;
+		} else if (j < n_keys ? !is_key(node, j) : node != NULL) {
+			printf("%s: wrong key before the one after key %d\n",
+					what, (int) i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool
+test_radix(void)
+{
+	ldns_radix_t *tree = ldns_radix_create();
+	bool present[MAX_KEYS];
+	size_t i, j, order[MAX_KEYS], t;
+	bool r = true;
+
+	make_keys();
+	memset(present, 0, sizeof(present));
+	/* insert in random order */
+	for (i = 0; i < n_keys; i++) {
+		order[i] = i;
+	}
+	for (i = n_keys; i > 1; i--) {
+		j = rnd((uint32_t) i);
+		t = order[j];
+		order[j] = order[i - 1];
+		order[i - 1] = t;
+	}
+	for (i = 0; i < n_keys; i++) {
+		if (ldns_radix_insert(tree, keys[order[i]].data,
+				keys[order[i]].len, &keys[order[i]])
+				!= LDNS_STATUS_OK) {
+			printf("could not insert key %d\n", (int) order[i]);
+			ldns_radix_free(tree);
+			return false;
+		}
+		present[order[i]] = true;
+		if (i % 200 == 199 && (!walk(tree, present, "inserting") ||
+		    !find(tree, present, "inserting"))) {
+			r = false;
+			break;
+		}
+	}
+	r = r && walk(tree, present, "all keys") &&
+	    find(tree, present, "all keys");
+
+	/* delete half of them, and then the rest */
+	for (i = 0; r && i < n_keys; i++) {
+		if (rnd(2) == 0) {
+			continue;
+		}
+		if (ldns_radix_delete(tree, keys[i].data, keys[i].len)
+				!= &keys[i]) {
+			printf("could not delete key %d\n", (int) i);
+			r = false;
+		}
+		present[i] = false;
+	}
+	r = r && walk(tree, present, "half deleted") &&
+	    find(tree, present, "half deleted");
+	for (i = 0; r && i < n_keys; i++) {
+		if (present[i] && ldns_radix_delete(tree, keys[i].data,
+				keys[i].len) != &keys[i]) {
+			printf("could not delete key %d\n", (int) i);
+			r = false;
+		}
+		present[i] = false;
+	}
+	r = r && walk(tree, present, "all deleted");
+	ldns_radix_free(tree);
+	return r;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_radix()) {
+		printf("test_radix() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	exit(result);
+}
@@ -0,0 +1,286 @@
+/*
+ * Unit tests for comparing and lowercasing domain names, which is done
+ * eight bytes at a time, against doing it a byte at a time
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#define ROUNDS 200000
+
+/* around the upper and lower case letters, and with the high bit set */
+static const uint8_t bytes[] = {
+	'@', 'A', 'B', 'Y', 'Z', '[', '`', 'a', 'b', 'y', 'z', '{',
+	0x00, 0x01, '-', '0', 0x7f, 0x80, 0xc1, 0xda, 0xe1, 0xfa, 0xff
+};
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static uint8_t
+lower(uint8_t b)
+{
+	return b >= 'A' && b <= 'Z' ? b + ('a' - 'A') : b;
+}
+
+/* A name of up to five labels of up to 20 bytes, so that they start and
+ * end anywhere in the words the library compares */
+static size_t
+random_name(uint8_t *data)
+{
+	size_t len = 0, n_labels = rnd(6), i, j, l;
+
+	for (i = 0; i < n_labels; i++) {
+		l = 1 + rnd(20);
+		data[len++] = (uint8_t) l;
+		for (j = 0; j < l; j++) {
+			data[len++] = bytes[rnd(sizeof(bytes))];
+		}
+	}
+	data[len++] = 0;
+	return len;
+}
+
+/* A name like the first, often only differing in case, or in one
+ * byte, or one that is above or below it */
+static size_t
+related_name(uint8_t *data, const uint8_t *name, size_t size)
+{
+	size_t len, i;
+
+	switch (rnd(5)) {
+	case 0:
+		return random_name(data);
+	case 1:
+		/* a parent */
+		for (i = 0; name[i] && rnd(2); i += name[i] + 1)
+			;
+		memcpy(data, name + i, size - i);
+		return size - i;
+	case 2:
+		/* a child */
+		len = random_name(data);
+		if (len == 1 || len - 1 + size > LDNS_MAX_DOMAINLEN) {
+			memcpy(data, name, size);
+			return size;
+		}
+		memcpy(data + len - 1, name, size);
+		return len - 1 + size;
+	default:
+		/* the same, in other case, and sometimes a byte changed */
+		memcpy(data, name, size);
+		for (i = 0; i < size; i += data[i] + 1) {
+			if (data[i] == 0) {
+				break;
+			}
+			if (rnd(2)) {
+				data[i + 1 + rnd(data[i])] =
+					bytes[rnd(sizeof(bytes))];
+			}
+		}
+		for (i = 0; i < size; i++) {
+			if (rnd(2) && ((data[i] | 0x20) >= 'a' &&
+			               (data[i] | 0x20) <= 'z')) {
+				data[i] ^= 0x20;
+			}
+		}
+		/* but not the length bytes */
+		for (i = 0; i < size; i += name[i] + 1) {
+			data[i] = name[i];
+			if (name[i] == 0) {
+				break;
+			}
+		}
+		return size;
+	}
+}
+
+static size_t
+labels(const uint8_t *name, const uint8_t **label)
+{
+	size_t n = 0;
+
+	for (; *name; name += *name + 1) {
+		label[n++] = name;
+	}
+	return n;
+}
+
+/* The canonical order of RFC 4034, a byte at a time */
+static int
+ref_compare(const uint8_t *a, const uint8_t *b)
+{
+	const uint8_t *la[LDNS_MAX_DOMAINLEN], *lb[LDNS_MAX_DOMAINLEN];
+	size_t na = labels(a, la), nb = labels(b, lb), i, j;
+
+	for (i = 1; i <= na && i <= nb; i++) {
+		a = la[na - i];
+		b = lb[nb - i];
+		for (j = 1; j <= a[0] && j <= b[0]; j++) {
+			if (lower(a[j]) != lower(b[j])) {
+				return lower(a[j]) < lower(b[j]) ? -1 : 1;
+			}
+		}
+		if (a[0] != b[0]) {
+			return a[0] < b[0] ? -1 : 1;
+		}
+	}
+	return na < nb ? -1 : na > nb ? 1 : 0;
+}
+
+static bool
+ref_is_subdomain(const uint8_t *a, size_t size_a,
+		const uint8_t *b, size_t size_b)
+{
+	const uint8_t *la[LDNS_MAX_DOMAINLEN], *lb[LDNS_MAX_DOMAINLEN];
+	const uint8_t *suffix;
+	size_t na = labels(a, la), nb = labels(b, lb), i;
+
+	/* names that only differ in case are subdomains of each other */
+	if (na < nb || (size_a == size_b && memcmp(a, b, size_a) == 0)) {
+		return false;
+	}
+	/* the last labels of a are those of b */
+	suffix = nb > 0 ? la[na - nb] : a + size_a - 1;
+	if ((size_t) (a + size_a - suffix) != size_b) {
+		return false;
+	}
+	for (i = 0; i < size_b; i++) {
+		if (lower(suffix[i]) != lower(b[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* The order of the lowercased RDATA of two NS RRs */
+static int
+ref_rdata_compare(const uint8_t *a, size_t size_a,
+		const uint8_t *b, size_t size_b)
+{
+	size_t i;
+
+	for (i = 0; i < size_a && i < size_b; i++) {
+		if (lower(a[i]) != lower(b[i])) {
+			return lower(a[i]) < lower(b[i]) ? -1 : 1;
+		}
+	}
+	return size_a < size_b ? -1 : size_a > size_b ? 1 : 0;
+}
+
+static int
+sign(int c)
+{
+	return c < 0 ? -1 : c > 0 ? 1 : 0;
+}
+
+static ldns_rr *
+ns_rr(const ldns_rdf *name)
+{
+	ldns_rr *rr = ldns_rr_new();
+	ldns_rdf *owner = NULL;
+
+	ldns_rr_set_type(rr, LDNS_RR_TYPE_NS);
+	(void) ldns_str2rdf_dname(&owner, "dname.test.");
+	ldns_rr_set_owner(rr, owner);
+	(void) ldns_rr_push_rdf(rr, ldns_rdf_clone(name));
+	return rr;
+}
+
+static void
+print_names(const ldns_rdf *a, const ldns_rdf *b)
+{
+	ldns_rdf_print(stdout, a);
+	printf(" and ");
+	ldns_rdf_print(stdout, b);
+	printf("\n");
+}
+
+static bool
+test_pair(const uint8_t *a, size_t size_a, const uint8_t *b, size_t size_b)
+{
+	ldns_rdf *ra = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_DNAME, size_a, a);
+	ldns_rdf *rb = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_DNAME, size_b, b);
+	ldns_rdf *canon = ldns_rdf_clone(ra);
+	ldns_rr *rr_a = ns_rr(ra), *rr_b = ns_rr(rb);
+	ldns_dnssec_rrs *rrs = ldns_dnssec_rrs_new();
+	int expect = ref_compare(a, b), rdata_expect;
+	bool r = true;
+	size_t i;
+
+	if (sign(ldns_dname_compare(ra, rb)) != expect) {
+		printf("ldns_dname_compare() is %d, not %d, for ",
+				ldns_dname_compare(ra, rb), expect);
+		print_names(ra, rb);
+		r = false;
+	}
+	if (ldns_dname_is_subdomain(ra, rb)
+			!= ref_is_subdomain(a, size_a, b, size_b)) {
+		printf("ldns_dname_is_subdomain() is wrong for ");
+		print_names(ra, rb);
+		r = false;
+	}
+	ldns_dname2canonical(canon);
+	for (i = 0; i < size_a; i++) {
+		if (ldns_rdf_data(canon)[i] != lower(a[i])) {
+			printf("ldns_dname2canonical() is wrong at %d for ",
+					(int) i);
+			print_names(ra, canon);
+			r = false;
+			break;
+		}
+	}
+
+	/* in RDATA that is lowercased in the canonical form */
+	rdata_expect = ref_rdata_compare(a, size_a, b, size_b);
+	if (sign(ldns_rr_compare(rr_a, rr_b)) != rdata_expect) {
+		printf("ldns_rr_compare() is %d, not %d, for NS ",
+				ldns_rr_compare(rr_a, rr_b), rdata_expect);
+		print_names(ra, rb);
+		r = false;
+	}
+	/* which ldns_dnssec_rrs_add_rr() compares without wireformat */
+	rrs->rr = rr_a;
+	(void) ldns_dnssec_rrs_add_rr(rrs, rr_b);
+	if (rdata_expect == 0 ? rrs->next != NULL
+	    : rrs->rr != (rdata_expect < 0 ? rr_a : rr_b)) {
+		printf("ldns_dnssec_rrs_add_rr() orders wrongly NS ");
+		print_names(ra, rb);
+		r = false;
+	}
+	if (rdata_expect == 0) {
+		ldns_rr_free(rr_b);
+	}
+	ldns_dnssec_rrs_deep_free(rrs);
+	ldns_rdf_deep_free(ra);
+	ldns_rdf_deep_free(rb);
+	ldns_rdf_deep_free(canon);
+	return r;
+}
+
+int main(void)
+{
+	uint8_t a[LDNS_MAX_DOMAINLEN + 1], b[LDNS_MAX_DOMAINLEN + 1];
+	size_t size_a, size_b, i, failed = 0;
+
+	for (i = 0; i < ROUNDS && failed < 10; i++) {
+		size_a = random_name(a);
+		size_b = related_name(b, a, size_a);
+		if (!test_pair(a, size_a, b, size_b) ||
+		    !test_pair(b, size_b, a, size_a)) {
+			failed++;
+		}
+	}
+	if (failed) {
+		printf("comparing names failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	exit(EXIT_SUCCESS);
+}
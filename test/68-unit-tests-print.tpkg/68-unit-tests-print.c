@@ -0,0 +1,371 @@
+/*
+ * Unit tests for printing RR lists and zones through the buffered writer
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+/* enough RRs for the output to be written in several chunks */
+#define RR_COUNT 6000
+
+static const char *rrs_str[] = {
+	"a\\000b.\\.dot.\\032sp.print.test. 0 IN A 192.0.2.1",
+	"max.print.test. 2147483647 IN TXT \"a\\\"b\\\\c\\009\\255\" \"\"",
+	"mx.print.test. 3600 IN MX 65535 m\\@x.print.test.",
+	"srv.print.test. 3600 IN SRV 0 65535 1 t.print.test.",
+	"print.test. 3600 IN SOA ns.print.test. h\\.m.print.test. "
+		"4294967295 1 2 3 4",
+	"ds.print.test. 3600 IN DS 65535 8 2 "
+		"2bb183af5f22588179a53b0a98631fad1a292118"
+		"f19b3fee4c1d1de4de8dc2ca",
+	"key.print.test. 3600 IN DNSKEY 257 3 8 "
+		"AwEAAcFcGsaxxdgiuuGmCkVImy4h99CqT7jwY3pexPGcnUFtR2Fh36Bp"
+		"oZojx6OzYXPKuntpBpyDH4LcgqaB+vqeXX2ZdQy5jGEXgEsc8LXwBOHz",
+	"sig.print.test. 3600 IN RRSIG A 8 3 3600 20260101000000 "
+		"20251201000000 65535 print.test. dGVzdA==",
+	"nsec.print.test. 3600 IN NSEC a.print.test. A NS SOA RRSIG NSEC "
+		"TYPE65534",
+	"2t7b4g4vsa5smi47k61mv5bv1a22bojr.print.test. 3600 IN NSEC3 1 1 12 "
+		"aabbccdd 2T7B4G4VSA5SMI47K61MV5BV1A22BOJS A RRSIG",
+	"t.print.test. 3600 IN TYPE65280 \\# 3 010203",
+	"loc.print.test. 3600 IN LOC 52 22 23.000 N 4 53 32.000 E "
+		"-2.00m 0.00m 10000m 10m",
+	"aaaa.print.test. 3600 CH AAAA 2001:db8::1",
+	"caa.print.test. 3600 IN CAA 0 issue \"ca.example\"",
+	"\\255\\128.print.test. 3600 IN PTR \\(x\\).print.test.",
+	"long.print.test. 1 IN TXT "
+		"\"0123456789012345678901234567890123456789012345678901234567\""
+		" \"\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\""
+};
+#define N_RRS_STR (sizeof(rrs_str) / sizeof(rrs_str[0]))
+
+static const char *labels[] = {
+	"a", "B", "\\000", "\\.", "\\032", "x-y", "\\\\", "\\255", "long-label-"
+	"0123456789012345678901234567890123456789012345678"
+};
+#define N_LABELS (sizeof(labels) / sizeof(labels[0]))
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static ldns_rr *
+new_rr(const char *str)
+{
+	ldns_rr *rr = NULL;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "could not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+static ldns_rr *
+random_rr(void)
+{
+	char str[512];
+	size_t len = 0;
+	uint32_t i, depth = 1 + rnd(3);
+
+	if (rnd(8) == 0) {
+		return new_rr(rrs_str[rnd(N_RRS_STR)]);
+	}
+	for (i = 0; i < depth; i++) {
+		len += (size_t) snprintf(str + len, sizeof(str) - len, "%s.",
+				labels[rnd(N_LABELS)]);
+	}
+	switch (rnd(4)) {
+	case 0:
+		snprintf(str + len, sizeof(str) - len,
+				"print.test. %u IN A 10.%u.%u.%u",
+				rnd(2147483647), rnd(256), rnd(256), rnd(256));
+		break;
+	case 1:
+		snprintf(str + len, sizeof(str) - len,
+				"print.test. %u IN MX %u mx%u.print.test.",
+				rnd(100000), rnd(65536), rnd(1000));
+		break;
+	case 2:
+		snprintf(str + len, sizeof(str) - len,
+				"print.test. %u IN TXT \"t\\%03u\" \"%u\"",
+				rnd(10), rnd(256), rnd(4000000));
+		break;
+	default:
+		snprintf(str + len, sizeof(str) - len,
+				"print.test. 3600 IN SRV %u %u %u s.print.test.",
+				rnd(65536), rnd(65536), rnd(65536));
+		break;
+	}
+	return new_rr(str);
+}
+
+/* What was printed to fp, as a string */
+static char *
+printed(FILE *fp)
+{
+	long size = ftell(fp);
+	char *str = LDNS_XMALLOC(char, (size_t) size + 1);
+
+	rewind(fp);
+	if (!str || fread(str, 1, (size_t) size, fp) != (size_t) size) {
+		fprintf(stderr, "could not read back what was printed\n");
+		exit(EXIT_FAILURE);
+	}
+	str[size] = '\0';
+	fclose(fp);
+	return str;
+}
+
+/* Appends str to the expected output */
+static void
+expect_add(ldns_buffer *expect, char *str)
+{
+	if (!str) {
+		fprintf(stderr, "could not convert to a string\n");
+		exit(EXIT_FAILURE);
+	}
+	(void) ldns_buffer_printf(expect, "%s", str);
+	LDNS_FREE(str);
+}
+
+static bool
+same(const char *got, ldns_buffer *expect, const char *what)
+{
+	const char *e = (const char *) ldns_buffer_begin(expect);
+	size_t i;
+
+	if (strlen(got) == ldns_buffer_position(expect) &&
+	    memcmp(got, e, ldns_buffer_position(expect)) == 0) {
+		return true;
+	}
+	for (i = 0; got[i] && got[i] == e[i]; i++)
+		;
+	printf("%s: printed %d bytes, expected %d, differing from byte %d: "
+	       "\"%.60s\" instead of \"%.60s\"\n", what, (int) strlen(got),
+	       (int) ldns_buffer_position(expect), (int) i, got + i, e + i);
+	return false;
+}
+
+static bool
+test_print(const ldns_output_format *fmt, const char *what)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	ldns_zone *zone = ldns_zone_new();
+	ldns_buffer *expect = ldns_buffer_new(1024);
+	FILE *fp;
+	char *got;
+	bool r = true;
+	size_t i;
+
+	seed = 1;
+	for (i = 0; i < RR_COUNT; i++) {
+		(void) ldns_rr_list_push_rr(rrs, random_rr());
+	}
+
+	/* an RR list is printed like its RRs one by one */
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		expect_add(expect, ldns_rr2str_fmt(fmt,
+				ldns_rr_list_rr(rrs, i)));
+	}
+	fp = tmpfile();
+	ldns_rr_list_print_fmt(fp, fmt, rrs);
+	got = printed(fp);
+	r = same(got, expect, what) && r;
+	LDNS_FREE(got);
+
+	/* and so are the RRs one by one */
+	fp = tmpfile();
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		ldns_rr_print_fmt(fp, fmt, ldns_rr_list_rr(rrs, i));
+	}
+	got = printed(fp);
+	r = same(got, expect, what) && r;
+	LDNS_FREE(got);
+
+	/* a zone is its SOA and then its other RRs */
+	ldns_buffer_clear(expect);
+	ldns_zone_set_soa(zone, new_rr(rrs_str[4]));
+	expect_add(expect, ldns_rr2str_fmt(fmt, ldns_zone_soa(zone)));
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		expect_add(expect, ldns_rr2str_fmt(fmt,
+				ldns_rr_list_rr(rrs, i)));
+	}
+	ldns_rr_list_free(ldns_zone_rrs(zone));
+	ldns_zone_set_rrs(zone, rrs);
+	fp = tmpfile();
+	ldns_zone_print_fmt(fp, fmt, zone);
+	got = printed(fp);
+	r = same(got, expect, what) && r;
+	LDNS_FREE(got);
+
+	ldns_zone_deep_free(zone);
+	ldns_buffer_free(expect);
+	return r;
+}
+
+/* How earlier versions of ldns printed these RRs */
+static const char *rrs_printed[] = {
+	"a\\000b.\\.dot.\\032sp.print.test.\t0\tIN\tA\t192.0.2.1\n",
+	"max.print.test.\t2147483647\tIN\tTXT\t\"a\\\"b\\\\c\t\\255\" \"\"\n",
+	"mx.print.test.\t3600\tIN\tMX\t65535 m@x.print.test.\n",
+	"srv.print.test.\t3600\tIN\tSRV\t0 65535 1 t.print.test.\n",
+	"print.test.\t3600\tIN\tSOA\tns.print.test. h\\.m.print.test. 4294967295 1 2 3 4\n",
+	"ds.print.test.\t3600\tIN\tDS\t65535 8 2 2bb183af5f22588179a53b0a98631fad1a292118f19b3fee4c1d1de4de8dc2ca\n",
+	"key.print.test.\t3600\tIN\tDNSKEY\t257 3 8 AwEAAcFcGsaxxdgiuuGmCkVImy4h99CqT7jwY3pexPGcnUFtR2Fh36BpoZojx6OzYXPKuntpBpyDH4LcgqaB+vqeXX2ZdQy5jGEXgEsc8LXwBOHz ;{id = 6683 (ksk), size = 640b}\n",
+	"sig.print.test.\t3600\tIN\tRRSIG\tA 8 3 3600 20260101000000 20251201000000 65535 print.test. dGVzdA==\n",
+	"nsec.print.test.\t3600\tIN\tNSEC\ta.print.test. A NS SOA RRSIG NSEC TYPE65534 \n",
+	"2t7b4g4vsa5smi47k61mv5bv1a22bojr.print.test.\t3600\tIN\tNSEC3\t1 1 12 aabbccdd  2t7b4g4vsa5smi47k61mv5bv1a22bojs A RRSIG \n",
+	"t.print.test.\t3600\tIN\tTYPE65280\t\\# 3 010203\n",
+	"loc.print.test.\t3600\tIN\tLOC\t52 22 23.000 N 04 53 32.000 E -2m 0.00m 10000m 10m\n",
+	"aaaa.print.test.\t3600\tCH\tAAAA\t2001:db8::1\n",
+	"caa.print.test.\t3600\tIN\tCAA\t0 issue \"ca.example\"\n",
+	"\\255\\128.print.test.\t3600\tIN\tPTR\t\\(x\\).print.test.\n",
+	"long.print.test.\t1\tIN\tTXT\t\"0123456789012345678901234567890123456789012345678901234567\" \"\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\"\n"
+};
+
+static bool
+test_printed(void)
+{
+	bool r = true;
+	char *str;
+	ldns_rr *rr;
+	size_t i;
+
+	for (i = 0; i < N_RRS_STR; i++) {
+		rr = new_rr(rrs_str[i]);
+		str = ldns_rr2str_fmt(ldns_output_format_default, rr);
+		if (!rrs_printed[i] || !str || strcmp(str, rrs_printed[i])) {
+			printf("printed %s", str ? str : "nothing\n");
+			printf("instead of %s", rrs_printed[i] ?
+					rrs_printed[i] : "(nothing)\n");
+			r = false;
+		}
+		LDNS_FREE(str);
+		ldns_rr_free(rr);
+	}
+	return r;
+}
+
+/* How earlier versions of ldns printed this ldns_dnssec_zone, without
+ * and with the layout comments */
+static const char *zone_printed[] = {
+	"print.test.\t3600\tIN\tSOA\tns.print.test. h\\.m.print.test. 4294967295 1 2 3 4\n"
+	"a\\000b.\\.dot.\\032sp.print.test.\t0\tIN\tA\t192.0.2.1\n"
+	"aaaa.print.test.\t3600\tCH\tAAAA\t2001:db8::1\n"
+	"caa.print.test.\t3600\tIN\tCAA\t0 issue \"ca.example\"\n"
+	"ds.print.test.\t3600\tIN\tDS\t65535 8 2 2bb183af5f22588179a53b0a98631fad1a292118f19b3fee4c1d1de4de8dc2ca\n"
+	"key.print.test.\t3600\tIN\tDNSKEY\t257 3 8 AwEAAcFcGsaxxdgiuuGmCkVImy4h99CqT7jwY3pexPGcnUFtR2Fh36BpoZojx6OzYXPKuntpBpyDH4LcgqaB+vqeXX2ZdQy5jGEXgEsc8LXwBOHz ;{id = 6683 (ksk), size = 640b}\n"
+	"loc.print.test.\t3600\tIN\tLOC\t52 22 23.000 N 04 53 32.000 E -2m 0.00m 10000m 10m\n"
+	"long.print.test.\t1\tIN\tTXT\t\"0123456789012345678901234567890123456789012345678901234567\" \"\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\"\n"
+	"max.print.test.\t2147483647\tIN\tTXT\t\"a\\\"b\\\\c\t\\255\" \"\"\n"
+	"mx.print.test.\t3600\tIN\tMX\t65535 m@x.print.test.\n"
+	"nsec.print.test.\t3600\tIN\tNSEC\ta.print.test. A NS SOA RRSIG NSEC TYPE65534 \n"
+	"srv.print.test.\t3600\tIN\tSRV\t0 65535 1 t.print.test.\n"
+	"t.print.test.\t3600\tIN\tTYPE65280\t\\# 3 010203\n"
+	"\\255\\128.print.test.\t3600\tIN\tPTR\t\\(x\\).print.test.\n",
+	";; Zone: print.test.\n"
+	";\n"
+	"print.test.\t3600\tIN\tSOA\tns.print.test. h\\.m.print.test. 4294967295 1 2 3 4\n"
+	";\n"
+	";\n"
+	"a\\000b.\\.dot.\\032sp.print.test.\t0\tIN\tA\t192.0.2.1\n"
+	";\n"
+	"aaaa.print.test.\t3600\tCH\tAAAA\t2001:db8::1\n"
+	";\n"
+	"caa.print.test.\t3600\tIN\tCAA\t0 issue \"ca.example\"\n"
+	";\n"
+	"ds.print.test.\t3600\tIN\tDS\t65535 8 2 2bb183af5f22588179a53b0a98631fad1a292118f19b3fee4c1d1de4de8dc2ca\n"
+	";\n"
+	"key.print.test.\t3600\tIN\tDNSKEY\t257 3 8 AwEAAcFcGsaxxdgiuuGmCkVImy4h99CqT7jwY3pexPGcnUFtR2Fh36BpoZojx6OzYXPKuntpBpyDH4LcgqaB+vqeXX2ZdQy5jGEXgEsc8LXwBOHz\n"
+	";\n"
+	"loc.print.test.\t3600\tIN\tLOC\t52 22 23.000 N 04 53 32.000 E -2m 0.00m 10000m 10m\n"
+	";\n"
+	"long.print.test.\t1\tIN\tTXT\t\"0123456789012345678901234567890123456789012345678901234567\" \"\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\"\n"
+	";\n"
+	"max.print.test.\t2147483647\tIN\tTXT\t\"a\\\"b\\\\c\t\\255\" \"\"\n"
+	";\n"
+	"mx.print.test.\t3600\tIN\tMX\t65535 m@x.print.test.\n"
+	";\n"
+	";; Empty nonterminal: nsec.print.test.\n"
+	"nsec.print.test.\t3600\tIN\tNSEC\ta.print.test. A NS SOA RRSIG NSEC TYPE65534 \n"
+	";\n"
+	";\n"
+	"srv.print.test.\t3600\tIN\tSRV\t0 65535 1 t.print.test.\n"
+	";\n"
+	"t.print.test.\t3600\tIN\tTYPE65280\t\\# 3 010203\n"
+	";\n"
+	"\\255\\128.print.test.\t3600\tIN\tPTR\t\\(x\\).print.test.\n"
+	";\n"
+};
+
+static bool
+test_dnssec_zone(void)
+{
+	ldns_output_format layout = { LDNS_COMMENT_LAYOUT, NULL };
+	const ldns_output_format *fmts[2];
+	ldns_dnssec_zone *zone = ldns_dnssec_zone_new();
+	ldns_rr *rr;
+	FILE *fp;
+	char *got;
+	bool r = true;
+	size_t i;
+
+	fmts[0] = ldns_output_format_default;
+	fmts[1] = &layout;
+	for (i = 0; i < N_RRS_STR; i++) {
+		rr = new_rr(rrs_str[i]);
+		/* but not the NSEC3, which has no name in the zone */
+		if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_NSEC3 ||
+		    ldns_dnssec_zone_add_rr(zone, rr) != LDNS_STATUS_OK) {
+			ldns_rr_free(rr);
+		}
+	}
+	for (i = 0; i < 2; i++) {
+		fp = tmpfile();
+		ldns_dnssec_zone_print_fmt(fp, fmts[i], zone);
+		got = printed(fp);
+		if (!zone_printed[i] || strcmp(got, zone_printed[i]) != 0) {
+			printf("printed the zone as:\n%s\ninstead of:\n%s\n",
+					got, zone_printed[i] ?
+					zone_printed[i] : "(nothing)");
+			r = false;
+		}
+		LDNS_FREE(got);
+	}
+	ldns_dnssec_zone_deep_free(zone);
+	return r;
+}
+
+int main(void)
+{
+	ldns_output_format layout = { LDNS_COMMENT_LAYOUT | LDNS_COMMENT_KEY
+		| LDNS_COMMENT_BUBBLEBABBLE | LDNS_COMMENT_FLAGS
+		| LDNS_FMT_ZEROIZE_RRSIGS | LDNS_FMT_PAD_SOA_SERIAL, NULL };
+	ldns_output_format short_fmt = { LDNS_FMT_SHORT, NULL };
+	int result = EXIT_SUCCESS;
+
+	if (!test_print(ldns_output_format_nocomments, "nocomments") ||
+	    !test_print(ldns_output_format_default, "default") ||
+	    !test_print(ldns_output_format_bubblebabble, "bubblebabble") ||
+	    !test_print(&layout, "layout") ||
+	    !test_print(&short_fmt, "short")) {
+		printf("test_print() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_printed()) {
+		printf("test_printed() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_dnssec_zone()) {
+		printf("test_dnssec_zone() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	exit(result);
+}
@@ -0,0 +1,351 @@
+/*
+ * Unit tests for the per thread pools of recycled buffers and packets
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* as in buffer.c and packet.c; buffers of twice the largest size
+ * class are not pooled */
+#define BUFFER_POOL_MIN   512
+#define BUFFER_POOL_MAX   (BUFFER_POOL_MIN << 7)
+#define BUFFER_POOL_DEPTH 8
+#define PKT_POOL_DEPTH    16
+#define PKT_POOL_MAX_RRS  64
+
+/* Whether a buffer from the pool is cleared and can be written to its
+ * full capacity */
+static bool
+buffer_is_new(ldns_buffer *buffer, size_t capacity, const char *what)
+{
+	if (!buffer) {
+		printf("%s: no buffer\n", what);
+		return false;
+	}
+	if (ldns_buffer_capacity(buffer) < capacity ||
+	    ldns_buffer_position(buffer) != 0 ||
+	    ldns_buffer_limit(buffer) != ldns_buffer_capacity(buffer) ||
+	    ldns_buffer_status(buffer) != LDNS_STATUS_OK) {
+		printf("%s: buffer of capacity %d at %d with limit %d, for "
+		       "%d\n", what, (int) ldns_buffer_capacity(buffer),
+		       (int) ldns_buffer_position(buffer),
+		       (int) ldns_buffer_limit(buffer), (int) capacity);
+		return false;
+	}
+	memset(ldns_buffer_begin(buffer), 0xff, ldns_buffer_capacity(buffer));
+	return true;
+}
+
+static bool
+test_buffers(void)
+{
+	ldns_buffer *recycled[BUFFER_POOL_DEPTH + 4], *b, *b2, *sentinel;
+	void *data;
+	bool r = true;
+	size_t i;
+
+	/* a recycled buffer comes back cleared, for any capacity of its
+	 * size class */
+	b = ldns_buffer_new_pooled(100);
+	r = buffer_is_new(b, 100, "new") && r;
+	(void) ldns_buffer_printf(b, "some text");
+	ldns_buffer_set_limit(b, ldns_buffer_position(b));
+	b->_status = LDNS_STATUS_MEM_ERR;
+	ldns_buffer_recycle(b);
+	b2 = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	if (b2 != b) {
+		printf("a recycled buffer was not used again\n");
+		r = false;
+	}
+	r = buffer_is_new(b2, BUFFER_POOL_MIN, "recycled") && r;
+
+	/* a buffer is pooled in the largest class it has the capacity
+	 * for; not for a larger one */
+	ldns_buffer_recycle(b2);
+	b = ldns_buffer_new(BUFFER_POOL_MIN * 2 - 1);
+	ldns_buffer_recycle(b);
+	b2 = ldns_buffer_new_pooled(BUFFER_POOL_MIN + 1);
+	if (b2 == b) {
+		printf("a buffer too small was taken from the pool\n");
+		r = false;
+	}
+	r = buffer_is_new(b2, BUFFER_POOL_MIN + 1, "larger class") && r;
+	ldns_buffer_free(b2);
+	b2 = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	if (b2 != b) {
+		printf("a buffer was not pooled in its size class\n");
+		r = false;
+	}
+	r = buffer_is_new(b2, BUFFER_POOL_MIN, "smaller class") && r;
+	sentinel = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	ldns_buffer_free(b2);
+
+	/* buffers too large or exported are not pooled; then the one
+	 * recycled before is still on top */
+	b = ldns_buffer_new(BUFFER_POOL_MIN);
+	data = ldns_buffer_export(b);
+	LDNS_FREE(data);
+	ldns_buffer_recycle(sentinel);
+	ldns_buffer_recycle(ldns_buffer_new(BUFFER_POOL_MAX * 2));
+	ldns_buffer_recycle(b);
+	b = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	if (b != sentinel) {
+		printf("a buffer that should be freed was pooled\n");
+		r = false;
+	}
+	b2 = ldns_buffer_new_pooled(BUFFER_POOL_MAX * 2);
+	r = buffer_is_new(b2, BUFFER_POOL_MAX * 2, "not pooled") && r;
+	ldns_buffer_free(b2);
+	ldns_buffer_free(b);
+
+	/* no more buffers than the depth of the pool are kept, and the
+	 * last one kept comes back first */
+	for (i = 0; i < BUFFER_POOL_DEPTH + 4; i++) {
+		recycled[i] = ldns_buffer_new(BUFFER_POOL_MIN);
+	}
+	for (i = 0; i < BUFFER_POOL_DEPTH + 4; i++) {
+		ldns_buffer_recycle(recycled[i]);
+	}
+	for (i = 0; i < BUFFER_POOL_DEPTH; i++) {
+		b = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+		if (b != recycled[BUFFER_POOL_DEPTH - 1 - i]) {
+			printf("buffer %d did not come from the pool\n",
+					(int) i);
+			r = false;
+		}
+		r = buffer_is_new(b, BUFFER_POOL_MIN, "depth") && r;
+		recycled[BUFFER_POOL_DEPTH - 1 - i] = b;
+	}
+	for (i = 0; i < BUFFER_POOL_DEPTH; i++) {
+		ldns_buffer_recycle(recycled[i]);
+	}
+	/* until they are freed */
+	ldns_buffer_pool_free();
+	b = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	r = buffer_is_new(b, BUFFER_POOL_MIN, "pool freed") && r;
+	ldns_buffer_recycle(b);
+	return r;
+}
+
+static ldns_rr *
+new_rr(const char *str)
+{
+	ldns_rr *rr = NULL;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "could not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+/* A response with n RRs in the answer section, and more set in it */
+static void
+fill_pkt(ldns_pkt *pkt, size_t n)
+{
+	ldns_rdf *from = NULL;
+	ldns_rr *question = NULL;
+	size_t i;
+
+	ldns_pkt_set_id(pkt, 4711);
+	ldns_pkt_set_qr(pkt, true);
+	ldns_pkt_set_aa(pkt, true);
+	ldns_pkt_set_rcode(pkt, LDNS_RCODE_NXDOMAIN);
+	ldns_pkt_set_edns_udp_size(pkt, 1232);
+	ldns_pkt_set_edns_do(pkt, true);
+	ldns_pkt_set_querytime(pkt, 10);
+	(void) ldns_str2rdf_a(&from, "192.0.2.1");
+	ldns_pkt_set_answerfrom(pkt, from);
+	(void) ldns_rr_new_question_frm_str(&question, "pool.test. IN A",
+			NULL, NULL);
+	(void) ldns_pkt_push_rr(pkt, LDNS_SECTION_QUESTION, question);
+	for (i = 0; i < n; i++) {
+		(void) ldns_pkt_push_rr(pkt, LDNS_SECTION_ANSWER,
+				new_rr("pool.test. 3600 IN A 192.0.2.1"));
+	}
+	(void) ldns_pkt_push_rr(pkt, LDNS_SECTION_AUTHORITY,
+			new_rr("test. 3600 IN NS ns.pool.test."));
+	(void) ldns_pkt_push_rr(pkt, LDNS_SECTION_ADDITIONAL,
+			new_rr("ns.pool.test. 3600 IN A 192.0.2.2"));
+}
+
+/* Whether a packet from the pool is printed like a new one */
+static bool
+pkt_is_new(ldns_pkt *pkt, const char *what)
+{
+	ldns_pkt *fresh = ldns_pkt_new();
+	char *got = ldns_pkt2str(pkt), *expect = ldns_pkt2str(fresh);
+	bool r = got && expect && strcmp(got, expect) == 0 &&
+		ldns_pkt_edns_udp_size(pkt) == 0 && !ldns_pkt_edns(pkt) &&
+		ldns_pkt_querytime(pkt) == 0 && !ldns_pkt_answerfrom(pkt) &&
+		!ldns_pkt_tsig(pkt) && ldns_pkt_ancount(pkt) == 0 &&
+		ldns_rr_list_rr_count(ldns_pkt_answer(pkt)) == 0;
+
+	if (!r) {
+		printf("%s: printed as\n%s\ninstead of\n%s\n", what,
+				got ? got : "(nothing)",
+				expect ? expect : "(nothing)");
+	}
+	LDNS_FREE(got);
+	LDNS_FREE(expect);
+	ldns_pkt_free(fresh);
+	return r;
+}
+
+static bool
+test_packets(void)
+{
+	ldns_pkt *recycled[PKT_POOL_DEPTH + 4], *p, *p2, *big;
+	bool r = true;
+	size_t i;
+
+	/* a recycled packet comes back empty, with the capacity of its
+	 * sections kept */
+	p = ldns_pkt_new_pooled();
+	r = pkt_is_new(p, "new") && r;
+	fill_pkt(p, 20);
+	ldns_pkt_recycle(p);
+	p2 = ldns_pkt_new_pooled();
+	if (p2 != p) {
+		printf("a recycled packet was not used again\n");
+		r = false;
+	}
+	r = pkt_is_new(p2, "recycled") && r;
+	if (ldns_pkt_answer(p2)->_rr_capacity < 20) {
+		printf("the answer section of a recycled packet shrank\n");
+		r = false;
+	}
+	/* and can be filled again */
+	fill_pkt(p2, 5);
+	if (ldns_pkt_ancount(p2) != 5 || ldns_pkt_id(p2) != 4711) {
+		printf("a recycled packet could not be filled again\n");
+		r = false;
+	}
+
+	/* a packet with large sections is not pooled; then the one
+	 * recycled before is still on top */
+	ldns_pkt_recycle(p2);
+	big = ldns_pkt_new();
+	fill_pkt(big, PKT_POOL_MAX_RRS + 1);
+	ldns_pkt_recycle(big);
+	p = ldns_pkt_new_pooled();
+	if (p != p2) {
+		printf("a packet with large sections was pooled\n");
+		r = false;
+	}
+	r = pkt_is_new(p, "after a large packet") && r;
+	ldns_pkt_free(p);
+
+	/* no more packets than the depth of the pool are kept */
+	for (i = 0; i < PKT_POOL_DEPTH + 4; i++) {
+		recycled[i] = ldns_pkt_new();
+		fill_pkt(recycled[i], i);
+	}
+	for (i = 0; i < PKT_POOL_DEPTH + 4; i++) {
+		ldns_pkt_recycle(recycled[i]);
+	}
+	for (i = 0; i < PKT_POOL_DEPTH; i++) {
+		p = ldns_pkt_new_pooled();
+		if (p != recycled[PKT_POOL_DEPTH - 1 - i]) {
+			printf("packet %d did not come from the pool\n",
+					(int) i);
+			r = false;
+		}
+		r = pkt_is_new(p, "depth") && r;
+		recycled[PKT_POOL_DEPTH - 1 - i] = p;
+	}
+	for (i = 0; i < PKT_POOL_DEPTH; i++) {
+		ldns_pkt_recycle(recycled[i]);
+	}
+	ldns_pkt_pool_free();
+	p = ldns_pkt_new_pooled();
+	r = pkt_is_new(p, "pool freed") && r;
+	/* left in the pool of the main thread, which is freed at exit */
+	ldns_pkt_recycle(p);
+	return r;
+}
+
+#ifdef HAVE_PTHREAD
+struct thread_arg
+{
+	ldns_buffer *main_buffer;
+	ldns_pkt *main_pkt;
+	bool r;
+};
+
+/* Does not get what the main thread recycled, and leaves things in its
+ * own pools, which are freed when it exits */
+static void *
+thread_main(void *arg)
+{
+	struct thread_arg *t = arg;
+	ldns_buffer *b = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	ldns_pkt *p = ldns_pkt_new_pooled();
+
+	t->r = b != t->main_buffer && p != t->main_pkt &&
+		buffer_is_new(b, BUFFER_POOL_MIN, "thread") &&
+		pkt_is_new(p, "thread") && test_buffers() && test_packets();
+	fill_pkt(p, 3);
+	ldns_pkt_recycle(p);
+	ldns_buffer_recycle(b);
+	return NULL;
+}
+
+static bool
+test_threads(void)
+{
+	struct thread_arg t;
+	pthread_t thread;
+	bool r = true;
+
+	t.main_buffer = ldns_buffer_new_pooled(BUFFER_POOL_MIN);
+	t.main_pkt = ldns_pkt_new_pooled();
+	t.r = false;
+	ldns_buffer_recycle(t.main_buffer);
+	ldns_pkt_recycle(t.main_pkt);
+	if (pthread_create(&thread, NULL, thread_main, &t) != 0 ||
+	    pthread_join(thread, NULL) != 0) {
+		printf("could not run a thread\n");
+		return false;
+	}
+	if (!t.r) {
+		printf("the pools of a thread were not its own\n");
+		r = false;
+	}
+	/* what the main thread recycled is still there */
+	if (ldns_buffer_new_pooled(BUFFER_POOL_MIN) != t.main_buffer ||
+	    ldns_pkt_new_pooled() != t.main_pkt) {
+		printf("the pools of the main thread were changed\n");
+		r = false;
+	}
+	ldns_buffer_recycle(t.main_buffer);
+	ldns_pkt_recycle(t.main_pkt);
+	return r;
+}
+#endif /* HAVE_PTHREAD */
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_buffers()) {
+		printf("test_buffers() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_packets()) {
+		printf("test_packets() failed.\n");
+		result = EXIT_FAILURE;
+	}
+#ifdef HAVE_PTHREAD
+	if (!test_threads()) {
+		printf("test_threads() failed.\n");
+		result = EXIT_FAILURE;
+	}
+#endif
+	exit(result);
+}
@@ -0,0 +1,309 @@
+/*
+ * Unit tests for sharing RRs and names, and for changing them after they
+ * are unshared
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+/* RRs with upper case in their owner and in names in their rdata, which
+ * ldns_rr2canonical() lowercases */
+static const char *rrs_str[] = {
+	"Share.TEST. 3600 IN NS NS1.Share.TEST.",
+	"Share.TEST. 3600 IN MX 10 Mail.Share.TEST.",
+	"Share.TEST. 3600 IN SOA NS1.Share.TEST. Host.Share.TEST. 1 2 3 4 5",
+	"Share.TEST. 3600 IN A 192.0.2.1",
+	"Www.Share.TEST. 3600 IN CNAME Share.TEST.",
+	"Srv.Share.TEST. 3600 IN SRV 0 1 2 Target.Share.TEST.",
+	"Share.TEST. 3600 IN RRSIG A 8 2 3600 20260101000000 "
+		"20251201000000 1 Share.TEST. dGVzdA=="
+};
+#define N_RRS_STR (sizeof(rrs_str) / sizeof(rrs_str[0]))
+
+static ldns_rr *
+new_rr(const char *str)
+{
+	ldns_rr *rr = NULL;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "could not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+/* Whether rr prints as str */
+static bool
+prints_as(const ldns_rr *rr, const char *str, const char *what)
+{
+	char *got = ldns_rr2str(rr);
+	bool r = got && strcmp(got, str) == 0;
+
+	if (!r) {
+		printf("%s: printed %sinstead of %s", what,
+				got ? got : "nothing\n", str);
+	}
+	LDNS_FREE(got);
+	return r;
+}
+
+/* Changes an RR the caller has to itself in every way there is */
+static void
+change(ldns_rr *rr)
+{
+	ldns_rdf *suffix = ldns_dname_new_frm_str("changed.");
+	size_t i;
+
+	ldns_rr2canonical(rr);
+	ldns_rr_set_ttl(rr, 1);
+	ldns_rr_set_class(rr, LDNS_RR_CLASS_CH);
+	for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+		if (ldns_rdf_get_type(ldns_rr_rdf(rr, i))
+				== LDNS_RDF_TYPE_DNAME) {
+			(void) ldns_dname_cat(ldns_rr_rdf(rr, i), suffix);
+		}
+	}
+	(void) ldns_dname_cat(ldns_rr_owner(rr), suffix);
+	ldns_rdf_deep_free(suffix);
+}
+
+/* The reference to an RR that ldns_rr_unshare() is called for becomes
+ * a copy of its own, which can be changed without the other holder
+ * seeing it */
+static bool
+test_ref(void)
+{
+	ldns_rr *rr, *ref, *copy;
+	char *str;
+	bool r = true;
+	size_t i;
+
+	for (i = 0; i < N_RRS_STR; i++) {
+		rr = new_rr(rrs_str[i]);
+		str = ldns_rr2str(rr);
+		if (ldns_rr_is_shared(rr) || ldns_rr_unshare(rr) != rr) {
+			printf("RR %d is shared before a reference to it\n",
+					(int) i);
+			r = false;
+		}
+		ref = ldns_rr_ref(rr);
+		if (ref != rr || !ldns_rr_is_shared(rr)) {
+			printf("RR %d is not shared by a reference\n", (int) i);
+			r = false;
+		}
+		copy = ldns_rr_unshare(ref);
+		if (!copy || copy == rr || ldns_rr_is_shared(rr)
+		          || ldns_rr_is_shared(copy)) {
+			printf("RR %d is not a copy of its own when "
+			       "unshared\n", (int) i);
+			ldns_rr_free(rr);
+			LDNS_FREE(str);
+			return false;
+		}
+		if (ldns_rr_owner(copy) == ldns_rr_owner(rr) ||
+		    (ldns_rr_rd_count(rr) > 0 &&
+		     ldns_rr_rdf(copy, 0) == ldns_rr_rdf(rr, 0))) {
+			printf("RR %d shares names with its copy\n", (int) i);
+			r = false;
+		}
+		change(copy);
+		r = prints_as(rr, str, "the RR of a changed copy") && r;
+		ldns_rr_free(copy);
+		r = prints_as(rr, str, "the RR of a freed copy") && r;
+		ldns_rr_free(rr);
+		LDNS_FREE(str);
+	}
+	return r;
+}
+
+static ldns_rr_list *
+new_list(void)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	size_t i;
+
+	for (i = 0; i < N_RRS_STR; i++) {
+		(void) ldns_rr_list_push_rr(rrs, new_rr(rrs_str[i]));
+	}
+	return rrs;
+}
+
+/* A list of shared RRs, of which the RRs are changed after they are
+ * unshared, and the list it shares them with */
+static bool
+test_list_share(bool free_first)
+{
+	ldns_rr_list *rrs = new_list(), *shared;
+	ldns_rr *rr;
+	char *str[N_RRS_STR];
+	bool r = true;
+	size_t i;
+
+	for (i = 0; i < N_RRS_STR; i++) {
+		str[i] = ldns_rr2str(ldns_rr_list_rr(rrs, i));
+	}
+	shared = ldns_rr_list_share(rrs);
+	for (i = 0; i < N_RRS_STR; i++) {
+		if (ldns_rr_list_rr(shared, i) != ldns_rr_list_rr(rrs, i) ||
+		    !ldns_rr_is_shared(ldns_rr_list_rr(rrs, i))) {
+			printf("RR %d of a list is not shared\n", (int) i);
+			r = false;
+		}
+	}
+	/* which outlives the list it shares them with */
+	if (free_first) {
+		ldns_rr_list_deep_free(rrs);
+		rrs = ldns_rr_list_share(shared);
+		ldns_rr_list_deep_free(shared);
+		shared = ldns_rr_list_share(rrs);
+	}
+	/* every other RR is changed, the others stay shared */
+	for (i = 0; i < N_RRS_STR; i += 2) {
+		rr = ldns_rr_unshare(ldns_rr_list_rr(shared, i));
+		(void) ldns_rr_list_set_rr(shared, rr, i);
+		change(rr);
+	}
+	for (i = 0; i < N_RRS_STR; i++) {
+		r = prints_as(ldns_rr_list_rr(rrs, i), str[i],
+				"an RR of a list with changed copies") && r;
+		if (ldns_rr_is_shared(ldns_rr_list_rr(rrs, i)) != (i % 2)) {
+			printf("RR %d of a list is %sshared\n", (int) i,
+					i % 2 ? "not " : "");
+			r = false;
+		}
+	}
+	ldns_rr_list_deep_free(shared);
+	for (i = 0; i < N_RRS_STR; i++) {
+		r = prints_as(ldns_rr_list_rr(rrs, i), str[i],
+				"an RR of a list with freed copies") && r;
+		if (ldns_rr_is_shared(ldns_rr_list_rr(rrs, i))) {
+			printf("RR %d of a list is still shared\n", (int) i);
+			r = false;
+		}
+		LDNS_FREE(str[i]);
+	}
+	ldns_rr_list_deep_free(rrs);
+	return r;
+}
+
+/* RRs that are not shared, but share names with other RRs, can be made
+ * canonical without changing the others */
+static bool
+test_shared_names(void)
+{
+	ldns_rr *rr = new_rr(rrs_str[0]), *other = new_rr(rrs_str[1]);
+	char *str;
+	bool r = true;
+
+	/* the owner of the NS and its name server for the MX */
+	ldns_rdf_deep_free(ldns_rr_owner(other));
+	ldns_rr_set_owner(other, ldns_rdf_ref(ldns_rr_owner(rr)));
+	ldns_rdf_deep_free(ldns_rr_set_rdf(other,
+			ldns_rdf_ref(ldns_rr_rdf(rr, 0)), 1));
+	str = ldns_rr2str(other);
+
+	if (ldns_rr_is_shared(rr) || ldns_rr_unshare(rr) != rr ||
+	    !ldns_rdf_is_shared(ldns_rr_owner(rr)) ||
+	    !ldns_rdf_is_shared(ldns_rr_rdf(rr, 0))) {
+		printf("the names of an RR are not shared\n");
+		r = false;
+	}
+	ldns_rr2canonical(rr);
+	r = prints_as(rr, "share.test.\t3600\tIN\tNS\tns1.share.test.\n",
+			"an RR with shared names made canonical") && r;
+	r = prints_as(other, str, "an RR sharing names with one made "
+			"canonical") && r;
+	if (ldns_rdf_is_shared(ldns_rr_owner(rr)) ||
+	    ldns_rdf_is_shared(ldns_rr_rdf(rr, 0)) ||
+	    ldns_rdf_is_shared(ldns_rr_owner(other)) ||
+	    ldns_rdf_is_shared(ldns_rr_rdf(other, 1))) {
+		printf("names are still shared after they were made "
+		       "canonical\n");
+		r = false;
+	}
+	/* ldns_dname_cat() refuses names that are shared */
+	ldns_rdf_deep_free(ldns_rr_owner(rr));
+	ldns_rr_set_owner(rr, ldns_rdf_ref(ldns_rr_owner(other)));
+	if (ldns_dname_cat(ldns_rr_owner(rr), ldns_rr_rdf(rr, 0))
+			== LDNS_STATUS_OK) {
+		printf("ldns_dname_cat() changed a shared name\n");
+		r = false;
+	}
+	r = prints_as(other, str, "an RR sharing a name that was "
+			"concatenated to") && r;
+	ldns_rr_free(rr);
+	ldns_rr_free(other);
+	LDNS_FREE(str);
+	return r;
+}
+
+/* The RRs of a zone read with interned owners can be made canonical one
+ * by one, without changing the others */
+static bool
+test_interned_owners(void)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	ldns_zone_reader *reader;
+	ldns_rr *rr;
+	char *str[N_RRS_STR];
+	FILE *fp = tmpfile();
+	bool r = true;
+	size_t i, j, n = 0;
+
+	for (i = 0; i < N_RRS_STR; i++) {
+		fprintf(fp, "%s\n", rrs_str[i]);
+	}
+	rewind(fp);
+	reader = ldns_zone_reader_new(fp, NULL, 3600, LDNS_RR_CLASS_IN);
+	ldns_zone_reader_set_intern_owners(reader, true);
+	while (ldns_zone_reader_next(reader, &rr, NULL) == LDNS_STATUS_OK
+			&& rr) {
+		str[n++] = ldns_rr2str(rr);
+		(void) ldns_rr_list_push_rr(rrs, rr);
+	}
+	ldns_zone_reader_free(reader);
+	fclose(fp);
+	if (n != N_RRS_STR || ldns_rr_owner(ldns_rr_list_rr(rrs, 0))
+			!= ldns_rr_owner(ldns_rr_list_rr(rrs, 1))) {
+		printf("the zone was not read with interned owners\n");
+		r = false;
+	}
+	for (i = 0; r && i < n; i++) {
+		rr = ldns_rr_unshare(ldns_rr_list_rr(rrs, i));
+		(void) ldns_rr_list_set_rr(rrs, rr, i);
+		ldns_rr2canonical(rr);
+		for (j = i + 1; j < n; j++) {
+			r = prints_as(ldns_rr_list_rr(rrs, j), str[j],
+					"an RR after one made canonical") && r;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		LDNS_FREE(str[i]);
+	}
+	ldns_rr_list_deep_free(rrs);
+	return r;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_ref()) {
+		printf("test_ref() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_list_share(false) || !test_list_share(true)) {
+		printf("test_list_share() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_shared_names()) {
+		printf("test_shared_names() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_interned_owners()) {
+		printf("test_interned_owners() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	exit(result);
+}
@@ -0,0 +1,385 @@
+/*
+ * Unit tests for interning the owner names of the RRs of zones
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#define N_NAMES 60
+#define MAX_RRS 600
+#define ROUNDS  20000
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+/* A zone with owners in both cases, relative and absolute, left out to
+ * repeat the previous one, and names that come back after others */
+static FILE *
+zone_file(void)
+{
+	FILE *fp = tmpfile();
+	uint32_t k, j, n, count = 0, name;
+
+	/* the same zone every time */
+	seed = 1;
+	fprintf(fp, "$ORIGIN intern.test.\n$TTL 3600\n"
+			"@ IN SOA ns hostmaster 1 2 3 4 5\n");
+	for (k = 0; k < N_NAMES + N_NAMES / 4; k++) {
+		name = k < N_NAMES ? k : rnd(N_NAMES);
+		n = 1 + rnd(4);
+		for (j = 0; j < n; j++, count++) {
+			switch (j == 0 ? rnd(3) : rnd(4)) {
+			case 0:
+				fprintf(fp, "n%u", name);
+				break;
+			case 1:
+				fprintf(fp, "N%u", name);
+				break;
+			case 2:
+				fprintf(fp, "n%u.Intern.TEST.", name);
+				break;
+			default:
+				/* the previous owner */
+				break;
+			}
+			switch (rnd(3)) {
+			case 0:
+				fprintf(fp, "\tIN A 10.0.%u.%u\n",
+						count / 256, count % 256);
+				break;
+			case 1:
+				fprintf(fp, "\tIN TXT \"t%u\"\n", count);
+				break;
+			default:
+				fprintf(fp, "\tIN MX 10 mx%u\n", count);
+				break;
+			}
+		}
+	}
+	rewind(fp);
+	return fp;
+}
+
+static bool
+same_bytes(const ldns_rdf *a, const ldns_rdf *b)
+{
+	return ldns_rdf_size(a) == ldns_rdf_size(b) &&
+	       memcmp(ldns_rdf_data(a), ldns_rdf_data(b), ldns_rdf_size(a)) == 0;
+}
+
+static ldns_rr_list *
+read_zone(bool intern)
+{
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	FILE *fp = zone_file();
+	ldns_zone_reader *reader = ldns_zone_reader_new(fp, NULL, 0,
+			LDNS_RR_CLASS_IN);
+	ldns_rr *rr;
+	int line_nr = 0;
+
+	ldns_zone_reader_set_intern_owners(reader, intern);
+	while (ldns_zone_reader_next(reader, &rr, &line_nr) == LDNS_STATUS_OK
+			&& rr) {
+		(void) ldns_rr_list_push_rr(rrs, rr);
+	}
+	if (!feof(fp)) {
+		printf("the zone could not be read past line %d\n", line_nr);
+		exit(EXIT_FAILURE);
+	}
+	ldns_zone_reader_free(reader);
+	fclose(fp);
+	return rrs;
+}
+
+/* Reading with interned owners gives the same RRs, of which only those
+ * following each other with the same owner, byte for byte, share it */
+static bool
+test_reader(void)
+{
+	ldns_rr_list *plain = read_zone(false), *interned = read_zone(true);
+	ldns_rr_list *rrs = ldns_rr_list_new();
+	ldns_zone *zone = NULL;
+	ldns_rdf *owner, *prev;
+	FILE *fp = zone_file();
+	char *a, *b;
+	bool r = true, shared;
+	size_t i, j, n = ldns_rr_list_rr_count(plain);
+
+	/* and as ldns_zone_new_frm_fp() reads it */
+	if (ldns_zone_new_frm_fp(&zone, fp, NULL, 0, LDNS_RR_CLASS_IN)
+			!= LDNS_STATUS_OK) {
+		printf("could not read the zone\n");
+		exit(EXIT_FAILURE);
+	}
+	fclose(fp);
+	(void) ldns_rr_list_push_rr(rrs, ldns_zone_soa(zone));
+	(void) ldns_rr_list_cat(rrs, ldns_zone_rrs(zone));
+	if (ldns_rr_list_rr_count(interned) != n ||
+	    ldns_rr_list_rr_count(rrs) != n) {
+		printf("read %d RRs, and %d with interned owners and %d as "
+		       "a zone\n", (int) n,
+		       (int) ldns_rr_list_rr_count(interned),
+		       (int) ldns_rr_list_rr_count(rrs));
+		r = false;
+		n = 0;
+	}
+	for (i = 0; i < n; i++) {
+		a = ldns_rr2str(ldns_rr_list_rr(plain, i));
+		b = ldns_rr2str(ldns_rr_list_rr(interned, i));
+		if (!a || !b || strcmp(a, b) != 0) {
+			printf("RR %d was read as %sand with interned "
+			       "owners as %s", (int) i, a, b);
+			r = false;
+		}
+		LDNS_FREE(b);
+		b = ldns_rr2str(ldns_rr_list_rr(rrs, i));
+		if (!a || !b || strcmp(a, b) != 0) {
+			printf("RR %d was read as %sand as a zone as %s",
+					(int) i, a, b);
+			r = false;
+		}
+		LDNS_FREE(a);
+		LDNS_FREE(b);
+
+		if (ldns_rdf_is_shared(ldns_rr_owner(ldns_rr_list_rr(plain, i)))
+		    || ldns_rdf_is_shared(ldns_rr_owner(
+				ldns_rr_list_rr(rrs, i)))) {
+			printf("RR %d shares its owner without interning\n",
+					(int) i);
+			r = false;
+		}
+		if (i == 0) {
+			continue;
+		}
+		owner = ldns_rr_owner(ldns_rr_list_rr(interned, i));
+		prev = ldns_rr_owner(ldns_rr_list_rr(interned, i - 1));
+		shared = owner == prev;
+		if (shared != same_bytes(owner, prev)) {
+			printf("RR %d %s the owner of the RR before it\n",
+					(int) i, shared ? "shares" : "does not "
+					"share");
+			r = false;
+		}
+		/* nor with the RRs before those */
+		for (j = 0; r && !shared && j < i; j++) {
+			if (ldns_rr_owner(ldns_rr_list_rr(interned, j))
+					== owner) {
+				printf("RR %d shares the owner of RR %d\n",
+						(int) i, (int) j);
+				r = false;
+			}
+		}
+	}
+
+	/* the RRs are freed in any order */
+	for (i = n; i > 1; i--) {
+		j = rnd((uint32_t) i);
+		ldns_rr_free(ldns_rr_list_rr(interned, j));
+		(void) ldns_rr_list_set_rr(interned,
+				ldns_rr_list_rr(interned, i - 1), j);
+		ldns_rr_list_set_rr_count(interned, i - 1);
+	}
+	ldns_rr_list_deep_free(interned);
+	ldns_rr_list_deep_free(plain);
+	ldns_rr_list_free(rrs);
+	ldns_zone_deep_free(zone);
+	return r;
+}
+
+static ldns_dnssec_zone *
+read_dnssec_zone(void)
+{
+	ldns_dnssec_zone *zone = NULL;
+	FILE *fp = zone_file();
+
+	if (ldns_dnssec_zone_new_frm_fp(&zone, fp, NULL, 0, LDNS_RR_CLASS_IN)
+			!= LDNS_STATUS_OK) {
+		printf("could not read the zone\n");
+		exit(EXIT_FAILURE);
+	}
+	fclose(fp);
+	return zone;
+}
+
+static char *
+zone2str(const ldns_dnssec_zone *zone)
+{
+	FILE *fp = tmpfile();
+	long size;
+	char *str;
+
+	ldns_dnssec_zone_print(fp, zone);
+	size = ftell(fp);
+	str = LDNS_XMALLOC(char, (size_t) size + 1);
+	rewind(fp);
+	if (!str || fread(str, 1, (size_t) size, fp) != (size_t) size) {
+		fprintf(stderr, "could not read back the zone\n");
+		exit(EXIT_FAILURE);
+	}
+	str[size] = '\0';
+	fclose(fp);
+	return str;
+}
+
+/* Whether the zones print the same, and the RRs of the interned one
+ * have the owner of their name when it is the same byte for byte */
+static bool
+same_zones(const ldns_dnssec_zone *plain, const ldns_dnssec_zone *interned,
+		bool all_interned, const char *what)
+{
+	char *a = zone2str(plain), *b = zone2str(interned);
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs *rrs;
+	ldns_rdf *owner;
+	bool r = strcmp(a, b) == 0;
+
+	if (!r) {
+		printf("%s: the zone without interning is\n%s\nand with "
+		       "interning\n%s\n", what, a, b);
+	}
+	LDNS_FREE(a);
+	LDNS_FREE(b);
+	for (node = ldns_rbtree_first(interned->names);
+	     all_interned && node != LDNS_RBTREE_NULL;
+	     node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		for (rrset = name->rrsets; rrset; rrset = rrset->next) {
+			for (rrs = rrset->rrs; rrs; rrs = rrs->next) {
+				owner = ldns_rr_owner(rrs->rr);
+				if ((owner == name->name) !=
+				    same_bytes(owner, name->name)) {
+					printf("%s: an RR of ", what);
+					ldns_rdf_print(stdout, name->name);
+					printf(" has %s owner\n",
+						owner == name->name ?
+						"the" : "not the");
+					r = false;
+				}
+			}
+		}
+	}
+	return r;
+}
+
+/* All RRs of a zone, cloned */
+static size_t
+zone_rrs(const ldns_dnssec_zone *zone, ldns_rr **rrs)
+{
+	ldns_rbnode_t *node;
+	ldns_dnssec_name *name;
+	ldns_dnssec_rrsets *rrset;
+	ldns_dnssec_rrs *cur;
+	size_t n = 0;
+
+	for (node = ldns_rbtree_first(zone->names);
+	     node != LDNS_RBTREE_NULL; node = ldns_rbtree_next(node)) {
+		name = (ldns_dnssec_name *) node->data;
+		for (rrset = name->rrsets; rrset; rrset = rrset->next) {
+			for (cur = rrset->rrs; cur && n < MAX_RRS;
+			     cur = cur->next) {
+				rrs[n++] = ldns_rr_clone(cur->rr);
+			}
+		}
+	}
+	return n;
+}
+
+/* Removes RRs from a zone with interned owners, and adds them again, and
+ * does the same for a zone without interning */
+static bool
+test_dnssec_zone(void)
+{
+	ldns_dnssec_zone *plain = read_dnssec_zone();
+	ldns_dnssec_zone *interned = read_dnssec_zone();
+	ldns_rr *rrs[MAX_RRS], *held_plain[MAX_RRS], *held[MAX_RRS];
+	char *a, *b;
+	bool r;
+	size_t round, i, n;
+
+	r = same_zones(plain, interned, false, "loaded");
+	ldns_dnssec_zone_intern_owners(interned);
+	r = same_zones(plain, interned, true, "interned") && r;
+	n = zone_rrs(plain, rrs);
+	memset(held, 0, sizeof(held));
+	memset(held_plain, 0, sizeof(held_plain));
+
+	for (round = 0; r && round < ROUNDS; round++) {
+		i = rnd((uint32_t) n);
+		if (held[i]) {
+			if (ldns_dnssec_zone_add_rr(interned, held[i])
+					!= LDNS_STATUS_OK ||
+			    ldns_dnssec_zone_add_rr(plain, held_plain[i])
+					!= LDNS_STATUS_OK) {
+				printf("could not add RR %d again\n", (int) i);
+				r = false;
+			}
+			held[i] = held_plain[i] = NULL;
+		} else {
+			held[i] = ldns_dnssec_zone_remove_rr(interned, rrs[i]);
+			held_plain[i] = ldns_dnssec_zone_remove_rr(plain,
+					rrs[i]);
+			a = held[i] ? ldns_rr2str(held[i]) : NULL;
+			b = ldns_rr2str(rrs[i]);
+			if (!held[i] || !held_plain[i] || !a || !b
+			             || strcmp(a, b) != 0) {
+				printf("removed %sinstead of %s", a ? a :
+						"nothing\n", b);
+				r = false;
+			} else if (ldns_rdf_is_shared(ldns_rr_owner(held[i]))) {
+				printf("a removed RR shares its owner\n");
+				r = false;
+			}
+			LDNS_FREE(a);
+			LDNS_FREE(b);
+		}
+		if (round % 1000 == 999) {
+			r = same_zones(plain, interned, false, "changed") && r;
+			ldns_dnssec_zone_intern_owners(interned);
+			r = same_zones(plain, interned, true,
+					"interned again") && r;
+		}
+	}
+	/* RRs that were removed outlive the zone */
+	ldns_dnssec_zone_deep_free(interned);
+	ldns_dnssec_zone_deep_free(plain);
+	for (i = 0; i < n; i++) {
+		if (held[i]) {
+			a = ldns_rr2str(held[i]);
+			b = ldns_rr2str(rrs[i]);
+			if (!a || !b || strcmp(a, b) != 0) {
+				printf("a removed RR changed to %s", a);
+				r = false;
+			}
+			LDNS_FREE(a);
+			LDNS_FREE(b);
+		}
+		ldns_rr_free(held[i]);
+		ldns_rr_free(held_plain[i]);
+		ldns_rr_free(rrs[i]);
+	}
+	return r;
+}
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+	if (!test_reader()) {
+		printf("test_reader() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	if (!test_dnssec_zone()) {
+		printf("test_dnssec_zone() failed.\n");
+		result = EXIT_FAILURE;
+	}
+	exit(result);
+}
@@ -0,0 +1,388 @@
+/*
+ * Unit tests for signing RRsets with a reused ldns_sign_ctx, against
+ * ldns_sign_public() and against signing every RRset from scratch
+ */
+
+#include "ldns/config.h"
+
+#include <ldns/ldns.h>
+
+#define ROUNDS 400
+
+static uint32_t seed = 1;
+
+static uint32_t
+rnd(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+#ifdef HAVE_SSL
+static const char *owners[] = {
+	"sign.test.", "Sign.TEST.", "www.sign.test.", "*.sign.test.",
+	"*.Wild.Sign.test.", "a.b.c.d.sign.test."
+};
+
+/* The RDATA of RRs of the types of an RRset, some of which only differ
+ * in case, which is lowercased for the NS, but not for the TXT */
+static const char *ns_rdata[] = {
+	"ns1.sign.test.", "NS1.sign.test.", "ns2.sign.test.", "a.sign.test.",
+	"ns.other.test."
+};
+static const char *txt_rdata[] = {
+	"\"a\"", "\"A\"", "\"b\"", "\"a\" \"b\"", "\"\"", "\"ab\""
+};
+
+static ldns_rr *
+new_rr(const char *owner, uint32_t ttl, const char *type, const char *rdata)
+{
+	char str[256];
+	ldns_rr *rr = NULL;
+
+	snprintf(str, sizeof(str), "%s %u IN %s %s", owner, (unsigned) ttl,
+			type, rdata);
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "could not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+/* An RRset in no particular order, with TTLs that differ, of which the
+ * TTL of the first RR is signed */
+static ldns_rr_list *
+random_rrset(void)
+{
+	ldns_rr_list *rrset = ldns_rr_list_new();
+	const char *owner = owners[rnd(sizeof(owners) / sizeof(owners[0]))];
+	char rdata[64];
+	size_t n = 1 + rnd(6), i;
+	uint32_t type = rnd(4);
+
+	for (i = 0; i < n; i++) {
+		switch (type) {
+		case 0:
+			snprintf(rdata, sizeof(rdata), "192.0.2.%u",
+					(unsigned) rnd(256));
+			(void) ldns_rr_list_push_rr(rrset, new_rr(owner,
+					3600 + rnd(3), "A", rdata));
+			break;
+		case 1:
+			(void) ldns_rr_list_push_rr(rrset, new_rr(owner,
+					3600 + rnd(3), "NS", ns_rdata[rnd(
+					sizeof(ns_rdata) / sizeof(ns_rdata[0]))]));
+			break;
+		case 2:
+			(void) ldns_rr_list_push_rr(rrset, new_rr(owner,
+					3600 + rnd(3), "TXT", txt_rdata[rnd(
+					sizeof(txt_rdata) / sizeof(txt_rdata[0]))]));
+			break;
+		default:
+			snprintf(rdata, sizeof(rdata), "%u %s",
+					(unsigned) rnd(3), ns_rdata[rnd(
+					sizeof(ns_rdata) / sizeof(ns_rdata[0]))]);
+			(void) ldns_rr_list_push_rr(rrset, new_rr(owner,
+					3600 + rnd(3), "MX", rdata));
+			break;
+		}
+	}
+	return rrset;
+}
+
+static ldns_key *
+new_key(ldns_signing_algorithm algorithm, uint16_t size, uint16_t flags)
+{
+	ldns_key *key = ldns_key_new_frm_algorithm(algorithm, size);
+	ldns_rr *rr;
+
+	if (!key) {
+		return NULL;
+	}
+	ldns_key_set_pubkey_owner(key, ldns_dname_new_frm_str("Sign.Test."));
+	ldns_key_set_flags(key, flags);
+	ldns_key_set_inception(key, 1700000000);
+	ldns_key_set_expiration(key, 1800000000);
+	rr = ldns_key2rr(key);
+	ldns_key_set_keytag(key, ldns_calc_keytag(rr));
+	ldns_rr_free(rr);
+	return key;
+}
+
+/* Whether the signatures of a key always come out the same */
+static bool
+deterministic(const ldns_key *key)
+{
+	switch (ldns_key_algorithm(key)) {
+	case LDNS_SIGN_RSASHA1:
+	case LDNS_SIGN_RSASHA256:
+	case LDNS_SIGN_RSASHA512:
+	case LDNS_SIGN_ED25519:
+	case LDNS_SIGN_ED448:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Signs an RRset like ldns_sign_public() did before it had a context:
+ * with the RRSIG of ldns_create_empty_rrsig(), and the RRs cloned, made
+ * canonical, given the TTL of the first RR and sorted as RR objects */
+static ldns_rr_list *
+ref_sign(const ldns_rr_list *rrset, ldns_key_list *keys)
+{
+	ldns_rr_list *sigs = ldns_rr_list_new();
+	ldns_rr_list *canon = ldns_rr_list_clone(rrset);
+	ldns_buffer *buf;
+	ldns_key *key;
+	ldns_rr *sig;
+	ldns_rdf *b64;
+	size_t i;
+
+	for (i = 0; i < ldns_rr_list_rr_count(canon); i++) {
+		ldns_rr2canonical(ldns_rr_list_rr(canon, i));
+		ldns_rr_set_ttl(ldns_rr_list_rr(canon, i),
+				ldns_rr_ttl(ldns_rr_list_rr(rrset, 0)));
+	}
+	ldns_rr_list_sort(canon);
+
+	for (i = 0; i < ldns_key_list_key_count(keys); i++) {
+		key = ldns_key_list_key(keys, i);
+		if (!ldns_key_use(key) ||
+		    !(ldns_key_flags(key) & LDNS_KEY_ZONE_KEY)) {
+			continue;
+		}
+		buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+		sig = ldns_create_empty_rrsig(canon, key);
+		if (ldns_rrsig2buffer_wire(buf, sig) != LDNS_STATUS_OK ||
+		    ldns_rr_list2buffer_wire(buf, canon) != LDNS_STATUS_OK ||
+		    !(b64 = ldns_sign_public_buffer(buf, key))) {
+			fprintf(stderr, "could not sign from scratch\n");
+			exit(EXIT_FAILURE);
+		}
+		(void) ldns_rr_rrsig_set_sig(sig, b64);
+		(void) ldns_rr_list_push_rr(sigs, sig);
+		ldns_buffer_free(buf);
+	}
+	ldns_rr_list_deep_free(canon);
+	return sigs;
+}
+
+static void
+print_rrset(const char *what, const ldns_rr_list *rrs)
+{
+	printf("%s:\n", what);
+	ldns_rr_list_print(stdout, rrs);
+}
+
+/* Whether the RRSIGs are those of the reference, up to the signature, and
+ * have the same signature when the key always makes the same, or else
+ * one that verifies */
+static bool
+same_sigs(const char *what, const ldns_rr_list *sigs,
+		const ldns_rr_list *ref, ldns_rr_list *rrset,
+		ldns_key_list *keys, ldns_rr_list *dnskeys)
+{
+	ldns_rr_list *good;
+	ldns_rr *sig, *ref_sig;
+	ldns_key *key;
+	bool r = true;
+	size_t i, j;
+
+	if (!sigs || ldns_rr_list_rr_count(sigs)
+			!= ldns_rr_list_rr_count(ref)) {
+		printf("%s made %d signatures instead of %d\n", what,
+				sigs ? (int) ldns_rr_list_rr_count(sigs) : -1,
+				(int) ldns_rr_list_rr_count(ref));
+		return false;
+	}
+	for (i = 0, j = 0; i < ldns_rr_list_rr_count(sigs); i++, j++) {
+		/* the key of the signature */
+		while (!ldns_key_use(ldns_key_list_key(keys, j)) ||
+		       !(ldns_key_flags(ldns_key_list_key(keys, j))
+				       & LDNS_KEY_ZONE_KEY)) {
+			j++;
+		}
+		key = ldns_key_list_key(keys, j);
+		sig = ldns_rr_list_rr(sigs, i);
+		ref_sig = ldns_rr_list_rr(ref, i);
+
+		if (deterministic(key)) {
+			if (ldns_rr_compare(sig, ref_sig) != 0 ||
+			    ldns_rr_ttl(sig) != ldns_rr_ttl(ref_sig) ||
+			    ldns_rdf_compare(ldns_rr_owner(sig),
+				    ldns_rr_owner(ref_sig)) != 0) {
+				r = false;
+			}
+		} else {
+			/* all but the signature */
+			ldns_rdf_deep_free(ldns_rr_pop_rdf(ref_sig));
+			(void) ldns_rr_push_rdf(ref_sig, ldns_rdf_clone(
+					ldns_rr_rdf(sig, 8)));
+			if (ldns_rr_compare(sig, ref_sig) != 0 ||
+			    ldns_rr_ttl(sig) != ldns_rr_ttl(ref_sig)) {
+				r = false;
+			}
+		}
+		good = ldns_rr_list_new();
+		if (ldns_verify_rrsig_keylist_time(rrset, sig, dnskeys,
+					1750000000, good) != LDNS_STATUS_OK) {
+			printf("%s made a signature that does not verify\n",
+					what);
+			r = false;
+		}
+		ldns_rr_list_free(good);
+	}
+	if (!r) {
+		printf("%s signed differently\n", what);
+		print_rrset("the RRset", rrset);
+		print_rrset("the signatures", sigs);
+		print_rrset("instead of", ref);
+	}
+	return r;
+}
+
+static ldns_key_list *
+new_keys(void)
+{
+	ldns_key_list *keys = ldns_key_list_new();
+	ldns_key *key;
+
+	(void) ldns_key_list_push_key(keys, new_key(LDNS_SIGN_RSASHA256,
+				1024, LDNS_KEY_ZONE_KEY));
+	(void) ldns_key_list_push_key(keys, new_key(LDNS_SIGN_RSASHA1,
+				1024, LDNS_KEY_ZONE_KEY | LDNS_KEY_SEP_KEY));
+	/* keys that do not sign */
+	key = new_key(LDNS_SIGN_RSASHA256, 1024, LDNS_KEY_ZONE_KEY);
+	ldns_key_set_use(key, false);
+	(void) ldns_key_list_push_key(keys, key);
+	(void) ldns_key_list_push_key(keys, new_key(LDNS_SIGN_RSASHA256,
+				1024, 0));
+#ifdef USE_ECDSA
+	(void) ldns_key_list_push_key(keys, new_key(
+				LDNS_SIGN_ECDSAP256SHA256, 256,
+				LDNS_KEY_ZONE_KEY));
+#endif
+#ifdef USE_ED25519
+	(void) ldns_key_list_push_key(keys, new_key(LDNS_SIGN_ED25519, 256,
+				LDNS_KEY_ZONE_KEY));
+#endif
+	return keys;
+}
+
+/* Changes a key in a way that changes its signatures, which a context
+ * that set it up before has to notice */
+static void
+change_key(ldns_key *key)
+{
+	ldns_rr *rr;
+
+	switch (rnd(4)) {
+	case 0:
+		ldns_key_set_inception(key, ldns_key_inception(key) + 1);
+		break;
+	case 1:
+		ldns_key_set_expiration(key, ldns_key_expiration(key) + 1);
+		break;
+	case 2:
+		ldns_rdf_deep_free(ldns_key_pubkey_owner(key));
+		ldns_key_set_pubkey_owner(key, ldns_dname_new_frm_str(
+				rnd(2) ? "sign.test." : "other.test."));
+		rr = ldns_key2rr(key);
+		ldns_key_set_keytag(key, ldns_calc_keytag(rr));
+		ldns_rr_free(rr);
+		break;
+	default:
+		ldns_key_set_use(key, !ldns_key_use(key));
+		break;
+	}
+}
+
+/* The DNSKEYs of the keys, with the owners they have now */
+static ldns_rr_list *
+dnskeys_of(ldns_key_list *keys)
+{
+	ldns_rr_list *dnskeys = ldns_rr_list_new();
+	size_t i;
+
+	for (i = 0; i < ldns_key_list_key_count(keys); i++) {
+		(void) ldns_rr_list_push_rr(dnskeys,
+				ldns_key2rr(ldns_key_list_key(keys, i)));
+	}
+	return dnskeys;
+}
+
+/* RRsets signed with one context, by keys that sometimes change, must be
+ * signed like ldns_sign_public() and signing from scratch do, and be left
+ * as they were */
+static bool
+test_sign_ctx(void)
+{
+	ldns_sign_ctx *ctx = ldns_sign_ctx_new();
+	ldns_key_list *keys = new_keys();
+	ldns_rr_list *rrset, *ref, *sigs, *dnskeys;
+	char *before, *after;
+	bool r = true;
+	size_t i, failed = 0;
+
+	for (i = 0; i < ROUNDS && failed < 5; i++) {
+		if (rnd(10) == 0) {
+			change_key(ldns_key_list_key(keys,
+				rnd(ldns_key_list_key_count(keys))));
+		}
+		rrset = random_rrset();
+		dnskeys = dnskeys_of(keys);
+		before = ldns_rr_list2str(rrset);
+		ref = ref_sign(rrset, keys);
+
+		sigs = ldns_sign_public_ctx(ctx, rrset, keys);
+		r = same_sigs("ldns_sign_public_ctx()", sigs, ref, rrset,
+				keys, dnskeys);
+		ldns_rr_list_deep_free(sigs);
+		sigs = ldns_sign_public(rrset, keys);
+		r = same_sigs("ldns_sign_public()", sigs, ref, rrset,
+				keys, dnskeys) && r;
+		ldns_rr_list_deep_free(sigs);
+
+		after = ldns_rr_list2str(rrset);
+		if (strcmp(before, after) != 0) {
+			printf("signing changed the RRset from:\n%sto:\n%s",
+					before, after);
+			r = false;
+		}
+		if (!r) {
+			failed++;
+		}
+		LDNS_FREE(before);
+		LDNS_FREE(after);
+		ldns_rr_list_deep_free(ref);
+		ldns_rr_list_deep_free(dnskeys);
+		ldns_rr_list_deep_free(rrset);
+	}
+	/* nothing to sign */
+	rrset = ldns_rr_list_new();
+	if (ldns_sign_public_ctx(ctx, rrset, keys) ||
+	    ldns_sign_public_ctx(ctx, NULL, keys) ||
+	    ldns_sign_public(rrset, keys)) {
+		printf("an empty RRset was signed\n");
+		failed++;
+	}
+	ldns_rr_list_free(rrset);
+	ldns_key_list_free(keys);
+	ldns_sign_ctx_free(ctx);
+	return failed == 0;
+}
+#endif /* HAVE_SSL */
+
+int main(void)
+{
+	int result = EXIT_SUCCESS;
+
+#ifdef HAVE_SSL
+	if (!test_sign_ctx()) {
+		printf("test_sign_ctx() failed.\n");
+		result = EXIT_FAILURE;
+	}
+#endif
+	exit(result);
+}
@@ -41,8 +41,10 @@ $TPKG -a ../.. fake 32-unbound-regression.tpkg
 $TPKG -a ../.. fake 999-compile-nossl.tpkg
 command -v indent || $TPKG -a ../.. fake codingstyle.tpkg
 grep -q '^#define HAVE_SSL ' ../ldns/config.h || (
+	$TPKG -a ../.. fake 11-sign-backend.tpkg
 	$TPKG -a ../.. fake 19-keygen.tpkg
 	$TPKG -a ../.. fake 20-sign-zone.tpkg
+	$TPKG -a ../.. fake 24-sign-cache.tpkg
 	$TPKG -a ../.. fake 25-ZONEMD.tpkg
 )
 
@@ -26,6 +26,182 @@
 #include <openssl/rand.h>
 #endif
 
+#if !defined(HAVE_ATOMIC_BUILTINS) && defined(HAVE_PTHREAD)
+/* Without atomic operations, reference counts are changed under one lock */
+static pthread_mutex_t ldns_refcount_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint32_t
+_ldns_refcount_add(uint32_t *refcount, int d)
+{
+	uint32_t r;
+
+	pthread_mutex_lock(&ldns_refcount_lock);
+	r = *refcount += d;
+	pthread_mutex_unlock(&ldns_refcount_lock);
+	return r;
+}
+#endif
+
+/* The pools of a thread, one for every type that was asked for */
+struct ldns_thread_pools
+{
+	const struct _ldns_thread_pool *type;
+	void *pool;
+	struct ldns_thread_pools *next;
+};
+
+static void
+ldns_thread_pools_free(void *arg)
+{
+	struct ldns_thread_pools *pools = arg, *next;
+
+	while (pools) {
+		next = pools->next;
+		pools->type->drain(pools->pool);
+		LDNS_FREE(pools->pool);
+		LDNS_FREE(pools);
+		pools = next;
+	}
+}
+
+#ifdef HAVE_PTHREAD
+/* Every thread has pools of its own, freed when the thread exits */
+static pthread_key_t ldns_thread_pools_key;
+static pthread_once_t ldns_thread_pools_once = PTHREAD_ONCE_INIT;
+static bool ldns_thread_pools_key_ok = false;
+#else
+static struct ldns_thread_pools *ldns_thread_pools_global = NULL;
+static bool ldns_thread_pools_exit_set = false;
+#endif /* HAVE_PTHREAD */
+
+/* The key destructor is not called for the main thread, so the pools of
+ * the thread that calls exit() are freed by this */
+static void
+ldns_thread_pools_exit(void)
+{
+	struct ldns_thread_pools *pools;
+
+#ifdef HAVE_PTHREAD
+	pools = pthread_getspecific(ldns_thread_pools_key);
+	(void) pthread_setspecific(ldns_thread_pools_key, NULL);
+#else
+	pools = ldns_thread_pools_global;
+	ldns_thread_pools_global = NULL;
+#endif
+	ldns_thread_pools_free(pools);
+}
+
+#ifdef HAVE_PTHREAD
+static void
+ldns_thread_pools_key_create(void)
+{
+	ldns_thread_pools_key_ok = pthread_key_create(&ldns_thread_pools_key,
+			ldns_thread_pools_free) == 0;
+	if (ldns_thread_pools_key_ok) {
+		(void) atexit(ldns_thread_pools_exit);
+	}
+}
+#endif /* HAVE_PTHREAD */
+
+void *
+_ldns_thread_pool(const struct _ldns_thread_pool *type, int create)
+{
+	struct ldns_thread_pools *pools, *p;
+
+#ifdef HAVE_PTHREAD
+	(void) pthread_once(&ldns_thread_pools_once,
+			ldns_thread_pools_key_create);
+	if (!ldns_thread_pools_key_ok) {
+		return NULL;
+	}
+	pools = pthread_getspecific(ldns_thread_pools_key);
+#else
+	pools = ldns_thread_pools_global;
+#endif
+	for (p = pools; p; p = p->next) {
+		if (p->type == type) {
+			return p->pool;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+	p = LDNS_MALLOC(struct ldns_thread_pools);
+	if (!p) {
+		return NULL;
+	}
+	p->type = type;
+	p->pool = LDNS_CALLOC(uint8_t, type->size);
+	p->next = pools;
+	if (!p->pool) {
+		LDNS_FREE(p);
+		return NULL;
+	}
+#ifdef HAVE_PTHREAD
+	if (pthread_setspecific(ldns_thread_pools_key, p)) {
+		LDNS_FREE(p->pool);
+		LDNS_FREE(p);
+		return NULL;
+	}
+#else
+	if (!ldns_thread_pools_exit_set) {
+		ldns_thread_pools_exit_set = atexit(ldns_thread_pools_exit) == 0;
+	}
+	ldns_thread_pools_global = p;
+#endif
+	return p->pool;
+}
+
+int
+_ldns_lru_compare(const void *a, const void *b)
+{
+	const struct _ldns_lru_entry *x = a;
+	const struct _ldns_lru_entry *y = b;
+
+	if (x->key_len != y->key_len) {
+		return x->key_len < y->key_len ? -1 : 1;
+	}
+	return memcmp(x->key, y->key, x->key_len);
+}
+
+void
+_ldns_lru_unlink(struct _ldns_lru *lru, struct _ldns_lru_entry *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		lru->first = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		lru->last = entry->prev;
+	}
+	entry->prev = entry->next = NULL;
+}
+
+void
+_ldns_lru_push_front(struct _ldns_lru *lru, struct _ldns_lru_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = lru->first;
+	if (lru->first) {
+		lru->first->prev = entry;
+	} else {
+		lru->last = entry;
+	}
+	lru->first = entry;
+}
+
+void
+_ldns_lru_touch(struct _ldns_lru *lru, struct _ldns_lru_entry *entry)
+{
+	if (lru->first != entry) {
+		_ldns_lru_unlink(lru, entry);
+		_ldns_lru_push_front(lru, entry);
+	}
+}
+
 ldns_lookup_table *
 ldns_lookup_by_name(ldns_lookup_table *table, const char *name)
 {
@@ -137,17 +313,18 @@ ldns_int_to_hexdigit(int i)
 int
 ldns_hexstring_to_data(uint8_t *data, const char *str)
 {
-	size_t i;
+	size_t i, len;
 
 	if (!str || !data) {
 		return -1;
 	}
 
-	if (strlen(str) % 2 != 0) {
+	len = strlen(str);
+	if (len % 2 != 0) {
 		return -2;
 	}
 
-	for (i = 0; i < strlen(str) / 2; i++) {
+	for (i = 0; i < len / 2; i++) {
 		data[i] =
 			16 * (uint8_t) ldns_hexdigit_to_int(str[i*2]) +
 			(uint8_t) ldns_hexdigit_to_int(str[i*2 + 1]);
@@ -405,7 +405,7 @@ ldns_wire2pkt(ldns_pkt **packet_p, const uint8_t *wire, size_t max)
 	size_t pos = 0;
 	uint16_t i;
 	ldns_rr *rr;
-	ldns_pkt *packet = ldns_pkt_new();
+	ldns_pkt *packet = ldns_pkt_new_pooled();
 	ldns_status status = LDNS_STATUS_OK;
 	uint8_t have_edns = 0;
 
@@ -426,7 +426,7 @@ ldns_wire2pkt(ldns_pkt **packet_p, const uint8_t *wire, size_t max)
 		}
 		LDNS_STATUS_CHECK_GOTO(status, status_error);
 		if (!ldns_rr_list_push_rr(ldns_pkt_question(packet), rr)) {
-			ldns_pkt_free(packet);
+			ldns_pkt_recycle(packet);
 			return LDNS_STATUS_INTERNAL_ERR;
 		}
 	}
@@ -437,7 +437,7 @@ ldns_wire2pkt(ldns_pkt **packet_p, const uint8_t *wire, size_t max)
 		}
 		LDNS_STATUS_CHECK_GOTO(status, status_error);
 		if (!ldns_rr_list_push_rr(ldns_pkt_answer(packet), rr)) {
-			ldns_pkt_free(packet);
+			ldns_pkt_recycle(packet);
 			return LDNS_STATUS_INTERNAL_ERR;
 		}
 	}
@@ -448,7 +448,7 @@ ldns_wire2pkt(ldns_pkt **packet_p, const uint8_t *wire, size_t max)
 		}
 		LDNS_STATUS_CHECK_GOTO(status, status_error);
 		if (!ldns_rr_list_push_rr(ldns_pkt_authority(packet), rr)) {
-			ldns_pkt_free(packet);
+			ldns_pkt_recycle(packet);
 			return LDNS_STATUS_INTERNAL_ERR;
 		}
 	}
@@ -476,7 +476,7 @@ ldns_wire2pkt(ldns_pkt **packet_p, const uint8_t *wire, size_t max)
 			ldns_pkt_set_tsig(packet, rr);
 			ldns_pkt_set_arcount(packet, ldns_pkt_arcount(packet) - 1);
 		} else if (!ldns_rr_list_push_rr(ldns_pkt_additional(packet), rr)) {
-			ldns_pkt_free(packet);
+			ldns_pkt_recycle(packet);
 			return LDNS_STATUS_INTERNAL_ERR;
 		}
 	}
@@ -490,6 +490,6 @@ ldns_wire2pkt(ldns_pkt **packet_p, const uint8_t *wire, size_t max)
 	return status;
 
 status_error:
-	ldns_pkt_free(packet);
+	ldns_pkt_recycle(packet);
 	return status;
 }
@@ -56,6 +56,13 @@ ldns_zone_push_rr(ldns_zone *z, ldns_rr *rr)
 }
 
 
+static int
+ldns_zone_glue_cut_compare(const void *a, const void *b)
+{
+	return ldns_dname_compare(*(const ldns_rdf * const *) a,
+	                          *(const ldns_rdf * const *) b);
+}
+
 /*
  * Get the list of glue records in a zone
  * XXX: there should be a way for this to return error, other than NULL, 
@@ -68,24 +75,24 @@ ldns_zone_glue_rr_list(const ldns_zone *z)
 	 * (AAAA/A) for a nameserver listed in the zone
 	 *
 	 * Alg used here:
-	 * first find all the zonecuts (NS records)
-	 * find all the AAAA or A records (can be done it the 
-	 * above loop).
+	 * first find all the zonecuts (NS records), and sort them.
 	 *
-	 * Check if the aaaa/a list are subdomains under the
-	 * NS domains.
-	 * If yes -> glue, if no -> not glue
+	 * Then look up the owner of every AAAA or A record, and all the
+	 * names above it, in the sorted zone cuts.
+	 * If one is found -> glue, if no -> not glue
 	 */
 
-	ldns_rr_list *zone_cuts;
-	ldns_rr_list *addr;
+	const ldns_rdf **zone_cuts;
+	size_t n_cuts;
 	ldns_rr_list *glue;
-	ldns_rr *r, *ns, *a;
-	ldns_rdf *dname_a, *ns_owner;
-	size_t i,j;
+	ldns_rr *r;
+	ldns_rdf *owner;
+	ldns_rdf name; /* the owner, or a name above it */
+	const ldns_rdf *name_p = &name;
+	uint8_t *data;
+	size_t i, pos;
 
 	zone_cuts = NULL;
-	addr = NULL;
 	glue = NULL;
 
 	/* we cannot determine glue in a 'zone' without a SOA */
@@ -93,53 +100,56 @@ ldns_zone_glue_rr_list(const ldns_zone *z)
 		return NULL;
 	}
 
-	zone_cuts = ldns_rr_list_new();
+	zone_cuts = LDNS_XMALLOC(const ldns_rdf *, ldns_zone_rr_count(z) + 1);
 	if (!zone_cuts) goto memory_error;
-	addr = ldns_rr_list_new();
-	if (!addr) goto memory_error;
 	glue = ldns_rr_list_new();
 	if (!glue) goto memory_error;
 
+	n_cuts = 0;
 	for(i = 0; i < ldns_zone_rr_count(z); i++) {
 		r = ldns_rr_list_rr(ldns_zone_rrs(z), i);
-		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_A ||
-				ldns_rr_get_type(r) == LDNS_RR_TYPE_AAAA) {
-			/* possibly glue */
-			if (!ldns_rr_list_push_rr(addr, r)) goto memory_error;
-			continue;
-		}
-		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_NS) {
+		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_NS && ldns_rr_owner(r)) {
 			/* multiple zones will end up here -
 			 * for now; not a problem
 			 */
 			/* don't add NS records for the current zone itself */
 			if (ldns_rdf_compare(ldns_rr_owner(r), 
 						ldns_rr_owner(ldns_zone_soa(z))) != 0) {
-				if (!ldns_rr_list_push_rr(zone_cuts, r)) goto memory_error;
+				zone_cuts[n_cuts++] = ldns_rr_owner(r);
 			}
-			continue;
 		}
 	}
+	qsort(zone_cuts, n_cuts, sizeof(*zone_cuts),
+			ldns_zone_glue_cut_compare);
 
-	/* will sorting make it quicker ?? */
-	for(i = 0; i < ldns_rr_list_rr_count(zone_cuts); i++) {
-		ns = ldns_rr_list_rr(zone_cuts, i);
-		ns_owner = ldns_rr_owner(ns);
-
-		for(j = 0; j < ldns_rr_list_rr_count(addr); j++) {
-			a = ldns_rr_list_rr(addr, j);
-			dname_a = ldns_rr_owner(a);
-
-			if (ldns_dname_is_subdomain(dname_a, ns_owner) ||
-				ldns_dname_compare(dname_a, ns_owner) == 0) {
+	for(i = 0; n_cuts > 0 && i < ldns_zone_rr_count(z); i++) {
+		r = ldns_rr_list_rr(ldns_zone_rrs(z), i);
+		owner = ldns_rr_owner(r);
+		if ((ldns_rr_get_type(r) != LDNS_RR_TYPE_A &&
+		     ldns_rr_get_type(r) != LDNS_RR_TYPE_AAAA) || !owner ||
+		    ldns_rdf_size(owner) == 0) {
+			continue;
+		}
+		/* walk from the owner up to the root, without copying */
+		data = ldns_rdf_data(owner);
+		ldns_rdf_set_type(&name, LDNS_RDF_TYPE_DNAME);
+		for (pos = 0; pos < ldns_rdf_size(owner);
+				pos += data[pos] + 1) {
+			ldns_rdf_set_data(&name, data + pos);
+			ldns_rdf_set_size(&name, ldns_rdf_size(owner) - pos);
+			if (bsearch(&name_p, zone_cuts, n_cuts,
+					sizeof(*zone_cuts),
+					ldns_zone_glue_cut_compare)) {
 				/* GLUE! */
-				if (!ldns_rr_list_push_rr(glue, a)) goto memory_error;
+				if (!ldns_rr_list_push_rr(glue, r)) goto memory_error;
+				break;
+			}
+			if (data[pos] == 0) {
+				break;
 			}
 		}
 	}
-	
-	ldns_rr_list_free(addr);
-	ldns_rr_list_free(zone_cuts);
+	LDNS_FREE(zone_cuts);
 
 	if (ldns_rr_list_rr_count(glue) == 0) {
 		ldns_rr_list_free(glue);
@@ -152,9 +162,6 @@ memory_error:
 	if (zone_cuts) {
 		LDNS_FREE(zone_cuts);
 	}
-	if (addr) {
-		ldns_rr_list_free(addr);
-	}
 	if (glue) {
 		ldns_rr_list_free(glue);
 	}
@@ -189,170 +196,258 @@ ldns_zone_new_frm_fp(ldns_zone **z, FILE *fp, const ldns_rdf *origin, uint32_t t
 	return ldns_zone_new_frm_fp_l(z, fp, origin, ttl, c, NULL);
 }
 
-ldns_status _ldns_rr_new_frm_fp_l_internal(ldns_rr **newrr, FILE *fp,
-		uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev,
-		int *line_nr, bool *explicit_ttl);
+ldns_status _ldns_rr_new_frm_fp_l_internal(ldns_rr_parse_ctx *ctx,
+		ldns_rr **newrr, FILE *fp, uint32_t *default_ttl,
+		ldns_rdf **origin, ldns_rdf **prev, int *line_nr,
+		bool *explicit_ttl);
 
-/* XXX: class is never used */
-ldns_status
-ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, const ldns_rdf *origin,
-	uint32_t default_ttl, ldns_rr_class ATTR_UNUSED(c), int *line_nr)
+/* The state of reading a zone file, between RRs */
+struct ldns_struct_zone_reader
 {
-	ldns_zone *newzone;
-	ldns_rr *rr, *prev_rr = NULL;
-	uint32_t my_ttl;
-	ldns_rdf *my_origin;
-	ldns_rdf *my_prev;
-	bool soa_seen = false; 	/* 2 soa are an error */
-	ldns_status s;
-	ldns_status ret;
+	FILE *fp;
+	ldns_rr_parse_ctx *ctx;
+	ldns_rdf *origin;
+	ldns_rdf *prev;
+	uint32_t default_ttl;
+	uint32_t ttl;
 	/* RFC 1035 Section 5.1, says 'Omitted class and TTL values are default
 	 * to the last explicitly stated values.'
 	 */
-	bool ttl_from_TTL = false;
-	bool explicit_ttl = false;
-
-	/* most cases of error are memory problems */
-	ret = LDNS_STATUS_MEM_ERR;
+	bool ttl_from_TTL;
+	/* whether RRs with the owner of the one before share it */
+	bool intern_owners;
+	/* the owner (a copy, or a reference when interning), type and ttl
+	 * of the last RR */
+	ldns_rdf *prev_owner;
+	ldns_rr_type prev_type;
+	uint32_t prev_ttl;
+};
 
-	newzone = NULL;
-	my_origin = NULL;
-	my_prev = NULL;
+/* XXX: class is never used */
+ldns_zone_reader *
+ldns_zone_reader_new(FILE *fp, const ldns_rdf *origin, uint32_t default_ttl,
+		ldns_rr_class ATTR_UNUSED(c))
+{
+	ldns_zone_reader *reader;
 
-	my_ttl    = default_ttl;
-	
+	reader = LDNS_CALLOC(ldns_zone_reader, 1);
+	if (!reader) {
+		return NULL;
+	}
+	reader->fp = fp;
+	reader->default_ttl = default_ttl;
+	reader->ttl = default_ttl;
+
+	/* one set of parse buffers for all RRs in the zone */
+	reader->ctx = ldns_rr_parse_ctx_new();
+	if (!reader->ctx) {
+		goto error;
+	}
 	if (origin) {
-		my_origin = ldns_rdf_clone(origin);
-		if (!my_origin) goto error;
+		reader->origin = ldns_rdf_clone(origin);
 		/* also set the prev */
-		my_prev   = ldns_rdf_clone(origin);
-		if (!my_prev) goto error;
+		reader->prev = ldns_rdf_clone(origin);
+		if (!reader->origin || !reader->prev) {
+			goto error;
+		}
 	}
+	return reader;
+error:
+	ldns_zone_reader_free(reader);
+	return NULL;
+}
 
-	newzone = ldns_zone_new();
-	if (!newzone) goto error;
+void
+ldns_zone_reader_set_intern_owners(ldns_zone_reader *reader, bool intern)
+{
+	reader->intern_owners = intern;
+}
+
+void
+ldns_zone_reader_free(ldns_zone_reader *reader)
+{
+	if (!reader) {
+		return;
+	}
+	ldns_rr_parse_ctx_free(reader->ctx);
+	if (reader->origin) {
+		ldns_rdf_deep_free(reader->origin);
+	}
+	if (reader->prev) {
+		ldns_rdf_deep_free(reader->prev);
+	}
+	if (reader->prev_owner) {
+		ldns_rdf_deep_free(reader->prev_owner);
+	}
+	LDNS_FREE(reader);
+}
+
+ldns_status
+ldns_zone_reader_next(ldns_zone_reader *reader, ldns_rr **rr, int *line_nr)
+{
+	ldns_rr *cur;
+	ldns_status s;
+	bool explicit_ttl = false;
 
-	while(!feof(fp)) {
+	*rr = NULL;
+	while(!feof(reader->fp)) {
 		/* If ttl came from $TTL line, then it should be the default.
 		 * (RFC 2308 Section 4)
 		 * Otherwise it "defaults to the last explicitly stated value"
 		 * (RFC 1035 Section 5.1)
 		 */
-		if (ttl_from_TTL)
-			my_ttl = default_ttl;
-		s = _ldns_rr_new_frm_fp_l_internal(&rr, fp, &my_ttl, &my_origin,
-				&my_prev, line_nr, &explicit_ttl);
+		if (reader->ttl_from_TTL)
+			reader->ttl = reader->default_ttl;
+		s = _ldns_rr_new_frm_fp_l_internal(reader->ctx, &cur,
+				reader->fp, &reader->ttl, &reader->origin,
+				&reader->prev, line_nr, &explicit_ttl);
 		switch (s) {
 		case LDNS_STATUS_OK:
-			if (explicit_ttl) {
-				if (!ttl_from_TTL) {
-					/* No $TTL, so ttl "defaults to the
-					 * last explicitly stated value"
-					 * (RFC 1035 Section 5.1)
-					 */
-					my_ttl = ldns_rr_ttl(rr);
-				}
-			/* When ttl is implicit, try to adhere to the rules as
-			 * much as possible. (also for compatibility with bind)
-			 * This was changed when fixing an issue with ZONEMD
-			 * which hashes the TTL too.
-			 */
-			} else if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SIG
-			       ||  ldns_rr_get_type(rr) == LDNS_RR_TYPE_RRSIG) {
-				if (ldns_rr_rd_count(rr) >= 4
-				&&  ldns_rdf_get_type(ldns_rr_rdf(rr, 3)) == LDNS_RDF_TYPE_INT32)
-
-					/* SIG without explicit ttl get ttl
-					 * from the original_ttl field
-					 * (RFC 2535 Section 7.2)
-					 *
-					 * Similarly for RRSIG, but stated less
-					 * specifically in the spec.
-					 * (RFC 4034 Section 3)
-					 */
-					ldns_rr_set_ttl(rr,
-					    ldns_rdf2native_int32(
-					        ldns_rr_rdf(rr, 3)));
-
-			} else if (prev_rr
-			       &&  ldns_rr_get_type(prev_rr) == ldns_rr_get_type(rr)
-			       &&  ldns_dname_compare( ldns_rr_owner(prev_rr)
-			                             , ldns_rr_owner(rr)) == 0)
-
-				/* "TTLs of all RRs in an RRSet must be the same"
-				 * (RFC 2881 Section 5.2)
-				 */
-				ldns_rr_set_ttl(rr, ldns_rr_ttl(prev_rr));
-
-			prev_rr = rr;
-			if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
-				if (soa_seen) {
-					/* second SOA 
-					 * just skip, maybe we want to say
-					 * something??? */
-					ldns_rr_free(rr);
-					continue;
-				}
-				soa_seen = true;
-				ldns_zone_set_soa(newzone, rr);
-				/* set origin to soa if not specified */
-				if (!my_origin) {
-					my_origin = ldns_rdf_clone(ldns_rr_owner(rr));
-				}
-				continue;
-			}
-			
-			/* a normal RR - as sofar the DNS is normal */
-			if (!ldns_zone_push_rr(newzone, rr)) {
-				ldns_rr_free(rr);
-				goto error;
-			}
 			break;
-
 		case LDNS_STATUS_SYNTAX_EMPTY:
 			/* empty line was seen */
 		case LDNS_STATUS_SYNTAX_TTL:
 			/* the function set the ttl */
-			default_ttl = my_ttl;
-			ttl_from_TTL = true;
-			break;
+			reader->default_ttl = reader->ttl;
+			reader->ttl_from_TTL = true;
+			continue;
 		case LDNS_STATUS_SYNTAX_ORIGIN:
 			/* the function set the origin */
-			break;
+			continue;
 		case LDNS_STATUS_SYNTAX_INCLUDE:
-			ret = LDNS_STATUS_SYNTAX_INCLUDE_ERR_NOTIMPL;
-			goto error;
+			return LDNS_STATUS_SYNTAX_INCLUDE_ERR_NOTIMPL;
 		default:
-			ret = s;
-			goto error;
+			return s;
+		}
+		if (explicit_ttl) {
+			if (!reader->ttl_from_TTL) {
+				/* No $TTL, so ttl "defaults to the
+				 * last explicitly stated value"
+				 * (RFC 1035 Section 5.1)
+				 */
+				reader->ttl = ldns_rr_ttl(cur);
+			}
+		/* When ttl is implicit, try to adhere to the rules as
+		 * much as possible. (also for compatibility with bind)
+		 * This was changed when fixing an issue with ZONEMD
+		 * which hashes the TTL too.
+		 */
+		} else if (ldns_rr_get_type(cur) == LDNS_RR_TYPE_SIG
+		       ||  ldns_rr_get_type(cur) == LDNS_RR_TYPE_RRSIG) {
+			if (ldns_rr_rd_count(cur) >= 4
+			&&  ldns_rdf_get_type(ldns_rr_rdf(cur, 3)) == LDNS_RDF_TYPE_INT32)
+
+				/* SIG without explicit ttl get ttl
+				 * from the original_ttl field
+				 * (RFC 2535 Section 7.2)
+				 *
+				 * Similarly for RRSIG, but stated less
+				 * specifically in the spec.
+				 * (RFC 4034 Section 3)
+				 */
+				ldns_rr_set_ttl(cur,
+				    ldns_rdf2native_int32(
+				        ldns_rr_rdf(cur, 3)));
+
+		} else if (reader->prev_owner
+		       &&  reader->prev_type == ldns_rr_get_type(cur)
+		       &&  ldns_dname_compare( reader->prev_owner
+		                             , ldns_rr_owner(cur)) == 0)
+
+			/* "TTLs of all RRs in an RRSet must be the same"
+			 * (RFC 2881 Section 5.2)
+			 */
+			ldns_rr_set_ttl(cur, reader->prev_ttl);
+
+		if (reader->prev_owner
+		&&  ldns_rdf_compare( reader->prev_owner
+		                    , ldns_rr_owner(cur)) == 0) {
+			/* RRs of one owner share its name */
+			if (reader->intern_owners
+			&&  reader->prev_owner != ldns_rr_owner(cur)) {
+				ldns_rdf_deep_free(ldns_rr_owner(cur));
+				ldns_rr_set_owner(cur,
+				    ldns_rdf_ref(reader->prev_owner));
+			}
+		} else if (ldns_rr_owner(cur)) {
+			if (reader->prev_owner) {
+				ldns_rdf_deep_free(reader->prev_owner);
+			}
+			reader->prev_owner = reader->intern_owners
+				? ldns_rdf_ref(ldns_rr_owner(cur))
+				: ldns_rdf_clone(ldns_rr_owner(cur));
+			if (!reader->prev_owner) {
+				ldns_rr_free(cur);
+				return LDNS_STATUS_MEM_ERR;
+			}
+		}
+		reader->prev_type = ldns_rr_get_type(cur);
+		reader->prev_ttl = ldns_rr_ttl(cur);
+
+		/* set origin to soa if not specified */
+		if (ldns_rr_get_type(cur) == LDNS_RR_TYPE_SOA
+		&&  !reader->origin) {
+			reader->origin = ldns_rdf_clone(ldns_rr_owner(cur));
 		}
+		*rr = cur;
+		return LDNS_STATUS_OK;
 	}
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, const ldns_rdf *origin,
+	uint32_t default_ttl, ldns_rr_class c, int *line_nr)
+{
+	ldns_zone *newzone;
+	ldns_zone_reader *reader;
+	ldns_rr *rr;
+	ldns_status s;
 
-	if (my_origin) {
-		ldns_rdf_deep_free(my_origin);
+	newzone = ldns_zone_new();
+	reader = ldns_zone_reader_new(fp, origin, default_ttl, c);
+	if (!newzone || !reader) {
+		s = LDNS_STATUS_MEM_ERR;
+		goto error;
 	}
-	if (my_prev) {
-		ldns_rdf_deep_free(my_prev);
+	while ((s = ldns_zone_reader_next(reader, &rr, line_nr))
+			== LDNS_STATUS_OK && rr) {
+		if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+			if (ldns_zone_soa(newzone)) {
+				/* second SOA 
+				 * just skip, maybe we want to say
+				 * something??? */
+				ldns_rr_free(rr);
+				continue;
+			}
+			ldns_zone_set_soa(newzone, rr);
+			continue;
+		}
+		
+		/* a normal RR - as sofar the DNS is normal */
+		if (!ldns_zone_push_rr(newzone, rr)) {
+			ldns_rr_free(rr);
+			s = LDNS_STATUS_MEM_ERR;
+			goto error;
+		}
+	}
+	if (s != LDNS_STATUS_OK) {
+		goto error;
 	}
+	ldns_zone_reader_free(reader);
 	if (z) {
 		*z = newzone;
 	} else {
-		ldns_zone_free(newzone);
+		ldns_zone_deep_free(newzone);
 	}
-
 	return LDNS_STATUS_OK;
 
 error:
-	if (my_origin) {
-		ldns_rdf_deep_free(my_origin);
-	}
-	if (my_prev) {
-		ldns_rdf_deep_free(my_prev);
-	}
+	ldns_zone_reader_free(reader);
 	if (newzone) {
-		ldns_zone_free(newzone);
+		ldns_zone_deep_free(newzone);
 	}
-	return ret;
+	return s;
 }
 
 void
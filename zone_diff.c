@@ -0,0 +1,492 @@
+/*
+ * zone_diff.c
+ *
+ * the differences between two versions of a zone
+ *
+ * a Net::DNS like library for C
+ *
+ * (c) NLnet Labs, 2024
+ *
+ * See the file LICENSE for the license
+ */
+
+#include <ldns/config.h>
+
+#include <ldns/ldns.h>
+
+#include <stdlib.h>
+
+/* Zones with fewer RRs than this are compared in the calling thread */
+#define LDNS_ZONE_DIFF_PARALLEL 32768
+
+/* From rr.c; memcmp() on these keys gives the order of ldns_rr_list_sort() */
+size_t _ldns_rr_sort_key_write(uint8_t *key, const ldns_rr *rr);
+void _ldns_rr_sort_run(void *(*f)(void *), void *jobs, size_t size, size_t n);
+
+/* The sort key of the current RR of one of the versions */
+struct ldns_zone_diff_key
+{
+	uint8_t *key;
+	size_t len;
+	size_t size;
+};
+
+/* A range of names, compared by one thread */
+struct ldns_zone_diff_part
+{
+	const ldns_rr_list *old_rrs;
+	size_t old_lo, old_hi;
+	const ldns_rr_list *new_rrs;
+	size_t new_lo, new_hi;
+	/* the differences, with the RRs of the versions (not references) */
+	ldns_rr_list *deleted;
+	ldns_rr_list *added;
+	ldns_status status;
+};
+
+static bool
+ldns_zone_diff_key_set(struct ldns_zone_diff_key *k, const ldns_rr *rr)
+{
+	size_t len = _ldns_rr_sort_key_write(NULL, rr);
+	uint8_t *key;
+
+	if (len > k->size) {
+		key = LDNS_XREALLOC(k->key, uint8_t, len);
+		if (!key) {
+			return false;
+		}
+		k->key = key;
+		k->size = len;
+	}
+	k->len = _ldns_rr_sort_key_write(k->key, rr);
+	return true;
+}
+
+static int
+ldns_zone_diff_key_compare(const struct ldns_zone_diff_key *a,
+		const struct ldns_zone_diff_key *b)
+{
+	int result = memcmp(a->key, b->key, a->len < b->len ? a->len : b->len);
+
+	if (result != 0) {
+		return result;
+	}
+	return a->len < b->len ? -1 : a->len > b->len ? 1 : 0;
+}
+
+/* Walks through the sorted RRs of both versions in the range of the part */
+static void *
+ldns_zone_diff_part(void *arg)
+{
+	struct ldns_zone_diff_part *part = arg;
+	struct ldns_zone_diff_key o = { NULL, 0, 0 }, n = { NULL, 0, 0 };
+	bool o_set = false, n_set = false;
+	ldns_rr *old_rr, *new_rr;
+	size_t i = part->old_lo, j = part->new_lo;
+	int c;
+
+	part->status = LDNS_STATUS_MEM_ERR;
+	part->deleted = ldns_rr_list_new();
+	part->added = ldns_rr_list_new();
+	if (!part->deleted || !part->added) {
+		goto done;
+	}
+	while (i < part->old_hi || j < part->new_hi) {
+		old_rr = i < part->old_hi ? ldns_rr_list_rr(part->old_rrs, i) : NULL;
+		new_rr = j < part->new_hi ? ldns_rr_list_rr(part->new_rrs, j) : NULL;
+		if (old_rr && !o_set) {
+			if (!ldns_zone_diff_key_set(&o, old_rr)) {
+				goto done;
+			}
+			o_set = true;
+		}
+		if (new_rr && !n_set) {
+			if (!ldns_zone_diff_key_set(&n, new_rr)) {
+				goto done;
+			}
+			n_set = true;
+		}
+		c = !new_rr ? -1 : !old_rr ? 1 : ldns_zone_diff_key_compare(&o, &n);
+
+		if (c < 0 || (c == 0 &&
+		    ldns_rr_ttl(old_rr) != ldns_rr_ttl(new_rr))) {
+			if (!ldns_rr_list_push_rr(part->deleted, old_rr)) {
+				goto done;
+			}
+		}
+		if (c > 0 || (c == 0 &&
+		    ldns_rr_ttl(old_rr) != ldns_rr_ttl(new_rr))) {
+			if (!ldns_rr_list_push_rr(part->added, new_rr)) {
+				goto done;
+			}
+		}
+		if (c <= 0) {
+			i++;
+			o_set = false;
+		}
+		if (c >= 0) {
+			j++;
+			n_set = false;
+		}
+	}
+	part->status = LDNS_STATUS_OK;
+done:
+	LDNS_FREE(o.key);
+	LDNS_FREE(n.key);
+	return NULL;
+}
+
+/* Returns the index of the first RR in the sorted list with an owner name
+ * that is equal to or comes after owner.
+ */
+static size_t
+ldns_zone_diff_lower_bound(const ldns_rr_list *rrs, const ldns_rdf *owner)
+{
+	size_t lo = 0, hi = ldns_rr_list_rr_count(rrs), mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (ldns_dname_compare(ldns_rr_owner(ldns_rr_list_rr(rrs, mid)),
+		                       owner) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static bool
+ldns_zone_diff_push_ref(ldns_rr_list *rrs, ldns_rr *rr)
+{
+	if (ldns_rr_list_push_rr(rrs, ldns_rr_ref(rr))) {
+		return true;
+	}
+	ldns_rr_free(rr);
+	return false;
+}
+
+/* Compares the RRs in the lists, which are sorted first, and makes the
+ * change set.
+ */
+static ldns_status
+ldns_zone_diff_new_frm_rr_lists(ldns_zone_diff **diff,
+		ldns_rr_list *old_rrs, ldns_rr *old_soa,
+		ldns_rr_list *new_rrs, ldns_rr *new_soa)
+{
+	struct ldns_zone_diff_part *parts;
+	const ldns_rr_list *split;
+	const ldns_rdf *owner;
+	size_t old_count, new_count, n_parts, i, j, k;
+	ldns_status s = LDNS_STATUS_OK;
+
+	ldns_rr_list_sort(old_rrs);
+	ldns_rr_list_sort(new_rrs);
+	old_count = ldns_rr_list_rr_count(old_rrs);
+	new_count = ldns_rr_list_rr_count(new_rrs);
+
+	n_parts = old_count + new_count < LDNS_ZONE_DIFF_PARALLEL ? 1
+	        : ldns_rr_list_sort_threads();
+	if (!(parts = LDNS_CALLOC(struct ldns_zone_diff_part, n_parts))) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	/* Divide the names of the larger version in ranges. A name is in
+	 * one part only, in both versions.
+	 */
+	split = old_count >= new_count ? old_rrs : new_rrs;
+	for (i = 0; i < n_parts; i++) {
+		parts[i].old_rrs = old_rrs;
+		parts[i].new_rrs = new_rrs;
+		if (i == 0) {
+			parts[i].old_lo = parts[i].new_lo = 0;
+		} else {
+			k = ldns_rr_list_rr_count(split) * i / n_parts;
+			owner = ldns_rr_owner(ldns_rr_list_rr(split, k));
+			parts[i].old_lo = ldns_zone_diff_lower_bound(
+					old_rrs, owner);
+			parts[i].new_lo = ldns_zone_diff_lower_bound(
+					new_rrs, owner);
+			parts[i - 1].old_hi = parts[i].old_lo;
+			parts[i - 1].new_hi = parts[i].new_lo;
+		}
+	}
+	parts[n_parts - 1].old_hi = old_count;
+	parts[n_parts - 1].new_hi = new_count;
+
+	_ldns_rr_sort_run(ldns_zone_diff_part, parts, sizeof(*parts), n_parts);
+
+	for (i = 0; i < n_parts && s == LDNS_STATUS_OK; i++) {
+		s = parts[i].status;
+	}
+	if (s == LDNS_STATUS_OK && !(*diff = LDNS_CALLOC(ldns_zone_diff, 1))) {
+		s = LDNS_STATUS_MEM_ERR;
+	}
+	if (s == LDNS_STATUS_OK) {
+		(*diff)->old_soa = old_soa ? ldns_rr_ref(old_soa) : NULL;
+		(*diff)->new_soa = new_soa ? ldns_rr_ref(new_soa) : NULL;
+		(*diff)->deleted = ldns_rr_list_new();
+		(*diff)->added = ldns_rr_list_new();
+		if (!(*diff)->deleted || !(*diff)->added) {
+			s = LDNS_STATUS_MEM_ERR;
+		}
+	}
+	for (i = 0; i < n_parts && s == LDNS_STATUS_OK; i++) {
+		for (j = 0; j < ldns_rr_list_rr_count(parts[i].deleted)
+				&& s == LDNS_STATUS_OK; j++) {
+			if (!ldns_zone_diff_push_ref((*diff)->deleted,
+					ldns_rr_list_rr(parts[i].deleted, j))) {
+				s = LDNS_STATUS_MEM_ERR;
+			}
+		}
+		for (j = 0; j < ldns_rr_list_rr_count(parts[i].added)
+				&& s == LDNS_STATUS_OK; j++) {
+			if (!ldns_zone_diff_push_ref((*diff)->added,
+					ldns_rr_list_rr(parts[i].added, j))) {
+				s = LDNS_STATUS_MEM_ERR;
+			}
+		}
+	}
+	for (i = 0; i < n_parts; i++) {
+		ldns_rr_list_free(parts[i].deleted);
+		ldns_rr_list_free(parts[i].added);
+	}
+	LDNS_FREE(parts);
+	if (s != LDNS_STATUS_OK && *diff) {
+		ldns_zone_diff_free(*diff);
+		*diff = NULL;
+	}
+	return s;
+}
+
+/* Pushes rr on rrs, or takes it as the SOA when it is the first one */
+static bool
+ldns_zone_diff_push(ldns_rr_list *rrs, ldns_rr *rr, ldns_rr **soa)
+{
+	if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+		if (!*soa) {
+			*soa = rr;
+		}
+		return true;
+	}
+	return ldns_rr_list_push_rr(rrs, rr);
+}
+
+static bool
+ldns_zone_diff_push_zone(ldns_rr_list *rrs, const ldns_zone *zone,
+		ldns_rr **soa)
+{
+	size_t i;
+
+	*soa = ldns_zone_soa(zone);
+	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(zone)); i++) {
+		if (!ldns_zone_diff_push(rrs,
+				ldns_rr_list_rr(ldns_zone_rrs(zone), i), soa)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ldns_status
+ldns_zone_diff_new_frm_zones(ldns_zone_diff **diff,
+		const ldns_zone *old_zone, const ldns_zone *new_zone)
+{
+	ldns_rr_list *old_rrs, *new_rrs;
+	ldns_rr *old_soa = NULL, *new_soa = NULL;
+	ldns_status s = LDNS_STATUS_MEM_ERR;
+
+	if (!diff || !old_zone || !new_zone) {
+		return LDNS_STATUS_NULL;
+	}
+	*diff = NULL;
+	old_rrs = ldns_rr_list_new();
+	new_rrs = ldns_rr_list_new();
+	if (old_rrs && new_rrs &&
+	    ldns_zone_diff_push_zone(old_rrs, old_zone, &old_soa) &&
+	    ldns_zone_diff_push_zone(new_rrs, new_zone, &new_soa)) {
+		s = ldns_zone_diff_new_frm_rr_lists(diff,
+				old_rrs, old_soa, new_rrs, new_soa);
+	}
+	ldns_rr_list_free(old_rrs);
+	ldns_rr_list_free(new_rrs);
+	return s;
+}
+
+static bool
+ldns_zone_diff_push_rrs(ldns_rr_list *rrs, const ldns_dnssec_rrs *dnssec_rrs,
+		ldns_rr **soa)
+{
+	for (; dnssec_rrs; dnssec_rrs = dnssec_rrs->next) {
+		if (dnssec_rrs->rr &&
+		    !ldns_zone_diff_push(rrs, dnssec_rrs->rr, soa)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool
+ldns_zone_diff_push_dnssec_zone(ldns_rr_list *rrs,
+		const ldns_dnssec_zone *zone, ldns_rr **soa)
+{
+	ldns_rbnode_t *node;
+	const ldns_dnssec_name *name;
+	const ldns_dnssec_rrsets *rrsets;
+
+	*soa = NULL;
+	if (!zone->names) {
+		return true;
+	}
+	for (node = ldns_rbtree_first(zone->names);
+			node != LDNS_RBTREE_NULL;
+			node = ldns_rbtree_next(node)) {
+		name = (const ldns_dnssec_name *) node->data;
+		for (rrsets = name->rrsets; rrsets; rrsets = rrsets->next) {
+			if (!ldns_zone_diff_push_rrs(rrs, rrsets->rrs, soa) ||
+			    !ldns_zone_diff_push_rrs(rrs, rrsets->signatures,
+				    soa)) {
+				return false;
+			}
+		}
+		if ((name->nsec &&
+		     !ldns_zone_diff_push(rrs, name->nsec, soa)) ||
+		    !ldns_zone_diff_push_rrs(rrs, name->nsec_signatures, soa)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ldns_status
+ldns_zone_diff_new_frm_dnssec_zones(ldns_zone_diff **diff,
+		const ldns_dnssec_zone *old_zone,
+		const ldns_dnssec_zone *new_zone)
+{
+	ldns_rr_list *old_rrs, *new_rrs;
+	ldns_rr *old_soa = NULL, *new_soa = NULL;
+	ldns_status s = LDNS_STATUS_MEM_ERR;
+
+	if (!diff || !old_zone || !new_zone) {
+		return LDNS_STATUS_NULL;
+	}
+	*diff = NULL;
+	old_rrs = ldns_rr_list_new();
+	new_rrs = ldns_rr_list_new();
+	if (old_rrs && new_rrs &&
+	    ldns_zone_diff_push_dnssec_zone(old_rrs, old_zone, &old_soa) &&
+	    ldns_zone_diff_push_dnssec_zone(new_rrs, new_zone, &new_soa)) {
+		s = ldns_zone_diff_new_frm_rr_lists(diff,
+				old_rrs, old_soa, new_rrs, new_soa);
+	}
+	ldns_rr_list_free(old_rrs);
+	ldns_rr_list_free(new_rrs);
+	return s;
+}
+
+bool
+ldns_zone_diff_has_changes(const ldns_zone_diff *diff)
+{
+	return diff && (ldns_rr_list_rr_count(diff->deleted) > 0 ||
+	                ldns_rr_list_rr_count(diff->added) > 0);
+}
+
+/* When neither the RRs nor the SOA changed, an IXFR is the current SOA
+ * alone, as sent to a client that is up to date (RFC 1995 section 4).
+ */
+static bool
+ldns_zone_diff_is_empty(const ldns_zone_diff *diff)
+{
+	return !ldns_zone_diff_has_changes(diff) &&
+	       ldns_rr_compare(diff->old_soa, diff->new_soa) == 0 &&
+	       ldns_rr_ttl(diff->old_soa) == ldns_rr_ttl(diff->new_soa);
+}
+
+ldns_rr_list *
+ldns_zone_diff2ixfr(const ldns_zone_diff *diff)
+{
+	ldns_rr_list *ixfr;
+	size_t i;
+	bool ok;
+
+	if (!diff || !diff->old_soa || !diff->new_soa) {
+		return NULL;
+	}
+	if (!(ixfr = ldns_rr_list_new())) {
+		return NULL;
+	}
+	if (ldns_zone_diff_is_empty(diff)) {
+		if (!ldns_zone_diff_push_ref(ixfr, diff->new_soa)) {
+			ldns_rr_list_free(ixfr);
+			return NULL;
+		}
+		return ixfr;
+	}
+	ok = ldns_zone_diff_push_ref(ixfr, diff->new_soa) &&
+	     ldns_zone_diff_push_ref(ixfr, diff->old_soa);
+	for (i = 0; ok && i < ldns_rr_list_rr_count(diff->deleted); i++) {
+		ok = ldns_zone_diff_push_ref(ixfr,
+				ldns_rr_list_rr(diff->deleted, i));
+	}
+	ok = ok && ldns_zone_diff_push_ref(ixfr, diff->new_soa);
+	for (i = 0; ok && i < ldns_rr_list_rr_count(diff->added); i++) {
+		ok = ldns_zone_diff_push_ref(ixfr,
+				ldns_rr_list_rr(diff->added, i));
+	}
+	ok = ok && ldns_zone_diff_push_ref(ixfr, diff->new_soa);
+	if (!ok) {
+		ldns_rr_list_deep_free(ixfr);
+		return NULL;
+	}
+	return ixfr;
+}
+
+/* Printing is done through one output buffer, from host2str.c */
+ldns_buffer *_ldns_print_buffer_new(FILE *output, size_t capacity);
+void _ldns_print_buffer_free(FILE *output, ldns_buffer *buf);
+void _ldns_rr_print_fmt_buf(FILE *output, const ldns_output_format *fmt,
+		const ldns_rr *rr, ldns_buffer *buf);
+
+ldns_status
+ldns_zone_diff_print_ixfr(FILE *out, const ldns_output_format *fmt,
+		const ldns_zone_diff *diff)
+{
+	ldns_buffer *buf;
+	size_t i;
+
+	if (!diff || !diff->old_soa || !diff->new_soa) {
+		return LDNS_STATUS_ERR;
+	}
+	if (!(buf = _ldns_print_buffer_new(out, LDNS_MAX_PACKETLEN))) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	_ldns_rr_print_fmt_buf(out, fmt, diff->new_soa, buf);
+	if (ldns_zone_diff_is_empty(diff)) {
+		_ldns_print_buffer_free(out, buf);
+		return LDNS_STATUS_OK;
+	}
+	_ldns_rr_print_fmt_buf(out, fmt, diff->old_soa, buf);
+	for (i = 0; i < ldns_rr_list_rr_count(diff->deleted); i++) {
+		_ldns_rr_print_fmt_buf(out, fmt,
+				ldns_rr_list_rr(diff->deleted, i), buf);
+	}
+	_ldns_rr_print_fmt_buf(out, fmt, diff->new_soa, buf);
+	for (i = 0; i < ldns_rr_list_rr_count(diff->added); i++) {
+		_ldns_rr_print_fmt_buf(out, fmt,
+				ldns_rr_list_rr(diff->added, i), buf);
+	}
+	_ldns_rr_print_fmt_buf(out, fmt, diff->new_soa, buf);
+	_ldns_print_buffer_free(out, buf);
+	return LDNS_STATUS_OK;
+}
+
+void
+ldns_zone_diff_free(ldns_zone_diff *diff)
+{
+	if (diff) {
+		ldns_rr_free(diff->old_soa);
+		ldns_rr_free(diff->new_soa);
+		ldns_rr_list_deep_free(diff->deleted);
+		ldns_rr_list_deep_free(diff->added);
+		LDNS_FREE(diff);
+	}
+}